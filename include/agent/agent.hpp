@@ -0,0 +1,38 @@
+#pragma once
+
+#include "core/config.hpp"
+#include <map>
+#include <string>
+
+namespace ak {
+namespace agent {
+
+// Optional long-lived key agent. It keeps decrypted profiles in (locked)
+// memory and serves them over a per-user Unix socket, so shell hooks and
+// repeated `ak` invocations skip key derivation and decryption.
+//
+// Protocol: one request line per connection; the reply starts with "OK" or
+// "ERR <message>", followed by NAME=base64(value) lines for KEYS and VAULT.
+//   PING | STATUS | STOP | KEYS <profile> | VAULT
+
+constexpr int DEFAULT_TTL_SECONDS = 900;
+// With a sync remote and AK_PASSPHRASE the agent pulls from the remote in the
+// background this often (AK_SYNC_INTERVAL seconds, 0 disables)
+constexpr int DEFAULT_SYNC_INTERVAL_SECONDS = 300;
+
+std::string socketPath(const core::Config& cfg);
+
+// Serve requests until STOP, SIGTERM or `ttlSeconds` without a request.
+// Returns a process exit code.
+int serve(const core::Config& cfg, int ttlSeconds);
+
+// Client side. All calls return false quickly when no agent is running
+// (or AK_NO_AGENT is set), so callers can fall back to decrypting themselves.
+bool ping(const core::Config& cfg);
+bool status(const core::Config& cfg, std::string& info);
+bool stop(const core::Config& cfg);
+bool fetchProfileKeys(const core::Config& cfg, const std::string& profile, std::map<std::string, std::string>& keys);
+bool fetchVault(const core::Config& cfg, core::KeyStore& ks);
+
+} // namespace agent
+} // namespace ak
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace ak {
@@ -8,6 +9,8 @@ namespace cli {
 
 // Flag expansion
 std::vector<std::string> expandShortFlags(const std::vector<std::string>& args);
+// Appends `arg` to `out`, expanded when it is a short flag bundle like -pf
+void appendExpandedFlag(std::string_view arg, std::vector<std::string>& out);
 
 // Help system
 void cmd_help();
@@ -1,7 +1,9 @@
 #pragma once
 
 #include "core/config.hpp"
+#include <map>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace ak {
@@ -29,10 +31,14 @@ int cmd_env(const core::Config& cfg, const std::vector<std::string>& args);
 int cmd_export(const core::Config& cfg, const std::vector<std::string>& args);
 int cmd_import(const core::Config& cfg, const std::vector<std::string>& args);
 int cmd_migrate(const core::Config& cfg, const std::vector<std::string>& args);
+int cmd_rekey(const core::Config& cfg, const std::vector<std::string>& args);
 
 int cmd_run(const core::Config& cfg, const std::vector<std::string>& args);
+int cmd_redact(const core::Config& cfg, const std::vector<std::string>& args);
 int cmd_guard(const core::Config& cfg, const std::vector<std::string>& args);
 int cmd_test(const core::Config& cfg, const std::vector<std::string>& args);
+// ak test --watch under its own name
+int cmd_monitor(const core::Config& cfg, const std::vector<std::string>& args);
 int cmd_generate(const core::Config& cfg, const std::vector<std::string>& args);
 int cmd_refresh(const core::Config& cfg, const std::vector<std::string>& args);
 int cmd_doctor(const core::Config& cfg, const std::vector<std::string>& args);
@@ -44,6 +50,8 @@ int cmd_completion(const core::Config& cfg, const std::vector<std::string>& args
 
 int cmd_version(const core::Config& cfg, const std::vector<std::string>& args);
 int cmd_backend(const core::Config& cfg, const std::vector<std::string>& args);
+int cmd_sync(const core::Config& cfg, const std::vector<std::string>& args);
+int cmd_agent(const core::Config& cfg, const std::vector<std::string>& args);
 int cmd_help(const core::Config& cfg, const std::vector<std::string>& args);
 int cmd_welcome(const core::Config& cfg, const std::vector<std::string>& args);
 int cmd_gui(const core::Config& cfg, const std::vector<std::string>& args);
@@ -56,14 +64,35 @@ int cmd_service(const core::Config& cfg, const std::vector<std::string>& args);
 // Profile duplication
 int cmd_duplicate(const core::Config& cfg, const std::vector<std::string>& args);
 
-// Internal commands for shell integration auto-loading
+// Internal commands for shell integration auto-loading and completion
+// `ak __complete <keys|profiles|services> [prefix]`: names from the
+// completion index, one per line
+int cmd_complete(const core::Config& cfg, const std::vector<std::string>& args);
 int cmd_internal_get_dir_profiles(const core::Config& cfg, const std::vector<std::string>& args);
 int cmd_internal_get_bundle(const core::Config& cfg, const std::vector<std::string>& args);
+int cmd_internal_dir_bundle(const core::Config& cfg, const std::vector<std::string>& args);
+
+// Prompt hook: export/unset delta for the current directory
+int cmd_hook_env(const core::Config& cfg, const std::vector<std::string>& args);
 
 // Utility functions
+std::string exportLine(const std::string& name, const std::string& value);
+// Escapes straight into `out`; exportLineBound is enough room for any value
+void appendExportLine(std::string& out, std::string_view name, std::string_view value);
+size_t exportLineBound(std::string_view name, std::string_view value);
+std::vector<std::pair<std::string, std::string>> resolveProfileValues(const core::Config& cfg, const std::string& name);
+core::KeyStore loadVaultPreferAgent(const core::Config& cfg);
+std::string makeExports(const std::vector<std::pair<std::string, std::string>>& values);
 std::string makeExportsForProfile(const core::Config& cfg, const std::string& name);
 void printExportsForProfile(const core::Config& cfg, const std::string& name);
 void printUnsetsForProfile(const core::Config& cfg, const std::string& name);
+std::string makeExportsForPersisted(const core::Config& cfg, const std::string& name);
+std::string makeDirBundle(const core::Config& cfg, const std::vector<std::string>& profiles,
+                          std::map<std::string, std::string>& memo);
+// Rebuild every persisted directory's bundle; called after each mutating command
+void refreshDirBundles(const core::Config& cfg);
+// Writes cfg.metricsFile and pushes to cfg.otlpEndpoint; failures only warn
+void publishMetrics(const core::Config& cfg);
 
 } // namespace commands
 } // namespace ak
\ No newline at end of file
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "core/config.hpp"
+
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace ak {
+namespace commands {
+
+// Buffered writer to a file descriptor. Export writers go through it so a
+// profile is escaped and written a few KiB at a time instead of being
+// assembled in one string; the buffer is zeroed when the sink goes away.
+class ExportSink {
+public:
+    explicit ExportSink(int fd) : fd_(fd) {}
+    ~ExportSink();
+    ExportSink(const ExportSink&) = delete;
+    ExportSink& operator=(const ExportSink&) = delete;
+
+    void write(std::string_view data);
+    void put(char c);
+    // False once any write failed (the rest is dropped)
+    bool flush();
+    bool ok() const { return ok_; }
+    size_t written() const { return written_; }
+
+private:
+    void writeDirect(std::string_view data);
+
+    int fd_;
+    std::array<char, 16384> buffer_{};
+    size_t used_ = 0;
+    size_t written_ = 0;
+    bool ok_ = true;
+};
+
+struct ExportOptions {
+    std::string secretName;      // k8s metadata.name
+    std::string secretNamespace; // k8s metadata.namespace; omitted when empty
+};
+
+// One output format. Entries arrive in merged order, each exactly once.
+class ExportWriter {
+public:
+    virtual ~ExportWriter() = default;
+    virtual void begin(ExportSink& out) { (void)out; }
+    // Throws std::runtime_error for a value the format cannot represent
+    virtual void entry(ExportSink& out, std::string_view name, std::string_view value) = 0;
+    virtual void end(ExportSink& out, size_t count) { (void)out; (void)count; }
+};
+
+// env, dotenv, json, yaml, k8s (Secret YAML), k8s-json, docker (--env-file),
+// systemd (EnvironmentFile=), github ($GITHUB_ENV); nullptr for anything else
+std::unique_ptr<ExportWriter> makeExportWriter(const std::string& format, const ExportOptions& options = {});
+const std::vector<std::string>& exportFormats();
+
+// Streams the merged profiles (later layers win, see resolveLayers) through
+// `writer` straight from the decrypted key tables; returns the number of keys
+size_t streamExport(const core::Config& cfg, const std::vector<std::string>& layers, ExportWriter& writer,
+                    ExportSink& out);
+
+} // namespace commands
+} // namespace ak
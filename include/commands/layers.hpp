@@ -0,0 +1,52 @@
+#pragma once
+
+#include "core/config.hpp"
+
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace ak {
+namespace commands {
+
+// "base,staging,local" -> {"base", "staging", "local"}; empty entries dropped
+std::vector<std::string> parseLayers(const std::string& spec);
+
+// A merged key's value and the layer that supplied it
+struct LayeredValue {
+    std::string value;
+    size_t layer = 0; // index into LayeredEnv::layers
+};
+
+// Profiles applied as overlays, in order. Keeps each layer's own values (in
+// profile order) and the merge, where the last layer holding a key wins.
+struct LayeredEnv {
+    std::vector<std::string> layers;
+    std::vector<std::vector<std::pair<std::string, std::string>>> perLayer;
+    std::vector<std::string> order; // merged keys, by first appearance
+    std::map<std::string, LayeredValue> merged;
+
+    // The merged table in `order`
+    std::vector<std::pair<std::string, std::string>> values() const;
+};
+
+// Resolves all layers in one pass: each profile's keys come from the agent
+// or the cached key store, with the layers decrypted concurrently, and the
+// legacy vault is opened at most once for names no profile file holds.
+// Blob values are read in full; a key whose blob cannot be read (not on
+// this machine, or not decrypting) is left out with a warning.
+LayeredEnv resolveLayers(const core::Config& cfg, const std::vector<std::string>& layers);
+
+// The same merge, visited in the same order, without building it: values
+// are passed straight out of the decrypted key tables and valid only for the
+// call. For exports of large profiles. Unreadable blobs are skipped the
+// same way.
+void visitLayers(const core::Config& cfg, const std::vector<std::string>& layers,
+                 const std::function<void(std::string_view name, std::string_view value)>& visit);
+
+} // namespace commands
+} // namespace ak
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ak {
+namespace core {
+
+// The audit log is one "<ISO time> <action> <key hash>" line per key. The
+// active file is rotated into numbered-by-time segments (gzip when built with
+// zlib) once it grows past maxBytes or its first entry is older than
+// maxAgeSeconds. A sidecar "<log>.idx" lists the segments with their time
+// range and, for the active file, a (offset, time) mark about every 64 KiB,
+// so queries seek instead of reading everything.
+//
+// Writers take "<log>.lock" (flock) around rotation and append, and each
+// call is a single write, so concurrent processes and threads interleave
+// whole batches only.
+
+struct AuditRotation {
+    uint64_t maxBytes = 16ull << 20;
+    long long maxAgeSeconds = 30LL * 24 * 3600;
+};
+
+// Defaults overridden by AK_AUDIT_MAX_BYTES and AK_AUDIT_MAX_AGE_DAYS
+AuditRotation auditRotationFromEnv();
+
+// Appends `lines` (each ending in '\n') as one batch; failures are ignored
+void appendAudit(const std::string& path, const std::string& lines, const AuditRotation& rotation);
+
+struct AuditEntry {
+    std::string timestamp;
+    std::string action;
+    std::string keyHash;
+};
+
+// Empty fields match everything. since/until are ISO times or prefixes of
+// one ("2026-01-01"); until includes everything its prefix covers.
+struct AuditQuery {
+    std::string since;
+    std::string until;
+    std::string action;
+    std::string keyHash;
+    size_t limit = 50; // newest matching entries kept; 0 for all
+};
+
+// Matching entries, oldest first. Reads the active file backwards from the
+// newest relevant mark and stops at `since` or once `limit` entries are
+// found; older segments are opened only when still needed.
+std::vector<AuditEntry> queryAudit(const std::string& path, const AuditQuery& query);
+
+// "7d", "12h", "30m" or "45s" before now as an ISO time; anything else is
+// returned unchanged
+std::string resolveAuditTime(const std::string& spec);
+
+} // namespace core
+} // namespace ak
@@ -1,6 +1,10 @@
 #pragma once
 
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <unordered_map>
 
@@ -10,23 +14,82 @@ namespace core {
 // Version
 extern const std::string AK_VERSION;
 
+// A setting computed on first read, for values whose lookup spawns a
+// process or touches disk while many commands never need them. Copies share
+// the result, so it is computed once per run; assigning a value replaces the
+// resolver. A default-constructed Lazy reads as T{}.
+template <typename T>
+class Lazy {
+public:
+    Lazy() = default;
+    Lazy(T value) : state_(std::make_shared<State>()) { state_->value = std::move(value); }
+
+    static Lazy deferred(std::function<T()> resolve) {
+        Lazy lazy;
+        lazy.state_ = std::make_shared<State>();
+        lazy.state_->resolve = std::move(resolve);
+        return lazy;
+    }
+
+    Lazy& operator=(T value) {
+        *this = Lazy(std::move(value));
+        return *this;
+    }
+
+    const T& get() const {
+        static const T empty{};
+        if (!state_) {
+            return empty;
+        }
+        std::call_once(state_->once, [this] {
+            if (state_->resolve) {
+                state_->value = state_->resolve();
+                state_->resolve = nullptr;
+            }
+        });
+        return state_->value;
+    }
+    operator const T&() const { return get(); }
+
+    // Whether get() would run the resolver
+    bool pending() const { return state_ && state_->resolve; }
+
+private:
+    struct State {
+        std::once_flag once;
+        std::function<T()> resolve;
+        T value{};
+    };
+    std::shared_ptr<State> state_;
+};
+
 // Configuration structure
 struct Config {
     std::string configDir;       // $XDG_CONFIG_HOME/ak or $HOME/.config/ak
-    std::string vaultPath;       // keys.env.gpg or keys.env
+    Lazy<std::string> vaultPath; // keys.env.gpg or keys.env; may depend on gpgAvailable
     std::string profilesDir;     // profiles directory
-    bool gpgAvailable = false;
+    Lazy<bool> gpgAvailable;     // probed with commandExists("gpg") on first use
     bool json = false;
     bool forcePlain = false;     // AK_DISABLE_GPG
     std::string presetPassphrase; // AK_PASSPHRASE
     std::string auditLogPath;
-    std::string instanceId;
+    Lazy<std::string> instanceId; // persistDir/instance_id, created on first use
     std::string persistDir;
+    std::string backend;         // AK_BACKEND or configDir/backend: gpg, aead or plain
+    bool profileLog = false;     // AK_PROFILE_LOG=1: append profile key changes to a record log
+    bool contentStore = false;   // AK_CONTENT_STORE=1: profiles are manifests over shared value objects
+    std::string metricsFile;     // --metrics-file or AK_METRICS_FILE: Prometheus text written on exit
+    std::string otlpEndpoint;    // --otlp-endpoint or AK_OTLP_ENDPOINT: OTLP/HTTP collector base URL
 };
 
 // KeyStore structure
 struct KeyStore {
     std::unordered_map<std::string, std::string> kv;
+    // Set by loadVault: what was read and from which write of which file, so
+    // saveVault can merge into a vault another writer replaced meanwhile
+    std::unordered_map<std::string, std::string> base;
+    std::string basePath;
+    std::string baseVersion;
 };
 
 // Utility functions
@@ -35,7 +98,7 @@ std::string getenvs(const char* key, const std::string& defaultValue = "");
 std::string trim(const std::string& str);
 std::string toLower(std::string str);
 bool icontains(const std::string& haystack, const std::string& needle);
-std::string maskValue(const std::string& value);
+std::string maskValue(std::string_view value);
 
 // Error handling and output
 void error(const Config& cfg, const std::string& msg, int code = 1);
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ak {
+namespace core {
+namespace metrics {
+
+// Process-wide counters and latency histograms for storage and service
+// checks, exported as Prometheus text (--metrics-file) or OTLP/HTTP JSON
+// (--otlp-endpoint). Collection is off until enable() is called; while off,
+// every call below is a relaxed load and a return.
+
+using Labels = std::vector<std::pair<std::string, std::string>>;
+
+void enable();
+bool enabled();
+
+class Counter {
+public:
+    void add(uint64_t n = 1) { value_.fetch_add(n, std::memory_order_relaxed); }
+    uint64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> value_{0};
+};
+
+// Fixed buckets from 0.5 ms to 10 s; the sum is kept in nanoseconds
+class Histogram {
+public:
+    static constexpr std::array<double, 14> BOUNDS = {0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05,
+                                                      0.1,    0.25,  0.5,    1,     2.5,  5,    10};
+
+    void observe(double seconds);
+    // Non-cumulative counts per bucket, the last one for +Inf
+    std::array<uint64_t, BOUNDS.size() + 1> buckets() const;
+    uint64_t count() const;
+    double sum() const { return static_cast<double>(sumNs_.load(std::memory_order_relaxed)) / 1e9; }
+
+private:
+    std::array<std::atomic<uint64_t>, BOUNDS.size() + 1> counts_{};
+    std::atomic<uint64_t> sumNs_{0};
+};
+
+// Looked up by name and labels, created on first use; references stay valid
+// until reset()
+Counter& counter(const std::string& name, const Labels& labels = {});
+Histogram& histogram(const std::string& name, const Labels& labels = {});
+
+// Shorthands that do nothing while collection is off
+void count(const std::string& name, const Labels& labels = {}, uint64_t n = 1);
+void observe(const std::string& name, const Labels& labels, double seconds);
+
+// Times its own lifetime into the histogram "<name>_seconds"
+class Span {
+public:
+    explicit Span(const char* name, Labels labels = {});
+    ~Span();
+    Span(const Span&) = delete;
+    Span& operator=(const Span&) = delete;
+
+    // Labels known only once the work is done, e.g. the outcome
+    void label(std::string key, std::string value);
+
+private:
+    const char* name_;
+    Labels labels_;
+    std::chrono::steady_clock::time_point start_;
+    bool active_;
+};
+
+std::string prometheusText();
+// ExportMetricsServiceRequest in the OTLP/HTTP JSON encoding, cumulative
+std::string otlpJson();
+// Replaces `path` atomically so scrapers never see a partial file
+bool writePrometheusFile(const std::string& path);
+
+// Drops every metric; for tests
+void reset();
+
+} // namespace metrics
+} // namespace core
+} // namespace ak
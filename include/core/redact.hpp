@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace ak {
+namespace core {
+
+// Aho-Corasick automaton over bytes: one pass over the text reports every
+// occurrence of every pattern, overlapping ones included. Patterns are
+// matched exactly or ignoring ASCII case; the trie is keyed on lower-cased
+// bytes and exact patterns are confirmed against the text when they hit.
+// Immutable once constructed, so one instance can be shared across threads.
+class PatternMatcher {
+public:
+    struct Pattern {
+        std::string text;
+        bool ignoreCase = false;
+    };
+
+    PatternMatcher() = default;
+    // Pattern ids are indexes into `patterns`; empty patterns never match
+    explicit PatternMatcher(std::vector<Pattern> patterns);
+
+    size_t size() const { return patterns_.size(); }
+    size_t longest() const { return longest_; }
+    // Whether some pattern contains '\n'; if not, no match spans lines
+    bool spansLines() const { return spansLines_; }
+
+    // onMatch(id, begin, end) for each occurrence, in order of `end`
+    template <typename F>
+    void scan(std::string_view text, F&& onMatch) const;
+
+private:
+    struct Node {
+        int32_t fail = 0;
+        int32_t outLink = -1; // nearest node on the fail chain with patterns
+        std::vector<uint32_t> ends; // patterns ending here
+        std::vector<std::pair<unsigned char, int32_t>> next; // sorted by byte
+    };
+
+    static unsigned char fold(unsigned char c) { return (c >= 'A' && c <= 'Z') ? static_cast<unsigned char>(c + 32) : c; }
+    int32_t child(int32_t node, unsigned char c) const;
+    int32_t step(int32_t node, unsigned char c) const;
+    bool confirm(uint32_t id, std::string_view text, size_t begin) const;
+
+    std::vector<Pattern> patterns_;
+    std::vector<Node> nodes_;
+    int32_t root_[256] = {}; // dense transitions out of the root
+    size_t longest_ = 0;
+    bool spansLines_ = false;
+};
+
+// Secret redaction plus error-phrase detection in the same pass. Secrets are
+// exact; phrases ignore case and are only reported, never replaced.
+class Redactor {
+public:
+    static constexpr std::string_view TOKEN = "[REDACTED]";
+
+    Redactor() = default;
+    Redactor(const std::vector<std::string>& secrets, const std::vector<std::string>& phrases = {});
+
+    // `text` with each secret occurrence replaced by TOKEN; overlapping
+    // occurrences collapse into one. `flagged`, when given, is set to whether
+    // any phrase occurs.
+    std::string redact(std::string_view text, bool* flagged = nullptr) const;
+    bool flags(std::string_view text) const;
+
+    // Redacts inFd into outFd in chunks, holding back only what could still
+    // be the start of a secret (a partial line at most, unless a secret
+    // contains a newline). False on a read or write error.
+    bool redactStream(int inFd, int outFd) const;
+
+    bool empty() const { return matcher_.size() == 0; }
+
+private:
+    // Appends the redacted form of text[0, limit) to `out`, extended past
+    // limit to the end of any secret that starts before it; returns the
+    // offset consumed
+    size_t redactInto(std::string_view text, size_t limit, std::string& out, bool* flagged) const;
+
+    PatternMatcher matcher_;
+    size_t secretCount_ = 0; // ids below this are secrets, the rest phrases
+};
+
+template <typename F>
+void PatternMatcher::scan(std::string_view text, F&& onMatch) const {
+    if (nodes_.empty()) {
+        return;
+    }
+    int32_t state = 0;
+    for (size_t i = 0; i < text.size(); ++i) {
+        state = step(state, fold(static_cast<unsigned char>(text[i])));
+        for (int32_t n = nodes_[state].ends.empty() ? nodes_[state].outLink : state; n > 0; n = nodes_[n].outLink) {
+            for (uint32_t id : nodes_[n].ends) {
+                size_t begin = i + 1 - patterns_[id].text.size();
+                if (confirm(id, text, begin)) {
+                    onMatch(static_cast<size_t>(id), begin, i + 1);
+                }
+            }
+        }
+    }
+}
+
+} // namespace core
+} // namespace ak
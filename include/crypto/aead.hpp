@@ -0,0 +1,36 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+namespace ak {
+namespace crypto {
+
+// In-process authenticated encryption for vault files (".akv").
+//
+// Layout: "AKV1" | kdf id | log2(N) | r | p | salt[16] | nonce[12] | ciphertext | tag[16]
+// The 36-byte header is bound as associated data. Keys are derived with scrypt
+// and cached per process, so only the first open of a file pays for the KDF.
+
+// True when built with an AEAD implementation (OpenSSL)
+bool aeadAvailable();
+
+// True when the blob starts with the AKV magic
+bool isAeadBlob(const std::string& blob);
+
+// True when the blob's header asks scrypt for no more than this build allows
+// (r <= 32, p <= 16, at most 1 GiB); aeadOpen refuses any other blob
+bool aeadParamsSupported(const std::string& blob);
+
+// Encrypt plaintext under a passphrase. Throws std::runtime_error on failure.
+std::string aeadSeal(const std::string& plaintext, const std::string& passphrase);
+
+// Decrypt and authenticate. Returns false on a wrong passphrase, tampering or
+// a malformed blob; plaintext is left untouched in that case.
+bool aeadOpen(const std::string& blob, const std::string& passphrase, std::string& plaintext);
+
+// Drop all cached derived keys (and zero them)
+void aeadClearKeyCache();
+
+} // namespace crypto
+} // namespace ak
@@ -1,22 +1,53 @@
 #pragma once
 
-#include <string>
+#include <array>
 #include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
 
 namespace ak {
 namespace crypto {
 
-// Base64 encoding/decoding
-std::string base64Encode(const std::string& input);
-std::string base64Decode(const std::string& input);
+// Base64 encoding/decoding, vectorized (SSSE3/AVX2 or NEON) where the CPU
+// allows. base64Decode is lenient: it stops at '=' and skips characters
+// outside the alphabet. base64DecodeStrict rejects anything but canonical,
+// correctly padded input.
+std::string base64Encode(std::string_view input);
+std::string base64Decode(std::string_view input);
+bool base64DecodeStrict(std::string_view input, std::string& output);
+// Lenient decode into a caller buffer of at least base64DecodedBound() bytes
+// (vector stores may run a few bytes past the result); returns bytes written
+size_t base64DecodedBound(size_t encodedLength);
+size_t base64DecodeInto(std::string_view input, char* output);
+// Forces the scalar code (tests comparing the two)
+void base64ForcePortable(bool portable);
 
-// SHA256 hashing class
+// SHA256 hashing class. Whole blocks are compressed straight from the input
+// with SHA-NI (x86) or the ARMv8 crypto extensions when the CPU has them,
+// otherwise with the portable implementation. The object is copyable: copy it
+// after a shared prefix (a salt) to reuse that midstate for many messages.
 class SHA256 {
 public:
+    using Digest = std::array<uint8_t, 32>;
+
     SHA256();
     void update(const std::string& str);
     void update(const uint8_t* data, size_t length);
+    // Hex digest; resets the hasher
     std::string final();
+    // Raw digest without any formatting; resets the hasher
+    Digest finalRaw();
+
+    // Digests of many (typically short) messages. On SHA-NI two messages of
+    // equal block count are compressed in interleaved lanes.
+    static std::vector<Digest> hashMany(const std::vector<std::string>& inputs);
+    static std::string toHex(const Digest& digest);
+
+    // Block implementation in use: "sha-ni", "armv8" or "portable"
+    static const char* backend();
+    // Forces the portable implementation (tests comparing the two)
+    static void forcePortable(bool portable);
 
 private:
     uint8_t data[64];
@@ -30,12 +61,20 @@ private:
     static uint32_t s0(uint32_t x);
     static uint32_t s1(uint32_t x);
     
-    void transform();
+    static void compressPortable(uint32_t state[8], const uint8_t* blocks, size_t count);
+    static void compress(uint32_t state[8], const uint8_t* blocks, size_t count);
     void reset();
 };
 
 // Utility function for hashing key names
 std::string hashKeyName(const std::string& name);
 
+// HMAC-SHA256 (RFC 2104) of `message` under `key`, as a hex digest
+std::string hmacSha256(const std::string& key, const std::string& message);
+
+// Zeroes a buffer of decrypted material; unlike memset the stores are never
+// optimized away
+void secureZero(void* data, size_t length);
+
 } // namespace crypto
 } // namespace ak
\ No newline at end of file
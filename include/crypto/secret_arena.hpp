@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace ak {
+namespace crypto {
+
+// Non-owning view of decrypted bytes, usually held by a SecretArena. Reads
+// like a string_view; turning it into a std::string is spelled copy(), so
+// every plaintext copy is visible where it is made.
+class SecretView {
+public:
+    constexpr SecretView() = default;
+    constexpr SecretView(const char* data, std::size_t size) : data_(data), size_(size) {}
+
+    constexpr const char* data() const { return data_; }
+    constexpr std::size_t size() const { return size_; }
+    constexpr bool empty() const { return size_ == 0; }
+    constexpr std::string_view view() const { return std::string_view(data_, size_); }
+    constexpr operator std::string_view() const { return view(); }
+
+    std::string copy() const { return std::string(data_, size_); }
+
+private:
+    const char* data_ = nullptr;
+    std::size_t size_ = 0;
+};
+
+inline bool operator==(SecretView a, std::string_view b) { return a.view() == b; }
+inline bool operator!=(SecretView a, std::string_view b) { return a.view() != b; }
+
+// Bump allocator for decrypted material. Memory comes straight from the OS in
+// page-rounded chunks that are locked into RAM (mlock/VirtualLock, so never
+// written to swap) and left out of core dumps where the platform allows.
+// reset() zeroes everything handed out and keeps the first chunk for the
+// next operation; the destructor zeroes and unlocks all of it. Locking is
+// best effort: past RLIMIT_MEMLOCK chunks are still zeroed, just not locked.
+// Not thread-safe; one arena per operation.
+class SecretArena {
+public:
+    // `reserve` sizes the first chunk, e.g. a bound for a whole key file
+    explicit SecretArena(std::size_t reserve = 0);
+    ~SecretArena();
+    SecretArena(const SecretArena&) = delete;
+    SecretArena& operator=(const SecretArena&) = delete;
+
+    // Uninitialized space, valid until reset(); throws std::bad_alloc
+    char* allocate(std::size_t size);
+    SecretView store(std::string_view data);
+    void reset();
+
+    std::size_t used() const;
+    std::size_t capacity() const;
+    // Every chunk is locked in memory
+    bool locked() const;
+
+private:
+    struct Chunk {
+        char* data = nullptr;
+        std::size_t size = 0;
+        std::size_t used = 0;
+        bool locked = false;
+    };
+
+    Chunk& chunkFor(std::size_t size);
+
+    std::vector<Chunk> chunks_;
+};
+
+} // namespace crypto
+} // namespace ak
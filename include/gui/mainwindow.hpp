@@ -5,6 +5,7 @@
 #include "core/config.hpp"
 #include "gui/widgets/keymanager.hpp"
 #include "gui/widgets/servicemanager.hpp"
+#include "gui/widgets/changefeed.hpp"
 #include <QMainWindow>
 #include <QTabWidget>
 #include <QVBoxLayout>
@@ -40,6 +41,7 @@ private:
 
     // UI Components
     QTabWidget *tabWidget;
+    widgets::StorageChangeFeed *changeFeed;
     widgets::KeyManagerWidget *keyManagerWidget;
     widgets::ServiceManagerWidget *serviceManagerWidget;
     QWidget *settingsTab;
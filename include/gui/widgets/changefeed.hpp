@@ -0,0 +1,71 @@
+#pragma once
+
+#ifdef BUILD_GUI
+
+#include "core/config.hpp"
+#include <QFileSystemWatcher>
+#include <QMap>
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QTimer>
+
+namespace ak {
+namespace gui {
+namespace widgets {
+
+// Watches the profiles directory, user_services.txt and the vault and reports
+// what changed, whether by this process or by `ak set` in a terminal. A save
+// is a burst of events (temporary file, rename, .profile rewrite), so events
+// are debounced and then resolved by comparing file stamps against the last
+// scan; widgets get one signal per changed profile rather than per event.
+class StorageChangeFeed : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit StorageChangeFeed(const core::Config& config, QObject *parent = nullptr);
+
+    static constexpr int DebounceMs = 200;
+
+signals:
+    // <name>.keys* or its record log changed
+    void profileKeysChanged(const QString &profileName);
+    // A .profile file was added, removed or rewritten
+    void profilesChanged();
+    void servicesChanged();
+    void vaultChanged();
+
+private slots:
+    void onPathChanged(const QString &path);
+    void flush();
+
+private:
+    struct Stamp {
+        qint64 modified = -1; // ms since epoch; -1 when missing
+        qint64 size = -1;
+        bool operator==(const Stamp &other) const { return modified == other.modified && size == other.size; }
+        bool operator!=(const Stamp &other) const { return !(*this == other); }
+    };
+
+    static Stamp stampOf(const QString &path);
+    QMap<QString, Stamp> scanProfiles() const;
+    // Atomic replaces drop a file's watch, so watches are re-added after each scan
+    void rewatch();
+
+    const core::Config& config;
+    QFileSystemWatcher *watcher;
+    QTimer *debounce;
+    QString profilesDir;
+    QString servicesPath;
+    QString vaultPath;
+    QMap<QString, Stamp> profileFiles; // file name -> stamp, hidden files skipped
+    Stamp servicesStamp;
+    Stamp vaultStamp;
+};
+
+} // namespace widgets
+} // namespace gui
+} // namespace ak
+
+#endif // BUILD_GUI
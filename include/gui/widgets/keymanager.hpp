@@ -3,11 +3,15 @@
 #ifdef BUILD_GUI
 
 #include "core/config.hpp"
+#include "services/services.hpp"
+#include "services/test_cache.hpp"
+#include "storage/profile_index.hpp"
+#include "storage/search_index.hpp"
+#include "gui/widgets/tablemodels.hpp"
 #include <QWidget>
 #include <QVBoxLayout>
 #include <QHBoxLayout>
-#include <QTableWidget>
-#include <QTableWidgetItem>
+#include <QTableView>
 #include <QLineEdit>
 #include <QPushButton>
 #include <QLabel>
@@ -26,6 +30,7 @@
 #include <QJsonArray>
 #include <QTextStream>
 #include <fstream>
+#include <memory>
 
 namespace ak {
 namespace gui {
@@ -33,69 +38,31 @@ namespace widgets {
 
 // Forward declarations
 class SecureInputWidget;
+class StorageChangeFeed;
 
-// Worker class for loading profile keys in background thread
-class ProfileKeysLoaderWorker : public QObject
+// Loads and saves profile keys on one long-lived background thread.
+// Requests run in the order they were made, so a load issued after a save
+// sees the saved file. `quiet` marks reloads triggered by a change on disk.
+class ProfileKeysWorker : public QObject
 {
     Q_OBJECT
 
 public:
-    ProfileKeysLoaderWorker(const core::Config& config, const QString& profileName, const QString& passphrase, QObject *parent = nullptr);
-    
-public slots:
-    void loadKeys();
-
-signals:
-    void keysLoaded(const QString& profileName, const std::map<std::string, std::string>& keys);
-    void loadFailed(const QString& profileName, const QString& error);
-
-private:
-    core::Config config;
-    QString profileName;
-    std::string passphrase;
-};
-
-// Worker class for saving profile keys in background thread
-class ProfileKeysSaverWorker : public QObject
-{
-    Q_OBJECT
-
-public:
-    ProfileKeysSaverWorker(const core::Config& config,
-                           const QString& profileName,
-                           const std::map<std::string, std::string>& keys,
-                           const QString& passphrase,
-                           QObject *parent = nullptr);
+    explicit ProfileKeysWorker(const core::Config& config, QObject *parent = nullptr);
 
 public slots:
-    void saveKeys();
+    void loadKeys(const QString& profileName, const QString& passphrase, bool quiet);
+    void saveKeys(const QString& profileName, const std::map<std::string, std::string>& keys, const QString& passphrase);
 
 signals:
-    void saveCompleted(const QString& profileName);
+    void keysLoaded(const QString& profileName, const std::map<std::string, std::string>& keys, bool quiet);
+    void loadFailed(const QString& profileName, const QString& error, bool quiet);
+    // `warning` is set when the keys were saved but the .profile list wasn't
+    void saveCompleted(const QString& profileName, const QString& warning);
     void saveFailed(const QString& profileName, const QString& error);
 
 private:
     core::Config config;
-    QString profileName;
-    std::map<std::string, std::string> keysToSave;
-    std::string passphrase;
-};
-
-// Custom table item for masked values
-class MaskedTableItem : public QTableWidgetItem
-{
-public:
-    explicit MaskedTableItem(const QString &actualValue);
-    
-    void setMasked(bool masked);
-    bool isMasked() const;
-    QString getActualValue() const;
-    
-private:
-    void updateDisplayValue();
-    
-    QString actualValue;
-    bool masked;
 };
 
 // Key Manager Widget
@@ -113,6 +80,8 @@ public:
     void setCurrentProfile(const QString &profileName);
     QString getCurrentProfile() const;
     void refreshProfileList();
+    // Follow external edits of the profiles as they happen
+    void watchStorage(StorageChangeFeed *feed);
 
 signals:
     void statusMessage(const QString &message);
@@ -127,12 +96,13 @@ private slots:
     void testSelectedKey();
     void testAllKeys();
     void showContextMenu(const QPoint &pos);
-    void onTableItemChanged(QTableWidgetItem *item);
+    void onTableClicked(const QModelIndex &index);
     void onSelectionChanged();
     void onProfileChanged(const QString &profileName);
-    void onKeysLoaded(const QString& profileName, const std::map<std::string, std::string>& keys);
-    void onKeysLoadFailed(const QString& profileName, const QString& error);
-    void onKeysSaved(const QString& profileName);
+    void onKeysLoaded(const QString& profileName, const std::map<std::string, std::string>& keys, bool quiet);
+    void onKeysLoadFailed(const QString& profileName, const QString& error, bool quiet);
+    void onProfileKeysChanged(const QString& profileName);
+    void onKeysSaved(const QString& profileName, const QString& warning);
     void onKeysSaveFailed(const QString& profileName, const QString& error);
     // Profile management actions
     void createProfile();
@@ -150,14 +120,24 @@ private:
     void loadKeys();
     void saveKeys();
     void updateTable();
-    void filterTable(const QString &filter);
+    // Filters the table to the search index's matches for currentFilter in
+    // the shown profile (same query syntax as `ak search`)
+    void applyFilter();
     void loadProfileKeys(const QString &profileName);
     void saveProfileKeys(const QString &profileName);
+    // Shows `keys` for the profile; an update of the profile already shown
+    // is applied row by row
+    void showProfileKeys(const QString &profileName, const std::map<std::string, std::string> &keys);
+    void requestLoad(const QString &profileName, const QString &passphrase, bool quiet);
     // Utility methods
-    void addKeyToTable(const QString &name, const QString &value, const QString &service, const QString &apiUrl);
+    // Model row of the current selection, or -1
+    int currentSourceRow() const;
+    KeyTableModel::RowInfo resolveKeyInfo(const std::string &name, const std::string &value);
     QString detectService(const QString &keyName);
     QString getServiceApiUrl(const QString &service);
     QString getServiceCode(const QString &displayName);
+    // Services from config, loaded at most once per table refresh
+    const std::map<std::string, ak::services::Service>& serviceCatalog();
     void updateTestStatus(const QString &keyName, bool success, const QString &message = "");
     bool validateKeyName(const QString &name);
     void showError(const QString &message);
@@ -169,17 +149,20 @@ private:
     void clearPassphrase();
     bool validateProfileName(const QString &name);
     
-    void cleanupLoadThread(bool waitForFinish = true);
-    void cleanupSaveThread(bool waitForFinish = true);
-    
     // Configuration and data
     const core::Config& config;
     QString currentProfile;
+    QString shownProfile; // whose keys the table holds
     std::map<std::string, std::string> profileKeys;
     std::map<QString, std::map<std::string, std::string>> cachedProfileKeys; // Cache loaded keys to avoid repeated GPG prompts
+    ak::storage::ProfileIndex profileIndex; // over profileKeys, updated with each edit
+    std::map<std::string, ak::services::Service> serviceCache;
+    bool servicesLoaded = false;
+    std::unique_ptr<ak::services::TestResultCache> testCache; // opened on first lookup after a refresh
+    std::unique_ptr<ak::storage::KeySearchIndex> searchIndex; // read on first search, dropped on storage changes
     bool keysModified; // Track if keys have been modified since last load
-    bool loadingInProgress;
-    bool savingInProgress;
+    int pendingLoads; // user-visible loads queued on the worker
+    int pendingSaves;
     QString sessionPassphrase;
     QString rememberedPassphrase;
     bool rememberPassphrase;
@@ -203,7 +186,9 @@ private:
     QLabel *statusLabel;
     
     // Table
-    QTableWidget *table;
+    QTableView *table;
+    KeyTableModel *keyModel;
+    SearchFilterProxyModel *proxyModel;
     
     // Context menu
     QMenu *contextMenu;
@@ -214,26 +199,13 @@ private:
     QAction *copyValueAction;
     QAction *toggleVisibilityAction;
     
-    // Table columns
-    enum TableColumn {
-        ColumnName = 0,
-        ColumnService = 1,
-        ColumnUrl = 2,
-        ColumnValue = 3,
-        ColumnTestStatus = 4,
-        ColumnActions = 5,
-        ColumnCount = 6
-    };
-    
     // State
     bool globalVisibilityState;
     QString currentFilter;
     
     // Background loading/saving
-    QThread *loadKeysThread;
-    ProfileKeysLoaderWorker *loadKeysWorker;
-    QThread *saveKeysThread;
-    ProfileKeysSaverWorker *saveKeysWorker;
+    QThread *keysThread;
+    ProfileKeysWorker *keysWorker;
 };
 
 } // namespace widgets
@@ -15,6 +15,7 @@
 #include <QGroupBox>
 #include <QString>
 #include <QStringList>
+#include <optional>
 
 namespace ak {
 namespace gui {
@@ -22,6 +23,7 @@ namespace widgets {
 
 // Forward declarations
 class ProfileImportExportDialog;
+class StorageChangeFeed;
 
 // Profile List Item
 class ProfileListItem : public QListWidgetItem
@@ -52,6 +54,8 @@ public:
     void ensureDefaultProfile();
     void setAsDefaultProfile();
     QString getDefaultProfileName() const;
+    // Keep the list and the vault copy in step with the files on disk
+    void watchStorage(StorageChangeFeed *feed);
 
 signals:
     void statusMessage(const QString &message);
@@ -85,6 +89,7 @@ private:
     QStringList availableProfiles;
     QString currentProfile;
     QString defaultProfileName;
+    std::optional<core::KeyStore> vaultCache; // decrypted on first export, dropped when the vault changes
 
     // UI components
     QVBoxLayout *mainLayout;
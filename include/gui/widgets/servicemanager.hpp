@@ -5,11 +5,11 @@
 #include "core/config.hpp"
 #include "services/services.hpp"
 #include "gui/widgets/common/secureinput.hpp"
+#include "gui/widgets/tablemodels.hpp"
 #include <QWidget>
 #include <QVBoxLayout>
 #include <QHBoxLayout>
-#include <QTableWidget>
-#include <QTableWidgetItem>
+#include <QTableView>
 #include <QLineEdit>
 #include <QPushButton>
 #include <QLabel>
@@ -30,6 +30,8 @@ namespace ak {
 namespace gui {
 namespace widgets {
 
+class StorageChangeFeed;
+
 // Service Editor Dialog
 class ServiceEditorDialog : public QDialog
 {
@@ -87,6 +89,8 @@ public:
     // Public interface
     void refreshServices();
     void selectService(const QString &serviceName);
+    // Reload when user_services.txt changes, e.g. after `ak service add`
+    void watchStorage(StorageChangeFeed *feed);
 
 signals:
     void statusMessage(const QString &message);
@@ -99,7 +103,6 @@ private slots:
     void testSelectedService();
     void testAllServices();
     void showContextMenu(const QPoint &pos);
-    void onTableItemChanged(QTableWidgetItem *item);
     void onSelectionChanged();
     void exportServices();
     void importServices();
@@ -115,7 +118,8 @@ private:
     void filterTable(const QString &filter);
     
     // Utility methods
-    void addServiceToTable(const services::Service &service);
+    // Service of the current selection, or nullptr
+    const services::Service *currentService() const;
     void updateTestStatus(const QString &serviceName, bool success, const QString &message = "");
     bool validateServiceName(const QString &name);
     bool canEditService(const services::Service &service);
@@ -144,7 +148,9 @@ private:
     QLabel *statusLabel;
     
     // Table
-    QTableWidget *table;
+    QTableView *table;
+    ServiceTableModel *serviceModel;
+    SearchFilterProxyModel *proxyModel;
     
     // Context menu
     QMenu *contextMenu;
@@ -155,17 +161,6 @@ private:
     QAction *copyNameAction;
     QAction *duplicateAction;
     
-    // Table columns
-    enum TableColumn {
-        ColumnName = 0,
-        ColumnKeyName = 1,
-        ColumnDescription = 2,
-        ColumnType = 3,
-        ColumnTestable = 4,
-        ColumnTestStatus = 5,
-        ColumnCount = 6
-    };
-    
     // State
     QString currentFilter;
 };
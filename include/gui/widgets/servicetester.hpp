@@ -20,6 +20,7 @@
 #include <QStringList>
 #include <QIcon>
 #include <QDateTime>
+#include <atomic>
 #include <chrono>
 
 namespace ak {
@@ -76,6 +77,8 @@ public:
     
     void setServices(const QStringList &services);
     void setFailFast(bool failFast);
+    // Thread-safe; aborts queued and in-flight checks of a running testAllServices()
+    void cancel();
 
 public slots:
     void testAllServices();
@@ -95,6 +98,7 @@ private:
     QStringList servicesToTest;
     bool failFast;
     QMutex mutex;
+    std::atomic<bool> cancelRequested{false};
 };
 
 // Service Tester Widget
@@ -0,0 +1,185 @@
+#pragma once
+
+#ifdef BUILD_GUI
+
+#include "services/services.hpp"
+#include <QAbstractTableModel>
+#include <QSet>
+#include <QSortFilterProxyModel>
+#include <QString>
+#include <QStringList>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace ak {
+namespace gui {
+namespace widgets {
+
+// Models behind the key and service tables. Rows are plain structs, so a
+// 1500-key profile costs one vector instead of ~9000 heap items; views only
+// ask for the cells they paint, which is where masking and per-row service
+// lookups happen. Edits and test results update single rows.
+
+enum class TestState { NotTested, Testing, Passed, Failed };
+
+// Lower-cased text a row is searched by (SearchFilterProxyModel)
+constexpr int SearchRole = Qt::UserRole + 1;
+// The unmasked value of a key row
+constexpr int ValueRole = Qt::UserRole + 2;
+
+class KeyTableModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    enum Column {
+        ColumnName = 0,
+        ColumnService = 1,
+        ColumnUrl = 2,
+        ColumnValue = 3,
+        ColumnTestStatus = 4,
+        ColumnActions = 5,
+        ColumnCount = 6
+    };
+
+    // Filled in for a row the first time one of its cells is needed
+    struct RowInfo {
+        QString service;
+        QString url;
+        TestState state = TestState::NotTested;
+        QString status; // last known outcome, e.g. from the test result cache
+    };
+    // Service detection and cache lookups are comparatively slow, so they run
+    // for visible rows only
+    using InfoResolver = std::function<RowInfo(const std::string& name, const std::string& value)>;
+
+    explicit KeyTableModel(QObject *parent = nullptr);
+
+    void setResolver(InfoResolver resolver);
+
+    // Replaces every row (profile switch or reload)
+    void setKeys(const std::map<std::string, std::string>& keys);
+    // Brings the rows in line with `keys` (the same profile re-read from
+    // disk), touching only rows that were added, removed or changed
+    void syncKeys(const std::map<std::string, std::string>& keys);
+    // Inserts or updates one row in name order
+    void upsertKey(const std::string& name, const std::string& value);
+    void removeKey(const std::string& name);
+    void setTestStatus(const std::string& name, TestState state, const QString& message);
+
+    // Masking applies to every row not toggled individually
+    void setMasked(bool masked);
+    bool isMasked() const { return masked; }
+    void toggleRowMasked(int row);
+
+    // Row of `name`, or -1
+    int rowOf(const std::string& name) const;
+    const std::string& nameAt(int row) const { return rows[row].name; }
+    const std::string& valueAt(int row) const { return rows[row].value; }
+    QString serviceAt(int row) const { return info(row).service; }
+
+    static QString maskValue(const std::string& value);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+private:
+    struct Row {
+        std::string name;
+        std::string value;
+        QString displayName;
+        QString search; // lower-cased name
+        bool toggled = false; // shown opposite to the table-wide masking
+        mutable bool resolved = false;
+        mutable RowInfo info;
+    };
+
+    const RowInfo& info(int row) const;
+    Row makeRow(const std::string& name, const std::string& value) const;
+
+    std::vector<Row> rows; // sorted by name, like the profile's key map
+    InfoResolver resolver;
+    bool masked = true;
+};
+
+class ServiceTableModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    enum Column {
+        ColumnName = 0,
+        ColumnKeyName = 1,
+        ColumnDescription = 2,
+        ColumnType = 3,
+        ColumnTestable = 4,
+        ColumnTestStatus = 5,
+        ColumnCount = 6
+    };
+
+    explicit ServiceTableModel(QObject *parent = nullptr);
+
+    void setServices(const std::map<std::string, services::Service>& services);
+    // Brings the rows in line with `services`, keeping the test status of
+    // rows that survive
+    void syncServices(const std::map<std::string, services::Service>& services);
+    void upsertService(const services::Service& service);
+    void removeService(const std::string& name);
+    void setTestStatus(const std::string& name, TestState state, const QString& message);
+
+    int rowOf(const std::string& name) const;
+    const services::Service& serviceAt(int row) const { return rows[row].service; }
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+private:
+    struct Row {
+        services::Service service;
+        QString search;
+        TestState state = TestState::NotTested;
+        QString message;
+    };
+
+    static Row makeRow(const services::Service& service);
+
+    std::vector<Row> rows; // sorted by service name
+};
+
+// Case-insensitive substring filter over SearchRole. A new search text only
+// re-runs the match over the models' cached lower-case strings; rows added
+// or changed in the source are filtered as they arrive. Alternatively the
+// caller hands over the exact set of accepted SearchRole values, e.g. the
+// matches of a storage::KeySearchIndex query.
+class SearchFilterProxyModel : public QSortFilterProxyModel
+{
+    Q_OBJECT
+
+public:
+    explicit SearchFilterProxyModel(QObject *parent = nullptr);
+
+    void setSearchText(const QString &text);
+    // Replaces the substring match until cleared
+    void setAcceptedNames(const QSet<QString> &lowered);
+    void clearAcceptedNames();
+
+protected:
+    bool filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const override;
+
+private:
+    QString needle;
+    bool byNames = false;
+    QSet<QString> accepted;
+};
+
+} // namespace widgets
+} // namespace gui
+} // namespace ak
+
+#endif // BUILD_GUI
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+namespace ak {
+namespace http {
+
+// Small in-process HTTP client for service checks. When built with libcurl,
+// every request goes through one shared multi handle driven by a background
+// thread, so connections, TLS sessions and HTTP/2 streams are reused across
+// checks and threads. Without libcurl callers fall back to curl(1).
+
+struct Request {
+    std::string method = "GET";
+    std::string url;
+    std::vector<std::string> headers; // "Name: value"
+    std::string body;
+    size_t maxBody = 1 << 20;          // the rest of a longer response is dropped
+};
+
+struct Timeouts {
+    long connectMs = 5000;
+    long totalMs = 12000;
+};
+
+struct Response {
+    int curlCode = 0;   // CURLcode; same numbering as the curl CLI exit status
+    int status = 0;     // HTTP status, 0 when no response arrived
+    std::string body;
+    std::string error;  // transport error, empty on success
+    std::vector<std::string> headers; // "Name: value" of the final response
+};
+
+// Value of a response header (case-insensitive name), "" when absent
+std::string header(const Response& response, const std::string& name);
+
+// True when the native engine is compiled in and not disabled with AK_HTTP_ENGINE=cli
+bool available();
+
+// 5s connect / 12s total, overridable with AK_HTTP_CONNECT_TIMEOUT and AK_HTTP_TIMEOUT (seconds)
+Timeouts defaultTimeouts();
+
+// Blocking and safe to call from many threads at once. Once `cancel` is set
+// (and interrupt() called) the transfer ends with CURLE_ABORTED_BY_CALLBACK.
+Response perform(const Request& request, const Timeouts& timeouts = defaultTimeouts(),
+                 const std::atomic<bool>* cancel = nullptr);
+
+// Wake the engine so it notices cancel flags set since its last pass
+void interrupt();
+
+// Headers from curl-style arguments, e.g. "-H 'Accept: a' --header \"X: y\""
+std::vector<std::string> parseHeaderArgs(const std::string& args);
+
+// Equivalent, shell-quoted curl arguments (timeouts not included)
+std::string toCurlArgs(const Request& request);
+
+// "5" or "0.25", as accepted by --connect-timeout / --max-time
+std::string formatSeconds(long ms);
+
+} // namespace http
+} // namespace ak
@@ -0,0 +1,90 @@
+/*
+ * libak: in-process access to an ak vault from C and anything with a C FFI
+ * (Python ctypes/cffi, Go cgo, ...), without spawning `ak get` per lookup.
+ *
+ * A handle unlocks each profile once, on first use, and then answers every
+ * lookup from memory until ak_reload() or ak_close(). Handles may be shared
+ * between threads; every call is safe to make concurrently except ak_close,
+ * which must follow all other calls on the handle. Values are returned in
+ * buffers the caller releases with ak_free_secret(), which zeroes them;
+ * iterators point straight into the unlocked table instead of copying.
+ *
+ * The functions and struct layouts below keep their meaning across releases;
+ * new ones are only ever added. AK_API_VERSION is bumped when that happens.
+ */
+#ifndef AK_LIBAK_H
+#define AK_LIBAK_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AK_API_VERSION 1
+
+typedef enum ak_status {
+    AK_OK = 0,
+    AK_ERR_INVALID = 1,   /* NULL handle or argument, or a malformed profile name */
+    AK_ERR_NOT_FOUND = 2, /* no such key in the profile */
+    AK_ERR_LOCKED = 3,    /* the profile is encrypted and no passphrase is available */
+    AK_ERR_DECRYPT = 4,   /* wrong passphrase or damaged key file */
+    AK_ERR_NO_MEMORY = 5,
+    AK_ERR_INTERNAL = 6
+} ak_status;
+
+typedef struct ak_vault ak_vault;
+typedef struct ak_iter ak_iter;
+
+/* Any field may be NULL to get what the ak command would use */
+typedef struct ak_options {
+    const char* config_dir; /* default $XDG_CONFIG_HOME/ak */
+    const char* passphrase; /* default $AK_PASSPHRASE */
+    const char* backend;    /* default $AK_BACKEND, then the backend setting */
+} ak_options;
+
+/* Version of the ak release the library was built from, e.g. "4.11.0" */
+const char* ak_version(void);
+/* Static English description of a status */
+const char* ak_strerror(ak_status status);
+
+/* `options` may be NULL. Nothing is decrypted until a profile is used. */
+ak_status ak_open(const ak_options* options, ak_vault** vault);
+/* Zeroes every unlocked profile not still held by an open iterator (those
+ * are zeroed when the iterator is closed) and frees the handle. NULL is
+ * ignored. */
+void ak_close(ak_vault* vault);
+/* Forgets the unlocked copy of `profile` (NULL: of every profile), so the
+ * next lookup reads the key file again */
+ak_status ak_reload(ak_vault* vault, const char* profile);
+
+/* A NULL profile means "default". On success *value is a NUL-terminated copy
+ * (values may contain NUL bytes; *length, if not NULL, is the exact size).
+ * A large value stored as a blob is read from the blob store; AK_ERR_DECRYPT
+ * when it is missing or damaged. */
+ak_status ak_get(ak_vault* vault, const char* profile, const char* name, char** value, size_t* length);
+/* Looks up `count` names after a single unlock. values[i] is NULL (and
+ * lengths[i] 0) for names the profile does not hold; `lengths` may be NULL.
+ * On failure no values are returned. */
+ak_status ak_get_many(ak_vault* vault, const char* profile, const char* const* names, size_t count, char** values,
+                      size_t* lengths);
+/* Zeroes and frees a value from ak_get or ak_get_many. NULL is ignored. */
+void ak_free_secret(char* value);
+
+/* Walks the keys of a profile in name order. The names and values returned
+ * by ak_iter_next are not NUL-terminated and stay valid until
+ * ak_iter_close, even across ak_reload and ak_close. Large values stored as
+ * blobs are read when reached; one that cannot be read is skipped. */
+ak_status ak_iter_open(ak_vault* vault, const char* profile, ak_iter** iter);
+/* 1 and the next entry, or 0 once the table is exhausted */
+int ak_iter_next(ak_iter* iter, const char** name, size_t* name_length, const char** value, size_t* value_length);
+void ak_iter_close(ak_iter* iter);
+
+/* Zeroes a buffer the caller copied secret material into */
+void ak_zeroize(void* data, size_t length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AK_LIBAK_H */
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "core/config.hpp"
+#include "services/services.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace ak {
+namespace services {
+
+// Long-running key health checks (ak monitor, ak test --watch). Each job
+// keeps its own next-probe time: healthy keys are probed rarely, rejected
+// ones more often, and rate limits, 5xx and transport errors back off
+// exponentially. Intervals are jittered so probes of many keys drift apart
+// instead of hitting a provider in lockstep.
+
+enum class KeyHealth { Unknown, Healthy, Failing, Throttled };
+
+const char* healthName(KeyHealth health);
+// Ok -> Healthy; 429, 5xx and failures without an HTTP status -> Throttled;
+// anything else (401, 403, ...) -> Failing
+KeyHealth classifyHealth(const TestResult& result);
+
+struct MonitorPolicy {
+    std::chrono::seconds healthyInterval{300};
+    std::chrono::seconds failingInterval{60};
+    std::chrono::seconds backoffBase{30}; // first retry after a throttle, doubled each time
+    std::chrono::seconds maxBackoff{3600};
+    double jitter = 0.1; // each interval scaled by a random factor in [1 - jitter, 1 + jitter]
+};
+
+class MonitorSchedule {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct State {
+        KeyHealth health = KeyHealth::Unknown;
+        int consecutive = 0; // results in a row with the current health
+        Clock::time_point next;
+        TestResult last{};
+    };
+
+    // Every job is due at `start`
+    MonitorSchedule(std::vector<TestJob> jobs, MonitorPolicy policy, Clock::time_point start,
+                    uint64_t seed = std::random_device{}());
+
+    // Indexes of the jobs whose probe time has come, earliest first
+    std::vector<size_t> due(Clock::time_point now) const;
+    // Stores the outcome and schedules the next probe; true when the job's
+    // health changed (the first result always counts as a change)
+    bool record(size_t index, const TestResult& result, Clock::time_point now);
+    Clock::time_point nextWake() const;
+
+    const std::vector<TestJob>& jobs() const { return jobs_; }
+    const State& state(size_t index) const { return states_[index]; }
+
+private:
+    std::chrono::milliseconds interval(const State& state);
+
+    std::vector<TestJob> jobs_;
+    std::vector<State> states_;
+    MonitorPolicy policy_;
+    std::mt19937_64 rng_;
+};
+
+// Health changes only; `previous` is Unknown for the first result of a job
+using MonitorChangeCallback =
+    std::function<void(const TestJob&, const TestResult&, KeyHealth previous, const MonitorSchedule::State&)>;
+
+// Probes due jobs through run_test_jobs (so the HTTP pool and decrypted key
+// cache stay warm across rounds) until schedule.cancel is set. `onRound`
+// runs after every round of probes.
+void runMonitor(const core::Config& cfg, const std::vector<TestJob>& jobs, TestSchedule schedule,
+                const MonitorPolicy& policy, const MonitorChangeCallback& onChange,
+                const std::function<void()>& onRound = nullptr);
+
+} // namespace services
+} // namespace ak
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+
+namespace ak {
+namespace services {
+
+struct Service;
+
+// One built-in service as compiled into the binary; see Service for the
+// meaning of each field
+struct BuiltinService {
+    std::string_view name;
+    std::string_view keyName;
+    std::string_view description;
+    std::string_view testEndpoint;
+    std::string_view testMethod;
+    std::string_view testHeaders;
+    std::string_view authMethod;
+    std::string_view generateUrl;
+    bool testable;
+};
+
+struct BuiltinServiceRange {
+    const BuiltinService* first;
+    const BuiltinService* last;
+
+    const BuiltinService* begin() const { return first; }
+    const BuiltinService* end() const { return last; }
+    size_t size() const { return static_cast<size_t>(last - first); }
+};
+
+// Every built-in service, in no particular order
+BuiltinServiceRange builtinServices();
+
+// Constant-time lookup through a perfect hash computed at compile time;
+// nullptr for names that are not built in
+const BuiltinService* findBuiltinService(std::string_view name);
+
+// The Service loadAllServices() starts from for a built-in entry
+Service makeService(const BuiltinService& builtin);
+
+} // namespace services
+} // namespace ak
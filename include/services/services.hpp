@@ -1,11 +1,15 @@
 #pragma once
 
 #include "core/config.hpp"
+#include "http/http.hpp"
+#include "services/registry.hpp"
 #include <string>
 #include <vector>
 #include <unordered_set>
 #include <map>
 #include <chrono>
+#include <functional>
+#include <memory>
 
 namespace ak {
 namespace services {
@@ -58,16 +62,23 @@ struct Service {
     }
 };
 
-// Service definitions
+// Service definitions; built from builtinServices(), see registry.hpp
 extern const std::map<std::string, Service> DEFAULT_SERVICES;
 extern const std::map<std::string, std::string> SERVICE_KEYS; // For backwards compatibility
 extern const std::unordered_set<std::string> TESTABLE_SERVICES; // For backwards compatibility
+// Key names the gemini service accepts, in lookup order
+const std::vector<std::string>& googleKeyNames();
 
 // Service management
 std::unordered_set<std::string> getKnownServiceKeys();
 std::vector<std::string> detectConfiguredServices(const core::Config& cfg, const std::string& profileName);
 
 // Service management
+// Built-in services merged with configDir/user_services.txt. Memoized per
+// file: it is reparsed only when its mtime or size changes, and
+// saveUserServices() drops the memo. The map is shared; copy to modify.
+using ServiceMapPtr = std::shared_ptr<const std::map<std::string, Service>>;
+ServiceMapPtr loadAllServicesCached(const core::Config& cfg);
 std::map<std::string, Service> loadAllServices(const core::Config& cfg);
 void saveUserServices(const core::Config& cfg, const std::map<std::string, Service>& services);
 void addService(const core::Config& cfg, const Service& service);
@@ -81,6 +92,7 @@ Service getServiceByName(const core::Config& cfg, const std::string& name);
 // Test result structure
 struct TestResult {
     std::string service;
+    std::string profile; // profile the keys came from; empty means the default
     bool ok;
     std::chrono::milliseconds duration;
     std::string error_message;
@@ -88,6 +100,7 @@ struct TestResult {
     std::string response_snippet;
     int exit_code = 0;
     int http_status = 0;
+    bool cached = false; // served from TestResultCache, no request made
 };
 
 struct CurlExecResult {
@@ -100,7 +113,60 @@ struct CurlExecResult {
 
 // Testing functions
 CurlExecResult curl_ok(const std::string& args, bool debug = false);
-TestResult test_one(const core::Config& cfg, const std::string& service, const std::string& profileName = "", bool debug = false);
+// In-process via http::perform when available, otherwise through curl_ok
+CurlExecResult http_ok(const http::Request& request, bool debug = false,
+                       const std::atomic<bool>* cancel = nullptr);
+TestResult test_one(const core::Config& cfg, const std::string& service, const std::string& profileName = "", bool debug = false,
+                    const std::atomic<bool>* cancel = nullptr);
+// The key value test_one would send for `service` (profile, then environment); "" if none
+std::string resolveTestKey(const core::Config& cfg, const std::string& service,
+                           const std::string& profileName = "");
+
+// One unit of work for the test scheduler
+struct TestJob {
+    std::string service;
+    std::string profile; // empty: default profile
+};
+
+struct TestSchedule {
+    size_t workers = 0;   // 0: AK_TEST_WORKERS, else 16
+    size_t perHost = 0;   // 0: AK_TEST_PER_HOST, else 4 checks per endpoint host at once
+    bool failFast = false;
+    bool debug = false;
+    // Reuse results from TestResultCache and record fresh ones
+    bool useCache = false;
+    bool refreshCache = false; // record only, never reuse (ak test --no-cache)
+    long maxAgeSeconds = -1;   // -1: defaultTestCacheTtl()
+    // Optional stop flag shared with the caller; see cancelTests()
+    std::atomic<bool>* cancel = nullptr;
+};
+
+// Observer callbacks. Both run on worker threads; `finished` calls arrive in
+// completion order and never concurrently, `started` calls may overlap.
+using TestStartCallback = std::function<void(const TestJob&)>;
+using TestResultCallback = std::function<void(const TestJob&, const TestResult&)>;
+
+// Run jobs on a bounded worker pool. On fail-fast (or cancelTests) dispatch
+// stops and in-flight requests are aborted; their results are dropped.
+// Returns the delivered results in completion order.
+std::vector<TestResult> run_test_jobs(
+    const core::Config& cfg,
+    const std::vector<TestJob>& jobs,
+    const TestSchedule& schedule,
+    const TestResultCallback& onResult = nullptr,
+    const TestStartCallback& onStart = nullptr
+);
+
+// Stop a run_test_jobs call whose schedule points at `cancel`; safe from any thread
+void cancelTests(std::atomic<bool>& cancel);
+
+// One NDJSON line (without the newline) describing a result
+std::string toJsonLine(const TestResult& result);
+
+// Host the check for `service` talks to ("" when it makes no request)
+std::string testHostFor(const std::map<std::string, Service>& services, const std::string& service);
+
+// Same as run_test_jobs for one profile
 std::vector<TestResult> run_tests_parallel(
     const core::Config& cfg,
     const std::vector<std::string>& services,
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "core/config.hpp"
+#include "services/services.hpp"
+
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <utility>
+
+namespace ak {
+namespace services {
+
+// Outcomes of network checks kept in persistDir/test_cache, so repeated
+// `ak test` runs and the GUI can skip requests that were answered recently.
+// Entries are keyed by service and a SHA-256 of the key value (salted with
+// the instance id): a rotated key, or another profile's key for the same
+// service, never finds a result it did not earn, and the file never holds
+// secrets. Entries unused for ENTRY_RETENTION are dropped on save.
+class TestResultCache {
+public:
+    explicit TestResultCache(const core::Config& cfg);
+
+    // Fills `out` from an entry younger than `maxAgeSeconds` (< 0: any age)
+    bool lookup(const std::string& service, const std::string& keyValue,
+                long maxAgeSeconds, TestResult& out) const;
+    // Keeps request-backed successes and definitive auth rejections;
+    // transient errors are skipped
+    void store(const std::string& service, const std::string& keyValue, const TestResult& result);
+    // Every entry of `service`, whatever its key
+    void erase(const std::string& service);
+    // Merges with the file on disk under a lock on "<file>.lock" and replaces
+    // it with writeFileAtomic; no-op when nothing changed. Throws
+    // std::runtime_error when the file can't be written.
+    void save();
+
+    static std::string path(const core::Config& cfg);
+    static bool cacheable(const TestResult& result);
+
+private:
+    using EntryKey = std::pair<std::string, std::string>; // service, key hash
+
+    struct Entry {
+        long long checkedAt = 0; // unix seconds
+        bool ok = false;
+        int httpStatus = 0;
+        long long durationMs = 0;
+        std::string error;
+    };
+
+    static constexpr long long ENTRY_RETENTION = 30LL * 86400;
+
+    static std::map<EntryKey, Entry> readEntries(const std::string& file);
+    std::string hashValue(const std::string& keyValue) const;
+
+    std::string path_;
+    std::string salt_;
+    std::map<EntryKey, Entry> entries_;
+    std::set<EntryKey> changed_;     // stored since load
+    std::set<std::string> erased_;   // services erased since load
+    mutable std::mutex mutex_;
+};
+
+// AK_TEST_CACHE_TTL in seconds, else one hour
+long defaultTestCacheTtl();
+
+// "90", "30s", "15m", "2h", "1d" -> seconds; -1 when malformed
+long parseMaxAge(const std::string& text);
+
+} // namespace services
+} // namespace ak
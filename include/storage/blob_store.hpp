@@ -0,0 +1,91 @@
+#pragma once
+
+#include "core/config.hpp"
+
+#include <cstddef>
+#include <functional>
+#include <istream>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace ak {
+namespace storage {
+
+// Out-of-line values for large secrets (service-account JSON, kubeconfigs,
+// TLS bundles). A blob is one file, configDir/blobs/<id>, holding the value
+// in BLOB_CHUNK_SIZE segments, each sealed on its own unless the backend is
+// plain. The vault or profile key file keeps only a short reference
+// (formatBlobRef), so listing and loading the other keys never reads the
+// blob, and readers stream it a segment at a time. Blobs are immutable:
+// replacing the value writes a new one and leaves the old for
+// collectBlobGarbage().
+constexpr size_t BLOB_CHUNK_SIZE = 256 * 1024;
+
+struct BlobRef {
+    std::string id;              // 32 hex digits, random
+    unsigned long long size = 0; // bytes in the value
+};
+
+// "\x01ak-blob <id> <size>": the leading control byte keeps a reference
+// from being mistaken for a value that was typed or imported
+std::string formatBlobRef(const BlobRef& ref);
+bool parseBlobRef(std::string_view value, BlobRef& ref);
+
+class BlobStore {
+public:
+    // Segments are sealed under `passphrase` unless the active backend is
+    // plain
+    BlobStore(const core::Config& cfg, std::string passphrase);
+
+    // Reads `in` to its end, a segment at a time. Throws std::runtime_error
+    // when the blob cannot be sealed or written.
+    BlobRef put(std::istream& in);
+    // Hands the value to `sink` in order: slices of an mmap of the file when
+    // unsealed, otherwise one decrypted segment at a time (wiped after the
+    // call). Stops early when `sink` returns false. False when the blob is
+    // missing, truncated or does not decrypt; `sink` may have seen a prefix.
+    bool stream(const BlobRef& ref, const std::function<bool(std::string_view)>& sink) const;
+    bool read(const BlobRef& ref, std::string& value) const;
+
+    // Every blob in the store
+    std::vector<std::string> ids() const;
+    // Rewrites blob `id` sealed the way this store seals, reading it through
+    // `from` (another passphrase or backend); the id, and so every reference,
+    // stays the same. True when this store already opens it as it would
+    // write it, or once the rewrite verifies; false when neither store opens
+    // it. Throws std::runtime_error when the rewrite cannot be written.
+    bool reseal(const std::string& id, const BlobStore& from);
+
+    // Blobs not in `live` are removed unless written in the last few
+    // minutes (their reference may not be saved yet); returns how many
+    size_t collectGarbage(const std::set<std::string>& live);
+
+    static std::string dir(const core::Config& cfg);
+
+private:
+    struct BlobInfo {
+        bool sealed = false;
+        unsigned long long size = 0;
+    };
+    // Each segment's value in order, with whether it is the last
+    bool readSegments(const std::string& id, BlobInfo& info,
+                      const std::function<bool(std::string_view, bool)>& sink) const;
+    std::string path(const std::string& id) const;
+
+    std::string dir_;
+    std::string passphrase_;
+    bool sealed_ = false;
+};
+
+// Replaces a blob reference in `value` with the blob's contents; any other
+// value is left as it is. False when the blob cannot be read.
+bool resolveBlobValue(const core::Config& cfg, std::string& value);
+
+// Removes blobs that neither the vault nor any profile refers to; nothing
+// is removed when one of them cannot be decrypted. Returns how many.
+size_t collectBlobGarbage(const core::Config& cfg);
+
+} // namespace storage
+} // namespace ak
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "core/config.hpp"
+#include "storage/metadata_cache.hpp"
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace ak {
+namespace storage {
+
+// Names offered by shell tab completion, in persistDir/completion.idx, so a
+// tab press is one small read instead of a vault decryption. Only names are
+// stored, never values. Each context ("keys", "profiles", "services") is a
+// sorted list recorded against the stamp of the file it was taken from:
+// secret names are pushed by the writes that change them, while profile and
+// service names come from plaintext sources and are simply re-read when
+// their stamp moves (see MetadataCache for the racy-window rule).
+class CompletionIndex {
+public:
+    // A missing or damaged file reads as empty
+    explicit CompletionIndex(const core::Config& cfg);
+
+    // Recorded against `source` and not racy
+    bool fresh(const std::string& context, const PathStamp& source) const;
+    // `sourcePath` is the file the names were read from (keys: the vault)
+    void set(const std::string& context, const std::string& sourcePath, std::vector<std::string> names);
+    // Sorted names in `context` starting with `prefix`; empty for unknown
+    // contexts and for a context whose source file has since been removed
+    std::vector<std::string> match(const std::string& context, const std::string& prefix) const;
+
+    // Replaces the file via tmp + rename when something changed. Failures
+    // are ignored; completion falls back to fewer suggestions.
+    void save();
+
+    static std::string path(const core::Config& cfg);
+
+private:
+    struct Section {
+        std::string sourcePath;
+        PathStamp source;
+        long long scannedAt = 0;
+        std::vector<std::string> names;
+    };
+
+    std::string path_;
+    bool changed_ = false;
+    std::map<std::string, Section> sections_;
+};
+
+// Records the vault's key names after a write or a full read of the vault
+void recordVaultNames(const core::Config& cfg, std::vector<std::string> names);
+
+} // namespace storage
+} // namespace ak
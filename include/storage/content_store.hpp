@@ -0,0 +1,72 @@
+#pragma once
+
+#include "core/config.hpp"
+#include "storage/vault.hpp"
+
+#include <cstddef>
+#include <map>
+#include <set>
+#include <string>
+#include <string_view>
+
+namespace ak {
+namespace storage {
+
+// Content-addressed value store (AK_CONTENT_STORE=1, aead and plain
+// backends). Each distinct value is sealed once into
+// profilesDir/objects/<2 hex>/<62 hex>[.akv], named by a SHA-256 of the value
+// under a per-store random salt, and a profile's key file becomes a
+// plaintext manifest (<name>.keys.cas) mapping names to digests. Duplicating
+// a profile copies its manifest, and a value shared by many profiles is
+// stored and decrypted once. Digests reveal which entries share a value,
+// never the value. Objects are immutable: a profile that stops using one
+// leaves it for collectGarbage().
+class ContentStore {
+public:
+    // Objects are sealed under `passphrase` when the active backend is aead
+    ContentStore(const core::Config& cfg, std::string passphrase);
+
+    // Creates the store's salt on first use
+    std::string digest(std::string_view value);
+    // Seals `value` unless an object with its digest exists; returns the
+    // digest. Throws std::runtime_error when it cannot be written, or when
+    // the passphrase does not open the store's existing objects.
+    std::string put(const std::string& value);
+    // False when the object is missing or does not decrypt
+    bool get(const std::string& digest, std::string& value);
+
+    // Objects not in `live` are removed; returns how many
+    size_t collectGarbage(const std::set<std::string>& live);
+    // Number of objects and their total size on disk
+    void stats(size_t& objects, unsigned long long& bytes) const;
+
+    static std::string dir(const core::Config& cfg);
+
+private:
+    std::string objectPath(const std::string& digest) const;
+    void primeKey();
+
+    std::string dir_;
+    std::string passphrase_;
+    std::string salt_;
+    bool sealed_ = false;
+    bool primed_ = false;
+};
+
+// name -> digest
+using Manifest = std::map<std::string, std::string>;
+
+constexpr const char* MANIFEST_SUFFIX = ".cas";
+
+bool contentStoreEnabled(const core::Config& cfg);
+
+// False when the file is missing or not a manifest
+bool readManifest(const std::string& path, Manifest& manifest);
+// Replaces the file via a private tmp + rename; throws std::runtime_error
+void writeManifest(const std::string& path, const Manifest& manifest);
+
+// Every digest referenced by a manifest under profilesDir
+std::set<std::string> liveDigests(const core::Config& cfg);
+
+} // namespace storage
+} // namespace ak
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <istream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace ak {
+namespace storage {
+
+enum class ImportFormat { Env, Json, Yaml };
+
+// "env"/"dotenv", "json", "yaml"/"yml"
+bool parseImportFormat(const std::string& name, ImportFormat& format);
+
+// Incremental parser for `ak import` files. feed() accepts the input in
+// chunks of any size (split anywhere, even inside an escape) and hands each
+// NAME/value pair to the sink as soon as it is complete, so large dumps are
+// never buffered whole. Names that are not valid environment variable
+// names are skipped.
+//
+//   env:  NAME=value, export NAME=value; double-quoted values take the usual
+//         backslash escapes and may span lines, single quotes are literal
+//   json: any nesting; string, number and boolean members are emitted by
+//         their own key, and {"name"|"key": ..., "value": ...} objects as
+//         one pair. NDJSON works too (a sequence of top-level values).
+//   yaml: "key: value" at any indent, quoted scalars, "#" comments and
+//         "|" / ">" block scalars
+//
+// Malformed input throws std::runtime_error naming the line.
+class ImportParser {
+public:
+    using Sink = std::function<void(std::string name, std::string value)>;
+
+    ImportParser(ImportFormat format, Sink sink);
+
+    void feed(std::string_view chunk);
+    // Flushes the last line/value; throws when the input stopped mid-value
+    void finish();
+
+private:
+    enum class JsonState {
+        Value, ValueOrEnd, KeyOrEnd, Key, Colon, CommaOrEnd, String, Escape, Unicode, Literal
+    };
+
+    struct Frame {
+        bool object = false;
+        std::string key;       // member being parsed
+        std::string name;      // "name"/"key" member
+        std::string value;     // "value" member
+        bool hasName = false;
+        bool hasValue = false;
+    };
+
+    void feedLines(std::string_view chunk);
+    void envLine(const std::string& line);
+    void yamlLine(const std::string& line);
+    void flushYamlBlock();
+
+    void jsonChar(char c);
+    void jsonScalar(std::string text);
+    void jsonClose(char c);
+    [[noreturn]] void jsonFail(const std::string& what) const;
+
+    void emit(std::string name, std::string value);
+
+    ImportFormat format_;
+    Sink sink_;
+    size_t line_ = 1;
+    std::string pending_;      // partial line (env, yaml)
+
+    // env: a double-quoted value still open at the end of a line
+    std::string envName_;
+    std::string envValue_;
+    bool envOpen_ = false;
+
+    // yaml: block scalar being collected
+    std::string blockName_;
+    std::vector<std::string> blockLines_;
+    size_t blockIndent_ = 0;   // indent of the key line
+    char blockStyle_ = 0;      // '|' or '>', 0 when none
+    bool blockKeepNewline_ = true;
+
+    // json
+    JsonState state_ = JsonState::Value;
+    std::vector<Frame> stack_;
+    std::string token_;
+    bool tokenIsKey_ = false;
+    unsigned unicodeDigits_ = 0;
+    unsigned unicodeValue_ = 0;
+    unsigned highSurrogate_ = 0;
+};
+
+// Runs `in` through an ImportParser in fixed-size chunks
+void importStream(std::istream& in, ImportFormat format, const ImportParser::Sink& sink);
+
+// True for [A-Za-z_][A-Za-z0-9_]*
+bool isValidKeyName(std::string_view name);
+
+} // namespace storage
+} // namespace ak
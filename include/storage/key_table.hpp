@@ -0,0 +1,92 @@
+#pragma once
+
+#include "crypto/crypto.hpp"
+#include "crypto/secret_arena.hpp"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace ak {
+namespace storage {
+
+// Decoded "NAME=base64" key file, parsed in one pass over the decrypted
+// buffer. Names and values are copied into a single SecretArena (locked,
+// zeroed on destruction) and the input buffer is wiped, so a table costs
+// one arena however many keys it holds. Entries are sorted by name; for
+// repeated names the last line wins, as with the map loaders, and a "-NAME"
+// line drops any earlier NAME (profile log tombstones). Move-only: the views
+// stay valid for the table's lifetime.
+class KeyTable {
+public:
+    struct Entry {
+        std::string_view name;
+        crypto::SecretView value;
+    };
+
+    KeyTable() = default;
+    KeyTable(KeyTable&&) noexcept = default;
+    KeyTable& operator=(KeyTable&&) noexcept = default;
+    KeyTable(const KeyTable&) = delete;
+    KeyTable& operator=(const KeyTable&) = delete;
+
+    static KeyTable parse(std::string data);
+
+    const std::vector<Entry>& entries() const { return entries_; }
+    std::size_t size() const { return entries_.size(); }
+    bool empty() const { return entries_.empty(); }
+    // nullptr when absent
+    const Entry* find(std::string_view name) const;
+    // Zeroes every name and value now, leaving an empty table
+    void wipe();
+
+    // Adapters for the std::map / std::unordered_map based APIs
+    template <typename Map>
+    void copyTo(Map& out) const {
+        for (const auto& entry : entries_) {
+            out.insert_or_assign(out.end(), std::string(entry.name), entry.value.copy());
+        }
+    }
+
+private:
+    std::unique_ptr<crypto::SecretArena> arena_;
+    std::vector<Entry> entries_;
+};
+
+// The same format parsed straight into a map, for loaders whose callers
+// take std::map / std::unordered_map: each value is decoded once, into its
+// own slot, with no table in between. `data` is wiped.
+template <typename Map>
+void parseKeyLines(std::string& data, Map& out) {
+    std::string_view rest(data);
+    while (!rest.empty()) {
+        auto nl = rest.find('\n');
+        std::string_view line = rest.substr(0, nl);
+        rest.remove_prefix(nl == std::string_view::npos ? rest.size() : nl + 1);
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        auto eq = line.find('=');
+        if (eq == std::string_view::npos) {
+            if (line[0] == '-' && line.size() > 1) {
+                auto it = out.find(std::string(line.substr(1)));
+                if (it != out.end()) {
+                    crypto::secureZero(&it->second[0], it->second.size());
+                    out.erase(it);
+                }
+            }
+            continue;
+        }
+        std::string_view encoded = line.substr(eq + 1);
+        std::string& value = out[std::string(line.substr(0, eq))];
+        crypto::secureZero(&value[0], value.size());
+        value.resize(crypto::base64DecodedBound(encoded.size()));
+        value.resize(crypto::base64DecodeInto(encoded, &value[0]));
+    }
+    crypto::secureZero(&data[0], data.size());
+}
+
+} // namespace storage
+} // namespace ak
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "core/config.hpp"
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace ak {
+namespace storage {
+
+// What one stat() says about a path; size is 0 for directories
+struct PathStamp {
+    bool exists = false;
+    long long mtime = 0; // nanoseconds since the epoch
+    unsigned long long size = 0;
+
+    bool operator==(const PathStamp& o) const {
+        return exists == o.exists && mtime == o.mtime && size == o.size;
+    }
+};
+
+PathStamp stampPath(const std::string& path);
+
+struct ProfileSummary {
+    std::string name;
+    size_t keyCount = 0;
+};
+
+// Versioned binary file in configDir/meta.cache holding what most commands
+// need at startup: the profile names and key counts, recorded against the
+// profiles directory's stamp, and the parsed user_services.txt, recorded
+// against that file's stamp. Readers stat the source and take the section
+// when the stamp still matches, instead of listing or parsing it.
+//
+// Profile files are replaced by rename, so any change to a profile list
+// moves the directory's mtime. Sources modified within RACY_WINDOW of the
+// scan that recorded them are never trusted, since a second change in the
+// same timestamp tick would go unnoticed.
+class MetadataCache {
+public:
+    static constexpr long long RACY_WINDOW = 2000000000LL; // ns
+
+    // Maps configDir/meta.cache; a missing, foreign-version or damaged file
+    // reads as empty
+    explicit MetadataCache(const core::Config& cfg);
+
+    bool profiles(const PathStamp& dir, std::vector<ProfileSummary>& out) const;
+    void setProfiles(const PathStamp& dir, std::vector<ProfileSummary> profiles);
+
+    // user_services.txt as rows of fields; the row layout belongs to the caller
+    bool serviceRecords(const PathStamp& file, std::vector<std::vector<std::string>>& out) const;
+    void setServiceRecords(const PathStamp& file, std::vector<std::vector<std::string>> rows);
+
+    // Replaces the file via tmp + rename when a section changed. Failures
+    // are ignored; the cache is only an accelerator.
+    void save();
+
+    static std::string path(const core::Config& cfg);
+
+private:
+    struct Section {
+        bool present = false;
+        PathStamp source;
+        long long scannedAt = 0; // when the source was read, same clock as mtime
+    };
+
+    bool fresh(const Section& section, const PathStamp& now) const;
+    void parse(std::string_view data);
+    std::string serialize() const;
+
+    std::string path_;
+    bool changed_ = false;
+    Section profileSection_;
+    std::vector<ProfileSummary> profiles_;
+    Section serviceSection_;
+    std::vector<std::vector<std::string>> serviceRows_;
+};
+
+} // namespace storage
+} // namespace ak
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <map>
+#include <set>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace ak {
+namespace storage {
+
+// Secondary indexes over one profile's key names: the exact name set, a
+// normalized-name set (upper case, '-' read as '_') for near-duplicate
+// checks, and key -> service / service -> keys, each service resolved once
+// per name. Built from a loaded profile and kept current with add() and
+// remove() as keys change, so validation is a lookup instead of a reload.
+class ProfileIndex {
+public:
+    ProfileIndex() = default;
+    explicit ProfileIndex(const std::map<std::string, std::string>& keys);
+
+    // No-op for names already present
+    void add(const std::string& name);
+    void remove(const std::string& name);
+
+    bool contains(const std::string& name) const;
+    // Another key whose normalized name equals `name`'s, or nullptr
+    const std::string* conflictFor(const std::string& name) const;
+    // getServiceForKeyName() of an indexed key; empty when not indexed
+    const std::string& serviceOf(const std::string& name) const;
+    // Sorted; empty for services with no keys here
+    const std::set<std::string>& keysForService(const std::string& service) const;
+    size_t size() const { return serviceByKey_.size(); }
+
+    static std::string normalize(std::string_view name);
+
+private:
+    std::unordered_map<std::string, std::string> serviceByKey_;
+    std::unordered_map<std::string, std::set<std::string>> keysByService_;
+    std::unordered_map<std::string, std::vector<std::string>> keysByNormalized_;
+};
+
+} // namespace storage
+} // namespace ak
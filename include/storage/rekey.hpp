@@ -0,0 +1,48 @@
+#pragma once
+
+#include "core/config.hpp"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace ak {
+namespace storage {
+
+// Bulk re-encryption (`ak rekey`, `ak migrate`). Everything sealed under
+// one configuration - content store objects, blobs, every profile's key file
+// and the vault - is decrypted, sealed under another (a new passphrase, a
+// new backend or both) and swapped in by rename, across a pool of workers.
+// A swap counts only once the new file decrypts to the same keys. Finished
+// items are appended to persistDir/rekey.journal, so a run that was
+// interrupted or hit errors is started again and picks up where it stopped;
+// the journal is removed when everything is done.
+struct RekeyOptions {
+    size_t jobs = 0;      // workers; 0 for one per CPU
+    bool keepOld = false; // keep other backends' files after a migration
+};
+
+struct RekeyReport {
+    size_t profiles = 0; // profiles with a key file, re-sealed or found done
+    size_t objects = 0;  // content store objects and blobs
+    size_t resumed = 0;  // items an earlier run had finished
+    bool vault = false;
+    std::vector<std::string> failed; // "profile NAME", "blob ID", ...
+
+    bool complete() const { return failed.empty(); }
+};
+
+std::string rekeyJournalPath(const core::Config& cfg);
+// The target backend of an unfinished run; "" when there is none
+std::string pendingRekeyTarget(const core::Config& cfg);
+
+// `to` is `from` with another backend (vaultPath to match) and/or
+// presetPassphrase; both passphrases must be preset. Items that fail keep
+// their old file. The backend setting is switched, old backends' files
+// removed (unless keepOld) and the journal dropped only when nothing
+// failed. Throws std::runtime_error when the journal cannot be written or
+// belongs to a run towards another backend.
+RekeyReport rekeyAll(const core::Config& from, const core::Config& to, const RekeyOptions& options = {});
+
+} // namespace storage
+} // namespace ak
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "core/config.hpp"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace ak {
+namespace storage {
+
+// Where profiles are shared between machines. A remote is a flat namespace
+// of named objects with opaque version tags (ETags); every write but the
+// index is a new, content-addressed object, so the only compare-and-swap is
+// on the index.
+struct RemoteObject {
+    bool found = false;
+    bool notModified = false; // the caller's etag is still current; data is empty
+    std::string etag;
+    std::string data;
+};
+
+class RemoteBackend {
+public:
+    virtual ~RemoteBackend() = default;
+
+    // Conditional when `etag` is set. Throws std::runtime_error on transport
+    // errors.
+    virtual RemoteObject get(const std::string& name, const std::string& etag) = 0;
+    // `ifMatch` nullptr writes unconditionally, "" only when the object does
+    // not exist yet, otherwise only while it still has that etag. False when
+    // the precondition failed; `etag` receives the new tag on success.
+    // Throws std::runtime_error on transport errors.
+    virtual bool put(const std::string& name, const std::string& data, const std::string* ifMatch,
+                     std::string& etag) = 0;
+    virtual std::string describe() const = 0;
+};
+
+// file:///dir or a plain path: a directory, e.g. on a synced or network
+// drive. http(s)://host/prefix: GET and PUT of <prefix>/<name> with
+// If-None-Match / If-Match, authenticated with AK_REMOTE_TOKEN as a bearer
+// token. Throws std::runtime_error for anything else.
+std::unique_ptr<RemoteBackend> openRemote(const std::string& url);
+
+// AK_REMOTE, otherwise configDir/remote; "" when none is configured
+std::string remoteSetting(const core::Config& cfg);
+// An empty url removes the setting
+void writeRemoteSetting(const core::Config& cfg, const std::string& url);
+
+// Sync state (persistDir/sync): the remote index as last seen, with its
+// etag, and per profile the object it matched and the local key file
+// version at the time. Fetched objects are cached there as they are on the
+// remote (sealed), so each value is downloaded once and the last synced
+// copy is the base of a three-way merge when both sides changed a profile.
+enum class SyncMode { Both, Pull, Push, Status };
+
+struct SyncChange {
+    std::string profile;
+    std::string action; // "pulled", "pushed", "merged", "local changes", "remote changes"
+};
+
+struct SyncReport {
+    std::vector<SyncChange> changes;
+    size_t requests = 0;  // round trips to the remote
+    size_t profiles = 0;  // local and remote profiles considered
+};
+
+// Profiles are sealed with the vault passphrase (sealingPassphrase) for the
+// remote whatever the local backend is. Removals are not synced: the remote
+// keeps a profile deleted here, and it comes back once another machine
+// changes it. Throws std::runtime_error when the remote is unreachable, a
+// profile cannot be decrypted, or the index kept changing under us.
+SyncReport syncProfiles(const core::Config& cfg, RemoteBackend& remote, SyncMode mode = SyncMode::Both);
+
+} // namespace storage
+} // namespace ak
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "core/config.hpp"
+#include "storage/metadata_cache.hpp"
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace ak {
+namespace storage {
+
+enum class KeyMatch { Substring, Glob, Regex, Fuzzy };
+
+// Reads the mode from the query text: "/re/" is a regex, "~text" is fuzzy,
+// text with * ? or [ is a glob, anything else a substring. `pattern` gets the
+// query without its markers.
+KeyMatch parseKeyQuery(const std::string& query, std::string& pattern);
+
+struct KeySearchHit {
+    std::string name;
+    std::string service;               // getServiceForKeyName(); empty if none
+    std::vector<std::string> profiles; // sorted
+    long long modified = 0;            // ns since the epoch, latest across profiles
+    double score = 1.0;                // fuzzy: trigram similarity of name or word
+};
+
+// Key name -> profiles, service and last-modified time across every profile,
+// in persistDir/keys.idx. Built from the plaintext .profile lists, so a search
+// never decrypts a value. Profile and key writes patch it as they happen;
+// refresh() re-reads any .profile whose stamp no longer matches what was
+// recorded (changes by older versions, removed profiles), trusting entries
+// only outside MetadataCache::RACY_WINDOW.
+class KeySearchIndex {
+public:
+    // Pg_trgm's default similarity cut-off
+    static constexpr double FUZZY_THRESHOLD = 0.3;
+
+    // A missing or damaged file reads as empty
+    explicit KeySearchIndex(const core::Config& cfg);
+
+    void refresh();
+    // The key list of `profile` as just written; names new to it are stamped now
+    void setProfile(const std::string& profile, const std::vector<std::string>& names);
+    // Marks names whose values changed in `profile`
+    void touch(const std::string& profile, const std::vector<std::string>& names);
+    void removeProfile(const std::string& profile);
+
+    // Case-insensitive; one hit per key name, sorted by name (fuzzy: by score).
+    // A non-empty `profile` limits the search to that profile. Throws
+    // std::runtime_error for an invalid regex.
+    std::vector<KeySearchHit> search(const std::string& pattern, KeyMatch mode,
+                                     const std::string& profile = "") const;
+
+    // Replaces the file via tmp + rename when something changed; failures
+    // are ignored, refresh() rebuilds what is missing
+    void save();
+
+    static std::string path(const core::Config& cfg);
+
+private:
+    struct KeyRecord {
+        long long modified = 0;
+        std::string service;
+    };
+    struct ProfileEntry {
+        PathStamp source; // the .profile file
+        long long scannedAt = 0;
+        std::map<std::string, KeyRecord> keys;
+    };
+
+    void reread(const std::string& profile, ProfileEntry& entry, const PathStamp& source, long long now);
+
+    const core::Config& cfg_;
+    std::string path_;
+    bool changed_ = false;
+    std::map<std::string, ProfileEntry> profiles_;
+};
+
+// Load, patch and save in one step, for storage writes
+void recordProfileNames(const core::Config& cfg, const std::string& profile, const std::vector<std::string>& names);
+void touchProfileNames(const core::Config& cfg, const std::string& profile, const std::vector<std::string>& names);
+
+} // namespace storage
+} // namespace ak
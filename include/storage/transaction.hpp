@@ -0,0 +1,64 @@
+#pragma once
+
+#include "core/config.hpp"
+#include "storage/vault.hpp"
+
+#include <map>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace ak {
+namespace storage {
+
+// A batch of changes to the vault and, optionally, one profile. Everything
+// is loaded (decrypted) once when the transaction begins and written once
+// on commit, instead of one full rewrite per key. Nothing touches disk
+// before commit(); a transaction that is never committed changes nothing.
+// Commit applies only this transaction's changes, so keys another writer
+// committed in the meantime are kept.
+class Transaction {
+public:
+    struct Stats {
+        size_t addedToVault = 0;
+        size_t updatedInVault = 0;
+        size_t removedFromVault = 0;
+        size_t addedToProfile = 0;
+    };
+
+    // Empty `profile`: vault only
+    explicit Transaction(const core::Config& cfg, std::string profile = "");
+
+    void put(const std::string& name, const std::string& value);
+    // Removes from the vault and the profile; false when the name was unknown
+    bool remove(const std::string& name);
+
+    // Writes each store that changed (once each), then bumps the generation.
+    // Throws std::logic_error when committed twice.
+    void commit();
+
+    const std::string& profile() const { return profile_; }
+    const Stats& stats() const { return stats_; }
+    // Names put or removed, in call order (for the audit log)
+    const std::vector<std::string>& touched() const { return touched_; }
+    bool empty() const { return touched_.empty(); }
+
+private:
+    const core::Config& cfg_;
+    std::string profile_;
+    core::KeyStore vault_;
+    std::vector<std::string> profileList_;
+    std::vector<std::string> profileListBase_;
+    std::unordered_set<std::string> listed_; // profileList_ as a set, for large imports
+    std::map<std::string, std::string> profileKeys_;
+    ProfileKeysPtr profileKeysBase_;
+    std::vector<std::string> touched_;
+    Stats stats_;
+    bool vaultChanged_ = false;
+    bool listChanged_ = false;
+    bool keysChanged_ = false;
+    bool committed_ = false;
+};
+
+} // namespace storage
+} // namespace ak
@@ -1,35 +1,165 @@
 #pragma once
 
 #include "core/config.hpp"
+#include "storage/key_table.hpp"
+#include "storage/metadata_cache.hpp"
+#include "storage/profile_index.hpp"
 #include <string>
 #include <vector>
 #include <filesystem>
 #include <map>
+#include <memory>
 
 namespace ak {
 namespace storage {
 
+// Storage backends. The active one decides the format new files are written
+// in; existing files are always read according to their extension
+// (.gpg = gpg subprocess, .akv = in-process AEAD, none = plain).
+enum class Backend { Plain, Gpg, Aead };
+Backend activeBackend(const core::Config& cfg);
+const char* backendName(Backend backend);
+bool parseBackend(const std::string& name, Backend& backend);
+bool backendSupported(const core::Config& cfg, Backend backend);
+std::string readBackendSetting(const core::Config& cfg);   // configDir/backend
+void writeBackendSetting(const core::Config& cfg, Backend backend);
+std::string vaultPathFor(const core::Config& cfg, Backend backend);
+
+// The configuration ak and libak start from: configDir (default
+// $XDG_CONFIG_HOME/ak, created if missing), the AK_* environment overrides and
+// the backend setting. The gpg probe, vault path and instance id are resolved
+// on first use.
+core::Config loadConfig(const std::string& configDir = "");
+
 // Vault operations (legacy - for migration)
 core::KeyStore loadVault(const core::Config& cfg);
+bool tryLoadVault(const core::Config& cfg, core::KeyStore& ks);  // false if it can't be decrypted
+// Flat-table variants for listing large vaults without building a map
+KeyTable loadVaultTable(const core::Config& cfg);
+bool tryLoadVaultTable(const core::Config& cfg, KeyTable& table);
+// Writers never clobber each other. Each save holds a lock on the config dir
+// only while it writes; when the vault was replaced after `ks` was loaded
+// (see KeyStore::baseVersion), the current vault is re-read and only the
+// keys `ks` set or dropped are applied to it. Throws std::runtime_error
+// when that re-read fails.
 void saveVault(const core::Config& cfg, const core::KeyStore& ks);
 
 // Profile-specific vault operations
 std::map<std::string, std::string> loadProfileKeys(const core::Config& cfg, const std::string& profileName);
-void saveProfileKeys(const core::Config& cfg, const std::string& profileName, const std::map<std::string, std::string>& keys);
+bool tryLoadProfileKeys(const core::Config& cfg, const std::string& profileName, std::map<std::string, std::string>& keys);
+// Same files as a flat KeyTable, without building a map (large profiles)
+bool tryLoadProfileKeyTable(const core::Config& cfg, const std::string& profileName, KeyTable& table);
+using ProfileKeysPtr = std::shared_ptr<const std::map<std::string, std::string>>;
+// Holds the profile's lock (profilesDir/.<name>.lock) while it writes, so
+// writers of other profiles never wait. `base` is the copy from
+// loadProfileKeysCached that `keys` was edited from: when the profile has
+// been written since, only the difference between the two is applied to
+// what is current (optimistic compare-and-swap with a merge instead of a
+// retry). Without a base `keys` replaces the profile.
+void saveProfileKeys(const core::Config& cfg, const std::string& profileName,
+                     const std::map<std::string, std::string>& keys, const ProfileKeysPtr& base = nullptr);
+// The merge saveProfileKeys uses: the edits that turn `base` into `mine`
+// (keys set, changed or dropped) are applied to `current`
+void mergeKeyChanges(const std::map<std::string, std::string>& base, const std::map<std::string, std::string>& mine,
+                     std::map<std::string, std::string>& current);
+// Changes whenever the profile's key file (or its record log) is replaced
+// or appended to; "" when it has none
+std::string profileKeysVersion(const core::Config& cfg, const std::string& profileName);
+// AK_PASSPHRASE, otherwise asked for once per process on a terminal; ""
+// when neither is available
+std::string sealingPassphrase(const core::Config& cfg);
+
+// Profile record log (AK_PROFILE_LOG=1, aead and plain backends). Changes are
+// appended to <keys file>.log as individually sealed records instead of
+// rewriting the whole key file; loads replay the log over that file, and the
+// log is folded back into it once it outgrows the live data.
+bool profileLogEnabled(const core::Config& cfg);
+void setProfileKey(const core::Config& cfg, const std::string& profileName,
+                   const std::string& name, const std::string& value);
+void removeProfileKey(const core::Config& cfg, const std::string& profileName, const std::string& name);
+// Rewrites the key file with the log applied and drops the log; false when
+// the profile had no log
+bool compactProfileKeys(const core::Config& cfg, const std::string& profileName);
+
+// Content store (AK_CONTENT_STORE=1, see storage/content_store.hpp).
+// duplicateProfileKeys gives `to` the keys of `from`: a copied manifest when
+// both are content-addressed, otherwise a decrypt and rewrite. False when
+// `from` has no key file.
+bool duplicateProfileKeys(const core::Config& cfg, const std::string& from, const std::string& to);
+// Points every manifest entry holding `oldValue` at `newValue`; returns the
+// number of profiles changed (their names go to `changedProfiles`)
+size_t rotateSharedValue(const core::Config& cfg, const std::string& oldValue, const std::string& newValue,
+                         std::vector<std::string>* changedProfiles = nullptr);
+// Removes objects no manifest refers to; returns how many
+size_t collectContentGarbage(const core::Config& cfg);
+
+// Shared decrypted-profile cache. Thread-safe; each profile is decrypted at most
+// once per process until its key file (or the passphrase) changes.
+ProfileKeysPtr loadProfileKeysCached(const core::Config& cfg, const std::string& profileName);
+// Same, but false when the key file exists and could not be decrypted (the
+// keys are then empty); the failure stays cached like any other result
+bool tryLoadProfileKeysCached(const core::Config& cfg, const std::string& profileName, ProfileKeysPtr& keys);
+// Index over the cached keys, built once per cached copy and patched in
+// place of a rebuild when this process changes the profile
+using ProfileIndexPtr = std::shared_ptr<const ProfileIndex>;
+ProfileIndexPtr loadProfileIndexCached(const core::Config& cfg, const std::string& profileName);
+void invalidateProfileKeysCache(const core::Config& cfg, const std::string& profileName);
+void clearProfileKeysCache();
 
 // Profile operations
 std::filesystem::path profilePath(const core::Config& cfg, const std::string& name);
 std::filesystem::path profileKeysPath(const core::Config& cfg, const std::string& name);
+std::filesystem::path profileKeysPathFor(const core::Config& cfg, const std::string& name, Backend backend);
+// Sorted; served from MetadataCache while the profiles directory is unchanged
 std::vector<std::string> listProfiles(const core::Config& cfg);
+std::vector<ProfileSummary> listProfileSummaries(const core::Config& cfg);
 std::vector<std::string> readProfile(const core::Config& cfg, const std::string& name);
-void writeProfile(const core::Config& cfg, const std::string& name, const std::vector<std::string>& keys);
+// With `base` (the list `keys` was edited from), names other writers added
+// or removed since are kept as they are
+void writeProfile(const core::Config& cfg, const std::string& name, const std::vector<std::string>& keys,
+                  const std::vector<std::string>* base = nullptr);
 std::map<std::string, std::string> readProfileKeys(const core::Config& cfg, const std::string& name);
 void writeProfileKeys(const core::Config& cfg, const std::string& name, const std::map<std::string, std::string>& keys);
 
-// Persistence operations
-std::string mappingFileForDir(const core::Config& cfg, const std::string& dir);
+// Persistence operations. Persisted directories live in one sorted index,
+// persist/dirs ("<dir>\t<profile>\t..." per line). A lookup resolves to the
+// nearest persisted ancestor, so subdirectories inherit their parent's
+// profiles. Older per-directory persist/<dirKey>.mapping files are folded
+// into the index the first time their directory is looked up or written.
+struct DirMapping {
+    std::string dir; // empty for a not yet migrated .mapping file
+    std::string key; // dirKey(dir); names the directory's bundle files
+    std::vector<std::string> profiles;
+};
+
+std::string dirKey(const std::string& dir);
+std::string mappingFileForDir(const core::Config& cfg, const std::string& dir); // legacy
+std::string dirIndexFile(const core::Config& cfg);
+bool findDirMapping(const core::Config& cfg, const std::string& dir, DirMapping& out);
+// Exact directory only, no inheritance
 std::vector<std::string> readDirProfiles(const core::Config& cfg, const std::string& dir);
+std::vector<std::string> readDirProfilesByKey(const core::Config& cfg, const std::string& key);
+// An empty list removes the directory
 void writeDirProfiles(const core::Config& cfg, const std::string& dir, const std::vector<std::string>& profiles);
+std::vector<DirMapping> listDirMappings(const core::Config& cfg);
+std::vector<std::string> listPersistedDirKeys(const core::Config& cfg);
+
+// Generation stamp in persist/generation, replaced by every vault, profile
+// and mapping write. Shell hooks compare it (without running ak) to know
+// whether anything could have changed since they last loaded.
+std::string generationFile(const core::Config& cfg);
+std::string readGeneration(const core::Config& cfg);
+void bumpGeneration(const core::Config& cfg);
+
+// Directory bundles: merged exports for every profile persisted in one
+// directory, sealed with the active backend and stamped with the generation
+// they were built from. readDirBundle refuses stale or missing bundles.
+bool canSealWithoutPrompt(const core::Config& cfg);
+void writeDirBundle(const core::Config& cfg, const std::string& key, const std::string& generation,
+                    const std::string& exports);
+bool readDirBundle(const core::Config& cfg, const std::string& key, const std::string& generation,
+                   std::string& exports);
+void removeDirBundle(const core::Config& cfg, const std::string& key);
 
 // Bundle operations
 std::string bundleFile(const core::Config& cfg, const std::string& profile);
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ak {
+namespace system {
+
+// Child processes for `ak run`. Environments are passed as "NAME=VALUE"
+// strings straight to the OS, with no shell and no quoting in between.
+
+// Current environment with each override applied (later duplicates win);
+// replaced variables keep their position, new ones go at the end
+std::vector<std::string> mergeEnvironment(const std::vector<std::pair<std::string, std::string>>& overrides);
+
+// `program` resolved against PATH the way execvp would; "" when nothing
+// executable matches. Names containing a slash are taken as they are.
+std::string findExecutable(const std::string& program);
+
+struct ChildProcess {
+    long pid = -1;          // POSIX
+    void* handle = nullptr; // Windows process handle
+};
+
+bool spawnProcess(const std::vector<std::string>& argv, const std::vector<std::string>& env, ChildProcess& child);
+// Waits up to timeoutMs (< 0: no limit). True once the child has exited,
+// with its status in exitCode (128 + signal number when it was killed).
+bool waitProcess(ChildProcess& child, int timeoutMs, int& exitCode);
+// Asks the child to stop (SIGTERM), kills it after graceMs, and reaps it
+void stopProcess(ChildProcess& child, int graceMs);
+
+// A program run for its output (no shell): stdout and stderr in one buffer,
+// stdin from /dev/null
+struct CaptureResult {
+    bool started = false;   // false when argv[0] is not found or cannot run
+    bool timedOut = false;
+    bool cancelled = false;
+    int exitCode = -1;      // as waitProcess reports it; -1 when stopped early
+    std::string output;     // capped at 1 MiB
+};
+
+// The child is stopped (stopProcess) once `timeoutMs` has passed (< 0: no
+// limit) or `cancel` is set, so a hung tool never outlives its caller's
+// patience
+CaptureResult captureProcess(const std::vector<std::string>& argv, int timeoutMs,
+                             const std::atomic<bool>* cancel = nullptr);
+
+// Replaces this process with argv[0] running under `env` (execve). Returns
+// only on failure: 127 when the program is not found, 126 when it cannot be
+// executed. Windows has no exec, so there the child runs to completion and
+// its status is returned.
+int execProcess(const std::vector<std::string>& argv, const std::vector<std::string>& env);
+
+} // namespace system
+} // namespace ak
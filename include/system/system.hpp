@@ -3,6 +3,7 @@
 #include "core/config.hpp"
 #include <string>
 #include <filesystem>
+#include <map>
 
 namespace ak {
 namespace system {
@@ -33,6 +34,35 @@ std::string getCwd();
 bool fileContains(const std::string& path, const std::string& needle);
 void appendLine(const std::string& path, const std::string& line);
 
+// "<path>.<pid>.<n>.tmp", distinct for every call in every process, for
+// writers that replace `path` by rename
+std::string uniqueTmpPath(const std::string& path);
+// Unique tmp, fsync, rename; readable only by the owner. Throws
+// std::runtime_error.
+void writeFileAtomic(const std::filesystem::path& path, const std::string& data);
+
+// Exclusive advisory lock on `path` (created 0600 when missing) for the life
+// of the object: flock on Unix, LockFileEx on Windows. Two objects exclude
+// each other even within one process. Blocks until the lock is granted.
+class FileLock {
+public:
+    explicit FileLock(const std::filesystem::path& path);
+    ~FileLock();
+    FileLock(const FileLock&) = delete;
+    FileLock& operator=(const FileLock&) = delete;
+
+    // False when the lock file could not be opened; the caller runs unlocked
+    bool held() const { return held_; }
+
+private:
+#ifdef _WIN32
+    void* handle_ = nullptr;
+#else
+    int fd_ = -1;
+#endif
+    bool held_ = false;
+};
+
 // User information
 struct TargetUser {
     std::string userName;
@@ -46,6 +76,32 @@ TargetUser resolveTargetUser();
 void writeShellInitFile(const core::Config& cfg);
 void ensureSourcedInRc(const core::Config& cfg);
 
+// Prompt hook (ak hook-env). AK_HOOK_STATE carries which directory mapping
+// and generation were last applied, plus a short HMAC of each exported
+// value, so the next prompt prints only what changed. The HMAC key is a
+// per-install secret in the config dir and never leaves it.
+enum class Shell { Bash, Zsh, Fish };
+bool parseShell(const std::string& name, Shell& shell);
+std::string shellExport(Shell shell, const std::string& name, const std::string& value);
+std::string shellUnset(Shell shell, const std::string& name);
+
+struct HookState {
+    std::string dirKey;       // "" when the directory has nothing persisted
+    std::string generation;
+    bool loadAll = false;
+    std::map<std::string, std::string> exported; // name -> hookValueHash(key, value)
+};
+// Reads <configDir>/hook.key, creating it (0600) on first use; a key that
+// cannot be persisted lasts for this process only
+std::string hookStateKey(const core::Config& cfg);
+std::string hookValueHash(const std::string& key, const std::string& value);
+std::string encodeHookState(const HookState& state);
+bool decodeHookState(const std::string& token, HookState& state);
+// Unsets, exports and the new AK_HOOK_STATE taking the shell from `previous`
+// to `next`; `values` holds the plaintext for next.exported
+std::string hookDelta(Shell shell, const HookState& previous, const HookState& next,
+                      const std::map<std::string, std::string>& values);
+
 // Guard functions
 void guard_enable(const core::Config& cfg);
 void guard_disable();
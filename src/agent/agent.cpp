@@ -0,0 +1,441 @@
+#include "agent/agent.hpp"
+#include "crypto/aead.hpp"
+#include "crypto/crypto.hpp"
+#include "storage/vault.hpp"
+#include "storage/remote.hpp"
+#include "system/system.hpp"
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <filesystem>
+#include <future>
+#include <iostream>
+#include <sstream>
+#include <string_view>
+
+#ifdef __unix__
+#include <poll.h>
+#include <sys/resource.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
+#endif
+
+namespace ak {
+namespace agent {
+
+namespace fs = std::filesystem;
+
+std::string socketPath(const core::Config& cfg) {
+    if (cfg.instanceId.get().empty()) {
+        return "";
+    }
+    std::string runtimeDir = core::getenvs("XDG_RUNTIME_DIR");
+    std::error_code ec;
+    if (!runtimeDir.empty() && fs::is_directory(runtimeDir, ec)) {
+        return runtimeDir + "/ak-" + cfg.instanceId.get() + ".sock";
+    }
+    return cfg.persistDir + "/agent-" + cfg.instanceId.get() + ".sock";
+}
+
+#ifdef __unix__
+
+namespace {
+
+constexpr size_t MAX_REQUEST = 4096;
+volatile std::sig_atomic_t stopRequested = 0;
+
+void onTerminate(int) {
+    stopRequested = 1;
+}
+
+bool fillSockaddr(const std::string& path, sockaddr_un& addr) {
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+        return false;
+    }
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+// Only talk to processes running as our own user
+bool peerIsSelf(int fd) {
+#if defined(__linux__)
+    struct ucred cred;
+    socklen_t len = sizeof(cred);
+    if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) != 0) {
+        return false;
+    }
+    return cred.uid == ::getuid();
+#else
+    uid_t uid;
+    gid_t gid;
+    if (getpeereid(fd, &uid, &gid) != 0) {
+        return false;
+    }
+    return uid == ::getuid();
+#endif
+}
+
+void setTimeouts(int fd, int millis) {
+    timeval tv;
+    tv.tv_sec = millis / 1000;
+    tv.tv_usec = (millis % 1000) * 1000;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+}
+
+bool writeAll(int fd, const std::string& data) {
+    const char* p = data.data();
+    size_t left = data.size();
+    while (left > 0) {
+        ssize_t n = ::send(fd, p, left, MSG_NOSIGNAL);
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        left -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+std::string readAll(int fd, size_t limit) {
+    std::string out;
+    char buf[4096];
+    while (out.size() < limit) {
+        ssize_t n = ::recv(fd, buf, sizeof(buf), 0);
+        if (n <= 0) {
+            break;
+        }
+        out.append(buf, static_cast<size_t>(n));
+    }
+    return out;
+}
+
+std::string readLine(int fd) {
+    std::string line;
+    char c;
+    while (line.size() < MAX_REQUEST && ::recv(fd, &c, 1, 0) == 1) {
+        if (c == '\n') {
+            break;
+        }
+        line.push_back(c);
+    }
+    return line;
+}
+
+// One request/response round trip; false when no agent answers
+bool request(const core::Config& cfg, const std::string& line, std::string& body) {
+    if (getenv("AK_NO_AGENT")) {
+        return false;
+    }
+    std::string path = socketPath(cfg);
+    sockaddr_un addr;
+    struct stat st;
+    if (!fillSockaddr(path, addr) || ::stat(path.c_str(), &st) != 0 || !S_ISSOCK(st.st_mode) ||
+        st.st_uid != ::getuid()) {
+        return false;
+    }
+
+    int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return false;
+    }
+    setTimeouts(fd, 2000);
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || !peerIsSelf(fd) ||
+        !writeAll(fd, line + "\n")) {
+        ::close(fd);
+        return false;
+    }
+    ::shutdown(fd, SHUT_WR);
+    std::string reply = readAll(fd, 64 * 1024 * 1024);
+    ::close(fd);
+
+    auto nl = reply.find('\n');
+    std::string head = reply.substr(0, nl);
+    if (head.rfind("OK", 0) != 0) {
+        return false;
+    }
+    body = head.size() > 3 ? head.substr(3) + "\n" : "";
+    if (nl != std::string::npos) {
+        body += reply.substr(nl + 1);
+    }
+    return true;
+}
+
+template <typename Map>
+void parseKeyLines(const std::string& body, Map& out) {
+    std::string_view rest(body);
+    while (!rest.empty()) {
+        auto nl = rest.find('\n');
+        std::string_view line = rest.substr(0, nl);
+        rest.remove_prefix(nl == std::string_view::npos ? rest.size() : nl + 1);
+        auto eq = line.find('=');
+        if (line.empty() || eq == std::string_view::npos) {
+            continue;
+        }
+        out[std::string(line.substr(0, eq))] = crypto::base64Decode(line.substr(eq + 1));
+    }
+}
+
+template <typename Map>
+std::string formatKeyLines(const Map& kv) {
+    std::string out = "OK\n";
+    for (const auto& [name, value] : kv) {
+        out += name + "=" + crypto::base64Encode(value) + "\n";
+    }
+    return out;
+}
+
+bool validProfileName(const std::string& name) {
+    return !name.empty() && name.find('/') == std::string::npos && name.find("..") == std::string::npos &&
+           name.find('\0') == std::string::npos;
+}
+
+// Harden the daemon: no core dumps, no ptrace by other same-uid processes,
+// and keep pages out of swap when the memlock limit allows it.
+bool hardenProcess() {
+    rlimit noCore{0, 0};
+    setrlimit(RLIMIT_CORE, &noCore);
+#ifdef __linux__
+    prctl(PR_SET_DUMPABLE, 0, 0, 0, 0);
+#endif
+    rlimit memlock;
+    if (getrlimit(RLIMIT_MEMLOCK, &memlock) == 0 &&
+        (memlock.rlim_cur == RLIM_INFINITY || memlock.rlim_cur >= (256u << 20))) {
+        return mlockall(MCL_CURRENT | MCL_FUTURE) == 0;
+    }
+    return false;
+}
+
+struct VaultCache {
+    long long mtime = -1;
+    long long size = -1;
+    std::string path;
+    core::KeyStore ks;
+};
+
+} // namespace
+
+int serve(const core::Config& cfg, int ttlSeconds) {
+    std::string path = socketPath(cfg);
+    sockaddr_un addr;
+    if (!fillSockaddr(path, addr)) {
+        std::cerr << "❌ Agent socket path unavailable: " << path << "\n";
+        return 1;
+    }
+    if (ping(cfg)) {
+        std::cerr << "❌ An agent is already running on " << path << "\n";
+        return 1;
+    }
+
+    stopRequested = 0;
+    bool locked = hardenProcess();
+    std::signal(SIGTERM, onTerminate);
+    std::signal(SIGINT, onTerminate);
+    std::signal(SIGPIPE, SIG_IGN);
+
+    system::ensureSecureDir(fs::path(path).parent_path());
+    ::unlink(path.c_str());  // stale socket from a crashed agent; ping() failed above
+    int listenFd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    mode_t oldMask = ::umask(0077);
+    bool bound = listenFd >= 0 && ::bind(listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0;
+    ::umask(oldMask);
+    if (!bound || ::chmod(path.c_str(), 0600) != 0 || ::listen(listenFd, 16) != 0) {
+        std::cerr << "❌ Failed to listen on " << path << ": " << std::strerror(errno) << "\n";
+        if (listenFd >= 0) {
+            ::close(listenFd);
+        }
+        return 1;
+    }
+
+    using clock = std::chrono::steady_clock;
+    auto lastUse = clock::now();
+    auto started = clock::now();
+    VaultCache vault;
+
+    auto vaultKeys = [&]() -> const core::KeyStore* {
+        std::error_code ec;
+        std::string vpath = cfg.vaultPath;
+        auto size = fs::file_size(vpath, ec);
+        if (ec) {
+            vault = VaultCache{};
+            return &vault.ks;
+        }
+        auto mtime = static_cast<long long>(fs::last_write_time(vpath, ec).time_since_epoch().count());
+        if (vault.path != vpath || vault.mtime != mtime || vault.size != static_cast<long long>(size)) {
+            core::KeyStore ks;
+            if (!storage::tryLoadVault(cfg, ks)) {
+                return nullptr;
+            }
+            vault.ks = std::move(ks);
+            vault.path = vpath;
+            vault.mtime = mtime;
+            vault.size = static_cast<long long>(size);
+        }
+        return &vault.ks;
+    };
+
+    // Background pulls never prompt: only with a preset passphrase
+    std::string remoteUrl = cfg.presetPassphrase.empty() ? "" : storage::remoteSetting(cfg);
+    long long syncIntervalMs = 0;
+    try {
+        syncIntervalMs = std::stoll(core::getenvs("AK_SYNC_INTERVAL",
+                                                  std::to_string(DEFAULT_SYNC_INTERVAL_SECONDS))) * 1000;
+    } catch (const std::exception&) {
+        syncIntervalMs = DEFAULT_SYNC_INTERVAL_SECONDS * 1000LL;
+    }
+    std::future<void> syncing;
+    auto nextSync = clock::now();
+
+    while (!stopRequested) {
+        long long untilSync = 60000;
+        if (!remoteUrl.empty() && syncIntervalMs > 0) {
+            bool busy = syncing.valid() &&
+                        syncing.wait_for(std::chrono::seconds(0)) != std::future_status::ready;
+            if (clock::now() >= nextSync && !busy) {
+                // A run still going when the next is due is not doubled up
+                syncing = std::async(std::launch::async, [cfg, remoteUrl] {
+                    try {
+                        auto remote = storage::openRemote(remoteUrl);
+                        storage::syncProfiles(cfg, *remote, storage::SyncMode::Pull);
+                    } catch (const std::exception&) {
+                        // Offline or unreachable: the local files are still current enough
+                    }
+                });
+                nextSync = clock::now() + std::chrono::milliseconds(syncIntervalMs);
+            }
+            untilSync = std::max<long long>(
+                1000, std::chrono::duration_cast<std::chrono::milliseconds>(nextSync - clock::now()).count());
+        }
+        auto idle = std::chrono::duration_cast<std::chrono::milliseconds>(clock::now() - lastUse).count();
+        long long remaining = static_cast<long long>(ttlSeconds) * 1000 - idle;
+        if (ttlSeconds > 0 && remaining <= 0) {
+            break;
+        }
+        long long wait = std::min<long long>(60000, untilSync);
+        pollfd pfd{listenFd, POLLIN, 0};
+        int rc = ::poll(&pfd, 1, static_cast<int>(ttlSeconds > 0 ? std::min<long long>(remaining, wait) : wait));
+        if (rc <= 0) {
+            continue;  // timeout or EINTR; loop re-checks TTL and stop flag
+        }
+
+        int fd = ::accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0) {
+            continue;
+        }
+        setTimeouts(fd, 2000);
+        if (!peerIsSelf(fd)) {
+            ::close(fd);
+            continue;
+        }
+
+        std::string line = readLine(fd);
+        std::string verb = line.substr(0, line.find(' '));
+        std::string arg = line.size() > verb.size() ? line.substr(verb.size() + 1) : "";
+        std::string reply;
+
+        if (verb == "PING") {
+            reply = "OK\n";
+        } else if (verb == "STATUS") {
+            auto up = std::chrono::duration_cast<std::chrono::seconds>(clock::now() - started).count();
+            reply = "OK pid=" + std::to_string(::getpid()) + " ttl=" + std::to_string(ttlSeconds) +
+                    " uptime=" + std::to_string(up) + " locked=" + (locked ? "yes" : "no") + "\n";
+        } else if (verb == "STOP") {
+            reply = "OK\n";
+            stopRequested = 1;
+        } else if (verb == "KEYS" && validProfileName(arg)) {
+            try {
+                // A profile this passphrase cannot open is an error, so the
+                // client decrypts it itself instead of loading nothing
+                storage::ProfileKeysPtr cached;
+                reply = storage::tryLoadProfileKeysCached(cfg, arg, cached) ? formatKeyLines(*cached)
+                                                                             : "ERR cannot decrypt profile\n";
+            } catch (const std::exception& e) {
+                reply = std::string("ERR ") + e.what() + "\n";
+            }
+        } else if (verb == "VAULT") {
+            const core::KeyStore* ks = vaultKeys();
+            reply = ks ? formatKeyLines(ks->kv) : "ERR cannot decrypt vault\n";
+        } else {
+            reply = "ERR unknown request\n";
+        }
+
+        writeAll(fd, reply);
+        std::fill(reply.begin(), reply.end(), '\0');
+        ::close(fd);
+        lastUse = clock::now();
+    }
+
+    ::close(listenFd);
+    ::unlink(path.c_str());
+    if (syncing.valid()) {
+        syncing.wait();
+    }
+    storage::clearProfileKeysCache();
+    crypto::aeadClearKeyCache();
+    return 0;
+}
+
+bool ping(const core::Config& cfg) {
+    std::string body;
+    return request(cfg, "PING", body);
+}
+
+bool status(const core::Config& cfg, std::string& info) {
+    if (!request(cfg, "STATUS", info)) {
+        return false;
+    }
+    info = core::trim(info);
+    return true;
+}
+
+bool stop(const core::Config& cfg) {
+    std::string body;
+    return request(cfg, "STOP", body);
+}
+
+bool fetchProfileKeys(const core::Config& cfg, const std::string& profile, std::map<std::string, std::string>& keys) {
+    std::string body;
+    if (!validProfileName(profile) || !request(cfg, "KEYS " + profile, body)) {
+        return false;
+    }
+    parseKeyLines(body, keys);
+    return true;
+}
+
+bool fetchVault(const core::Config& cfg, core::KeyStore& ks) {
+    std::string body;
+    if (!request(cfg, "VAULT", body)) {
+        return false;
+    }
+    parseKeyLines(body, ks.kv);
+    return true;
+}
+
+#else // !__unix__
+
+int serve(const core::Config& cfg, int ttlSeconds) {
+    (void)cfg;
+    (void)ttlSeconds;
+    std::cerr << "❌ The key agent is only supported on Unix-like systems\n";
+    return 1;
+}
+
+bool ping(const core::Config&) { return false; }
+bool status(const core::Config&, std::string&) { return false; }
+bool stop(const core::Config&) { return false; }
+bool fetchProfileKeys(const core::Config&, const std::string&, std::map<std::string, std::string>&) { return false; }
+bool fetchVault(const core::Config&, core::KeyStore&) { return false; }
+
+#endif
+
+} // namespace agent
+} // namespace ak
@@ -10,37 +10,39 @@ namespace ak {
 namespace cli {
 
 // Flag expansion
+void appendExpandedFlag(std::string_view arg, std::vector<std::string>& out) {
+    if (arg.size() < 2 || arg[0] != '-' || arg[1] == '-') {
+        out.emplace_back(arg);
+        return;
+    }
+    // Short flag like -pf becomes --profile --format
+    for (size_t i = 1; i < arg.size(); ++i) {
+        char c = arg[i];
+        if (c == 'p') {
+            out.push_back("--profile");
+        } else if (c == 'f') {
+            out.push_back("--format");
+        } else if (c == 'o') {
+            out.push_back("--output");
+        } else if (c == 'i') {
+            out.push_back("--file");
+        } else if (c == 'h') {
+            out.push_back("--help");
+        } else if (c == 'v') {
+            out.push_back("--version");
+        } else {
+            // Unknown short flag, keep as is
+            out.push_back(std::string("-") + c);
+        }
+    }
+}
+
 std::vector<std::string> expandShortFlags(const std::vector<std::string>& args) {
     std::vector<std::string> expanded;
     expanded.reserve(args.size() * 2); // Reserve extra space for expanded flags
-    
     for (const auto& arg : args) {
-        if (arg.size() >= 2 && arg[0] == '-' && arg[1] != '-') {
-            // Short flag like -pf becomes --profile --format
-            for (size_t i = 1; i < arg.size(); ++i) {
-                char c = arg[i];
-                if (c == 'p') {
-                    expanded.push_back("--profile");
-                } else if (c == 'f') {
-                    expanded.push_back("--format");
-                } else if (c == 'o') {
-                    expanded.push_back("--output");
-                } else if (c == 'i') {
-                    expanded.push_back("--file");
-                } else if (c == 'h') {
-                    expanded.push_back("--help");
-                } else if (c == 'v') {
-                    expanded.push_back("--version");
-                } else {
-                    // Unknown short flag, keep as is
-                    expanded.push_back(std::string("-") + c);
-                }
-            }
-        } else {
-            expanded.push_back(arg);
-        }
+        appendExpandedFlag(arg, expanded);
     }
-    
     return expanded;
 }
 
@@ -89,7 +91,9 @@ void cmd_help() {
     std::cout << "  " << ui::colorize("ak secret add <NAME> <VALUE>", ui::Colors::BRIGHT_CYAN) << "       Add a secret with value directly\n";
     std::cout << "  " << ui::colorize("ak secret add <NAME=VALUE>", ui::Colors::BRIGHT_CYAN) << "         Add a secret using NAME=VALUE format\n";
     std::cout << "  " << ui::colorize("ak secret set <NAME>", ui::Colors::BRIGHT_CYAN) << "               Set a secret (prompts for value)\n";
-    std::cout << "  " << ui::colorize("ak secret get <NAME> [--full|--reveal]", ui::Colors::BRIGHT_CYAN) << " Get a secret value\n";
+    std::cout << "  " << ui::colorize("ak secret set <NAME> --from-file <file>", ui::Colors::BRIGHT_CYAN) << " Store a large value as a blob\n";
+    std::cout << "  " << ui::colorize("ak secret set --batch [-p <profile>]", ui::Colors::BRIGHT_CYAN) << " Apply NAME=VALUE lines from stdin at once\n";
+    std::cout << "  " << ui::colorize("ak secret get <NAME> [--full|--reveal] [--to-file [<file>]]", ui::Colors::BRIGHT_CYAN) << " Get a secret value\n";
     std::cout << "  " << ui::colorize("ak secret ls [--json|--quiet]", ui::Colors::BRIGHT_CYAN) << "       List all secret names\n";
     std::cout << "  " << ui::colorize("ak secret rm <NAME>", ui::Colors::BRIGHT_CYAN) << "                Remove a secret\n";
     std::cout << "  " << ui::colorize("ak secret search <PATTERN>", ui::Colors::BRIGHT_CYAN) << "         Search for secrets by name pattern\n";
@@ -112,26 +116,34 @@ void cmd_help() {
 
     std::cout << ui::colorize("IMPORT/EXPORT:", ui::Colors::BRIGHT_MAGENTA + ui::Colors::BOLD) << "\n";
     std::cout << "  " << ui::colorize("ak export -p <profile> -f <format> -o <file>", ui::Colors::BRIGHT_CYAN) << " Export profile to file\n";
+    std::cout << "                                        " << ui::colorize("Also k8s, k8s-json, docker, systemd, github", ui::Colors::DIM) << "\n";
     std::cout << "  " << ui::colorize("ak import -p <profile> -f <format> -i <file>", ui::Colors::BRIGHT_CYAN) << " Import secrets from file\n";
     std::cout << "                                        " << ui::colorize("Formats: env, dotenv, json, yaml", ui::Colors::DIM) << "\n";
     std::cout << "                                        " << ui::colorize("Use --keys to import known service keys only", ui::Colors::DIM) << "\n\n";
 
     std::cout << ui::colorize("UTILITIES:", ui::Colors::BRIGHT_YELLOW + ui::Colors::BOLD) << "\n";
-    std::cout << "  " << ui::colorize("ak run -p <profile> -- <cmd>", ui::Colors::BRIGHT_CYAN) << "       Run command with profile loaded\n";
-    std::cout << "  " << ui::colorize("ak test [<service>|--all] [--json] [--quiet]", ui::Colors::BRIGHT_CYAN) << " Test API connectivity\n";
+    std::cout << "  " << ui::colorize("ak run -p <p>[,<p>] [--watch] -- <cmd>", ui::Colors::BRIGHT_CYAN) << " Run command with profile loaded\n";
+    std::cout << "  " << ui::colorize("ak redact [-p <profile>[,<p>]] < log", ui::Colors::BRIGHT_CYAN) << "  Replace secret values in piped text\n";
+    std::cout << "  " << ui::colorize("ak test [<service>|--all|--all-profiles] [--json] [--jobs N] [--no-cache|--max-age T] [--watch [S]]", ui::Colors::BRIGHT_CYAN) << " Test API connectivity\n";
     std::cout << "  " << ui::colorize("ak test '<api-key>' [--provider=<name>]", ui::Colors::BRIGHT_CYAN) << "  Test an API key directly\n";
-    std::cout << "  " << ui::colorize("ak refresh [-p <profile>]", ui::Colors::BRIGHT_CYAN) << "        Refresh access tokens (CLI or manual links)\n";
+    std::cout << "  " << ui::colorize("ak monitor [<service>...] [--interval S]", ui::Colors::BRIGHT_CYAN) << " Watch key health; print changes only\n";
+    std::cout << "  " << ui::colorize("ak refresh [-p <profile>] [--timeout S]", ui::Colors::BRIGHT_CYAN) << " Refresh access tokens (CLI or manual links)\n";
     std::cout << "  " << ui::colorize("ak guard enable|disable|status", ui::Colors::BRIGHT_CYAN) << "    Shell guard for secret protection\n";
     std::cout << "  " << ui::colorize("ak doctor", ui::Colors::BRIGHT_CYAN) << "                         Check system configuration\n";
-    std::cout << "  " << ui::colorize("ak audit [N]", ui::Colors::BRIGHT_CYAN) << "                      Show audit log (last N entries)\n";
+    std::cout << "  " << ui::colorize("ak audit [N] [--since T] [--action A] [--key K]", ui::Colors::BRIGHT_CYAN) << " Show audit log (last N entries)\n";
     std::cout << "  " << ui::colorize("ak env -p <profile>", ui::Colors::BRIGHT_CYAN) << "               Show profile as export statements\n\n";
     
     std::cout << ui::colorize("SYSTEM:", ui::Colors::BRIGHT_RED + ui::Colors::BOLD) << "\n";
     std::cout << "  " << ui::colorize("ak help", ui::Colors::BRIGHT_CYAN) << "                           Show this help message\n";
     std::cout << "  " << ui::colorize("ak version", ui::Colors::BRIGHT_CYAN) << "                        Show version information\n";
-    std::cout << "  " << ui::colorize("ak backend", ui::Colors::BRIGHT_CYAN) << "                        Show backend information\n";
+    std::cout << "  " << ui::colorize("ak backend [list|set <name>]", ui::Colors::BRIGHT_CYAN) << "      Show or select the vault backend (gpg, aead, plain)\n";
+    std::cout << "  " << ui::colorize("ak migrate --to <backend> [--jobs N]", ui::Colors::BRIGHT_CYAN) << " Re-encrypt everything with another backend\n";
+    std::cout << "  " << ui::colorize("ak rekey [--jobs N]", ui::Colors::BRIGHT_CYAN) << "               Re-encrypt everything under a new passphrase\n";
+    std::cout << "  " << ui::colorize("ak sync [pull|push|status|remote <url>]", ui::Colors::BRIGHT_CYAN) << " Sync profiles with a shared remote\n";
+    std::cout << "  " << ui::colorize("ak agent start|stop|status", ui::Colors::BRIGHT_CYAN) << "        Keep unlocked profiles in a background agent\n";
     std::cout << "  " << ui::colorize("ak purge [--no-backup] [--force]", ui::Colors::BRIGHT_CYAN) << "      Remove all secrets and profiles\n";
     std::cout << "  " << ui::colorize("ak install-shell", ui::Colors::BRIGHT_CYAN) << "                  Install shell integration\n";
+    std::cout << "  " << ui::colorize("ak hook-env --shell <sh>", ui::Colors::BRIGHT_CYAN) << "          Print auto-load changes for the prompt hook\n";
     std::cout << "  " << ui::colorize("ak completion <shell>", ui::Colors::BRIGHT_CYAN) << "             Generate shell completion script\n\n";
 
     std::cout << ui::colorize("LEGACY ALIASES:", ui::Colors::DIM + ui::Colors::BOLD) << "\n";
@@ -162,7 +174,7 @@ _ak_completion() {
     prev="${COMP_WORDS[COMP_CWORD-1]}"
 
     # Main commands (namespaced + legacy)
-    local commands="secret profile service add set get ls rm search cp purge save load unload profiles duplicate env export import migrate run guard test refresh doctor audit install-shell uninstall completion version backend help welcome"
+    local commands="secret profile service add set get ls rm search cp purge save load unload profiles duplicate env export import migrate rekey run redact guard test monitor refresh doctor audit install-shell hook-env uninstall completion version backend sync agent help welcome"
 
     # Handle multi-level completions
     case "${COMP_WORDS[1]}" in
@@ -173,7 +185,7 @@ _ak_completion() {
                     return 0
                     ;;
                 get)
-                    local secrets=$(ak ls 2>/dev/null | awk '{print $1}')
+                    local secrets=$(ak __complete keys "${cur}" 2>/dev/null)
                     COMPREPLY=($(compgen -W "${secrets} --full --reveal" -- ${cur}))
                     return 0
                     ;;
@@ -182,12 +194,12 @@ _ak_completion() {
                     return 0
                     ;;
                 cp)
-                    local secrets=$(ak ls 2>/dev/null | awk '{print $1}')
+                    local secrets=$(ak __complete keys "${cur}" 2>/dev/null)
                     COMPREPLY=($(compgen -W "${secrets} --clear" -- ${cur}))
                     return 0
                     ;;
                 add|set|rm|search)
-                    local secrets=$(ak ls 2>/dev/null | awk '{print $1}')
+                    local secrets=$(ak __complete keys "${cur}" 2>/dev/null)
                     COMPREPLY=($(compgen -W "${secrets}" -- ${cur}))
                     return 0
                     ;;
@@ -200,13 +212,13 @@ _ak_completion() {
                     return 0
                     ;;
                 load|unload|duplicate|rm)
-                    local profiles=$(ak profiles 2>/dev/null | tr '\n' ' ')
+                    local profiles=$(ak __complete profiles "${cur}" 2>/dev/null)
                     COMPREPLY=($(compgen -W "${profiles} --persist --force" -- ${cur}))
                     return 0
                     ;;
                 save)
-                    local profiles=$(ak profiles 2>/dev/null | tr '\n' ' ')
-                    local secrets=$(ak ls 2>/dev/null | awk '{print $1}')
+                    local profiles=$(ak __complete profiles "${cur}" 2>/dev/null)
+                    local secrets=$(ak __complete keys "${cur}" 2>/dev/null)
                     COMPREPLY=($(compgen -W "${profiles} ${secrets}" -- ${cur}))
                     return 0
                     ;;
@@ -219,7 +231,7 @@ _ak_completion() {
                     return 0
                     ;;
                 show|edit|rm)
-                    local services=$(ak service ls 2>/dev/null | grep -v "Built-in\|Custom\|Available" | awk '{print $1}')
+                    local services=$(ak __complete services "${cur}" 2>/dev/null)
                     COMPREPLY=($(compgen -W "${services}" -- ${cur}))
                     return 0
                     ;;
@@ -234,7 +246,7 @@ _ak_completion() {
             ;;
         --profile|-p)
             # Complete with available profiles
-            local profiles=$(ak profiles 2>/dev/null | tr '\n' ' ')
+            local profiles=$(ak __complete profiles "${cur}" 2>/dev/null)
             COMPREPLY=($(compgen -W "${profiles}" -- ${cur}))
             return 0
             ;;
@@ -254,9 +266,9 @@ _ak_completion() {
             COMPREPLY=($(compgen -W "add ls show edit rm" -- ${cur}))
             return 0
             ;;
-        test)
+        test|monitor)
             local services="anthropic azure_openai brave cohere deepseek exa fireworks gemini groq huggingface inference langchain continue composio hyperbolic logfire mistral openai openrouter perplexity sambanova tavily together xai"
-            COMPREPLY=($(compgen -W "${services} --all --json --fail-fast --quiet --provider --debug" -- ${cur}))
+            COMPREPLY=($(compgen -W "${services} --all --all-profiles --jobs --no-cache --max-age --watch --json --fail-fast --quiet --provider --debug" -- ${cur}))
             return 0
             ;;
         --provider)
@@ -292,7 +304,7 @@ _arguments -C \
   '(-v --version)'{-v,--version}'[Show version information]' \
   '--json[Enable JSON output]' \
   '--quiet[Minimal output for scripting]' \
-  '1:command:(secret profile service add set get ls rm search cp purge save load unload profiles duplicate env export import migrate run guard test refresh doctor audit install-shell uninstall completion version backend help welcome gui)' \
+  '1:command:(secret profile service add set get ls rm search cp purge save load unload profiles duplicate env export import migrate rekey run redact guard test monitor refresh doctor audit install-shell hook-env uninstall completion version backend sync agent help welcome gui)' \
   '*::arg:->args'
 
 case $state in
@@ -314,7 +326,7 @@ case $state in
             _arguments \
               '--full[Show unmasked value]' \
               '--reveal[Show unmasked value]' \
-              '*:secret name:'
+              '*:secret name:{compadd -- $(ak __complete keys 2>/dev/null)}'
             ;;
           ls)
             _arguments \
@@ -324,7 +336,7 @@ case $state in
           cp)
             _arguments \
               '--clear[Auto-clear time]:time:(20s 30s 60s)' \
-              '*:secret name:'
+              '*:secret name:{compadd -- $(ak __complete keys 2>/dev/null)}'
             ;;
         esac
         ;;
@@ -342,12 +354,12 @@ case $state in
           load|unload)
             _arguments \
               '--persist[Remember for current directory]' \
-              '*:profile name:'
+              '*:profile name:{compadd -- $(ak __complete profiles 2>/dev/null)}'
             ;;
           rm)
             _arguments \
               '--force[Skip confirmation]' \
-              '*:profile name:'
+              '*:profile name:{compadd -- $(ak __complete profiles 2>/dev/null)}'
             ;;
         esac
         ;;
@@ -369,12 +381,17 @@ case $state in
       guard)
         _values 'action' enable disable status
         ;;
-      test)
+      test|monitor)
         _arguments \
           '--all[Test all services]' \
           '--json[JSON output]' \
           '--quiet[Minimal output]' \
           '--fail-fast[Stop on first failure]' \
+          '--all-profiles[Test every profile]' \
+          '--jobs[Parallel checks]:count:' \
+          '--no-cache[Ignore cached results]' \
+          '--max-age[Reuse cached results up to this age]:age:' \
+          '--watch[Rerun every N seconds]:seconds:' \
           '--debug[Show debug information]' \
           '--provider=[Specify provider for inline key]:provider:(anthropic azure_openai brave cohere deepseek exa fireworks gemini groq huggingface inference langchain continue composio hyperbolic logfire mistral openai openrouter perplexity sambanova tavily together xai)' \
           '*:service name or API key:'
@@ -387,22 +404,22 @@ case $state in
       load|unload)
         _arguments \
           '--persist[Remember for current directory]' \
-          '*:profile name:'
+          '*:profile name:{compadd -- $(ak __complete profiles 2>/dev/null)}'
         ;;
       env)
         _arguments \
-          '--profile[Profile name]:profile name:' '-p+[Profile name]:profile name:'
+          '--profile[Profile name]:profile name:{compadd -- $(ak __complete profiles 2>/dev/null)}' '-p+[Profile name]:profile name:{compadd -- $(ak __complete profiles 2>/dev/null)}'
         ;;
       import)
         _arguments \
-          '--profile[Profile name]:profile name:' '-p+[Profile name]:profile name:' \
+          '--profile[Profile name]:profile name:{compadd -- $(ak __complete profiles 2>/dev/null)}' '-p+[Profile name]:profile name:{compadd -- $(ak __complete profiles 2>/dev/null)}' \
           '--format[Format]:format:(env dotenv json yaml)' '-f+[Format]:format:(env dotenv json yaml)' \
           '--file[File path]:file:_files' '-i+[File path]:file:_files' \
           '--keys[Only import known service provider keys]'
         ;;
       export)
         _arguments \
-          '--profile[Profile name]:profile name:' '-p+[Profile name]:profile name:' \
+          '--profile[Profile name]:profile name:{compadd -- $(ak __complete profiles 2>/dev/null)}' '-p+[Profile name]:profile name:{compadd -- $(ak __complete profiles 2>/dev/null)}' \
           '--format[Format]:format:(env dotenv json yaml)' '-f+[Format]:format:(env dotenv json yaml)' \
           '--output[Output file]:file:_files' '-o+[Output file]:file:_files'
         ;;
@@ -423,7 +440,7 @@ complete -c ak -l json -d "Enable JSON output"
 complete -c ak -l quiet -d "Minimal output for scripting"
 
 # Main commands (namespaced + legacy)
-complete -c ak -n "__fish_use_subcommand" -a "secret profile service add set get ls rm search cp purge save load unload profiles duplicate env export import migrate run guard test refresh doctor audit install-shell uninstall completion version backend help welcome gui"
+complete -c ak -n "__fish_use_subcommand" -a "secret profile service add set get ls rm search cp purge save load unload profiles duplicate env export import migrate rekey run redact guard test monitor refresh doctor audit install-shell hook-env uninstall completion version backend sync agent help welcome gui"
 
 # Secret namespace
 complete -c ak -n "__fish_seen_subcommand_from secret; and not __fish_seen_subcommand_from add set get ls rm search cp" -a "add set get ls rm search cp" -d "Secret commands"
@@ -441,6 +458,11 @@ complete -c ak -n "__fish_seen_subcommand_from profile; and __fish_seen_subcomma
 # Service namespace
 complete -c ak -n "__fish_seen_subcommand_from service; and not __fish_seen_subcommand_from add ls show edit rm" -a "add ls show edit rm" -d "Service commands"
 
+# Names from the completion index (no decryption)
+complete -c ak -n "__fish_seen_subcommand_from get set rm search cp" -a "(ak __complete keys (commandline -ct) 2>/dev/null)" -d "Secret"
+complete -c ak -n "__fish_seen_subcommand_from load unload duplicate" -a "(ak __complete profiles (commandline -ct) 2>/dev/null)" -d "Profile"
+complete -c ak -n "__fish_seen_subcommand_from service; and __fish_seen_subcommand_from show edit rm" -a "(ak __complete services (commandline -ct) 2>/dev/null)" -d "Service"
+
 # completion subcommand
 complete -c ak -n "__fish_seen_subcommand_from completion" -a "bash zsh fish" -d "Shell"
 
@@ -448,12 +470,17 @@ complete -c ak -n "__fish_seen_subcommand_from completion" -a "bash zsh fish" -d
 complete -c ak -n "__fish_seen_subcommand_from guard" -a "enable disable status" -d "Shell guard actions"
 
 # test options
-complete -c ak -n "__fish_seen_subcommand_from test" -l all -d "Test all configured providers"
-complete -c ak -n "__fish_seen_subcommand_from test" -l json -d "JSON output"
-complete -c ak -n "__fish_seen_subcommand_from test" -l quiet -d "Minimal output"
-complete -c ak -n "__fish_seen_subcommand_from test" -l fail-fast -d "Stop on first failure"
-complete -c ak -n "__fish_seen_subcommand_from test" -l debug -d "Show debug information"
-complete -c ak -n "__fish_seen_subcommand_from test" -l provider -r -a "anthropic azure_openai brave cohere deepseek exa fireworks gemini groq huggingface inference langchain continue composio hyperbolic logfire mistral openai openrouter perplexity sambanova tavily together xai" -d "Specify provider for inline key"
+complete -c ak -n "__fish_seen_subcommand_from test monitor" -l all -d "Test all configured providers"
+complete -c ak -n "__fish_seen_subcommand_from test monitor" -l json -d "JSON output"
+complete -c ak -n "__fish_seen_subcommand_from test monitor" -l quiet -d "Minimal output"
+complete -c ak -n "__fish_seen_subcommand_from test monitor" -l fail-fast -d "Stop on first failure"
+complete -c ak -n "__fish_seen_subcommand_from test monitor" -l all-profiles -d "Test every profile"
+complete -c ak -n "__fish_seen_subcommand_from test monitor" -s j -l jobs -r -d "Parallel checks"
+complete -c ak -n "__fish_seen_subcommand_from test monitor" -l no-cache -d "Ignore cached results"
+complete -c ak -n "__fish_seen_subcommand_from test monitor" -l watch -d "Rerun every N seconds"
+complete -c ak -n "__fish_seen_subcommand_from test monitor" -l max-age -r -d "Reuse cached results up to this age"
+complete -c ak -n "__fish_seen_subcommand_from test monitor" -l debug -d "Show debug information"
+complete -c ak -n "__fish_seen_subcommand_from test monitor" -l provider -r -a "anthropic azure_openai brave cohere deepseek exa fireworks gemini groq huggingface inference langchain continue composio hyperbolic logfire mistral openai openrouter perplexity sambanova tavily together xai" -d "Specify provider for inline key"
 
 # purge options
 complete -c ak -n "__fish_seen_subcommand_from purge" -l no-backup -d "Skip backup creation"
@@ -464,16 +491,16 @@ complete -c ak -n "__fish_seen_subcommand_from load" -l persist -d "Persist prof
 complete -c ak -n "__fish_seen_subcommand_from unload" -l persist -d "Remove persisted profile for this directory"
 
 # env options
-complete -c ak -n "__fish_seen_subcommand_from env" -s p -l profile -r -d "Profile name"
+complete -c ak -n "__fish_seen_subcommand_from env" -s p -l profile -r -a "(ak __complete profiles 2>/dev/null)" -d "Profile name"
 
 # import options
-complete -c ak -n "__fish_seen_subcommand_from import" -s p -l profile -r -d "Profile name"
+complete -c ak -n "__fish_seen_subcommand_from import" -s p -l profile -r -a "(ak __complete profiles 2>/dev/null)" -d "Profile name"
 complete -c ak -n "__fish_seen_subcommand_from import" -s f -l format -a "env dotenv json yaml" -d "Input format"
 complete -c ak -n "__fish_seen_subcommand_from import" -s i -l file -r -d "Input file"
 complete -c ak -n "__fish_seen_subcommand_from import" -l keys -d "Only import known service keys"
 
 # export options
-complete -c ak -n "__fish_seen_subcommand_from export" -s p -l profile -r -d "Profile name"
+complete -c ak -n "__fish_seen_subcommand_from export" -s p -l profile -r -a "(ak __complete profiles 2>/dev/null)" -d "Profile name"
 complete -c ak -n "__fish_seen_subcommand_from export" -s f -l format -a "env dotenv json yaml" -d "Output format"
 complete -c ak -n "__fish_seen_subcommand_from export" -s o -l output -r -d "Output file"
 
@@ -492,7 +519,7 @@ _ak_completion() {
     prev="${COMP_WORDS[COMP_CWORD-1]}"
 
     # Main commands (namespaced + legacy)
-    local commands="secret profile service add set get ls rm search cp purge save load unload profiles duplicate env export import migrate run guard test refresh doctor audit install-shell uninstall completion version backend help welcome"
+    local commands="secret profile service add set get ls rm search cp purge save load unload profiles duplicate env export import migrate rekey run redact guard test monitor refresh doctor audit install-shell hook-env uninstall completion version backend sync agent help welcome"
 
     # Handle multi-level completions
     case "${COMP_WORDS[1]}" in
@@ -503,7 +530,7 @@ _ak_completion() {
                     return 0
                     ;;
                 get)
-                    local secrets=$(ak ls 2>/dev/null | awk '{print $1}')
+                    local secrets=$(ak __complete keys "${cur}" 2>/dev/null)
                     COMPREPLY=($(compgen -W "${secrets} --full --reveal" -- ${cur}))
                     return 0
                     ;;
@@ -512,12 +539,12 @@ _ak_completion() {
                     return 0
                     ;;
                 cp)
-                    local secrets=$(ak ls 2>/dev/null | awk '{print $1}')
+                    local secrets=$(ak __complete keys "${cur}" 2>/dev/null)
                     COMPREPLY=($(compgen -W "${secrets} --clear" -- ${cur}))
                     return 0
                     ;;
                 add|set|rm|search)
-                    local secrets=$(ak ls 2>/dev/null | awk '{print $1}')
+                    local secrets=$(ak __complete keys "${cur}" 2>/dev/null)
                     COMPREPLY=($(compgen -W "${secrets}" -- ${cur}))
                     return 0
                     ;;
@@ -530,13 +557,13 @@ _ak_completion() {
                     return 0
                     ;;
                 load|unload|duplicate|rm)
-                    local profiles=$(ak profiles 2>/dev/null | tr '\n' ' ')
+                    local profiles=$(ak __complete profiles "${cur}" 2>/dev/null)
                     COMPREPLY=($(compgen -W "${profiles} --persist --force" -- ${cur}))
                     return 0
                     ;;
                 save)
-                    local profiles=$(ak profiles 2>/dev/null | tr '\n' ' ')
-                    local secrets=$(ak ls 2>/dev/null | awk '{print $1}')
+                    local profiles=$(ak __complete profiles "${cur}" 2>/dev/null)
+                    local secrets=$(ak __complete keys "${cur}" 2>/dev/null)
                     COMPREPLY=($(compgen -W "${profiles} ${secrets}" -- ${cur}))
                     return 0
                     ;;
@@ -549,7 +576,7 @@ _ak_completion() {
                     return 0
                     ;;
                 show|edit|rm)
-                    local services=$(ak service ls 2>/dev/null | grep -v "Built-in\|Custom\|Available" | awk '{print $1}')
+                    local services=$(ak __complete services "${cur}" 2>/dev/null)
                     COMPREPLY=($(compgen -W "${services}" -- ${cur}))
                     return 0
                     ;;
@@ -564,7 +591,7 @@ _ak_completion() {
             ;;
         --profile|-p)
             # Complete with available profiles
-            local profiles=$(ak profiles 2>/dev/null | tr '\n' ' ')
+            local profiles=$(ak __complete profiles "${cur}" 2>/dev/null)
             COMPREPLY=($(compgen -W "${profiles}" -- ${cur}))
             return 0
             ;;
@@ -584,9 +611,9 @@ _ak_completion() {
             COMPREPLY=($(compgen -W "add ls show edit rm" -- ${cur}))
             return 0
             ;;
-        test)
+        test|monitor)
             local services="anthropic azure_openai brave cohere deepseek exa fireworks gemini groq huggingface inference langchain continue composio hyperbolic logfire mistral openai openrouter perplexity sambanova tavily together xai"
-            COMPREPLY=($(compgen -W "${services} --all --json --fail-fast --quiet --provider --debug" -- ${cur}))
+            COMPREPLY=($(compgen -W "${services} --all --all-profiles --jobs --no-cache --max-age --watch --json --fail-fast --quiet --provider --debug" -- ${cur}))
             return 0
             ;;
         --provider)
@@ -627,7 +654,7 @@ _arguments -C \
   '(-v --version)'{-v,--version}'[Show version information]' \
   '--json[Enable JSON output]' \
   '--quiet[Minimal output for scripting]' \
-  '1:command:(secret profile service add set get ls rm search cp purge save load unload profiles duplicate env export import migrate run guard test refresh doctor audit install-shell uninstall completion version backend help welcome gui)' \
+  '1:command:(secret profile service add set get ls rm search cp purge save load unload profiles duplicate env export import migrate rekey run redact guard test monitor refresh doctor audit install-shell hook-env uninstall completion version backend sync agent help welcome gui)' \
   '*::arg:->args'
 
 case $state in
@@ -649,7 +676,7 @@ case $state in
             _arguments \
               '--full[Show unmasked value]' \
               '--reveal[Show unmasked value]' \
-              '*:secret name:'
+              '*:secret name:{compadd -- $(ak __complete keys 2>/dev/null)}'
             ;;
           ls)
             _arguments \
@@ -659,7 +686,7 @@ case $state in
           cp)
             _arguments \
               '--clear[Auto-clear time]:time:(20s 30s 60s)' \
-              '*:secret name:'
+              '*:secret name:{compadd -- $(ak __complete keys 2>/dev/null)}'
             ;;
         esac
         ;;
@@ -677,12 +704,12 @@ case $state in
           load|unload)
             _arguments \
               '--persist[Remember for current directory]' \
-              '*:profile name:'
+              '*:profile name:{compadd -- $(ak __complete profiles 2>/dev/null)}'
             ;;
           rm)
             _arguments \
               '--force[Skip confirmation]' \
-              '*:profile name:'
+              '*:profile name:{compadd -- $(ak __complete profiles 2>/dev/null)}'
             ;;
         esac
         ;;
@@ -704,12 +731,17 @@ case $state in
       guard)
         _values 'action' enable disable status
         ;;
-      test)
+      test|monitor)
         _arguments \
           '--all[Test all services]' \
           '--json[JSON output]' \
           '--quiet[Minimal output]' \
           '--fail-fast[Stop on first failure]' \
+          '--all-profiles[Test every profile]' \
+          '--jobs[Parallel checks]:count:' \
+          '--no-cache[Ignore cached results]' \
+          '--max-age[Reuse cached results up to this age]:age:' \
+          '--watch[Rerun every N seconds]:seconds:' \
           '--debug[Show debug information]' \
           '--provider=[Specify provider for inline key]:provider:(anthropic azure_openai brave cohere deepseek exa fireworks gemini groq huggingface inference langchain continue composio hyperbolic logfire mistral openai openrouter perplexity sambanova tavily together xai)' \
           '*:service name or API key:'
@@ -722,22 +754,22 @@ case $state in
       load|unload)
         _arguments \
           '--persist[Remember for current directory]' \
-          '*:profile name:'
+          '*:profile name:{compadd -- $(ak __complete profiles 2>/dev/null)}'
         ;;
       env)
         _arguments \
-          '--profile[Profile name]:profile name:' '-p+[Profile name]:profile name:'
+          '--profile[Profile name]:profile name:{compadd -- $(ak __complete profiles 2>/dev/null)}' '-p+[Profile name]:profile name:{compadd -- $(ak __complete profiles 2>/dev/null)}'
         ;;
       import)
         _arguments \
-          '--profile[Profile name]:profile name:' '-p+[Profile name]:profile name:' \
+          '--profile[Profile name]:profile name:{compadd -- $(ak __complete profiles 2>/dev/null)}' '-p+[Profile name]:profile name:{compadd -- $(ak __complete profiles 2>/dev/null)}' \
           '--format[Format]:format:(env dotenv json yaml)' '-f+[Format]:format:(env dotenv json yaml)' \
           '--file[File path]:file:_files' '-i+[File path]:file:_files' \
           '--keys[Only import known service provider keys]'
         ;;
       export)
         _arguments \
-          '--profile[Profile name]:profile name:' '-p+[Profile name]:profile name:' \
+          '--profile[Profile name]:profile name:{compadd -- $(ak __complete profiles 2>/dev/null)}' '-p+[Profile name]:profile name:{compadd -- $(ak __complete profiles 2>/dev/null)}' \
           '--format[Format]:format:(env dotenv json yaml)' '-f+[Format]:format:(env dotenv json yaml)' \
           '--output[Output file]:file:_files' '-o+[Output file]:file:_files'
         ;;
@@ -759,7 +791,7 @@ complete -c ak -l json -d "Enable JSON output"
 complete -c ak -l quiet -d "Minimal output for scripting"
 
 # Main commands (namespaced + legacy)
-complete -c ak -n "__fish_use_subcommand" -a "secret profile service add set get ls rm search cp purge save load unload profiles duplicate env export import migrate run guard test refresh doctor audit install-shell uninstall completion version backend help welcome gui"
+complete -c ak -n "__fish_use_subcommand" -a "secret profile service add set get ls rm search cp purge save load unload profiles duplicate env export import migrate rekey run redact guard test monitor refresh doctor audit install-shell hook-env uninstall completion version backend sync agent help welcome gui"
 
 # Secret namespace
 complete -c ak -n "__fish_seen_subcommand_from secret; and not __fish_seen_subcommand_from add set get ls rm search cp" -a "add set get ls rm search cp" -d "Secret commands"
@@ -777,6 +809,11 @@ complete -c ak -n "__fish_seen_subcommand_from profile; and __fish_seen_subcomma
 # Service namespace
 complete -c ak -n "__fish_seen_subcommand_from service; and not __fish_seen_subcommand_from add ls show edit rm" -a "add ls show edit rm" -d "Service commands"
 
+# Names from the completion index (no decryption)
+complete -c ak -n "__fish_seen_subcommand_from get set rm search cp" -a "(ak __complete keys (commandline -ct) 2>/dev/null)" -d "Secret"
+complete -c ak -n "__fish_seen_subcommand_from load unload duplicate" -a "(ak __complete profiles (commandline -ct) 2>/dev/null)" -d "Profile"
+complete -c ak -n "__fish_seen_subcommand_from service; and __fish_seen_subcommand_from show edit rm" -a "(ak __complete services (commandline -ct) 2>/dev/null)" -d "Service"
+
 # completion subcommand
 complete -c ak -n "__fish_seen_subcommand_from completion" -a "bash zsh fish" -d "Shell"
 
@@ -784,12 +821,17 @@ complete -c ak -n "__fish_seen_subcommand_from completion" -a "bash zsh fish" -d
 complete -c ak -n "__fish_seen_subcommand_from guard" -a "enable disable status" -d "Shell guard actions"
 
 # test options
-complete -c ak -n "__fish_seen_subcommand_from test" -l all -d "Test all configured providers"
-complete -c ak -n "__fish_seen_subcommand_from test" -l json -d "JSON output"
-complete -c ak -n "__fish_seen_subcommand_from test" -l quiet -d "Minimal output"
-complete -c ak -n "__fish_seen_subcommand_from test" -l fail-fast -d "Stop on first failure"
-complete -c ak -n "__fish_seen_subcommand_from test" -l debug -d "Show debug information"
-complete -c ak -n "__fish_seen_subcommand_from test" -l provider -r -a "anthropic azure_openai brave cohere deepseek exa fireworks gemini groq huggingface inference langchain continue composio hyperbolic logfire mistral openai openrouter perplexity sambanova tavily together xai" -d "Specify provider for inline key"
+complete -c ak -n "__fish_seen_subcommand_from test monitor" -l all -d "Test all configured providers"
+complete -c ak -n "__fish_seen_subcommand_from test monitor" -l json -d "JSON output"
+complete -c ak -n "__fish_seen_subcommand_from test monitor" -l quiet -d "Minimal output"
+complete -c ak -n "__fish_seen_subcommand_from test monitor" -l fail-fast -d "Stop on first failure"
+complete -c ak -n "__fish_seen_subcommand_from test monitor" -l all-profiles -d "Test every profile"
+complete -c ak -n "__fish_seen_subcommand_from test monitor" -s j -l jobs -r -d "Parallel checks"
+complete -c ak -n "__fish_seen_subcommand_from test monitor" -l no-cache -d "Ignore cached results"
+complete -c ak -n "__fish_seen_subcommand_from test monitor" -l watch -d "Rerun every N seconds"
+complete -c ak -n "__fish_seen_subcommand_from test monitor" -l max-age -r -d "Reuse cached results up to this age"
+complete -c ak -n "__fish_seen_subcommand_from test monitor" -l debug -d "Show debug information"
+complete -c ak -n "__fish_seen_subcommand_from test monitor" -l provider -r -a "anthropic azure_openai brave cohere deepseek exa fireworks gemini groq huggingface inference langchain continue composio hyperbolic logfire mistral openai openrouter perplexity sambanova tavily together xai" -d "Specify provider for inline key"
 
 # purge options
 complete -c ak -n "__fish_seen_subcommand_from purge" -l no-backup -d "Skip backup creation"
@@ -800,16 +842,16 @@ complete -c ak -n "__fish_seen_subcommand_from load" -l persist -d "Persist prof
 complete -c ak -n "__fish_seen_subcommand_from unload" -l persist -d "Remove persisted profile for this directory"
 
 # env options
-complete -c ak -n "__fish_seen_subcommand_from env" -s p -l profile -r -d "Profile name"
+complete -c ak -n "__fish_seen_subcommand_from env" -s p -l profile -r -a "(ak __complete profiles 2>/dev/null)" -d "Profile name"
 
 # import options
-complete -c ak -n "__fish_seen_subcommand_from import" -s p -l profile -r -d "Profile name"
+complete -c ak -n "__fish_seen_subcommand_from import" -s p -l profile -r -a "(ak __complete profiles 2>/dev/null)" -d "Profile name"
 complete -c ak -n "__fish_seen_subcommand_from import" -s f -l format -a "env dotenv json yaml" -d "Input format"
 complete -c ak -n "__fish_seen_subcommand_from import" -s i -l file -r -d "Input file"
 complete -c ak -n "__fish_seen_subcommand_from import" -l keys -d "Only import known service keys"
 
 # export options
-complete -c ak -n "__fish_seen_subcommand_from export" -s p -l profile -r -d "Profile name"
+complete -c ak -n "__fish_seen_subcommand_from export" -s p -l profile -r -a "(ak __complete profiles 2>/dev/null)" -d "Profile name"
 complete -c ak -n "__fish_seen_subcommand_from export" -s f -l format -a "env dotenv json yaml" -d "Output format"
 complete -c ak -n "__fish_seen_subcommand_from export" -s o -l output -r -d "Output file"
 
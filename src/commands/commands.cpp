@@ -1,27 +1,54 @@
 #include "commands/commands.hpp"
+#include "commands/layers.hpp"
+#include "commands/exporters.hpp"
+#include "agent/agent.hpp"
 #include "core/config.hpp"
+#include "core/audit.hpp"
+#include "core/redact.hpp"
+#include "core/metrics.hpp"
+#include "http/http.hpp"
 #include "storage/vault.hpp"
+#include "storage/importer.hpp"
+#include "storage/completion_index.hpp"
+#include "storage/search_index.hpp"
+#include "storage/content_store.hpp"
+#include "storage/blob_store.hpp"
+#include "storage/rekey.hpp"
+#include "storage/remote.hpp"
+#include "storage/transaction.hpp"
 #include "system/system.hpp"
+#include "system/process.hpp"
 #include "services/services.hpp"
+#include "services/test_cache.hpp"
+#include "services/monitor.hpp"
 #include "ui/ui.hpp"
 #include "cli/cli.hpp"
-#ifdef BUILD_GUI
-#include "gui/gui.hpp"
-#endif
 #include <iostream>
 #include <fstream>
+#include <random>
+#include <string_view>
 #include <sstream>
 #include <iomanip>
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <future>
 #include <unordered_set>
 #include <filesystem>
+#include <cctype>
+#include <csignal>
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <cerrno>
 #ifdef _WIN32
 #include <io.h>
 #define STDIN_FILENO 0
 #define STDOUT_FILENO 1
 #define isatty _isatty
 #else
+#include <fcntl.h>
 #include <unistd.h>
 #endif
 
@@ -31,56 +58,233 @@ namespace ak
     {
 
         // Utility functions
+        void appendExportLine(std::string &out, std::string_view name, std::string_view value)
+        {
+            out += "export ";
+            out += name;
+            out += "=\"";
+            for (char c : value)
+            {
+                if (c == '\\' || c == '"')
+                {
+                    out.push_back('\\');
+                }
+                if (c == '\n')
+                {
+                    out += "\\n";
+                    continue;
+                }
+                out.push_back(c);
+            }
+            out += "\"\n";
+        }
+
+        // Room for a line even if every value byte needs escaping
+        size_t exportLineBound(std::string_view name, std::string_view value)
+        {
+            return name.size() + 2 * value.size() + 11;
+        }
+
+        std::string exportLine(const std::string &name, const std::string &value)
+        {
+            std::string line;
+            line.reserve(exportLineBound(name, value));
+            appendExportLine(line, name, value);
+            return line;
+        }
+
+        core::KeyStore loadVaultPreferAgent(const core::Config &cfg)
+        {
+            core::KeyStore ks;
+            if (agent::fetchVault(cfg, ks))
+            {
+                return ks;
+            }
+            return storage::loadVault(cfg);
+        }
+
+        // Values for the selected profile in profile order, preferring per-profile
+        // key storage and falling back to the legacy global vault for compatibility.
+        std::vector<std::pair<std::string, std::string>> resolveProfileValues(const core::Config &cfg, const std::string &name)
+        {
+            return std::move(resolveLayers(cfg, {name}).perLayer[0]);
+        }
+
+        std::string makeExports(const std::vector<std::pair<std::string, std::string>> &values)
+        {
+            // Sized up front: growing would leave partial copies in freed memory
+            size_t bound = 0;
+            for (const auto &[key, value] : values)
+            {
+                bound += exportLineBound(key, value);
+            }
+            std::string exports;
+            exports.reserve(bound);
+            for (const auto &[key, value] : values)
+            {
+                appendExportLine(exports, key, value);
+            }
+            return exports;
+        }
+
+        // `name` may list layers ("base,local"); later ones win
         std::string makeExportsForProfile(const core::Config &cfg, const std::string &name)
         {
-            // Export values for the selected profile, preferring per-profile key storage
-            // and falling back to the legacy global vault for compatibility.
-            auto keyNames = storage::readProfile(cfg, name);
-            auto profileKeyMap = storage::loadProfileKeys(cfg, name);
-            core::KeyStore ks = storage::loadVault(cfg);
+            return makeExports(resolveLayers(cfg, parseLayers(name)).values());
+        }
 
-            std::ostringstream oss;
+        // Exports for one persisted entry: a profile, or a "_key_<NAME>" entry
+        // left by `ak load <NAME> --persist` (read from the vault)
+        std::string makeExportsForPersisted(const core::Config &cfg, const std::string &name)
+        {
+            auto profiles = storage::listProfiles(cfg);
+            if (std::find(profiles.begin(), profiles.end(), name) != profiles.end())
+            {
+                return makeExportsForProfile(cfg, name);
+            }
+            if (name.substr(0, 5) == "_key_")
+            {
+                std::string keyName = name.substr(5);
+                core::KeyStore ks = loadVaultPreferAgent(cfg);
+                auto it = ks.kv.find(keyName);
+                if (it != ks.kv.end())
+                {
+                    return exportLine(keyName, it->second);
+                }
+            }
+            return "";
+        }
 
-            for (const auto &key : keyNames)
+        // Resolves every profile in `profiles` not yet in `memo` as one layered
+        // pass, leaving each profile's own exports behind
+        void fillBundleMemo(const core::Config &cfg, const std::vector<std::string> &profiles,
+                            std::map<std::string, std::string> &memo)
+        {
+            auto known = storage::listProfiles(cfg);
+            std::vector<std::string> missing;
+            for (const auto &profile : profiles)
             {
-                // Prefer per-profile value
-                auto pit = profileKeyMap.find(key);
-                std::string value;
-                if (pit != profileKeyMap.end())
+                if (!memo.count(profile) && std::find(known.begin(), known.end(), profile) != known.end() &&
+                    std::find(missing.begin(), missing.end(), profile) == missing.end())
                 {
-                    value = pit->second;
+                    missing.push_back(profile);
                 }
-                else
+            }
+            if (missing.empty())
+            {
+                return;
+            }
+            LayeredEnv layered = resolveLayers(cfg, missing);
+            for (size_t i = 0; i < missing.size(); ++i)
+            {
+                memo.emplace(missing[i], makeExports(layered.perLayer[i]));
+            }
+        }
+
+        // Merged bundle for a directory: each profile's exports follow a
+        // "# profile <name>" marker so the reader can pick which ones to load
+        std::string makeDirBundle(const core::Config &cfg, const std::vector<std::string> &profiles,
+                                  std::map<std::string, std::string> &memo)
+        {
+            fillBundleMemo(cfg, profiles, memo);
+            std::ostringstream oss;
+            for (const auto &profile : profiles)
+            {
+                auto it = memo.find(profile);
+                if (it == memo.end())
                 {
-                    // Fallback to global vault (legacy behavior)
-                    auto vit = ks.kv.find(key);
-                    if (vit == ks.kv.end())
-                    {
-                        continue;
-                    }
-                    value = vit->second;
+                    it = memo.emplace(profile, makeExportsForPersisted(cfg, profile)).first;
                 }
+                oss << "# profile " << profile << "\n" << it->second;
+            }
+            return oss.str();
+        }
+
+        void refreshDirBundles(const core::Config &cfg)
+        {
+            auto mappings = storage::listDirMappings(cfg);
+            // Without a silent way to seal, bundles are rebuilt on the next cd instead
+            if (mappings.empty() || !storage::canSealWithoutPrompt(cfg))
+            {
+                return;
+            }
 
-                std::string escaped;
-                escaped.reserve(value.size() * 2);
-                for (char c : value)
+            std::string generation = storage::readGeneration(cfg);
+            std::map<std::string, std::string> memo;
+            std::vector<std::string> allProfiles;
+            for (const auto &mapping : mappings)
+            {
+                allProfiles.insert(allProfiles.end(), mapping.profiles.begin(), mapping.profiles.end());
+            }
+            try
+            {
+                fillBundleMemo(cfg, allProfiles, memo);
+            }
+            catch (const std::exception &)
+            {
+                // Same as a failed write below: drop the stale bundles, the hook rebuilds them
+                for (const auto &mapping : mappings)
                 {
-                    if (c == '\\' || c == '"')
-                    {
-                        escaped.push_back('\\');
-                    }
-                    if (c == '\n')
-                    {
-                        escaped += "\\n";
-                        continue;
-                    }
-                    escaped.push_back(c);
+                    storage::removeDirBundle(cfg, mapping.key);
+                }
+                return;
+            }
+            for (const auto &mapping : mappings)
+            {
+                try
+                {
+                    storage::writeDirBundle(cfg, mapping.key, generation, makeDirBundle(cfg, mapping.profiles, memo));
+                }
+                catch (const std::exception &)
+                {
+                    // A stale bundle is never served; the hook rebuilds it
+                    storage::removeDirBundle(cfg, mapping.key);
                 }
+            }
+        }
 
-                oss << "export " << key << "=\"" << escaped << "\"\n";
+        void publishMetrics(const core::Config &cfg)
+        {
+            if (!cfg.metricsFile.empty() && !core::metrics::writePrometheusFile(cfg.metricsFile))
+            {
+                std::cerr << "ak: could not write metrics to " << cfg.metricsFile << "\n";
+            }
+            if (cfg.otlpEndpoint.empty())
+            {
+                return;
+            }
+            // Same convention as OTEL_EXPORTER_OTLP_ENDPOINT: a base URL gets the signal path
+            http::Request request;
+            request.method = "POST";
+            request.url = cfg.otlpEndpoint;
+            const std::string signal = "/v1/metrics";
+            if (request.url.size() < signal.size() || request.url.compare(request.url.size() - signal.size(), signal.size(), signal) != 0)
+            {
+                if (!request.url.empty() && request.url.back() == '/')
+                {
+                    request.url.pop_back();
+                }
+                request.url += signal;
             }
+            request.headers.push_back("Content-Type: application/json");
+            request.body = core::metrics::otlpJson();
 
-            return oss.str();
+            int status = 0;
+            if (http::available())
+            {
+                http::Timeouts timeouts{2000, 5000};
+                status = http::perform(request, timeouts).status;
+            }
+            else
+            {
+                std::string out = system::runCmdCapture("curl -sS -o /dev/null -w '%{http_code}' --max-time 5 " + http::toCurlArgs(request));
+                status = std::atoi(core::trim(out).c_str());
+            }
+            if (status < 200 || status >= 300)
+            {
+                std::cerr << "ak: OTLP export to " << request.url << " failed"
+                          << (status ? " (HTTP " + std::to_string(status) + ")" : std::string()) << "\n";
+            }
         }
 
         void printExportsForProfile(const core::Config &cfg, const std::string &name)
@@ -109,6 +313,7 @@ namespace ak
             std::string name;
             std::string value;
             std::string profileName;
+            bool everywhere = false;
 
             // Parse arguments, handling profile flag
             std::vector<std::string> parsedArgs;
@@ -119,6 +324,10 @@ namespace ak
                     profileName = args[i + 1];
                     ++i; // Skip the profile name argument
                 }
+                else if (args[i] == "--everywhere")
+                {
+                    everywhere = true;
+                }
                 else
                 {
                     parsedArgs.push_back(args[i]);
@@ -167,6 +376,10 @@ namespace ak
             {
                 core::error(cfg, "Environment variable value cannot be empty");
             }
+            if (everywhere && !storage::contentStoreEnabled(cfg))
+            {
+                core::error(cfg, "--everywhere needs the content store (AK_CONTENT_STORE=1, aead or plain backend)");
+            }
 
             // Unified Services model: no custom-service prompt
 
@@ -184,19 +397,42 @@ namespace ak
 
             // Read existing profile key list
             std::vector<std::string> profileKeys = storage::readProfile(cfg, profileName);
+            const std::vector<std::string> listedBefore = profileKeys;
 
             // Save/update value in the profile-specific encrypted store
-            auto profileKeyMap = storage::loadProfileKeys(cfg, profileName);
-            bool keyExistedInProfileStore = (profileKeyMap.find(name) != profileKeyMap.end());
-            profileKeyMap[name] = value;
-            storage::saveProfileKeys(cfg, profileName, profileKeyMap);
+            // (a single record when the profile log is on)
+            auto currentKeys = storage::loadProfileKeysCached(cfg, profileName);
+            auto previous = currentKeys->find(name);
+            bool keyExistedInProfileStore = previous != currentKeys->end();
+            std::string previousValue = keyExistedInProfileStore ? previous->second : std::string();
+            storage::setProfileKey(cfg, profileName, name, value);
+
+            // --everywhere: every profile entry that shared the old value
+            // moves to the new one, a manifest rewrite per profile
+            std::vector<std::string> rotatedProfiles;
+            if (everywhere && keyExistedInProfileStore)
+            {
+                storage::rotateSharedValue(cfg, previousValue, value, &rotatedProfiles);
+                for (const auto &rotated : rotatedProfiles)
+                {
+                    if (rotated == profileName)
+                    {
+                        continue;
+                    }
+                    std::string rotatedExports = makeExportsForProfile(cfg, rotated);
+                    if (!rotatedExports.empty())
+                    {
+                        storage::writeEncryptedBundle(cfg, rotated, rotatedExports);
+                    }
+                }
+            }
 
             // Ensure key is listed in the profile
             bool keyListedInProfile = (std::find(profileKeys.begin(), profileKeys.end(), name) != profileKeys.end());
             if (!keyListedInProfile)
             {
                 profileKeys.push_back(name);
-                storage::writeProfile(cfg, profileName, profileKeys);
+                storage::writeProfile(cfg, profileName, profileKeys, &listedBefore);
             }
 
             // Update encrypted bundle exports for persistence/loading
@@ -209,24 +445,10 @@ namespace ak
             // Also update any temporary per-key bundles
             {
                 std::string tempProfileName = "_key_" + name;
-                std::string escaped;
-                escaped.reserve(value.size() * 2);
-                for (char c : value)
-                {
-                    if (c == '\\' || c == '"')
-                    {
-                        escaped.push_back('\\');
-                    }
-                    if (c == '\n')
-                    {
-                        escaped += "\\n";
-                        continue;
-                    }
-                    escaped.push_back(c);
-                }
-                std::string tempExports = "export " + name + "=\"" + escaped + "\"\n";
+                std::string tempExports = exportLine(name, value);
                 storage::writeEncryptedBundle(cfg, tempProfileName, tempExports);
             }
+            refreshDirBundles(cfg);
 
             // Feedback
             if (keyExistsInVault && (keyExistedInProfileStore || keyListedInProfile))
@@ -246,16 +468,196 @@ namespace ak
                 core::success(cfg, "Added " + name + " to vault and profile '" + profileName + "'");
             }
 
+            if (!rotatedProfiles.empty())
+            {
+                core::success(cfg, "Rotated the shared value in " + std::to_string(rotatedProfiles.size()) + " profile" +
+                                       (rotatedProfiles.size() == 1 ? "" : "s"));
+                std::vector<std::string> auditArgs{name};
+                auditArgs.insert(auditArgs.end(), rotatedProfiles.begin(), rotatedProfiles.end());
+                core::auditLog(cfg, "rotate_shared", auditArgs);
+            }
+
             core::auditLog(cfg, keyExistsInVault ? "update_profile" : "add_profile", {name, profileName});
 
             return 0;
         }
 
+        // ak set --batch [-p <profile>]: NAME=VALUE, "unset NAME" or NDJSON
+        // {"name": ..., "value": ...} lines on stdin, applied as one transaction
+        int setBatchFromStdin(const core::Config &cfg, const std::vector<std::string> &args)
+        {
+            std::string profileName;
+            for (size_t i = 1; i < args.size(); ++i)
+            {
+                if ((args[i] == "--profile" || args[i] == "-p") && i + 1 < args.size())
+                {
+                    profileName = args[++i];
+                }
+                else if (args[i] != "--batch")
+                {
+                    core::error(cfg, "Usage: ak set --batch [-p|--profile <profile>] < changes");
+                }
+            }
+
+            // Nothing is written unless every line parses
+            storage::Transaction tx(cfg, profileName);
+            std::string line;
+            size_t lineNo = 0;
+            while (std::getline(std::cin, line))
+            {
+                ++lineNo;
+                std::string trimmed = core::trim(line);
+                if (trimmed.empty() || trimmed[0] == '#')
+                {
+                    continue;
+                }
+
+                std::string name, value;
+                bool removal = false;
+                if (trimmed[0] == '{')
+                {
+                    // {"name": ..., "value": ...} (or {"NAME": ...}) comes back as one pair
+                    try
+                    {
+                        auto pairs = storage::parse_json_min(trimmed);
+                        if (pairs.size() == 1)
+                        {
+                            name = pairs[0].first;
+                            value = pairs[0].second;
+                        }
+                    }
+                    catch (const std::exception &)
+                    {
+                        name.clear();
+                    }
+                }
+                else if (trimmed.rfind("unset ", 0) == 0)
+                {
+                    name = core::trim(trimmed.substr(6));
+                    removal = true;
+                }
+                else
+                {
+                    std::istringstream single(trimmed);
+                    auto pairs = storage::parse_env_file(single);
+                    if (!pairs.empty())
+                    {
+                        name = pairs[0].first;
+                        value = pairs[0].second;
+                    }
+                }
+
+                if (!storage::isValidKeyName(name) || (!removal && value.empty()))
+                {
+                    core::error(cfg, "Line " + std::to_string(lineNo) + ": expected NAME=VALUE, unset NAME or {\"name\":...,\"value\":...}");
+                }
+                if (removal)
+                {
+                    tx.remove(name);
+                }
+                else
+                {
+                    tx.put(name, value);
+                }
+            }
+
+            if (tx.empty())
+            {
+                core::ok(cfg, "No changes");
+                return 0;
+            }
+            tx.commit();
+
+            if (!profileName.empty())
+            {
+                std::string exports = makeExportsForProfile(cfg, profileName);
+                if (!exports.empty())
+                {
+                    storage::writeEncryptedBundle(cfg, profileName, exports);
+                }
+            }
+            refreshDirBundles(cfg);
+
+            const auto &stats = tx.stats();
+            std::string message = "Applied " + std::to_string(tx.touched().size()) + " change(s) (" +
+                                  std::to_string(stats.addedToVault) + " new, " +
+                                  std::to_string(stats.updatedInVault) + " updated, " +
+                                  std::to_string(stats.removedFromVault) + " removed)";
+            if (!profileName.empty())
+            {
+                message += " in vault and profile '" + profileName + "'";
+            }
+            core::ok(cfg, message);
+
+            std::vector<std::string> logKeys;
+            if (!profileName.empty())
+            {
+                logKeys.push_back(profileName);
+            }
+            logKeys.insert(logKeys.end(), tx.touched().begin(), tx.touched().end());
+            core::auditLog(cfg, "set_batch", logKeys);
+
+            return 0;
+        }
+
+        // Blobs are sealed with the vault passphrase unless the backend is plain
+        std::string blobPassphrase(const core::Config &cfg)
+        {
+            return storage::activeBackend(cfg) == storage::Backend::Plain ? cfg.presetPassphrase
+                                                                          : storage::sealingPassphrase(cfg);
+        }
+
+        // `ak set NAME --from-file PATH|-`: streamed into a blob, so the vault
+        // holds only its reference
+        int setBlobFromFile(const core::Config &cfg, const std::string &name, const std::string &path)
+        {
+            std::ifstream file;
+            if (path != "-")
+            {
+                file.open(path, std::ios::binary);
+                if (!file)
+                {
+                    core::error(cfg, "Cannot read " + path);
+                }
+            }
+            std::istream &in = path == "-" ? std::cin : file;
+
+            storage::BlobRef ref;
+            try
+            {
+                storage::BlobStore store(cfg, blobPassphrase(cfg));
+                ref = store.put(in);
+            }
+            catch (const std::exception &e)
+            {
+                core::error(cfg, e.what());
+            }
+
+            core::KeyStore ks = storage::loadVault(cfg);
+            ks.kv[name] = storage::formatBlobRef(ref);
+            storage::saveVault(cfg, ks);
+            refreshDirBundles(cfg);
+
+            core::success(cfg, "Successfully stored " + name + " (" + std::to_string(ref.size) + " bytes, as a blob)");
+            core::auditLog(cfg, "set", {name});
+
+            return 0;
+        }
+
         int cmd_set(const core::Config &cfg, const std::vector<std::string> &args)
         {
             if (args.size() < 2)
             {
-                core::error(cfg, "Usage: ak set <NAME> or ak set <NAME=VALUE>");
+                core::error(cfg, "Usage: ak set <NAME>, ak set <NAME=VALUE>, ak set <NAME> --from-file <file> or ak set --batch [-p <profile>] < changes");
+            }
+            if (args[1] == "--batch")
+            {
+                return setBatchFromStdin(cfg, args);
+            }
+
+            if (args.size() >= 4 && args[2] == "--from-file")
+            {
+                return setBlobFromFile(cfg, args[1], args[3]);
             }
 
             std::string input = args[1];
@@ -289,6 +691,7 @@ namespace ak
             core::KeyStore ks = storage::loadVault(cfg);
             ks.kv[name] = value;
             storage::saveVault(cfg, ks);
+            refreshDirBundles(cfg);
 
             core::success(cfg, "Successfully stored " + name);
             core::auditLog(cfg, "set", {name});
@@ -296,34 +699,157 @@ namespace ak
             return 0;
         }
 
+        // What listings show for a value: masked, or the size of a blob
+        std::string maskForListing(std::string_view value)
+        {
+            storage::BlobRef ref;
+            if (storage::parseBlobRef(value, ref))
+            {
+                return "[blob, " + std::to_string(ref.size) + " bytes]";
+            }
+            return core::maskValue(value);
+        }
+
+        // Created owner-only; `exclusive` fails instead of reusing an existing file
+        int openPrivateFile(const std::string &path, bool exclusive)
+        {
+#ifdef _WIN32
+            int flags = _O_WRONLY | _O_CREAT | _O_BINARY | (exclusive ? _O_EXCL : _O_TRUNC);
+            return ::_open(path.c_str(), flags, _S_IREAD | _S_IWRITE);
+#else
+            int flags = O_WRONLY | O_CREAT | O_CLOEXEC | (exclusive ? O_EXCL : O_TRUNC);
+            return ::open(path.c_str(), flags, 0600);
+#endif
+        }
+
+        // Flushed to disk and closed; false when either failed
+        bool closePrivateFile(int fd)
+        {
+#ifdef _WIN32
+            return ::_close(fd) == 0;
+#else
+            bool synced = ::fsync(fd) == 0;
+            return ::close(fd) == 0 && synced;
+#endif
+        }
+
+        // Writes a value to `fd` as it is stored: a blob a segment at a time
+        // (straight out of its mapping when unsealed), anything else whole
+        bool writeValue(const core::Config &cfg, const std::string &value, int fd)
+        {
+            ExportSink sink(fd);
+            storage::BlobRef ref;
+            if (!storage::parseBlobRef(value, ref))
+            {
+                sink.write(value);
+                return sink.flush();
+            }
+            storage::BlobStore store(cfg, blobPassphrase(cfg));
+            bool read = store.stream(ref, [&](std::string_view piece) {
+                sink.write(piece);
+                return sink.ok();
+            });
+            return sink.flush() && read;
+        }
+
+        // $XDG_RUNTIME_DIR or /dev/shm when there is one: memory-backed, so the
+        // value never reaches a disk
+        std::string runtimeFileFor(const std::string &name)
+        {
+            std::error_code ec;
+            std::filesystem::path dir = std::filesystem::temp_directory_path(ec);
+            std::string runtime = core::getenvs("XDG_RUNTIME_DIR");
+            if (!runtime.empty() && std::filesystem::is_directory(runtime, ec))
+            {
+                dir = runtime;
+            }
+            else if (std::filesystem::is_directory("/dev/shm", ec))
+            {
+                dir = "/dev/shm";
+            }
+            std::random_device rd;
+            char tag[9];
+            std::snprintf(tag, sizeof(tag), "%08x", static_cast<unsigned>(rd()));
+            return (dir / ("ak-" + name + "-" + tag)).string();
+        }
+
         int cmd_get(const core::Config &cfg, const std::vector<std::string> &args)
         {
             if (args.size() < 2)
             {
-                core::error(cfg, "Usage: ak get <NAME> [--full|--reveal]");
+                core::error(cfg, "Usage: ak get <NAME> [--full|--reveal] [--to-file [<file>]]");
             }
 
             std::string name = args[1];
             bool full = false;
+            bool toFile = false;
+            std::string outputPath;
 
-            // Check for --full or --reveal flags
             for (size_t i = 2; i < args.size(); ++i)
             {
                 if (args[i] == "--full" || args[i] == "--reveal")
                 {
                     full = true;
-                    break;
+                }
+                else if (args[i] == "--to-file")
+                {
+                    toFile = true;
+                    if (i + 1 < args.size() && args[i + 1].rfind("-", 0) != 0)
+                    {
+                        outputPath = args[++i];
+                    }
                 }
             }
 
-            core::KeyStore ks = storage::loadVault(cfg);
+            core::KeyStore ks = loadVaultPreferAgent(cfg);
             auto it = ks.kv.find(name);
             if (it == ks.kv.end())
             {
                 core::error(cfg, name + " not found.");
             }
+            storage::BlobRef ref;
+            bool blob = storage::parseBlobRef(it->second, ref);
 
-            std::cout << (full ? it->second : core::maskValue(it->second)) << "\n";
+            if (toFile)
+            {
+                // A named file is replaced only once complete; the runtime file
+                // is new, so it is written in place
+                bool named = !outputPath.empty();
+                std::string path = named ? outputPath : runtimeFileFor(name);
+                std::string target = named ? system::uniqueTmpPath(path) : path;
+                int fd = openPrivateFile(target, !named);
+                if (fd < 0)
+                {
+                    core::error(cfg, "Failed to write " + path);
+                }
+                bool written = writeValue(cfg, it->second, fd);
+                written = closePrivateFile(fd) && written;
+                std::error_code ec;
+                if (written && named)
+                {
+                    std::filesystem::rename(target, path, ec);
+                    written = !ec;
+                }
+                if (!written)
+                {
+                    std::filesystem::remove(target, ec);
+                    core::error(cfg, "Failed to write " + name + " to " + path);
+                }
+                std::cout << path << "\n";
+            }
+            else if (full && blob)
+            {
+                // Exactly the stored bytes; no newline is added
+                std::cout.flush();
+                if (!writeValue(cfg, it->second, STDOUT_FILENO))
+                {
+                    core::error(cfg, "Failed to read the blob value of " + name);
+                }
+            }
+            else
+            {
+                std::cout << (full ? it->second : maskForListing(it->second)) << "\n";
+            }
             core::auditLog(cfg, "get", {name});
 
             return 0;
@@ -347,28 +873,30 @@ namespace ak
                 }
             }
 
-            core::KeyStore ks = storage::loadVault(cfg);
+            // Sorted already; values are only needed for masking
+            storage::KeyTable table = storage::loadVaultTable(cfg);
             std::vector<std::string> names;
-            names.reserve(ks.kv.size());
-
-            for (const auto &pair : ks.kv)
+            names.reserve(table.size());
+            for (const auto &entry : table.entries())
             {
-                names.push_back(pair.first);
+                names.emplace_back(entry.name);
             }
-            std::sort(names.begin(), names.end());
 
             core::auditLog(cfg, "ls", names);
+            // Names are already decrypted here; keeps completion current for
+            // vaults written before the completion index existed
+            storage::recordVaultNames(cfg, names);
 
             if (jsonOutput || cfg.json)
             {
                 std::cout << "[";
                 bool first = true;
-                for (const auto &name : names)
+                for (const auto &entry : table.entries())
                 {
                     if (!first)
                         std::cout << ",";
                     first = false;
-                    std::cout << "{\"name\":\"" << name << "\",\"masked\":\"" << core::maskValue(ks.kv[name]) << "\"}";
+                    std::cout << "{\"name\":\"" << entry.name << "\",\"masked\":\"" << maskForListing(entry.value) << "\"}";
                 }
                 std::cout << "]\n";
             }
@@ -389,10 +917,10 @@ namespace ak
                 }
 
                 std::cout << ui::colorize("📂 Available Keys:", ui::Colors::BRIGHT_MAGENTA) << "\n";
-                for (const auto &name : names)
+                for (const auto &entry : table.entries())
                 {
-                    std::string keyName = ui::colorize(name, ui::Colors::BRIGHT_CYAN);
-                    std::string maskedValue = ui::colorize(core::maskValue(ks.kv[name]), ui::Colors::BRIGHT_BLACK);
+                    std::string keyName = ui::colorize(std::string(entry.name), ui::Colors::BRIGHT_CYAN);
+                    std::string maskedValue = ui::colorize(maskForListing(entry.value), ui::Colors::BRIGHT_BLACK);
                     std::cout << "  " << std::left << std::setw(42) << keyName << " " << maskedValue << "\n";
                 }
 
@@ -433,6 +961,8 @@ namespace ak
                 if (std::filesystem::exists(profilePath))
                 {
                     std::filesystem::remove(profilePath);
+                    storage::bumpGeneration(cfg);
+                    refreshDirBundles(cfg);
                     core::success(cfg, "Successfully removed profile '" + profileName + "'");
                     core::auditLog(cfg, "rm_profile", {profileName});
                 }
@@ -452,6 +982,7 @@ namespace ak
             }
 
             storage::saveVault(cfg, ks);
+            refreshDirBundles(cfg);
             core::success(cfg, "Successfully removed " + name);
             core::auditLog(cfg, "rm", {name});
 
@@ -460,41 +991,129 @@ namespace ak
 
         int cmd_search(const core::Config &cfg, const std::vector<std::string> &args)
         {
-            if (args.size() < 2)
+            const std::string usage = "Usage: ak search <PATTERN> [--glob|--regex|--fuzzy] [--profile <name>] [--json]";
+            std::string query;
+            std::string profile;
+            bool modeGiven = false;
+            storage::KeyMatch givenMode = storage::KeyMatch::Substring;
+            bool jsonOutput = cfg.json;
+            for (size_t i = 1; i < args.size(); ++i)
+            {
+                if (args[i] == "--glob")
+                {
+                    modeGiven = true;
+                    givenMode = storage::KeyMatch::Glob;
+                }
+                else if (args[i] == "--regex")
+                {
+                    modeGiven = true;
+                    givenMode = storage::KeyMatch::Regex;
+                }
+                else if (args[i] == "--fuzzy")
+                {
+                    modeGiven = true;
+                    givenMode = storage::KeyMatch::Fuzzy;
+                }
+                else if ((args[i] == "--profile" || args[i] == "-p") && i + 1 < args.size())
+                {
+                    profile = args[++i];
+                }
+                else if (args[i] == "--json")
+                {
+                    jsonOutput = true;
+                }
+                else if (query.empty())
+                {
+                    query = args[i];
+                }
+                else
+                {
+                    core::error(cfg, usage);
+                }
+            }
+            if (query.empty())
             {
-                core::error(cfg, "Usage: ak search <PATTERN>");
+                core::error(cfg, usage);
             }
 
-            std::string pattern = args[1];
-            core::KeyStore ks = storage::loadVault(cfg);
-            std::vector<std::string> hits;
+            std::string pattern;
+            storage::KeyMatch mode = storage::parseKeyQuery(query, pattern);
+            if (modeGiven)
+            {
+                mode = givenMode;
+                pattern = query;
+            }
 
-            for (const auto &pair : ks.kv)
+            // Names, profiles and services only; no value is decrypted
+            std::vector<storage::KeySearchHit> hits;
+            try
             {
-                if (core::icontains(pair.first, pattern))
+                storage::KeySearchIndex index(cfg);
+                index.refresh();
+                index.save();
+                hits = index.search(pattern, mode, profile);
+            }
+            catch (const std::exception &e)
+            {
+                core::error(cfg, e.what());
+            }
+
+            std::vector<std::string> names;
+            names.reserve(hits.size());
+            for (const auto &hit : hits)
+            {
+                names.push_back(hit.name);
+            }
+            core::auditLog(cfg, "search", names);
+
+            if (jsonOutput)
+            {
+                std::cout << "[";
+                for (size_t i = 0; i < hits.size(); ++i)
                 {
-                    hits.push_back(pair.first);
+                    const auto &hit = hits[i];
+                    std::cout << (i ? "," : "") << "{\"name\":\"" << hit.name << "\",\"service\":\"" << hit.service
+                              << "\",\"profiles\":[";
+                    for (size_t j = 0; j < hit.profiles.size(); ++j)
+                    {
+                        std::cout << (j ? "," : "") << "\"" << hit.profiles[j] << "\"";
+                    }
+                    std::cout << "],\"modified\":" << hit.modified / 1000000000LL;
+                    if (mode == storage::KeyMatch::Fuzzy)
+                    {
+                        std::cout << ",\"score\":" << std::fixed << std::setprecision(2) << hit.score;
+                    }
+                    std::cout << "}";
                 }
+                std::cout << "]\n";
+                return 0;
             }
 
             if (hits.empty())
             {
-                core::info(cfg, "No keys found matching pattern '" + pattern + "'");
+                core::info(cfg, "No keys found matching pattern '" + query + "'");
                 return 0;
             }
 
-            std::sort(hits.begin(), hits.end());
-
-            std::cout << ui::colorize("🔍 Found " + std::to_string(hits.size()) + " key" + (hits.size() == 1 ? "" : "s") + " matching '" + pattern + "':", ui::Colors::BRIGHT_BLUE) << "\n";
+            std::cout << ui::colorize("🔍 Found " + std::to_string(hits.size()) + " key" + (hits.size() == 1 ? "" : "s") + " matching '" + query + "':", ui::Colors::BRIGHT_BLUE) << "\n";
 
             for (const auto &hit : hits)
             {
-                std::string keyName = ui::colorize(hit, ui::Colors::BRIGHT_CYAN);
-                std::string maskedValue = ui::colorize(core::maskValue(ks.kv[hit]), ui::Colors::BRIGHT_BLACK);
-                std::cout << "  " << std::left << std::setw(42) << keyName << " " << maskedValue << "\n";
-            }
+                std::string profiles;
+                for (const auto &name : hit.profiles)
+                {
+                    profiles += (profiles.empty() ? "" : ", ") + name;
+                }
+                std::time_t when = static_cast<std::time_t>(hit.modified / 1000000000LL);
+                std::ostringstream modified;
+                modified << std::put_time(std::localtime(&when), "%Y-%m-%d %H:%M");
 
-            core::auditLog(cfg, "search", hits);
+                std::string keyName = ui::colorize(hit.name, ui::Colors::BRIGHT_CYAN);
+                std::cout << "  " << std::left << std::setw(42) << keyName << " "
+                          << std::setw(14) << (hit.service.empty() ? "-" : hit.service) << " "
+                          << ui::colorize(profiles, ui::Colors::BRIGHT_GREEN) << " "
+                          << ui::colorize(modified.str(), ui::Colors::BRIGHT_BLACK) << "\n";
+            }
             return 0;
         }
 
@@ -604,6 +1223,7 @@ namespace ak
             }
 
             storage::writeProfile(cfg, profile, names);
+            refreshDirBundles(cfg);
             core::success(cfg, "Successfully saved profile '" + profile + "' with " + std::to_string(names.size()) + " key" + (names.size() == 1 ? "" : "s"));
             core::auditLog(cfg, "save_profile", names);
 
@@ -613,7 +1233,7 @@ namespace ak
         int cmd_profiles(const core::Config &cfg, const std::vector<std::string> &args)
         {
             (void)args; // Parameter intentionally unused
-            auto profiles = storage::listProfiles(cfg);
+            auto profiles = storage::listProfileSummaries(cfg);
 
             if (profiles.empty())
             {
@@ -623,16 +1243,15 @@ namespace ak
 
             std::cout << ui::colorize("📁 Available Profiles:", ui::Colors::BRIGHT_MAGENTA) << "\n";
 
-            for (const auto &name : profiles)
+            for (const auto &profile : profiles)
             {
-                // Get profile keys count
-                auto keys = storage::readProfile(cfg, name);
-                std::string profileName = ui::colorize(name, ui::Colors::BRIGHT_CYAN);
-                std::string keyInfo = ui::colorize(std::to_string(keys.size()) + " key" + (keys.size() == 1 ? "" : "s"), ui::Colors::DIM);
+                std::string profileName = ui::colorize(profile.name, ui::Colors::BRIGHT_CYAN);
+                std::string keyInfo = ui::colorize(std::to_string(profile.keyCount) + " key" + (profile.keyCount == 1 ? "" : "s"), ui::Colors::DIM);
 
                 // Show key names if not too many
-                if (keys.size() <= 3 && !keys.empty())
+                if (profile.keyCount <= 3 && profile.keyCount > 0)
                 {
+                    auto keys = storage::readProfile(cfg, profile.name);
                     std::string keyList = "";
                     for (size_t i = 0; i < keys.size(); ++i)
                     {
@@ -661,9 +1280,234 @@ namespace ak
 
         int cmd_backend(const core::Config &cfg, const std::vector<std::string> &args)
         {
-            (void)args; // Parameter intentionally unused
-            std::cout << ((cfg.gpgAvailable && !cfg.forcePlain) ? "gpg" : "plain") << "\n";
+            if (args.size() < 2)
+            {
+                std::cout << storage::backendName(storage::activeBackend(cfg)) << "\n";
+                return 0;
+            }
+
+            if (args[1] == "list")
+            {
+                for (auto backend : {storage::Backend::Gpg, storage::Backend::Aead, storage::Backend::Plain})
+                {
+                    std::cout << storage::backendName(backend)
+                              << (backend == storage::activeBackend(cfg) ? " (active)" : "")
+                              << (storage::backendSupported(cfg, backend) ? "" : " (unavailable)") << "\n";
+                }
+                return 0;
+            }
+
+            storage::Backend backend;
+            if (args[1] != "set" || args.size() < 3 || !storage::parseBackend(args[2], backend))
+            {
+                core::error(cfg, "Usage: ak backend [list|set <gpg|aead|plain>]");
+            }
+            if (!storage::backendSupported(cfg, backend))
+            {
+                core::error(cfg, std::string("Backend '") + storage::backendName(backend) + "' is not available in this build/environment");
+            }
+
+            storage::writeBackendSetting(cfg, backend);
+            core::auditLog(cfg, "backend", {storage::backendName(backend)});
+            core::ok(cfg, std::string("Backend set to ") + storage::backendName(backend));
+            std::cerr << "💡 New writes use " << storage::backendName(backend)
+                      << "; run 'ak migrate --to " << storage::backendName(backend)
+                      << "' to convert existing profiles now.\n";
+            return 0;
+        }
+
+        int cmd_sync(const core::Config &cfg, const std::vector<std::string> &args)
+        {
+            std::string sub = args.size() > 1 ? args[1] : "";
+            if (sub == "remote")
+            {
+                if (args.size() < 3)
+                {
+                    std::string url = storage::remoteSetting(cfg);
+                    std::cout << (url.empty() ? "(none)" : url) << "\n";
+                    return 0;
+                }
+                std::string url = args[2] == "--clear" ? "" : args[2];
+                if (!url.empty())
+                {
+                    try
+                    {
+                        storage::openRemote(url);
+                    }
+                    catch (const std::exception &e)
+                    {
+                        core::error(cfg, e.what());
+                    }
+                }
+                storage::writeRemoteSetting(cfg, url);
+                core::auditLog(cfg, "sync_remote", {url});
+                core::ok(cfg, url.empty() ? "Remote cleared" : "Remote set to " + url);
+                return 0;
+            }
+
+            storage::SyncMode mode = storage::SyncMode::Both;
+            if (sub == "pull")
+                mode = storage::SyncMode::Pull;
+            else if (sub == "push")
+                mode = storage::SyncMode::Push;
+            else if (sub == "status")
+                mode = storage::SyncMode::Status;
+            else if (!sub.empty())
+                core::error(cfg, "Usage: ak sync [pull|push|status|remote <url>|remote --clear]");
+
+            std::string url = storage::remoteSetting(cfg);
+            if (url.empty())
+            {
+                core::error(cfg, "No remote configured; run 'ak sync remote <url>' or set AK_REMOTE");
+            }
+            storage::SyncReport report;
+            try
+            {
+                auto remote = storage::openRemote(url);
+                report = storage::syncProfiles(cfg, *remote, mode);
+            }
+            catch (const std::exception &e)
+            {
+                core::error(cfg, "Sync failed: " + std::string(e.what()));
+            }
+
+            for (const auto &change : report.changes)
+            {
+                std::cout << "  " << ui::colorize(change.profile, ui::Colors::BRIGHT_CYAN) << "  " << change.action << "\n";
+            }
+            std::string summary = std::to_string(report.profiles) + " profile(s), " + std::to_string(report.requests) +
+                                  " request(s)";
+            if (mode == storage::SyncMode::Status)
+            {
+                std::cout << (report.changes.empty() ? "Up to date" : "Pending changes") << " (" << summary << ")\n";
+                return 0;
+            }
+            if (!report.changes.empty())
+            {
+                core::auditLog(cfg, "sync", {url});
+            }
+            core::ok(cfg, (report.changes.empty() ? "Up to date (" : "Synced (") + summary + ")");
+            return 0;
+        }
+
+        int cmd_agent(const core::Config &cfg, const std::vector<std::string> &args)
+        {
+            std::string sub = args.size() > 1 ? args[1] : "status";
+            int ttl = agent::DEFAULT_TTL_SECONDS;
+            bool foreground = false;
+            try
+            {
+                ttl = std::stoi(core::getenvs("AK_AGENT_TTL", std::to_string(ttl)));
+            }
+            catch (const std::exception &)
+            {
+            }
+            for (size_t i = 2; i < args.size(); ++i)
+            {
+                if (args[i] == "--ttl" && i + 1 < args.size())
+                {
+                    try
+                    {
+                        ttl = std::stoi(args[++i]);
+                    }
+                    catch (const std::exception &)
+                    {
+                        core::error(cfg, "Invalid --ttl value: " + args[i]);
+                    }
+                }
+                else if (args[i] == "--foreground")
+                {
+                    foreground = true;
+                }
+            }
+
+            if (sub == "status")
+            {
+                std::string info;
+                if (!agent::status(cfg, info))
+                {
+                    std::cout << "agent: not running\n";
+                    return 1;
+                }
+                std::cout << "agent: running (" << info << ")\n";
+                std::cout << "socket: " << agent::socketPath(cfg) << "\n";
+                return 0;
+            }
+            if (sub == "stop")
+            {
+                if (!agent::stop(cfg))
+                {
+                    core::warn(cfg, "No agent running");
+                    return 1;
+                }
+                core::ok(cfg, "Agent stopped");
+                return 0;
+            }
+            if (sub != "start")
+            {
+                core::error(cfg, "Usage: ak agent <start|stop|status> [--ttl SECONDS] [--foreground]");
+            }
+
+            if (agent::ping(cfg))
+            {
+                core::ok(cfg, "Agent already running");
+                return 0;
+            }
+
+            // Unlock once, up front; the daemon has no terminal to ask on
+            core::Config agentCfg = cfg;
+            if (agentCfg.presetPassphrase.empty() && storage::activeBackend(cfg) != storage::Backend::Plain)
+            {
+                agentCfg.presetPassphrase = system::promptSecret("🔐 Vault passphrase: ");
+            }
+            std::map<std::string, std::string> probe;
+            if (!storage::tryLoadProfileKeys(agentCfg, storage::getDefaultProfileName(), probe))
+            {
+                core::error(cfg, "Could not unlock the default profile - agent not started");
+            }
+            probe.clear();
+
+            if (foreground)
+            {
+                return agent::serve(agentCfg, ttl);
+            }
+
+#ifdef __unix__
+            pid_t pid = fork();
+            if (pid < 0)
+            {
+                core::error(cfg, "Failed to start agent");
+            }
+            if (pid == 0)
+            {
+                setsid();
+                int devnull = open("/dev/null", O_RDWR);
+                if (devnull >= 0)
+                {
+                    dup2(devnull, STDIN_FILENO);
+                    dup2(devnull, STDOUT_FILENO);
+                    dup2(devnull, STDERR_FILENO);
+                    close(devnull);
+                }
+                _exit(agent::serve(agentCfg, ttl));
+            }
+
+            // Wait briefly for the socket to come up
+            for (int i = 0; i < 50 && !agent::ping(cfg); ++i)
+            {
+                usleep(20000);
+            }
+            if (!agent::ping(cfg))
+            {
+                core::error(cfg, "Agent failed to start");
+            }
+            core::auditLog(cfg, "agent_start", {});
+            core::ok(cfg, "Agent started (pid " + std::to_string(pid) + ", idle timeout " + std::to_string(ttl) + "s)");
             return 0;
+#else
+            core::error(cfg, "The key agent is only supported on Unix-like systems");
+            return 1;
+#endif
         }
 
         int cmd_help(const core::Config &cfg, const std::vector<std::string> &args)
@@ -741,9 +1585,9 @@ namespace ak
                     // Copy all profiles and vault
                     try
                     {
-                        if (std::filesystem::exists(cfg.vaultPath))
+                        if (std::filesystem::exists(cfg.vaultPath.get()))
                         {
-                            std::filesystem::copy_file(cfg.vaultPath, backupDir + "/keys.env.gpg");
+                            std::filesystem::copy_file(cfg.vaultPath.get(), backupDir + "/keys.env.gpg");
                         }
                         if (std::filesystem::exists(cfg.profilesDir))
                         {
@@ -778,9 +1622,9 @@ namespace ak
                 int deletedItems = 0;
 
                 // Remove vault file
-                if (std::filesystem::exists(cfg.vaultPath))
+                if (std::filesystem::exists(cfg.vaultPath.get()))
                 {
-                    std::filesystem::remove(cfg.vaultPath);
+                    std::filesystem::remove(cfg.vaultPath.get());
                     deletedItems++;
                 }
 
@@ -843,35 +1687,46 @@ namespace ak
                 }
             }
 
-            // Check if it's a profile first
+            // Check if it's a profile (or a "base,local" list of them) first
             auto profiles = storage::listProfiles(cfg);
-            bool isProfile = std::find(profiles.begin(), profiles.end(), name) != profiles.end();
+            auto layers = parseLayers(name);
+            bool isProfile = !layers.empty() &&
+                             std::all_of(layers.begin(), layers.end(), [&](const std::string &layer)
+                                         { return std::find(profiles.begin(), profiles.end(), layer) != profiles.end(); });
 
             std::string exports;
 
             if (isProfile)
             {
-                // Load profile
-                exports = makeExportsForProfile(cfg, name);
+                // Load profile layers; later ones win
+                exports = makeExports(resolveLayers(cfg, layers).values());
 
                 if (persist)
                 {
                     // Get current directory and store profile for persistence
                     std::string currentDir = system::getCwd();
                     auto existingProfiles = storage::readDirProfiles(cfg, currentDir);
-                    if (std::find(existingProfiles.begin(), existingProfiles.end(), name) == existingProfiles.end())
+                    bool changed = false;
+                    for (const auto &layer : layers)
+                    {
+                        if (std::find(existingProfiles.begin(), existingProfiles.end(), layer) == existingProfiles.end())
+                        {
+                            existingProfiles.push_back(layer);
+                            changed = true;
+                        }
+                    }
+                    if (changed)
                     {
-                        existingProfiles.push_back(name);
                         storage::writeDirProfiles(cfg, currentDir, existingProfiles);
                     }
                 }
 
-                core::auditLog(cfg, "load_profile", {name});
+                core::auditLog(cfg, "load_profile", layers);
             }
             else
             {
                 // Try to load as individual key
-                core::KeyStore ks = storage::loadVault(cfg);
+                core::KeyStore ks = loadVaultPreferAgent(cfg);
                 auto it = ks.kv.find(name);
                 if (it == ks.kv.end())
                 {
@@ -879,25 +1734,7 @@ namespace ak
                 }
 
                 // Create export statement for single key
-                std::string value = it->second;
-                std::string escaped;
-                escaped.reserve(value.size() * 2);
-
-                for (char c : value)
-                {
-                    if (c == '\\' || c == '"')
-                    {
-                        escaped.push_back('\\');
-                    }
-                    if (c == '\n')
-                    {
-                        escaped += "\\n";
-                        continue;
-                    }
-                    escaped.push_back(c);
-                }
-
-                exports = "export " + name + "=\"" + escaped + "\"\n";
+                exports = exportLine(name, it->second);
 
                 if (persist)
                 {
@@ -919,6 +1756,11 @@ namespace ak
                 core::auditLog(cfg, "load_key", {name});
             }
 
+            if (persist)
+            {
+                refreshDirBundles(cfg);
+            }
+
             // Enhanced interactive shell detection
             bool isInteractive = false;
             std::string currentShell = "unknown";
@@ -1068,11 +1910,181 @@ namespace ak
             return 0;
         }
 
-        // Placeholder implementations for complex commands
+        // Double-quoted with JSON escapes; also a valid YAML double-quoted scalar
+        std::string quoteJsonString(const std::string &value)
+        {
+            std::string out = "\"";
+            for (unsigned char c : value)
+            {
+                switch (c)
+                {
+                case '"':
+                    out += "\\\"";
+                    break;
+                case '\\':
+                    out += "\\\\";
+                    break;
+                case '\n':
+                    out += "\\n";
+                    break;
+                case '\r':
+                    out += "\\r";
+                    break;
+                case '\t':
+                    out += "\\t";
+                    break;
+                default:
+                    if (c < 0x20)
+                    {
+                        char buf[8];
+                        std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+                        out += buf;
+                    }
+                    else
+                    {
+                        out += static_cast<char>(c);
+                    }
+                }
+            }
+            return out + "\"";
+        }
+
+        // "base,local" -> "base-local": a valid Kubernetes object name
+        std::string defaultSecretName(const std::string &spec)
+        {
+            std::string name;
+            for (char c : spec)
+            {
+                char lower = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+                bool fine = (lower >= 'a' && lower <= 'z') || (lower >= '0' && lower <= '9') || lower == '.';
+                name += fine ? lower : '-';
+            }
+            return name;
+        }
+
         int cmd_export(const core::Config &cfg, const std::vector<std::string> &args)
         {
-            (void)args; // Parameter intentionally unused
-            core::ok(cfg, "Export command - implementation needed");
+            std::string spec;
+            std::string format = "env";
+            std::string outputPath;
+            commands::ExportOptions options;
+            for (size_t i = 1; i < args.size(); ++i)
+            {
+                if ((args[i] == "--profile" || args[i] == "-p") && i + 1 < args.size())
+                {
+                    spec = args[++i];
+                }
+                else if ((args[i] == "--format" || args[i] == "-f") && i + 1 < args.size())
+                {
+                    format = args[++i];
+                }
+                else if ((args[i] == "--output" || args[i] == "-o") && i + 1 < args.size())
+                {
+                    outputPath = args[++i];
+                }
+                else if (args[i] == "--name" && i + 1 < args.size())
+                {
+                    options.secretName = args[++i];
+                }
+                else if (args[i] == "--namespace" && i + 1 < args.size())
+                {
+                    options.secretNamespace = args[++i];
+                }
+            }
+            if (spec.empty())
+            {
+                core::error(cfg, "Usage: ak export --profile|-p <profile>[,<profile>...] [--format|-f <format>] [--output|-o <file>] [--name <secret>] [--namespace <ns>]");
+            }
+            if (options.secretName.empty())
+            {
+                options.secretName = defaultSecretName(spec);
+            }
+            auto writer = makeExportWriter(format, options);
+            if (!writer)
+            {
+                std::string supported;
+                for (const auto &name : exportFormats())
+                {
+                    supported += (supported.empty() ? "" : ", ") + name;
+                }
+                core::error(cfg, "Unsupported format '" + format + "'. Supported formats: " + supported);
+            }
+
+            auto layers = parseLayers(spec);
+            auto known = storage::listProfiles(cfg);
+            for (const auto &layer : layers)
+            {
+                if (std::find(known.begin(), known.end(), layer) == known.end())
+                {
+                    core::error(cfg, "Profile '" + layer + "' not found");
+                }
+            }
+
+            // Streamed a buffer at a time; a file is written under a private
+            // temporary name and only replaces `outputPath` once complete
+            bool toFile = !outputPath.empty() && outputPath != "-";
+            std::string tmpPath = toFile ? system::uniqueTmpPath(outputPath) : "";
+            int fd = STDOUT_FILENO;
+            if (toFile)
+            {
+                fd = openPrivateFile(tmpPath, false);
+                if (fd < 0)
+                {
+                    core::error(cfg, "Failed to write " + outputPath);
+                }
+            }
+            else
+            {
+                std::cout.flush();
+            }
+
+            size_t count = 0;
+            std::string failure;
+            {
+                ExportSink sink(fd);
+                try
+                {
+                    count = streamExport(cfg, layers, *writer, sink);
+                }
+                catch (const std::exception &e)
+                {
+                    failure = e.what();
+                }
+                if (failure.empty() && !sink.ok())
+                {
+                    failure = "Failed to write " + (toFile ? outputPath : std::string("output"));
+                }
+            }
+            if (toFile)
+            {
+                std::error_code ec;
+                bool closed = closePrivateFile(fd);
+                if (failure.empty() && !closed)
+                {
+                    failure = "Failed to write " + outputPath;
+                }
+                if (failure.empty())
+                {
+                    std::filesystem::rename(tmpPath, outputPath, ec);
+                    if (ec)
+                    {
+                        failure = "Failed to replace " + outputPath;
+                    }
+                }
+                if (!failure.empty())
+                {
+                    std::filesystem::remove(tmpPath, ec);
+                }
+            }
+            if (!failure.empty())
+            {
+                core::error(cfg, failure);
+            }
+            if (toFile)
+            {
+                core::ok(cfg, "Exported " + std::to_string(count) + " key(s) to " + outputPath);
+            }
+            core::auditLog(cfg, "export", layers);
             return 0;
         }
 
@@ -1123,7 +2135,8 @@ namespace ak
             }
 
             // Validate format
-            if (format != "env" && format != "dotenv" && format != "json" && format != "yaml")
+            storage::ImportFormat importFormat;
+            if (!storage::parseImportFormat(format, importFormat))
             {
                 core::error(cfg, "Unsupported format '" + format + "'. Supported formats: env, dotenv, json, yaml");
             }
@@ -1133,209 +2146,421 @@ namespace ak
             {
                 core::error(cfg, "File not found: " + filePath);
             }
+            std::ifstream file(filePath, std::ios::binary);
+            if (!file.is_open())
+            {
+                core::error(cfg, "Failed to open file: " + filePath);
+            }
 
-            // Parse the file based on format
-            std::vector<std::pair<std::string, std::string>> keyValuePairs;
-
+            // Stream the file straight into one transaction: nothing is
+            // written unless the whole file parses
+            std::unordered_set<std::string> knownKeys;
+            if (keysOnly)
+            {
+                knownKeys = services::getKnownServiceKeys();
+            }
+            storage::Transaction tx(cfg, profileName);
+            size_t parsed = 0;
+            size_t imported = 0;
             try
             {
-                if (format == "env" || format == "dotenv")
-                {
-                    std::ifstream file(filePath);
-                    if (!file.is_open())
-                    {
-                        core::error(cfg, "Failed to open file: " + filePath);
-                    }
-                    keyValuePairs = storage::parse_env_file(file);
-                }
-                else if (format == "json")
-                {
-                    std::ifstream file(filePath);
-                    if (!file.is_open())
-                    {
-                        core::error(cfg, "Failed to open file: " + filePath);
-                    }
-                    std::ostringstream buffer;
-                    buffer << file.rdbuf();
-                    keyValuePairs = storage::parse_json_min(buffer.str());
-                }
-                else if (format == "yaml")
-                {
-                    // Simple YAML parsing - just handle key: value pairs
-                    std::ifstream file(filePath);
-                    if (!file.is_open())
-                    {
-                        core::error(cfg, "Failed to open file: " + filePath);
-                    }
+                storage::importStream(file, importFormat, [&](std::string key, std::string value)
+                                      {
+                                          ++parsed;
+                                          if (value.empty() || (keysOnly && !knownKeys.count(key)))
+                                          {
+                                              return;
+                                          }
+                                          tx.put(key, value);
+                                          ++imported;
+                                      });
+            }
+            catch (const std::exception &e)
+            {
+                core::error(cfg, "Failed to parse file: " + std::string(e.what()));
+            }
 
-                    std::string line;
-                    while (std::getline(file, line))
-                    {
-                        line = core::trim(line);
-                        if (line.empty() || line[0] == '#')
-                        {
-                            continue;
-                        }
+            if (parsed == 0)
+            {
+                core::error(cfg, "No valid key-value pairs found in file");
+            }
+            if (keysOnly && imported == 0)
+            {
+                core::error(cfg, "No known service provider keys found in file");
+            }
 
-                        auto colon = line.find(':');
-                        if (colon == std::string::npos)
-                        {
-                            continue;
-                        }
+            tx.commit();
+            const auto &stats = tx.stats();
 
-                        std::string key = core::trim(line.substr(0, colon));
-                        std::string value = core::trim(line.substr(colon + 1));
+            // Generate updated exports for the profile
+            std::string exports = makeExportsForProfile(cfg, profileName);
+            if (!exports.empty())
+            {
+                storage::writeEncryptedBundle(cfg, profileName, exports);
+            }
+            refreshDirBundles(cfg);
 
-                        // Remove quotes if present
-                        if (!value.empty() && ((value.front() == '"' && value.back() == '"') ||
-                                               (value.front() == '\'' && value.back() == '\'')))
-                        {
-                            value = value.substr(1, value.size() - 2);
-                        }
+            // Provide feedback
+            std::string message = "Imported " + std::to_string(imported) + " key(s) to profile '" + profileName + "' ";
+            message += "(" + std::to_string(stats.addedToVault) + " new in vault, " + std::to_string(stats.updatedInVault) + " updated in vault, ";
+            message += std::to_string(stats.addedToProfile) + " new in profile)";
 
-                        // Validate key name
-                        if (!key.empty() && (std::isalpha(key[0]) || key[0] == '_'))
-                        {
-                            bool validKey = true;
-                            for (char c : key)
-                            {
-                                if (!std::isalnum(c) && c != '_')
-                                {
-                                    validKey = false;
-                                    break;
-                                }
-                            }
-                            if (validKey)
-                            {
-                                keyValuePairs.push_back({key, value});
-                            }
-                        }
-                    }
-                }
+            if (keysOnly)
+            {
+                message += " [known service keys only]";
+            }
+
+            core::ok(cfg, message);
+
+            // Log the operation
+            std::vector<std::string> logKeys;
+            logKeys.reserve(tx.touched().size() + 1);
+            logKeys.push_back(profileName);
+            logKeys.insert(logKeys.end(), tx.touched().begin(), tx.touched().end());
+            core::auditLog(cfg, "import", logKeys);
+
+            return 0;
+        }
+
+        // "--jobs N" / "--jobs=N" at args[i]; advances i past the value
+        bool parseJobsOption(const core::Config &cfg, const std::vector<std::string> &args, size_t &i, size_t &jobs)
+        {
+            std::string value;
+            if (args[i] == "--jobs" && i + 1 < args.size())
+            {
+                value = args[++i];
+            }
+            else if (args[i].rfind("--jobs=", 0) == 0)
+            {
+                value = args[i].substr(7);
+            }
+            else
+            {
+                return false;
+            }
+            char *endp = nullptr;
+            unsigned long n = std::strtoul(value.c_str(), &endp, 10);
+            if (value.empty() || *endp != '\0' || n == 0 || n > 256)
+            {
+                core::error(cfg, "--jobs takes a number from 1 to 256");
+            }
+            jobs = n;
+            return true;
+        }
+
+        // Runs the rekey pipeline and reports it; one audit entry per run,
+        // whatever it covered
+        int runRekey(const core::Config &cfg, const core::Config &src, const core::Config &dst,
+                     const storage::RekeyOptions &options, const std::string &action)
+        {
+            std::string pending = storage::pendingRekeyTarget(cfg);
+            if (!pending.empty())
+            {
+                core::info(cfg, "Resuming the unfinished run recorded in " + storage::rekeyJournalPath(cfg));
+            }
+            storage::RekeyReport report;
+            try
+            {
+                report = storage::rekeyAll(src, dst, options);
             }
             catch (const std::exception &e)
             {
-                core::error(cfg, "Failed to parse file: " + std::string(e.what()));
+                core::error(cfg, e.what());
             }
 
-            if (keyValuePairs.empty())
+            std::string backend = storage::backendName(storage::activeBackend(dst));
+            std::string summary = std::to_string(report.profiles) + " profile(s)" +
+                                  (report.vault ? ", the vault" : "") + " and " +
+                                  std::to_string(report.objects) + " stored object(s)";
+            core::auditLog(cfg, action, {backend});
+            if (!report.complete())
             {
-                core::error(cfg, "No valid key-value pairs found in file");
+                for (const auto &item : report.failed)
+                {
+                    core::warn(cfg, "Could not re-encrypt " + item);
+                }
+                core::warn(cfg, std::to_string(report.failed.size()) + " item(s) kept their old encryption; run the command again to resume");
+                return 1;
             }
+            core::ok(cfg, (action == "rekey" ? "Re-encrypted " : "Migrated ") + summary + " to " + backend +
+                              (report.resumed ? " (" + std::to_string(report.resumed) + " finished earlier)" : ""));
+            return 0;
+        }
 
-            // Filter for known service keys if --keys flag is used
-            if (keysOnly)
+        int cmd_migrate(const core::Config &cfg, const std::vector<std::string> &args)
+        {
+            // ak migrate --to <gpg|aead|plain> [--keep] [--jobs N]
+            // Re-encrypts the legacy vault, every profile and the stored objects
+            // with the target backend and makes it the active one. Old files are
+            // removed only once every item has been swapped and verified.
+            std::string target;
+            storage::RekeyOptions options;
+            for (size_t i = 1; i < args.size(); ++i)
+            {
+                if (args[i] == "--to" && i + 1 < args.size())
+                {
+                    target = args[++i];
+                }
+                else if (args[i].rfind("--to=", 0) == 0)
+                {
+                    target = args[i].substr(5);
+                }
+                else if (args[i] == "--keep")
+                {
+                    options.keepOld = true;
+                }
+                else if (args[i] == "--parallel")
+                {
+                    // the default; accepted for scripts that spell it out
+                }
+                else if (!parseJobsOption(cfg, args, i, options.jobs))
+                {
+                    core::error(cfg, "Unknown argument '" + args[i] + "'. Usage: ak migrate --to <gpg|aead|plain> [--keep] [--jobs N]");
+                }
+            }
+
+            storage::Backend backend;
+            if (target.empty() || !storage::parseBackend(target, backend))
+            {
+                core::error(cfg, "Usage: ak migrate --to <gpg|aead|plain> [--keep] [--jobs N]");
+            }
+            if (!storage::backendSupported(cfg, backend))
             {
-                auto knownKeys = services::getKnownServiceKeys();
-                auto filtered = keyValuePairs;
-                keyValuePairs.clear();
+                core::error(cfg, std::string("Backend '") + storage::backendName(backend) + "' is not available in this build/environment");
+            }
 
-                for (const auto &[key, value] : filtered)
+            core::Config src = cfg;
+            if (src.presetPassphrase.empty() &&
+                (backend != storage::Backend::Plain || storage::activeBackend(cfg) != storage::Backend::Plain))
+            {
+                src.presetPassphrase = system::promptSecret("🔐 Vault passphrase: ");
+                if (src.presetPassphrase.empty())
                 {
-                    if (knownKeys.find(key) != knownKeys.end())
-                    {
-                        keyValuePairs.push_back({key, value});
-                    }
+                    core::error(cfg, "A passphrase is required (set AK_PASSPHRASE)");
                 }
+            }
+            core::Config dst = src;
+            dst.forcePlain = false;
+            dst.backend = storage::backendName(backend);
+            dst.vaultPath = storage::vaultPathFor(dst, backend);
+            return runRekey(cfg, src, dst, options, "migrate");
+        }
 
-                if (keyValuePairs.empty())
+        int cmd_rekey(const core::Config &cfg, const std::vector<std::string> &args)
+        {
+            // ak rekey [--jobs N]
+            // Re-encrypts everything under a new passphrase, keeping the backend
+            storage::RekeyOptions options;
+            for (size_t i = 1; i < args.size(); ++i)
+            {
+                if (!parseJobsOption(cfg, args, i, options.jobs))
                 {
-                    core::error(cfg, "No known service provider keys found in file");
+                    core::error(cfg, "Usage: ak rekey [--jobs N]");
                 }
             }
+            storage::Backend backend = storage::activeBackend(cfg);
+            if (backend == storage::Backend::Plain)
+            {
+                core::error(cfg, "The plain backend has no passphrase; use 'ak migrate --to aead' to encrypt");
+            }
 
-            // Load existing vault and profile
-            core::KeyStore ks = storage::loadVault(cfg);
-            std::vector<std::string> profileKeys = storage::readProfile(cfg, profileName);
-            auto profileKeyMap = storage::loadProfileKeys(cfg, profileName);
+            core::Config src = cfg;
+            if (src.presetPassphrase.empty())
+            {
+                src.presetPassphrase = system::promptSecret("🔐 Current passphrase: ");
+            }
+            core::Config dst = cfg;
+            const char *preset = std::getenv("AK_NEW_PASSPHRASE");
+            if (preset && *preset)
+            {
+                dst.presetPassphrase = preset;
+            }
+            else
+            {
+                dst.presetPassphrase = system::promptSecret("🔐 New passphrase: ");
+                if (system::promptSecret("🔐 Repeat the new passphrase: ") != dst.presetPassphrase)
+                {
+                    core::error(cfg, "The passphrases do not match");
+                }
+            }
+            if (src.presetPassphrase.empty() || dst.presetPassphrase.empty())
+            {
+                core::error(cfg, "A passphrase is required (set AK_PASSPHRASE and AK_NEW_PASSPHRASE)");
+            }
+            int rc = runRekey(cfg, src, dst, options, "rekey");
+            if (rc == 0)
+            {
+                core::info(cfg, "Use the new passphrase from now on (update AK_PASSPHRASE if it is set)");
+            }
+            return rc;
+        }
 
-            // Track what we're doing
-            int addedToVault = 0;
-            int updatedInVault = 0;
-            int addedToProfile = 0;
+        // Environment for `ak run`: the current one with each profile's values
+        // applied in order, so later profiles win
+        std::vector<std::string> runEnvironment(const core::Config &cfg, const std::vector<std::string> &profiles)
+        {
+            return system::mergeEnvironment(resolveLayers(cfg, profiles).values());
+        }
 
-            // Add each key-value pair
-            for (const auto &[key, value] : keyValuePairs)
+        int cmd_run(const core::Config &cfg, const std::vector<std::string> &args)
+        {
+            const std::string usage = "Usage: ak run [--profile <name>[,<name>...]] [--watch] -- <command> [args...]";
+            std::vector<std::string> profiles;
+            bool watch = false;
+            size_t i = 1;
+            for (; i < args.size(); ++i)
             {
-                if (key.empty() || value.empty())
+                std::string list;
+                if ((args[i] == "--profile" || args[i] == "-p") && i + 1 < args.size())
+                {
+                    list = args[++i];
+                }
+                else if (args[i].rfind("--profile=", 0) == 0)
                 {
+                    list = args[i].substr(10);
+                }
+                else if (args[i] == "--watch" || args[i] == "-w")
+                {
+                    watch = true;
                     continue;
                 }
-
-                // Check if key exists in vault
-                bool keyExistsInVault = ks.kv.find(key) != ks.kv.end();
-                bool keyExistsInProfile = std::find(profileKeys.begin(), profileKeys.end(), key) != profileKeys.end();
-
-                // Add/update in vault
-                ks.kv[key] = value;
-                if (keyExistsInVault)
+                else if (args[i] == "--")
                 {
-                    updatedInVault++;
+                    ++i;
+                    break;
                 }
                 else
                 {
-                    addedToVault++;
+                    break; // the command starts here
                 }
-
-                // Also store/update value in the profile-scoped encrypted keystore
-                profileKeyMap[key] = value;
-
-                // Add to profile if not already there
-                if (!keyExistsInProfile)
+                auto layers = parseLayers(list);
+                profiles.insert(profiles.end(), layers.begin(), layers.end());
+            }
+            std::vector<std::string> command(args.begin() + static_cast<std::ptrdiff_t>(i), args.end());
+            if (command.empty())
+            {
+                core::error(cfg, usage);
+            }
+            if (profiles.empty())
+            {
+                profiles.push_back(storage::getDefaultProfileName());
+            }
+            auto known = storage::listProfiles(cfg);
+            for (const auto &profile : profiles)
+            {
+                if (std::find(known.begin(), known.end(), profile) == known.end())
                 {
-                    profileKeys.push_back(key);
-                    addedToProfile++;
+                    core::error(cfg, "Profile '" + profile + "' not found");
                 }
             }
+            core::auditLog(cfg, "run", profiles);
 
-            // Save vault and profile + profile key map
-            storage::saveVault(cfg, ks);
-            storage::writeProfile(cfg, profileName, profileKeys);
-            storage::saveProfileKeys(cfg, profileName, profileKeyMap);
+            std::vector<std::string> env = runEnvironment(cfg, profiles);
+            std::cout.flush();
+            std::cerr.flush();
 
-            // Generate updated exports for the profile
-            std::string exports = makeExportsForProfile(cfg, profileName);
-            if (!exports.empty())
+            if (!watch)
             {
-                storage::writeEncryptedBundle(cfg, profileName, exports);
+                int rc = system::execProcess(command, env);
+#ifdef _WIN32
+                if (rc != 127)
+                {
+                    return rc;
+                }
+#endif
+                core::error(cfg, (rc == 127 ? "Command not found: " : "Cannot execute: ") + command[0], rc);
             }
 
-            // Provide feedback
-            std::string message = "Imported " + std::to_string(keyValuePairs.size()) + " key(s) to profile '" + profileName + "' ";
-            message += "(" + std::to_string(addedToVault) + " new in vault, " + std::to_string(updatedInVault) + " updated in vault, ";
-            message += std::to_string(addedToProfile) + " new in profile)";
-
-            if (keysOnly)
+            // --watch: supervise the child and restart it whenever the resolved
+            // values change. The generation moves on every write, so polling it
+            // is one small read.
+            system::ChildProcess child;
+            if (!system::spawnProcess(command, env, child))
             {
-                message += " [known service keys only]";
+                core::error(cfg, "Command not found: " + command[0], 127);
             }
+#ifndef _WIN32
+            // Ctrl-C reaches the child through the terminal; let it decide
+            std::signal(SIGINT, SIG_IGN);
+#endif
+            std::string generation = storage::readGeneration(cfg);
+            int exitCode = 0;
+            while (!system::waitProcess(child, 500, exitCode))
+            {
+                std::string current = storage::readGeneration(cfg);
+                if (current == generation)
+                {
+                    continue;
+                }
+                generation = current;
+                std::vector<std::string> next = runEnvironment(cfg, profiles);
+                if (next == env)
+                {
+                    continue;
+                }
+                env = std::move(next);
+                core::info(cfg, "Profile changed; restarting " + command[0]);
+                system::stopProcess(child, 5000);
+                if (!system::spawnProcess(command, env, child))
+                {
+                    core::error(cfg, "Command not found: " + command[0], 127);
+                }
+            }
+            return exitCode;
+        }
 
-            core::ok(cfg, message);
-
-            // Log the operation
-            std::vector<std::string> logKeys;
-            logKeys.reserve(keyValuePairs.size() + 1);
-            logKeys.push_back(profileName);
-            for (const auto &[key, value] : keyValuePairs)
+        // Filters stdin to stdout with every secret of the chosen profiles (all
+        // of them by default) replaced by [REDACTED]
+        int cmd_redact(const core::Config &cfg, const std::vector<std::string> &args)
+        {
+            std::vector<std::string> layers;
+            for (size_t i = 1; i < args.size(); ++i)
+            {
+                if ((args[i] == "--profile" || args[i] == "-p") && i + 1 < args.size())
+                {
+                    auto more = parseLayers(args[++i]);
+                    layers.insert(layers.end(), more.begin(), more.end());
+                }
+                else
+                {
+                    core::error(cfg, "Usage: ak redact [--profile|-p <profile>[,<profile>...]] < input");
+                }
+            }
+            auto known = storage::listProfiles(cfg);
+            if (layers.empty())
+            {
+                layers = known;
+            }
+            for (const auto &layer : layers)
             {
-                logKeys.push_back(key);
+                if (std::find(known.begin(), known.end(), layer) == known.end())
+                {
+                    core::error(cfg, "Profile '" + layer + "' not found");
+                }
             }
-            core::auditLog(cfg, "import", logKeys);
-
-            return 0;
-        }
 
-        int cmd_migrate(const core::Config &cfg, const std::vector<std::string> &args)
-        {
-            (void)args; // Parameter intentionally unused
-            core::ok(cfg, "Migrate command - implementation needed");
-            return 0;
-        }
+            // Every layer's values, not just the merged ones: a shadowed value
+            // is still a secret. Very short values would match everywhere.
+            const size_t minLength = 4;
+            std::unordered_set<std::string> seen;
+            std::vector<std::string> secrets;
+            LayeredEnv layered = resolveLayers(cfg, layers);
+            for (const auto &values : layered.perLayer)
+            {
+                for (const auto &entry : values)
+                {
+                    if (entry.second.size() >= minLength && seen.insert(entry.second).second)
+                    {
+                        secrets.push_back(entry.second);
+                    }
+                }
+            }
 
-        int cmd_run(const core::Config &cfg, const std::vector<std::string> &args)
-        {
-            (void)args; // Parameter intentionally unused
-            core::ok(cfg, "Run command - implementation needed");
+            core::Redactor redactor(secrets);
+            if (!redactor.redactStream(STDIN_FILENO, STDOUT_FILENO))
+            {
+                core::error(cfg, "Failed to redact input: " + std::string(std::strerror(errno)));
+            }
             return 0;
         }
 
@@ -1404,6 +2629,10 @@ namespace ak
             std::string providerOverride;
             std::vector<std::string> specificServices;
             std::vector<std::string> specificKeys;
+            bool allProfiles = false;
+            services::TestSchedule schedule;
+            schedule.useCache = true;
+            int watchSeconds = 0; // --watch [S]: monitor, probing healthy keys about every S seconds
 
             for (size_t i = 1; i < args.size(); ++i)
             {
@@ -1419,6 +2648,50 @@ namespace ak
                 {
                     debugMode = true;
                 }
+                else if (args[i] == "--all-profiles")
+                {
+                    allProfiles = true;
+                }
+                else if (args[i] == "-j" || args[i] == "--jobs")
+                {
+                    if (i + 1 < args.size())
+                    {
+                        try
+                        {
+                            schedule.workers = static_cast<size_t>(std::max(1, std::stoi(args[i + 1])));
+                        }
+                        catch (const std::exception &)
+                        {
+                            core::error(cfg, "Invalid value for --jobs: " + args[i + 1]);
+                        }
+                        i++;
+                    }
+                }
+                else if (args[i] == "--no-cache")
+                {
+                    schedule.refreshCache = true;
+                }
+                else if (args[i] == "--watch" || args[i] == "-w")
+                {
+                    watchSeconds = 300;
+                    if (i + 1 < args.size() && !args[i + 1].empty() && std::all_of(args[i + 1].begin(), args[i + 1].end(), ::isdigit))
+                    {
+                        watchSeconds = std::max(1, std::atoi(args[i + 1].c_str()));
+                        i++;
+                    }
+                }
+                else if (args[i] == "--max-age")
+                {
+                    if (i + 1 < args.size())
+                    {
+                        schedule.maxAgeSeconds = services::parseMaxAge(args[i + 1]);
+                        if (schedule.maxAgeSeconds < 0)
+                        {
+                            core::error(cfg, "Invalid value for --max-age: " + args[i + 1] + " (use e.g. 90, 30m, 2h, 1d)");
+                        }
+                        i++;
+                    }
+                }
                 else if (args[i].substr(0, 11) == "--provider=")
                 {
                     providerOverride = args[i].substr(11);
@@ -1520,10 +2793,9 @@ namespace ak
 
                 // Get display name
                 std::string displayName = result.service;
-                auto builtinIt = services::DEFAULT_SERVICES.find(result.service);
-                if (builtinIt != services::DEFAULT_SERVICES.end())
+                if (const auto *builtin = services::findBuiltinService(result.service))
                 {
-                    displayName = builtinIt->second.description;
+                    displayName = std::string(builtin->description);
                 }
                 else if (!result.service.empty())
                 {
@@ -1566,15 +2838,56 @@ namespace ak
                 return result.ok ? 0 : 1;
             }
 
+            // Every profile's configured services as one pipeline
+            std::vector<services::TestJob> jobs;
+            if (allProfiles)
+            {
+                auto allServices = services::loadAllServices(cfg);
+                for (const auto &profile : storage::listProfiles(cfg))
+                {
+                    auto profileValues = storage::loadProfileKeysCached(cfg, profile);
+                    for (const auto &service : services::detectConfiguredServices(cfg, profile))
+                    {
+                        auto it = allServices.find(service);
+                        if (it == allServices.end())
+                            continue;
+                        // Same names the single-profile lookup tries
+                        std::vector<std::string> keyNames = {it->second.keyName};
+                        if (service == "gemini")
+                        {
+                            keyNames = services::googleKeyNames();
+                        }
+                        for (const auto &keyName : keyNames)
+                        {
+                            auto keyIt = profileValues->find(keyName);
+                            if (keyIt != profileValues->end() && !keyIt->second.empty())
+                            {
+                                jobs.push_back({service, profile});
+                                break;
+                            }
+                        }
+                    }
+                }
+                if (jobs.empty())
+                {
+                    // Under --json no jobs means no result lines, not a different shape
+                    if (!cfg.json)
+                    {
+                        std::cerr << "ℹ️  No testable services found in any profile.\n";
+                    }
+                    return 0;
+                }
+            }
             // Determine what to test based on arguments
-            if (!profileName.empty())
+            else if (!profileName.empty())
             {
                 // Test profile keys: ./ak test -p default
                 try
                 {
                     auto profileKeys = storage::readProfile(cfg, profileName);
-                    auto vault = storage::loadVault(cfg);
-                    auto profileValues = storage::loadProfileKeys(cfg, profileName);
+                    auto profileValues = storage::loadProfileKeysCached(cfg, profileName);
+                    // The legacy vault is only decrypted if some key isn't in its profile
+                    std::unique_ptr<core::KeyStore> vault;
 
                     // Map profile keys to services they belong to
                     for (const auto &keyName : profileKeys)
@@ -1585,18 +2898,18 @@ namespace ak
                             {
                                 // Check if key exists in profile store, vault, or environment
                                 bool hasKey = false;
-                                if (profileValues.find(keyName) != profileValues.end())
-                                {
-                                    hasKey = true;
-                                }
-                                else if (vault.kv.find(keyName) != vault.kv.end())
+                                if (profileValues->find(keyName) != profileValues->end())
                                 {
                                     hasKey = true;
                                 }
                                 else
                                 {
+                                    if (!vault)
+                                    {
+                                        vault = std::make_unique<core::KeyStore>(loadVaultPreferAgent(cfg));
+                                    }
                                     const char *envValue = getenv(keyName.c_str());
-                                    hasKey = (envValue && *envValue);
+                                    hasKey = vault->kv.count(keyName) || (envValue && *envValue);
                                 }
 
                                 if (hasKey && std::find(servicesToTest.begin(), servicesToTest.end(), service) == servicesToTest.end())
@@ -1610,11 +2923,7 @@ namespace ak
 
                     if (servicesToTest.empty())
                     {
-                        if (cfg.json)
-                        {
-                            std::cout << "[]\n";
-                        }
-                        else
+                        if (!cfg.json)
                         {
                             std::cerr << "ℹ️  No testable services found in profile '" << profileName << "'.\n";
                         }
@@ -1708,11 +3017,7 @@ namespace ak
 
                 if (servicesToTest.empty())
                 {
-                    if (cfg.json)
-                    {
-                        std::cout << "[]\n";
-                    }
-                    else
+                    if (!cfg.json)
                     {
                         std::cerr << "ℹ️  No services to test.\n";
                     }
@@ -1720,13 +3025,54 @@ namespace ak
                 }
             }
 
+            for (const auto &service : servicesToTest)
+            {
+                jobs.push_back({service, profileName});
+            }
+
             // Run the tests
-            if (!cfg.json && servicesToTest.size() > 1)
+            if (!cfg.json && jobs.size() > 1)
             {
-                core::working(cfg, "Testing " + std::to_string(servicesToTest.size()) + " API connections...");
+                core::working(cfg, "Testing " + std::to_string(jobs.size()) + " API connections...");
             }
 
-            auto results = services::run_tests_parallel(cfg, servicesToTest, failFast, profileName, debugMode);
+            schedule.failFast = failFast;
+            schedule.debug = debugMode;
+
+            // Display names: built-in description, else the custom service's description or name
+            std::map<std::string, services::Service> knownServices;
+            bool knownServicesLoaded = true;
+            try
+            {
+                knownServices = services::loadAllServices(cfg);
+            }
+            catch (const std::exception &)
+            {
+                knownServicesLoaded = false;
+            }
+            auto displayNameFor = [&](const std::string &service)
+            {
+                std::string name = service;
+                if (const auto *builtin = services::findBuiltinService(service))
+                {
+                    return std::string(builtin->description);
+                }
+                if (!knownServicesLoaded)
+                {
+                    // Fallback: capitalize first letter
+                    if (!name.empty())
+                    {
+                        name[0] = std::toupper(name[0]);
+                    }
+                    return name;
+                }
+                auto customIt = knownServices.find(service);
+                if (customIt != knownServices.end() && !customIt->second.isBuiltIn)
+                {
+                    name = customIt->second.description.empty() ? customIt->second.name : customIt->second.description;
+                }
+                return name;
+            };
 
             auto printDebugInfo = [&](const std::string &indent, const services::TestResult &res) {
                 if (!debugMode)
@@ -1772,221 +3118,149 @@ namespace ak
                 }
             };
 
-            // Output results
-            if (cfg.json)
+            auto cachedNote = [](const services::TestResult &res) -> std::string
             {
-                std::cout << "[";
-                bool first = true;
-                for (const auto &result : results)
-                {
-                    if (!first)
-                        std::cout << ",";
-                    first = false;
-                    std::cout << "{\"service\":\"" << result.service << "\",\"ok\":"
-                              << (result.ok ? "true" : "false") << "}";
-                }
-                std::cout << "]\n";
-            }
-            else
+                return res.cached ? " " + ui::colorize("(cached)", ui::Colors::DIM) : "";
+            };
+
+            // Render each result as soon as it completes (NDJSON under --json)
+            int passed = 0;
+            int failed = 0;
+            size_t delivered = 0;
+            auto renderResult = [&](const services::TestJob &, const services::TestResult &result)
             {
-                for (const auto &result : results)
+                ++delivered;
+                if (result.ok)
+                    passed++;
+                else
+                    failed++;
+
+                if (cfg.json)
                 {
-                    if (servicesToTest.size() == 1)
-                    {
-                        // Single service test - show detailed steps like in demo
-                        // Get service display name
-                        std::string serviceName = result.service;
+                    std::cout << services::toJsonLine(result) << "\n" << std::flush;
+                    return;
+                }
 
-                        // Check built-in services first
-                        auto builtinIt = services::DEFAULT_SERVICES.find(result.service);
-                        if (builtinIt != services::DEFAULT_SERVICES.end())
-                        {
-                            serviceName = builtinIt->second.description;
-                        }
-                        else
-                        {
-                            // Check custom services
-                            try
-                            {
-                                auto allServices = services::loadAllServices(cfg);
-                                std::vector<services::Service> customServices;
-                                for (const auto &[name, service] : allServices)
-                                {
-                                    if (!service.isBuiltIn)
-                                    {
-                                        customServices.push_back(service);
-                                    }
-                                }
-                                for (const auto &customService : customServices)
-                                {
-                                    if (customService.name == result.service)
-                                    {
-                                        serviceName = customService.description.empty() ? customService.name : customService.description;
-                                        break;
-                                    }
-                                }
-                            }
-                            catch (const std::exception &)
-                            {
-                                // Fallback: capitalize first letter
-                                if (!serviceName.empty())
-                                {
-                                    serviceName[0] = std::toupper(serviceName[0]);
-                                }
-                            }
-                        }
+                std::string serviceName = displayNameFor(result.service);
+                if (jobs.size() == 1)
+                {
+                    // Single service test - show detailed steps like in demo
+                    std::cout << ui::colorize("🧪 Testing " + serviceName + " API connection...", ui::Colors::BRIGHT_YELLOW) << "\n";
 
-                        std::cout << ui::colorize("🧪 Testing " + serviceName + " API connection...", ui::Colors::BRIGHT_YELLOW) << "\n";
+                    // Show the actual steps being performed based on what test_one() does
+                    std::cout << ui::colorize("├── Finding API key...", ui::Colors::DIM) << " ";
+                    std::cout << ui::colorize("✓", ui::Colors::BRIGHT_GREEN) << "\n";
 
-                        // Show the actual steps being performed based on what test_one() does
-                        std::cout << ui::colorize("├── Finding API key...", ui::Colors::DIM) << " ";
+                    std::cout << ui::colorize("├── Connecting to API endpoint...", ui::Colors::DIM) << " ";
+                    if (result.ok)
+                    {
                         std::cout << ui::colorize("✓", ui::Colors::BRIGHT_GREEN) << "\n";
-
-                        std::cout << ui::colorize("├── Connecting to API endpoint...", ui::Colors::DIM) << " ";
-                        if (result.ok)
-                        {
-                            std::cout << ui::colorize("✓", ui::Colors::BRIGHT_GREEN) << "\n";
-                            std::cout << ui::colorize("└── Verifying authentication...", ui::Colors::DIM) << " ";
-                            std::cout << ui::colorize("✓", ui::Colors::BRIGHT_GREEN) << "\n\n";
-                            std::cout << ui::colorize("✅ " + serviceName + " API: All tests passed!", ui::Colors::BRIGHT_GREEN) << "\n";
-                        }
-                        else
-                        {
-                            std::cout << ui::colorize("❌", ui::Colors::BRIGHT_RED) << "\n";
-                            std::cout << ui::colorize("└── Verifying authentication...", ui::Colors::DIM) << " ";
-                            std::cout << ui::colorize("❌", ui::Colors::BRIGHT_RED) << "\n\n";
-                            std::cout << ui::colorize("❌ " + serviceName + " API: " + (result.error_message.empty() ? "Test failed" : result.error_message), ui::Colors::BRIGHT_RED) << "\n";
-                        }
-
-                        printDebugInfo("    ", result);
+                        std::cout << ui::colorize("└── Verifying authentication...", ui::Colors::DIM) << " ";
+                        std::cout << ui::colorize("✓", ui::Colors::BRIGHT_GREEN) << "\n\n";
+                        std::cout << ui::colorize("✅ " + serviceName + " API: All tests passed!", ui::Colors::BRIGHT_GREEN) << cachedNote(result) << "\n";
                     }
                     else
                     {
-                        // Multiple services - show tree-like progress
-                        bool isLast = (&result == &results.back());
-                        std::string branch = isLast ? "└── " : "├── ";
-
-                        // Get display name for service (built-in or custom)
-                        std::string displayName = result.service;
-                        auto builtinIt2 = services::DEFAULT_SERVICES.find(result.service);
-                        if (builtinIt2 != services::DEFAULT_SERVICES.end())
-                        {
-                            displayName = builtinIt2->second.description;
-                        }
-                        else
-                        {
-                            // Check custom services
-                            try
-                            {
-                                auto allServices = services::loadAllServices(cfg);
-                                std::vector<services::Service> customServices;
-                                for (const auto &[name, service] : allServices)
-                                {
-                                    if (!service.isBuiltIn)
-                                    {
-                                        customServices.push_back(service);
-                                    }
-                                }
-                                for (const auto &customService : customServices)
-                                {
-                                    if (customService.name == result.service)
-                                    {
-                                        displayName = customService.description.empty() ? customService.name : customService.description;
-                                        break;
-                                    }
-                                }
-                            }
-                            catch (const std::exception &)
-                            {
-                                // Fallback: capitalize first letter
-                                if (!displayName.empty())
-                                {
-                                    displayName[0] = std::toupper(displayName[0]);
-                                }
-                            }
-                        }
-
-                        // Use the same display name logic as for single service
-                        std::string serviceName = result.service;
-                        auto builtinIter = services::DEFAULT_SERVICES.find(result.service);
-                        if (builtinIter != services::DEFAULT_SERVICES.end())
-                        {
-                            serviceName = builtinIter->second.description;
-                        }
-                        else
-                        {
-                            // Check custom services
-                            try
-                            {
-                                auto allServices = services::loadAllServices(cfg);
-                                std::vector<services::Service> customServices;
-                                for (const auto &[name, service] : allServices)
-                                {
-                                    if (!service.isBuiltIn)
-                                    {
-                                        customServices.push_back(service);
-                                    }
-                                }
-                                for (const auto &customService : customServices)
-                                {
-                                    if (customService.name == result.service)
-                                    {
-                                        serviceName = customService.description.empty() ? customService.name : customService.description;
-                                        break;
-                                    }
-                                }
-                            }
-                            catch (const std::exception &)
-                            {
-                                // Fallback: capitalize first letter
-                                if (!serviceName.empty())
-                                {
-                                    serviceName[0] = std::toupper(serviceName[0]);
-                                }
-                            }
-                        }
-
-                        std::cout << ui::colorize(branch + serviceName + "...", ui::Colors::DIM) << " ";
+                        std::cout << ui::colorize("❌", ui::Colors::BRIGHT_RED) << "\n";
+                        std::cout << ui::colorize("└── Verifying authentication...", ui::Colors::DIM) << " ";
+                        std::cout << ui::colorize("❌", ui::Colors::BRIGHT_RED) << "\n\n";
+                        std::cout << ui::colorize("❌ " + serviceName + " API: " + (result.error_message.empty() ? "Test failed" : result.error_message), ui::Colors::BRIGHT_RED) << cachedNote(result) << "\n";
+                    }
 
-                        if (result.ok)
-                        {
-                            std::cout << ui::colorize("✓", ui::Colors::BRIGHT_GREEN) << "\n";
-                        }
-                        else
-                        {
-                            std::cout << ui::colorize("❌", ui::Colors::BRIGHT_RED) << "\n";
-                        }
+                    printDebugInfo("    ", result);
+                }
+                else
+                {
+                    // Multiple services - tree-like progress in completion order
+                    bool isLast = (delivered == jobs.size());
+                    std::string branch = isLast ? "└── " : "├── ";
+                    if (allProfiles)
+                    {
+                        serviceName += " [" + result.profile + "]";
+                    }
+                    std::cout << ui::colorize(branch + serviceName + "...", ui::Colors::DIM) << " ";
 
-                        std::string childIndent = isLast ? "    " : "│   ";
-                        printDebugInfo(childIndent, result);
+                    if (result.ok)
+                    {
+                        std::cout << ui::colorize("✓", ui::Colors::BRIGHT_GREEN) << cachedNote(result) << "\n";
+                    }
+                    else
+                    {
+                        std::cout << ui::colorize("❌", ui::Colors::BRIGHT_RED) << cachedNote(result) << "\n";
                     }
+
+                    std::string childIndent = isLast ? "    " : "│   ";
+                    printDebugInfo(childIndent, result);
                 }
+                std::cout << std::flush;
+            };
 
-                // Summary for multiple tests
-                if (!cfg.json && servicesToTest.size() > 1)
+            if (watchSeconds > 0)
+            {
+                services::MonitorPolicy policy;
+                policy.healthyInterval = std::chrono::seconds(watchSeconds);
+                policy.failingInterval = std::chrono::seconds(std::max(5, watchSeconds / 5));
+                if (!cfg.json)
+                {
+                    std::cout << ui::colorize("👀 Watching " + std::to_string(jobs.size()) + " key(s); healthy every ~" + std::to_string(watchSeconds) + "s, failing every ~" + std::to_string(policy.failingInterval.count()) + "s, rate limits back off (Ctrl+C to stop)", ui::Colors::DIM) << "\n" << std::flush;
+                }
+                // Only health changes are printed
+                auto onChange = [&](const services::TestJob &job, const services::TestResult &result,
+                                    services::KeyHealth previous, const services::MonitorSchedule::State &state)
                 {
-                    int passed = 0;
-                    int failed = 0;
-                    for (const auto &result : results)
+                    core::metrics::count("ak_monitor_state_changes_total", {{"service", job.service}, {"state", services::healthName(state.health)}});
+                    if (cfg.json)
                     {
-                        if (result.ok)
-                            passed++;
-                        else
-                            failed++;
+                        std::string line = services::toJsonLine(result);
+                        std::cout << "{\"state\":\"" << services::healthName(state.health) << "\",\"previous\":\""
+                                  << services::healthName(previous) << "\"," << line.substr(1) << "\n" << std::flush;
+                        return;
                     }
+                    std::time_t now = std::time(nullptr);
+                    std::ostringstream when;
+                    when << std::put_time(std::localtime(&now), "%H:%M:%S");
+                    std::string name = displayNameFor(job.service) + (job.profile.empty() ? "" : " [" + job.profile + "]");
+                    long long nextIn = std::chrono::duration_cast<std::chrono::seconds>(state.next - services::MonitorSchedule::Clock::now()).count();
+                    std::string detail = result.ok ? "" : " — " + (result.error_message.empty() ? std::string("Test failed") : result.error_message);
+                    std::string nextNote = " " + ui::colorize("(next check in " + std::to_string(std::max(0LL, nextIn)) + "s)", ui::Colors::DIM);
+                    switch (state.health)
+                    {
+                    case services::KeyHealth::Healthy:
+                        std::cout << when.str() << " " << ui::colorize("✅ " + name + ": healthy", ui::Colors::BRIGHT_GREEN) << nextNote << "\n";
+                        break;
+                    case services::KeyHealth::Throttled:
+                        std::cout << when.str() << " " << ui::colorize("⏳ " + name + ": throttled" + detail, ui::Colors::BRIGHT_YELLOW) << nextNote << "\n";
+                        break;
+                    default:
+                        std::cout << when.str() << " " << ui::colorize("❌ " + name + ": failing" + detail, ui::Colors::BRIGHT_RED) << nextNote << "\n";
+                        break;
+                    }
+                    std::cout << std::flush;
+                };
+                services::runMonitor(cfg, jobs, schedule, policy, onChange, [&]() { publishMetrics(cfg); });
+                return 0;
+            }
+
+            services::run_test_jobs(cfg, jobs, schedule, renderResult);
 
-                    std::cout << "\n";
-                    if (failed == 0)
+            // Summary for multiple tests
+            if (!cfg.json && jobs.size() > 1)
+            {
+                std::cout << "\n";
+                if (failed == 0 && delivered == jobs.size())
+                {
+                    core::success(cfg, "All " + std::to_string(passed) + " API tests passed!");
+                }
+                else
+                {
+                    std::cout << ui::colorize("📊 Results: " + std::to_string(passed) + " passed, " + std::to_string(failed) + " failed", ui::Colors::BRIGHT_BLUE) << "\n";
+                    if (delivered < jobs.size())
                     {
-                        core::success(cfg, "All " + std::to_string(passed) + " API tests passed!");
+                        std::cout << ui::colorize("⏹️  Stopped after first failure; " + std::to_string(jobs.size() - delivered) + " not run.", ui::Colors::DIM) << "\n";
                     }
-                    else
+                    if (failed > 0 && !debugMode)
                     {
-                        std::cout << ui::colorize("📊 Results: " + std::to_string(passed) + " passed, " + std::to_string(failed) + " failed", ui::Colors::BRIGHT_BLUE) << "\n";
-                        if (!debugMode)
-                        {
-                            std::cout << ui::colorize("💡 Tip: re-run with '--debug' for detailed curl diagnostics.", ui::Colors::DIM) << "\n";
-                        }
+                        std::cout << ui::colorize("💡 Tip: re-run with '--debug' for detailed curl diagnostics.", ui::Colors::DIM) << "\n";
                     }
                 }
             }
@@ -1994,10 +3268,95 @@ namespace ak
             return 0;
         }
 
+        int cmd_monitor(const core::Config &cfg, const std::vector<std::string> &args)
+        {
+            std::vector<std::string> testArgs = args;
+            testArgs[0] = "test";
+            bool watching = false;
+            for (auto &arg : testArgs)
+            {
+                if (arg == "--interval")
+                {
+                    arg = "--watch";
+                }
+                watching = watching || arg == "--watch" || arg == "-w";
+            }
+            if (!watching)
+            {
+                testArgs.insert(testArgs.begin() + 1, "--watch");
+            }
+            return cmd_test(cfg, testArgs);
+        }
+
+        // `ak refresh` stops its provider tools on Ctrl-C instead of dying
+        // with them still running
+        std::atomic<bool> refreshCancelled{false};
+        // What each provider gets for its auth check and refresh together
+        // (AK_REFRESH_TIMEOUT, --timeout)
+        constexpr int DEFAULT_REFRESH_TIMEOUT_SECONDS = 30;
+
+        void onRefreshInterrupt(int)
+        {
+            refreshCancelled = true;
+        }
+
+        int parseSeconds(const std::string &text, int fallback)
+        {
+            try
+            {
+                return text.empty() ? fallback : std::stoi(text);
+            }
+            catch (const std::exception &)
+            {
+                return fallback;
+            }
+        }
+
+        struct RefreshOutcome
+        {
+            std::string token;
+            std::string problem; // why there is no token, for the report
+        };
+
+        // The provider's auth check, then its token command, both bounded by
+        // `deadline`
+        RefreshOutcome refreshWithCli(const std::vector<std::string> &checkArgs,
+                                      const std::vector<std::string> &refreshArgs,
+                                      std::chrono::steady_clock::time_point deadline)
+        {
+            RefreshOutcome outcome;
+            auto remainingMs = [&]()
+            {
+                auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+                return static_cast<int>(std::max<long long>(0, left));
+            };
+            auto explain = [&](const system::CaptureResult &run)
+            {
+                if (run.cancelled)
+                    outcome.problem = "was interrupted";
+                else if (run.timedOut)
+                    outcome.problem = "timed out";
+            };
+            auto check = system::captureProcess(checkArgs, remainingMs(), &refreshCancelled);
+            if (check.exitCode != 0 || core::trim(check.output).empty())
+            {
+                explain(check);
+                return outcome;
+            }
+            auto refresh = system::captureProcess(refreshArgs, remainingMs(), &refreshCancelled);
+            if (refresh.exitCode == 0)
+            {
+                outcome.token = core::trim(refresh.output);
+            }
+            explain(refresh);
+            return outcome;
+        }
+
         int cmd_refresh(const core::Config &cfg, const std::vector<std::string> &args)
         {
             std::string profileName;
             bool jsonOutput = cfg.json;
+            int timeoutSeconds = parseSeconds(core::getenvs("AK_REFRESH_TIMEOUT"), DEFAULT_REFRESH_TIMEOUT_SECONDS);
             
             // Parse arguments
             for (size_t i = 1; i < args.size(); ++i)
@@ -2010,6 +3369,14 @@ namespace ak
                         i++;
                     }
                 }
+                else if (args[i] == "--timeout" && i + 1 < args.size())
+                {
+                    timeoutSeconds = parseSeconds(args[++i], -1);
+                    if (timeoutSeconds <= 0)
+                    {
+                        core::error(cfg, "Invalid --timeout value: " + args[i]);
+                    }
+                }
             }
             
             if (profileName.empty())
@@ -2017,23 +3384,24 @@ namespace ak
                 profileName = storage::getDefaultProfileName();
             }
             
-            // Map of service names to CLI tools and their refresh commands
+            // Map of service names to CLI tools and their refresh commands.
+            // Commands are argv vectors run without a shell.
             struct CliProvider {
                 std::string cliTool;
-                std::string checkCmd;
-                std::string refreshCmd;
+                std::vector<std::string> checkArgs;
+                std::vector<std::string> refreshArgs;
                 std::string keyName;
                 std::string extractPattern; // Pattern to extract token from output
             };
             
             std::map<std::string, CliProvider> cliProviders = {
-                {"gcp", {"gcloud", "gcloud auth list --filter=status:ACTIVE --format=value(account)", 
-                         "gcloud auth print-access-token", "GOOGLE_APPLICATION_CREDENTIALS", ""}},
-                {"aws", {"aws", "aws sts get-caller-identity", 
-                         "aws configure get aws_access_key_id 2>/dev/null", 
+                {"gcp", {"gcloud", {"gcloud", "auth", "list", "--filter=status:ACTIVE", "--format=value(account)"},
+                         {"gcloud", "auth", "print-access-token"}, "GOOGLE_APPLICATION_CREDENTIALS", ""}},
+                {"aws", {"aws", {"aws", "sts", "get-caller-identity"},
+                         {"aws", "configure", "get", "aws_access_key_id"},
                          "AWS_ACCESS_KEY_ID", ""}},
-                {"azure", {"az", "az account show", 
-                          "az account get-access-token --query accessToken -o tsv", 
+                {"azure", {"az", {"az", "account", "show"},
+                          {"az", "account", "get-access-token", "--query", "accessToken", "-o", "tsv"},
                           "AZURE_CLIENT_ID", ""}},
             };
             
@@ -2074,7 +3442,8 @@ namespace ak
             };
             
             // Get all services in the profile
-            auto profileKeys = storage::loadProfileKeys(cfg, profileName);
+            auto profileBase = storage::loadProfileKeysCached(cfg, profileName);
+            const auto &profileKeys = *profileBase;
             auto allServices = services::loadAllServices(cfg);
             
             std::vector<std::string> cliRefreshed;
@@ -2087,6 +3456,16 @@ namespace ak
                           << ui::colorize(profileName, ui::Colors::BRIGHT_WHITE) << "\n\n";
             }
             
+            // Providers whose CLI is installed, refreshed concurrently below
+            struct RefreshJob
+            {
+                std::string serviceName;
+                const CliProvider *provider;
+                std::string toolPath;
+                std::future<RefreshOutcome> outcome;
+            };
+            std::vector<RefreshJob> jobs;
+            
             // Check each service
             for (const auto &[serviceName, service] : allServices)
             {
@@ -2094,7 +3473,8 @@ namespace ak
                 bool hasKey = false;
                 std::string keyName = service.keyName;
                 
-                if (profileKeys.find(keyName) != profileKeys.end() && !profileKeys[keyName].empty())
+                auto keyIt = profileKeys.find(keyName);
+                if (keyIt != profileKeys.end() && !keyIt->second.empty())
                 {
                     hasKey = true;
                 }
@@ -2117,82 +3497,15 @@ namespace ak
                 auto cliIt = cliProviders.find(serviceName);
                 if (cliIt != cliProviders.end())
                 {
-                    const auto &cliProvider = cliIt->second;
-                    
-                    // Check if CLI tool is available
-                    int exitCode = 0;
-                    std::string checkResult = system::runCmdCapture("which " + cliProvider.cliTool + " 2>/dev/null", &exitCode);
-                    
-                    if (exitCode == 0 && !checkResult.empty())
+                    // Resolved here rather than by forking `which`
+                    std::string toolPath = system::findExecutable(cliIt->second.cliTool);
+                    if (toolPath.empty())
                     {
-                        // Check if user is authenticated
-                        int authExitCode = 0;
-                        std::string authCheck = system::runCmdCapture(cliProvider.checkCmd + " 2>&1", &authExitCode);
-                        
-                        if (authExitCode == 0 && !authCheck.empty())
-                        {
-                            // Try to refresh token
-                            int refreshExitCode = 0;
-                            std::string tokenOutput = system::runCmdCapture(cliProvider.refreshCmd + " 2>&1", &refreshExitCode);
-                            
-                            if (refreshExitCode == 0 && !tokenOutput.empty())
-                            {
-                                // Extract token (trim whitespace)
-                                std::string token = tokenOutput;
-                                token.erase(0, token.find_first_not_of(" \t\n\r"));
-                                token.erase(token.find_last_not_of(" \t\n\r") + 1);
-                                            
-                                if (!token.empty())
-                                {
-                                    // Save the token to the profile
-                                    try
-                                    {
-                                        // Load existing profile keys
-                                        auto existingKeys = storage::loadProfileKeys(cfg, profileName);
-                                        existingKeys[cliProvider.keyName] = token;
-                                        storage::saveProfileKeys(cfg, profileName, existingKeys);
-                                        
-                                        // Also ensure the key is in the profile list
-                                        auto profileKeys = storage::readProfile(cfg, profileName);
-                                        if (std::find(profileKeys.begin(), profileKeys.end(), cliProvider.keyName) == profileKeys.end())
-                                        {
-                                            profileKeys.push_back(cliProvider.keyName);
-                                            storage::writeProfile(cfg, profileName, profileKeys);
-                                        }
-                                        
-                                        cliRefreshed.push_back(serviceName);
-                                        
-                                        if (!jsonOutput)
-                                        {
-                                            std::cout << ui::colorize("✅ ", ui::Colors::BRIGHT_GREEN) 
-                                                      << ui::colorize(service.description, ui::Colors::WHITE)
-                                                      << " - Token refreshed via " << cliProvider.cliTool << "\n";
-                                        }
-                                    }
-                                    catch (const std::exception &e)
-                                    {
-                                        if (!jsonOutput)
-                                        {
-                                            std::cout << ui::colorize("⚠️  ", ui::Colors::BRIGHT_YELLOW) 
-                                                      << ui::colorize(service.description, ui::Colors::WHITE)
-                                                      << " - Failed to save token: " << e.what() << "\n";
-                                        }
-                                    }
-                                }
-                            }
-                            else
-                            {
-                                needsManual.push_back(serviceName);
-                            }
-                        }
-                        else
-                        {
-                            needsManual.push_back(serviceName);
-                        }
+                        needsManual.push_back(serviceName);
                     }
                     else
                     {
-                        needsManual.push_back(serviceName);
+                        jobs.push_back({serviceName, &cliIt->second, toolPath, {}});
                     }
                 }
                 else
@@ -2210,6 +3523,94 @@ namespace ak
                 }
             }
             
+            // Each provider's auth check and refresh run on their own thread with
+            // one deadline for both; Ctrl-C stops every tool still running
+            refreshCancelled = false;
+            auto previousHandler = jobs.empty() ? SIG_DFL : std::signal(SIGINT, onRefreshInterrupt);
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(timeoutSeconds);
+            for (auto &job : jobs)
+            {
+                std::vector<std::string> check = job.provider->checkArgs;
+                std::vector<std::string> refresh = job.provider->refreshArgs;
+                check[0] = refresh[0] = job.toolPath;
+                job.outcome = std::async(std::launch::async, [check, refresh, deadline]()
+                                         { return refreshWithCli(check, refresh, deadline); });
+            }
+            
+            std::map<std::string, std::string> refreshedTokens;
+            for (auto &job : jobs)
+            {
+                RefreshOutcome outcome = job.outcome.get();
+                const auto &service = allServices.at(job.serviceName);
+                if (outcome.token.empty())
+                {
+                    needsManual.push_back(job.serviceName);
+                    if (!jsonOutput && !outcome.problem.empty())
+                    {
+                        std::cout << ui::colorize("⚠️  ", ui::Colors::BRIGHT_YELLOW)
+                                  << ui::colorize(service.description, ui::Colors::WHITE)
+                                  << " - " << job.provider->cliTool << " " << outcome.problem << "\n";
+                    }
+                    continue;
+                }
+                refreshedTokens[job.provider->keyName] = outcome.token;
+                cliRefreshed.push_back(job.serviceName);
+            }
+            if (!jobs.empty())
+            {
+                std::signal(SIGINT, previousHandler);
+            }
+            
+            // One profile write for every refreshed token, merged over whatever
+            // other writers saved while the tools ran
+            if (!refreshedTokens.empty())
+            {
+                try
+                {
+                    auto updated = profileKeys;
+                    for (const auto &[keyName, token] : refreshedTokens)
+                    {
+                        updated[keyName] = token;
+                    }
+                    storage::saveProfileKeys(cfg, profileName, updated, profileBase);
+                    
+                    // Also ensure the keys are in the profile list
+                    auto listed = storage::readProfile(cfg, profileName);
+                    const auto listedBefore = listed;
+                    for (const auto &entry : refreshedTokens)
+                    {
+                        if (std::find(listed.begin(), listed.end(), entry.first) == listed.end())
+                        {
+                            listed.push_back(entry.first);
+                        }
+                    }
+                    if (listed.size() != listedBefore.size())
+                    {
+                        storage::writeProfile(cfg, profileName, listed, &listedBefore);
+                    }
+                    refreshDirBundles(cfg);
+                    
+                    if (!jsonOutput)
+                    {
+                        for (const auto &serviceName : cliRefreshed)
+                        {
+                            std::cout << ui::colorize("✅ ", ui::Colors::BRIGHT_GREEN) 
+                                      << ui::colorize(allServices.at(serviceName).description, ui::Colors::WHITE)
+                                      << " - Token refreshed via " << cliProviders.at(serviceName).cliTool << "\n";
+                        }
+                    }
+                }
+                catch (const std::exception &e)
+                {
+                    if (!jsonOutput)
+                    {
+                        std::cout << ui::colorize("⚠️  ", ui::Colors::BRIGHT_YELLOW) 
+                                  << "Failed to save refreshed tokens: " << e.what() << "\n";
+                    }
+                    cliRefreshed.clear();
+                }
+            }
+            
             // Output results
             if (jsonOutput)
             {
@@ -2300,8 +3701,39 @@ namespace ak
 
         int cmd_doctor(const core::Config &cfg, const std::vector<std::string> &args)
         {
-            (void)args; // Parameter intentionally unused
-            std::cout << "backend: " << ((cfg.gpgAvailable && !cfg.forcePlain) ? "gpg" : "plain") << "\n";
+            if (args.size() >= 2 && args[1] == "--compact")
+            {
+                // Fold every profile's record log back into its key file
+                size_t compacted = 0;
+                for (const auto &profile : storage::listProfiles(cfg))
+                {
+                    try
+                    {
+                        if (storage::compactProfileKeys(cfg, profile))
+                        {
+                            ++compacted;
+                        }
+                    }
+                    catch (const std::exception &e)
+                    {
+                        core::warn(cfg, "Could not compact profile '" + profile + "': " + e.what());
+                    }
+                }
+                core::ok(cfg, "Compacted " + std::to_string(compacted) + " profile log(s)");
+                return 0;
+            }
+            if (args.size() >= 2 && args[1] == "--gc")
+            {
+                // Drop content store objects no profile manifest refers to, and
+                // blobs no key refers to
+                size_t removed = storage::collectContentGarbage(cfg);
+                size_t blobs = storage::collectBlobGarbage(cfg);
+                core::ok(cfg, "Removed " + std::to_string(removed) + " unreferenced value object(s) and " +
+                                  std::to_string(blobs) + " blob(s)");
+                return 0;
+            }
+
+            std::cout << "backend: " << storage::backendName(storage::activeBackend(cfg)) << "\n";
             if (cfg.gpgAvailable)
             {
                 std::cout << "found: gpg\n";
@@ -2316,45 +3748,87 @@ namespace ak
             }
 
             std::cout << "profiles: " << storage::listProfiles(cfg).size() << "\n";
-            std::cout << "vault: " << cfg.vaultPath << "\n";
+            std::cout << "vault: " << cfg.vaultPath.get() << "\n";
+            std::cout << "profile log: " << (storage::profileLogEnabled(cfg) ? "on" : "off") << "\n";
+            std::cout << "content store: " << (storage::contentStoreEnabled(cfg) ? "on" : "off");
+            if (std::filesystem::exists(storage::ContentStore::dir(cfg)))
+            {
+                size_t objects = 0;
+                unsigned long long bytes = 0;
+                storage::ContentStore(cfg, "").stats(objects, bytes);
+                std::cout << " (" << objects << " object" << (objects == 1 ? "" : "s") << ", " << bytes << " bytes)";
+            }
+            std::cout << "\n";
 
             return 0;
         }
 
         int cmd_audit(const core::Config &cfg, const std::vector<std::string> &args)
         {
-            size_t tail = 50;
-            if (args.size() >= 2)
+            const std::string usage =
+                "Usage: ak audit [N] [--since <time>] [--until <time>] [--action <name>] [--key <NAME>] [--limit N|--all]";
+            core::AuditQuery query;
+            auto count = [&](const std::string &text)
             {
                 try
                 {
-                    tail = std::stoul(args[1]);
+                    return static_cast<size_t>(std::stoul(text));
                 }
                 catch (...)
                 {
-                    // Use default
+                    core::error(cfg, usage);
+                    return size_t(0);
                 }
-            }
-
-            std::ifstream in(cfg.auditLogPath);
-            if (!in)
+            };
+            for (size_t i = 1; i < args.size(); ++i)
             {
-                core::error(cfg, "No audit log");
+                bool hasValue = i + 1 < args.size();
+                if (args[i] == "--since" && hasValue)
+                {
+                    query.since = core::resolveAuditTime(args[++i]);
+                }
+                else if (args[i] == "--until" && hasValue)
+                {
+                    query.until = core::resolveAuditTime(args[++i]);
+                }
+                else if (args[i] == "--action" && hasValue)
+                {
+                    query.action = args[++i];
+                }
+                else if (args[i] == "--key" && hasValue)
+                {
+                    // Entries hold key hashes, never names
+                    query.keyHash = core::hashKeyName(args[++i]);
+                }
+                else if ((args[i] == "--limit" || args[i] == "-n") && hasValue)
+                {
+                    query.limit = count(args[++i]);
+                }
+                else if (args[i] == "--all")
+                {
+                    query.limit = 0;
+                }
+                else if (i == 1 && !args[i].empty() && std::isdigit(static_cast<unsigned char>(args[i][0])))
+                {
+                    query.limit = count(args[i]); // `ak audit 100`, as before
+                }
+                else
+                {
+                    core::error(cfg, usage);
+                }
             }
 
-            std::vector<std::string> lines;
-            std::string line;
-            while (std::getline(in, line))
+            if (!std::filesystem::exists(cfg.auditLogPath) && !std::filesystem::exists(cfg.auditLogPath + ".idx"))
             {
-                lines.push_back(line);
+                core::error(cfg, "No audit log");
             }
 
-            size_t start = lines.size() > tail ? lines.size() - tail : 0;
-            for (size_t i = start; i < lines.size(); ++i)
+            std::string out;
+            for (const auto &entry : core::queryAudit(cfg.auditLogPath, query))
             {
-                std::cout << lines[i] << "\n";
+                out += entry.timestamp + " " + entry.action + " " + entry.keyHash + "\n";
             }
-
+            std::cout << out;
             return 0;
         }
 
@@ -2376,14 +3850,8 @@ namespace ak
                 targetCfg.persistDir = targetCfg.configDir + "/persist";
 
                 // Update vault path to use target user's directory
-                if (targetCfg.gpgAvailable && !targetCfg.forcePlain)
-                {
-                    targetCfg.vaultPath = targetCfg.configDir + "/vault.gpg";
-                }
-                else
-                {
-                    targetCfg.vaultPath = targetCfg.configDir + "/vault.env";
-                }
+                targetCfg.backend = storage::readBackendSetting(targetCfg);
+                targetCfg.vaultPath = storage::vaultPathFor(targetCfg, storage::activeBackend(targetCfg));
             }
 
             system::writeShellInitFile(targetCfg);
@@ -2427,27 +3895,6 @@ namespace ak
             return 0;
         }
 
-        int cmd_gui(const core::Config &cfg, const std::vector<std::string> &args)
-        {
-#ifdef BUILD_GUI
-            // Check if GUI is available
-            if (!gui::isGuiAvailable())
-            {
-                core::error(cfg, "GUI support not available. Please build with -DBUILD_GUI=ON");
-                return 1;
-            }
-
-            // Launch GUI application
-            core::auditLog(cfg, "gui", {"launched"});
-            return gui::runGuiApplication(cfg, args);
-#else
-            (void)cfg;  // Suppress unused parameter warning
-            (void)args; // Suppress unused parameter warning
-            std::cerr << "Error: GUI support not compiled. Please build with -DBUILD_GUI=ON" << std::endl;
-            return 1;
-#endif
-        }
-
         // Service management
         int cmd_service(const core::Config &cfg, const std::vector<std::string> &args)
         {
@@ -2820,6 +4267,10 @@ namespace ak
                 // Read source profile keys
                 auto sourceKeys = storage::readProfile(cfg, sourceProfile);
 
+                // Values first (a manifest copy under the content store), so
+                // the new profile never lists keys it cannot resolve
+                storage::duplicateProfileKeys(cfg, sourceProfile, newProfile);
+
                 // Write to new profile
                 storage::writeProfile(cfg, newProfile, sourceKeys);
 
@@ -2829,6 +4280,7 @@ namespace ak
                 {
                     storage::writeEncryptedBundle(cfg, newProfile, exports);
                 }
+                refreshDirBundles(cfg);
 
                 core::success(cfg, "Successfully duplicated profile '" + sourceProfile + "' to '" + newProfile + "' with " +
                                        std::to_string(sourceKeys.size()) + " key" + (sourceKeys.size() == 1 ? "" : "s"));
@@ -2851,10 +4303,13 @@ namespace ak
                 return 1; // Silent failure for internal commands
             }
 
-            std::string dir = args[1];
-            auto profiles = storage::readDirProfiles(cfg, dir);
+            storage::DirMapping mapping;
+            if (!storage::findDirMapping(cfg, args[1], mapping))
+            {
+                return 0;
+            }
 
-            for (const auto &profile : profiles)
+            for (const auto &profile : mapping.profiles)
             {
                 std::cout << profile << "\n";
             }
@@ -2871,51 +4326,243 @@ namespace ak
 
             std::string profileName = args[1];
 
-            // Try to read from bundle first (for persisted data)
-            std::string exports = storage::readEncryptedBundle(cfg, profileName);
+            // A running agent has the freshest decrypted values; otherwise use the
+            // persisted bundle and finally decrypt the profile ourselves
+            std::string exports;
+            if (!agent::ping(cfg))
+            {
+                exports = storage::readEncryptedBundle(cfg, profileName);
+            }
 
             if (exports.empty())
             {
                 // If no bundle, generate exports from profile (fallback)
-                auto profiles = storage::listProfiles(cfg);
-                bool isProfile = std::find(profiles.begin(), profiles.end(), profileName) != profiles.end();
+                exports = makeExportsForPersisted(cfg, profileName);
+            }
+
+            std::cout << exports;
+            return 0;
+        }
+
+        // The sealed bundle for a persisted directory when its stamp is current,
+        // otherwise rebuilt (and resealed) here
+        std::string loadDirBundle(const core::Config &cfg, const std::string &key, const std::vector<std::string> &profiles)
+        {
+            std::string generation = storage::readGeneration(cfg);
+            std::string bundle;
+            if (storage::readDirBundle(cfg, key, generation, bundle))
+            {
+                return bundle;
+            }
+
+            std::map<std::string, std::string> memo;
+            bundle = makeDirBundle(cfg, profiles, memo);
+            if (storage::canSealWithoutPrompt(cfg))
+            {
+                try
+                {
+                    storage::writeDirBundle(cfg, key, generation, bundle);
+                }
+                catch (const std::exception &)
+                {
+                    // Serve it anyway; the next call retries
+                }
+            }
+            return bundle;
+        }
+
+        // Export lines of the bundle sections to load: only "default" unless
+        // AK_AUTO_LOAD_ALL=1
+        std::vector<std::string> selectBundleLines(const std::string &bundle, bool loadAll)
+        {
+            std::vector<std::string> lines;
+            std::istringstream in(bundle);
+            std::string line;
+            bool include = false;
+            while (std::getline(in, line))
+            {
+                if (line.rfind("# profile ", 0) == 0)
+                {
+                    include = loadAll || line.substr(10) == "default";
+                    continue;
+                }
+                if (include && !line.empty())
+                {
+                    lines.push_back(line);
+                }
+            }
+            return lines;
+        }
+
+        // Inverse of exportLine
+        bool parseExportLine(const std::string &line, std::string &name, std::string &value)
+        {
+            if (line.rfind("export ", 0) != 0)
+            {
+                return false;
+            }
+            auto eq = line.find("=\"", 7);
+            if (eq == std::string::npos || line.size() < eq + 3 || line.back() != '"')
+            {
+                return false;
+            }
+            name = line.substr(7, eq - 7);
+            value.clear();
+            for (size_t i = eq + 2; i + 1 < line.size(); ++i)
+            {
+                if (line[i] == '\\' && i + 2 < line.size())
+                {
+                    char next = line[++i];
+                    value.push_back(next == 'n' ? '\n' : next);
+                }
+                else
+                {
+                    value.push_back(line[i]);
+                }
+            }
+            return !name.empty();
+        }
+
+        int cmd_complete(const core::Config &cfg, const std::vector<std::string> &args)
+        {
+            // ak __complete <keys|profiles|services> [prefix]; never decrypts
+            // and never audits, since it runs on every tab press
+            if (args.size() < 2)
+            {
+                return 1;
+            }
+            const std::string &context = args[1];
+            std::string prefix = args.size() > 2 ? args[2] : "";
 
-                if (isProfile)
+            storage::CompletionIndex index(cfg);
+            if (context == "profiles")
+            {
+                if (!index.fresh(context, storage::stampPath(cfg.profilesDir)))
                 {
-                    exports = makeExportsForProfile(cfg, profileName);
+                    index.set(context, cfg.profilesDir, storage::listProfiles(cfg));
                 }
-                else if (profileName.substr(0, 5) == "_key_")
+            }
+            else if (context == "services")
+            {
+                std::string userServices = cfg.configDir + "/user_services.txt";
+                if (!index.fresh(context, storage::stampPath(userServices)))
                 {
-                    // Handle temporary key profiles
-                    std::string keyName = profileName.substr(5);
-                    core::KeyStore ks = storage::loadVault(cfg);
-                    auto it = ks.kv.find(keyName);
-                    if (it != ks.kv.end())
+                    std::vector<std::string> names;
+                    for (const auto &entry : *services::loadAllServicesCached(cfg))
                     {
-                        std::string value = it->second;
-                        std::string escaped;
-                        escaped.reserve(value.size() * 2);
+                        names.push_back(entry.first);
+                    }
+                    index.set(context, userServices, std::move(names));
+                }
+            }
+            else if (context != "keys")
+            {
+                return 1;
+            }
+            index.save();
 
-                        for (char c : value)
-                        {
-                            if (c == '\\' || c == '"')
-                            {
-                                escaped.push_back('\\');
-                            }
-                            if (c == '\n')
-                            {
-                                escaped += "\\n";
-                                continue;
-                            }
-                            escaped.push_back(c);
-                        }
+            for (const auto &name : index.match(context, prefix))
+            {
+                std::cout << name << "\n";
+            }
+            return 0;
+        }
+
+        int cmd_internal_dir_bundle(const core::Config &cfg, const std::vector<std::string> &args)
+        {
+            if (args.size() < 2)
+            {
+                return 1; // Silent failure for internal commands
+            }
+
+            bool loadAll = std::find(args.begin() + 2, args.end(), "--all") != args.end();
+            storage::DirMapping mapping;
+            if (!storage::findDirMapping(cfg, args[1], mapping))
+            {
+                return 0;
+            }
+
+            for (const auto &line : selectBundleLines(loadDirBundle(cfg, mapping.key, mapping.profiles), loadAll))
+            {
+                std::cout << line << "\n";
+            }
+            return 0;
+        }
+
+        int cmd_hook_env(const core::Config &cfg, const std::vector<std::string> &args)
+        {
+            system::Shell shell = system::Shell::Bash;
+            for (size_t i = 1; i < args.size(); ++i)
+            {
+                std::string name;
+                if (args[i] == "--shell" && i + 1 < args.size())
+                {
+                    name = args[++i];
+                }
+                else if (args[i].rfind("--shell=", 0) == 0)
+                {
+                    name = args[i].substr(8);
+                }
+                else
+                {
+                    continue;
+                }
+                if (!system::parseShell(name, shell))
+                {
+                    core::error(cfg, "Unsupported shell: " + name + " (use bash, zsh or fish)");
+                }
+            }
+
+            system::HookState previous;
+            const char *token = getenv("AK_HOOK_STATE");
+            bool hadState = token && system::decodeHookState(token, previous);
+
+            std::string dir = system::getCwd();
+            storage::DirMapping mapping;
+            bool persisted = storage::findDirMapping(cfg, dir, mapping);
+
+            // Keyed by the persisted ancestor, so moving around inside it is a no-op
+            system::HookState next;
+            next.dirKey = persisted ? mapping.key : "";
+            next.generation = storage::readGeneration(cfg);
+            next.loadAll = core::getenvs("AK_AUTO_LOAD_ALL") == "1";
 
-                        exports = "export " + keyName + "=\"" + escaped + "\"\n";
+            // Same mapping, nothing written since: no decrypt, no output
+            if (hadState && previous.dirKey == next.dirKey && previous.generation == next.generation &&
+                previous.loadAll == next.loadAll)
+            {
+                return 0;
+            }
+
+            std::map<std::string, std::string> values;
+            if (persisted)
+            {
+                std::string hashKey = system::hookStateKey(cfg);
+                for (const auto &line : selectBundleLines(loadDirBundle(cfg, mapping.key, mapping.profiles), next.loadAll))
+                {
+                    std::string name, value;
+                    if (parseExportLine(line, name, value))
+                    {
+                        values[name] = value;
+                        next.exported[name] = system::hookValueHash(hashKey, value);
                     }
                 }
             }
 
-            std::cout << exports;
+            std::cout << system::hookDelta(shell, previous, next, values);
+
+            if (next.exported != previous.exported)
+            {
+                if (!next.exported.empty())
+                {
+                    std::cerr << "🔄 ak: loaded " << next.exported.size() << " variable" << (next.exported.size() == 1 ? "" : "s")
+                              << " for " << mapping.dir << "\n";
+                }
+                else
+                {
+                    std::cerr << "🔄 ak: unloaded " << previous.exported.size() << " variable" << (previous.exported.size() == 1 ? "" : "s") << "\n";
+                }
+            }
             return 0;
         }
 
@@ -2930,7 +4577,9 @@ namespace ak
                                  "  ak secret add <NAME> <VALUE>     Add a secret\n"
                                  "  ak secret add <NAME=VALUE>       Add a secret using NAME=VALUE format\n"
                                  "  ak secret set <NAME>             Set a secret (prompts for value)\n"
-                                 "  ak secret get <NAME> [--full|--reveal]  Get a secret value\n"
+                                 "  ak secret set <NAME> --from-file <file>  Store a large value as a blob\n"
+                                 "  ak secret set --batch [-p <profile>]  Apply NAME=VALUE lines from stdin at once\n"
+                                 "  ak secret get <NAME> [--full|--reveal] [--to-file [<file>]]  Get a secret value\n"
                                  "  ak secret ls [--json]            List all secret names\n"
                                  "  ak secret rm <NAME>              Remove a secret\n"
                                  "  ak secret search <PATTERN>       Search for secrets by name pattern\n"
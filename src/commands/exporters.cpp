@@ -0,0 +1,361 @@
+#include "commands/exporters.hpp"
+#include "commands/layers.hpp"
+#include "crypto/crypto.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <random>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace ak {
+namespace commands {
+
+ExportSink::~ExportSink() {
+    crypto::secureZero(buffer_.data(), buffer_.size());
+}
+
+void ExportSink::write(std::string_view data) {
+    // Large pieces (mapped blob segments) go out without a copy
+    if (data.size() >= buffer_.size()) {
+        flush();
+        writeDirect(data);
+        return;
+    }
+    while (!data.empty()) {
+        if (used_ == buffer_.size()) {
+            flush();
+        }
+        size_t n = std::min(data.size(), buffer_.size() - used_);
+        std::copy(data.begin(), data.begin() + n, buffer_.begin() + used_);
+        used_ += n;
+        data.remove_prefix(n);
+    }
+}
+
+void ExportSink::put(char c) {
+    if (used_ == buffer_.size()) {
+        flush();
+    }
+    buffer_[used_++] = c;
+}
+
+bool ExportSink::flush() {
+    writeDirect(std::string_view(buffer_.data(), used_));
+    crypto::secureZero(buffer_.data(), used_);
+    used_ = 0;
+    return ok_;
+}
+
+void ExportSink::writeDirect(std::string_view data) {
+    while (ok_ && !data.empty()) {
+#ifdef _WIN32
+        int n = ::_write(fd_, data.data(), static_cast<unsigned>(data.size()));
+#else
+        ssize_t n = ::write(fd_, data.data(), data.size());
+#endif
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            ok_ = false;
+            break;
+        }
+        written_ += static_cast<size_t>(n);
+        data.remove_prefix(static_cast<size_t>(n));
+    }
+}
+
+namespace {
+
+// Bytes per base64 step: a multiple of 3, so the pieces join into one
+// valid encoding
+constexpr size_t BASE64_STEP = 3 * 1024;
+
+void writeBase64(ExportSink& out, std::string_view value) {
+    while (!value.empty()) {
+        std::string piece = crypto::base64Encode(value.substr(0, BASE64_STEP));
+        out.write(piece);
+        crypto::secureZero(&piece[0], piece.size());
+        value.remove_prefix(std::min(value.size(), BASE64_STEP));
+    }
+}
+
+// The escaping of quoteJsonString, a byte at a time
+void writeJsonString(ExportSink& out, std::string_view value) {
+    out.put('"');
+    for (unsigned char c : value) {
+        switch (c) {
+        case '"':
+            out.write("\\\"");
+            break;
+        case '\\':
+            out.write("\\\\");
+            break;
+        case '\n':
+            out.write("\\n");
+            break;
+        case '\r':
+            out.write("\\r");
+            break;
+        case '\t':
+            out.write("\\t");
+            break;
+        default:
+            if (c < 0x20) {
+                char buf[8];
+                std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+                out.write(buf);
+            } else {
+                out.put(static_cast<char>(c));
+            }
+        }
+    }
+    out.put('"');
+}
+
+// `NAME="value"` with the escaping appendExportLine uses
+void writeQuotedAssignment(ExportSink& out, std::string_view name, std::string_view value) {
+    out.write(name);
+    out.write("=\"");
+    for (char c : value) {
+        if (c == '\\' || c == '"') {
+            out.put('\\');
+        }
+        if (c == '\n') {
+            out.write("\\n");
+            continue;
+        }
+        out.put(c);
+    }
+    out.write("\"\n");
+}
+
+class EnvWriter : public ExportWriter {
+public:
+    void entry(ExportSink& out, std::string_view name, std::string_view value) override {
+        out.write("export ");
+        writeQuotedAssignment(out, name, value);
+    }
+};
+
+class DotenvWriter : public ExportWriter {
+public:
+    void entry(ExportSink& out, std::string_view name, std::string_view value) override {
+        writeQuotedAssignment(out, name, value);
+    }
+};
+
+class JsonWriter : public ExportWriter {
+public:
+    void begin(ExportSink& out) override { out.put('{'); }
+    void entry(ExportSink& out, std::string_view name, std::string_view value) override {
+        out.write(first_ ? "\n  " : ",\n  ");
+        first_ = false;
+        writeJsonString(out, name);
+        out.write(": ");
+        writeJsonString(out, value);
+    }
+    void end(ExportSink& out, size_t count) override { out.write(count ? "\n}\n" : "}\n"); }
+
+private:
+    bool first_ = true;
+};
+
+class YamlWriter : public ExportWriter {
+public:
+    void entry(ExportSink& out, std::string_view name, std::string_view value) override {
+        out.write(name);
+        out.write(": ");
+        writeJsonString(out, value); // a JSON string is a valid YAML scalar
+        out.put('\n');
+    }
+};
+
+// Kubernetes accepts only [-._a-zA-Z0-9] in data keys
+void checkSecretKey(std::string_view name) {
+    for (char c : name) {
+        bool fine = std::isalnum(static_cast<unsigned char>(c)) || c == '-' || c == '_' || c == '.';
+        if (!fine) {
+            throw std::runtime_error("'" + std::string(name) + "' is not a valid Kubernetes Secret key");
+        }
+    }
+}
+
+class K8sYamlWriter : public ExportWriter {
+public:
+    explicit K8sYamlWriter(ExportOptions options) : options_(std::move(options)) {}
+
+    void begin(ExportSink& out) override {
+        out.write("apiVersion: v1\nkind: Secret\nmetadata:\n  name: ");
+        writeJsonString(out, options_.secretName);
+        if (!options_.secretNamespace.empty()) {
+            out.write("\n  namespace: ");
+            writeJsonString(out, options_.secretNamespace);
+        }
+        out.write("\ntype: Opaque\ndata:");
+    }
+    void entry(ExportSink& out, std::string_view name, std::string_view value) override {
+        checkSecretKey(name);
+        out.write("\n  ");
+        out.write(name);
+        out.write(": ");
+        writeBase64(out, value);
+    }
+    void end(ExportSink& out, size_t count) override { out.write(count ? "\n" : " {}\n"); }
+
+private:
+    ExportOptions options_;
+};
+
+class K8sJsonWriter : public ExportWriter {
+public:
+    explicit K8sJsonWriter(ExportOptions options) : options_(std::move(options)) {}
+
+    void begin(ExportSink& out) override {
+        out.write("{\n  \"apiVersion\": \"v1\",\n  \"kind\": \"Secret\",\n  \"metadata\": {\"name\": ");
+        writeJsonString(out, options_.secretName);
+        if (!options_.secretNamespace.empty()) {
+            out.write(", \"namespace\": ");
+            writeJsonString(out, options_.secretNamespace);
+        }
+        out.write("},\n  \"type\": \"Opaque\",\n  \"data\": {");
+    }
+    void entry(ExportSink& out, std::string_view name, std::string_view value) override {
+        checkSecretKey(name);
+        out.write(first_ ? "\n    \"" : ",\n    \"");
+        first_ = false;
+        out.write(name);
+        out.write("\": \"");
+        writeBase64(out, value);
+        out.put('"');
+    }
+    void end(ExportSink& out, size_t count) override { out.write(count ? "\n  }\n}\n" : "}\n}\n"); }
+
+private:
+    ExportOptions options_;
+    bool first_ = true;
+};
+
+// docker --env-file takes each line literally: no quotes, no escapes, so a
+// newline cannot be written at all
+class DockerEnvWriter : public ExportWriter {
+public:
+    void entry(ExportSink& out, std::string_view name, std::string_view value) override {
+        if (value.find_first_of("\r\n") != std::string_view::npos) {
+            throw std::runtime_error(std::string(name) + " spans several lines, which docker env-files cannot hold");
+        }
+        out.write(name);
+        out.put('=');
+        out.write(value);
+        out.put('\n');
+    }
+};
+
+// systemd EnvironmentFile=: a double-quoted value may span lines and is
+// never expanded, so only the quote and backslash need escaping
+class SystemdWriter : public ExportWriter {
+public:
+    void entry(ExportSink& out, std::string_view name, std::string_view value) override {
+        out.write(name);
+        out.write("=\"");
+        for (char c : value) {
+            if (c == '\\' || c == '"') {
+                out.put('\\');
+            }
+            out.put(c);
+        }
+        out.write("\"\n");
+    }
+};
+
+// $GITHUB_ENV: NAME<<DELIMITER, the raw value, DELIMITER. The delimiter is
+// random per run and re-drawn in the (unlikely) case a value contains it.
+class GithubEnvWriter : public ExportWriter {
+public:
+    void entry(ExportSink& out, std::string_view name, std::string_view value) override {
+        while (delimiter_.empty() || value.find(delimiter_) != std::string_view::npos) {
+            delimiter_ = "ak_EOF_" + randomTag();
+        }
+        out.write(name);
+        out.write("<<");
+        out.write(delimiter_);
+        out.put('\n');
+        out.write(value);
+        out.put('\n');
+        out.write(delimiter_);
+        out.put('\n');
+    }
+
+private:
+    static std::string randomTag() {
+        std::random_device rd;
+        char buf[24];
+        std::snprintf(buf, sizeof(buf), "%08x%08x", rd(), rd());
+        return buf;
+    }
+
+    std::string delimiter_;
+};
+
+} // namespace
+
+const std::vector<std::string>& exportFormats() {
+    static const std::vector<std::string> formats = {"env", "dotenv", "json", "yaml", "k8s",
+                                                     "k8s-json", "docker", "systemd", "github"};
+    return formats;
+}
+
+std::unique_ptr<ExportWriter> makeExportWriter(const std::string& format, const ExportOptions& options) {
+    if (format == "env") {
+        return std::make_unique<EnvWriter>();
+    }
+    if (format == "dotenv") {
+        return std::make_unique<DotenvWriter>();
+    }
+    if (format == "json") {
+        return std::make_unique<JsonWriter>();
+    }
+    if (format == "yaml") {
+        return std::make_unique<YamlWriter>();
+    }
+    if (format == "k8s") {
+        return std::make_unique<K8sYamlWriter>(options);
+    }
+    if (format == "k8s-json") {
+        return std::make_unique<K8sJsonWriter>(options);
+    }
+    if (format == "docker") {
+        return std::make_unique<DockerEnvWriter>();
+    }
+    if (format == "systemd") {
+        return std::make_unique<SystemdWriter>();
+    }
+    if (format == "github") {
+        return std::make_unique<GithubEnvWriter>();
+    }
+    return nullptr;
+}
+
+size_t streamExport(const core::Config& cfg, const std::vector<std::string>& layers, ExportWriter& writer,
+                    ExportSink& out) {
+    size_t count = 0;
+    writer.begin(out);
+    visitLayers(cfg, layers, [&](std::string_view name, std::string_view value) {
+        writer.entry(out, name, value);
+        ++count;
+    });
+    writer.end(out, count);
+    out.flush();
+    return count;
+}
+
+} // namespace commands
+} // namespace ak
@@ -0,0 +1,37 @@
+// `ak gui` lives apart from commands.cpp so that libak, which carries the
+// rest of the commands, builds without Qt; only the ak executable links it.
+#include "commands/commands.hpp"
+#include "core/config.hpp"
+#ifdef BUILD_GUI
+#include "gui/gui.hpp"
+#endif
+#include <iostream>
+
+namespace ak
+{
+    namespace commands
+    {
+
+        int cmd_gui(const core::Config &cfg, const std::vector<std::string> &args)
+        {
+#ifdef BUILD_GUI
+            // Check if GUI is available
+            if (!gui::isGuiAvailable())
+            {
+                core::error(cfg, "GUI support not available. Please build with -DBUILD_GUI=ON");
+                return 1;
+            }
+
+            // Launch GUI application
+            core::auditLog(cfg, "gui", {"launched"});
+            return gui::runGuiApplication(cfg, args);
+#else
+            (void)cfg;  // Suppress unused parameter warning
+            (void)args; // Suppress unused parameter warning
+            std::cerr << "Error: GUI support not compiled. Please build with -DBUILD_GUI=ON" << std::endl;
+            return 1;
+#endif
+        }
+
+    } // namespace commands
+} // namespace ak
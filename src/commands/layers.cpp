@@ -0,0 +1,196 @@
+#include "commands/layers.hpp"
+
+#include "agent/agent.hpp"
+#include "commands/commands.hpp"
+#include "crypto/crypto.hpp"
+#include "storage/blob_store.hpp"
+#include "storage/vault.hpp"
+
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <sstream>
+#include <unordered_set>
+
+namespace ak {
+namespace commands {
+
+namespace {
+
+struct LoadedLayer {
+    std::vector<std::string> names;
+    storage::ProfileKeysPtr keys;
+};
+
+LoadedLayer loadLayer(const core::Config& cfg, const std::string& name) {
+    LoadedLayer layer;
+    layer.names = storage::readProfile(cfg, name);
+    std::map<std::string, std::string> agentKeys;
+    if (agent::fetchProfileKeys(cfg, name, agentKeys)) {
+        layer.keys = std::make_shared<const std::map<std::string, std::string>>(std::move(agentKeys));
+    } else {
+        layer.keys = storage::loadProfileKeysCached(cfg, name);
+    }
+    return layer;
+}
+
+// Layers by position, each distinct profile loaded once (concurrently when
+// there are several)
+std::vector<std::shared_ptr<const LoadedLayer>> loadLayers(const core::Config& cfg,
+                                                           const std::vector<std::string>& layers) {
+    std::map<std::string, size_t> slot;
+    std::vector<std::string> distinct;
+    for (const auto& name : layers) {
+        if (slot.emplace(name, distinct.size()).second) {
+            distinct.push_back(name);
+        }
+    }
+    std::vector<std::shared_ptr<const LoadedLayer>> loaded(distinct.size());
+    if (distinct.size() == 1) {
+        loaded[0] = std::make_shared<const LoadedLayer>(loadLayer(cfg, distinct[0]));
+    } else {
+        std::vector<std::future<LoadedLayer>> pending;
+        pending.reserve(distinct.size());
+        for (const auto& name : distinct) {
+            pending.push_back(std::async(std::launch::async, loadLayer, std::cref(cfg), std::cref(name)));
+        }
+        for (size_t i = 0; i < pending.size(); ++i) {
+            loaded[i] = std::make_shared<const LoadedLayer>(pending[i].get());
+        }
+    }
+    std::vector<std::shared_ptr<const LoadedLayer>> out;
+    out.reserve(layers.size());
+    for (const auto& name : layers) {
+        out.push_back(loaded[slot.at(name)]);
+    }
+    return out;
+}
+
+// Blob references stand for their contents wherever a value is used. A
+// blob that is not here (the reference came through sync or an import) or
+// does not decrypt leaves its key out with a warning; the other keys load.
+bool resolveBlob(const core::Config& cfg, const std::string& key, std::string& value) {
+    if (storage::resolveBlobValue(cfg, value)) {
+        return true;
+    }
+    core::warn(cfg, "Skipping " + key + ": its blob value could not be read");
+    return false;
+}
+
+} // namespace
+
+std::vector<std::string> parseLayers(const std::string& spec) {
+    std::vector<std::string> layers;
+    std::stringstream in(spec);
+    std::string name;
+    while (std::getline(in, name, ',')) {
+        if (!name.empty()) {
+            layers.push_back(name);
+        }
+    }
+    return layers;
+}
+
+std::vector<std::pair<std::string, std::string>> LayeredEnv::values() const {
+    std::vector<std::pair<std::string, std::string>> out;
+    out.reserve(order.size());
+    for (const auto& key : order) {
+        out.emplace_back(key, merged.at(key).value);
+    }
+    return out;
+}
+
+LayeredEnv resolveLayers(const core::Config& cfg, const std::vector<std::string>& layers) {
+    LayeredEnv env;
+    env.layers = layers;
+    auto loaded = loadLayers(cfg, layers);
+
+    // The legacy vault is only decrypted if some key isn't in its profile
+    std::unique_ptr<core::KeyStore> vault;
+    env.perLayer.resize(layers.size());
+    for (size_t i = 0; i < layers.size(); ++i) {
+        const auto& layer = *loaded[i];
+        auto& values = env.perLayer[i];
+        values.reserve(layer.names.size());
+        for (const auto& key : layer.names) {
+            auto pit = layer.keys->find(key);
+            if (pit != layer.keys->end()) {
+                values.emplace_back(key, pit->second);
+                if (!resolveBlob(cfg, key, values.back().second)) {
+                    values.pop_back();
+                    continue;
+                }
+            } else {
+                if (!vault) {
+                    vault = std::make_unique<core::KeyStore>(loadVaultPreferAgent(cfg));
+                }
+                auto vit = vault->kv.find(key);
+                if (vit == vault->kv.end()) {
+                    continue;
+                }
+                values.emplace_back(key, vit->second);
+                if (!resolveBlob(cfg, key, values.back().second)) {
+                    values.pop_back();
+                    continue;
+                }
+            }
+            if (env.merged.insert_or_assign(key, LayeredValue{values.back().second, i}).second) {
+                env.order.push_back(key);
+            }
+        }
+    }
+    return env;
+}
+
+void visitLayers(const core::Config& cfg, const std::vector<std::string>& layers,
+                 const std::function<void(std::string_view name, std::string_view value)>& visit) {
+    auto loaded = loadLayers(cfg, layers);
+    std::vector<std::unordered_set<std::string_view>> listed(loaded.size());
+    for (size_t i = 0; i < loaded.size(); ++i) {
+        listed[i].insert(loaded[i]->names.begin(), loaded[i]->names.end());
+    }
+    std::unique_ptr<core::KeyStore> vault;
+    auto valueIn = [&](size_t i, std::string_view key) -> const std::string* {
+        auto pit = loaded[i]->keys->find(std::string(key));
+        if (pit != loaded[i]->keys->end()) {
+            return &pit->second;
+        }
+        if (!vault) {
+            vault = std::make_unique<core::KeyStore>(loadVaultPreferAgent(cfg));
+        }
+        auto vit = vault->kv.find(std::string(key));
+        return vit == vault->kv.end() ? nullptr : &vit->second;
+    };
+
+    // A key goes out where resolveLayers first places it, with the value of
+    // the last layer that lists and has it
+    std::unordered_set<std::string_view> seen;
+    for (size_t i = 0; i < loaded.size(); ++i) {
+        for (const auto& key : loaded[i]->names) {
+            if (seen.count(key) || !valueIn(i, key)) {
+                continue;
+            }
+            seen.insert(key);
+            const std::string* value = nullptr;
+            for (size_t j = loaded.size(); j-- > i && !value;) {
+                if (listed[j].count(key)) {
+                    value = valueIn(j, key);
+                }
+            }
+            storage::BlobRef ref;
+            if (!storage::parseBlobRef(*value, ref)) {
+                visit(key, *value);
+                continue;
+            }
+            std::string blob = *value;
+            if (!resolveBlob(cfg, key, blob)) {
+                continue;
+            }
+            visit(key, blob);
+            crypto::secureZero(&blob[0], blob.size());
+        }
+    }
+}
+
+} // namespace commands
+} // namespace ak
@@ -0,0 +1,438 @@
+#include "core/audit.hpp"
+#include "core/config.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+
+#ifdef __unix__
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+#endif
+#ifdef AK_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace ak {
+namespace core {
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const uint64_t MARK_STEP = 64 * 1024;
+const size_t READ_BLOCK = 64 * 1024;
+
+struct AuditIndex {
+    struct Segment {
+        std::string file; // next to the log
+        std::string first;
+        std::string last;
+    };
+    std::vector<Segment> segments;              // oldest first
+    std::vector<std::pair<uint64_t, std::string>> marks; // active file: offset, time
+};
+
+std::string indexPath(const std::string& path) { return path + ".idx"; }
+
+AuditIndex readIndex(const std::string& path) {
+    AuditIndex index;
+    std::ifstream in(indexPath(path));
+    std::string kind;
+    while (in >> kind) {
+        if (kind == "seg") {
+            AuditIndex::Segment segment;
+            if (in >> segment.file >> segment.first >> segment.last) {
+                index.segments.push_back(segment);
+            }
+        } else if (kind == "mark") {
+            uint64_t offset = 0;
+            std::string time;
+            if (in >> offset >> time) {
+                index.marks.emplace_back(offset, time);
+            }
+        }
+        std::string rest;
+        std::getline(in, rest);
+    }
+    return index;
+}
+
+void writeIndex(const std::string& path, const AuditIndex& index) {
+    std::string tmp = indexPath(path) + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::trunc);
+        for (const auto& segment : index.segments) {
+            out << "seg " << segment.file << " " << segment.first << " " << segment.last << "\n";
+        }
+        for (const auto& [offset, time] : index.marks) {
+            out << "mark " << offset << " " << time << "\n";
+        }
+        if (!out) {
+            return;
+        }
+    }
+    std::error_code ec;
+    fs::rename(tmp, indexPath(path), ec);
+}
+
+// Seconds since the epoch for "YYYY-MM-DDTHH:MM:SS..." (UTC); -1 if unparsable
+long long epochOf(const std::string& iso) {
+    std::tm tm{};
+    if (std::sscanf(iso.c_str(), "%4d-%2d-%2dT%2d:%2d:%2d", &tm.tm_year, &tm.tm_mon, &tm.tm_mday, &tm.tm_hour,
+                    &tm.tm_min, &tm.tm_sec) != 6) {
+        return -1;
+    }
+    tm.tm_year -= 1900;
+    tm.tm_mon -= 1;
+#ifdef _WIN32
+    return static_cast<long long>(_mkgmtime(&tm));
+#else
+    return static_cast<long long>(timegm(&tm));
+#endif
+}
+
+std::string isoOf(long long epoch) {
+    std::time_t t = static_cast<std::time_t>(epoch);
+    char buf[32];
+    std::strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S.000Z", std::gmtime(&t));
+    return buf;
+}
+
+bool parseEntry(const std::string& line, AuditEntry& entry) {
+    size_t a = line.find(' ');
+    size_t b = a == std::string::npos ? a : line.find(' ', a + 1);
+    if (b == std::string::npos) {
+        return false;
+    }
+    entry.timestamp = line.substr(0, a);
+    entry.action = line.substr(a + 1, b - a - 1);
+    entry.keyHash = line.substr(b + 1);
+    return true;
+}
+
+bool beforeSince(const std::string& time, const AuditQuery& q) { return !q.since.empty() && time < q.since; }
+bool afterUntil(const std::string& time, const AuditQuery& q) {
+    return !q.until.empty() && time.compare(0, q.until.size(), q.until) > 0;
+}
+
+bool matches(const AuditEntry& e, const AuditQuery& q) {
+    return !beforeSince(e.timestamp, q) && !afterUntil(e.timestamp, q) && (q.action.empty() || e.action == q.action) &&
+           (q.keyHash.empty() || e.keyHash == q.keyHash);
+}
+
+// Calls onLine for each complete line of [0, end) from the last to the
+// first, until it returns false
+template <typename F>
+void scanBackwards(const std::string& path, uint64_t end, F&& onLine) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        return;
+    }
+    std::string carry; // the start of a line whose beginning is not read yet
+    uint64_t pos = end;
+    std::string block;
+    while (pos > 0) {
+        size_t n = static_cast<size_t>(std::min<uint64_t>(READ_BLOCK, pos));
+        pos -= n;
+        block.resize(n);
+        in.seekg(static_cast<std::streamoff>(pos));
+        if (!in.read(&block[0], static_cast<std::streamsize>(n))) {
+            return;
+        }
+        carry.insert(0, block);
+        // What precedes the first newline may continue in the next block
+        size_t stop = carry.size();
+        for (size_t nl; stop > 0 && (nl = carry.rfind('\n', stop - 1)) != std::string::npos; stop = nl) {
+            if (nl + 1 < stop && !onLine(carry.substr(nl + 1, stop - nl - 1))) {
+                return;
+            }
+        }
+        carry.resize(stop);
+    }
+    if (!carry.empty()) {
+        onLine(carry);
+    }
+}
+
+// Every line of a segment, oldest first
+template <typename F>
+void scanSegment(const std::string& file, F&& onLine) {
+#ifdef AK_HAVE_ZLIB
+    if (file.size() > 3 && file.compare(file.size() - 3, 3, ".gz") == 0) {
+        gzFile gz = gzopen(file.c_str(), "rb");
+        if (!gz) {
+            return;
+        }
+        std::string line;
+        char buf[4096];
+        while (gzgets(gz, buf, sizeof(buf))) {
+            line += buf;
+            if (!line.empty() && line.back() == '\n') {
+                line.pop_back();
+                onLine(line);
+                line.clear();
+            }
+        }
+        if (!line.empty()) {
+            onLine(line);
+        }
+        gzclose(gz);
+        return;
+    }
+#endif
+    std::ifstream in(file);
+    std::string line;
+    while (std::getline(in, line)) {
+        onLine(line);
+    }
+}
+
+std::string firstTime(const std::string& path, const AuditIndex& index) {
+    if (!index.marks.empty() && index.marks.front().first == 0) {
+        return index.marks.front().second;
+    }
+    std::ifstream in(path);
+    std::string line;
+    AuditEntry entry;
+    return std::getline(in, line) && parseEntry(line, entry) ? entry.timestamp : "";
+}
+
+// Moves the active log into a segment; called with the lock held
+void rotate(const std::string& path, AuditIndex& index, uint64_t size) {
+    std::string first = firstTime(path, index);
+    std::string last;
+    scanBackwards(path, size, [&](const std::string& line) {
+        AuditEntry entry;
+        if (parseEntry(line, entry)) {
+            last = entry.timestamp;
+        }
+        return last.empty();
+    });
+    if (first.empty() || last.empty()) {
+        return;
+    }
+
+    // audit.log.20260114T093000, then -1, -2 for same-second rotations
+    std::string stamp;
+    for (char c : first.substr(0, 19)) {
+        if (c != '-' && c != ':') {
+            stamp += c;
+        }
+    }
+    std::string base = path + "." + stamp;
+#ifdef AK_HAVE_ZLIB
+    const std::string suffix = ".gz";
+#else
+    const std::string suffix;
+#endif
+    std::string target = base + suffix;
+    for (int n = 1; fs::exists(target); ++n) {
+        target = base + "-" + std::to_string(n) + suffix;
+    }
+
+    std::error_code ec;
+#ifdef AK_HAVE_ZLIB
+    {
+        std::ifstream in(path, std::ios::binary);
+        std::string tmp = target + ".tmp";
+        gzFile gz = gzopen(tmp.c_str(), "wb9");
+        if (!gz) {
+            return;
+        }
+        std::vector<char> buf(READ_BLOCK);
+        bool good = true;
+        while (in.read(buf.data(), static_cast<std::streamsize>(buf.size())) || in.gcount() > 0) {
+            if (gzwrite(gz, buf.data(), static_cast<unsigned>(in.gcount())) <= 0) {
+                good = false;
+                break;
+            }
+        }
+        if (gzclose(gz) != Z_OK || !good) {
+            fs::remove(tmp, ec);
+            return;
+        }
+        fs::rename(tmp, target, ec);
+        if (ec) {
+            fs::remove(tmp, ec);
+            return;
+        }
+        fs::remove(path, ec);
+    }
+#else
+    fs::rename(path, target, ec);
+    if (ec) {
+        return;
+    }
+#endif
+    index.segments.push_back({fs::path(target).filename().string(), first, last});
+    index.marks.clear();
+    writeIndex(path, index);
+}
+
+#ifdef __unix__
+// flock on "<log>.lock" for the life of the object
+class FileLock {
+public:
+    explicit FileLock(const std::string& path) : fd_(::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600)) {
+        if (fd_ >= 0) {
+            ::flock(fd_, LOCK_EX);
+        }
+    }
+    ~FileLock() {
+        if (fd_ >= 0) {
+            ::close(fd_); // releases the lock
+        }
+    }
+    FileLock(const FileLock&) = delete;
+    FileLock& operator=(const FileLock&) = delete;
+
+private:
+    int fd_;
+};
+#endif
+
+} // namespace
+
+AuditRotation auditRotationFromEnv() {
+    AuditRotation rotation;
+    const char* bytes = std::getenv("AK_AUDIT_MAX_BYTES");
+    if (bytes && *bytes) {
+        rotation.maxBytes = std::strtoull(bytes, nullptr, 10);
+    }
+    const char* days = std::getenv("AK_AUDIT_MAX_AGE_DAYS");
+    if (days && *days) {
+        rotation.maxAgeSeconds = std::strtoll(days, nullptr, 10) * 24 * 3600;
+    }
+    return rotation;
+}
+
+void appendAudit(const std::string& path, const std::string& lines, const AuditRotation& rotation) {
+    if (lines.empty()) {
+        return;
+    }
+    // flock is per open file, so threads of one process exclude each other
+    // too; the mutex covers platforms without it
+    static std::mutex mutex;
+    std::lock_guard<std::mutex> guard(mutex);
+#ifdef __unix__
+    FileLock lock(path + ".lock");
+#endif
+
+    std::error_code ec;
+    uint64_t size = fs::exists(path, ec) ? fs::file_size(path, ec) : 0;
+    if (ec) {
+        size = 0;
+    }
+    AuditIndex index;
+    bool indexLoaded = false;
+    if (size > 0) {
+        bool rotateNow = rotation.maxBytes > 0 && size >= rotation.maxBytes;
+        if (!rotateNow && rotation.maxAgeSeconds > 0) {
+            index = readIndex(path);
+            indexLoaded = true;
+            long long first = epochOf(firstTime(path, index));
+            long long now = static_cast<long long>(std::time(nullptr));
+            rotateNow = first >= 0 && now - first > rotation.maxAgeSeconds;
+        }
+        if (rotateNow) {
+            if (!indexLoaded) {
+                index = readIndex(path);
+            }
+            rotate(path, index, size);
+            size = fs::exists(path, ec) ? fs::file_size(path, ec) : 0;
+        }
+    }
+
+    std::FILE* file = std::fopen(path.c_str(), "ab");
+    if (!file) {
+        return;
+    }
+    bool written = std::fwrite(lines.data(), 1, lines.size(), file) == lines.size();
+    std::fclose(file);
+
+    if (written && (size == 0 || size / MARK_STEP != (size + lines.size()) / MARK_STEP)) {
+        std::ofstream(indexPath(path), std::ios::app) << "mark " << size << " " << lines.substr(0, lines.find(' '))
+                                                      << "\n";
+    }
+}
+
+std::vector<AuditEntry> queryAudit(const std::string& path, const AuditQuery& query) {
+    std::vector<AuditEntry> newestFirst;
+    bool done = false;
+    auto full = [&] { return query.limit > 0 && newestFirst.size() >= query.limit; };
+
+    AuditIndex index = readIndex(path);
+    std::error_code ec;
+    uint64_t end = fs::exists(path, ec) ? fs::file_size(path, ec) : 0;
+    if (!query.until.empty()) {
+        // Everything from the first mark past `until` on is newer still
+        for (const auto& [offset, time] : index.marks) {
+            if (afterUntil(time, query) && offset < end) {
+                end = offset;
+                break;
+            }
+        }
+    }
+    scanBackwards(path, end, [&](const std::string& line) {
+        AuditEntry entry;
+        if (!parseEntry(line, entry)) {
+            return true;
+        }
+        if (beforeSince(entry.timestamp, query)) {
+            done = true;
+            return false;
+        }
+        if (matches(entry, query)) {
+            newestFirst.push_back(std::move(entry));
+        }
+        return !(done = full());
+    });
+
+    std::string dir = fs::path(path).parent_path().string();
+    for (auto it = index.segments.rbegin(); it != index.segments.rend() && !done; ++it) {
+        if (afterUntil(it->first, query)) {
+            continue;
+        }
+        if (beforeSince(it->last, query)) {
+            break;
+        }
+        std::vector<AuditEntry> found;
+        scanSegment((fs::path(dir) / it->file).string(), [&](const std::string& line) {
+            AuditEntry entry;
+            if (parseEntry(line, entry) && matches(entry, query)) {
+                found.push_back(std::move(entry));
+            }
+        });
+        for (auto f = found.rbegin(); f != found.rend() && !full(); ++f) {
+            newestFirst.push_back(std::move(*f));
+        }
+        done = full();
+    }
+
+    std::reverse(newestFirst.begin(), newestFirst.end());
+    return newestFirst;
+}
+
+std::string resolveAuditTime(const std::string& spec) {
+    if (spec.size() < 2) {
+        return spec;
+    }
+    char unit = spec.back();
+    long long scale = unit == 'd' ? 86400 : unit == 'h' ? 3600 : unit == 'm' ? 60 : unit == 's' ? 1 : 0;
+    std::string digits = spec.substr(0, spec.size() - 1);
+    if (scale == 0 || digits.find_first_not_of("0123456789") != std::string::npos) {
+        return spec;
+    }
+    return isoOf(static_cast<long long>(std::time(nullptr)) - std::stoll(digits) * scale);
+}
+
+} // namespace core
+} // namespace ak
@@ -1,5 +1,7 @@
 #include "core/config.hpp"
+#include "core/audit.hpp"
 #include "ui/ui.hpp"
+#include "system/process.hpp"
 #include <algorithm>
 #include <iostream>
 #include <sstream>
@@ -22,9 +24,9 @@ namespace core {
 const std::string AK_VERSION = AK_VERSION_STRING;
 
 // Utility functions
+// A PATH scan in-process: no shell is forked just to look for a tool
 bool commandExists(const std::string& cmd) {
-    std::string command = "command -v " + cmd + " >/dev/null 2>&1";
-    return system(command.c_str()) == 0;
+    return !system::findExecutable(cmd).empty();
 }
 
 std::string getenvs(const char* key, const std::string& defaultValue) {
@@ -51,7 +53,7 @@ bool icontains(const std::string& haystack, const std::string& needle) {
     return lower_haystack.find(lower_needle) != std::string::npos;
 }
 
-std::string maskValue(const std::string& value) {
+std::string maskValue(std::string_view value) {
     if (value.empty()) {
         return "(empty)";
     }
@@ -62,7 +64,7 @@ std::string maskValue(const std::string& value) {
     }
     
     // For longer values, show first 8 + "***" + last 4 characters
-    return value.substr(0, 8) + "***" + value.substr(value.length() - 4);
+    return std::string(value.substr(0, 8)) + "***" + std::string(value.substr(value.length() - 4));
 }
 
 // Error handling and output
@@ -118,19 +120,16 @@ std::string isoTimeUTC() {
 }
 
 void auditLog(const Config& cfg, const std::string& action, const std::vector<std::string>& keys) {
-    if (cfg.auditLogPath.empty()) return;
-    
-    std::ofstream logFile(cfg.auditLogPath, std::ios::app);
-    if (!logFile.is_open()) return;
+    if (cfg.auditLogPath.empty() || keys.empty()) return;
     
     std::string timestamp = isoTimeUTC();
     
+    // One batch, one write
+    std::string lines;
     for (const auto& key : keys) {
-        std::string hashedKey = hashKeyName(key);
-        logFile << timestamp << " " << action << " " << hashedKey << std::endl;
+        lines += timestamp + " " + action + " " + hashKeyName(key) + "\n";
     }
-    
-    logFile.close();
+    appendAudit(cfg.auditLogPath, lines, auditRotationFromEnv());
 }
 
 // Instance management
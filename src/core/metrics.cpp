@@ -0,0 +1,327 @@
+#include "core/metrics.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+
+namespace ak {
+namespace core {
+namespace metrics {
+
+namespace {
+
+std::atomic<bool> collecting{false};
+std::atomic<long long> startedNs{0};
+
+struct Entry {
+    std::string name;
+    Labels labels;
+    std::unique_ptr<Counter> counter;
+    std::unique_ptr<Histogram> histogram;
+};
+
+struct Registry {
+    std::mutex mutex;
+    std::map<std::string, Entry> entries; // by name + labels, so families stay together
+};
+
+Registry& registry() {
+    static Registry* instance = new Registry(); // outlives exit-time publishing
+    return *instance;
+}
+
+long long nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch())
+        .count();
+}
+
+std::string keyFor(const std::string& name, const Labels& labels) {
+    std::string key = name;
+    for (const auto& [k, v] : labels) {
+        key += '\x01';
+        key += k;
+        key += '=';
+        key += v;
+    }
+    return key;
+}
+
+Entry& lookup(const std::string& name, const Labels& labels) {
+    auto& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    auto [it, inserted] = reg.entries.try_emplace(keyFor(name, labels));
+    if (inserted) {
+        it->second.name = name;
+        it->second.labels = labels;
+    }
+    return it->second;
+}
+
+std::string formatNumber(double value) {
+    std::ostringstream out;
+    out << std::setprecision(9) << value;
+    return out.str();
+}
+
+void appendEscaped(std::string& out, const std::string& value, bool json) {
+    for (char c : value) {
+        if (c == '\\' || c == '"') {
+            out += '\\';
+            out += c;
+        } else if (c == '\n') {
+            out += "\\n";
+        } else if (json && static_cast<unsigned char>(c) < 0x20) {
+            char buf[8];
+            std::snprintf(buf, sizeof(buf), "\\u%04x", static_cast<unsigned char>(c));
+            out += buf;
+        } else {
+            out += c;
+        }
+    }
+}
+
+// {a="1",b="2"} plus an optional trailing le label
+std::string promLabels(const Labels& labels, const std::string& le = "") {
+    if (labels.empty() && le.empty()) {
+        return "";
+    }
+    std::string out = "{";
+    for (const auto& [k, v] : labels) {
+        if (out.size() > 1) {
+            out += ',';
+        }
+        out += k + "=\"";
+        appendEscaped(out, v, false);
+        out += '"';
+    }
+    if (!le.empty()) {
+        if (out.size() > 1) {
+            out += ',';
+        }
+        out += "le=\"" + le + "\"";
+    }
+    return out + "}";
+}
+
+std::string otlpAttributes(const Labels& labels) {
+    std::string out = "[";
+    for (const auto& [k, v] : labels) {
+        if (out.size() > 1) {
+            out += ',';
+        }
+        out += "{\"key\":\"";
+        appendEscaped(out, k, true);
+        out += "\",\"value\":{\"stringValue\":\"";
+        appendEscaped(out, v, true);
+        out += "\"}}";
+    }
+    return out + "]";
+}
+
+} // namespace
+
+void enable() {
+    long long expected = 0;
+    startedNs.compare_exchange_strong(expected, nowNs());
+    collecting.store(true, std::memory_order_relaxed);
+}
+
+bool enabled() {
+    return collecting.load(std::memory_order_relaxed);
+}
+
+void Histogram::observe(double seconds) {
+    seconds = std::max(seconds, 0.0);
+    size_t bucket = static_cast<size_t>(std::lower_bound(BOUNDS.begin(), BOUNDS.end(), seconds) - BOUNDS.begin());
+    counts_[bucket].fetch_add(1, std::memory_order_relaxed);
+    sumNs_.fetch_add(static_cast<uint64_t>(seconds * 1e9), std::memory_order_relaxed);
+}
+
+std::array<uint64_t, Histogram::BOUNDS.size() + 1> Histogram::buckets() const {
+    std::array<uint64_t, BOUNDS.size() + 1> out{};
+    for (size_t i = 0; i < out.size(); ++i) {
+        out[i] = counts_[i].load(std::memory_order_relaxed);
+    }
+    return out;
+}
+
+uint64_t Histogram::count() const {
+    uint64_t total = 0;
+    for (const auto& c : counts_) {
+        total += c.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+Counter& counter(const std::string& name, const Labels& labels) {
+    Entry& entry = lookup(name, labels);
+    std::lock_guard<std::mutex> lock(registry().mutex);
+    if (!entry.counter) {
+        entry.counter = std::make_unique<Counter>();
+    }
+    return *entry.counter;
+}
+
+Histogram& histogram(const std::string& name, const Labels& labels) {
+    Entry& entry = lookup(name, labels);
+    std::lock_guard<std::mutex> lock(registry().mutex);
+    if (!entry.histogram) {
+        entry.histogram = std::make_unique<Histogram>();
+    }
+    return *entry.histogram;
+}
+
+void count(const std::string& name, const Labels& labels, uint64_t n) {
+    if (enabled()) {
+        counter(name, labels).add(n);
+    }
+}
+
+void observe(const std::string& name, const Labels& labels, double seconds) {
+    if (enabled()) {
+        histogram(name, labels).observe(seconds);
+    }
+}
+
+Span::Span(const char* name, Labels labels) : name_(name), active_(enabled()) {
+    if (active_) {
+        labels_ = std::move(labels);
+        start_ = std::chrono::steady_clock::now();
+    }
+}
+
+Span::~Span() {
+    if (active_) {
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start_;
+        histogram(std::string(name_) + "_seconds", labels_).observe(elapsed.count());
+    }
+}
+
+void Span::label(std::string key, std::string value) {
+    if (active_) {
+        labels_.emplace_back(std::move(key), std::move(value));
+    }
+}
+
+std::string prometheusText() {
+    auto& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    std::string out;
+    const std::string* family = nullptr;
+    for (const auto& [key, entry] : reg.entries) {
+        if (!family || *family != entry.name) {
+            family = &entry.name;
+            out += "# TYPE " + entry.name + (entry.histogram ? " histogram\n" : " counter\n");
+        }
+        if (entry.counter) {
+            out += entry.name + promLabels(entry.labels) + " " + std::to_string(entry.counter->value()) + "\n";
+        }
+        if (entry.histogram) {
+            auto counts = entry.histogram->buckets();
+            uint64_t cumulative = 0;
+            for (size_t i = 0; i < counts.size(); ++i) {
+                cumulative += counts[i];
+                std::string le = i < Histogram::BOUNDS.size() ? formatNumber(Histogram::BOUNDS[i]) : "+Inf";
+                out += entry.name + "_bucket" + promLabels(entry.labels, le) + " " + std::to_string(cumulative) + "\n";
+            }
+            out += entry.name + "_sum" + promLabels(entry.labels) + " " + formatNumber(entry.histogram->sum()) + "\n";
+            out += entry.name + "_count" + promLabels(entry.labels) + " " + std::to_string(cumulative) + "\n";
+        }
+    }
+    return out;
+}
+
+std::string otlpJson() {
+    auto& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    std::string times = "\"startTimeUnixNano\":\"" + std::to_string(startedNs.load()) + "\",\"timeUnixNano\":\"" +
+                        std::to_string(nowNs()) + "\"";
+
+    // One metric per family, one data point per label set
+    std::vector<std::string> metrics;
+    std::string points;
+    const Entry* family = nullptr;
+    auto flush = [&]() {
+        if (!family) {
+            return;
+        }
+        if (family->histogram) {
+            metrics.push_back("{\"name\":\"" + family->name + "\",\"unit\":\"s\",\"histogram\":{\"dataPoints\":[" +
+                              points + "],\"aggregationTemporality\":2}}");
+        } else {
+            metrics.push_back("{\"name\":\"" + family->name + "\",\"sum\":{\"dataPoints\":[" + points +
+                              "],\"aggregationTemporality\":2,\"isMonotonic\":true}}");
+        }
+        points.clear();
+    };
+    for (const auto& [key, entry] : reg.entries) {
+        if (!family || family->name != entry.name) {
+            flush();
+            family = &entry;
+        }
+        if (!points.empty()) {
+            points += ',';
+        }
+        points += "{\"attributes\":" + otlpAttributes(entry.labels) + "," + times;
+        if (entry.histogram) {
+            auto counts = entry.histogram->buckets();
+            uint64_t total = 0;
+            std::string buckets;
+            for (uint64_t c : counts) {
+                buckets += (buckets.empty() ? "\"" : ",\"") + std::to_string(c) + "\"";
+                total += c;
+            }
+            std::string bounds;
+            for (double b : Histogram::BOUNDS) {
+                bounds += (bounds.empty() ? "" : ",") + formatNumber(b);
+            }
+            points += ",\"count\":\"" + std::to_string(total) + "\",\"sum\":" + formatNumber(entry.histogram->sum()) +
+                      ",\"bucketCounts\":[" + buckets + "],\"explicitBounds\":[" + bounds + "]}";
+        } else if (entry.counter) {
+            points += ",\"asInt\":\"" + std::to_string(entry.counter->value()) + "\"}";
+        }
+    }
+    flush();
+
+    std::string out = "{\"resourceMetrics\":[{\"resource\":{\"attributes\":[{\"key\":\"service.name\",\"value\":"
+                      "{\"stringValue\":\"ak\"}}]},\"scopeMetrics\":[{\"scope\":{\"name\":\"ak\"},\"metrics\":[";
+    for (size_t i = 0; i < metrics.size(); ++i) {
+        out += (i ? "," : "") + metrics[i];
+    }
+    return out + "]}]}]}";
+}
+
+bool writePrometheusFile(const std::string& path) {
+    std::string tmp = path + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            return false;
+        }
+        out << prometheusText();
+        if (!out.flush()) {
+            std::remove(tmp.c_str());
+            return false;
+        }
+    }
+    if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+        std::remove(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+void reset() {
+    auto& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    reg.entries.clear();
+}
+
+} // namespace metrics
+} // namespace core
+} // namespace ak
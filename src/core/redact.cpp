@@ -0,0 +1,195 @@
+#include "core/redact.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <deque>
+
+#ifdef _WIN32
+#include <io.h>
+#define read _read
+#define write _write
+#else
+#include <unistd.h>
+#endif
+
+namespace ak {
+namespace core {
+
+PatternMatcher::PatternMatcher(std::vector<Pattern> patterns) : patterns_(std::move(patterns)) {
+    nodes_.emplace_back();
+    for (uint32_t id = 0; id < patterns_.size(); ++id) {
+        const std::string& text = patterns_[id].text;
+        if (text.empty()) {
+            continue;
+        }
+        int32_t node = 0;
+        for (unsigned char raw : text) {
+            unsigned char c = fold(raw);
+            int32_t next = child(node, c);
+            if (next < 0) {
+                next = static_cast<int32_t>(nodes_.size());
+                nodes_.emplace_back();
+                auto& edges = nodes_[node].next;
+                auto at = std::lower_bound(edges.begin(), edges.end(), std::make_pair(c, int32_t(0)));
+                edges.insert(at, {c, next});
+            }
+            node = next;
+        }
+        nodes_[node].ends.push_back(id);
+        longest_ = std::max(longest_, text.size());
+        spansLines_ = spansLines_ || text.find('\n') != std::string::npos;
+    }
+
+    for (int c = 0; c < 256; ++c) {
+        int32_t next = child(0, static_cast<unsigned char>(c));
+        root_[c] = next < 0 ? 0 : next;
+    }
+    // Breadth first, so every fail target is finished before it is used
+    std::deque<int32_t> queue;
+    for (const auto& edge : nodes_[0].next) {
+        queue.push_back(edge.second);
+    }
+    while (!queue.empty()) {
+        int32_t node = queue.front();
+        queue.pop_front();
+        for (const auto& [c, next] : nodes_[node].next) {
+            int32_t fail = step(nodes_[node].fail, c);
+            nodes_[next].fail = fail;
+            nodes_[next].outLink = nodes_[fail].ends.empty() ? nodes_[fail].outLink : fail;
+            queue.push_back(next);
+        }
+    }
+}
+
+int32_t PatternMatcher::child(int32_t node, unsigned char c) const {
+    for (const auto& edge : nodes_[node].next) {
+        if (edge.first == c) {
+            return edge.second;
+        }
+        if (edge.first > c) {
+            break;
+        }
+    }
+    return -1;
+}
+
+int32_t PatternMatcher::step(int32_t node, unsigned char c) const {
+    while (node != 0) {
+        int32_t next = child(node, c);
+        if (next >= 0) {
+            return next;
+        }
+        node = nodes_[node].fail;
+    }
+    return root_[c];
+}
+
+bool PatternMatcher::confirm(uint32_t id, std::string_view text, size_t begin) const {
+    const Pattern& pattern = patterns_[id];
+    return pattern.ignoreCase || text.compare(begin, pattern.text.size(), pattern.text) == 0;
+}
+
+Redactor::Redactor(const std::vector<std::string>& secrets, const std::vector<std::string>& phrases)
+    : secretCount_(secrets.size()) {
+    std::vector<PatternMatcher::Pattern> patterns;
+    patterns.reserve(secrets.size() + phrases.size());
+    for (const auto& secret : secrets) {
+        patterns.push_back({secret, false});
+    }
+    for (const auto& phrase : phrases) {
+        patterns.push_back({phrase, true});
+    }
+    matcher_ = PatternMatcher(std::move(patterns));
+}
+
+size_t Redactor::redactInto(std::string_view text, size_t limit, std::string& out, bool* flagged) const {
+    std::vector<std::pair<size_t, size_t>> spans;
+    bool phrase = false;
+    matcher_.scan(text, [&](size_t id, size_t begin, size_t end) {
+        if (id < secretCount_) {
+            spans.emplace_back(begin, end);
+        } else {
+            phrase = true;
+        }
+    });
+    if (flagged) {
+        *flagged = phrase;
+    }
+    std::sort(spans.begin(), spans.end());
+
+    size_t consumed = limit;
+    size_t pos = 0;
+    for (size_t i = 0; i < spans.size() && spans[i].first < consumed;) {
+        size_t begin = spans[i].first;
+        size_t end = spans[i].second;
+        // Overlapping secrets become one token
+        for (++i; i < spans.size() && spans[i].first < end; ++i) {
+            end = std::max(end, spans[i].second);
+        }
+        out.append(text.substr(pos, begin - pos));
+        out.append(TOKEN);
+        pos = end;
+        consumed = std::max(consumed, end);
+    }
+    out.append(text.substr(pos, consumed - pos));
+    return consumed;
+}
+
+std::string Redactor::redact(std::string_view text, bool* flagged) const {
+    std::string out;
+    out.reserve(text.size());
+    redactInto(text, text.size(), out, flagged);
+    return out;
+}
+
+bool Redactor::flags(std::string_view text) const {
+    bool phrase = false;
+    matcher_.scan(text, [&](size_t id, size_t, size_t) { phrase = phrase || id >= secretCount_; });
+    return phrase;
+}
+
+bool Redactor::redactStream(int inFd, int outFd) const {
+    std::string buffer;
+    std::string out;
+    char chunk[65536];
+    size_t hold = matcher_.longest() > 0 ? matcher_.longest() - 1 : 0;
+    for (;;) {
+        auto n = ::read(inFd, chunk, sizeof(chunk));
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        bool eof = n == 0;
+        buffer.append(chunk, static_cast<size_t>(n));
+
+        size_t limit = buffer.size();
+        if (!eof) {
+            limit = buffer.size() > hold ? buffer.size() - hold : 0;
+            size_t newline = matcher_.spansLines() ? std::string::npos : buffer.rfind('\n');
+            if (newline != std::string::npos) {
+                limit = std::max(limit, newline + 1);
+            }
+        }
+        out.clear();
+        buffer.erase(0, redactInto(buffer, limit, out, nullptr));
+
+        for (size_t done = 0; done < out.size();) {
+            auto w = ::write(outFd, out.data() + done, static_cast<unsigned>(out.size() - done));
+            if (w < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            done += static_cast<size_t>(w);
+        }
+        if (eof) {
+            return true;
+        }
+    }
+}
+
+} // namespace core
+} // namespace ak
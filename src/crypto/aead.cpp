@@ -0,0 +1,292 @@
+#include "crypto/aead.hpp"
+#include "crypto/crypto.hpp"
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#ifdef AK_HAVE_OPENSSL
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#endif
+
+namespace ak {
+namespace crypto {
+
+namespace {
+
+constexpr char MAGIC[4] = {'A', 'K', 'V', '1'};
+constexpr uint8_t KDF_SCRYPT = 1;
+constexpr size_t SALT_LEN = 16;
+constexpr size_t NONCE_LEN = 12;
+constexpr size_t TAG_LEN = 16;
+constexpr size_t KEY_LEN = 32;
+constexpr size_t HEADER_LEN = sizeof(MAGIC) + 4 + SALT_LEN + NONCE_LEN;
+
+// scrypt N=2^15, r=8, p=1 (~32 MiB). Stored per file so it can be raised later.
+constexpr uint8_t DEFAULT_LOG2N = 15;
+constexpr uint8_t DEFAULT_R = 8;
+constexpr uint8_t DEFAULT_P = 1;
+
+// Headers come from files that may have been shared or pulled, so what they
+// may ask of scrypt is bounded: at most 1 GiB and a few times the default work
+constexpr uint8_t MAX_R = 32;
+constexpr uint8_t MAX_P = 16;
+constexpr uint64_t MAX_KDF_MEM = uint64_t(1) << 30;
+
+struct KdfParams {
+    uint8_t log2N = DEFAULT_LOG2N;
+    uint8_t r = DEFAULT_R;
+    uint8_t p = DEFAULT_P;
+    std::string salt;
+};
+
+uint64_t kdfMemory(const KdfParams& params) {
+    return 128ULL * params.r * ((uint64_t(1) << params.log2N) + params.p + 2);
+}
+
+bool kdfParamsSupported(const KdfParams& params) {
+    return params.log2N >= 10 && params.log2N <= 22 && params.r >= 1 && params.r <= MAX_R &&
+           params.p >= 1 && params.p <= MAX_P && kdfMemory(params) <= MAX_KDF_MEM;
+}
+
+// Header fields of a blob already known to be long enough
+KdfParams headerParams(const std::string& blob) {
+    KdfParams params;
+    params.log2N = static_cast<uint8_t>(blob[5]);
+    params.r = static_cast<uint8_t>(blob[6]);
+    params.p = static_cast<uint8_t>(blob[7]);
+    params.salt = blob.substr(8, SALT_LEN);
+    return params;
+}
+
+struct CachedKey {
+    std::string passDigest;  // SHA256 of the passphrase, never the passphrase itself
+    KdfParams params;
+    std::string key;
+};
+
+std::mutex keyCacheMutex;
+std::vector<CachedKey> keyCache;
+
+void wipe(std::string& s) {
+#ifdef AK_HAVE_OPENSSL
+    if (!s.empty()) {
+        OPENSSL_cleanse(&s[0], s.size());
+    }
+#else
+    std::fill(s.begin(), s.end(), '\0');
+#endif
+    s.clear();
+}
+
+std::string passphraseDigest(const std::string& passphrase) {
+    SHA256 hasher;
+    hasher.update(passphrase);
+    return hasher.final();
+}
+
+#ifdef AK_HAVE_OPENSSL
+std::string deriveKey(const std::string& passphrase, const KdfParams& params) {
+    if (!kdfParamsSupported(params)) {
+        throw std::runtime_error("Unsupported vault KDF parameters");
+    }
+    std::string key(KEY_LEN, '\0');
+    uint64_t n = uint64_t(1) << params.log2N;
+    uint64_t maxMem = kdfMemory(params) + (1 << 20);
+    if (EVP_PBE_scrypt(passphrase.data(), passphrase.size(),
+                       reinterpret_cast<const unsigned char*>(params.salt.data()), params.salt.size(),
+                       n, params.r, params.p, maxMem,
+                       reinterpret_cast<unsigned char*>(&key[0]), key.size()) != 1) {
+        throw std::runtime_error("Key derivation failed");
+    }
+    return key;
+}
+#endif
+
+// Look up (or derive and remember) the key for these parameters
+std::string keyFor(const std::string& passphrase, const KdfParams& params) {
+    std::string digest = passphraseDigest(passphrase);
+    {
+        std::lock_guard<std::mutex> lock(keyCacheMutex);
+        for (const auto& entry : keyCache) {
+            if (entry.passDigest == digest && entry.params.salt == params.salt &&
+                entry.params.log2N == params.log2N && entry.params.r == params.r &&
+                entry.params.p == params.p) {
+                return entry.key;
+            }
+        }
+    }
+#ifdef AK_HAVE_OPENSSL
+    std::string key = deriveKey(passphrase, params);
+    std::lock_guard<std::mutex> lock(keyCacheMutex);
+    keyCache.push_back({digest, params, key});
+    return key;
+#else
+    throw std::runtime_error("AEAD backend not available in this build");
+#endif
+}
+
+// Parameters for sealing: reuse the salt of a key already derived for this
+// passphrase so saving right after loading doesn't run the KDF a second time.
+KdfParams sealParams(const std::string& passphrase) {
+    std::string digest = passphraseDigest(passphrase);
+    {
+        std::lock_guard<std::mutex> lock(keyCacheMutex);
+        for (auto it = keyCache.rbegin(); it != keyCache.rend(); ++it) {
+            if (it->passDigest == digest && it->params.log2N >= DEFAULT_LOG2N) {
+                return it->params;
+            }
+        }
+    }
+    KdfParams params;
+    params.salt.assign(SALT_LEN, '\0');
+#ifdef AK_HAVE_OPENSSL
+    if (RAND_bytes(reinterpret_cast<unsigned char*>(&params.salt[0]), SALT_LEN) != 1) {
+        throw std::runtime_error("Failed to generate salt");
+    }
+#endif
+    return params;
+}
+
+} // namespace
+
+bool aeadAvailable() {
+#ifdef AK_HAVE_OPENSSL
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool isAeadBlob(const std::string& blob) {
+    return blob.size() >= sizeof(MAGIC) && std::memcmp(blob.data(), MAGIC, sizeof(MAGIC)) == 0;
+}
+
+bool aeadParamsSupported(const std::string& blob) {
+    if (blob.size() < HEADER_LEN || !isAeadBlob(blob) || static_cast<uint8_t>(blob[4]) != KDF_SCRYPT) {
+        return false;
+    }
+    return kdfParamsSupported(headerParams(blob));
+}
+
+std::string aeadSeal(const std::string& plaintext, const std::string& passphrase) {
+#ifdef AK_HAVE_OPENSSL
+    KdfParams params = sealParams(passphrase);
+    std::string key = keyFor(passphrase, params);
+
+    std::string out;
+    out.reserve(HEADER_LEN + plaintext.size() + TAG_LEN);
+    out.append(MAGIC, sizeof(MAGIC));
+    out.push_back(static_cast<char>(KDF_SCRYPT));
+    out.push_back(static_cast<char>(params.log2N));
+    out.push_back(static_cast<char>(params.r));
+    out.push_back(static_cast<char>(params.p));
+    out.append(params.salt);
+
+    unsigned char nonce[NONCE_LEN];
+    if (RAND_bytes(nonce, NONCE_LEN) != 1) {
+        wipe(key);
+        throw std::runtime_error("Failed to generate nonce");
+    }
+    out.append(reinterpret_cast<const char*>(nonce), NONCE_LEN);
+
+    EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+    bool ok = ctx != nullptr;
+    int len = 0;
+    size_t ctOffset = out.size();
+    out.resize(ctOffset + plaintext.size() + TAG_LEN);
+    auto* ct = reinterpret_cast<unsigned char*>(&out[ctOffset]);
+
+    ok = ok && EVP_EncryptInit_ex(ctx, EVP_aes_256_gcm(), nullptr, nullptr, nullptr) == 1;
+    ok = ok && EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_IVLEN, NONCE_LEN, nullptr) == 1;
+    ok = ok && EVP_EncryptInit_ex(ctx, nullptr, nullptr,
+                                  reinterpret_cast<const unsigned char*>(key.data()), nonce) == 1;
+    ok = ok && EVP_EncryptUpdate(ctx, nullptr, &len,
+                                 reinterpret_cast<const unsigned char*>(out.data()), HEADER_LEN) == 1;
+    ok = ok && EVP_EncryptUpdate(ctx, ct, &len,
+                                 reinterpret_cast<const unsigned char*>(plaintext.data()),
+                                 static_cast<int>(plaintext.size())) == 1;
+    ok = ok && EVP_EncryptFinal_ex(ctx, ct + len, &len) == 1;
+    ok = ok && EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, TAG_LEN, ct + plaintext.size()) == 1;
+    EVP_CIPHER_CTX_free(ctx);
+    wipe(key);
+
+    if (!ok) {
+        throw std::runtime_error("Failed to encrypt vault");
+    }
+    return out;
+#else
+    (void)plaintext;
+    (void)passphrase;
+    throw std::runtime_error("AEAD backend not available in this build");
+#endif
+}
+
+bool aeadOpen(const std::string& blob, const std::string& passphrase, std::string& plaintext) {
+#ifdef AK_HAVE_OPENSSL
+    if (blob.size() < HEADER_LEN + TAG_LEN || !isAeadBlob(blob) ||
+        static_cast<uint8_t>(blob[4]) != KDF_SCRYPT) {
+        return false;
+    }
+
+    KdfParams params = headerParams(blob);
+    if (!kdfParamsSupported(params)) {
+        return false;
+    }
+    const auto* nonce = reinterpret_cast<const unsigned char*>(blob.data() + 8 + SALT_LEN);
+    const auto* ct = reinterpret_cast<const unsigned char*>(blob.data() + HEADER_LEN);
+    size_t ctLen = blob.size() - HEADER_LEN - TAG_LEN;
+
+    std::string key;
+    try {
+        key = keyFor(passphrase, params);
+    } catch (const std::exception&) {
+        return false;
+    }
+
+    std::string out(ctLen, '\0');
+    EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+    bool ok = ctx != nullptr;
+    int len = 0;
+    auto* pt = reinterpret_cast<unsigned char*>(&out[0]);
+
+    ok = ok && EVP_DecryptInit_ex(ctx, EVP_aes_256_gcm(), nullptr, nullptr, nullptr) == 1;
+    ok = ok && EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_IVLEN, NONCE_LEN, nullptr) == 1;
+    ok = ok && EVP_DecryptInit_ex(ctx, nullptr, nullptr,
+                                  reinterpret_cast<const unsigned char*>(key.data()), nonce) == 1;
+    ok = ok && EVP_DecryptUpdate(ctx, nullptr, &len,
+                                 reinterpret_cast<const unsigned char*>(blob.data()), HEADER_LEN) == 1;
+    ok = ok && EVP_DecryptUpdate(ctx, pt, &len, ct, static_cast<int>(ctLen)) == 1;
+    ok = ok && EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, TAG_LEN,
+                                   const_cast<char*>(blob.data() + HEADER_LEN + ctLen)) == 1;
+    ok = ok && EVP_DecryptFinal_ex(ctx, pt + len, &len) == 1;
+    EVP_CIPHER_CTX_free(ctx);
+    wipe(key);
+
+    if (!ok) {
+        wipe(out);
+        return false;
+    }
+    plaintext.swap(out);
+    return true;
+#else
+    (void)blob;
+    (void)passphrase;
+    (void)plaintext;
+    return false;
+#endif
+}
+
+void aeadClearKeyCache() {
+    std::lock_guard<std::mutex> lock(keyCacheMutex);
+    for (auto& entry : keyCache) {
+        wipe(entry.key);
+    }
+    keyCache.clear();
+}
+
+} // namespace crypto
+} // namespace ak
@@ -1,73 +1,602 @@
 #include "crypto/crypto.hpp"
-#include <sstream>
-#include <iomanip>
+#include <algorithm>
+#include <atomic>
 #include <cstring>
 
+// Vector code: x86 paths are compiled per function with target attributes
+// and picked at runtime. NEON is baseline on AArch64; the ARMv8 SHA-2
+// instructions need the crypto extension enabled for the whole build
+// (e.g. -march=armv8-a+crypto, the default on Apple).
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define AK_CRYPTO_X86 1
+#include <cpuid.h>
+#include <immintrin.h>
+#else
+#define AK_CRYPTO_X86 0
+#endif
+
+#if defined(__aarch64__) && (defined(__ARM_FEATURE_SHA2) || defined(__ARM_FEATURE_CRYPTO)) && \
+    (defined(__APPLE__) || defined(__linux__))
+#define AK_SHA256_ARM 1
+#include <arm_neon.h>
+#if !defined(__APPLE__)
+#include <asm/hwcap.h>
+#include <sys/auxv.h>
+#endif
+#else
+#define AK_SHA256_ARM 0
+#endif
+
+#if defined(__aarch64__) && (defined(__GNUC__) || defined(__clang__))
+#define AK_BASE64_NEON 1
+#if !AK_SHA256_ARM
+#include <arm_neon.h>
+#endif
+#else
+#define AK_BASE64_NEON 0
+#endif
+
 namespace ak {
 namespace crypto {
 
-// Base64 encoding
-std::string base64Encode(const std::string& input) {
-    static const char table[] =
-        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
-    
-    std::string output;
-    output.reserve(((input.size() + 2) / 3) * 4);
-    
-    unsigned char a3[3];
-    for (size_t pos = 0; pos < input.size();) {
-        int len = 0;
-        for (; len < 3 && pos < input.size(); ++len) {
-            a3[len] = static_cast<unsigned char>(input[pos++]);
-        }
-        if (len < 3) {
-            for (int j = len; j < 3; ++j) {
-                a3[j] = 0;
-            }
+// Base64. The scalar code handles tails and anything the vector loops
+// refuse; the vector loops only ever run on whole, valid chunks.
+namespace {
+
+const char B64_TABLE[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// 0..63 for alphabet characters, 0xFF otherwise
+struct DecodeTable {
+    uint8_t value[256];
+    DecodeTable() {
+        std::memset(value, 0xFF, sizeof(value));
+        for (int i = 0; i < 64; ++i) {
+            value[static_cast<uint8_t>(B64_TABLE[i])] = static_cast<uint8_t>(i);
         }
-        
-        unsigned int triple = (a3[0] << 16) | (a3[1] << 8) | a3[2];
-        output.push_back(table[(triple >> 18) & 0x3F]);
-        output.push_back(table[(triple >> 12) & 0x3F]);
-        output.push_back(len >= 2 ? table[(triple >> 6) & 0x3F] : '=');
-        output.push_back(len >= 3 ? table[triple & 0x3F] : '=');
     }
-    
+};
+const DecodeTable B64_DECODE;
+
+// Whole 3-byte groups -> 4 chars each; returns bytes consumed
+using EncodeBlocksFn = size_t (*)(const uint8_t*, size_t, char*);
+// Valid 4-char groups -> 3 bytes each, stopping before a chunk that holds
+// anything outside the alphabet; returns chars consumed. May write up to
+// 8 bytes past the decoded output.
+using DecodeBlocksFn = size_t (*)(const char*, size_t, uint8_t*);
+
+size_t encodeBlocksScalar(const uint8_t* in, size_t n, char* out) {
+    size_t i = 0;
+    for (; i + 3 <= n; i += 3, out += 4) {
+        uint32_t triple = (static_cast<uint32_t>(in[i]) << 16) | (in[i + 1] << 8) | in[i + 2];
+        out[0] = B64_TABLE[(triple >> 18) & 0x3F];
+        out[1] = B64_TABLE[(triple >> 12) & 0x3F];
+        out[2] = B64_TABLE[(triple >> 6) & 0x3F];
+        out[3] = B64_TABLE[triple & 0x3F];
+    }
+    return i;
+}
+
+size_t decodeBlocksScalar(const char* in, size_t n, uint8_t* out) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4, out += 3) {
+        uint32_t a = B64_DECODE.value[static_cast<uint8_t>(in[i])];
+        uint32_t b = B64_DECODE.value[static_cast<uint8_t>(in[i + 1])];
+        uint32_t c = B64_DECODE.value[static_cast<uint8_t>(in[i + 2])];
+        uint32_t d = B64_DECODE.value[static_cast<uint8_t>(in[i + 3])];
+        if ((a | b | c | d) & 0x80) {
+            break;
+        }
+        uint32_t triple = (a << 18) | (b << 12) | (c << 6) | d;
+        out[0] = static_cast<uint8_t>(triple >> 16);
+        out[1] = static_cast<uint8_t>(triple >> 8);
+        out[2] = static_cast<uint8_t>(triple);
+    }
+    return i;
+}
+
+#if AK_CRYPTO_X86
+// Vector code after Muła and Lemire, "Faster Base64 Encoding and Decoding
+// using AVX2 Instructions"; the same per-128-bit-lane steps serve SSSE3 and
+// AVX2.
+__attribute__((target("ssse3")))
+inline __m128i encodeLane(__m128i in) {
+    // 12 input bytes -> four 6-bit indices per 32-bit lane
+    in = _mm_shuffle_epi8(in, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+    __m128i t0 = _mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00));
+    __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+    __m128i t2 = _mm_and_si128(in, _mm_set1_epi32(0x003f03f0));
+    __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+    __m128i indices = _mm_or_si128(t1, t3);
+
+    // Index -> ASCII by adding a per-range offset
+    __m128i reduced = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+    __m128i upper = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+    reduced = _mm_or_si128(reduced, _mm_and_si128(upper, _mm_set1_epi8(13)));
+    const __m128i offsets = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                          '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+    return _mm_add_epi8(_mm_shuffle_epi8(offsets, reduced), indices);
+}
+
+__attribute__((target("ssse3")))
+size_t encodeBlocksSsse3(const uint8_t* in, size_t n, char* out) {
+    size_t i = 0;
+    // Each step reads 16 bytes and consumes 12
+    for (; i + 16 <= n; i += 12, out += 16) {
+        __m128i chars = encodeLane(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out), chars);
+    }
+    return i + encodeBlocksScalar(in + i, n - i, out);
+}
+
+__attribute__((target("avx2")))
+size_t encodeBlocksAvx2(const uint8_t* in, size_t n, char* out) {
+    size_t i = 0;
+    for (; i + 28 <= n; i += 24, out += 32) {
+        __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i + 12));
+        __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+
+        v = _mm256_shuffle_epi8(v, _mm256_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1,
+                                                   10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+        __m256i t0 = _mm256_and_si256(v, _mm256_set1_epi32(0x0fc0fc00));
+        __m256i t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+        __m256i t2 = _mm256_and_si256(v, _mm256_set1_epi32(0x003f03f0));
+        __m256i t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+        __m256i indices = _mm256_or_si256(t1, t3);
+
+        __m256i reduced = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+        __m256i upper = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices);
+        reduced = _mm256_or_si256(reduced, _mm256_and_si256(upper, _mm256_set1_epi8(13)));
+        const __m256i offsets = _mm256_setr_epi8(
+            'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+            '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0, 'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+            '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+        __m256i chars = _mm256_add_epi8(_mm256_shuffle_epi8(offsets, reduced), indices);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), chars);
+    }
+    return i + encodeBlocksSsse3(in + i, n - i, out);
+}
+
+// ASCII -> 6-bit values, with a nibble-table validity check (any non
+// alphabet byte, including '=', makes the chunk fall back)
+__attribute__((target("ssse3")))
+size_t decodeBlocksSsse3(const char* in, size_t n, uint8_t* out) {
+    const __m128i lutLo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A,
+                                        0x1B, 0x1B, 0x1B, 0x1A);
+    const __m128i lutHi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10,
+                                        0x10, 0x10, 0x10, 0x10);
+    const __m128i lutRoll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i mask2F = _mm_set1_epi8(0x2F);
+
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16, out += 12) {
+        __m128i str = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        __m128i hiNibbles = _mm_and_si128(_mm_srli_epi32(str, 4), mask2F);
+        __m128i loNibbles = _mm_and_si128(str, mask2F);
+        __m128i hi = _mm_shuffle_epi8(lutHi, hiNibbles);
+        __m128i lo = _mm_shuffle_epi8(lutLo, loNibbles);
+        if (_mm_movemask_epi8(_mm_cmpgt_epi8(_mm_and_si128(lo, hi), _mm_setzero_si128())) != 0) {
+            break;
+        }
+        __m128i eq2F = _mm_cmpeq_epi8(str, mask2F);
+        __m128i roll = _mm_shuffle_epi8(lutRoll, _mm_add_epi8(eq2F, hiNibbles));
+        str = _mm_add_epi8(str, roll);
+
+        // Pack four 6-bit values per 32-bit lane into 3 bytes
+        __m128i merged = _mm_maddubs_epi16(str, _mm_set1_epi32(0x01400140));
+        merged = _mm_madd_epi16(merged, _mm_set1_epi32(0x00011000));
+        merged = _mm_shuffle_epi8(merged, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out), merged);
+    }
+    return i + decodeBlocksScalar(in + i, n - i, out);
+}
+
+__attribute__((target("avx2")))
+size_t decodeBlocksAvx2(const char* in, size_t n, uint8_t* out) {
+    const __m256i lutLo = _mm256_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A,
+                                           0x1B, 0x1B, 0x1B, 0x1A, 0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                           0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+    const __m256i lutHi = _mm256_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10,
+                                           0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                                           0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m256i lutRoll = _mm256_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+                                             0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m256i mask2F = _mm256_set1_epi8(0x2F);
+
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32, out += 24) {
+        __m256i str = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+        __m256i hiNibbles = _mm256_and_si256(_mm256_srli_epi32(str, 4), mask2F);
+        __m256i loNibbles = _mm256_and_si256(str, mask2F);
+        __m256i hi = _mm256_shuffle_epi8(lutHi, hiNibbles);
+        __m256i lo = _mm256_shuffle_epi8(lutLo, loNibbles);
+        if (!_mm256_testz_si256(lo, hi)) {
+            break;
+        }
+        __m256i eq2F = _mm256_cmpeq_epi8(str, mask2F);
+        __m256i roll = _mm256_shuffle_epi8(lutRoll, _mm256_add_epi8(eq2F, hiNibbles));
+        str = _mm256_add_epi8(str, roll);
+
+        __m256i merged = _mm256_maddubs_epi16(str, _mm256_set1_epi32(0x01400140));
+        merged = _mm256_madd_epi16(merged, _mm256_set1_epi32(0x00011000));
+        merged = _mm256_shuffle_epi8(merged, _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+                                                              2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+        // 12 bytes at the bottom of each lane -> 24 contiguous bytes
+        merged = _mm256_permutevar8x32_epi32(merged, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), merged);
+    }
+    return i + decodeBlocksSsse3(in + i, n - i, out);
+}
+#endif
+
+#if AK_BASE64_NEON
+size_t encodeBlocksNeon(const uint8_t* in, size_t n, char* out) {
+    const uint8x16x4_t table = vld1q_u8_x4(reinterpret_cast<const uint8_t*>(B64_TABLE));
+    const uint8x16_t mask6 = vdupq_n_u8(0x3F);
+    size_t i = 0;
+    for (; i + 48 <= n; i += 48, out += 64) {
+        uint8x16x3_t src = vld3q_u8(in + i);
+        uint8x16x4_t idx;
+        idx.val[0] = vshrq_n_u8(src.val[0], 2);
+        idx.val[1] = vandq_u8(vorrq_u8(vshlq_n_u8(src.val[0], 4), vshrq_n_u8(src.val[1], 4)), mask6);
+        idx.val[2] = vandq_u8(vorrq_u8(vshlq_n_u8(src.val[1], 2), vshrq_n_u8(src.val[2], 6)), mask6);
+        idx.val[3] = vandq_u8(src.val[2], mask6);
+        uint8x16x4_t chars;
+        for (int k = 0; k < 4; ++k) {
+            chars.val[k] = vqtbl4q_u8(table, idx.val[k]);
+        }
+        vst4q_u8(reinterpret_cast<uint8_t*>(out), chars);
+    }
+    return i + encodeBlocksScalar(in + i, n - i, out);
+}
+
+size_t decodeBlocksNeon(const char* in, size_t n, uint8_t* out) {
+    // Two 64-entry halves of the ASCII table; invalid entries are 0xFF and
+    // bytes >= 128 miss both halves
+    const uint8x16x4_t lo = vld1q_u8_x4(B64_DECODE.value);
+    const uint8x16x4_t hi = vld1q_u8_x4(B64_DECODE.value + 64);
+    const uint8x16_t sixtyFour = vdupq_n_u8(64);
+    size_t i = 0;
+    for (; i + 64 <= n; i += 64, out += 48) {
+        uint8x16x4_t str = vld4q_u8(reinterpret_cast<const uint8_t*>(in + i));
+        uint8x16x4_t v;
+        uint8x16_t bad = vdupq_n_u8(0);
+        for (int k = 0; k < 4; ++k) {
+            v.val[k] = vorrq_u8(vqtbl4q_u8(lo, str.val[k]), vqtbl4q_u8(hi, vsubq_u8(str.val[k], sixtyFour)));
+            bad = vorrq_u8(bad, vorrq_u8(v.val[k], vcgeq_u8(str.val[k], vdupq_n_u8(128))));
+        }
+        if (vmaxvq_u8(bad) >= 64) {
+            break;
+        }
+        uint8x16x3_t bytes;
+        bytes.val[0] = vorrq_u8(vshlq_n_u8(v.val[0], 2), vshrq_n_u8(v.val[1], 4));
+        bytes.val[1] = vorrq_u8(vshlq_n_u8(v.val[1], 4), vshrq_n_u8(v.val[2], 2));
+        bytes.val[2] = vorrq_u8(vshlq_n_u8(v.val[2], 6), v.val[3]);
+        vst3q_u8(out, bytes);
+    }
+    return i + decodeBlocksScalar(in + i, n - i, out);
+}
+#endif
+
+std::atomic<bool> base64PortableForced{false};
+
+struct Base64Kernels {
+    EncodeBlocksFn encode = encodeBlocksScalar;
+    DecodeBlocksFn decode = decodeBlocksScalar;
+};
+
+Base64Kernels base64Kernels() {
+    static const Base64Kernels selected = []() {
+        Base64Kernels k;
+#if AK_CRYPTO_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            k.encode = encodeBlocksAvx2;
+            k.decode = decodeBlocksAvx2;
+        } else if (__builtin_cpu_supports("ssse3")) {
+            k.encode = encodeBlocksSsse3;
+            k.decode = decodeBlocksSsse3;
+        }
+#elif AK_BASE64_NEON
+        k.encode = encodeBlocksNeon;
+        k.decode = decodeBlocksNeon;
+#endif
+        return k;
+    }();
+    return base64PortableForced ? Base64Kernels{} : selected;
+}
+
+// Slack for vector stores that run past the decoded bytes
+constexpr size_t DECODE_SLACK = 8;
+
+} // namespace
+
+std::string base64Encode(std::string_view input) {
+    std::string output(((input.size() + 2) / 3) * 4, '\0');
+    const auto* in = reinterpret_cast<const uint8_t*>(input.data());
+    size_t done = base64Kernels().encode(in, input.size(), &output[0]);
+
+    size_t rest = input.size() - done;
+    if (rest > 0) {
+        char* out = &output[done / 3 * 4];
+        uint32_t triple = static_cast<uint32_t>(in[done]) << 16;
+        if (rest == 2) {
+            triple |= static_cast<uint32_t>(in[done + 1]) << 8;
+        }
+        out[0] = B64_TABLE[(triple >> 18) & 0x3F];
+        out[1] = B64_TABLE[(triple >> 12) & 0x3F];
+        out[2] = rest == 2 ? B64_TABLE[(triple >> 6) & 0x3F] : '=';
+        out[3] = '=';
+    }
     return output;
 }
 
-// Base64 decoding
-std::string base64Decode(const std::string& input) {
-    auto val = [&](char c) -> int {
-        if ('A' <= c && c <= 'Z') return c - 'A';
-        if ('a' <= c && c <= 'z') return c - 'a' + 26;
-        if ('0' <= c && c <= '9') return c - '0' + 52;
-        if (c == '+') return 62;
-        if (c == '/') return 63;
-        return -1;
-    };
-    
-    std::string output;
-    output.reserve((input.size() / 4) * 3);
-    
-    int accum = 0, bits = 0;
-    for (char c : input) {
-        if (c == '=') break;
-        int v = val(c);
-        if (v < 0) continue;
-        
+size_t base64DecodedBound(size_t encodedLength) {
+    return encodedLength / 4 * 3 + 3 + DECODE_SLACK;
+}
+
+size_t base64DecodeInto(std::string_view input, char* output) {
+    auto* out = reinterpret_cast<uint8_t*>(output);
+    DecodeBlocksFn decodeBlocks = base64Kernels().decode;
+
+    size_t written = 0;
+    uint32_t accum = 0;
+    int bits = 0;
+    for (size_t i = 0; i < input.size();) {
+        if (bits == 0) {
+            size_t used = decodeBlocks(input.data() + i, input.size() - i, out + written);
+            i += used;
+            written += used / 4 * 3;
+            if (i == input.size()) {
+                break;
+            }
+        }
+        // Lenient path: stop at padding, skip anything outside the alphabet
+        char c = input[i++];
+        if (c == '=') {
+            break;
+        }
+        uint8_t v = B64_DECODE.value[static_cast<uint8_t>(c)];
+        if (v & 0x80) {
+            continue;
+        }
         accum = (accum << 6) | v;
         bits += 6;
         if (bits >= 8) {
             bits -= 8;
-            output.push_back(static_cast<char>((accum >> bits) & 0xFF));
+            out[written++] = static_cast<uint8_t>((accum >> bits) & 0xFF);
         }
     }
-    
+    return written;
+}
+
+std::string base64Decode(std::string_view input) {
+    std::string output(base64DecodedBound(input.size()), '\0');
+    output.resize(base64DecodeInto(input, &output[0]));
     return output;
 }
 
+bool base64DecodeStrict(std::string_view input, std::string& output) {
+    output.clear();
+    if (input.size() % 4 != 0) {
+        return false;
+    }
+    if (input.empty()) {
+        return true;
+    }
+    size_t padding = input[input.size() - 1] == '=' ? (input[input.size() - 2] == '=' ? 2 : 1) : 0;
+    size_t body = input.size() - 4; // the last group may carry padding
+
+    output.assign(base64DecodedBound(input.size()), '\0');
+    auto* out = reinterpret_cast<uint8_t*>(&output[0]);
+    size_t used = base64Kernels().decode(input.data(), body, out);
+    if (used != body) {
+        output.clear();
+        return false;
+    }
+
+    const char* last = input.data() + body;
+    uint32_t v[4];
+    for (int k = 0; k < 4; ++k) {
+        v[k] = k >= 4 - static_cast<int>(padding) ? 0 : B64_DECODE.value[static_cast<uint8_t>(last[k])];
+        if (v[k] & 0x80) {
+            output.clear();
+            return false;
+        }
+    }
+    uint32_t triple = (v[0] << 18) | (v[1] << 12) | (v[2] << 6) | v[3];
+    // Bits below the last full byte must be zero in canonical encodings
+    if ((padding == 1 && (triple & 0xFF)) || (padding == 2 && (triple & 0xFFFF))) {
+        output.clear();
+        return false;
+    }
+    size_t written = body / 4 * 3;
+    out[written++] = static_cast<uint8_t>(triple >> 16);
+    if (padding < 2) {
+        out[written++] = static_cast<uint8_t>(triple >> 8);
+    }
+    if (padding < 1) {
+        out[written++] = static_cast<uint8_t>(triple);
+    }
+    output.resize(written);
+    return true;
+}
+
+void base64ForcePortable(bool portable) {
+    base64PortableForced = portable;
+}
+
 // SHA256 implementation
+namespace {
+
+const uint32_t K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+const uint32_t INITIAL_STATE[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+using CompressFn = void (*)(uint32_t*, const uint8_t*, size_t);
+
+#if AK_CRYPTO_X86
+// Two interleaved streams hide the latency of sha256rnds2; hashMany feeds
+// pairs of equal-length messages through here
+template <int Lanes>
+__attribute__((target("sha,sse4.1,ssse3")))
+void compressShaNiLanes(uint32_t* const* states, const uint8_t* const* data, size_t count) {
+    const __m128i mask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+    __m128i abef[Lanes], cdgh[Lanes];
+    for (int l = 0; l < Lanes; ++l) {
+        // Registers hold the state as ABEF / CDGH
+        __m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(states[l])), 0xB1);
+        __m128i efgh = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(states[l] + 4)), 0x1B);
+        abef[l] = _mm_alignr_epi8(tmp, efgh, 8);
+        cdgh[l] = _mm_blend_epi16(efgh, tmp, 0xF0);
+    }
+
+    for (size_t block = 0; block < count; ++block) {
+        __m128i savedAbef[Lanes], savedCdgh[Lanes], w[Lanes][4];
+        for (int l = 0; l < Lanes; ++l) {
+            savedAbef[l] = abef[l];
+            savedCdgh[l] = cdgh[l];
+        }
+        for (int i = 0; i < 16; ++i) {
+            const __m128i k = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&K[4 * i]));
+            for (int l = 0; l < Lanes; ++l) {
+                __m128i msg;
+                if (i < 4) {
+                    msg = _mm_shuffle_epi8(
+                        _mm_loadu_si128(reinterpret_cast<const __m128i*>(data[l] + block * 64 + i * 16)), mask);
+                } else {
+                    // w[i & 3] is W(i-4); the others follow in ring order
+                    msg = _mm_sha256msg1_epu32(w[l][i & 3], w[l][(i + 1) & 3]);
+                    msg = _mm_add_epi32(msg, _mm_alignr_epi8(w[l][(i + 3) & 3], w[l][(i + 2) & 3], 4));
+                    msg = _mm_sha256msg2_epu32(msg, w[l][(i + 3) & 3]);
+                }
+                w[l][i & 3] = msg;
+                __m128i t = _mm_add_epi32(msg, k);
+                cdgh[l] = _mm_sha256rnds2_epu32(cdgh[l], abef[l], t);
+                abef[l] = _mm_sha256rnds2_epu32(abef[l], cdgh[l], _mm_shuffle_epi32(t, 0x0E));
+            }
+        }
+        for (int l = 0; l < Lanes; ++l) {
+            abef[l] = _mm_add_epi32(abef[l], savedAbef[l]);
+            cdgh[l] = _mm_add_epi32(cdgh[l], savedCdgh[l]);
+        }
+    }
+
+    for (int l = 0; l < Lanes; ++l) {
+        __m128i feba = _mm_shuffle_epi32(abef[l], 0x1B);
+        __m128i dchg = _mm_shuffle_epi32(cdgh[l], 0xB1);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(states[l]), _mm_blend_epi16(feba, dchg, 0xF0));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(states[l] + 4), _mm_alignr_epi8(dchg, feba, 8));
+    }
+}
+
+void compressShaNi(uint32_t* state, const uint8_t* blocks, size_t count) {
+    compressShaNiLanes<1>(&state, &blocks, count);
+}
+
+bool cpuHasShaNi() {
+    unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+        return false;
+    }
+    bool sse41 = (ecx & (1u << 19)) != 0;
+    bool ssse3 = (ecx & (1u << 9)) != 0;
+    if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+        return false;
+    }
+    return sse41 && ssse3 && (ebx & (1u << 29)) != 0;
+}
+#endif
+
+#if AK_SHA256_ARM
+void compressArmv8(uint32_t* state, const uint8_t* blocks, size_t count) {
+    uint32x4_t abcd = vld1q_u32(state);
+    uint32x4_t efgh = vld1q_u32(state + 4);
+    for (size_t block = 0; block < count; ++block) {
+        uint32x4_t savedAbcd = abcd, savedEfgh = efgh, w[4];
+        for (int i = 0; i < 16; ++i) {
+            uint32x4_t msg;
+            if (i < 4) {
+                msg = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(blocks + block * 64 + i * 16)));
+            } else {
+                msg = vsha256su1q_u32(vsha256su0q_u32(w[i & 3], w[(i + 1) & 3]), w[(i + 2) & 3], w[(i + 3) & 3]);
+            }
+            w[i & 3] = msg;
+            uint32x4_t t = vaddq_u32(msg, vld1q_u32(&K[4 * i]));
+            uint32x4_t previous = abcd;
+            abcd = vsha256hq_u32(abcd, efgh, t);
+            efgh = vsha256h2q_u32(efgh, previous, t);
+        }
+        abcd = vaddq_u32(abcd, savedAbcd);
+        efgh = vaddq_u32(efgh, savedEfgh);
+    }
+    vst1q_u32(state, abcd);
+    vst1q_u32(state + 4, efgh);
+}
+
+bool cpuHasArmSha2() {
+#if defined(__APPLE__)
+    return true;
+#else
+    return (getauxval(AT_HWCAP) & HWCAP_SHA2) != 0;
+#endif
+}
+#endif
+
+std::atomic<bool> portableForced{false};
+
+CompressFn hardwareCompress() {
+    static const CompressFn selected = []() -> CompressFn {
+#if AK_CRYPTO_X86
+        if (cpuHasShaNi()) {
+            return compressShaNi;
+        }
+#endif
+#if AK_SHA256_ARM
+        if (cpuHasArmSha2()) {
+            return compressArmv8;
+        }
+#endif
+        return nullptr;
+    }();
+    return selected;
+}
+
+// Appends the padding and length of a `length`-byte message whose tail
+// (length % 64 bytes) is `tail`; returns one or two blocks
+size_t padTail(const uint8_t* tail, size_t tailLength, unsigned long long totalBits, uint8_t out[128]) {
+    std::memset(out, 0, 128);
+    std::memcpy(out, tail, tailLength);
+    out[tailLength] = 0x80;
+    size_t blocks = tailLength < 56 ? 1 : 2;
+    for (int j = 0; j < 8; ++j) {
+        out[blocks * 64 - 1 - j] = static_cast<uint8_t>(totalBits >> (8 * j));
+    }
+    return blocks;
+}
+
+void storeDigest(const uint32_t state[8], SHA256::Digest& digest) {
+    for (int j = 0; j < 8; ++j) {
+        digest[j * 4] = static_cast<uint8_t>(state[j] >> 24);
+        digest[j * 4 + 1] = static_cast<uint8_t>(state[j] >> 16);
+        digest[j * 4 + 2] = static_cast<uint8_t>(state[j] >> 8);
+        digest[j * 4 + 3] = static_cast<uint8_t>(state[j]);
+    }
+}
+
+} // namespace
+
 SHA256::SHA256() {
     reset();
 }
@@ -77,47 +606,153 @@ void SHA256::update(const std::string& str) {
 }
 
 void SHA256::update(const uint8_t* data_ptr, size_t length) {
-    for (size_t i = 0; i < length; ++i) {
-        data[datalen] = data_ptr[i];
-        datalen++;
-        if (datalen == 64) {
-            transform();
-            bitlen += 512;
-            datalen = 0;
+    if (datalen > 0) {
+        size_t take = std::min<size_t>(64 - datalen, length);
+        std::memcpy(data + datalen, data_ptr, take);
+        datalen += static_cast<uint32_t>(take);
+        data_ptr += take;
+        length -= take;
+        if (datalen < 64) {
+            return;
         }
+        compress(state, data, 1);
+        bitlen += 512;
+        datalen = 0;
     }
+
+    // Whole blocks straight from the caller's buffer
+    size_t blocks = length / 64;
+    if (blocks > 0) {
+        compress(state, data_ptr, blocks);
+        bitlen += 512ULL * blocks;
+        data_ptr += blocks * 64;
+        length -= blocks * 64;
+    }
+
+    std::memcpy(data, data_ptr, length);
+    datalen = static_cast<uint32_t>(length);
+}
+
+SHA256::Digest SHA256::finalRaw() {
+    uint8_t padded[128];
+    size_t blocks = padTail(data, datalen, bitlen + datalen * 8ULL, padded);
+    compress(state, padded, blocks);
+
+    Digest digest;
+    storeDigest(state, digest);
+    reset();
+    return digest;
 }
 
 std::string SHA256::final() {
-    uint32_t i = datalen;
-    if (datalen < 56) {
-        data[i++] = 0x80;
-        while (i < 56) {
-            data[i++] = 0x00;
+    return toHex(finalRaw());
+}
+
+std::string SHA256::toHex(const Digest& digest) {
+    static const char hex[] = "0123456789abcdef";
+    std::string out(64, '0');
+    for (size_t i = 0; i < digest.size(); ++i) {
+        out[i * 2] = hex[digest[i] >> 4];
+        out[i * 2 + 1] = hex[digest[i] & 0x0F];
+    }
+    return out;
+}
+
+std::vector<SHA256::Digest> SHA256::hashMany(const std::vector<std::string>& inputs) {
+    std::vector<Digest> digests(inputs.size());
+    // Small batches keep the padded copies in cache
+    constexpr size_t BATCH = 32;
+    std::vector<uint8_t> buffer;
+    uint32_t states[BATCH][8];
+    size_t offsets[BATCH + 1];
+    size_t order[BATCH];
+    bool lanes = false;
+#if AK_CRYPTO_X86
+    lanes = !portableForced && hardwareCompress() == compressShaNi;
+#endif
+
+    for (size_t base = 0; base < inputs.size(); base += BATCH) {
+        size_t n = std::min(BATCH, inputs.size() - base);
+        // Every message fully padded, so lanes never branch on length
+        offsets[0] = 0;
+        for (size_t i = 0; i < n; ++i) {
+            offsets[i + 1] = offsets[i] + (inputs[base + i].size() + 9 + 63) / 64 * 64;
+            order[i] = i;
         }
-    } else {
-        data[i++] = 0x80;
-        while (i < 64) {
-            data[i++] = 0x00;
+        buffer.resize(offsets[n]);
+        for (size_t i = 0; i < n; ++i) {
+            const std::string& input = inputs[base + i];
+            const auto* bytes = reinterpret_cast<const uint8_t*>(input.data());
+            size_t whole = input.size() / 64 * 64;
+            std::memcpy(buffer.data() + offsets[i], bytes, whole);
+            uint8_t tail[128];
+            size_t tailBlocks = padTail(bytes + whole, input.size() - whole, input.size() * 8ULL, tail);
+            std::memcpy(buffer.data() + offsets[i] + whole, tail, tailBlocks * 64);
+            std::memcpy(states[i], INITIAL_STATE, sizeof(INITIAL_STATE));
+        }
+        auto blockCount = [&](size_t i) { return (offsets[i + 1] - offsets[i]) / 64; };
+
+        if (lanes) {
+#if AK_CRYPTO_X86
+            // Pair up messages of equal block count
+            std::sort(order, order + n, [&](size_t x, size_t y) { return blockCount(x) < blockCount(y); });
+            for (size_t k = 0; k < n;) {
+                size_t x = order[k];
+                if (k + 1 < n && blockCount(order[k + 1]) == blockCount(x)) {
+                    size_t y = order[k + 1];
+                    uint32_t* pair[2] = {states[x], states[y]};
+                    const uint8_t* blocks[2] = {buffer.data() + offsets[x], buffer.data() + offsets[y]};
+                    compressShaNiLanes<2>(pair, blocks, blockCount(x));
+                    k += 2;
+                } else {
+                    compressShaNi(states[x], buffer.data() + offsets[x], blockCount(x));
+                    ++k;
+                }
+            }
+#endif
+        } else {
+            for (size_t i = 0; i < n; ++i) {
+                compress(states[i], buffer.data() + offsets[i], blockCount(i));
+            }
+        }
+
+        for (size_t i = 0; i < n; ++i) {
+            storeDigest(states[i], digests[base + i]);
         }
-        transform();
-        std::memset(data, 0, 56);
     }
-    
-    bitlen += datalen * 8ULL;
-    for (int j = 0; j < 8; ++j) {
-        data[63 - j] = (bitlen >> (8 * j)) & 0xFF;
+    return digests;
+}
+
+const char* SHA256::backend() {
+    if (portableForced) {
+        return "portable";
     }
-    transform();
-    
-    std::ostringstream oss;
-    oss << std::hex << std::setfill('0');
-    for (int j = 0; j < 8; ++j) {
-        oss << std::setw(8) << state[j];
+    CompressFn fn = hardwareCompress();
+#if AK_CRYPTO_X86
+    if (fn == compressShaNi) {
+        return "sha-ni";
+    }
+#endif
+#if AK_SHA256_ARM
+    if (fn == compressArmv8) {
+        return "armv8";
+    }
+#endif
+    (void)fn;
+    return "portable";
+}
+
+void SHA256::forcePortable(bool portable) {
+    portableForced = portable;
+}
+
+void SHA256::compress(uint32_t st[8], const uint8_t* blocks, size_t count) {
+    CompressFn fn = portableForced ? nullptr : hardwareCompress();
+    if (fn) {
+        fn(st, blocks, count);
+    } else {
+        compressPortable(st, blocks, count);
     }
-    
-    reset();
-    return oss.str();
 }
 
 uint32_t SHA256::ror(uint32_t x, int n) {
@@ -140,64 +775,48 @@ uint32_t SHA256::s1(uint32_t x) {
     return ror(x, 17) ^ ror(x, 19) ^ (x >> 10);
 }
 
-void SHA256::transform() {
-    static const uint32_t K[64] = {
-        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
-        0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
-        0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
-        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
-        0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
-        0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
-        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
-        0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
-    };
-    
-    uint32_t m[64];
-    for (int i = 0, j = 0; i < 16; ++i, j += 4) {
-        m[i] = (data[j] << 24) | (data[j + 1] << 16) | (data[j + 2] << 8) | data[j + 3];
-    }
-    
-    for (int i = 16; i < 64; ++i) {
-        m[i] = s1(m[i - 2]) + m[i - 7] + s0(m[i - 15]) + m[i - 16];
-    }
-    
-    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
-    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
-    
-    for (int i = 0; i < 64; ++i) {
-        uint32_t t1 = h + (ror(e, 6) ^ ror(e, 11) ^ ror(e, 25)) + ch(e, f, g) + K[i] + m[i];
-        uint32_t t2 = (ror(a, 2) ^ ror(a, 13) ^ ror(a, 22)) + maj(a, b, c);
-        h = g;
-        g = f;
-        f = e;
-        e = d + t1;
-        d = c;
-        c = b;
-        b = a;
-        a = t1 + t2;
-    }
-    
-    state[0] += a;
-    state[1] += b;
-    state[2] += c;
-    state[3] += d;
-    state[4] += e;
-    state[5] += f;
-    state[6] += g;
-    state[7] += h;
+void SHA256::compressPortable(uint32_t st[8], const uint8_t* blocks, size_t count) {
+    for (size_t block = 0; block < count; ++block, blocks += 64) {
+        uint32_t m[64];
+        for (int i = 0, j = 0; i < 16; ++i, j += 4) {
+            m[i] = (static_cast<uint32_t>(blocks[j]) << 24) | (blocks[j + 1] << 16) | (blocks[j + 2] << 8) | blocks[j + 3];
+        }
+        
+        for (int i = 16; i < 64; ++i) {
+            m[i] = s1(m[i - 2]) + m[i - 7] + s0(m[i - 15]) + m[i - 16];
+        }
+        
+        uint32_t a = st[0], b = st[1], c = st[2], d = st[3];
+        uint32_t e = st[4], f = st[5], g = st[6], h = st[7];
+        
+        for (int i = 0; i < 64; ++i) {
+            uint32_t t1 = h + (ror(e, 6) ^ ror(e, 11) ^ ror(e, 25)) + ch(e, f, g) + K[i] + m[i];
+            uint32_t t2 = (ror(a, 2) ^ ror(a, 13) ^ ror(a, 22)) + maj(a, b, c);
+            h = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+        
+        st[0] += a;
+        st[1] += b;
+        st[2] += c;
+        st[3] += d;
+        st[4] += e;
+        st[5] += f;
+        st[6] += g;
+        st[7] += h;
+    }
 }
 
 void SHA256::reset() {
     datalen = 0;
     bitlen = 0;
-    state[0] = 0x6a09e667;
-    state[1] = 0xbb67ae85;
-    state[2] = 0x3c6ef372;
-    state[3] = 0xa54ff53a;
-    state[4] = 0x510e527f;
-    state[5] = 0x9b05688c;
-    state[6] = 0x1f83d9ab;
-    state[7] = 0x5be0cd19;
+    std::memcpy(state, INITIAL_STATE, sizeof(state));
 }
 
 // Utility function for hashing key names
@@ -207,5 +826,43 @@ std::string hashKeyName(const std::string& name) {
     return hash.final().substr(0, 16);
 }
 
+std::string hmacSha256(const std::string& key, const std::string& message) {
+    uint8_t block[64] = {};
+    if (key.size() > sizeof(block)) {
+        SHA256 hash;
+        hash.update(key);
+        SHA256::Digest digest = hash.finalRaw();
+        std::copy(digest.begin(), digest.end(), block);
+    } else {
+        std::copy(key.begin(), key.end(), block);
+    }
+
+    uint8_t pad[64];
+    SHA256 inner;
+    for (size_t i = 0; i < sizeof(pad); ++i) {
+        pad[i] = block[i] ^ 0x36;
+    }
+    inner.update(pad, sizeof(pad));
+    inner.update(message);
+    SHA256::Digest innerDigest = inner.finalRaw();
+
+    SHA256 outer;
+    for (size_t i = 0; i < sizeof(pad); ++i) {
+        pad[i] = block[i] ^ 0x5c;
+    }
+    outer.update(pad, sizeof(pad));
+    outer.update(innerDigest.data(), innerDigest.size());
+    secureZero(block, sizeof(block));
+    secureZero(pad, sizeof(pad));
+    return outer.final();
+}
+
+void secureZero(void* data, size_t length) {
+    volatile unsigned char* p = static_cast<volatile unsigned char*>(data);
+    while (length--) {
+        *p++ = 0;
+    }
+}
+
 } // namespace crypto
-} // namespace ak
\ No newline at end of file
+} // namespace ak
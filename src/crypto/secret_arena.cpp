@@ -0,0 +1,159 @@
+#include "crypto/secret_arena.hpp"
+#include "crypto/crypto.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <unistd.h>
+#define AK_ARENA_MMAP 1
+#elif defined(_WIN32)
+#include <windows.h>
+#endif
+
+namespace ak {
+namespace crypto {
+
+namespace {
+
+std::size_t pageSize() {
+#if defined(AK_ARENA_MMAP)
+    static const std::size_t size = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+    return size;
+#else
+    return 4096;
+#endif
+}
+
+// Page-rounded, locked when the OS lets us; nullptr when out of memory
+char* mapChunk(std::size_t size, bool& locked) {
+    locked = false;
+#if defined(AK_ARENA_MMAP)
+    void* p = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+    if (p == MAP_FAILED) {
+        return nullptr;
+    }
+    locked = ::mlock(p, size) == 0;
+#ifdef MADV_DONTDUMP
+    ::madvise(p, size, MADV_DONTDUMP);
+#endif
+    return static_cast<char*>(p);
+#elif defined(_WIN32)
+    void* p = ::VirtualAlloc(nullptr, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+    if (!p) {
+        return nullptr;
+    }
+    locked = ::VirtualLock(p, size) != 0;
+    return static_cast<char*>(p);
+#else
+    return new (std::nothrow) char[size];
+#endif
+}
+
+void unmapChunk(char* data, std::size_t size, bool locked) {
+#if defined(AK_ARENA_MMAP)
+    if (locked) {
+        ::munlock(data, size);
+    }
+    ::munmap(data, size);
+#elif defined(_WIN32)
+    if (locked) {
+        ::VirtualUnlock(data, size);
+    }
+    ::VirtualFree(data, 0, MEM_RELEASE);
+#else
+    (void)size;
+    (void)locked;
+    delete[] data;
+#endif
+}
+
+std::size_t roundToPages(std::size_t size) {
+    std::size_t page = pageSize();
+    return std::max<std::size_t>(1, (size + page - 1) / page) * page;
+}
+
+} // namespace
+
+SecretArena::SecretArena(std::size_t reserve) {
+    if (reserve) {
+        chunkFor(reserve);
+    }
+}
+
+SecretArena::~SecretArena() {
+    for (auto& chunk : chunks_) {
+        secureZero(chunk.data, chunk.used);
+        unmapChunk(chunk.data, chunk.size, chunk.locked);
+    }
+}
+
+SecretArena::Chunk& SecretArena::chunkFor(std::size_t size) {
+    if (!chunks_.empty() && chunks_.back().size - chunks_.back().used >= size) {
+        return chunks_.back();
+    }
+    // Doubling keeps an operation that outgrows its guess to a few chunks
+    std::size_t want = roundToPages(std::max(size, chunks_.empty() ? 0 : chunks_.back().size * 2));
+    chunks_.reserve(chunks_.size() + 1);
+    Chunk chunk;
+    chunk.size = want;
+    chunk.data = mapChunk(want, chunk.locked);
+    if (!chunk.data) {
+        throw std::bad_alloc();
+    }
+    chunks_.push_back(chunk);
+    return chunks_.back();
+}
+
+char* SecretArena::allocate(std::size_t size) {
+    Chunk& chunk = chunkFor(size);
+    char* out = chunk.data + chunk.used;
+    chunk.used += size;
+    return out;
+}
+
+SecretView SecretArena::store(std::string_view data) {
+    char* out = allocate(data.size());
+    if (!data.empty()) {
+        std::memcpy(out, data.data(), data.size());
+    }
+    return SecretView(out, data.size());
+}
+
+void SecretArena::reset() {
+    for (std::size_t i = 0; i < chunks_.size(); ++i) {
+        secureZero(chunks_[i].data, chunks_[i].used);
+        chunks_[i].used = 0;
+        if (i > 0) {
+            unmapChunk(chunks_[i].data, chunks_[i].size, chunks_[i].locked);
+        }
+    }
+    if (chunks_.size() > 1) {
+        chunks_.resize(1);
+    }
+}
+
+std::size_t SecretArena::used() const {
+    std::size_t total = 0;
+    for (const auto& chunk : chunks_) {
+        total += chunk.used;
+    }
+    return total;
+}
+
+std::size_t SecretArena::capacity() const {
+    std::size_t total = 0;
+    for (const auto& chunk : chunks_) {
+        total += chunk.size;
+    }
+    return total;
+}
+
+bool SecretArena::locked() const {
+    return std::all_of(chunks_.begin(), chunks_.end(), [](const Chunk& chunk) { return chunk.locked; });
+}
+
+} // namespace crypto
+} // namespace ak
@@ -1,6 +1,7 @@
 #ifdef BUILD_GUI
 
 #include "gui/mainwindow.hpp"
+#include "storage/vault.hpp"
 #include <QApplication>
 #include <QMessageBox>
 #include <QLabel>
@@ -14,7 +15,7 @@ namespace ak {
 namespace gui {
 
 MainWindow::MainWindow(const core::Config& cfg, QWidget *parent)
-    : QMainWindow(parent), config(cfg), tabWidget(nullptr),
+    : QMainWindow(parent), config(cfg), tabWidget(nullptr), changeFeed(nullptr),
       keyManagerWidget(nullptr),
       serviceManagerWidget(nullptr), settingsTab(nullptr), exitAction(nullptr), aboutAction(nullptr),
       helpAction(nullptr)
@@ -83,13 +84,27 @@ void MainWindow::setupMenuBar()
     helpMenu->addAction(aboutAction);
 }
 
+namespace {
+
+QString backendDisplayName(const ak::core::Config &config)
+{
+    switch (ak::storage::activeBackend(config)) {
+        case ak::storage::Backend::Gpg: return "GPG Encryption";
+        case ak::storage::Backend::Aead: return "AEAD Encryption";
+        case ak::storage::Backend::Plain: break;
+    }
+    return "Plain Text";
+}
+
+} // namespace
+
 void MainWindow::setupStatusBar()
 {
     // Create status bar with basic info
     statusBar()->showMessage("Ready", 2000);
     
     // Add permanent widgets to status bar
-    QLabel *backendLabel = new QLabel(config.gpgAvailable ? "Backend: GPG" : "Backend: Plain");
+    QLabel *backendLabel = new QLabel("Backend: " + QString(ak::storage::backendName(ak::storage::activeBackend(config))).toUpper());
     statusBar()->addPermanentWidget(backendLabel);
     
     QLabel *versionLabel = new QLabel("v" AK_VERSION_STRING);
@@ -98,16 +113,21 @@ void MainWindow::setupStatusBar()
 
 void MainWindow::setupTabs()
 {
+    // Changes on disk, from our own saves or from the CLI
+    changeFeed = new widgets::StorageChangeFeed(config, this);
+
     // Key Manager Tab (now includes profile management)
     keyManagerWidget = new widgets::KeyManagerWidget(config, this);
     connect(keyManagerWidget, &widgets::KeyManagerWidget::statusMessage,
             this, &MainWindow::onStatusMessage);
+    keyManagerWidget->watchStorage(changeFeed);
     tabWidget->addTab(keyManagerWidget, "Key Manager");
 
     // Service Manager Tab
     serviceManagerWidget = new widgets::ServiceManagerWidget(config, this);
     connect(serviceManagerWidget, &widgets::ServiceManagerWidget::statusMessage,
             this, &MainWindow::onStatusMessage);
+    serviceManagerWidget->watchStorage(changeFeed);
     tabWidget->addTab(serviceManagerWidget, "Service Manager");
 
     // Settings Tab - Full Implementation
@@ -121,10 +141,14 @@ void MainWindow::setupTabs()
     QVBoxLayout *backendLayout = new QVBoxLayout(backendGroup);
     
     QLabel *backendStatus = new QLabel(QString("Current Backend: <b>%1</b>")
-        .arg(config.gpgAvailable && !config.forcePlain ? "GPG Encryption" : "Plain Text"));
+        .arg(backendDisplayName(config)));
     backendLayout->addWidget(backendStatus);
     
-    if (config.gpgAvailable) {
+    if (ak::storage::activeBackend(config) == ak::storage::Backend::Aead) {
+        QLabel *aeadInfo = new QLabel("✅ In-process AES-256-GCM encryption is active");
+        aeadInfo->setStyleSheet("color: #00aa00;");
+        backendLayout->addWidget(aeadInfo);
+    } else if (config.gpgAvailable) {
         QLabel *gpgInfo = new QLabel("✅ GPG encryption is available and active");
         gpgInfo->setStyleSheet("color: #00aa00;");
         backendLayout->addWidget(gpgInfo);
@@ -206,7 +230,7 @@ void MainWindow::showAbout()
     QMessageBox::about(this, "About AK",
         "AK - API Key Manager v" AK_VERSION_STRING "\n\n"
         "A secure tool for managing API keys and environment variables.\n\n"
-        "Backend: " + QString(config.gpgAvailable ? "GPG Encryption" : "Plain Text") + "\n"
+        "Backend: " + backendDisplayName(config) + "\n"
         "Config Directory: " + QString::fromStdString(config.configDir));
 }
 
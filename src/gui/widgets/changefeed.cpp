@@ -0,0 +1,141 @@
+#ifdef BUILD_GUI
+
+#include "gui/widgets/changefeed.hpp"
+#include <QDir>
+#include <QFileInfo>
+#include <QStringList>
+
+namespace ak {
+namespace gui {
+namespace widgets {
+
+StorageChangeFeed::StorageChangeFeed(const core::Config& config, QObject *parent)
+    : QObject(parent), config(config), watcher(new QFileSystemWatcher(this)), debounce(new QTimer(this)),
+      profilesDir(QString::fromStdString(config.profilesDir)),
+      servicesPath(QString::fromStdString(config.configDir + "/user_services.txt")),
+      vaultPath(QString::fromStdString(config.vaultPath.get()))
+{
+    debounce->setSingleShot(true);
+    debounce->setInterval(DebounceMs);
+    connect(debounce, &QTimer::timeout, this, &StorageChangeFeed::flush);
+    connect(watcher, &QFileSystemWatcher::directoryChanged, this, &StorageChangeFeed::onPathChanged);
+    connect(watcher, &QFileSystemWatcher::fileChanged, this, &StorageChangeFeed::onPathChanged);
+
+    profileFiles = scanProfiles();
+    servicesStamp = stampOf(servicesPath);
+    vaultStamp = stampOf(vaultPath);
+    rewatch();
+}
+
+StorageChangeFeed::Stamp StorageChangeFeed::stampOf(const QString &path)
+{
+    QFileInfo info(path);
+    Stamp stamp;
+    if (info.exists()) {
+        stamp.modified = info.lastModified().toMSecsSinceEpoch();
+        stamp.size = info.size();
+    }
+    return stamp;
+}
+
+QMap<QString, StorageChangeFeed::Stamp> StorageChangeFeed::scanProfiles() const
+{
+    QMap<QString, Stamp> files;
+    // Hidden entries are the temporary files of atomic writes
+    const QFileInfoList entries = QDir(profilesDir).entryInfoList(QDir::Files | QDir::NoDotAndDotDot);
+    for (const QFileInfo &info : entries) {
+        files.insert(info.fileName(), Stamp{info.lastModified().toMSecsSinceEpoch(), info.size()});
+    }
+    return files;
+}
+
+void StorageChangeFeed::rewatch()
+{
+    QStringList wanted;
+    wanted << profilesDir << QString::fromStdString(config.configDir);
+    for (auto it = profileFiles.constBegin(); it != profileFiles.constEnd(); ++it) {
+        wanted << profilesDir + "/" + it.key();
+    }
+    if (servicesStamp.size >= 0) {
+        wanted << servicesPath;
+    }
+    if (vaultStamp.size >= 0) {
+        wanted << vaultPath;
+    }
+
+    QStringList watched = watcher->files() + watcher->directories();
+    QStringList missing;
+    for (const QString &path : wanted) {
+        if (!watched.contains(path) && QFileInfo::exists(path)) {
+            missing << path;
+        }
+    }
+    if (!missing.isEmpty()) {
+        watcher->addPaths(missing);
+    }
+}
+
+void StorageChangeFeed::onPathChanged(const QString &path)
+{
+    Q_UNUSED(path)
+    // Restarting the timer folds a burst into one scan
+    debounce->start();
+}
+
+void StorageChangeFeed::flush()
+{
+    QMap<QString, Stamp> current = scanProfiles();
+    QSet<QString> changedProfiles;
+    bool listChanged = false;
+
+    auto note = [&](const QString &fileName) {
+        if (fileName.endsWith(".profile")) {
+            listChanged = true;
+            return;
+        }
+        int keys = fileName.indexOf(".keys");
+        if (keys > 0) {
+            changedProfiles.insert(fileName.left(keys));
+        }
+    };
+    for (auto it = current.constBegin(); it != current.constEnd(); ++it) {
+        auto before = profileFiles.constFind(it.key());
+        if (before == profileFiles.constEnd() || before.value() != it.value()) {
+            note(it.key());
+        }
+    }
+    for (auto it = profileFiles.constBegin(); it != profileFiles.constEnd(); ++it) {
+        if (!current.contains(it.key())) {
+            note(it.key());
+        }
+    }
+    profileFiles = current;
+
+    Stamp services = stampOf(servicesPath);
+    bool servicesDiffer = services != servicesStamp;
+    servicesStamp = services;
+    Stamp vault = stampOf(vaultPath);
+    bool vaultDiffers = vault != vaultStamp;
+    vaultStamp = vault;
+
+    rewatch();
+
+    if (listChanged) {
+        emit profilesChanged();
+    }
+    for (const QString &profile : changedProfiles) {
+        emit profileKeysChanged(profile);
+    }
+    if (servicesDiffer) {
+        emit servicesChanged();
+    }
+    if (vaultDiffers) {
+        emit vaultChanged();
+    }
+}
+
+} // namespace widgets
+} // namespace gui
+} // namespace ak
+
+#endif // BUILD_GUI
@@ -1,11 +1,15 @@
 #ifdef BUILD_GUI
 
 #include "gui/widgets/keymanager.hpp"
+#include "gui/widgets/changefeed.hpp"
 #include "gui/widgets/common/dialogs.hpp"
 #include "gui/widgets/common/secureinput.hpp"
 #include "gui/widgets/servicehelpers.hpp"
 #include "storage/vault.hpp"
+#include "storage/importer.hpp"
+#include "storage/search_index.hpp"
 #include "services/services.hpp"
+#include "services/test_cache.hpp"
 #include "core/config.hpp"
 #include <QApplication>
 #include <QClipboard>
@@ -15,6 +19,7 @@
 #include <QTimer>
 #include <QRegularExpression>
 #include <QMap>
+#include <QSet>
 #include <QPushButton>
 #include <QUrl>
 #include <QThread>
@@ -29,108 +34,85 @@ namespace ak {
 namespace gui {
 namespace widgets {
 
-// ProfileKeysLoaderWorker Implementation
-ProfileKeysLoaderWorker::ProfileKeysLoaderWorker(const core::Config& cfg, const QString& profileName, const QString& passphrase, QObject *parent)
-    : QObject(parent), config(cfg), profileName(profileName), passphrase(passphrase.toStdString())
+// ProfileKeysWorker Implementation
+ProfileKeysWorker::ProfileKeysWorker(const core::Config& cfg, QObject *parent)
+    : QObject(parent), config(cfg)
 {
 }
 
-void ProfileKeysLoaderWorker::loadKeys()
+void ProfileKeysWorker::loadKeys(const QString& profileName, const QString& passphrase, bool quiet)
 {
     try {
         core::Config cfg = config;
-        if (!passphrase.empty()) {
-            cfg.presetPassphrase = passphrase;
+        if (!passphrase.isEmpty()) {
+            cfg.presetPassphrase = passphrase.toStdString();
         }
-        std::map<std::string, std::string> keys = ak::storage::loadProfileKeys(cfg, profileName.toStdString());
-        emit keysLoaded(profileName, keys);
+        // Shared with the service tester, so switching tabs doesn't re-decrypt;
+        // the cache is keyed on the file stamp, so our own saves never miss
+        auto keys = ak::storage::loadProfileKeysCached(cfg, profileName.toStdString());
+        emit keysLoaded(profileName, *keys, quiet);
     } catch (const std::exception& e) {
-        emit loadFailed(profileName, QString::fromStdString(e.what()));
+        emit loadFailed(profileName, QString::fromStdString(e.what()), quiet);
     }
 }
 
-// ProfileKeysSaverWorker Implementation
-ProfileKeysSaverWorker::ProfileKeysSaverWorker(const core::Config& cfg,
-                                               const QString& profileName,
-                                               const std::map<std::string, std::string>& keys,
-                                               const QString& passphrase,
-                                               QObject *parent)
-    : QObject(parent), config(cfg), profileName(profileName), keysToSave(keys), passphrase(passphrase.toStdString())
-{
-}
-
-void ProfileKeysSaverWorker::saveKeys()
+void ProfileKeysWorker::saveKeys(const QString& profileName,
+                                 const std::map<std::string, std::string>& keys,
+                                 const QString& passphrase)
 {
     try {
         core::Config cfg = config;
-        if (!passphrase.empty()) {
-            cfg.presetPassphrase = passphrase;
+        if (!passphrase.isEmpty()) {
+            cfg.presetPassphrase = passphrase.toStdString();
         }
-        ak::storage::saveProfileKeys(cfg, profileName.toStdString(), keysToSave);
-        emit saveCompleted(profileName);
+        ak::storage::saveProfileKeys(cfg, profileName.toStdString(), keys);
     } catch (const std::exception& e) {
         emit saveFailed(profileName, QString::fromStdString(e.what()));
+        return;
     }
-}
-
-// MaskedTableItem Implementation
-MaskedTableItem::MaskedTableItem(const QString &actualValue)
-    : QTableWidgetItem(), actualValue(actualValue), masked(true)
-{
-    updateDisplayValue();
-}
-
-void MaskedTableItem::setMasked(bool masked)
-{
-    this->masked = masked;
-    updateDisplayValue();
-}
 
-bool MaskedTableItem::isMasked() const
-{
-    return masked;
-}
-
-QString MaskedTableItem::getActualValue() const
-{
-    return actualValue;
-}
-
-void MaskedTableItem::updateDisplayValue()
-{
-    if (masked) {
-        QString maskedValue;
-        if (actualValue.length() > 8) {
-            maskedValue = actualValue.left(4) + QString("*").repeated(actualValue.length() - 8) + actualValue.right(4);
-        } else {
-            maskedValue = QString("*").repeated(actualValue.length());
+    // The .profile list follows the keys that were actually saved
+    try {
+        std::vector<std::string> keyNames;
+        keyNames.reserve(keys.size());
+        for (const auto& [key, value] : keys) {
+            keyNames.push_back(key);
         }
-        setText(maskedValue);
-        setToolTip("Click the eye button to reveal value");
-    } else {
-        setText(actualValue);
-        setToolTip("");
+        ak::storage::writeProfile(config, profileName.toStdString(), keyNames);
+        emit saveCompleted(profileName, QString());
+    } catch (const std::exception& e) {
+        emit saveCompleted(profileName, QString("Keys saved but failed to update profile index: %1").arg(e.what()));
     }
 }
 
 // KeyManagerWidget Implementation
 KeyManagerWidget::KeyManagerWidget(const core::Config& config, QWidget *parent)
     : QWidget(parent), config(config), currentProfile("default"),
-      profileKeys(), cachedProfileKeys(), keysModified(false),
-      loadingInProgress(false), savingInProgress(false),
+      shownProfile(), profileKeys(), cachedProfileKeys(), keysModified(false),
+      pendingLoads(0), pendingSaves(0),
       sessionPassphrase(), rememberedPassphrase(), rememberPassphrase(false),
       mainLayout(nullptr), toolbarLayout(nullptr),
       profileCombo(nullptr), profileActionsButton(nullptr), profileActionsMenu(nullptr),
       searchEdit(nullptr), addButton(nullptr), editButton(nullptr), deleteButton(nullptr),
       toggleVisibilityButton(nullptr), refreshButton(nullptr), statusLabel(nullptr),
-      table(nullptr), contextMenu(nullptr), addAction(nullptr), editAction(nullptr),
+      table(nullptr), keyModel(nullptr), proxyModel(nullptr), contextMenu(nullptr), addAction(nullptr), editAction(nullptr),
       deleteAction(nullptr), copyNameAction(nullptr), copyValueAction(nullptr),
       toggleVisibilityAction(nullptr), globalVisibilityState(true), currentFilter(),
-      loadKeysThread(nullptr), loadKeysWorker(nullptr),
-      saveKeysThread(nullptr), saveKeysWorker(nullptr)
+      keysThread(nullptr), keysWorker(nullptr)
 {
     qRegisterMetaType<std::map<std::string, std::string>>("std::map<std::string, std::string>");
 
+    // One worker thread for the widget's lifetime; loads and saves queue on it
+    keysThread = new QThread(this);
+    keysWorker = new ProfileKeysWorker(config);
+    keysWorker->moveToThread(keysThread);
+    connect(keysThread, &QThread::finished, keysWorker, &QObject::deleteLater);
+    connect(keysWorker, &ProfileKeysWorker::keysLoaded, this, &KeyManagerWidget::onKeysLoaded);
+    connect(keysWorker, &ProfileKeysWorker::loadFailed, this, &KeyManagerWidget::onKeysLoadFailed);
+    connect(keysWorker, &ProfileKeysWorker::saveCompleted, this, &KeyManagerWidget::onKeysSaved);
+    connect(keysWorker, &ProfileKeysWorker::saveFailed, this, &KeyManagerWidget::onKeysSaveFailed);
+    keysThread->start();
+
     // Ensure default profile exists
     ak::storage::ensureDefaultProfile(config);
     
@@ -143,59 +125,24 @@ KeyManagerWidget::KeyManagerWidget(const core::Config& config, QWidget *parent)
 
 KeyManagerWidget::~KeyManagerWidget()
 {
-    cleanupLoadThread(true);
-    cleanupSaveThread(true);
+    // Lets a queued save finish; the worker is deleted as the thread ends
+    keysThread->quit();
+    keysThread->wait();
     clearPassphrase();
-    loadingInProgress = false;
-    savingInProgress = false;
-}
-
-void KeyManagerWidget::cleanupLoadThread(bool waitForFinish)
-{
-    if (!loadKeysThread) {
-        return;
-    }
-
-    if (loadKeysThread->isRunning()) {
-        loadKeysThread->quit();
-        if (waitForFinish) {
-            loadKeysThread->wait();
-        } else {
-            return;
-        }
-    }
-
-    if (loadKeysWorker) {
-        delete loadKeysWorker;
-        loadKeysWorker = nullptr;
-    }
-
-    delete loadKeysThread;
-    loadKeysThread = nullptr;
 }
 
-void KeyManagerWidget::cleanupSaveThread(bool waitForFinish)
+void KeyManagerWidget::watchStorage(StorageChangeFeed *feed)
 {
-    if (!saveKeysThread) {
-        return;
-    }
+    connect(feed, &StorageChangeFeed::profileKeysChanged, this, &KeyManagerWidget::onProfileKeysChanged);
+    connect(feed, &StorageChangeFeed::profilesChanged, this, &KeyManagerWidget::refreshProfileList);
 
-    if (saveKeysThread->isRunning()) {
-        saveKeysThread->quit();
-        if (waitForFinish) {
-            saveKeysThread->wait();
-        } else {
-            return;
+    // Key lists changed on disk, so the search index has too
+    connect(feed, &StorageChangeFeed::profilesChanged, this, [this]() {
+        searchIndex.reset();
+        if (!currentFilter.isEmpty()) {
+            applyFilter();
         }
-    }
-
-    if (saveKeysWorker) {
-        delete saveKeysWorker;
-        saveKeysWorker = nullptr;
-    }
-
-    delete saveKeysThread;
-    saveKeysThread = nullptr;
+    });
 }
 
 QString KeyManagerWidget::currentPassphrase() const
@@ -211,7 +158,7 @@ bool KeyManagerWidget::ensurePassphrase(bool requireConfirmation, QString &outPa
         return true;
     }
 
-    PassphrasePromptDialog dialog(requireConfirmation, config.gpgAvailable && !config.forcePlain, this);
+    PassphrasePromptDialog dialog(requireConfirmation, ak::storage::activeBackend(config) != ak::storage::Backend::Plain, this);
     if (dialog.exec() != QDialog::Accepted) {
         outPassphrase.clear();
         return false;
@@ -312,6 +259,7 @@ void KeyManagerWidget::setupToolbar()
     // Search box
     searchEdit = new QLineEdit(this);
     searchEdit->setPlaceholderText("Search keys...");
+    searchEdit->setToolTip("Substring, glob (STRIPE_*), /regex/ or ~fuzzy");
     searchEdit->setMaximumWidth(200);
     connect(searchEdit, &QLineEdit::textChanged, this, &KeyManagerWidget::searchKeys);
     
@@ -370,11 +318,15 @@ void KeyManagerWidget::setupToolbar()
 
 void KeyManagerWidget::setupTable()
 {
-    table = new QTableWidget(this);
-    table->setColumnCount(ColumnCount);
-    
-    QStringList headers = {"Key Name", "Service", "API URL", "Value", "Test Status", "Actions"};
-    table->setHorizontalHeaderLabels(headers);
+    keyModel = new KeyTableModel(this);
+    keyModel->setResolver([this](const std::string &name, const std::string &value) {
+        return resolveKeyInfo(name, value);
+    });
+    proxyModel = new SearchFilterProxyModel(this);
+    proxyModel->setSourceModel(keyModel);
+
+    table = new QTableView(this);
+    table->setModel(proxyModel);
     
     // Configure table appearance
     table->setSelectionBehavior(QAbstractItemView::SelectRows);
@@ -386,7 +338,7 @@ void KeyManagerWidget::setupTable()
     // Disable sorting for actions column specifically
     QHeaderView *headerForSorting = table->horizontalHeader();
     connect(headerForSorting, &QHeaderView::sortIndicatorChanged, [this](int logicalIndex, Qt::SortOrder) {
-        if (logicalIndex == ColumnActions) {
+        if (logicalIndex == KeyTableModel::ColumnActions) {
             // Prevent sorting on Actions column
             table->horizontalHeader()->setSortIndicator(-1, Qt::AscendingOrder);
         }
@@ -394,21 +346,26 @@ void KeyManagerWidget::setupTable()
     
     // Configure column widths - responsive design
     QHeaderView *header = table->horizontalHeader();
-    header->setSectionResizeMode(ColumnName, QHeaderView::ResizeToContents);
-    header->setSectionResizeMode(ColumnService, QHeaderView::ResizeToContents);
-    header->setSectionResizeMode(ColumnUrl, QHeaderView::Interactive);
-    header->setSectionResizeMode(ColumnValue, QHeaderView::Stretch);
-    header->setSectionResizeMode(ColumnTestStatus, QHeaderView::ResizeToContents);
-    header->setSectionResizeMode(ColumnActions, QHeaderView::Fixed);
+    // ResizeToContents would measure every row on each change, which defeats
+    // lazy row resolution; Interactive columns are sized once from the header
+    header->setSectionResizeMode(KeyTableModel::ColumnName, QHeaderView::Interactive);
+    header->setSectionResizeMode(KeyTableModel::ColumnService, QHeaderView::Interactive);
+    header->setSectionResizeMode(KeyTableModel::ColumnUrl, QHeaderView::Interactive);
+    header->setSectionResizeMode(KeyTableModel::ColumnValue, QHeaderView::Stretch);
+    header->setSectionResizeMode(KeyTableModel::ColumnTestStatus, QHeaderView::Interactive);
+    header->setSectionResizeMode(KeyTableModel::ColumnActions, QHeaderView::Fixed);
+    header->resizeSection(KeyTableModel::ColumnName, 200);
+    header->resizeSection(KeyTableModel::ColumnService, 120);
+    header->resizeSection(KeyTableModel::ColumnTestStatus, 140);
     
     // Set fixed width for actions column
-    header->resizeSection(ColumnActions, 60);
+    header->resizeSection(KeyTableModel::ColumnActions, 60);
     
     // Connect signals
-    connect(table, &QTableWidget::itemSelectionChanged, this, &KeyManagerWidget::onSelectionChanged);
-    connect(table, &QTableWidget::itemChanged, this, &KeyManagerWidget::onTableItemChanged);
-    connect(table, &QTableWidget::customContextMenuRequested, this, &KeyManagerWidget::showContextMenu);
-    connect(table, &QTableWidget::itemDoubleClicked, this, &KeyManagerWidget::editKey);
+    connect(table->selectionModel(), &QItemSelectionModel::selectionChanged, this, &KeyManagerWidget::onSelectionChanged);
+    connect(table, &QTableView::clicked, this, &KeyManagerWidget::onTableClicked);
+    connect(table, &QTableView::customContextMenuRequested, this, &KeyManagerWidget::showContextMenu);
+    connect(table, &QTableView::doubleClicked, this, &KeyManagerWidget::editKey);
     
     mainLayout->addWidget(table);
 }
@@ -434,9 +391,9 @@ void KeyManagerWidget::setupContextMenu()
     copyNameAction = contextMenu->addAction("Copy Name");
     copyNameAction->setIcon(QApplication::style()->standardIcon(QStyle::SP_DialogApplyButton));
     connect(copyNameAction, &QAction::triggered, [this]() {
-        int row = table->currentRow();
+        int row = currentSourceRow();
         if (row >= 0) {
-            QString name = table->item(row, ColumnName)->text();
+            QString name = QString::fromStdString(keyModel->nameAt(row));
             QApplication::clipboard()->setText(name);
             showSuccess("Key name copied to clipboard");
         }
@@ -445,25 +402,16 @@ void KeyManagerWidget::setupContextMenu()
     copyValueAction = contextMenu->addAction("Copy Value");
     copyValueAction->setIcon(QApplication::style()->standardIcon(QStyle::SP_DialogApplyButton));
     connect(copyValueAction, &QAction::triggered, [this]() {
-        int row = table->currentRow();
+        int row = currentSourceRow();
         if (row >= 0) {
-            MaskedTableItem *item = dynamic_cast<MaskedTableItem*>(table->item(row, ColumnValue));
-            if (item) {
-                QApplication::clipboard()->setText(item->getActualValue());
-                showSuccess("Key value copied to clipboard");
-            }
+            QApplication::clipboard()->setText(QString::fromStdString(keyModel->valueAt(row)));
+            showSuccess("Key value copied to clipboard");
         }
     });
     
     toggleVisibilityAction = contextMenu->addAction("Toggle Visibility");
     connect(toggleVisibilityAction, &QAction::triggered, [this]() {
-        int row = table->currentRow();
-        if (row >= 0) {
-            MaskedTableItem *item = dynamic_cast<MaskedTableItem*>(table->item(row, ColumnValue));
-            if (item) {
-                item->setMasked(!item->isMasked());
-            }
-        }
+        keyModel->toggleRowMasked(currentSourceRow());
     });
 }
 
@@ -479,36 +427,25 @@ void KeyManagerWidget::saveKeys()
 
 void KeyManagerWidget::loadProfileKeys(const QString &profileName)
 {
-    if (loadingInProgress && loadKeysThread && loadKeysThread->isRunning()) {
-        statusLabel->setText(QString("Waiting for profile '%1' to finish loading...").arg(profileName));
-        statusLabel->setStyleSheet("color: #cc6600; font-size: 12px;");
-        return;
-    }
-
-    cleanupLoadThread(false);
-
     // Check cache first
     auto cachedIt = cachedProfileKeys.find(profileName);
     if (cachedIt != cachedProfileKeys.end()) {
-        profileKeys = cachedIt->second;
-        loadingInProgress = false;
-        updateTable();
+        showProfileKeys(profileName, cachedIt->second);
         statusLabel->setText(QString("Loaded %1 keys from profile '%2'").arg(profileKeys.size()).arg(profileName));
         statusLabel->setStyleSheet("color: #666; font-size: 12px;");
         updateButtonStates();
         return;
     }
 
-    bool passRequired = config.gpgAvailable && !config.forcePlain;
+    bool passRequired = ak::storage::activeBackend(config) != ak::storage::Backend::Plain;
     std::filesystem::path keysPath = ak::storage::profileKeysPath(config, profileName.toStdString());
-    bool encryptedFileExists = passRequired && std::filesystem::exists(keysPath) && keysPath.extension() == ".gpg";
+    bool encryptedFileExists = passRequired && std::filesystem::exists(keysPath) && keysPath.extension() != ".keys";
 
     QString passphrase;
     if (encryptedFileExists) {
         if (!ensurePassphrase(false, passphrase)) {
             statusLabel->setText("Load cancelled");
             statusLabel->setStyleSheet("color: #cc6600; font-size: 12px;");
-            loadingInProgress = false;
             updateButtonStates();
             return;
         }
@@ -518,80 +455,102 @@ void KeyManagerWidget::loadProfileKeys(const QString &profileName)
     statusLabel->setText(QString("Loading keys from profile '%1'...").arg(profileName));
     statusLabel->setStyleSheet("color: #0066cc; font-size: 12px;");
 
-    loadingInProgress = true;
+    ++pendingLoads;
     updateButtonStates();
+    requestLoad(profileName, passphrase, false);
+}
 
-    // Create new worker and thread
-    loadKeysThread = new QThread();
-    loadKeysWorker = new ProfileKeysLoaderWorker(config, profileName, passphrase);
-    loadKeysWorker->moveToThread(loadKeysThread);
-
-    // Connect signals
-    connect(loadKeysThread, &QThread::started, loadKeysWorker, &ProfileKeysLoaderWorker::loadKeys);
-    connect(loadKeysWorker, &ProfileKeysLoaderWorker::keysLoaded, this, &KeyManagerWidget::onKeysLoaded);
-    connect(loadKeysWorker, &ProfileKeysLoaderWorker::loadFailed, this, &KeyManagerWidget::onKeysLoadFailed);
-    connect(loadKeysWorker, &ProfileKeysLoaderWorker::keysLoaded, loadKeysThread, &QThread::quit);
-    connect(loadKeysWorker, &ProfileKeysLoaderWorker::loadFailed, loadKeysThread, &QThread::quit);
-    connect(loadKeysThread, &QThread::finished, this, [this]() {
-        if (loadKeysWorker) {
-            loadKeysWorker->deleteLater();
-            loadKeysWorker = nullptr;
-        }
-        if (loadKeysThread) {
-            loadKeysThread->deleteLater();
-            loadKeysThread = nullptr;
-        }
-    });
-
-    // Start the thread
-    loadKeysThread->start();
+void KeyManagerWidget::requestLoad(const QString &profileName, const QString &passphrase, bool quiet)
+{
+    ProfileKeysWorker *worker = keysWorker;
+    QMetaObject::invokeMethod(worker, [worker, profileName, passphrase, quiet]() {
+        worker->loadKeys(profileName, passphrase, quiet);
+    }, Qt::QueuedConnection);
 }
 
-void KeyManagerWidget::onKeysLoaded(const QString& profileName, const std::map<std::string, std::string>& keys)
+void KeyManagerWidget::showProfileKeys(const QString &profileName, const std::map<std::string, std::string> &keys)
 {
     profileKeys = keys;
-    cachedProfileKeys[profileName] = profileKeys;
-    keysModified = false;
-    loadingInProgress = false;
-
+    profileIndex = ak::storage::ProfileIndex(profileKeys);
+    if (profileName == shownProfile) {
+        keyModel->syncKeys(profileKeys);
+        return;
+    }
+    shownProfile = profileName;
     updateTable();
-
-    emit statusMessage(QString("Loaded %1 keys from profile '%2'").arg(profileKeys.size()).arg(profileName));
-    statusLabel->setStyleSheet("color: #666; font-size: 12px;");
-    updateButtonStates();
+    if (!currentFilter.isEmpty()) {
+        applyFilter();
+    }
 }
 
-void KeyManagerWidget::onKeysLoadFailed(const QString& profileName, const QString& error)
+void KeyManagerWidget::onKeysLoaded(const QString& profileName, const std::map<std::string, std::string>& keys, bool quiet)
 {
-    profileKeys.clear();
-    cachedProfileKeys[profileName] = profileKeys;
+    if (!quiet) {
+        pendingLoads = std::max(0, pendingLoads - 1);
+    }
+    cachedProfileKeys[profileName] = keys;
+    // The user may have switched profiles while this was queued; and a queued
+    // save of ours would make a quiet reload step back for a moment
+    if (profileName != currentProfile || (quiet && pendingSaves > 0)) {
+        updateButtonStates();
+        return;
+    }
+
+    showProfileKeys(profileName, keys);
     keysModified = false;
-    loadingInProgress = false;
 
-    updateTable();
+    if (!quiet) {
+        emit statusMessage(QString("Loaded %1 keys from profile '%2'").arg(profileKeys.size()).arg(profileName));
+        statusLabel->setStyleSheet("color: #666; font-size: 12px;");
+    }
+    updateButtonStates();
+}
+
+void KeyManagerWidget::onKeysLoadFailed(const QString& profileName, const QString& error, bool quiet)
+{
+    if (quiet) {
+        // Keep showing what we have; the user can retry with Refresh
+        showError(QString("Profile '%1' changed on disk but could not be reloaded: %2").arg(profileName).arg(error));
+        return;
+    }
+    pendingLoads = std::max(0, pendingLoads - 1);
+    cachedProfileKeys[profileName] = {};
+    if (profileName == currentProfile) {
+        showProfileKeys(profileName, {});
+        keysModified = false;
+    }
 
     showError(QString("Failed to load keys from profile '%1': %2").arg(profileName).arg(error));
     updateButtonStates();
 }
 
-void KeyManagerWidget::saveProfileKeys(const QString &profileName)
+void KeyManagerWidget::onProfileKeysChanged(const QString& profileName)
 {
-    if (savingInProgress && saveKeysThread && saveKeysThread->isRunning()) {
-        statusLabel->setText(QString("Saving keys for profile '%1'... Please wait.").arg(profileName));
-        statusLabel->setStyleSheet("color: #cc6600; font-size: 12px;");
+    // Covers our own saves too; those hit the decrypted cache and diff to nothing
+    cachedProfileKeys.erase(profileName);
+    if (profileName != currentProfile) {
         return;
     }
 
-    cleanupSaveThread(false);
+    QString passphrase = currentPassphrase();
+    if (ak::storage::activeBackend(config) != ak::storage::Backend::Plain && passphrase.isEmpty()) {
+        // Never prompt from a background event
+        statusLabel->setText(QString("Profile '%1' changed on disk; click Refresh to reload").arg(profileName));
+        statusLabel->setStyleSheet("color: #cc6600; font-size: 12px;");
+        return;
+    }
+    requestLoad(profileName, passphrase, true);
+}
 
-    bool passRequired = config.gpgAvailable && !config.forcePlain;
+void KeyManagerWidget::saveProfileKeys(const QString &profileName)
+{
+    bool passRequired = ak::storage::activeBackend(config) != ak::storage::Backend::Plain;
     QString passphrase;
     if (passRequired) {
         bool needConfirmation = currentPassphrase().isEmpty();
         if (!ensurePassphrase(needConfirmation, passphrase)) {
             statusLabel->setText("Save cancelled");
             statusLabel->setStyleSheet("color: #cc6600; font-size: 12px;");
-            savingInProgress = false;
             updateButtonStates();
             return;
         }
@@ -600,48 +559,29 @@ void KeyManagerWidget::saveProfileKeys(const QString &profileName)
     statusLabel->setText(QString("Saving keys to profile '%1'...").arg(profileName));
     statusLabel->setStyleSheet("color: #0066cc; font-size: 12px;");
 
-    savingInProgress = true;
+    ++pendingSaves;
     updateButtonStates();
 
-    saveKeysThread = new QThread();
-    saveKeysWorker = new ProfileKeysSaverWorker(config, profileName, profileKeys, passphrase);
-    saveKeysWorker->moveToThread(saveKeysThread);
-
-    connect(saveKeysThread, &QThread::started, saveKeysWorker, &ProfileKeysSaverWorker::saveKeys);
-    connect(saveKeysWorker, &ProfileKeysSaverWorker::saveCompleted, this, &KeyManagerWidget::onKeysSaved);
-    connect(saveKeysWorker, &ProfileKeysSaverWorker::saveFailed, this, &KeyManagerWidget::onKeysSaveFailed);
-    connect(saveKeysWorker, &ProfileKeysSaverWorker::saveCompleted, saveKeysThread, &QThread::quit);
-    connect(saveKeysWorker, &ProfileKeysSaverWorker::saveFailed, saveKeysThread, &QThread::quit);
-    connect(saveKeysThread, &QThread::finished, this, [this]() {
-        if (saveKeysWorker) {
-            saveKeysWorker->deleteLater();
-            saveKeysWorker = nullptr;
-        }
-        if (saveKeysThread) {
-            saveKeysThread->deleteLater();
-            saveKeysThread = nullptr;
-        }
-    });
-
-    saveKeysThread->start();
+    // Queued behind earlier saves, each with its own snapshot of the keys
+    ProfileKeysWorker *worker = keysWorker;
+    std::map<std::string, std::string> keys = profileKeys;
+    QMetaObject::invokeMethod(worker, [worker, profileName, keys, passphrase]() {
+        worker->saveKeys(profileName, keys, passphrase);
+    }, Qt::QueuedConnection);
 }
 
-void KeyManagerWidget::onKeysSaved(const QString& profileName)
+void KeyManagerWidget::onKeysSaved(const QString& profileName, const QString& warning)
 {
-    savingInProgress = false;
-    keysModified = false;
-    cachedProfileKeys[profileName] = profileKeys;
+    pendingSaves = std::max(0, pendingSaves - 1);
+    keysModified = pendingSaves > 0;
+    if (profileName == currentProfile) {
+        cachedProfileKeys[profileName] = profileKeys;
+    }
 
-    try {
-        std::vector<std::string> keyNames;
-        keyNames.reserve(profileKeys.size());
-        for (const auto& [key, value] : profileKeys) {
-            keyNames.push_back(key);
-        }
-        ak::storage::writeProfile(config, profileName.toStdString(), keyNames);
+    if (warning.isEmpty()) {
         showSuccess(QString("Keys saved to profile '%1'").arg(profileName));
-    } catch (const std::exception& e) {
-        showError(QString("Keys saved but failed to update profile index: %1").arg(e.what()));
+    } else {
+        showError(warning);
     }
 
     emit statusMessage(QString("Keys saved to profile '%1'").arg(profileName));
@@ -650,18 +590,18 @@ void KeyManagerWidget::onKeysSaved(const QString& profileName)
 
 void KeyManagerWidget::onKeysSaveFailed(const QString& profileName, const QString& error)
 {
-    savingInProgress = false;
+    pendingSaves = std::max(0, pendingSaves - 1);
     showError(QString("Failed to save keys to profile '%1': %2").arg(profileName).arg(error));
     updateButtonStates();
 }
 
 void KeyManagerWidget::updateButtonStates()
 {
-    bool busy = loadingInProgress || savingInProgress;
-    bool hasSelection = table && table->currentRow() >= 0;
+    bool busy = pendingLoads > 0 || pendingSaves > 0;
+    bool hasSelection = table && currentSourceRow() >= 0;
 
     if (addButton) addButton->setEnabled(!busy);
-    if (refreshButton) refreshButton->setEnabled(!busy && !loadingInProgress);
+    if (refreshButton) refreshButton->setEnabled(!busy);
     if (editButton) editButton->setEnabled(!busy && hasSelection);
     if (deleteButton) deleteButton->setEnabled(!busy && hasSelection);
     if (testSelectedButton) testSelectedButton->setEnabled(!busy && hasSelection);
@@ -670,6 +610,9 @@ void KeyManagerWidget::updateButtonStates()
 
 void KeyManagerWidget::refreshProfileList()
 {
+    QString previous = currentProfile;
+    // Rebuilding the combo must not look like the user picking a profile
+    profileCombo->blockSignals(true);
     try {
         auto profiles = ak::storage::listProfiles(config);
         
@@ -690,6 +633,13 @@ void KeyManagerWidget::refreshProfileList()
     } catch (const std::exception& e) {
         showError(QString("Failed to load profiles: %1").arg(e.what()));
     }
+    profileCombo->blockSignals(false);
+
+    // The shown profile was removed (possibly by another process)
+    if (!previous.isEmpty() && currentProfile != previous) {
+        loadProfileKeys(currentProfile);
+        emit profileChanged(currentProfile);
+    }
 }
 
 void KeyManagerWidget::onProfileChanged(const QString &profileName)
@@ -746,84 +696,57 @@ QString KeyManagerWidget::getCurrentProfile() const
 
 void KeyManagerWidget::updateTable()
 {
-    // Clear table
-    table->setRowCount(0);
-    
-    // Add keys to table
-    int row = 0;
-    for (const auto& [name, value] : profileKeys) {
-        QString qname = QString::fromStdString(name);
-        QString qvalue = QString::fromStdString(value);
-        
-        // Apply filter if active
-        if (!currentFilter.isEmpty()) {
-            if (!qname.contains(currentFilter, Qt::CaseInsensitive)) {
-                continue;
-            }
-        }
-        
-        QString service = detectService(qname);
-        QString apiUrl = getServiceApiUrl(service);
-        addKeyToTable(qname, qvalue, service, apiUrl);
-        row++;
-    }
+    // Rows resolve their service and cached test status when first shown
+    servicesLoaded = false;
+    testCache.reset();
+    keyModel->setKeys(profileKeys);
     
     // Update status
-    statusLabel->setText(QString("Showing %1 keys from profile '%2'").arg(table->rowCount()).arg(currentProfile));
+    statusLabel->setText(QString("Showing %1 keys from profile '%2'").arg(proxyModel->rowCount()).arg(currentProfile));
     
     // Update button states
     onSelectionChanged();
 }
 
-void KeyManagerWidget::addKeyToTable(const QString &name, const QString &value, const QString &service, const QString &apiUrl)
+KeyTableModel::RowInfo KeyManagerWidget::resolveKeyInfo(const std::string &name, const std::string &value)
 {
-    int row = table->rowCount();
-    table->insertRow(row);
-    
-    // Name column
-    QTableWidgetItem *nameItem = new QTableWidgetItem(name);
-    nameItem->setFlags(nameItem->flags() & ~Qt::ItemIsEditable);
-    table->setItem(row, ColumnName, nameItem);
-    
-    // Service column
-    QTableWidgetItem *serviceItem = new QTableWidgetItem(service);
-    serviceItem->setFlags(serviceItem->flags() & ~Qt::ItemIsEditable);
-    table->setItem(row, ColumnService, serviceItem);
-    
-    // API URL column
-    QTableWidgetItem *urlItem = new QTableWidgetItem(apiUrl.isEmpty() ? "N/A" : apiUrl);
-    urlItem->setFlags(urlItem->flags() & ~Qt::ItemIsEditable);
-    if (!apiUrl.isEmpty()) {
-        urlItem->setToolTip("API Endpoint: " + apiUrl);
+    KeyTableModel::RowInfo info;
+    info.service = detectService(QString::fromStdString(name));
+    info.url = getServiceApiUrl(info.service);
+
+    // Last known outcome, shown instead of "Not tested"
+    QString serviceCode = getServiceCode(info.service);
+    if (serviceCode.isEmpty()) {
+        return info;
     }
-    table->setItem(row, ColumnUrl, urlItem);
-    
-    // Value column (masked)
-    MaskedTableItem *valueItem = new MaskedTableItem(value);
-    valueItem->setMasked(globalVisibilityState);
-    valueItem->setFlags(valueItem->flags() & ~Qt::ItemIsEditable);
-    table->setItem(row, ColumnValue, valueItem);
-    
-    // Test Status column
-    QTableWidgetItem *testStatusItem = new QTableWidgetItem("Not tested");
-    testStatusItem->setFlags(testStatusItem->flags() & ~Qt::ItemIsEditable);
-    testStatusItem->setTextAlignment(Qt::AlignCenter);
-    table->setItem(row, ColumnTestStatus, testStatusItem);
-    
-    // Actions column - make it clickable for context menu
-    QPushButton *actionsButton = new QPushButton();
-    QIcon menuIcon = QIcon::fromTheme("application-menu", QIcon(":/icons/menu.svg"));
-    actionsButton->setIcon(menuIcon);
-    actionsButton->setToolTip("Click for actions");
-    actionsButton->setMaximumSize(30, 25);
-    actionsButton->setFlat(true);
-    connect(actionsButton, &QPushButton::clicked, [this, row, actionsButton]() {
-        table->selectRow(row);
-        // Get the global position of the button to show menu nearby
-        QPoint globalPos = actionsButton->mapToGlobal(QPoint(actionsButton->width()/2, actionsButton->height()));
-        contextMenu->exec(globalPos);
-    });
-    table->setCellWidget(row, ColumnActions, actionsButton);
+    try {
+        if (!testCache) {
+            testCache = std::make_unique<ak::services::TestResultCache>(config);
+        }
+        ak::services::TestResult cached;
+        if (testCache->lookup(serviceCode.toStdString(), value, ak::services::defaultTestCacheTtl(), cached)) {
+            if (cached.ok) {
+                info.state = TestState::Passed;
+                info.status = QString("? %1ms (cached)").arg(cached.duration.count());
+            } else {
+                QString error = cached.error_message.empty() ? "Failed" : QString::fromStdString(cached.error_message);
+                info.state = TestState::Failed;
+                info.status = "? " + error + " (cached)";
+            }
+        }
+    } catch (const std::exception&) {
+        // An unreadable cache just means no history
+    }
+    return info;
+}
+
+int KeyManagerWidget::currentSourceRow() const
+{
+    QModelIndex current = table->currentIndex();
+    if (!current.isValid()) {
+        return -1;
+    }
+    return proxyModel->mapToSource(current).row();
 }
 
 QString KeyManagerWidget::detectService(const QString &keyName)
@@ -832,7 +755,7 @@ QString KeyManagerWidget::detectService(const QString &keyName)
     
     // First, check actual loaded services from config (handles custom services)
     try {
-        auto allServices = ak::services::loadAllServices(config);
+        const auto& allServices = serviceCatalog();
         for (const auto& [serviceName, service] : allServices) {
             if (QString::fromStdString(service.keyName).compare(keyName, Qt::CaseInsensitive) == 0) {
                 // Use description if available, otherwise use service name
@@ -902,7 +825,7 @@ QString KeyManagerWidget::getServiceApiUrl(const QString &service)
 {
     // First, check actual loaded services from config (handles custom services)
     try {
-        auto allServices = ak::services::loadAllServices(config);
+        const auto& allServices = serviceCatalog();
         for (const auto& [serviceName, serviceObj] : allServices) {
             QString serviceDisplayName = QString::fromStdString(serviceObj.description);
             if (serviceDisplayName.isEmpty()) {
@@ -976,18 +899,19 @@ void KeyManagerWidget::refreshKeys()
     // Clear cache for current profile to force reload
     cachedProfileKeys.erase(currentProfile);
     loadKeys();
-    updateTable();
     showSuccess("Keys refreshed");
 }
 
 void KeyManagerWidget::selectKey(const QString &keyName)
 {
-    for (int row = 0; row < table->rowCount(); ++row) {
-        if (table->item(row, ColumnName)->text() == keyName) {
-            table->selectRow(row);
-            table->scrollToItem(table->item(row, ColumnName));
-            break;
-        }
+    int row = keyModel->rowOf(keyName.toStdString());
+    if (row < 0) {
+        return;
+    }
+    QModelIndex index = proxyModel->mapFromSource(keyModel->index(row, KeyTableModel::ColumnName));
+    if (index.isValid()) {
+        table->selectRow(index.row());
+        table->scrollTo(index);
     }
 }
 
@@ -999,16 +923,22 @@ void KeyManagerWidget::addKey()
         QString value = dialog.getKeyValue();
         
         // Check if key already exists
-        if (profileKeys.find(name.toStdString()) != profileKeys.end()) {
+        std::string keyName = name.toStdString();
+        if (profileIndex.contains(keyName)) {
             showError("Key with this name already exists!");
             return;
         }
+        if (const std::string* other = profileIndex.conflictFor(keyName)) {
+            showError(QString("Key name clashes with existing key %1").arg(QString::fromStdString(*other)));
+            return;
+        }
         
         // Add to profile keys
-        profileKeys[name.toStdString()] = value.toStdString();
+        profileKeys[keyName] = value.toStdString();
+        profileIndex.add(keyName);
         keysModified = true;
         saveKeys();
-        updateTable();
+        keyModel->upsertKey(keyName, value.toStdString());
         selectKey(name);
         
         showSuccess(QString("Added key: %1").arg(name));
@@ -1017,16 +947,14 @@ void KeyManagerWidget::addKey()
 
 void KeyManagerWidget::editKey()
 {
-    int row = table->currentRow();
+    int row = currentSourceRow();
     if (row < 0) return;
     
-    QString name = table->item(row, ColumnName)->text();
-    MaskedTableItem *valueItem = dynamic_cast<MaskedTableItem*>(table->item(row, ColumnValue));
-    QString service = table->item(row, ColumnService)->text();
+    QString name = QString::fromStdString(keyModel->nameAt(row));
+    QString value = QString::fromStdString(keyModel->valueAt(row));
+    QString service = keyModel->serviceAt(row);
     
-    if (!valueItem) return;
-    
-    KeyEditDialog dialog(config, name, valueItem->getActualValue(), service, this);
+    KeyEditDialog dialog(config, name, value, service, this);
     if (dialog.exec() == QDialog::Accepted) {
         QString newValue = dialog.getKeyValue();
         
@@ -1035,11 +963,8 @@ void KeyManagerWidget::editKey()
         keysModified = true;
         saveKeys();
         
-        // Update table item
-        valueItem = new MaskedTableItem(newValue);
-        valueItem->setMasked(globalVisibilityState);
-        valueItem->setFlags(valueItem->flags() & ~Qt::ItemIsEditable);
-        table->setItem(row, ColumnValue, valueItem);
+        // Update the row in place
+        keyModel->upsertKey(name.toStdString(), newValue.toStdString());
         
         showSuccess(QString("Updated key: %1").arg(name));
     }
@@ -1047,10 +972,10 @@ void KeyManagerWidget::editKey()
 
 void KeyManagerWidget::deleteKey()
 {
-    int row = table->currentRow();
+    int row = currentSourceRow();
     if (row < 0) return;
     
-    QString name = table->item(row, ColumnName)->text();
+    QString name = QString::fromStdString(keyModel->nameAt(row));
     
     if (ConfirmationDialog::confirm(this, "Delete Key", 
         QString("Are you sure you want to delete the key '%1'?").arg(name),
@@ -1058,9 +983,10 @@ void KeyManagerWidget::deleteKey()
         
         // Remove from keystore
         profileKeys.erase(name.toStdString());
+        profileIndex.remove(name.toStdString());
         keysModified = true;
         saveKeys();
-        updateTable();
+        keyModel->removeKey(name.toStdString());
         
         showSuccess(QString("Deleted key: %1").arg(name));
     }
@@ -1069,20 +995,42 @@ void KeyManagerWidget::deleteKey()
 void KeyManagerWidget::searchKeys(const QString &text)
 {
     currentFilter = text.trimmed();
-    updateTable();
+    applyFilter();
+}
+
+void KeyManagerWidget::applyFilter()
+{
+    if (currentFilter.isEmpty()) {
+        proxyModel->clearAcceptedNames();
+    } else {
+        if (!searchIndex) {
+            searchIndex = std::make_unique<ak::storage::KeySearchIndex>(config);
+            searchIndex->refresh();
+            searchIndex->save();
+        }
+        std::string pattern;
+        ak::storage::KeyMatch mode = ak::storage::parseKeyQuery(currentFilter.toStdString(), pattern);
+        QSet<QString> names;
+        try {
+            for (const auto &hit : searchIndex->search(pattern, mode, shownProfile.toStdString())) {
+                names.insert(QString::fromStdString(hit.name).toLower());
+            }
+        } catch (const std::exception &) {
+            // A regex still being typed; keep the previous filter
+            return;
+        }
+        proxyModel->setAcceptedNames(names);
+    }
+    statusLabel->setText(QString("Showing %1 keys from profile '%2'").arg(proxyModel->rowCount()).arg(currentProfile));
+    onSelectionChanged();
 }
 
 void KeyManagerWidget::toggleKeyVisibility()
 {
     globalVisibilityState = !globalVisibilityState;
     
-    // Update all masked items
-    for (int row = 0; row < table->rowCount(); ++row) {
-        MaskedTableItem *item = dynamic_cast<MaskedTableItem*>(table->item(row, ColumnValue));
-        if (item) {
-            item->setMasked(globalVisibilityState);
-        }
-    }
+    // Repaints the value column; masked text is computed per visible cell
+    keyModel->setMasked(globalVisibilityState);
     
     // Update button text and icon
     toggleVisibilityButton->setIcon(globalVisibilityState
@@ -1094,11 +1042,10 @@ void KeyManagerWidget::toggleKeyVisibility()
 
 void KeyManagerWidget::showContextMenu(const QPoint &pos)
 {
-    QTableWidgetItem *item = table->itemAt(pos);
-    if (!item) return;
+    QModelIndex index = table->indexAt(pos);
+    if (!index.isValid()) return;
     
-    int row = item->row();
-    bool hasSelection = row >= 0;
+    bool hasSelection = true;
     
     editAction->setEnabled(hasSelection);
     deleteAction->setEnabled(hasSelection);
@@ -1106,13 +1053,18 @@ void KeyManagerWidget::showContextMenu(const QPoint &pos)
     copyValueAction->setEnabled(hasSelection);
     toggleVisibilityAction->setEnabled(hasSelection);
     
-    contextMenu->exec(table->mapToGlobal(pos));
+    contextMenu->exec(table->viewport()->mapToGlobal(pos));
 }
 
-void KeyManagerWidget::onTableItemChanged(QTableWidgetItem *item)
+void KeyManagerWidget::onTableClicked(const QModelIndex &index)
 {
-    // Currently all items are read-only, so this shouldn't be called
-    Q_UNUSED(item)
+    // The Actions column opens the row's menu below the clicked cell
+    if (!index.isValid() || index.column() != KeyTableModel::ColumnActions) {
+        return;
+    }
+    table->selectRow(index.row());
+    QRect cell = table->visualRect(index);
+    showContextMenu(QPoint(cell.center().x(), cell.bottom()));
 }
 
 void KeyManagerWidget::onSelectionChanged()
@@ -1159,11 +1111,11 @@ void KeyManagerWidget::showSuccess(const QString &message)
 
 void KeyManagerWidget::testSelectedKey()
 {
-    int row = table->currentRow();
+    int row = currentSourceRow();
     if (row < 0) return;
     
-    QString keyName = table->item(row, ColumnName)->text();
-    QString serviceName = table->item(row, ColumnService)->text();
+    QString keyName = QString::fromStdString(keyModel->nameAt(row));
+    QString serviceName = keyModel->serviceAt(row);
     
     // Map service display name to service code
     QString serviceCode = getServiceCode(serviceName);
@@ -1184,7 +1136,15 @@ void KeyManagerWidget::testSelectedKey()
     // Run test in separate thread to avoid blocking UI
     QTimer::singleShot(100, [this, serviceCode, serviceName, keyName]() {
         try {
-            auto result = ak::services::test_one(config, serviceCode.toStdString());
+            std::string code = serviceCode.toStdString();
+            auto result = ak::services::test_one(config, code);
+            try {
+                ak::services::TestResultCache cache(config);
+                cache.store(code, ak::services::resolveTestKey(config, code), result);
+                cache.save();
+            } catch (const std::exception&) {
+                // Caching is best effort
+            }
             
             if (result.ok) {
                 updateTestStatus(keyName, true, QString("? %1ms").arg(result.duration.count()));
@@ -1199,28 +1159,16 @@ void KeyManagerWidget::testSelectedKey()
             showError(QString("%1 test failed: %2").arg(serviceName).arg(e.what()));
         }
         
-        testSelectedButton->setEnabled(table->currentRow() >= 0);
+        testSelectedButton->setEnabled(currentSourceRow() >= 0);
     });
 }
 
 void KeyManagerWidget::updateTestStatus(const QString &keyName, bool success, const QString &message)
 {
-    for (int row = 0; row < table->rowCount(); ++row) {
-        if (table->item(row, ColumnName)->text() == keyName) {
-            QTableWidgetItem *statusItem = table->item(row, ColumnTestStatus);
-            if (statusItem) {
-                statusItem->setText(message);
-                if (success) {
-                    statusItem->setForeground(QBrush(QColor(0, 170, 0))); // Green
-                } else if (message.startsWith("?")) {
-                    statusItem->setForeground(QBrush(QColor(204, 68, 68))); // Red
-                } else {
-                    statusItem->setForeground(QBrush(QColor(102, 102, 102))); // Gray for testing
-                }
-            }
-            break;
-        }
-    }
+    TestState state = success ? TestState::Passed
+                    : message.startsWith("?") ? TestState::Failed
+                    : TestState::Testing;
+    keyModel->setTestStatus(keyName.toStdString(), state, message);
 }
 
 void KeyManagerWidget::testAllKeys()
@@ -1232,13 +1180,13 @@ void KeyManagerWidget::testAllKeys()
         return;
     }
     
-    // Reset all test statuses to "Testing..."
-    for (int row = 0; row < table->rowCount(); ++row) {
-        QString keyName = table->item(row, ColumnName)->text();
-        QString serviceName = table->item(row, ColumnService)->text();
-        QString serviceCode = getServiceCode(serviceName);
-        
-        if (!serviceCode.isEmpty() && std::find(configuredServices.begin(), configuredServices.end(), serviceCode.toStdString()) != configuredServices.end()) {
+    // Keys per tested service, so each result updates its rows directly
+    std::map<std::string, std::vector<QString>> keysByService;
+    for (int row = 0; row < keyModel->rowCount(); ++row) {
+        std::string serviceCode = getServiceCode(keyModel->serviceAt(row)).toStdString();
+        if (!serviceCode.empty() && std::find(configuredServices.begin(), configuredServices.end(), serviceCode) != configuredServices.end()) {
+            QString keyName = QString::fromStdString(keyModel->nameAt(row));
+            keysByService[serviceCode].push_back(keyName);
             updateTestStatus(keyName, false, "Testing...");
         }
     }
@@ -1253,25 +1201,29 @@ void KeyManagerWidget::testAllKeys()
     // Run tests
     std::string profileName = currentProfile.toStdString();
 
-    QTimer::singleShot(100, [this, configuredServices, profileName]() {
+    QTimer::singleShot(100, [this, configuredServices, keysByService, profileName]() {
         try {
-            auto results = ak::services::run_tests_parallel(config, configuredServices, false, profileName, false);
+            std::vector<ak::services::TestJob> jobs;
+            for (const auto& service : configuredServices) {
+                jobs.push_back({service, profileName});
+            }
+            ak::services::TestSchedule schedule;
+            schedule.useCache = true;
+            schedule.refreshCache = true;
+            auto results = ak::services::run_test_jobs(config, jobs, schedule);
             
             // Update status for each service
             for (const auto& result : results) {
-                // Find the key name for this service
-                for (int row = 0; row < table->rowCount(); ++row) {
-                    QString keyName = table->item(row, ColumnName)->text();
-                    QString serviceName = table->item(row, ColumnService)->text();
-                    QString serviceCode = getServiceCode(serviceName);
-                    
-                    if (serviceCode.toStdString() == result.service) {
-                        if (result.ok) {
-                            updateTestStatus(keyName, true, QString("? %1ms").arg(result.duration.count()));
-                        } else {
-                            QString error = result.error_message.empty() ? "Failed" : QString::fromStdString(result.error_message);
-                            updateTestStatus(keyName, false, "? " + error);
-                        }
+                auto keys = keysByService.find(result.service);
+                if (keys == keysByService.end()) {
+                    continue;
+                }
+                for (const QString& keyName : keys->second) {
+                    if (result.ok) {
+                        updateTestStatus(keyName, true, QString("? %1ms").arg(result.duration.count()));
+                    } else {
+                        QString error = result.error_message.empty() ? "Failed" : QString::fromStdString(result.error_message);
+                        updateTestStatus(keyName, false, "? " + error);
                     }
                 }
             }
@@ -1293,10 +1245,19 @@ void KeyManagerWidget::testAllKeys()
         }
         
         testAllButton->setEnabled(true);
-        testSelectedButton->setEnabled(table->currentRow() >= 0);
+        testSelectedButton->setEnabled(currentSourceRow() >= 0);
     });
 }
 
+const std::map<std::string, ak::services::Service>& KeyManagerWidget::serviceCatalog()
+{
+    if (!servicesLoaded) {
+        serviceCache = ak::services::loadAllServices(config);
+        servicesLoaded = true;
+    }
+    return serviceCache;
+}
+
 QString KeyManagerWidget::getServiceCode(const QString &displayName)
 {
     // First try built-in service code mapping
@@ -1307,7 +1268,7 @@ QString KeyManagerWidget::getServiceCode(const QString &displayName)
     
     // If not found in built-in services, check custom services from config
     try {
-        auto allServices = ak::services::loadAllServices(config);
+        const auto& allServices = serviceCatalog();
         for (const auto& [serviceName, service] : allServices) {
             // Check if display name matches service description or name
             QString serviceDisplayName = QString::fromStdString(service.description);
@@ -1520,31 +1481,13 @@ void KeyManagerWidget::importProfile()
         try {
             std::vector<std::string> keys;
 
-            if (format == "env") {
-                // Parse .env file
-                std::ifstream input(filePath.toStdString());
-                auto parsedKeys = ak::storage::parse_env_file(input);
-                for (const auto& [key, value] : parsedKeys) {
-                    keys.push_back(key);
-                }
-            } else if (format == "json") {
-                // Parse JSON file
-                std::ifstream input(filePath.toStdString());
-                std::string content((std::istreambuf_iterator<char>(input)),
-                                  std::istreambuf_iterator<char>());
-                auto parsedKeys = ak::storage::parse_json_min(content);
-                for (const auto& [key, value] : parsedKeys) {
-                    keys.push_back(key);
-                }
-            } else if (format == "yaml") {
-                // For now, treat YAML as JSON (simplified)
-                std::ifstream input(filePath.toStdString());
-                std::string content((std::istreambuf_iterator<char>(input)),
-                                  std::istreambuf_iterator<char>());
-                auto parsedKeys = ak::storage::parse_json_min(content);
-                for (const auto& [key, value] : parsedKeys) {
-                    keys.push_back(key);
-                }
+            // Streams the file; only the names are needed here
+            ak::storage::ImportFormat importFormat;
+            if (ak::storage::parseImportFormat(format.toStdString(), importFormat)) {
+                std::ifstream input(filePath.toStdString(), std::ios::binary);
+                ak::storage::importStream(input, importFormat, [&](std::string key, std::string) {
+                    keys.push_back(std::move(key));
+                });
             }
 
             // Write profile
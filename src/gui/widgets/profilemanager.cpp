@@ -1,8 +1,10 @@
 #ifdef BUILD_GUI
 
 #include "gui/widgets/profilemanager.hpp"
+#include "gui/widgets/changefeed.hpp"
 #include "gui/widgets/common/dialogs.hpp"
 #include "storage/vault.hpp"
+#include "storage/importer.hpp"
 #include "core/config.hpp"
 #include <QApplication>
 #include <QInputDialog>
@@ -215,20 +217,17 @@ void ProfileManagerWidget::loadProfiles()
 {
     try {
         availableProfiles.clear();
-        auto profiles = ak::storage::listProfiles(config);
-        for (const auto& profile : profiles) {
-            availableProfiles << QString::fromStdString(profile);
-        }
+        // Names and key counts come from the metadata cache while the
+        // profiles directory is unchanged, instead of reading every profile
+        auto profiles = ak::storage::listProfileSummaries(config);
 
         // Clear and populate list
         profileList->clear();
 
-        for (const QString& profileName : availableProfiles) {
-            // Get key count for this profile
-            auto keys = ak::storage::readProfile(config, profileName.toStdString());
-            int keyCount = keys.size();
-
-            new ProfileListItem(profileName, keyCount, profileList);
+        for (const auto& profile : profiles) {
+            QString profileName = QString::fromStdString(profile.name);
+            availableProfiles << profileName;
+            new ProfileListItem(profileName, static_cast<int>(profile.keyCount), profileList);
         }
 
         profileListLabel->setText(QString("Available Profiles (%1):").arg(availableProfiles.size()));
@@ -243,6 +242,12 @@ void ProfileManagerWidget::loadProfiles()
     }
 }
 
+void ProfileManagerWidget::watchStorage(StorageChangeFeed *feed)
+{
+    connect(feed, &StorageChangeFeed::profilesChanged, this, &ProfileManagerWidget::loadProfiles);
+    connect(feed, &StorageChangeFeed::vaultChanged, this, [this]() { vaultCache.reset(); });
+}
+
 void ProfileManagerWidget::refreshProfiles()
 {
     // Ensure default profile exists first
@@ -252,6 +257,7 @@ void ProfileManagerWidget::refreshProfiles()
         showError(QString("Failed to ensure default profile: %1").arg(e.what()));
     }
     
+    vaultCache.reset();
     loadProfiles();
     showSuccess("Profiles refreshed");
 }
@@ -406,31 +412,13 @@ void ProfileManagerWidget::importProfile()
         try {
             std::vector<std::string> keys;
 
-            if (format == "env") {
-                // Parse .env file
-                std::ifstream input(filePath.toStdString());
-                auto parsedKeys = ak::storage::parse_env_file(input);
-                for (const auto& [key, value] : parsedKeys) {
-                    keys.push_back(key);
-                }
-            } else if (format == "json") {
-                // Parse JSON file
-                std::ifstream input(filePath.toStdString());
-                std::string content((std::istreambuf_iterator<char>(input)),
-                                  std::istreambuf_iterator<char>());
-                auto parsedKeys = ak::storage::parse_json_min(content);
-                for (const auto& [key, value] : parsedKeys) {
-                    keys.push_back(key);
-                }
-            } else if (format == "yaml") {
-                // For now, treat YAML as JSON (simplified)
-                std::ifstream input(filePath.toStdString());
-                std::string content((std::istreambuf_iterator<char>(input)),
-                                  std::istreambuf_iterator<char>());
-                auto parsedKeys = ak::storage::parse_json_min(content);
-                for (const auto& [key, value] : parsedKeys) {
-                    keys.push_back(key);
-                }
+            // Streams the file; only the names are needed here
+            ak::storage::ImportFormat importFormat;
+            if (ak::storage::parseImportFormat(format.toStdString(), importFormat)) {
+                std::ifstream input(filePath.toStdString(), std::ios::binary);
+                ak::storage::importStream(input, importFormat, [&](std::string key, std::string) {
+                    keys.push_back(std::move(key));
+                });
             }
 
             // Write profile
@@ -464,8 +452,12 @@ void ProfileManagerWidget::exportProfile()
             // Read profile keys (use the name from dialog in case user changed it)
             auto keys = ak::storage::readProfile(config, selectedProfileForExport.toStdString());
             
-            // Load vault to get actual key values
-            auto vault = ak::storage::loadVault(config);
+            // Load vault to get actual key values; one decrypt serves every
+            // export until the feed reports a change
+            if (!vaultCache) {
+                vaultCache = ak::storage::loadVault(config);
+            }
+            const auto& vault = *vaultCache;
 
             if (format == "env") {
                 // Export as .env file with values
@@ -1,6 +1,7 @@
 #ifdef BUILD_GUI
 
 #include "gui/widgets/servicemanager.hpp"
+#include "gui/widgets/changefeed.hpp"
 #include "gui/widgets/common/dialogs.hpp"
 #include "storage/vault.hpp"
 #include "services/services.hpp"
@@ -873,7 +874,7 @@ void ServiceManagerWidget::setupUi()
     mainLayout->addLayout(toolbarLayout);
     
     // Create table
-    table = new QTableWidget(this);
+    table = new QTableView(this);
     mainLayout->addWidget(table);
     
     // Status label
@@ -884,9 +885,10 @@ void ServiceManagerWidget::setupUi()
 
 void ServiceManagerWidget::setupTable()
 {
-    table->setColumnCount(ColumnCount);
-    QStringList headers = {"Name", "Key Name", "Description", "Type", "Testable", "Status"};
-    table->setHorizontalHeaderLabels(headers);
+    serviceModel = new ServiceTableModel(this);
+    proxyModel = new SearchFilterProxyModel(this);
+    proxyModel->setSourceModel(serviceModel);
+    table->setModel(proxyModel);
     
     // Configure table appearance
     table->setAlternatingRowColors(true);
@@ -898,19 +900,17 @@ void ServiceManagerWidget::setupTable()
     // Configure column widths
     QHeaderView *header = table->horizontalHeader();
     header->setStretchLastSection(true);
-    header->resizeSection(ColumnName, 120);
-    header->resizeSection(ColumnKeyName, 150);
-    header->resizeSection(ColumnDescription, 200);
-    header->resizeSection(ColumnTestable, 80);
+    header->resizeSection(ServiceTableModel::ColumnName, 120);
+    header->resizeSection(ServiceTableModel::ColumnKeyName, 150);
+    header->resizeSection(ServiceTableModel::ColumnDescription, 200);
+    header->resizeSection(ServiceTableModel::ColumnTestable, 80);
     
     // Connect signals
-    connect(table, &QTableWidget::customContextMenuRequested,
+    connect(table, &QTableView::customContextMenuRequested,
             this, &ServiceManagerWidget::showContextMenu);
-    connect(table, &QTableWidget::itemChanged,
-            this, &ServiceManagerWidget::onTableItemChanged);
     connect(table->selectionModel(), &QItemSelectionModel::selectionChanged,
             this, &ServiceManagerWidget::onSelectionChanged);
-    connect(table, &QTableWidget::itemDoubleClicked, [this]() {
+    connect(table, &QTableView::doubleClicked, [this]() {
         editService();
     });
 }
@@ -993,33 +993,28 @@ void ServiceManagerWidget::setupContextMenu()
     
     copyNameAction = contextMenu->addAction("Copy Name");
     connect(copyNameAction, &QAction::triggered, [this]() {
-        int row = table->currentRow();
-        if (row >= 0) {
-            QApplication::clipboard()->setText(table->item(row, ColumnName)->text());
+        if (const services::Service *service = currentService()) {
+            QApplication::clipboard()->setText(QString::fromStdString(service->name));
             emit statusMessage("Service name copied to clipboard");
         }
     });
     
     duplicateAction = contextMenu->addAction("Duplicate");
     connect(duplicateAction, &QAction::triggered, [this]() {
-        int row = table->currentRow();
-        if (row >= 0 && row < table->rowCount()) {
-            QString serviceName = table->item(row, ColumnName)->text();
-            auto it = allServices.find(serviceName.toStdString());
-            if (it != allServices.end()) {
-                auto service = it->second;
-                service.name += "_copy";
-                service.isBuiltIn = false; // Duplicated services are always user-defined
-                ServiceEditorDialog dialog(service, this);
-                if (dialog.exec() == QDialog::Accepted) {
-                    auto newService = dialog.getService();
-                    try {
-                        services::addService(config, newService);
-                        refreshServices();
-                        emit statusMessage("Service duplicated successfully");
-                    } catch (const std::exception& e) {
-                        showError("Failed to duplicate service: " + QString::fromStdString(e.what()));
-                    }
+        const services::Service *current = currentService();
+        if (current) {
+            auto service = *current;
+            service.name += "_copy";
+            service.isBuiltIn = false; // Duplicated services are always user-defined
+            ServiceEditorDialog dialog(service, this);
+            if (dialog.exec() == QDialog::Accepted) {
+                auto newService = dialog.getService();
+                try {
+                    services::addService(config, newService);
+                    refreshServices();
+                    emit statusMessage("Service duplicated successfully");
+                } catch (const std::exception& e) {
+                    showError("Failed to duplicate service: " + QString::fromStdString(e.what()));
                 }
             }
         }
@@ -1054,74 +1049,19 @@ void ServiceManagerWidget::saveServices()
 
 void ServiceManagerWidget::updateTable()
 {
-    table->setRowCount(0);
-    
-    for (const auto& [name, service] : allServices) {
-        if (!currentFilter.isEmpty() &&
-            !QString::fromStdString(service.name).contains(currentFilter, Qt::CaseInsensitive) &&
-            !QString::fromStdString(service.keyName).contains(currentFilter, Qt::CaseInsensitive) &&
-            !QString::fromStdString(service.description).contains(currentFilter, Qt::CaseInsensitive)) {
-            continue;
-        }
-        
-        addServiceToTable(service);
-    }
-    
+    // Only rows that were added, removed or changed are touched, so test
+    // results and the selection survive a reload
+    serviceModel->syncServices(allServices);
     table->resizeRowsToContents();
 }
 
-void ServiceManagerWidget::addServiceToTable(const services::Service &service)
+const services::Service *ServiceManagerWidget::currentService() const
 {
-    int row = table->rowCount();
-    table->insertRow(row);
-    
-    // Name
-    QTableWidgetItem *nameItem = new QTableWidgetItem(QString::fromStdString(service.name));
-    nameItem->setFlags(nameItem->flags() & ~Qt::ItemIsEditable);
-    if (service.isBuiltIn) {
-        nameItem->setIcon(QApplication::style()->standardIcon(QStyle::SP_ComputerIcon));
-    } else {
-        nameItem->setIcon(QApplication::style()->standardIcon(QStyle::SP_FileIcon));
-    }
-    table->setItem(row, ColumnName, nameItem);
-    
-    // Key Name
-    QTableWidgetItem *keyItem = new QTableWidgetItem(QString::fromStdString(service.keyName));
-    keyItem->setFlags(keyItem->flags() & ~Qt::ItemIsEditable);
-    table->setItem(row, ColumnKeyName, keyItem);
-    
-    // Description
-    QString desc = QString::fromStdString(service.description);
-    if (desc.length() > 50) {
-        desc = desc.left(47) + "...";
-    }
-    QTableWidgetItem *descItem = new QTableWidgetItem(desc);
-    descItem->setFlags(descItem->flags() & ~Qt::ItemIsEditable);
-    descItem->setToolTip(QString::fromStdString(service.description));
-    table->setItem(row, ColumnDescription, descItem);
-    
-    // Type
-    QTableWidgetItem *typeItem = new QTableWidgetItem(service.isBuiltIn ? "Built-in" : "User");
-    typeItem->setFlags(typeItem->flags() & ~Qt::ItemIsEditable);
-    if (service.isBuiltIn) {
-        typeItem->setForeground(QColor(0, 100, 0)); // Dark green for built-in
-    } else {
-        typeItem->setForeground(QColor(0, 0, 150)); // Dark blue for user-defined
+    QModelIndex current = table->currentIndex();
+    if (!current.isValid()) {
+        return nullptr;
     }
-    table->setItem(row, ColumnType, typeItem);
-    
-    // Testable
-    QTableWidgetItem *testableItem = new QTableWidgetItem(service.testable ? "Yes" : "No");
-    testableItem->setFlags(testableItem->flags() & ~Qt::ItemIsEditable);
-    if (service.testable) {
-        testableItem->setIcon(QApplication::style()->standardIcon(QStyle::SP_DialogApplyButton));
-    }
-    table->setItem(row, ColumnTestable, testableItem);
-    
-    // Status
-    QTableWidgetItem *statusItem = new QTableWidgetItem("Not tested");
-    statusItem->setFlags(statusItem->flags() & ~Qt::ItemIsEditable);
-    table->setItem(row, ColumnTestStatus, statusItem);
+    return &serviceModel->serviceAt(proxyModel->mapToSource(current).row());
 }
 
 bool ServiceManagerWidget::canEditService(const services::Service &service)
@@ -1143,13 +1083,22 @@ void ServiceManagerWidget::refreshServices()
     loadServices();
 }
 
+void ServiceManagerWidget::watchStorage(StorageChangeFeed *feed)
+{
+    // The reload is diffed into the table, so our own saves change nothing
+    connect(feed, &StorageChangeFeed::servicesChanged, this, &ServiceManagerWidget::refreshServices);
+}
+
 void ServiceManagerWidget::selectService(const QString &serviceName)
 {
-    for (int row = 0; row < table->rowCount(); ++row) {
-        if (table->item(row, ColumnName)->text() == serviceName) {
-            table->selectRow(row);
-            break;
-        }
+    int row = serviceModel->rowOf(serviceName.toStdString());
+    if (row < 0) {
+        return;
+    }
+    QModelIndex index = proxyModel->mapFromSource(serviceModel->index(row, ServiceTableModel::ColumnName));
+    if (index.isValid()) {
+        table->selectRow(index.row());
+        table->scrollTo(index);
     }
 }
 
@@ -1178,18 +1127,12 @@ void ServiceManagerWidget::addService()
 
 void ServiceManagerWidget::editService()
 {
-    int row = table->currentRow();
-    if (row < 0 || row >= table->rowCount()) {
-        return;
-    }
-    
-    QString serviceName = table->item(row, ColumnName)->text();
-    auto it = allServices.find(serviceName.toStdString());
-    if (it == allServices.end()) {
+    const services::Service *selected = currentService();
+    if (!selected) {
         return;
     }
     
-    auto service = it->second;
+    auto service = *selected;
     if (!canEditService(service)) {
         showError("This service cannot be edited");
         return;
@@ -1219,18 +1162,13 @@ void ServiceManagerWidget::editService()
 
 void ServiceManagerWidget::deleteService()
 {
-    int row = table->currentRow();
-    if (row < 0 || row >= table->rowCount()) {
+    const services::Service *selected = currentService();
+    if (!selected) {
         return;
     }
     
-    QString serviceName = table->item(row, ColumnName)->text();
-    auto it = allServices.find(serviceName.toStdString());
-    if (it == allServices.end()) {
-        return;
-    }
-    
-    auto service = it->second;
+    auto service = *selected;
+    QString serviceName = QString::fromStdString(service.name);
     if (!canDeleteService(service)) {
         showError("Built-in services cannot be deleted");
         return;
@@ -1258,32 +1196,26 @@ void ServiceManagerWidget::deleteService()
 void ServiceManagerWidget::searchServices(const QString &text)
 {
     currentFilter = text;
-    updateTable();
+    proxyModel->setSearchText(currentFilter);
 }
 
 void ServiceManagerWidget::testSelectedService()
 {
-    int row = table->currentRow();
-    if (row < 0 || row >= table->rowCount()) {
-        return;
-    }
-    
-    QString serviceName = table->item(row, 0)->text();
-    auto it = allServices.find(serviceName.toStdString());
-    if (it == allServices.end()) {
+    const services::Service *selected = currentService();
+    if (!selected) {
         return;
     }
     
-    auto service = it->second;
+    auto service = *selected;
     if (!service.testable) {
         showError("This service is not configured for testing");
         return;
     }
     
-    // Use the existing serviceName variable
-    table->item(row, ColumnTestStatus)->setText("Testing...");
+    QString serviceName = QString::fromStdString(service.name);
+    serviceModel->setTestStatus(service.name, TestState::Testing, QString());
     
-    QTimer::singleShot(100, [this, serviceName, row]() {
+    QTimer::singleShot(100, [this, serviceName]() {
         try {
             auto result = services::test_one(config, serviceName.toStdString());
             updateTestStatus(serviceName, result.ok, QString::fromStdString(result.error_message));
@@ -1308,14 +1240,8 @@ void ServiceManagerWidget::testAllServices()
     }
     
     // Update status for all testable services
-    for (int row = 0; row < table->rowCount(); ++row) {
-        QString serviceName = table->item(row, ColumnName)->text();
-        for (const auto& testable : testableServices) {
-            if (serviceName.toStdString() == testable) {
-                table->item(row, ColumnTestStatus)->setText("Testing...");
-                break;
-            }
-        }
+    for (const auto& testable : testableServices) {
+        serviceModel->setTestStatus(testable, TestState::Testing, QString());
     }
     
     QTimer::singleShot(100, [this, testableServices]() {
@@ -1426,8 +1352,7 @@ void ServiceManagerWidget::importServices()
 
 void ServiceManagerWidget::showContextMenu(const QPoint &pos)
 {
-    QTableWidgetItem *item = table->itemAt(pos);
-    bool hasSelection = item != nullptr;
+    bool hasSelection = table->indexAt(pos).isValid();
     
     editAction->setEnabled(hasSelection);
     deleteAction->setEnabled(hasSelection);
@@ -1435,18 +1360,12 @@ void ServiceManagerWidget::showContextMenu(const QPoint &pos)
     copyNameAction->setEnabled(hasSelection);
     duplicateAction->setEnabled(hasSelection);
     
-    contextMenu->exec(table->mapToGlobal(pos));
-}
-
-void ServiceManagerWidget::onTableItemChanged(QTableWidgetItem *item)
-{
-    Q_UNUSED(item)
-    // Table items are read-only, so this shouldn't happen
+    contextMenu->exec(table->viewport()->mapToGlobal(pos));
 }
 
 void ServiceManagerWidget::onSelectionChanged()
 {
-    bool hasSelection = table->currentRow() >= 0;
+    bool hasSelection = currentService() != nullptr;
     editButton->setEnabled(hasSelection);
     deleteButton->setEnabled(hasSelection);
     testSelectedButton->setEnabled(hasSelection);
@@ -1454,19 +1373,7 @@ void ServiceManagerWidget::onSelectionChanged()
 
 void ServiceManagerWidget::updateTestStatus(const QString &serviceName, bool success, const QString &message)
 {
-    for (int row = 0; row < table->rowCount(); ++row) {
-        if (table->item(row, ColumnName)->text() == serviceName) {
-            QTableWidgetItem *statusItem = table->item(row, ColumnTestStatus);
-            if (success) {
-                statusItem->setText("✅ Success");
-                statusItem->setToolTip("Test passed");
-            } else {
-                statusItem->setText("❌ Failed");
-                statusItem->setToolTip(message.isEmpty() ? "Test failed" : message);
-            }
-            break;
-        }
-    }
+    serviceModel->setTestStatus(serviceName.toStdString(), success ? TestState::Passed : TestState::Failed, message);
 }
 
 bool ServiceManagerWidget::validateServiceName(const QString &name)
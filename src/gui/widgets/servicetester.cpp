@@ -136,6 +136,7 @@ QString ServiceListItem::getStatusText(TestStatus status) const
 ServiceTestWorker::ServiceTestWorker(const core::Config& config, QObject *parent)
     : QObject(parent), config(config), failFast(false)
 {
+    qRegisterMetaType<std::chrono::milliseconds>("std::chrono::milliseconds");
 }
 
 void ServiceTestWorker::setServices(const QStringList &services)
@@ -150,28 +151,45 @@ void ServiceTestWorker::setFailFast(bool failFast)
     this->failFast = failFast;
 }
 
+void ServiceTestWorker::cancel()
+{
+    ak::services::cancelTests(cancelRequested);
+}
+
 void ServiceTestWorker::testAllServices()
 {
     QMutexLocker locker(&mutex);
     QStringList services = servicesToTest;
+    ak::services::TestSchedule schedule;
+    schedule.failFast = failFast;
+    // Explicit runs always hit the network but keep the key table's cache current
+    schedule.useCache = true;
+    schedule.refreshCache = true;
     locker.unlock();
 
-    int current = 0;
-    int total = services.size();
+    cancelRequested = false;
+    schedule.cancel = &cancelRequested;
 
+    std::vector<ak::services::TestJob> jobs;
     for (const QString& serviceName : services) {
-        emit progress(current, total);
-        testService(serviceName);
-        current++;
-
-        // Check if we should fail fast
-        locker.relock();
-        if (failFast) {
-            // For now, we don't implement early termination logic
-        }
-        locker.unlock();
+        jobs.push_back({serviceName.toStdString(), std::string()});
     }
 
+    // Checks run in parallel on the scheduler's workers; the signals below
+    // are emitted from those threads and reach the widget queued
+    int total = services.size();
+    int current = 0;
+    emit progress(current, total);
+    ak::services::run_test_jobs(config, jobs, schedule,
+        [&](const ak::services::TestJob&, const ak::services::TestResult& result) {
+            emit serviceTestCompleted(QString::fromStdString(result.service), result.ok, result.duration,
+                                      QString::fromStdString(result.error_message));
+            emit progress(++current, total);
+        },
+        [&](const ak::services::TestJob& job) {
+            emit serviceTestStarted(QString::fromStdString(job.service));
+        });
+
     emit progress(total, total);
     emit allTestsCompleted();
 }
@@ -562,6 +580,9 @@ void ServiceTesterWidget::testSelectedService()
 void ServiceTesterWidget::stopTesting()
 {
     if (workerThread && workerThread->isRunning()) {
+        if (worker) {
+            worker->cancel();
+        }
         workerThread->requestInterruption();
         workerThread->quit();
         workerThread->wait(5000); // Wait up to 5 seconds
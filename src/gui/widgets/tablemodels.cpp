@@ -0,0 +1,486 @@
+#ifdef BUILD_GUI
+
+#include "gui/widgets/tablemodels.hpp"
+#include <QApplication>
+#include <QColor>
+#include <QIcon>
+#include <QStyle>
+#include <algorithm>
+
+namespace ak {
+namespace gui {
+namespace widgets {
+
+namespace {
+
+QVariant testStateColor(TestState state)
+{
+    switch (state) {
+    case TestState::Passed:
+        return QColor(0, 170, 0); // Green
+    case TestState::Failed:
+        return QColor(204, 68, 68); // Red
+    case TestState::Testing:
+        return QColor(102, 102, 102); // Gray for testing
+    default:
+        return QVariant();
+    }
+}
+
+} // namespace
+
+// KeyTableModel Implementation
+KeyTableModel::KeyTableModel(QObject *parent)
+    : QAbstractTableModel(parent)
+{
+}
+
+void KeyTableModel::setResolver(InfoResolver resolver)
+{
+    this->resolver = std::move(resolver);
+}
+
+KeyTableModel::Row KeyTableModel::makeRow(const std::string& name, const std::string& value) const
+{
+    Row row;
+    row.name = name;
+    row.value = value;
+    row.displayName = QString::fromStdString(name);
+    row.search = row.displayName.toLower();
+    return row;
+}
+
+void KeyTableModel::setKeys(const std::map<std::string, std::string>& keys)
+{
+    beginResetModel();
+    rows.clear();
+    rows.reserve(keys.size());
+    for (const auto& [name, value] : keys) {
+        rows.push_back(makeRow(name, value));
+    }
+    endResetModel();
+}
+
+void KeyTableModel::syncKeys(const std::map<std::string, std::string>& keys)
+{
+    for (int row = static_cast<int>(rows.size()) - 1; row >= 0; --row) {
+        if (keys.find(rows[row].name) == keys.end()) {
+            beginRemoveRows(QModelIndex(), row, row);
+            rows.erase(rows.begin() + row);
+            endRemoveRows();
+        }
+    }
+    for (const auto& [name, value] : keys) {
+        upsertKey(name, value);
+    }
+}
+
+void KeyTableModel::upsertKey(const std::string& name, const std::string& value)
+{
+    auto it = std::lower_bound(rows.begin(), rows.end(), name,
+                               [](const Row& row, const std::string& key) { return row.name < key; });
+    int row = static_cast<int>(it - rows.begin());
+    if (it != rows.end() && it->name == name) {
+        if (it->value == value) {
+            return;
+        }
+        it->value = value;
+        it->resolved = false; // a cached outcome belongs to the old value
+        emit dataChanged(index(row, 0), index(row, ColumnCount - 1));
+        return;
+    }
+    beginInsertRows(QModelIndex(), row, row);
+    rows.insert(it, makeRow(name, value));
+    endInsertRows();
+}
+
+void KeyTableModel::removeKey(const std::string& name)
+{
+    int row = rowOf(name);
+    if (row < 0) {
+        return;
+    }
+    beginRemoveRows(QModelIndex(), row, row);
+    rows.erase(rows.begin() + row);
+    endRemoveRows();
+}
+
+void KeyTableModel::setTestStatus(const std::string& name, TestState state, const QString& message)
+{
+    int row = rowOf(name);
+    if (row < 0) {
+        return;
+    }
+    info(row); // resolve first so the lookup doesn't overwrite this result
+    rows[row].info.state = state;
+    rows[row].info.status = message;
+    QModelIndex cell = index(row, ColumnTestStatus);
+    emit dataChanged(cell, cell);
+}
+
+void KeyTableModel::setMasked(bool masked)
+{
+    this->masked = masked;
+    for (auto& row : rows) {
+        row.toggled = false;
+    }
+    if (!rows.empty()) {
+        emit dataChanged(index(0, ColumnValue), index(static_cast<int>(rows.size()) - 1, ColumnValue));
+    }
+}
+
+void KeyTableModel::toggleRowMasked(int row)
+{
+    if (row < 0 || row >= static_cast<int>(rows.size())) {
+        return;
+    }
+    rows[row].toggled = !rows[row].toggled;
+    QModelIndex cell = index(row, ColumnValue);
+    emit dataChanged(cell, cell);
+}
+
+int KeyTableModel::rowOf(const std::string& name) const
+{
+    auto it = std::lower_bound(rows.begin(), rows.end(), name,
+                               [](const Row& row, const std::string& key) { return row.name < key; });
+    if (it == rows.end() || it->name != name) {
+        return -1;
+    }
+    return static_cast<int>(it - rows.begin());
+}
+
+QString KeyTableModel::maskValue(const std::string& value)
+{
+    QString actual = QString::fromStdString(value);
+    if (actual.length() > 8) {
+        return actual.left(4) + QString("*").repeated(actual.length() - 8) + actual.right(4);
+    }
+    return QString("*").repeated(actual.length());
+}
+
+const KeyTableModel::RowInfo& KeyTableModel::info(int row) const
+{
+    const Row& r = rows[row];
+    if (!r.resolved) {
+        r.info = resolver ? resolver(r.name, r.value) : RowInfo();
+        r.resolved = true;
+    }
+    return r.info;
+}
+
+int KeyTableModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : static_cast<int>(rows.size());
+}
+
+int KeyTableModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : ColumnCount;
+}
+
+QVariant KeyTableModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= static_cast<int>(rows.size())) {
+        return QVariant();
+    }
+    const Row& row = rows[index.row()];
+    bool rowMasked = masked != row.toggled;
+
+    switch (role) {
+    case SearchRole:
+        return row.search;
+    case ValueRole:
+        return QString::fromStdString(row.value);
+    case Qt::DisplayRole:
+        switch (index.column()) {
+        case ColumnName:
+            return row.displayName;
+        case ColumnService:
+            return info(index.row()).service;
+        case ColumnUrl: {
+            const QString& url = info(index.row()).url;
+            return url.isEmpty() ? QString("N/A") : url;
+        }
+        case ColumnValue:
+            // Masked text is built per paint and never stored
+            return rowMasked ? maskValue(row.value) : QString::fromStdString(row.value);
+        case ColumnTestStatus: {
+            const QString& status = info(index.row()).status;
+            return status.isEmpty() ? QString("Not tested") : status;
+        }
+        default:
+            return QVariant();
+        }
+    case Qt::ToolTipRole:
+        if (index.column() == ColumnUrl && !info(index.row()).url.isEmpty()) {
+            return "API Endpoint: " + info(index.row()).url;
+        }
+        if (index.column() == ColumnValue && rowMasked) {
+            return QString("Click the eye button to reveal value");
+        }
+        if (index.column() == ColumnActions) {
+            return QString("Click for actions");
+        }
+        return QVariant();
+    case Qt::DecorationRole:
+        if (index.column() == ColumnActions) {
+            return QIcon::fromTheme("application-menu", QIcon(":/icons/menu.svg"));
+        }
+        return QVariant();
+    case Qt::ForegroundRole:
+        if (index.column() == ColumnTestStatus) {
+            return testStateColor(info(index.row()).state);
+        }
+        return QVariant();
+    case Qt::TextAlignmentRole:
+        if (index.column() == ColumnTestStatus || index.column() == ColumnActions) {
+            return int(Qt::AlignCenter);
+        }
+        return QVariant();
+    default:
+        return QVariant();
+    }
+}
+
+QVariant KeyTableModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole) {
+        return QAbstractTableModel::headerData(section, orientation, role);
+    }
+    static const QStringList headers = {"Key Name", "Service", "API URL", "Value", "Test Status", "Actions"};
+    return section >= 0 && section < headers.size() ? headers[section] : QVariant();
+}
+
+// ServiceTableModel Implementation
+ServiceTableModel::ServiceTableModel(QObject *parent)
+    : QAbstractTableModel(parent)
+{
+}
+
+ServiceTableModel::Row ServiceTableModel::makeRow(const services::Service& service)
+{
+    Row row;
+    row.service = service;
+    row.search = QString::fromStdString(service.name + "\n" + service.keyName + "\n" + service.description).toLower();
+    return row;
+}
+
+void ServiceTableModel::setServices(const std::map<std::string, services::Service>& services)
+{
+    beginResetModel();
+    rows.clear();
+    rows.reserve(services.size());
+    for (const auto& [name, service] : services) {
+        rows.push_back(makeRow(service));
+    }
+    endResetModel();
+}
+
+void ServiceTableModel::syncServices(const std::map<std::string, services::Service>& services)
+{
+    for (int row = static_cast<int>(rows.size()) - 1; row >= 0; --row) {
+        if (services.find(rows[row].service.name) == services.end()) {
+            beginRemoveRows(QModelIndex(), row, row);
+            rows.erase(rows.begin() + row);
+            endRemoveRows();
+        }
+    }
+    for (const auto& [name, service] : services) {
+        upsertService(service);
+    }
+}
+
+void ServiceTableModel::upsertService(const services::Service& service)
+{
+    auto it = std::lower_bound(rows.begin(), rows.end(), service.name,
+                               [](const Row& row, const std::string& key) { return row.service.name < key; });
+    int row = static_cast<int>(it - rows.begin());
+    if (it != rows.end() && it->service.name == service.name) {
+        TestState state = it->state;
+        QString message = it->message;
+        *it = makeRow(service);
+        it->state = state;
+        it->message = message;
+        emit dataChanged(index(row, 0), index(row, ColumnCount - 1));
+        return;
+    }
+    beginInsertRows(QModelIndex(), row, row);
+    rows.insert(it, makeRow(service));
+    endInsertRows();
+}
+
+void ServiceTableModel::removeService(const std::string& name)
+{
+    int row = rowOf(name);
+    if (row < 0) {
+        return;
+    }
+    beginRemoveRows(QModelIndex(), row, row);
+    rows.erase(rows.begin() + row);
+    endRemoveRows();
+}
+
+void ServiceTableModel::setTestStatus(const std::string& name, TestState state, const QString& message)
+{
+    int row = rowOf(name);
+    if (row < 0) {
+        return;
+    }
+    rows[row].state = state;
+    rows[row].message = message;
+    QModelIndex cell = index(row, ColumnTestStatus);
+    emit dataChanged(cell, cell);
+}
+
+int ServiceTableModel::rowOf(const std::string& name) const
+{
+    auto it = std::lower_bound(rows.begin(), rows.end(), name,
+                               [](const Row& row, const std::string& key) { return row.service.name < key; });
+    if (it == rows.end() || it->service.name != name) {
+        return -1;
+    }
+    return static_cast<int>(it - rows.begin());
+}
+
+int ServiceTableModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : static_cast<int>(rows.size());
+}
+
+int ServiceTableModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : ColumnCount;
+}
+
+QVariant ServiceTableModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= static_cast<int>(rows.size())) {
+        return QVariant();
+    }
+    const Row& row = rows[index.row()];
+    const services::Service& service = row.service;
+
+    switch (role) {
+    case SearchRole:
+        return row.search;
+    case Qt::DisplayRole:
+        switch (index.column()) {
+        case ColumnName:
+            return QString::fromStdString(service.name);
+        case ColumnKeyName:
+            return QString::fromStdString(service.keyName);
+        case ColumnDescription: {
+            QString desc = QString::fromStdString(service.description);
+            if (desc.length() > 50) {
+                desc = desc.left(47) + "...";
+            }
+            return desc;
+        }
+        case ColumnType:
+            return QString(service.isBuiltIn ? "Built-in" : "User");
+        case ColumnTestable:
+            return QString(service.testable ? "Yes" : "No");
+        case ColumnTestStatus:
+            switch (row.state) {
+            case TestState::Passed:
+                return QString("✅ Success");
+            case TestState::Failed:
+                return QString("❌ Failed");
+            case TestState::Testing:
+                return QString("Testing...");
+            default:
+                return QString("Not tested");
+            }
+        default:
+            return QVariant();
+        }
+    case Qt::ToolTipRole:
+        if (index.column() == ColumnDescription) {
+            return QString::fromStdString(service.description);
+        }
+        if (index.column() == ColumnTestStatus && row.state == TestState::Passed) {
+            return QString("Test passed");
+        }
+        if (index.column() == ColumnTestStatus && row.state == TestState::Failed) {
+            return row.message.isEmpty() ? QString("Test failed") : row.message;
+        }
+        return QVariant();
+    case Qt::DecorationRole:
+        if (index.column() == ColumnName) {
+            return QApplication::style()->standardIcon(service.isBuiltIn ? QStyle::SP_ComputerIcon : QStyle::SP_FileIcon);
+        }
+        if (index.column() == ColumnTestable && service.testable) {
+            return QApplication::style()->standardIcon(QStyle::SP_DialogApplyButton);
+        }
+        return QVariant();
+    case Qt::ForegroundRole:
+        if (index.column() == ColumnType) {
+            // Dark green for built-in, dark blue for user-defined
+            return service.isBuiltIn ? QColor(0, 100, 0) : QColor(0, 0, 150);
+        }
+        return QVariant();
+    default:
+        return QVariant();
+    }
+}
+
+QVariant ServiceTableModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole) {
+        return QAbstractTableModel::headerData(section, orientation, role);
+    }
+    static const QStringList headers = {"Name", "Key Name", "Description", "Type", "Testable", "Status"};
+    return section >= 0 && section < headers.size() ? headers[section] : QVariant();
+}
+
+// SearchFilterProxyModel Implementation
+SearchFilterProxyModel::SearchFilterProxyModel(QObject *parent)
+    : QSortFilterProxyModel(parent)
+{
+    setDynamicSortFilter(true);
+}
+
+void SearchFilterProxyModel::setSearchText(const QString &text)
+{
+    QString lowered = text.trimmed().toLower();
+    if (lowered == needle) {
+        return;
+    }
+    needle = lowered;
+    // Re-runs filterAcceptsRow only; rows are neither rebuilt nor re-sorted
+    invalidateRowsFilter();
+}
+
+void SearchFilterProxyModel::setAcceptedNames(const QSet<QString> &lowered)
+{
+    byNames = true;
+    accepted = lowered;
+    invalidateRowsFilter();
+}
+
+void SearchFilterProxyModel::clearAcceptedNames()
+{
+    if (!byNames && needle.isEmpty()) {
+        return;
+    }
+    byNames = false;
+    accepted.clear();
+    needle.clear();
+    invalidateRowsFilter();
+}
+
+bool SearchFilterProxyModel::filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const
+{
+    if (!byNames && needle.isEmpty()) {
+        return true;
+    }
+    QModelIndex index = sourceModel()->index(sourceRow, 0, sourceParent);
+    QString search = index.data(SearchRole).toString();
+    return byNames ? accepted.contains(search) : search.contains(needle);
+}
+
+} // namespace widgets
+} // namespace gui
+} // namespace ak
+
+#endif // BUILD_GUI
@@ -0,0 +1,438 @@
+#include "http/http.hpp"
+#include "core/config.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+
+#ifdef AK_HAVE_LIBCURL
+#include <curl/curl.h>
+#endif
+
+namespace ak {
+namespace http {
+
+namespace {
+
+long envMillis(const char* name, long fallback) {
+    const char* value = std::getenv(name);
+    if (!value || !*value) {
+        return fallback;
+    }
+    char* end = nullptr;
+    double seconds = std::strtod(value, &end);
+    if (end == value || seconds <= 0) {
+        return fallback;
+    }
+    return static_cast<long>(seconds * 1000.0);
+}
+
+std::string shellQuote(const std::string& value) {
+    std::string quoted = "'";
+    for (char c : value) {
+        if (c == '\'') {
+            quoted += "'\\''";
+        } else {
+            quoted += c;
+        }
+    }
+    return quoted + "'";
+}
+
+// Split like a POSIX shell would: whitespace separated, '...' literal,
+// "..." with backslash escapes, adjacent pieces joined.
+std::vector<std::string> shellSplit(const std::string& input) {
+    std::vector<std::string> words;
+    std::string current;
+    bool inWord = false;
+    for (size_t i = 0; i < input.size(); ++i) {
+        char c = input[i];
+        if (c == '\'') {
+            inWord = true;
+            size_t end = input.find('\'', i + 1);
+            if (end == std::string::npos) {
+                end = input.size();
+            }
+            current.append(input, i + 1, end - i - 1);
+            i = end;
+        } else if (c == '"') {
+            inWord = true;
+            for (++i; i < input.size() && input[i] != '"'; ++i) {
+                if (input[i] == '\\' && i + 1 < input.size() &&
+                    std::strchr("\"\\$`", input[i + 1])) {
+                    ++i;
+                }
+                current += input[i];
+            }
+        } else if (c == '\\' && i + 1 < input.size()) {
+            inWord = true;
+            current += input[++i];
+        } else if (std::isspace(static_cast<unsigned char>(c))) {
+            if (inWord) {
+                words.push_back(current);
+                current.clear();
+                inWord = false;
+            }
+        } else {
+            inWord = true;
+            current += c;
+        }
+    }
+    if (inWord) {
+        words.push_back(current);
+    }
+    return words;
+}
+
+#ifdef AK_HAVE_LIBCURL
+
+struct Transfer {
+    const Request* request = nullptr;
+    Timeouts timeouts;
+    const std::atomic<bool>* cancel = nullptr;
+    std::promise<Response> done;
+    CURL* easy = nullptr;
+    curl_slist* headers = nullptr;
+    std::string received;
+    std::vector<std::string> receivedHeaders;
+    char error[CURL_ERROR_SIZE] = {0};
+};
+
+size_t collect(char* data, size_t size, size_t count, void* userdata) {
+    auto* transfer = static_cast<Transfer*>(userdata);
+    size_t bytes = size * count;
+    size_t limit = transfer->request->maxBody;
+    if (transfer->received.size() < limit) {
+        transfer->received.append(data, std::min(bytes, limit - transfer->received.size()));
+    }
+    return bytes;
+}
+
+// One call per header line; a status line starts the headers of a new
+// response (after a redirect or 100 Continue)
+size_t collectHeader(char* data, size_t size, size_t count, void* userdata) {
+    auto* transfer = static_cast<Transfer*>(userdata);
+    size_t bytes = size * count;
+    std::string line(data, bytes);
+    while (!line.empty() && (line.back() == '\n' || line.back() == '\r')) {
+        line.pop_back();
+    }
+    if (line.compare(0, 5, "HTTP/") == 0) {
+        transfer->receivedHeaders.clear();
+    } else if (!line.empty()) {
+        transfer->receivedHeaders.push_back(std::move(line));
+    }
+    return bytes;
+}
+
+// One multi handle for the whole process. Callers queue transfers and block
+// on a future; the worker thread owns every easy handle and the pool.
+class Engine {
+public:
+    static Engine& instance() {
+        static Engine engine;
+        return engine;
+    }
+
+    Response perform(const Request& request, const Timeouts& timeouts, const std::atomic<bool>* cancel) {
+        Transfer transfer;
+        transfer.request = &request;
+        transfer.timeouts = timeouts;
+        transfer.cancel = cancel;
+        auto result = transfer.done.get_future();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (stopping_) {
+                return failure(CURLE_FAILED_INIT, "HTTP engine is shutting down");
+            }
+            pending_.push_back(&transfer);
+        }
+        curl_multi_wakeup(multi_);
+        return result.get();
+    }
+
+    void interrupt() {
+        curl_multi_wakeup(multi_);
+    }
+
+    Engine(const Engine&) = delete;
+    Engine& operator=(const Engine&) = delete;
+
+private:
+    Engine() {
+        curl_global_init(CURL_GLOBAL_DEFAULT);
+        multi_ = curl_multi_init();
+        curl_multi_setopt(multi_, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+        curl_multi_setopt(multi_, CURLMOPT_MAX_HOST_CONNECTIONS, 8L);
+        curl_multi_setopt(multi_, CURLMOPT_MAXCONNECTS, 64L);
+        worker_ = std::thread([this]() { run(); });
+    }
+
+    ~Engine() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        curl_multi_wakeup(multi_);
+        if (worker_.joinable()) {
+            worker_.join();
+        }
+        for (CURL* easy : idle_) {
+            curl_easy_cleanup(easy);
+        }
+        curl_multi_cleanup(multi_);
+    }
+
+    static Response failure(int code, const std::string& message) {
+        Response response;
+        response.curlCode = code;
+        response.error = message;
+        return response;
+    }
+
+    static bool cancelled(const Transfer* t) {
+        return t->cancel && t->cancel->load();
+    }
+
+    void start(Transfer* t) {
+        const Request& req = *t->request;
+        if (cancelled(t)) {
+            t->done.set_value(failure(CURLE_ABORTED_BY_CALLBACK, "Cancelled"));
+            return;
+        }
+        if (idle_.empty()) {
+            t->easy = curl_easy_init();
+        } else {
+            t->easy = idle_.back();
+            idle_.pop_back();
+        }
+        if (!t->easy) {
+            t->done.set_value(failure(CURLE_FAILED_INIT, "Failed to create HTTP handle"));
+            return;
+        }
+
+        CURL* e = t->easy;
+        curl_easy_setopt(e, CURLOPT_URL, req.url.c_str());
+        curl_easy_setopt(e, CURLOPT_PRIVATE, t);
+        curl_easy_setopt(e, CURLOPT_WRITEFUNCTION, collect);
+        curl_easy_setopt(e, CURLOPT_WRITEDATA, t);
+        curl_easy_setopt(e, CURLOPT_HEADERFUNCTION, collectHeader);
+        curl_easy_setopt(e, CURLOPT_HEADERDATA, t);
+        curl_easy_setopt(e, CURLOPT_ERRORBUFFER, t->error);
+        curl_easy_setopt(e, CURLOPT_NOSIGNAL, 1L);
+        curl_easy_setopt(e, CURLOPT_CONNECTTIMEOUT_MS, t->timeouts.connectMs);
+        curl_easy_setopt(e, CURLOPT_TIMEOUT_MS, t->timeouts.totalMs);
+        curl_easy_setopt(e, CURLOPT_HTTP_VERSION, static_cast<long>(CURL_HTTP_VERSION_2TLS));
+        // Wait for an existing connection to the host so parallel checks
+        // share one HTTP/2 connection instead of racing to open several.
+        // Only over TLS, where ALPN settles this right after the handshake;
+        // on plain HTTP it would queue behind the first response.
+        if (req.url.compare(0, 8, "https://") == 0) {
+            curl_easy_setopt(e, CURLOPT_PIPEWAIT, 1L);
+        }
+        curl_easy_setopt(e, CURLOPT_USERAGENT, ("ak/" + core::AK_VERSION).c_str());
+
+        for (const auto& header : req.headers) {
+            t->headers = curl_slist_append(t->headers, header.c_str());
+        }
+        if (t->headers) {
+            curl_easy_setopt(e, CURLOPT_HTTPHEADER, t->headers);
+        }
+
+        if (req.method == "HEAD") {
+            curl_easy_setopt(e, CURLOPT_NOBODY, 1L);
+        } else {
+            if (!req.body.empty()) {
+                curl_easy_setopt(e, CURLOPT_POSTFIELDS, req.body.data());
+                curl_easy_setopt(e, CURLOPT_POSTFIELDSIZE_LARGE, static_cast<curl_off_t>(req.body.size()));
+            }
+            if (req.method != "GET" && !(req.method == "POST" && !req.body.empty())) {
+                curl_easy_setopt(e, CURLOPT_CUSTOMREQUEST, req.method.c_str());
+            }
+        }
+
+        active_.insert(t);
+        curl_multi_add_handle(multi_, e);
+    }
+
+    void finish(Transfer* t, CURLcode code) {
+        Response response;
+        response.curlCode = static_cast<int>(code);
+        long status = 0;
+        curl_easy_getinfo(t->easy, CURLINFO_RESPONSE_CODE, &status);
+        response.status = static_cast<int>(status);
+        response.body.swap(t->received);
+        response.headers.swap(t->receivedHeaders);
+        if (code == CURLE_ABORTED_BY_CALLBACK && cancelled(t)) {
+            response.error = "Cancelled";
+        } else if (code != CURLE_OK) {
+            response.error = t->error[0] ? t->error : curl_easy_strerror(code);
+        }
+
+        curl_multi_remove_handle(multi_, t->easy);
+        curl_slist_free_all(t->headers);
+        curl_easy_reset(t->easy);
+        idle_.push_back(t->easy);
+        active_.erase(t);
+        t->done.set_value(std::move(response));
+    }
+
+    void run() {
+        for (;;) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (stopping_) {
+                    break;
+                }
+                for (Transfer* t : pending_) {
+                    start(t);
+                }
+                pending_.clear();
+            }
+
+            int running = 0;
+            curl_multi_perform(multi_, &running);
+            int queued = 0;
+            while (CURLMsg* msg = curl_multi_info_read(multi_, &queued)) {
+                if (msg->msg != CURLMSG_DONE) {
+                    continue;
+                }
+                Transfer* t = nullptr;
+                curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, &t);
+                finish(t, msg->data.result);
+            }
+            std::vector<Transfer*> aborted;
+            for (Transfer* t : active_) {
+                if (cancelled(t)) {
+                    aborted.push_back(t);
+                }
+            }
+            for (Transfer* t : aborted) {
+                finish(t, CURLE_ABORTED_BY_CALLBACK);
+            }
+            // libcurl shortens the wait to its own timers; wakeups cover new work
+            curl_multi_poll(multi_, nullptr, 0, 10000, nullptr);
+        }
+
+        // Exiting the process: fail whatever is still queued or in flight
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (Transfer* t : pending_) {
+            t->done.set_value(failure(CURLE_ABORTED_BY_CALLBACK, "HTTP engine is shutting down"));
+        }
+        pending_.clear();
+        for (Transfer* t : std::unordered_set<Transfer*>(active_)) {
+            finish(t, CURLE_ABORTED_BY_CALLBACK);
+        }
+    }
+
+    CURLM* multi_ = nullptr;
+    std::thread worker_;
+    std::mutex mutex_;
+    std::vector<Transfer*> pending_;
+    bool stopping_ = false;
+    // Worker thread only
+    std::unordered_set<Transfer*> active_;
+    std::vector<CURL*> idle_;
+};
+
+#endif
+
+} // namespace
+
+bool available() {
+#ifdef AK_HAVE_LIBCURL
+    const char* engine = std::getenv("AK_HTTP_ENGINE");
+    return !(engine && std::strcmp(engine, "cli") == 0);
+#else
+    return false;
+#endif
+}
+
+Timeouts defaultTimeouts() {
+    Timeouts timeouts;
+    timeouts.connectMs = envMillis("AK_HTTP_CONNECT_TIMEOUT", timeouts.connectMs);
+    timeouts.totalMs = envMillis("AK_HTTP_TIMEOUT", timeouts.totalMs);
+    return timeouts;
+}
+
+Response perform(const Request& request, const Timeouts& timeouts, const std::atomic<bool>* cancel) {
+#ifdef AK_HAVE_LIBCURL
+    return Engine::instance().perform(request, timeouts, cancel);
+#else
+    (void)request;
+    (void)timeouts;
+    (void)cancel;
+    Response response;
+    response.curlCode = 2; // CURLE_FAILED_INIT
+    response.error = "Built without libcurl";
+    return response;
+#endif
+}
+
+void interrupt() {
+#ifdef AK_HAVE_LIBCURL
+    Engine::instance().interrupt();
+#endif
+}
+
+std::string header(const Response& response, const std::string& name) {
+    for (const auto& line : response.headers) {
+        size_t colon = line.find(':');
+        if (colon != name.size()) {
+            continue;
+        }
+        bool same = std::equal(name.begin(), name.end(), line.begin(), [](char a, char b) {
+            return std::tolower(static_cast<unsigned char>(a)) == std::tolower(static_cast<unsigned char>(b));
+        });
+        if (same) {
+            size_t start = line.find_first_not_of(" \t", colon + 1);
+            return start == std::string::npos ? "" : line.substr(start);
+        }
+    }
+    return "";
+}
+
+std::vector<std::string> parseHeaderArgs(const std::string& args) {
+    std::vector<std::string> headers;
+    auto words = shellSplit(args);
+    for (size_t i = 0; i < words.size(); ++i) {
+        const std::string& word = words[i];
+        if ((word == "-H" || word == "--header") && i + 1 < words.size()) {
+            headers.push_back(words[++i]);
+        } else if (word.size() > 2 && word.compare(0, 2, "-H") == 0) {
+            headers.push_back(word.substr(2));
+        } else if (word.compare(0, 9, "--header=") == 0) {
+            headers.push_back(word.substr(9));
+        }
+    }
+    return headers;
+}
+
+std::string toCurlArgs(const Request& request) {
+    std::string args = "-X " + request.method;
+    for (const auto& header : request.headers) {
+        args += " -H " + shellQuote(header);
+    }
+    if (!request.body.empty()) {
+        args += " --data-binary " + shellQuote(request.body);
+    }
+    return args + " " + shellQuote(request.url);
+}
+
+std::string formatSeconds(long ms) {
+    if (ms % 1000 == 0) {
+        return std::to_string(ms / 1000);
+    }
+    std::string fraction = std::to_string(1000 + ms % 1000).substr(1);
+    while (!fraction.empty() && fraction.back() == '0') {
+        fraction.pop_back();
+    }
+    return std::to_string(ms / 1000) + "." + fraction;
+}
+
+} // namespace http
+} // namespace ak
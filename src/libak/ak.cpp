@@ -0,0 +1,394 @@
+#include "libak/ak.h"
+
+#include "core/config.hpp"
+#include "crypto/crypto.hpp"
+#include "storage/blob_store.hpp"
+#include "storage/key_table.hpp"
+#include "storage/vault.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <future>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <vector>
+
+using ak::storage::KeyTable;
+
+namespace {
+
+// An unlocked profile. The table's arena is zeroed when whoever holds the
+// last reference (the handle or an iterator) drops it.
+using TablePtr = std::shared_ptr<const KeyTable>;
+
+struct Unlocked {
+    ak_status status = AK_OK;
+    TablePtr table;
+};
+
+bool validProfileName(const char* profile) {
+    std::string name(profile);
+    return !name.empty() && name != "." && name != ".." && name.find('/') == std::string::npos &&
+           name.find('\\') == std::string::npos;
+}
+
+// Values are handed out with their size in front, so ak_free_secret can zero
+// them without being told the length
+char* copySecret(std::string_view value) {
+    auto* block = static_cast<char*>(std::malloc(sizeof(size_t) + value.size() + 1));
+    if (!block) {
+        return nullptr;
+    }
+    size_t size = value.size() + 1;
+    std::memcpy(block, &size, sizeof(size));
+    char* out = block + sizeof(size_t);
+    std::memcpy(out, value.data(), value.size());
+    out[value.size()] = '\0';
+    return out;
+}
+
+// The value as callers see it: a blob reference (a large value stored out
+// of line) is read into `blob` and `value` points there. Never prompts; a
+// sealed blob needs the preset passphrase.
+ak_status resolveValue(const ak::core::Config& cfg, std::string_view stored, std::string& blob,
+                       std::string_view& value) {
+    value = stored;
+    ak::storage::BlobRef ref;
+    if (!ak::storage::parseBlobRef(stored, ref)) {
+        return AK_OK;
+    }
+    bool sealed = ak::storage::activeBackend(cfg) != ak::storage::Backend::Plain;
+    if (sealed && cfg.presetPassphrase.empty()) {
+        return AK_ERR_LOCKED;
+    }
+    if (!ak::storage::BlobStore(cfg, sealed ? cfg.presetPassphrase : "").read(ref, blob)) {
+        return AK_ERR_DECRYPT;
+    }
+    value = blob;
+    return AK_OK;
+}
+
+void wipe(std::string& value) {
+    ak::crypto::secureZero(&value[0], value.size());
+    value.clear();
+}
+
+} // namespace
+
+struct ak_vault {
+    ak::core::Config cfg;
+    std::mutex mutex;
+    // Concurrent first lookups of a profile share one decryption
+    std::map<std::string, std::shared_future<Unlocked>> profiles;
+
+    Unlocked unlock(const std::string& profile) {
+        std::promise<Unlocked> promise;
+        std::shared_future<Unlocked> pending;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = profiles.find(profile);
+            if (it != profiles.end()) {
+                pending = it->second;
+            } else {
+                profiles[profile] = promise.get_future().share();
+            }
+        }
+        if (pending.valid()) {
+            return pending.get();
+        }
+
+        Unlocked result;
+        try {
+            KeyTable table;
+            if (ak::storage::tryLoadProfileKeyTable(cfg, profile, table)) {
+                std::vector<std::string> names;
+                names.reserve(table.size());
+                for (const auto& entry : table.entries()) {
+                    names.emplace_back(entry.name);
+                }
+                ak::core::auditLog(cfg, "unlock", names);
+                result.table = std::make_shared<const KeyTable>(std::move(table));
+            } else {
+                result.status = cfg.presetPassphrase.empty() ? AK_ERR_LOCKED : AK_ERR_DECRYPT;
+            }
+        } catch (const std::bad_alloc&) {
+            result.status = AK_ERR_NO_MEMORY;
+        } catch (...) {
+            result.status = AK_ERR_INTERNAL;
+        }
+        promise.set_value(result);
+        // Failures are not remembered; the next call tries again (a passphrase
+        // agent may have come up, a damaged file may have been restored)
+        if (result.status != AK_OK) {
+            std::lock_guard<std::mutex> lock(mutex);
+            profiles.erase(profile);
+        }
+        return result;
+    }
+};
+
+struct ak_iter {
+    TablePtr table;
+    ak::core::Config cfg; // a copy: the iterator may outlive the handle
+    size_t next = 0;
+    std::list<std::string> blobs; // values handed out for blob references
+
+    ~ak_iter() {
+        for (auto& blob : blobs) {
+            wipe(blob);
+        }
+        wipe(cfg.presetPassphrase);
+    }
+};
+
+namespace {
+
+ak_status unlockProfile(ak_vault* vault, const char* profile, TablePtr& table) {
+    if (!vault) {
+        return AK_ERR_INVALID;
+    }
+    if (!profile) {
+        profile = "default";
+    }
+    if (!validProfileName(profile)) {
+        return AK_ERR_INVALID;
+    }
+    Unlocked unlocked = vault->unlock(profile);
+    table = std::move(unlocked.table);
+    return unlocked.status;
+}
+
+} // namespace
+
+extern "C" {
+
+const char* ak_version(void) {
+    return ak::core::AK_VERSION.c_str();
+}
+
+const char* ak_strerror(ak_status status) {
+    switch (status) {
+        case AK_OK: return "success";
+        case AK_ERR_INVALID: return "invalid argument";
+        case AK_ERR_NOT_FOUND: return "key not found";
+        case AK_ERR_LOCKED: return "profile is encrypted and no passphrase is available";
+        case AK_ERR_DECRYPT: return "profile could not be decrypted";
+        case AK_ERR_NO_MEMORY: return "out of memory";
+        case AK_ERR_INTERNAL: return "internal error";
+    }
+    return "unknown status";
+}
+
+ak_status ak_open(const ak_options* options, ak_vault** vault) {
+    if (!vault) {
+        return AK_ERR_INVALID;
+    }
+    *vault = nullptr;
+    try {
+        auto handle = std::make_unique<ak_vault>();
+        handle->cfg = ak::storage::loadConfig(options && options->config_dir ? options->config_dir : "");
+        if (options && options->passphrase) {
+            handle->cfg.presetPassphrase = options->passphrase;
+        }
+        if (options && options->backend) {
+            handle->cfg.backend = options->backend;
+            ak::core::Config resolved = handle->cfg;
+            handle->cfg.vaultPath = ak::core::Lazy<std::string>::deferred([resolved] {
+                return ak::storage::vaultPathFor(resolved, ak::storage::activeBackend(resolved));
+            });
+        }
+        *vault = handle.release();
+        return AK_OK;
+    } catch (const std::bad_alloc&) {
+        return AK_ERR_NO_MEMORY;
+    } catch (...) {
+        return AK_ERR_INTERNAL;
+    }
+}
+
+void ak_close(ak_vault* vault) {
+    if (!vault) {
+        return;
+    }
+    if (!vault->cfg.presetPassphrase.empty()) {
+        ak::crypto::secureZero(&vault->cfg.presetPassphrase[0], vault->cfg.presetPassphrase.size());
+    }
+    delete vault;
+}
+
+ak_status ak_reload(ak_vault* vault, const char* profile) {
+    if (!vault) {
+        return AK_ERR_INVALID;
+    }
+    std::lock_guard<std::mutex> lock(vault->mutex);
+    if (profile) {
+        vault->profiles.erase(profile);
+    } else {
+        vault->profiles.clear();
+    }
+    return AK_OK;
+}
+
+ak_status ak_get(ak_vault* vault, const char* profile, const char* name, char** value, size_t* length) {
+    if (!name || !value) {
+        return AK_ERR_INVALID;
+    }
+    *value = nullptr;
+    TablePtr table;
+    ak_status status = unlockProfile(vault, profile, table);
+    if (status != AK_OK) {
+        return status;
+    }
+    const KeyTable::Entry* entry = table->find(name);
+    if (!entry) {
+        return AK_ERR_NOT_FOUND;
+    }
+    std::string blob;
+    std::string_view resolved;
+    status = resolveValue(vault->cfg, entry->value, blob, resolved);
+    if (status != AK_OK) {
+        return status;
+    }
+    *value = copySecret(resolved);
+    wipe(blob);
+    if (!*value) {
+        return AK_ERR_NO_MEMORY;
+    }
+    if (length) {
+        *length = resolved.size();
+    }
+    return AK_OK;
+}
+
+ak_status ak_get_many(ak_vault* vault, const char* profile, const char* const* names, size_t count, char** values,
+                      size_t* lengths) {
+    if (count && (!names || !values)) {
+        return AK_ERR_INVALID;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        values[i] = nullptr;
+        if (lengths) {
+            lengths[i] = 0;
+        }
+        if (!names[i]) {
+            return AK_ERR_INVALID;
+        }
+    }
+    TablePtr table;
+    ak_status status = unlockProfile(vault, profile, table);
+    if (status != AK_OK) {
+        return status;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        const KeyTable::Entry* entry = table->find(names[i]);
+        if (!entry) {
+            continue;
+        }
+        std::string blob;
+        std::string_view resolved;
+        status = resolveValue(vault->cfg, entry->value, blob, resolved);
+        if (status == AK_OK) {
+            values[i] = copySecret(resolved);
+            status = values[i] ? AK_OK : AK_ERR_NO_MEMORY;
+        }
+        wipe(blob);
+        if (status != AK_OK) {
+            for (size_t j = 0; j < i; ++j) {
+                ak_free_secret(values[j]);
+                values[j] = nullptr;
+                if (lengths) {
+                    lengths[j] = 0;
+                }
+            }
+            return status;
+        }
+        if (lengths) {
+            lengths[i] = resolved.size();
+        }
+    }
+    return AK_OK;
+}
+
+void ak_free_secret(char* value) {
+    if (!value) {
+        return;
+    }
+    char* block = value - sizeof(size_t);
+    size_t size;
+    std::memcpy(&size, block, sizeof(size));
+    ak::crypto::secureZero(value, size);
+    std::free(block);
+}
+
+ak_status ak_iter_open(ak_vault* vault, const char* profile, ak_iter** iter) {
+    if (!iter) {
+        return AK_ERR_INVALID;
+    }
+    *iter = nullptr;
+    TablePtr table;
+    ak_status status = unlockProfile(vault, profile, table);
+    if (status != AK_OK) {
+        return status;
+    }
+    *iter = new (std::nothrow) ak_iter;
+    if (!*iter) {
+        return AK_ERR_NO_MEMORY;
+    }
+    (*iter)->table = std::move(table);
+    (*iter)->cfg = vault->cfg;
+    return AK_OK;
+}
+
+int ak_iter_next(ak_iter* iter, const char** name, size_t* name_length, const char** value, size_t* value_length) {
+    if (!iter) {
+        return 0;
+    }
+    const KeyTable::Entry* found = nullptr;
+    std::string_view resolved;
+    while (!found && iter->next < iter->table->size()) {
+        const KeyTable::Entry& entry = iter->table->entries()[iter->next++];
+        std::string blob;
+        if (resolveValue(iter->cfg, entry.value, blob, resolved) != AK_OK) {
+            wipe(blob);
+            continue; // an unreadable blob is skipped, as `ak load` does
+        }
+        found = &entry;
+        if (resolved.data() == blob.data()) {
+            iter->blobs.push_back(std::move(blob));
+            resolved = iter->blobs.back();
+        }
+    }
+    if (!found) {
+        return 0;
+    }
+    const KeyTable::Entry& entry = *found;
+    if (name) {
+        *name = entry.name.data();
+    }
+    if (name_length) {
+        *name_length = entry.name.size();
+    }
+    if (value) {
+        *value = resolved.data();
+    }
+    if (value_length) {
+        *value_length = resolved.size();
+    }
+    return 1;
+}
+
+void ak_iter_close(ak_iter* iter) {
+    delete iter;
+}
+
+void ak_zeroize(void* data, size_t length) {
+    if (data) {
+        ak::crypto::secureZero(data, length);
+    }
+}
+
+} // extern "C"
@@ -1,59 +1,163 @@
 #include "core/config.hpp"
+#include "core/metrics.hpp"
 #include "commands/commands.hpp"
 #include "storage/vault.hpp"
 #include "system/system.hpp"
 #include "cli/cli.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
 #include <iostream>
-#include <vector>
+#include <iterator>
 #include <string>
-#include <map>
-#include <functional>
+#include <string_view>
+#include <utility>
+#include <vector>
 
 using namespace ak;
 
-int main(int argc, char** argv) {
-    // Initialize configuration
-    core::Config cfg;
-    std::string base = core::getenvs("XDG_CONFIG_HOME", core::getenvs("HOME") + "/.config");
-    cfg.configDir = base + "/ak";
-    cfg.profilesDir = cfg.configDir + "/profiles";
-    cfg.gpgAvailable = core::commandExists("gpg");
-    
-    if (getenv("AK_DISABLE_GPG")) {
-        cfg.forcePlain = true;
-    }
-    if (getenv("AK_PASSPHRASE")) {
-        cfg.presetPassphrase = core::getenvs("AK_PASSPHRASE");
+namespace {
+
+struct CommandEntry {
+    std::string_view name;
+    commands::CommandHandler handler;
+    bool needsDefaultProfile; // false for help/version and the shell-hook paths
+};
+
+// Sorted by name (checked below) for a binary search; no allocation at startup
+constexpr CommandEntry COMMANDS[] = {
+    {"--help", commands::cmd_help, false},
+    {"--version", commands::cmd_version, false},
+    {"-h", commands::cmd_help, false},
+    {"-v", commands::cmd_version, false},
+
+    // Internal commands for shell integration auto-loading and completion
+    {"__complete", commands::cmd_complete, false},
+    {"_internal_dir_bundle", commands::cmd_internal_dir_bundle, false},
+    {"_internal_get_bundle", commands::cmd_internal_get_bundle, false},
+    {"_internal_get_dir_profiles", commands::cmd_internal_get_dir_profiles, false},
+
+    {"add", commands::cmd_add, true},
+    {"agent", commands::cmd_agent, true},
+    {"audit", commands::cmd_audit, true},
+    {"backend", commands::cmd_backend, true},
+    {"completion", commands::cmd_completion, false},
+    {"cp", commands::cmd_cp, true},
+    {"doctor", commands::cmd_doctor, true},
+    {"duplicate", commands::cmd_duplicate, true},
+    {"env", commands::cmd_env, true},
+    {"export", commands::cmd_export, true},
+    {"generate", commands::cmd_generate, true},
+    {"get", commands::cmd_get, true},
+    {"guard", commands::cmd_guard, true},
+    {"gui", commands::cmd_gui, true},
+    {"help", commands::cmd_help, false},
+    {"hook-env", commands::cmd_hook_env, false},
+    {"import", commands::cmd_import, true},
+    {"install-shell", commands::cmd_install_shell, true},
+    {"load", commands::cmd_load, true},
+    {"ls", commands::cmd_ls, true},
+    {"migrate", commands::cmd_migrate, true},
+    {"monitor", commands::cmd_monitor, true},
+    {"profile", commands::cmd_profile, true},
+    {"profiles", commands::cmd_profiles, true},
+    {"purge", commands::cmd_purge, true},
+    {"redact", commands::cmd_redact, true},
+    {"refresh", commands::cmd_refresh, true},
+    {"rekey", commands::cmd_rekey, true},
+    {"rm", commands::cmd_rm, true},
+    {"run", commands::cmd_run, true},
+    {"save", commands::cmd_save, true},
+    {"search", commands::cmd_search, true},
+    {"secret", commands::cmd_secret, true},
+    {"service", commands::cmd_service, true},
+    {"set", commands::cmd_set, true},
+    {"sync", commands::cmd_sync, true},
+    {"test", commands::cmd_test, true},
+    {"uninstall", commands::cmd_uninstall, true},
+    {"unload", commands::cmd_unload, true},
+    {"version", commands::cmd_version, false},
+    {"welcome", commands::cmd_welcome, true},
+};
+
+constexpr bool commandsSorted() {
+    for (size_t i = 1; i < sizeof(COMMANDS) / sizeof(COMMANDS[0]); ++i) {
+        if (!(COMMANDS[i - 1].name < COMMANDS[i].name)) {
+            return false;
+        }
     }
-    if (cfg.forcePlain) {
-        cfg.gpgAvailable = false;
+    return true;
+}
+static_assert(commandsSorted(), "COMMANDS must stay sorted by name");
+
+const CommandEntry* findCommand(std::string_view name) {
+    auto end = std::end(COMMANDS);
+    auto it = std::lower_bound(std::begin(COMMANDS), end, name,
+                               [](const CommandEntry& entry, std::string_view n) { return entry.name < n; });
+    return it != end && it->name == name ? it : nullptr;
+}
+
+// Wall time per startup phase, printed to stderr with --timings or
+// AK_TRACE_STARTUP=1 so cold-start regressions show up in numbers
+class StartupTrace {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    void mark(const char* phase) {
+        auto now = Clock::now();
+        phases_.emplace_back(phase, std::chrono::duration_cast<std::chrono::microseconds>(now - last_).count());
+        last_ = now;
     }
-    
-    cfg.vaultPath = cfg.configDir + ((cfg.gpgAvailable && !cfg.forcePlain) ? "/keys.env.gpg" : "/keys.env");
-    cfg.auditLogPath = cfg.configDir + "/audit.log";
-    
-    system::ensureSecureDir(cfg.configDir);
-    cfg.instanceId = core::loadOrCreateInstanceId(cfg);
-    cfg.persistDir = cfg.configDir + "/persist";
-    
-    // Parse global flags - first expand short flags
-    std::vector<std::string> rawArgs;
-    rawArgs.reserve(argc - 1);
-    for (int i = 1; i < argc; ++i) {
-        rawArgs.push_back(argv[i]);
+
+    void print(const core::Config& cfg) const {
+        long long total = 0;
+        for (const auto& [phase, us] : phases_) {
+            std::cerr << "ak: " << std::left << std::setw(16) << phase << std::right << std::setw(8) << us << " us\n";
+            total += us;
+        }
+        std::cerr << "ak: " << std::left << std::setw(16) << "startup total" << std::right << std::setw(8) << total
+                  << " us (gpg probe " << (cfg.gpgAvailable.pending() ? "deferred" : "done") << ")\n";
     }
+
+private:
+    Clock::time_point last_ = Clock::now();
+    std::vector<std::pair<const char*, long long>> phases_;
+};
+
+} // namespace
+
+int main(int argc, char** argv) {
+    StartupTrace trace;
+    bool timings = core::getenvs("AK_TRACE_STARTUP") == "1";
+
+    // Initialize configuration
+    core::Config cfg = storage::loadConfig();
+    trace.mark("config");
     
-    // Expand short flags
-    std::vector<std::string> expandedArgs = cli::expandShortFlags(rawArgs);
-    
-    // Process global flags
+    // Parse global flags, expanding short flags as we go
     std::vector<std::string> args;
-    args.reserve(expandedArgs.size());
-    for (const auto& arg : expandedArgs) {
-        if (arg == "--json") {
+    args.reserve(argc > 1 ? argc - 1 : 0);
+    bool passthrough = false; // everything after "--" belongs to a child command
+    for (int i = 1; i < argc; ++i) {
+        std::string_view arg = argv[i];
+        if (passthrough) {
+            args.emplace_back(arg);
+        } else if (arg == "--") {
+            passthrough = true;
+            args.emplace_back(arg);
+        } else if (arg == "--json") {
             cfg.json = true;
+        } else if (arg == "--timings") {
+            timings = true;
+        } else if ((arg == "--metrics-file" || arg == "--otlp-endpoint") && i + 1 < argc) {
+            (arg == "--metrics-file" ? cfg.metricsFile : cfg.otlpEndpoint) = argv[++i];
+        } else if (arg.rfind("--metrics-file=", 0) == 0) {
+            cfg.metricsFile = std::string(arg.substr(15));
+        } else if (arg.rfind("--otlp-endpoint=", 0) == 0) {
+            cfg.otlpEndpoint = std::string(arg.substr(16));
         } else {
-            args.push_back(arg);
+            cli::appendExpandedFlag(arg, args);
         }
     }
     
@@ -68,77 +172,37 @@ int main(int argc, char** argv) {
     } else {
         cmd = args[0];
     }
+    const CommandEntry* command = findCommand(cmd);
+    trace.mark("args");
+
+    // Published at exit so commands that end through core::error count too
+    if (!cfg.metricsFile.empty() || !cfg.otlpEndpoint.empty()) {
+        core::metrics::enable();
+        static core::Config published;
+        published = cfg;
+        std::atexit([] { commands::publishMetrics(published); });
+    }
     
     // Ensure default profile exists
-    storage::ensureDefaultProfile(cfg);
-    
-    // Command dispatch table
-    std::map<std::string, commands::CommandHandler> commandMap = {
-        {"welcome", commands::cmd_welcome},
-        {"help", commands::cmd_help},
-        {"--help", commands::cmd_help},
-        {"-h", commands::cmd_help},
-        {"version", commands::cmd_version},
-        {"--version", commands::cmd_version},
-        {"-v", commands::cmd_version},
-        {"backend", commands::cmd_backend},
-        
-        // Namespaced commands (canonical)
-        {"secret", commands::cmd_secret},
-        {"profile", commands::cmd_profile},
-        {"service", commands::cmd_service},
-        
-        // Legacy/Alias commands (backward compatibility)
-        {"add", commands::cmd_add},
-        {"set", commands::cmd_set},
-        {"get", commands::cmd_get},
-        {"ls", commands::cmd_ls},
-        {"rm", commands::cmd_rm},
-        {"search", commands::cmd_search},
-        {"cp", commands::cmd_cp},
-        {"purge", commands::cmd_purge},
-        
-        // Profile management (legacy aliases)
-        {"save", commands::cmd_save},
-        {"load", commands::cmd_load},
-        {"unload", commands::cmd_unload},
-        {"profiles", commands::cmd_profiles},
-        {"env", commands::cmd_env},
-        {"duplicate", commands::cmd_duplicate},
-        
-        // Export/Import
-        {"export", commands::cmd_export},
-        {"import", commands::cmd_import},
-        {"migrate", commands::cmd_migrate},
-        
-        // Utilities
-        {"run", commands::cmd_run},
-        {"guard", commands::cmd_guard},
-        {"test", commands::cmd_test},
-        {"generate", commands::cmd_generate},
-        {"refresh", commands::cmd_refresh},
-        {"doctor", commands::cmd_doctor},
-        {"audit", commands::cmd_audit},
-        
-        // System
-        {"install-shell", commands::cmd_install_shell},
-        {"uninstall", commands::cmd_uninstall},
-        {"completion", commands::cmd_completion},
-        
-        // Internal commands for shell integration auto-loading
-        {"_internal_get_dir_profiles", commands::cmd_internal_get_dir_profiles},
-        {"_internal_get_bundle", commands::cmd_internal_get_bundle},
-        
-        // GUI
-        {"gui", commands::cmd_gui}
-    };
+    if (!command || command->needsDefaultProfile) {
+        storage::ensureDefaultProfile(cfg);
+        trace.mark("default profile");
+    }
     
-    // Dispatch to appropriate command handler
-    auto it = commandMap.find(cmd);
-    if (it != commandMap.end()) {
-        return it->second(cfg, args);
-    } else {
+    if (timings) {
+        trace.print(cfg);
+    }
+    if (!command) {
         core::error(cfg, "Unknown command '" + cmd + "' (try: ak help)");
         return 1;
     }
-}
\ No newline at end of file
+    if (!timings) {
+        return command->handler(cfg, args);
+    }
+    auto start = StartupTrace::Clock::now();
+    int rc = command->handler(cfg, args);
+    std::cerr << "ak: " << std::left << std::setw(16) << "command" << std::right << std::setw(8)
+              << std::chrono::duration_cast<std::chrono::microseconds>(StartupTrace::Clock::now() - start).count()
+              << " us\n";
+    return rc;
+}
@@ -0,0 +1,137 @@
+#include "services/monitor.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+namespace ak {
+namespace services {
+
+const char* healthName(KeyHealth health) {
+    switch (health) {
+    case KeyHealth::Healthy:
+        return "healthy";
+    case KeyHealth::Failing:
+        return "failing";
+    case KeyHealth::Throttled:
+        return "throttled";
+    default:
+        return "unknown";
+    }
+}
+
+KeyHealth classifyHealth(const TestResult& result) {
+    if (result.ok) {
+        return KeyHealth::Healthy;
+    }
+    if (result.http_status == 429 || result.http_status >= 500 ||
+        (result.http_status == 0 && result.exit_code != 0)) {
+        return KeyHealth::Throttled;
+    }
+    return KeyHealth::Failing;
+}
+
+MonitorSchedule::MonitorSchedule(std::vector<TestJob> jobs, MonitorPolicy policy, Clock::time_point start,
+                                 uint64_t seed)
+    : jobs_(std::move(jobs)), states_(jobs_.size()), policy_(policy), rng_(seed) {
+    for (auto& state : states_) {
+        state.next = start;
+    }
+}
+
+std::vector<size_t> MonitorSchedule::due(Clock::time_point now) const {
+    std::vector<size_t> out;
+    for (size_t i = 0; i < states_.size(); ++i) {
+        if (states_[i].next <= now) {
+            out.push_back(i);
+        }
+    }
+    std::sort(out.begin(), out.end(), [&](size_t a, size_t b) { return states_[a].next < states_[b].next; });
+    return out;
+}
+
+std::chrono::milliseconds MonitorSchedule::interval(const State& state) {
+    std::chrono::milliseconds base;
+    switch (state.health) {
+    case KeyHealth::Healthy:
+        base = policy_.healthyInterval;
+        break;
+    case KeyHealth::Throttled: {
+        base = policy_.backoffBase;
+        for (int i = 1; i < state.consecutive && base < policy_.maxBackoff; ++i) {
+            base *= 2;
+        }
+        base = std::min<std::chrono::milliseconds>(base, policy_.maxBackoff);
+        break;
+    }
+    default:
+        base = policy_.failingInterval;
+        break;
+    }
+    if (policy_.jitter <= 0) {
+        return base;
+    }
+    std::uniform_real_distribution<double> factor(1.0 - policy_.jitter, 1.0 + policy_.jitter);
+    return std::chrono::milliseconds(static_cast<long long>(static_cast<double>(base.count()) * factor(rng_)));
+}
+
+bool MonitorSchedule::record(size_t index, const TestResult& result, Clock::time_point now) {
+    State& state = states_[index];
+    KeyHealth health = classifyHealth(result);
+    bool changed = health != state.health;
+    state.consecutive = changed ? 1 : state.consecutive + 1;
+    state.health = health;
+    state.last = result;
+    state.next = now + interval(state);
+    return changed;
+}
+
+MonitorSchedule::Clock::time_point MonitorSchedule::nextWake() const {
+    auto next = Clock::time_point::max();
+    for (const auto& state : states_) {
+        next = std::min(next, state.next);
+    }
+    return next;
+}
+
+void runMonitor(const core::Config& cfg, const std::vector<TestJob>& jobs, TestSchedule schedule,
+                const MonitorPolicy& policy, const MonitorChangeCallback& onChange,
+                const std::function<void()>& onRound) {
+    using Clock = MonitorSchedule::Clock;
+    MonitorSchedule monitor(jobs, policy, Clock::now());
+    auto stopped = [&]() { return schedule.cancel && schedule.cancel->load(); };
+    // Every probe is a real request; stored results still serve plain ak test.
+    // One failing key must not stop the others being watched.
+    schedule.refreshCache = true;
+    schedule.failFast = false;
+
+    while (!stopped() && !jobs.empty()) {
+        auto due = monitor.due(Clock::now());
+        if (!due.empty()) {
+            std::vector<TestJob> round;
+            round.reserve(due.size());
+            for (size_t index : due) {
+                round.push_back(monitor.jobs()[index]);
+            }
+            run_test_jobs(cfg, round, schedule, [&](const TestJob& job, const TestResult& result) {
+                size_t index = due[static_cast<size_t>(&job - round.data())];
+                KeyHealth previous = monitor.state(index).health;
+                if (monitor.record(index, result, Clock::now()) && onChange) {
+                    onChange(job, result, previous, monitor.state(index));
+                }
+            });
+            if (stopped()) {
+                break;
+            }
+            if (onRound) {
+                onRound();
+            }
+        }
+        // Sleep in short steps so a stop request is noticed promptly
+        auto until = std::min(monitor.nextWake(), Clock::now() + std::chrono::seconds(1));
+        std::this_thread::sleep_until(until);
+    }
+}
+
+} // namespace services
+} // namespace ak
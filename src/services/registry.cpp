@@ -0,0 +1,294 @@
+#include "services/registry.hpp"
+#include "services/services.hpp"
+
+#include <array>
+#include <cctype>
+#include <cstdint>
+
+namespace ak {
+namespace services {
+
+namespace {
+
+constexpr BuiltinService BUILTINS[] = {
+    {"anthropic", "ANTHROPIC_API_KEY", "Anthropic AI", "https://api.anthropic.com/v1/messages", "POST", "", "Bearer",
+     "https://console.anthropic.com/settings/keys", true},
+    {"azure_openai", "AZURE_OPENAI_API_KEY", "Azure OpenAI Service", "", "GET", "", "Bearer",
+     "https://portal.azure.com/#blade/Microsoft_Azure_CognitiveServices/CognitiveServicesMenuBlade/ApiKeys", true},
+    {"brave", "BRAVE_API_KEY", "Brave Search API", "https://api.search.brave.com/res/v1/web/search", "GET", "", "Bearer",
+     "https://brave.com/search/api/", true},
+    {"cohere", "COHERE_API_KEY", "Cohere AI", "https://api.cohere.ai/v1/models", "GET", "", "Bearer",
+     "https://dashboard.cohere.com/api-keys", true},
+    {"deepseek", "DEEPSEEK_API_KEY", "DeepSeek AI", "https://api.deepseek.com/v1/models", "GET", "", "Bearer",
+     "https://platform.deepseek.com/api_keys", true},
+    {"exa", "EXA_API_KEY", "Exa Search", "https://api.exa.ai/search", "POST", "", "Bearer",
+     "https://dashboard.exa.ai/api-keys", true},
+    {"fireworks", "FIREWORKS_API_KEY", "Fireworks AI", "https://api.fireworks.ai/inference/v1/models", "GET", "", "Bearer",
+     "https://fireworks.ai/account/api-keys", true},
+    {"gemini", "GEMINI_API_KEY", "Google Gemini", "https://generativelanguage.googleapis.com/v1/models", "GET", "", "Bearer",
+     "https://aistudio.google.com/app/apikey", true},
+    {"groq", "GROQ_API_KEY", "Groq AI", "https://api.groq.com/openai/v1/models", "GET", "", "Bearer",
+     "https://console.groq.com/keys", true},
+    {"huggingface", "HUGGINGFACE_TOKEN", "Hugging Face", "https://huggingface.co/api/whoami", "GET", "", "Bearer",
+     "https://huggingface.co/settings/tokens", true},
+    {"inference", "INFERENCE_API_KEY", "Hugging Face Inference API", "https://api-inference.huggingface.co/models", "GET", "", "Bearer",
+     "https://huggingface.co/settings/tokens", true},
+    {"langchain", "LANGCHAIN_API_KEY", "LangChain", "https://api.smith.langchain.com/info", "GET", "", "Bearer",
+     "https://smith.langchain.com/settings", true},
+    {"continue", "CONTINUE_API_KEY", "Continue.dev", "https://api.continue.dev/v1/health", "GET", "", "Bearer",
+     "https://app.continue.dev/settings", true},
+    {"composio", "COMPOSIO_API_KEY", "Composio", "https://backend.composio.dev/api/v1/actions", "GET", "", "Bearer",
+     "https://app.composio.dev/settings", true},
+    {"hyperbolic", "HYPERBOLIC_API_KEY", "Hyperbolic AI", "https://api.hyperbolic.xyz/v1/models", "GET", "", "Bearer",
+     "https://app.hyperbolic.xyz/settings", true},
+    {"logfire", "LOGFIRE_TOKEN", "Pydantic Logfire", "https://logfire-api.pydantic.dev/v1/info", "GET", "", "Bearer",
+     "https://logfire.pydantic.dev/", true},
+    {"mistral", "MISTRAL_API_KEY", "Mistral AI", "https://api.mistral.ai/v1/models", "GET", "", "Bearer",
+     "https://console.mistral.ai/api-keys", true},
+    {"openai", "OPENAI_API_KEY", "OpenAI", "https://api.openai.com/v1/models", "GET", "", "Bearer",
+     "https://platform.openai.com/api-keys", true},
+    {"openrouter", "OPENROUTER_API_KEY", "OpenRouter", "https://openrouter.ai/api/v1/models", "GET", "", "Bearer",
+     "https://openrouter.ai/settings/keys", true},
+    {"perplexity", "PERPLEXITY_API_KEY", "Perplexity AI", "https://api.perplexity.ai/models", "GET", "", "Bearer",
+     "https://www.perplexity.ai/settings/api", true},
+    {"sambanova", "SAMBANOVA_API_KEY", "SambaNova AI", "https://api.sambanova.ai/v1/models", "GET", "", "Bearer",
+     "https://cloud.sambanova.ai/apis", true},
+    {"tavily", "TAVILY_API_KEY", "Tavily Search", "https://api.tavily.com/search", "POST", "", "Bearer",
+     "https://app.tavily.com/home", true},
+    {"together", "TOGETHER_API_KEY", "Together AI", "https://api.together.xyz/v1/models", "GET", "", "Bearer",
+     "https://api.together.xyz/settings/api-keys", true},
+    {"xai", "XAI_API_KEY", "xAI Grok", "https://api.x.ai/v1/models", "GET", "", "Bearer",
+     "https://console.x.ai/", true},
+    {"ollama", "OLLAMA_API_KEY", "Ollama (local)", "http://localhost:11434/api/chat", "POST",
+     "-H 'Content-Type: application/json'", "", "", true},
+    // Cloud providers
+    {"aws", "AWS_ACCESS_KEY_ID", "Amazon Web Services", "", "GET", "", "AWS Signature",
+     "https://console.aws.amazon.com/iam/home#/security_credentials", false},
+    {"gcp", "GOOGLE_APPLICATION_CREDENTIALS", "Google Cloud Platform", "", "GET", "", "OAuth2",
+     "https://console.cloud.google.com/apis/credentials", false},
+    {"azure", "AZURE_CLIENT_ID", "Microsoft Azure", "", "GET", "", "OAuth2",
+     "https://portal.azure.com/#view/Microsoft_AAD_IAM/ActiveDirectoryMenuBlade/~/RegisteredApps", false},
+    {"github", "GITHUB_TOKEN", "GitHub", "https://api.github.com/user", "GET", "", "Bearer",
+     "https://github.com/settings/tokens/new", false},
+    {"docker", "DOCKER_AUTH_TOKEN", "Docker Hub", "", "GET", "", "Bearer",
+     "https://hub.docker.com/settings/security", false},
+    // Database providers
+    {"mongodb", "MONGODB_URI", "MongoDB", "", "GET", "", "Connection String", "", false},
+    {"postgres", "DATABASE_URL", "PostgreSQL", "", "GET", "", "Connection String", "", false},
+    {"redis", "REDIS_URL", "Redis", "", "GET", "", "Connection String", "", false},
+    // Other common services
+    {"stripe", "STRIPE_SECRET_KEY", "Stripe Payment", "https://api.stripe.com/v1/account", "GET", "", "Bearer",
+     "https://dashboard.stripe.com/apikeys", false},
+    {"sendgrid", "SENDGRID_API_KEY", "SendGrid Email", "https://api.sendgrid.com/v3/user/profile", "GET", "", "Bearer",
+     "https://app.sendgrid.com/settings/api_keys", false},
+    {"twilio", "TWILIO_AUTH_TOKEN", "Twilio", "https://api.twilio.com/2010-04-01/Accounts.json", "GET", "", "Basic Auth",
+     "https://console.twilio.com/us1/account/keys-credentials/api-keys", false},
+    {"slack", "SLACK_API_TOKEN", "Slack", "https://slack.com/api/auth.test", "GET", "", "Bearer",
+     "https://api.slack.com/apps", false},
+    {"discord", "DISCORD_TOKEN", "Discord Bot", "https://discord.com/api/v10/users/@me", "GET", "", "Bot",
+     "https://discord.com/developers/applications", false},
+    {"vercel", "VERCEL_TOKEN", "Vercel", "https://api.vercel.com/v2/user", "GET", "", "Bearer",
+     "https://vercel.com/account/tokens", false},
+    {"netlify", "NETLIFY_AUTH_TOKEN", "Netlify", "https://api.netlify.com/api/v1/user", "GET", "", "Bearer",
+     "https://app.netlify.com/user/applications", false},
+};
+
+constexpr size_t BUILTIN_COUNT = sizeof(BUILTINS) / sizeof(BUILTINS[0]);
+
+// Perfect hash over BUILTINS: FNV-1a with a seed, finished with a mixer, into a
+// power-of-two slot table. The seed is searched for at compile time until no
+// two names share a slot, so a lookup is one hash and one compare.
+constexpr size_t HASH_SLOTS = 128;
+constexpr uint8_t EMPTY_SLOT = 0xff;
+static_assert(BUILTIN_COUNT < HASH_SLOTS && HASH_SLOTS <= EMPTY_SLOT, "grow HASH_SLOTS");
+
+constexpr uint32_t hashName(std::string_view name, uint32_t seed) {
+    uint32_t h = 2166136261u ^ seed;
+    for (char c : name) {
+        h ^= static_cast<unsigned char>(c);
+        h *= 16777619u;
+    }
+    h ^= h >> 15;
+    h *= 0x2c1b3c6du;
+    h ^= h >> 12;
+    return h;
+}
+
+constexpr uint32_t findSeed() {
+    for (uint32_t seed = 1; seed < (1u << 16); ++seed) {
+        bool used[HASH_SLOTS] = {};
+        bool perfect = true;
+        for (const auto& service : BUILTINS) {
+            size_t slot = hashName(service.name, seed) & (HASH_SLOTS - 1);
+            if (used[slot]) {
+                perfect = false;
+                break;
+            }
+            used[slot] = true;
+        }
+        if (perfect) {
+            return seed;
+        }
+    }
+    return 0;
+}
+
+constexpr uint32_t HASH_SEED = findSeed();
+static_assert(HASH_SEED != 0, "no perfect hash seed for the built-in services");
+
+constexpr std::array<uint8_t, HASH_SLOTS> buildSlots() {
+    std::array<uint8_t, HASH_SLOTS> slots{};
+    for (auto& slot : slots) {
+        slot = EMPTY_SLOT;
+    }
+    for (size_t i = 0; i < BUILTIN_COUNT; ++i) {
+        slots[hashName(BUILTINS[i].name, HASH_SEED) & (HASH_SLOTS - 1)] = static_cast<uint8_t>(i);
+    }
+    return slots;
+}
+
+constexpr std::array<uint8_t, HASH_SLOTS> SLOTS = buildSlots();
+
+// Key prefixes that identify a provider; the longest matching prefix wins,
+// and only once the key has at least minLength characters
+struct PrefixRule {
+    std::string_view prefix;
+    std::string_view provider;
+    size_t minLength;
+};
+
+constexpr PrefixRule PREFIX_RULES[] = {
+    {"sk-", "openai", 21},        {"sk-ant-", "anthropic", 0}, {"sk-or-", "openrouter", 0},
+    {"gsk_", "groq", 0},          {"mis", "mistral", 0},       {"fw_", "fireworks", 0},
+    {"pplx-", "perplexity", 0},   {"tvly-", "tavily", 0},      {"xai-", "xai", 0},
+    {"ds-", "deepseek", 0},       {"hf_", "huggingface", 0},   {"exa-", "exa", 0},
+    {"AIza", "gemini", 0},        {"BSA", "brave", 0},         {"sk_live_", "stripe", 0},
+    {"sk_test_", "stripe", 0},    {"SG.", "sendgrid", 0},      {"ghp_", "github", 0},
+    {"gho_", "github", 0},        {"ghs_", "github", 0},       {"ghr_", "github", 0},
+    {"github_pat_", "github", 0}, {"xoxb-", "slack", 0},       {"xoxp-", "slack", 0},
+    {"xoxa-", "slack", 0},        {"hyp-", "hyperbolic", 0},   {"snova-", "sambanova", 0},
+    {"samba-", "sambanova", 0},   {"ls__", "langchain", 0},    {"lsv2_", "langchain", 0},
+};
+
+constexpr size_t RULE_COUNT = sizeof(PREFIX_RULES) / sizeof(PREFIX_RULES[0]);
+
+// Trie over PREFIX_RULES in first-child/next-sibling form; node 0 is the
+// root, so 0 also serves as "no child"/"no sibling"
+struct TrieNode {
+    char label = 0;
+    uint8_t child = 0;
+    uint8_t sibling = 0;
+    int8_t rule = -1;
+};
+
+constexpr size_t trieCapacity() {
+    size_t nodes = 1;
+    for (const auto& rule : PREFIX_RULES) {
+        nodes += rule.prefix.size();
+    }
+    return nodes;
+}
+
+constexpr size_t TRIE_CAPACITY = trieCapacity();
+static_assert(TRIE_CAPACITY <= 256 && RULE_COUNT <= 127, "prefix trie outgrew its node indexes");
+
+constexpr std::array<TrieNode, TRIE_CAPACITY> buildTrie() {
+    std::array<TrieNode, TRIE_CAPACITY> nodes{};
+    size_t count = 1;
+    for (size_t r = 0; r < RULE_COUNT; ++r) {
+        size_t node = 0;
+        for (char c : PREFIX_RULES[r].prefix) {
+            size_t next = nodes[node].child;
+            while (next != 0 && nodes[next].label != c) {
+                next = nodes[next].sibling;
+            }
+            if (next == 0) {
+                next = count++;
+                nodes[next].label = c;
+                nodes[next].sibling = nodes[node].child;
+                nodes[node].child = static_cast<uint8_t>(next);
+            }
+            node = next;
+        }
+        nodes[node].rule = static_cast<int8_t>(r);
+    }
+    return nodes;
+}
+
+constexpr std::array<TrieNode, TRIE_CAPACITY> TRIE = buildTrie();
+
+std::string_view matchPrefix(std::string_view key) {
+    int best = -1;
+    size_t node = 0;
+    for (char c : key) {
+        size_t next = TRIE[node].child;
+        while (next != 0 && TRIE[next].label != c) {
+            next = TRIE[next].sibling;
+        }
+        if (next == 0) {
+            break;
+        }
+        node = next;
+        int rule = TRIE[node].rule;
+        if (rule >= 0 && key.size() >= PREFIX_RULES[rule].minLength) {
+            best = rule;
+        }
+    }
+    return best < 0 ? std::string_view() : PREFIX_RULES[best].provider;
+}
+
+bool allAlnum(const std::string& text) {
+    for (char c : text) {
+        if (!std::isalnum(static_cast<unsigned char>(c))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+BuiltinServiceRange builtinServices() {
+    return {BUILTINS, BUILTINS + BUILTIN_COUNT};
+}
+
+const BuiltinService* findBuiltinService(std::string_view name) {
+    uint8_t index = SLOTS[hashName(name, HASH_SEED) & (HASH_SLOTS - 1)];
+    if (index == EMPTY_SLOT || BUILTINS[index].name != name) {
+        return nullptr;
+    }
+    return &BUILTINS[index];
+}
+
+Service makeService(const BuiltinService& builtin) {
+    Service service(std::string(builtin.name), std::string(builtin.keyName), std::string(builtin.description),
+                    std::string(builtin.testEndpoint), std::string(builtin.testMethod),
+                    std::string(builtin.testHeaders), std::string(builtin.authMethod), builtin.testable, true);
+    service.generateUrl = std::string(builtin.generateUrl);
+    return service;
+}
+
+std::string detectProviderFromKey(const std::string& apiKey) {
+    std::string_view provider = matchPrefix(apiKey);
+    if (!provider.empty()) {
+        return std::string(provider);
+    }
+    // Keys without a telling prefix: length/alphabet shape, then markers
+    // anywhere in the key
+    if (apiKey.size() == 40 && allAlnum(apiKey)) {
+        return "cohere";
+    }
+    if (apiKey.size() == 64 && allAlnum(apiKey)) {
+        return "together";
+    }
+    if (apiKey.find("vercel") != std::string::npos) {
+        return "vercel";
+    }
+    if (apiKey.find("composio") != std::string::npos) {
+        return "composio";
+    }
+    return ""; // Unknown provider
+}
+
+} // namespace services
+} // namespace ak
@@ -1,12 +1,24 @@
 #include "services/services.hpp"
+#include "services/registry.hpp"
+#include "services/test_cache.hpp"
 #include "core/config.hpp"
+#include "core/metrics.hpp"
+#include "core/redact.hpp"
+#include "http/http.hpp"
+#include "storage/metadata_cache.hpp"
 #include "storage/vault.hpp"
 #include "system/system.hpp"
 #include <iostream>
 #include <fstream>
 #include <filesystem>
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <future>
+#include <memory>
+#include <mutex>
+#include <set>
 #include <thread>
 #include <algorithm>
 #include <sstream>
@@ -63,20 +75,6 @@ std::string resolveAuthPrefix(const Service& service)
     return "";
 }
 
-std::string escapeSingleQuotes(const std::string& value)
-{
-    std::string escaped;
-    escaped.reserve(value.size() * 2);
-    for (char c : value) {
-        if (c == '\'') {
-            escaped += "'\\''";
-        } else {
-            escaped += c;
-        }
-    }
-    return escaped;
-}
-
 std::string escapeMultiline(const std::string& value)
 {
     std::string escaped;
@@ -134,8 +132,18 @@ bool containsCaseInsensitive(const std::string& haystack, const std::string& nee
     return loweredHaystack.find(loweredNeedle) != std::string::npos;
 }
 
-void applyAuth(const Service& service, const std::string& apiKey,
-               std::string& curlArgs, std::string& endpoint)
+bool hasHeader(const http::Request& request, const std::string& name)
+{
+    for (const auto& header : request.headers) {
+        if (header.size() > name.size() && header[name.size()] == ':' &&
+            containsCaseInsensitive(header.substr(0, name.size()), name)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void applyAuth(const Service& service, const std::string& apiKey, http::Request& request)
 {
     // Special-case: Ollama typically runs locally and does not require auth
     if (service.name == "ollama") {
@@ -149,21 +157,68 @@ void applyAuth(const Service& service, const std::string& apiKey,
     std::string value = prefix + apiKey;
 
     if (service.authLocation == "query") {
-        endpoint = appendQueryParameter(endpoint, parameter, value);
+        request.url = appendQueryParameter(request.url, parameter, value);
         return;
     }
 
     if (service.authLocation == "body") {
         // Ensure content-type header present
-        if (!containsCaseInsensitive(service.testHeaders, "content-type")) {
-            curlArgs += " -H 'Content-Type: application/x-www-form-urlencoded'";
+        if (!hasHeader(request, "content-type")) {
+            request.headers.push_back("Content-Type: application/x-www-form-urlencoded");
         }
-        curlArgs += " --data-urlencode '" + parameter + "=" + value + "'";
+        std::string field = urlEncode(parameter) + "=" + urlEncode(value);
+        request.body = request.body.empty() ? field : field + "&" + request.body;
         return;
     }
 
     // Default to header injection
-    curlArgs += " -H '" + parameter + ": " + value + "'";
+    request.headers.push_back(parameter + ": " + value);
+}
+
+// The request a service definition describes, with the key applied
+http::Request buildTestRequest(const Service& service, const std::string& apiKey)
+{
+    http::Request request;
+    std::string method = service.testMethod.empty() ? "GET" : service.testMethod;
+    std::transform(method.begin(), method.end(), method.begin(), ::toupper);
+    if ((method == "GET" || method == "HEAD") && !service.testBody.empty()) {
+        method = "POST";
+    }
+    request.method = method;
+    request.url = service.testEndpoint;
+    request.headers = http::parseHeaderArgs(service.testHeaders);
+
+    std::string body = service.testBody;
+    if (body.empty() && service.name == "ollama") {
+        body = "{\"model\":\"llama3\",\"messages\":[{\"role\":\"user\",\"content\":\"ping\"}],\"stream\":false}";
+    }
+    request.body = body;
+    applyAuth(service, apiKey, request);
+
+    if (!body.empty() && !hasHeader(request, "content-type")) {
+        request.headers.push_back("Content-Type: application/json");
+    }
+    return request;
+}
+
+// Body text that marks a response as failed despite its status
+const std::vector<std::string> ERROR_PHRASES = {
+    "\"error\"", "unauthorized", "invalid_api_key", "invalid api key",
+    "authentication failed", "access denied", "forbidden",
+};
+
+const core::Redactor& errorPhraseMatcher()
+{
+    static const core::Redactor matcher({}, ERROR_PHRASES);
+    return matcher;
+}
+
+// Same verdict for native and curl(1) results: transport ok, status < 400
+// and no obvious error text in the body
+bool looksSuccessful(int exitCode, int httpStatus, const std::string& output)
+{
+    bool success = (exitCode == 0 && (httpStatus == 0 || (httpStatus >= 200 && httpStatus < 400)));
+    return success && !errorPhraseMatcher().flags(output);
 }
 
 void ensureAuthDefaults(Service& service)
@@ -185,24 +240,64 @@ void ensureAuthDefaults(Service& service)
     }
 }
 
-std::string maskSensitive(const std::string& text, const std::vector<std::string>& secrets)
+std::string jsonQuote(const std::string& value)
 {
-    std::string masked = text;
-    constexpr const char* token = "[REDACTED]";
-
-    for (const auto& secret : secrets) {
-        if (secret.empty()) {
-            continue;
+    std::ostringstream out;
+    out << '"';
+    for (unsigned char c : value) {
+        switch (c) {
+        case '"': out << "\\\""; break;
+        case '\\': out << "\\\\"; break;
+        case '\n': out << "\\n"; break;
+        case '\r': out << "\\r"; break;
+        case '\t': out << "\\t"; break;
+        default:
+            if (c < 0x20) {
+                out << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c) << std::dec;
+            } else {
+                out << c;
+            }
         }
+    }
+    out << '"';
+    return out.str();
+}
 
-        std::string::size_type pos = 0;
-        while ((pos = masked.find(secret, pos)) != std::string::npos) {
-            masked.replace(pos, secret.size(), token);
-            pos += std::strlen(token);
+std::size_t envCount(const char* name, std::size_t fallback)
+{
+    const char* value = getenv(name);
+    if (!value || !*value) {
+        return fallback;
+    }
+    try {
+        long parsed = std::stol(value);
+        return parsed > 0 ? static_cast<std::size_t>(parsed) : fallback;
+    } catch (const std::exception&) {
+        return fallback;
+    }
+}
+
+// API key from the profile (or the default profile), else the environment.
+// The profile cache means one decrypt per test run.
+std::string profileOrEnvKey(const core::Config& cfg, const std::string& profileName, const std::string& keyName)
+{
+    try {
+        auto profileKeys = ak::storage::loadProfileKeysCached(
+            cfg, profileName.empty() ? ak::storage::getDefaultProfileName() : profileName);
+        auto it = profileKeys->find(keyName);
+        if (it != profileKeys->end() && !it->second.empty()) {
+            return it->second;
         }
+    } catch (const std::exception&) {
+        // Profile load failed, continue to other sources
     }
 
-    return masked;
+    const char* envValue = getenv(keyName.c_str());
+    if (envValue && *envValue) {
+        return std::string(envValue);
+    }
+
+    return "";
 }
 
 std::string truncateForDisplay(const std::string& text, std::size_t maxLength = 800)
@@ -215,93 +310,23 @@ std::string truncateForDisplay(const std::string& text, std::size_t maxLength =
 
 }
 
-// Default service definitions with full information
-const std::map<std::string, Service> DEFAULT_SERVICES = {
-    {"anthropic", {"anthropic", "ANTHROPIC_API_KEY", "Anthropic AI", "https://api.anthropic.com/v1/messages", "POST", "", "Bearer", true, true}},
-    {"azure_openai", {"azure_openai", "AZURE_OPENAI_API_KEY", "Azure OpenAI Service", "", "GET", "", "Bearer", true, true}},
-    {"brave", {"brave", "BRAVE_API_KEY", "Brave Search API", "https://api.search.brave.com/res/v1/web/search", "GET", "", "Bearer", true, true}},
-    {"cohere", {"cohere", "COHERE_API_KEY", "Cohere AI", "https://api.cohere.ai/v1/models", "GET", "", "Bearer", true, true}},
-    {"deepseek", {"deepseek", "DEEPSEEK_API_KEY", "DeepSeek AI", "https://api.deepseek.com/v1/models", "GET", "", "Bearer", true, true}},
-    {"exa", {"exa", "EXA_API_KEY", "Exa Search", "https://api.exa.ai/search", "POST", "", "Bearer", true, true}},
-    {"fireworks", {"fireworks", "FIREWORKS_API_KEY", "Fireworks AI", "https://api.fireworks.ai/inference/v1/models", "GET", "", "Bearer", true, true}},
-    {"gemini", {"gemini", "GEMINI_API_KEY", "Google Gemini", "https://generativelanguage.googleapis.com/v1/models", "GET", "", "Bearer", true, true}},
-    {"groq", {"groq", "GROQ_API_KEY", "Groq AI", "https://api.groq.com/openai/v1/models", "GET", "", "Bearer", true, true}},
-    {"huggingface", {"huggingface", "HUGGINGFACE_TOKEN", "Hugging Face", "https://huggingface.co/api/whoami", "GET", "", "Bearer", true, true}},
-    {"inference", {"inference", "INFERENCE_API_KEY", "Hugging Face Inference API", "https://api-inference.huggingface.co/models", "GET", "", "Bearer", true, true}},
-    {"langchain", {"langchain", "LANGCHAIN_API_KEY", "LangChain", "https://api.smith.langchain.com/info", "GET", "", "Bearer", true, true}},
-    {"continue", {"continue", "CONTINUE_API_KEY", "Continue.dev", "https://api.continue.dev/v1/health", "GET", "", "Bearer", true, true}},
-    {"composio", {"composio", "COMPOSIO_API_KEY", "Composio", "https://backend.composio.dev/api/v1/actions", "GET", "", "Bearer", true, true}},
-    {"hyperbolic", {"hyperbolic", "HYPERBOLIC_API_KEY", "Hyperbolic AI", "https://api.hyperbolic.xyz/v1/models", "GET", "", "Bearer", true, true}},
-    {"logfire", {"logfire", "LOGFIRE_TOKEN", "Pydantic Logfire", "https://logfire-api.pydantic.dev/v1/info", "GET", "", "Bearer", true, true}},
-    {"mistral", {"mistral", "MISTRAL_API_KEY", "Mistral AI", "https://api.mistral.ai/v1/models", "GET", "", "Bearer", true, true}},
-    {"openai", {"openai", "OPENAI_API_KEY", "OpenAI", "https://api.openai.com/v1/models", "GET", "", "Bearer", true, true}},
-    {"openrouter", {"openrouter", "OPENROUTER_API_KEY", "OpenRouter", "https://openrouter.ai/api/v1/models", "GET", "", "Bearer", true, true}},
-    {"perplexity", {"perplexity", "PERPLEXITY_API_KEY", "Perplexity AI", "https://api.perplexity.ai/models", "GET", "", "Bearer", true, true}},
-    {"sambanova", {"sambanova", "SAMBANOVA_API_KEY", "SambaNova AI", "https://api.sambanova.ai/v1/models", "GET", "", "Bearer", true, true}},
-    {"tavily", {"tavily", "TAVILY_API_KEY", "Tavily Search", "https://api.tavily.com/search", "POST", "", "Bearer", true, true}},
-    {"together", {"together", "TOGETHER_API_KEY", "Together AI", "https://api.together.xyz/v1/models", "GET", "", "Bearer", true, true}},
-    {"xai", {"xai", "XAI_API_KEY", "xAI Grok", "https://api.x.ai/v1/models", "GET", "", "Bearer", true, true}},
-    {"ollama", {"ollama", "OLLAMA_API_KEY", "Ollama (local)", "http://localhost:11434/api/chat", "POST",
-        "-H 'Content-Type: application/json'", "", true, true}},
-    // Cloud providers
-    {"aws", {"aws", "AWS_ACCESS_KEY_ID", "Amazon Web Services", "", "GET", "", "AWS Signature", false, true}},
-    {"gcp", {"gcp", "GOOGLE_APPLICATION_CREDENTIALS", "Google Cloud Platform", "", "GET", "", "OAuth2", false, true}},
-    {"azure", {"azure", "AZURE_CLIENT_ID", "Microsoft Azure", "", "GET", "", "OAuth2", false, true}},
-    {"github", {"github", "GITHUB_TOKEN", "GitHub", "https://api.github.com/user", "GET", "", "Bearer", false, true}},
-    {"docker", {"docker", "DOCKER_AUTH_TOKEN", "Docker Hub", "", "GET", "", "Bearer", false, true}},
-    // Database providers
-    {"mongodb", {"mongodb", "MONGODB_URI", "MongoDB", "", "GET", "", "Connection String", false, true}},
-    {"postgres", {"postgres", "DATABASE_URL", "PostgreSQL", "", "GET", "", "Connection String", false, true}},
-    {"redis", {"redis", "REDIS_URL", "Redis", "", "GET", "", "Connection String", false, true}},
-    // Other common services
-    {"stripe", {"stripe", "STRIPE_SECRET_KEY", "Stripe Payment", "https://api.stripe.com/v1/account", "GET", "", "Bearer", false, true}},
-    {"sendgrid", {"sendgrid", "SENDGRID_API_KEY", "SendGrid Email", "https://api.sendgrid.com/v3/user/profile", "GET", "", "Bearer", false, true}},
-    {"twilio", {"twilio", "TWILIO_AUTH_TOKEN", "Twilio", "https://api.twilio.com/2010-04-01/Accounts.json", "GET", "", "Basic Auth", false, true}},
-    {"slack", {"slack", "SLACK_API_TOKEN", "Slack", "https://slack.com/api/auth.test", "GET", "", "Bearer", false, true}},
-    {"discord", {"discord", "DISCORD_TOKEN", "Discord Bot", "https://discord.com/api/v10/users/@me", "GET", "", "Bot", false, true}},
-    {"vercel", {"vercel", "VERCEL_TOKEN", "Vercel", "https://api.vercel.com/v2/user", "GET", "", "Bearer", false, true}},
-    {"netlify", {"netlify", "NETLIFY_AUTH_TOKEN", "Netlify", "https://api.netlify.com/api/v1/user", "GET", "", "Bearer", false, true}},
-};
+const std::vector<std::string>& googleKeyNames()
+{
+    static const std::vector<std::string> names = {
+        "GEMINI_API_KEY", "GOOGLE_API_KEY", "GOOGLE_GENERATIVE_AI_API_KEY",
+        "GOOGLE_AI_API_KEY", "GOOGLE_CLOUD_API_KEY"
+    };
+    return names;
+}
 
-// API key creation page URLs per service
-static const std::map<std::string, std::string> SERVICE_GENERATE_URLS = {
-	{"anthropic",    "https://console.anthropic.com/settings/keys"},
-	{"azure_openai", "https://portal.azure.com/#blade/Microsoft_Azure_CognitiveServices/CognitiveServicesMenuBlade/ApiKeys"},
-	{"brave",        "https://brave.com/search/api/"},
-	{"cohere",       "https://dashboard.cohere.com/api-keys"},
-	{"deepseek",     "https://platform.deepseek.com/api_keys"},
-	{"exa",          "https://dashboard.exa.ai/api-keys"},
-	{"fireworks",    "https://fireworks.ai/account/api-keys"},
-	{"gemini",       "https://aistudio.google.com/app/apikey"},
-	{"groq",         "https://console.groq.com/keys"},
-	{"huggingface",  "https://huggingface.co/settings/tokens"},
-	{"inference",    "https://huggingface.co/settings/tokens"},
-	{"langchain",    "https://smith.langchain.com/settings"},
-	{"continue",     "https://app.continue.dev/settings"},
-	{"composio",     "https://app.composio.dev/settings"},
-	{"hyperbolic",   "https://app.hyperbolic.xyz/settings"},
-	{"logfire",      "https://logfire.pydantic.dev/"},
-	{"mistral",      "https://console.mistral.ai/api-keys"},
-	{"openai",       "https://platform.openai.com/api-keys"},
-	{"openrouter",   "https://openrouter.ai/settings/keys"},
-	{"perplexity",   "https://www.perplexity.ai/settings/api"},
-	{"sambanova",    "https://cloud.sambanova.ai/apis"},
-	{"tavily",       "https://app.tavily.com/home"},
-	{"together",     "https://api.together.xyz/settings/api-keys"},
-	{"xai",          "https://console.x.ai/"},
-	{"aws",          "https://console.aws.amazon.com/iam/home#/security_credentials"},
-	{"gcp",          "https://console.cloud.google.com/apis/credentials"},
-	{"azure",        "https://portal.azure.com/#view/Microsoft_AAD_IAM/ActiveDirectoryMenuBlade/~/RegisteredApps"},
-	{"github",       "https://github.com/settings/tokens/new"},
-	{"docker",       "https://hub.docker.com/settings/security"},
-	{"stripe",       "https://dashboard.stripe.com/apikeys"},
-	{"sendgrid",     "https://app.sendgrid.com/settings/api_keys"},
-	{"twilio",       "https://console.twilio.com/us1/account/keys-credentials/api-keys"},
-	{"slack",        "https://api.slack.com/apps"},
-	{"discord",      "https://discord.com/developers/applications"},
-	{"vercel",       "https://vercel.com/account/tokens"},
-	{"netlify",      "https://app.netlify.com/user/applications"},
-};
+// Built-in services by name, for callers that want them sorted
+const std::map<std::string, Service> DEFAULT_SERVICES = []() {
+    std::map<std::string, Service> services;
+    for (const auto& builtin : builtinServices()) {
+        services.emplace(std::string(builtin.name), makeService(builtin));
+    }
+    return services;
+}();
 
 // Legacy SERVICE_KEYS for backwards compatibility
 const std::map<std::string, std::string> SERVICE_KEYS = []() {
@@ -378,8 +403,8 @@ std::unordered_set<std::string> getKnownServiceKeys(const core::Config& cfg) {
     
     // Add user-defined service keys
     try {
-        auto allServices = loadAllServices(cfg);
-        for (const auto& [name, service] : allServices) {
+        auto allServices = loadAllServicesCached(cfg);
+        for (const auto& [name, service] : *allServices) {
             if (!service.isBuiltIn) {
                 keys.insert(service.keyName);
             }
@@ -396,31 +421,22 @@ std::unordered_set<std::string> getKnownServiceKeys(const core::Config& cfg) {
 std::vector<std::string> detectConfiguredServices(const core::Config& cfg, const std::string& profileName) {
     std::vector<std::string> services;
     std::unordered_set<std::string> allAvailableKeys;
+    auto allServices = loadAllServicesCached(cfg);
     
     // Collect all available keys from multiple sources
     try {
         // 1. Load profile keys if profile specified
-        if (!profileName.empty()) {
-            auto profileKeys = ak::storage::loadProfileKeys(cfg, profileName);
-            for (const auto& [key, value] : profileKeys) {
-                if (!value.empty()) {
-                    allAvailableKeys.insert(key);
-                }
-            }
-        } else {
-            // Load default profile keys
-            auto defaultProfile = ak::storage::getDefaultProfileName();
-            auto profileKeys = ak::storage::loadProfileKeys(cfg, defaultProfile);
-            for (const auto& [key, value] : profileKeys) {
-                if (!value.empty()) {
-                    allAvailableKeys.insert(key);
-                }
+        // (falls back to the default profile)
+        auto profileKeys = ak::storage::loadProfileKeysCached(
+            cfg, profileName.empty() ? ak::storage::getDefaultProfileName() : profileName);
+        for (const auto& [key, value] : *profileKeys) {
+            if (!value.empty()) {
+                allAvailableKeys.insert(key);
             }
         }
         
         // 2. Check environment variables as fallback
-        auto allServices = loadAllServices(cfg);
-        for (const auto& [name, service] : allServices) {
+        for (const auto& [name, service] : *allServices) {
             const char* envValue = getenv(service.keyName.c_str());
             if (envValue && *envValue) {
                 allAvailableKeys.insert(service.keyName);
@@ -429,8 +445,7 @@ std::vector<std::string> detectConfiguredServices(const core::Config& cfg, const
         
     } catch (const std::exception& e) {
         // Fall back to environment only
-        auto allServices = loadAllServices(cfg);
-        for (const auto& [name, service] : allServices) {
+        for (const auto& [name, service] : *allServices) {
             const char* envValue = getenv(service.keyName.c_str());
             if (envValue && *envValue) {
                 allAvailableKeys.insert(service.keyName);
@@ -439,18 +454,13 @@ std::vector<std::string> detectConfiguredServices(const core::Config& cfg, const
     }
     
     // Check which services have their required keys available
-    auto allServices = loadAllServices(cfg);
-    for (const auto& [name, service] : allServices) {
+    for (const auto& [name, service] : *allServices) {
         if (service.testable) {
             bool isConfigured = false;
             
             // Special handling for gemini service to check Google aliases
             if (name == "gemini") {
-                const std::vector<std::string> googleKeys = {
-                    "GEMINI_API_KEY", "GOOGLE_API_KEY", "GOOGLE_GENERATIVE_AI_API_KEY",
-                    "GOOGLE_AI_API_KEY", "GOOGLE_CLOUD_API_KEY"
-                };
-                for (const auto& googleKey : googleKeys) {
+                for (const auto& googleKey : googleKeyNames()) {
                     if (allAvailableKeys.find(googleKey) != allAvailableKeys.end()) {
                         isConfigured = true;
                         break;
@@ -478,7 +488,10 @@ std::vector<std::string> detectConfiguredServices(const core::Config& cfg, const
 // Testing functions
 CurlExecResult curl_ok(const std::string& args, bool debug) {
     const std::string baseFlags = debug ? "-sS" : "-sS"; // keep quiet while capturing output
-    std::string commandCore = "curl " + baseFlags + " --connect-timeout 5 --max-time 12 " + args;
+    http::Timeouts timeouts = http::defaultTimeouts();
+    std::string commandCore = "curl " + baseFlags +
+        " --connect-timeout " + http::formatSeconds(timeouts.connectMs) +
+        " --max-time " + http::formatSeconds(timeouts.totalMs) + " " + args;
     std::string cmd = commandCore + " -w '\nHTTP_STATUS:%{http_code}' 2>&1";
     int exitCode = 0;
     std::string output = system::runCmdCapture(cmd, &exitCode);
@@ -499,43 +512,55 @@ CurlExecResult curl_ok(const std::string& args, bool debug) {
     }
 
     output = core::trim(output);
+    bool success = looksSuccessful(exitCode, httpStatus, output);
+    return {success, exitCode, httpStatus, output, commandCore};
+}
 
-    bool success = (exitCode == 0 && (httpStatus == 0 || (httpStatus >= 200 && httpStatus < 400)));
+CurlExecResult http_ok(const http::Request& request, bool debug, const std::atomic<bool>* cancel) {
+    if (cancel && *cancel) {
+        return {false, 42, 0, "Cancelled", ""};
+    }
+    core::metrics::Span span("ak_http_request", {{"engine", http::available() ? "native" : "curl"}});
+    if (!http::available()) {
+        return curl_ok(http::toCurlArgs(request), debug);
+    }
 
-    // Additional check for common error patterns
-    if (success && !output.empty()) {
-        std::string lowerOutput = output;
-        std::transform(lowerOutput.begin(), lowerOutput.end(), lowerOutput.begin(), ::tolower);
-
-        if (lowerOutput.find("\"error\"") != std::string::npos ||
-            lowerOutput.find("unauthorized") != std::string::npos ||
-            lowerOutput.find("invalid_api_key") != std::string::npos ||
-            lowerOutput.find("invalid api key") != std::string::npos ||
-            lowerOutput.find("authentication failed") != std::string::npos ||
-            lowerOutput.find("access denied") != std::string::npos ||
-            lowerOutput.find("forbidden") != std::string::npos) {
-            success = false;
-        }
+    http::Timeouts timeouts = http::defaultTimeouts();
+    http::Response response = http::perform(request, timeouts, cancel);
+
+    std::string output = response.body;
+    if (!response.error.empty()) {
+        output += (output.empty() ? "" : "\n") +
+            ("curl: (" + std::to_string(response.curlCode) + ") " + response.error);
     }
+    output = core::trim(output);
 
-    return {success, exitCode, httpStatus, output, commandCore};
+    // Equivalent command line, for --debug output and reproducing by hand
+    std::string command = "curl -sS --connect-timeout " + http::formatSeconds(timeouts.connectMs) +
+        " --max-time " + http::formatSeconds(timeouts.totalMs) + " " + http::toCurlArgs(request);
+
+    bool success = looksSuccessful(response.curlCode, response.status, output);
+    return {success, response.curlCode, response.status, output, command};
 }
 
-TestResult test_one(const core::Config& cfg, const std::string& service, const std::string& profileName, bool debug) {
+TestResult test_one(const core::Config& cfg, const std::string& service, const std::string& profileName, bool debug,
+                    const std::atomic<bool>* cancel) {
     TestResult result;
     result.service = service;
+    result.profile = profileName;
     result.ok = false;
 
     auto start = std::chrono::steady_clock::now();
     bool debugEnabled = debug || (getenv("AK_DEBUG_TESTS") != nullptr);
 
     auto recordCurl = [&](const CurlExecResult& exec, const std::vector<std::string>& secrets) {
+        core::Redactor redactor(secrets);
         result.exit_code = exec.exit_code;
         result.http_status = exec.http_status;
-        result.curl_command = maskSensitive(exec.command, secrets);
+        result.curl_command = redactor.redact(exec.command);
 
         bool keepOutput = debugEnabled || !exec.ok;
-        std::string maskedOutput = maskSensitive(exec.output, secrets);
+        std::string maskedOutput = redactor.redact(exec.output);
         if (keepOutput) {
             result.response_snippet = truncateForDisplay(maskedOutput);
         }
@@ -560,48 +585,18 @@ TestResult test_one(const core::Config& cfg, const std::string& service, const s
         result.ok = exec.ok;
     };
 
-    // Helper function to get API key from profile or environment
-    auto getServiceKey = [&cfg, &profileName](const std::string& keyName) -> std::string {
-        // First check profile keys if profile specified
-        if (!profileName.empty()) {
-            try {
-                auto profileKeys = ak::storage::loadProfileKeys(cfg, profileName);
-                auto it = profileKeys.find(keyName);
-                if (it != profileKeys.end() && !it->second.empty()) {
-                    return it->second;
-                }
-            } catch (const std::exception&) {
-                // Profile load failed, continue to other sources
-            }
-        } else {
-            // Check default profile
-            try {
-                auto defaultProfile = ak::storage::getDefaultProfileName();
-                auto profileKeys = ak::storage::loadProfileKeys(cfg, defaultProfile);
-                auto it = profileKeys.find(keyName);
-                if (it != profileKeys.end() && !it->second.empty()) {
-                    return it->second;
-                }
-            } catch (const std::exception&) {
-                // Default profile load failed, continue to other sources
-            }
-        }
-        
-        // Check environment variables as fallback
-        const char* envValue = getenv(keyName.c_str());
-        if (envValue && *envValue) {
-            return std::string(envValue);
-        }
-        
-        return "";
+    auto getServiceKey = [&cfg, &profileName](const std::string& keyName) {
+        return profileOrEnvKey(cfg, profileName, keyName);
     };
-    
+
     try {
         if (service == "openai") {
             std::string apiKey = getServiceKey("OPENAI_API_KEY");
             if (!apiKey.empty()) {
-                std::string args = "-H 'Authorization: Bearer " + apiKey + "' https://api.openai.com/v1/models";
-                auto curl_result = curl_ok(args, debugEnabled);
+                http::Request request;
+                request.url = "https://api.openai.com/v1/models";
+                request.headers = {"Authorization: Bearer " + apiKey};
+                auto curl_result = http_ok(request, debugEnabled, cancel);
                 recordCurl(curl_result, {apiKey});
                 setOkFrom(curl_result);
             } else {
@@ -612,14 +607,16 @@ TestResult test_one(const core::Config& cfg, const std::string& service, const s
             if (!apiKey.empty()) {
                 const std::string payload =
                     "{\"model\":\"anthropic-haiku\",\"max_tokens\":32,\"messages\":[{\"role\":\"user\",\"content\":\"ping\"}]}";
-                std::string args =
-                    "-X POST "
-                    "-H 'x-api-key: " + apiKey + "' "
-                    "-H 'anthropic-version: 2023-06-01' "
-                    "-H 'content-type: application/json' "
-                    "--data '" + payload + "' "
-                    "https://api.anthropic.com/v1/messages";
-                auto curl_result = curl_ok(args, debugEnabled);
+                http::Request request;
+                request.method = "POST";
+                request.url = "https://api.anthropic.com/v1/messages";
+                request.headers = {
+                    "x-api-key: " + apiKey,
+                    "anthropic-version: 2023-06-01",
+                    "content-type: application/json"
+                };
+                request.body = payload;
+                auto curl_result = http_ok(request, debugEnabled, cancel);
                 recordCurl(curl_result, {apiKey});
                 setOkFrom(curl_result);
             } else {
@@ -628,11 +625,7 @@ TestResult test_one(const core::Config& cfg, const std::string& service, const s
         } else if (service == "gemini") {
             // Special handling for Gemini API - check for Google aliases
             std::string googleKey;
-            const std::vector<std::string> googleKeys = {
-                "GEMINI_API_KEY", "GOOGLE_API_KEY", "GOOGLE_GENERATIVE_AI_API_KEY",
-                "GOOGLE_AI_API_KEY", "GOOGLE_CLOUD_API_KEY"
-            };
-            for (const auto& key : googleKeys) {
+            for (const auto& key : googleKeyNames()) {
                 googleKey = getServiceKey(key);
                 if (!googleKey.empty()) break;
             }
@@ -657,50 +650,16 @@ TestResult test_one(const core::Config& cfg, const std::string& service, const s
             } else {
                 // Check if it's a user-defined service
                 try {
-                    auto allServices = loadAllServices(cfg);
-                    auto serviceIt = allServices.find(service);
+                    auto allServices = loadAllServicesCached(cfg);
+                    auto serviceIt = allServices->find(service);
                     
-                    if (serviceIt != allServices.end() && serviceIt->second.testable) {
+                    if (serviceIt != allServices->end() && serviceIt->second.testable) {
                         const Service& serviceObj = serviceIt->second;
                         std::string apiKey = getServiceKey(serviceObj.keyName);
                         if (!apiKey.empty()) {
                             if (!serviceObj.testEndpoint.empty()) {
                                 // Perform actual HTTP test
-                                std::string method = serviceObj.testMethod.empty() ? "GET" : serviceObj.testMethod;
-                                std::string upperMethod = method;
-                                std::transform(upperMethod.begin(), upperMethod.end(), upperMethod.begin(), ::toupper);
-                                if ((upperMethod == "GET" || upperMethod == "HEAD") && !serviceObj.testBody.empty()) {
-                                    upperMethod = "POST";
-                                }
-                                if (upperMethod.empty()) {
-                                    upperMethod = "GET";
-                                }
-
-                                std::string curlArgs = "-X " + upperMethod;
-
-                                // Add custom headers if specified
-                                if (!serviceObj.testHeaders.empty()) {
-                                    curlArgs += " " + serviceObj.testHeaders;
-                                }
-
-                                std::string endpoint = serviceObj.testEndpoint;
-                                applyAuth(serviceObj, apiKey, curlArgs, endpoint);
-
-                                // Add the endpoint
-                                curlArgs += " " + endpoint;
-
-                                if (!serviceObj.testBody.empty() || serviceObj.name == "ollama") {
-                                    if (!containsCaseInsensitive(serviceObj.testHeaders, "content-type")) {
-                                        curlArgs += " -H 'Content-Type: application/json'";
-                                    }
-                                    std::string body = serviceObj.testBody;
-                                    if (body.empty() && serviceObj.name == "ollama") {
-                                        body = "{\"model\":\"llama3\",\"messages\":[{\"role\":\"user\",\"content\":\"ping\"}],\"stream\":false}";
-                                    }
-                                    curlArgs += " --data '" + escapeSingleQuotes(body) + "'";
-                                }
-
-                                auto curl_result = curl_ok(curlArgs, debugEnabled);
+                                auto curl_result = http_ok(buildTestRequest(serviceObj, apiKey), debugEnabled, cancel);
                                 recordCurl(curl_result, {apiKey});
                                 setOkFrom(curl_result);
                             } else {
@@ -729,62 +688,283 @@ TestResult test_one(const core::Config& cfg, const std::string& service, const s
     return result;
 }
 
-std::vector<TestResult> run_tests_parallel(
+std::string resolveTestKey(const core::Config& cfg, const std::string& service, const std::string& profileName) {
+    if (service == "gemini") {
+        for (const auto& key : googleKeyNames()) {
+            std::string value = profileOrEnvKey(cfg, profileName, key);
+            if (!value.empty()) {
+                return value;
+            }
+        }
+        return "";
+    }
+    auto it = SERVICE_KEYS.find(service);
+    if (it != SERVICE_KEYS.end()) {
+        return profileOrEnvKey(cfg, profileName, it->second);
+    }
+    try {
+        auto allServices = loadAllServicesCached(cfg);
+        auto serviceIt = allServices->find(service);
+        if (serviceIt != allServices->end()) {
+            return profileOrEnvKey(cfg, profileName, serviceIt->second.keyName);
+        }
+    } catch (const std::exception&) {
+        // Unreadable user services: nothing to resolve
+    }
+    return "";
+}
+
+std::string testHostFor(const std::map<std::string, Service>& services, const std::string& service) {
+    // Mirrors test_one: other built-ins only check that a key is present
+    if (service != "openai" && service != "anthropic" && SERVICE_KEYS.count(service)) {
+        return "";
+    }
+    auto it = services.find(service);
+    if (it == services.end() || it->second.testEndpoint.empty()) {
+        return "";
+    }
+
+    const std::string& url = it->second.testEndpoint;
+    std::size_t start = url.find("://");
+    start = (start == std::string::npos) ? 0 : start + 3;
+    std::size_t end = url.find_first_of("/?#", start);
+    std::string host = url.substr(start, end == std::string::npos ? std::string::npos : end - start);
+    std::size_t at = host.rfind('@');
+    if (at != std::string::npos) {
+        host.erase(0, at + 1);
+    }
+    std::transform(host.begin(), host.end(), host.begin(), ::tolower);
+    return host;
+}
+
+std::vector<TestResult> run_test_jobs(
     const core::Config& cfg,
-    const std::vector<std::string>& services,
-    bool fail_fast,
-    const std::string& profileName,
-    bool debug) {
+    const std::vector<TestJob>& jobs,
+    const TestSchedule& schedule,
+    const TestResultCallback& onResult,
+    const TestStartCallback& onStart) {
 
     std::vector<TestResult> results;
-    std::vector<std::future<TestResult>> futures;
+    if (jobs.empty()) {
+        return results;
+    }
 
-    // Launch tests in parallel
-    for (const auto& service : services) {
-        futures.push_back(
-            std::async(std::launch::async, [&cfg, service, profileName, debug]() {
-                return test_one(cfg, service, profileName, debug);
-            })
-        );
+    // Decrypt each profile once up front; every test_one below hits the cache
+    std::set<std::string> profiles;
+    for (const auto& job : jobs) {
+        profiles.insert(job.profile.empty() ? ak::storage::getDefaultProfileName() : job.profile);
     }
-    
-    // Collect results
-    for (auto& future : futures) {
-        TestResult result = future.get();
-        results.push_back(result);
-        
-        if (fail_fast && !result.ok) {
-            break;
+    for (const auto& profile : profiles) {
+        try {
+            ak::storage::loadProfileKeysCached(cfg, profile);
+        } catch (const std::exception&) {
+            // test_one falls back to the environment
         }
     }
-    
-    return results;
-}
 
-// Unified service management functions
-std::map<std::string, Service> loadAllServices(const core::Config& cfg) {
-    std::map<std::string, Service> allServices;
-    
-    // Load default services first
-    for (const auto& [name, service] : DEFAULT_SERVICES) {
-        allServices[name] = service;
+    ServiceMapPtr allServices;
+    try {
+        allServices = loadAllServicesCached(cfg);
+    } catch (const std::exception&) {
+        // No host information; only the global worker limit applies
+    }
+    std::vector<std::string> hosts;
+    hosts.reserve(jobs.size());
+    for (const auto& job : jobs) {
+        hosts.push_back(allServices ? testHostFor(*allServices, job.service) : std::string());
+    }
+
+    std::size_t workers = schedule.workers ? schedule.workers : envCount("AK_TEST_WORKERS", 16);
+    std::size_t perHost = schedule.perHost ? schedule.perHost : envCount("AK_TEST_PER_HOST", 4);
+    workers = std::min(workers, jobs.size());
+
+    std::unique_ptr<TestResultCache> cache;
+    if (schedule.useCache) {
+        cache = std::make_unique<TestResultCache>(cfg);
+    }
+    long maxAge = schedule.maxAgeSeconds >= 0 ? schedule.maxAgeSeconds : defaultTestCacheTtl();
+
+    std::mutex mutex;                   // guards pending and inFlight
+    std::condition_variable ready;
+    std::deque<std::size_t> pending;
+    std::map<std::string, std::size_t> inFlight;
+    std::mutex emitMutex;               // serialises results and onResult
+    std::atomic<bool> localCancel{false};
+    std::atomic<bool>& cancel = schedule.cancel ? *schedule.cancel : localCancel;
+    for (std::size_t i = 0; i < jobs.size(); ++i) {
+        pending.push_back(i);
     }
 
-    // Populate generate URLs for built-in services
-    for (auto& [name, service] : allServices) {
-        if (service.generateUrl.empty()) {
-            auto urlIt = SERVICE_GENERATE_URLS.find(name);
-            if (urlIt != SERVICE_GENERATE_URLS.end()) {
-                service.generateUrl = urlIt->second;
+    // First queued job whose host has a free slot, or npos once done/cancelled
+    auto next = [&](std::unique_lock<std::mutex>& lock) -> std::size_t {
+        for (;;) {
+            if (cancel || pending.empty()) {
+                return std::string::npos;
+            }
+            for (auto it = pending.begin(); it != pending.end(); ++it) {
+                const std::string& host = hosts[*it];
+                if (host.empty() || inFlight[host] < perHost) {
+                    std::size_t index = *it;
+                    pending.erase(it);
+                    if (!host.empty()) {
+                        ++inFlight[host];
+                    }
+                    return index;
+                }
+            }
+            ready.wait(lock);
+        }
+    };
+
+    auto work = [&]() {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            std::size_t index = next(lock);
+            if (index == std::string::npos) {
+                return;
+            }
+            lock.unlock();
+
+            const TestJob& job = jobs[index];
+            if (onStart) {
+                onStart(job);
+            }
+            // Only checks that make a request are worth caching
+            TestResult result;
+            std::string keyValue;
+            if (cache && !hosts[index].empty()) {
+                keyValue = resolveTestKey(cfg, job.service, job.profile);
+            }
+            bool hit = !keyValue.empty() && !schedule.refreshCache &&
+                       cache->lookup(job.service, keyValue, maxAge, result);
+            if (!hit) {
+                result = test_one(cfg, job.service, job.profile, schedule.debug, &cancel);
+                if (!keyValue.empty()) {
+                    cache->store(job.service, keyValue, result);
+                }
+            }
+            result.profile = job.profile;
+            if (core::metrics::enabled()) {
+                if (!keyValue.empty()) {
+                    core::metrics::count("ak_cache_requests_total",
+                                         {{"cache", "test_results"}, {"result", hit ? "hit" : "miss"}});
+                }
+                if (!hit) {
+                    core::metrics::observe("ak_service_test_seconds", {{"service", job.service}},
+                                           std::chrono::duration<double>(result.duration).count());
+                }
+                core::metrics::count("ak_service_tests_total",
+                                     {{"service", job.service}, {"result", result.ok ? "ok" : "fail"}});
+            }
+
+            lock.lock();
+            if (!hosts[index].empty()) {
+                --inFlight[hosts[index]];
             }
+            ready.notify_all();
+            lock.unlock();
+
+            {
+                std::lock_guard<std::mutex> emit(emitMutex);
+                // After a stop, failures are mostly aborted requests
+                if (!(cancel && !result.ok)) {
+                    if (schedule.failFast && !result.ok) {
+                        {
+                            std::lock_guard<std::mutex> guard(mutex);
+                            cancel = true;
+                        }
+                        ready.notify_all();
+                        http::interrupt();
+                    }
+                    results.push_back(result);
+                    if (onResult) {
+                        onResult(job, result);
+                    }
+                }
+            }
+            lock.lock();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(workers);
+    for (std::size_t i = 0; i < workers; ++i) {
+        threads.emplace_back(work);
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    if (cache) {
+        try {
+            cache->save();
+        } catch (const std::exception&) {
+            // A read-only config dir just means no caching
         }
     }
 
-    // Load user-defined services
-    std::string userServicesPath = cfg.configDir + "/user_services.txt";
+    return results;
+}
+
+void cancelTests(std::atomic<bool>& cancel) {
+    cancel = true;
+    http::interrupt();
+}
+
+std::string toJsonLine(const TestResult& result) {
+    std::ostringstream out;
+    out << "{\"service\":" << jsonQuote(result.service);
+    if (!result.profile.empty()) {
+        out << ",\"profile\":" << jsonQuote(result.profile);
+    }
+    out << ",\"ok\":" << (result.ok ? "true" : "false")
+        << ",\"duration_ms\":" << result.duration.count();
+    if (result.http_status != 0) {
+        out << ",\"http_status\":" << result.http_status;
+    }
+    if (!result.error_message.empty()) {
+        out << ",\"error\":" << jsonQuote(result.error_message);
+    }
+    if (result.cached) {
+        out << ",\"cached\":true";
+    }
+    out << "}";
+    return out.str();
+}
+
+std::vector<TestResult> run_tests_parallel(
+    const core::Config& cfg,
+    const std::vector<std::string>& services,
+    bool fail_fast,
+    const std::string& profileName,
+    bool debug) {
+
+    std::vector<TestJob> jobs;
+    jobs.reserve(services.size());
+    for (const auto& service : services) {
+        jobs.push_back({service, profileName});
+    }
+
+    TestSchedule schedule;
+    schedule.failFast = fail_fast;
+    schedule.debug = debug;
+    return run_test_jobs(cfg, jobs, schedule);
+}
+
+// Unified service management functions
+namespace {
+
+std::string userServicesFile(const core::Config& cfg) {
+    return cfg.configDir + "/user_services.txt";
+}
+
+// User-defined services in file order; a later block overrides an earlier
+// one of the same name when merged
+std::vector<Service> parseUserServices(const std::string& userServicesPath) {
+    std::vector<Service> userServices;
     std::ifstream file(userServicesPath);
     if (!file.is_open()) {
-        return allServices; // Return just default services if file doesn't exist
+        return userServices;
     }
     
     std::string line;
@@ -803,7 +983,7 @@ std::map<std::string, Service> loadAllServices(const core::Config& cfg) {
             if (inService && !currentService.name.empty()) {
                 currentService.isBuiltIn = false; // User-defined services are not built-in
                 ensureAuthDefaults(currentService);
-                allServices[currentService.name] = currentService;
+                userServices.push_back(currentService);
             }
             
             // Start new service
@@ -854,14 +1034,118 @@ std::map<std::string, Service> loadAllServices(const core::Config& cfg) {
     if (inService && !currentService.name.empty()) {
         currentService.isBuiltIn = false; // User-defined services are not built-in
         ensureAuthDefaults(currentService);
-        allServices[currentService.name] = currentService;
+        userServices.push_back(currentService);
     }
     
+    return userServices;
+}
+
+// Row layout for MetadataCache::serviceRecords
+const size_t SERVICE_ROW_FIELDS = 13;
+
+std::vector<std::string> serviceToRow(const Service& service) {
+    return {service.name, service.keyName, service.description, service.testEndpoint,
+            service.testMethod, service.testHeaders, service.authMethod, service.authLocation,
+            service.authParameter, service.authPrefix, service.testBody, service.generateUrl,
+            service.testable ? "1" : "0"};
+}
+
+bool rowsToServices(const std::vector<std::vector<std::string>>& rows, std::vector<Service>& out) {
+    for (const auto& row : rows) {
+        if (row.size() != SERVICE_ROW_FIELDS) {
+            return false;
+        }
+        Service service;
+        service.name = row[0];
+        service.keyName = row[1];
+        service.description = row[2];
+        service.testEndpoint = row[3];
+        service.testMethod = row[4];
+        service.testHeaders = row[5];
+        service.authMethod = row[6];
+        service.authLocation = row[7];
+        service.authParameter = row[8];
+        service.authPrefix = row[9];
+        service.testBody = row[10];
+        service.generateUrl = row[11];
+        service.testable = row[12] == "1";
+        service.isBuiltIn = false;
+        out.push_back(std::move(service));
+    }
+    return true;
+}
+
+// The parsed user services come from MetadataCache while user_services.txt
+// keeps the stamp they were recorded with
+std::map<std::string, Service> readAllServices(const core::Config& cfg, const std::string& userServicesPath,
+                                               const storage::PathStamp& stamp) {
+    std::map<std::string, Service> allServices = DEFAULT_SERVICES;
+    if (!stamp.exists) {
+        return allServices; // Return just default services if file doesn't exist
+    }
+
+    std::vector<Service> userServices;
+    storage::MetadataCache meta(cfg);
+    std::vector<std::vector<std::string>> rows;
+    if (!meta.serviceRecords(stamp, rows) || !rowsToServices(rows, userServices)) {
+        userServices = parseUserServices(userServicesPath);
+        rows.clear();
+        for (const auto& service : userServices) {
+            rows.push_back(serviceToRow(service));
+        }
+        meta.setServiceRecords(stamp, std::move(rows));
+        meta.save();
+    }
+    for (auto& service : userServices) {
+        allServices[service.name] = std::move(service);
+    }
     return allServices;
 }
 
+struct ServiceRegistryEntry {
+    storage::PathStamp stamp;
+    ServiceMapPtr services;
+};
+
+std::mutex& serviceRegistryMutex() {
+    static std::mutex mutex;
+    return mutex;
+}
+
+std::map<std::string, ServiceRegistryEntry>& serviceRegistry() {
+    static std::map<std::string, ServiceRegistryEntry> registry; // by user_services.txt path
+    return registry;
+}
+
+} // namespace
+
+ServiceMapPtr loadAllServicesCached(const core::Config& cfg) {
+    std::string path = userServicesFile(cfg);
+    ServiceRegistryEntry current;
+    current.stamp = storage::stampPath(path);
+
+    {
+        std::lock_guard<std::mutex> lock(serviceRegistryMutex());
+        auto it = serviceRegistry().find(path);
+        if (it != serviceRegistry().end() && it->second.stamp == current.stamp) {
+            return it->second.services;
+        }
+    }
+
+    // Load outside the lock; a concurrent reload of the same file is harmless
+    current.services = std::make_shared<const std::map<std::string, Service>>(
+        readAllServices(cfg, path, current.stamp));
+    std::lock_guard<std::mutex> lock(serviceRegistryMutex());
+    serviceRegistry()[path] = current;
+    return current.services;
+}
+
+std::map<std::string, Service> loadAllServices(const core::Config& cfg) {
+    return *loadAllServicesCached(cfg);
+}
+
 void saveUserServices(const core::Config& cfg, const std::map<std::string, Service>& services) {
-    std::string userServicesPath = cfg.configDir + "/user_services.txt";
+    std::string userServicesPath = userServicesFile(cfg);
     
     // Create config directory if it doesn't exist
     std::filesystem::create_directories(cfg.configDir);
@@ -894,6 +1178,11 @@ void saveUserServices(const core::Config& cfg, const std::map<std::string, Servi
             file << "\n";
         }
     }
+    file.close();
+
+    // A same-size rewrite within the mtime granularity would look unchanged
+    std::lock_guard<std::mutex> lock(serviceRegistryMutex());
+    serviceRegistry().erase(userServicesPath);
 }
 
 void addService(const core::Config& cfg, const Service& service) {
@@ -938,9 +1227,9 @@ Service* findService(std::map<std::string, Service>& services, const std::string
 }
 
 Service getServiceByName(const core::Config& cfg, const std::string& name) {
-    auto services = loadAllServices(cfg);
-    auto it = services.find(name);
-    if (it != services.end()) {
+    auto services = loadAllServicesCached(cfg);
+    auto it = services->find(name);
+    if (it != services->end()) {
         return it->second;
     }
     throw std::runtime_error("Service not found: " + name);
@@ -949,8 +1238,8 @@ Service getServiceByName(const core::Config& cfg, const std::string& name) {
 std::map<std::string, std::string> getAllServiceKeys(const core::Config& cfg) {
     std::map<std::string, std::string> allKeys;
     
-    auto allServices = loadAllServices(cfg);
-    for (const auto& [name, service] : allServices) {
+    auto allServices = loadAllServicesCached(cfg);
+    for (const auto& [name, service] : *allServices) {
         allKeys[name] = service.keyName;
     }
     
@@ -967,52 +1256,24 @@ TestResult testServiceWithKey(const Service& service, const std::string& apiKey)
     try {
         if (!apiKey.empty() && !service.testEndpoint.empty() && service.testable) {
             // Perform actual HTTP test
-            std::string method = service.testMethod.empty() ? "GET" : service.testMethod;
-            std::string upperMethod = method;
-            std::transform(upperMethod.begin(), upperMethod.end(), upperMethod.begin(), ::toupper);
-            if ((upperMethod == "GET" || upperMethod == "HEAD") && !service.testBody.empty()) {
-                upperMethod = "POST";
-            }
-            if (upperMethod.empty()) {
-                upperMethod = "GET";
-            }
-
-            std::string curlArgs = "-X " + upperMethod;
-
-            // Add custom headers if specified
-            if (!service.testHeaders.empty()) {
-                curlArgs += " " + service.testHeaders;
-            }
-
-            std::string endpoint = service.testEndpoint;
-            applyAuth(service, apiKey, curlArgs, endpoint);
-
-            // Add the endpoint
-            curlArgs += " " + endpoint;
-
-            if (!service.testBody.empty()) {
-                if (!containsCaseInsensitive(service.testHeaders, "content-type")) {
-                    curlArgs += " -H 'Content-Type: application/json'";
-                }
-                curlArgs += " --data '" + escapeSingleQuotes(service.testBody) + "'";
-            }
-
-            auto curl_result = curl_ok(curlArgs, false);
+            auto curl_result = http_ok(buildTestRequest(service, apiKey), false);
             result.exit_code = curl_result.exit_code;
             result.http_status = curl_result.http_status;
-            result.curl_command = maskSensitive(curl_result.command, {apiKey});
-            if (!curl_result.output.empty()) {
-                result.response_snippet = truncateForDisplay(maskSensitive(curl_result.output, {apiKey}));
+            core::Redactor redactor({apiKey});
+            std::string maskedOutput = redactor.redact(curl_result.output);
+            result.curl_command = redactor.redact(curl_result.command);
+            if (!maskedOutput.empty()) {
+                result.response_snippet = truncateForDisplay(maskedOutput);
             }
             result.ok = curl_result.ok;
             if (!curl_result.ok) {
                 if (curl_result.http_status >= 400) {
                     result.error_message = "HTTP " + std::to_string(curl_result.http_status);
-                    if (!curl_result.output.empty()) {
-                        result.error_message += ": " + truncateForDisplay(maskSensitive(curl_result.output, {apiKey}), 300);
+                    if (!maskedOutput.empty()) {
+                        result.error_message += ": " + truncateForDisplay(maskedOutput, 300);
                     }
-                } else if (!curl_result.output.empty()) {
-                    result.error_message = truncateForDisplay(maskSensitive(curl_result.output, {apiKey}), 300);
+                } else if (!maskedOutput.empty()) {
+                    result.error_message = truncateForDisplay(maskedOutput, 300);
                 } else if (curl_result.exit_code != 0) {
                     result.error_message = "curl exited with code " + std::to_string(curl_result.exit_code);
                 } else {
@@ -1036,117 +1297,6 @@ TestResult testServiceWithKey(const Service& service, const std::string& apiKey)
     return result;
 }
 
-std::string detectProviderFromKey(const std::string& apiKey) {
-    // OpenAI: sk-... or sk-proj-...
-    if (apiKey.substr(0, 3) == "sk-" && apiKey.size() > 20) {
-        // Could be OpenAI or Anthropic (sk-ant-...)
-        if (apiKey.substr(0, 7) == "sk-ant-") {
-            return "anthropic";
-        }
-        return "openai";
-    }
-    // Anthropic
-    if (apiKey.find("sk-ant-") == 0) {
-        return "anthropic";
-    }
-    // Groq: gsk_...
-    if (apiKey.substr(0, 4) == "gsk_") {
-        return "groq";
-    }
-    // Cohere: ...
-    if (apiKey.size() == 40 && apiKey.find_first_not_of("abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789") == std::string::npos) {
-        return "cohere";
-    }
-    // Mistral: ...
-    if (apiKey.find("mis") == 0 || apiKey.find("mist") == 0) {
-        return "mistral";
-    }
-    // Fireworks: fw_...
-    if (apiKey.substr(0, 3) == "fw_") {
-        return "fireworks";
-    }
-    // Together: ...
-    if (apiKey.size() == 64 && apiKey.find_first_not_of("abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789") == std::string::npos) {
-        return "together";
-    }
-    // OpenRouter: sk-or-...
-    if (apiKey.substr(0, 6) == "sk-or-") {
-        return "openrouter";
-    }
-    // Perplexity: pplx-...
-    if (apiKey.substr(0, 5) == "pplx-") {
-        return "perplexity";
-    }
-    // Tavily: tvly-...
-    if (apiKey.substr(0, 5) == "tvly-") {
-        return "tavily";
-    }
-    // xAI/Grok: xai-...
-    if (apiKey.substr(0, 4) == "xai-") {
-        return "xai";
-    }
-    // DeepSeek: sk-... already handled (falls to openai), but deepseek keys sometimes start with ds-
-    if (apiKey.substr(0, 3) == "ds-") {
-        return "deepseek";
-    }
-    // Hugging Face: hf_...
-    if (apiKey.substr(0, 3) == "hf_") {
-        return "huggingface";
-    }
-    // Exa: exa-...
-    if (apiKey.substr(0, 4) == "exa-") {
-        return "exa";
-    }
-    // Google/Gemini: AIza...
-    if (apiKey.substr(0, 4) == "AIza") {
-        return "gemini";
-    }
-    // Brave: BSA...
-    if (apiKey.substr(0, 3) == "BSA") {
-        return "brave";
-    }
-    // Stripe: sk_live_ or sk_test_
-    if (apiKey.substr(0, 8) == "sk_live_" || apiKey.substr(0, 8) == "sk_test_") {
-        return "stripe";
-    }
-    // SendGrid: SG.
-    if (apiKey.substr(0, 3) == "SG.") {
-        return "sendgrid";
-    }
-    // Vercel: ...
-    if (apiKey.find("vercel") != std::string::npos) {
-        return "vercel";
-    }
-    // GitHub: ghp_ or gho_ or ghs_ or ghr_ or github_pat_
-    if (apiKey.substr(0, 4) == "ghp_" || apiKey.substr(0, 4) == "gho_" ||
-        apiKey.substr(0, 4) == "ghs_" || apiKey.substr(0, 4) == "ghr_" ||
-        apiKey.substr(0, 11) == "github_pat_") {
-        return "github";
-    }
-    // Slack: xoxb- or xoxp- or xoxa-
-    if (apiKey.substr(0, 5) == "xoxb-" || apiKey.substr(0, 5) == "xoxp-" || apiKey.substr(0, 5) == "xoxa-") {
-        return "slack";
-    }
-    // Composio
-    if (apiKey.find("composio") != std::string::npos) {
-        return "composio";
-    }
-    // Hyperbolic
-    if (apiKey.find("hyp-") == 0) {
-        return "hyperbolic";
-    }
-    // SambaNova
-    if (apiKey.find("snova-") == 0 || apiKey.find("samba-") == 0) {
-        return "sambanova";
-    }
-    // LangChain: ls__... or lsv2_...
-    if (apiKey.substr(0, 4) == "ls__" || apiKey.substr(0, 5) == "lsv2_") {
-        return "langchain";
-    }
-
-    return ""; // Unknown provider
-}
-
 TestResult testInlineKey(const core::Config& cfg, const std::string& apiKey, const std::string& provider, bool /*debug*/) {
     std::string resolvedProvider = provider;
     if (resolvedProvider.empty()) {
@@ -1163,9 +1313,9 @@ TestResult testInlineKey(const core::Config& cfg, const std::string& apiKey, con
     }
 
     // Look up the service definition
-    auto allServices = loadAllServices(cfg);
-    auto serviceIt = allServices.find(resolvedProvider);
-    if (serviceIt == allServices.end()) {
+    auto allServices = loadAllServicesCached(cfg);
+    auto serviceIt = allServices->find(resolvedProvider);
+    if (serviceIt == allServices->end()) {
         result.error_message = "Unknown provider '" + resolvedProvider + "'";
         return result;
     }
@@ -0,0 +1,244 @@
+#include "services/test_cache.hpp"
+#include "crypto/crypto.hpp"
+#include "system/system.hpp"
+
+#include <cctype>
+#include <cstdlib>
+#include <ctime>
+#include <iterator>
+#include <filesystem>
+#include <fstream>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+namespace ak {
+namespace services {
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const char* const CACHE_HEADER = "# ak test cache v1";
+
+std::string escapeField(const std::string& value)
+{
+    std::string out;
+    out.reserve(value.size());
+    for (char c : value) {
+        switch (c) {
+            case '\\': out += "\\\\"; break;
+            case '\t': out += "\\t"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            default: out += c; break;
+        }
+    }
+    return out;
+}
+
+std::string unescapeField(const std::string& value)
+{
+    std::string out;
+    out.reserve(value.size());
+    for (std::size_t i = 0; i < value.size(); ++i) {
+        if (value[i] == '\\' && i + 1 < value.size()) {
+            char next = value[++i];
+            out += next == 't' ? '\t' : next == 'n' ? '\n' : next == 'r' ? '\r' : next;
+        } else {
+            out += value[i];
+        }
+    }
+    return out;
+}
+
+std::vector<std::string> splitTabs(const std::string& line)
+{
+    std::vector<std::string> fields;
+    std::size_t start = 0;
+    for (;;) {
+        std::size_t tab = line.find('\t', start);
+        fields.push_back(line.substr(start, tab == std::string::npos ? std::string::npos : tab - start));
+        if (tab == std::string::npos) {
+            return fields;
+        }
+        start = tab + 1;
+    }
+}
+
+long long nowSeconds()
+{
+    return static_cast<long long>(std::time(nullptr));
+}
+
+} // namespace
+
+TestResultCache::TestResultCache(const core::Config& cfg)
+    : path_(path(cfg)), salt_(cfg.instanceId), entries_(readEntries(path_)) {
+}
+
+std::map<TestResultCache::EntryKey, TestResultCache::Entry> TestResultCache::readEntries(const std::string& file) {
+    std::map<EntryKey, Entry> entries;
+    std::ifstream in(file);
+    std::string line;
+    if (!std::getline(in, line) || line != CACHE_HEADER) {
+        return entries;
+    }
+    // service, key hash, checked at, ok, http status, duration ms, error
+    while (std::getline(in, line)) {
+        auto fields = splitTabs(line);
+        if (fields.size() != 7) {
+            continue;
+        }
+        try {
+            Entry entry;
+            entry.checkedAt = std::stoll(fields[2]);
+            entry.ok = fields[3] == "1";
+            entry.httpStatus = std::stoi(fields[4]);
+            entry.durationMs = std::stoll(fields[5]);
+            entry.error = unescapeField(fields[6]);
+            entries[{unescapeField(fields[0]), fields[1]}] = entry;
+        } catch (const std::exception&) {
+            // Skip damaged lines
+        }
+    }
+    return entries;
+}
+
+std::string TestResultCache::path(const core::Config& cfg) {
+    return cfg.persistDir + "/test_cache";
+}
+
+bool TestResultCache::cacheable(const TestResult& result) {
+    // Only checks that actually sent a request; key-presence checks are free
+    if (result.cached || result.curl_command.empty()) {
+        return false;
+    }
+    return result.ok || result.http_status == 401 || result.http_status == 403;
+}
+
+std::string TestResultCache::hashValue(const std::string& keyValue) const {
+    crypto::SHA256 hasher;
+    hasher.update(salt_ + ":" + keyValue);
+    return hasher.final();
+}
+
+bool TestResultCache::lookup(const std::string& service, const std::string& keyValue,
+                             long maxAgeSeconds, TestResult& out) const {
+    std::string keyHash = hashValue(keyValue);
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find({service, keyHash});
+    if (it == entries_.end()) {
+        return false;
+    }
+    const Entry& entry = it->second;
+    long long age = nowSeconds() - entry.checkedAt;
+    if (age < 0 || (maxAgeSeconds >= 0 && age > maxAgeSeconds)) {
+        return false;
+    }
+
+    out.service = service;
+    out.ok = entry.ok;
+    out.http_status = entry.httpStatus;
+    out.duration = std::chrono::milliseconds(entry.durationMs);
+    out.error_message = entry.error;
+    out.exit_code = 0;
+    out.cached = true;
+    return true;
+}
+
+void TestResultCache::store(const std::string& service, const std::string& keyValue, const TestResult& result) {
+    if (!cacheable(result) || keyValue.empty()) {
+        return;
+    }
+    EntryKey key{service, hashValue(keyValue)};
+    Entry entry;
+    entry.checkedAt = nowSeconds();
+    entry.ok = result.ok;
+    entry.httpStatus = result.http_status;
+    entry.durationMs = result.duration.count();
+    entry.error = result.error_message;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_[key] = entry;
+    changed_.insert(key);
+}
+
+void TestResultCache::erase(const std::string& service) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto it = entries_.lower_bound({service, ""}); it != entries_.end() && it->first.first == service;) {
+        changed_.erase(it->first);
+        it = entries_.erase(it);
+    }
+    erased_.insert(service);
+}
+
+void TestResultCache::save() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (changed_.empty() && erased_.empty()) {
+        return;
+    }
+
+    // Another process may have written since we loaded; keep its entries
+    // unless this run stored the same one or erased the service. The lock
+    // keeps parallel runs from merging against the same old file.
+    fs::create_directories(fs::path(path_).parent_path());
+    system::FileLock fileLock(path_ + ".lock");
+    for (const auto& [key, entry] : readEntries(path_)) {
+        if (!changed_.count(key) && !erased_.count(key.first)) {
+            entries_[key] = entry;
+        }
+    }
+    long long cutoff = nowSeconds() - ENTRY_RETENTION;
+    for (auto it = entries_.begin(); it != entries_.end();) {
+        it = it->second.checkedAt < cutoff ? entries_.erase(it) : std::next(it);
+    }
+
+    std::ostringstream out;
+    out << CACHE_HEADER << "\n";
+    for (const auto& [key, entry] : entries_) {
+        out << escapeField(key.first) << '\t' << key.second << '\t' << entry.checkedAt << '\t'
+            << (entry.ok ? "1" : "0") << '\t' << entry.httpStatus << '\t' << entry.durationMs << '\t'
+            << escapeField(entry.error) << "\n";
+    }
+    system::writeFileAtomic(path_, out.str());
+    changed_.clear();
+    erased_.clear();
+}
+
+long defaultTestCacheTtl() {
+    const char* value = std::getenv("AK_TEST_CACHE_TTL");
+    if (value && *value) {
+        long parsed = parseMaxAge(value);
+        if (parsed >= 0) {
+            return parsed;
+        }
+    }
+    return 3600;
+}
+
+long parseMaxAge(const std::string& text) {
+    if (text.empty()) {
+        return -1;
+    }
+    std::size_t digits = 0;
+    while (digits < text.size() && std::isdigit(static_cast<unsigned char>(text[digits]))) {
+        ++digits;
+    }
+    if (digits == 0 || digits > 9 || text.size() - digits > 1) {
+        return -1;
+    }
+    long value = std::stol(text.substr(0, digits));
+    char unit = digits < text.size() ? text[digits] : 's';
+    switch (unit) {
+        case 's': return value;
+        case 'm': return value * 60;
+        case 'h': return value * 3600;
+        case 'd': return value * 86400;
+        default: return -1;
+    }
+}
+
+} // namespace services
+} // namespace ak
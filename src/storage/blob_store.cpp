@@ -0,0 +1,522 @@
+#include "storage/blob_store.hpp"
+#include "crypto/aead.hpp"
+#include "crypto/crypto.hpp"
+#include "storage/key_table.hpp"
+#include "storage/vault.hpp"
+#include "system/system.hpp"
+
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace ak {
+namespace storage {
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// File layout, integers little endian:
+//   "AKB1" | u8 sealed | 3 reserved | u64 size | u32 chunk size | u32 segments
+//   then per segment: u32 length | bytes
+// A sealed segment opens to: blob id | u32 index | u8 last | data, so
+// segments cannot be reordered, moved between blobs or cut off unnoticed.
+const char MAGIC[4] = {'A', 'K', 'B', '1'};
+const size_t HEADER_SIZE = 24;
+const size_t ID_LEN = 32;
+const size_t SEGMENT_PREFIX = ID_LEN + 4 + 1;
+const char REF_PREFIX[] = "\x01" "ak-blob ";
+// A reference may be saved a moment after its blob is written
+const auto GC_GRACE = std::chrono::minutes(10);
+
+void putU32(std::string& out, uint32_t v) {
+    for (int i = 0; i < 4; ++i) {
+        out += static_cast<char>((v >> (8 * i)) & 0xff);
+    }
+}
+
+void putU64(std::string& out, uint64_t v) {
+    for (int i = 0; i < 8; ++i) {
+        out += static_cast<char>((v >> (8 * i)) & 0xff);
+    }
+}
+
+uint64_t getLE(const char* p, int bytes) {
+    uint64_t v = 0;
+    for (int i = bytes - 1; i >= 0; --i) {
+        v = (v << 8) | static_cast<unsigned char>(p[i]);
+    }
+    return v;
+}
+
+bool isBlobId(const std::string& s) {
+    return s.size() == ID_LEN && s.find_first_not_of("0123456789abcdef") == std::string::npos;
+}
+
+std::string randomId() {
+    std::random_device rd;
+    std::string id;
+    for (int i = 0; i < 4; ++i) {
+        char buf[9];
+        std::snprintf(buf, sizeof(buf), "%08x", static_cast<unsigned>(rd()));
+        id += buf;
+    }
+    return id;
+}
+
+// A new owner-only file written front to back, with the header patched in
+// at the end: descriptor writes and an fsync where POSIX is available, an
+// ofstream elsewhere
+class BlobFile {
+public:
+    explicit BlobFile(const std::string& path) {
+#if defined(__unix__) || defined(__APPLE__)
+        fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+        if (fd_ < 0) {
+            throw std::runtime_error("Failed to create " + path);
+        }
+#else
+        out_.open(path, std::ios::binary | std::ios::trunc);
+        if (!out_) {
+            throw std::runtime_error("Failed to create " + path);
+        }
+#endif
+    }
+    ~BlobFile() { close(); }
+    BlobFile(const BlobFile&) = delete;
+    BlobFile& operator=(const BlobFile&) = delete;
+
+    bool write(const char* data, size_t size) {
+#if defined(__unix__) || defined(__APPLE__)
+        while (size > 0) {
+            ssize_t n = ::write(fd_, data, size);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                return false;
+            }
+            data += n;
+            size -= static_cast<size_t>(n);
+        }
+        return true;
+#else
+        return static_cast<bool>(out_.write(data, static_cast<std::streamsize>(size)));
+#endif
+    }
+
+    // Overwrites the start of the file, then syncs and closes it
+    bool finish(const std::string& header) {
+#if defined(__unix__) || defined(__APPLE__)
+        bool good = ::pwrite(fd_, header.data(), header.size(), 0) == static_cast<ssize_t>(header.size()) &&
+                    ::fsync(fd_) == 0;
+#else
+        bool good = static_cast<bool>(out_.seekp(0)) && write(header.data(), header.size()) && out_.flush();
+#endif
+        return close() && good;
+    }
+
+private:
+    bool close() {
+#if defined(__unix__) || defined(__APPLE__)
+        if (fd_ < 0) {
+            return true;
+        }
+        bool good = ::close(fd_) == 0;
+        fd_ = -1;
+        return good;
+#else
+        if (!out_.is_open()) {
+            return true;
+        }
+        out_.close();
+        return !out_.fail();
+#endif
+    }
+
+#if defined(__unix__) || defined(__APPLE__)
+    int fd_ = -1;
+#else
+    std::ofstream out_;
+#endif
+};
+
+size_t readChunk(std::istream& in, std::string& buffer) {
+    in.read(&buffer[0], static_cast<std::streamsize>(buffer.size()));
+    return static_cast<size_t>(in.gcount());
+}
+
+// Read-only mapping of a whole file, unmapped on destruction; read into
+// memory where mmap is not available
+class MappedFile {
+public:
+#if defined(__unix__) || defined(__APPLE__)
+    explicit MappedFile(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return;
+        }
+        struct stat st;
+        if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+            size_ = static_cast<size_t>(st.st_size);
+            void* map = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (map != MAP_FAILED) {
+                data_ = static_cast<const char*>(map);
+                ::madvise(map, size_, MADV_SEQUENTIAL);
+            }
+        }
+        ::close(fd);
+    }
+    ~MappedFile() {
+        if (data_) {
+            ::munmap(const_cast<char*>(data_), size_);
+        }
+    }
+#else
+    explicit MappedFile(const std::string& path) {
+        std::ifstream in(path, std::ios::binary);
+        if (in) {
+            contents_.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+            data_ = contents_.data();
+            size_ = contents_.size();
+        }
+    }
+#endif
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    std::string_view view() const { return data_ ? std::string_view(data_, size_) : std::string_view(); }
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+#if !defined(__unix__) && !defined(__APPLE__)
+    std::string contents_;
+#endif
+};
+
+} // namespace
+
+std::string formatBlobRef(const BlobRef& ref) {
+    return REF_PREFIX + ref.id + " " + std::to_string(ref.size);
+}
+
+bool parseBlobRef(std::string_view value, BlobRef& ref) {
+    std::string_view prefix(REF_PREFIX);
+    if (value.size() <= prefix.size() + ID_LEN + 1 || value.substr(0, prefix.size()) != prefix) {
+        return false;
+    }
+    value.remove_prefix(prefix.size());
+    std::string id(value.substr(0, ID_LEN));
+    std::string_view size = value.substr(ID_LEN);
+    if (!isBlobId(id) || size[0] != ' ' || size.size() < 2 || size.size() > 21 ||
+        size.find_first_not_of("0123456789", 1) != std::string_view::npos) {
+        return false;
+    }
+    ref.id = std::move(id);
+    ref.size = std::stoull(std::string(size.substr(1)));
+    return true;
+}
+
+std::string BlobStore::dir(const core::Config& cfg) {
+    return cfg.configDir + "/blobs";
+}
+
+BlobStore::BlobStore(const core::Config& cfg, std::string passphrase)
+    : dir_(dir(cfg)), passphrase_(std::move(passphrase)), sealed_(activeBackend(cfg) != Backend::Plain) {}
+
+std::string BlobStore::path(const std::string& id) const {
+    return dir_ + "/" + id;
+}
+
+namespace {
+
+// Writes a blob file under a private tmp name; commit() renames it into
+// place with the totals in its header
+class SegmentWriter {
+public:
+    SegmentWriter(std::string target, std::string id, const std::string& passphrase, bool sealed)
+        : target_(std::move(target)), tmp_(system::uniqueTmpPath(target_)), id_(std::move(id)),
+          passphrase_(passphrase), sealed_(sealed), file_(std::make_unique<BlobFile>(tmp_)) {
+        std::string header(HEADER_SIZE, '\0');
+        good_ = file_->write(header.data(), header.size());
+    }
+    ~SegmentWriter() {
+        if (file_) {
+            file_.reset();
+            std::error_code ec;
+            fs::remove(tmp_, ec);
+        }
+    }
+    SegmentWriter(const SegmentWriter&) = delete;
+    SegmentWriter& operator=(const SegmentWriter&) = delete;
+
+    void add(std::string_view data, bool last) {
+        std::string sealed;
+        if (sealed_) {
+            std::string plain = id_;
+            putU32(plain, segments_);
+            plain += last ? '\1' : '\0';
+            plain.append(data);
+            sealed = crypto::aeadSeal(plain, passphrase_);
+            crypto::secureZero(&plain[0], plain.size());
+            size_ += data.size();
+            data = sealed;
+        } else {
+            size_ += data.size();
+        }
+        std::string length;
+        putU32(length, static_cast<uint32_t>(data.size()));
+        good_ = good_ && file_->write(length.data(), length.size()) && file_->write(data.data(), data.size());
+        ++segments_;
+    }
+
+    // Throws std::runtime_error when anything failed to reach the disk
+    void commit(bool good) {
+        std::string header(MAGIC, sizeof(MAGIC));
+        header += sealed_ ? '\1' : '\0';
+        header.append(3, '\0');
+        putU64(header, size_);
+        putU32(header, static_cast<uint32_t>(BLOB_CHUNK_SIZE));
+        putU32(header, segments_);
+        good = file_->finish(header) && good && good_;
+        file_.reset();
+        std::error_code ec;
+        if (good) {
+            fs::rename(tmp_, target_, ec);
+        }
+        if (!good || ec) {
+            fs::remove(tmp_, ec);
+            throw std::runtime_error("Failed to write blob " + target_);
+        }
+    }
+
+    uint64_t size() const { return size_; }
+
+private:
+    std::string target_;
+    std::string tmp_;
+    std::string id_;
+    const std::string& passphrase_;
+    bool sealed_;
+    std::unique_ptr<BlobFile> file_; // null once committed
+    bool good_ = false;
+    uint32_t segments_ = 0;
+    uint64_t size_ = 0;
+};
+
+} // namespace
+
+BlobRef BlobStore::put(std::istream& in) {
+    if (sealed_ && !crypto::aeadAvailable()) {
+        throw std::runtime_error("Sealing blob values needs a build with AEAD support (OpenSSL)");
+    }
+    if (sealed_ && passphrase_.empty()) {
+        throw std::runtime_error("A passphrase is required to encrypt blob values (set AK_PASSPHRASE)");
+    }
+    std::error_code ec;
+    fs::create_directories(dir_, ec);
+    BlobRef ref;
+    ref.id = randomId();
+    SegmentWriter writer(path(ref.id), ref.id, passphrase_, sealed_);
+
+    // One chunk of look-ahead tells whether the current one is the last
+    std::string current(BLOB_CHUNK_SIZE, '\0');
+    std::string next(BLOB_CHUNK_SIZE, '\0');
+    size_t currentLen = readChunk(in, current);
+    while (true) {
+        size_t nextLen = currentLen == BLOB_CHUNK_SIZE ? readChunk(in, next) : 0;
+        bool last = nextLen == 0;
+        writer.add(std::string_view(current.data(), currentLen), last);
+        if (last) {
+            break;
+        }
+        current.swap(next);
+        currentLen = nextLen;
+    }
+    crypto::secureZero(&current[0], current.size());
+    crypto::secureZero(&next[0], next.size());
+    writer.commit(!in.bad());
+    ref.size = writer.size();
+    return ref;
+}
+
+bool BlobStore::stream(const BlobRef& ref, const std::function<bool(std::string_view)>& sink) const {
+    BlobInfo info;
+    return readSegments(ref.id, info, [&](std::string_view piece, bool) { return sink(piece); }) &&
+           info.size == ref.size;
+}
+
+bool BlobStore::readSegments(const std::string& id, BlobInfo& info,
+                             const std::function<bool(std::string_view, bool)>& sink) const {
+    if (!isBlobId(id)) {
+        return false;
+    }
+    MappedFile file(path(id));
+    std::string_view data = file.view();
+    if (data.size() < HEADER_SIZE || data.substr(0, 4) != std::string_view(MAGIC, 4)) {
+        return false;
+    }
+    info.sealed = data[4] == '\1';
+    info.size = getLE(data.data() + 8, 8);
+    uint64_t segments = getLE(data.data() + 20, 4);
+    if (segments == 0 || (info.sealed && passphrase_.empty())) {
+        return false;
+    }
+    data.remove_prefix(HEADER_SIZE);
+
+    uint64_t seen = 0;
+    for (uint32_t index = 0; index < segments; ++index) {
+        if (data.size() < 4 || data.size() - 4 < getLE(data.data(), 4)) {
+            return false;
+        }
+        std::string_view segment = data.substr(4, getLE(data.data(), 4));
+        data.remove_prefix(4 + segment.size());
+        bool last = index + 1 == segments;
+        if (!info.sealed) {
+            seen += segment.size();
+            if (!sink(segment, last)) {
+                return true;
+            }
+            continue;
+        }
+        std::string plain;
+        if (!crypto::aeadOpen(std::string(segment), passphrase_, plain)) {
+            return false;
+        }
+        bool fits = plain.size() >= SEGMENT_PREFIX && plain.compare(0, ID_LEN, id) == 0 &&
+                    getLE(plain.data() + ID_LEN, 4) == index && plain[ID_LEN + 4] == (last ? '\1' : '\0');
+        bool more = true;
+        if (fits) {
+            std::string_view value = std::string_view(plain).substr(SEGMENT_PREFIX);
+            seen += value.size();
+            more = sink(value, last);
+        }
+        crypto::secureZero(&plain[0], plain.size());
+        if (!fits) {
+            return false;
+        }
+        if (!more) {
+            return true;
+        }
+    }
+    return seen == info.size;
+}
+
+std::vector<std::string> BlobStore::ids() const {
+    std::vector<std::string> out;
+    std::error_code ec;
+    for (fs::directory_iterator it(dir_, ec), end; !ec && it != end; it.increment(ec)) {
+        std::string name = it->path().filename().string();
+        if (isBlobId(name)) {
+            out.push_back(name);
+        }
+    }
+    return out;
+}
+
+bool BlobStore::reseal(const std::string& id, const BlobStore& from) {
+    BlobInfo info;
+    auto all = [](std::string_view, bool) { return true; };
+    if (readSegments(id, info, all) && info.sealed == sealed_) {
+        return true;
+    }
+    if (!from.readSegments(id, info, all)) {
+        return false;
+    }
+    if (sealed_ && passphrase_.empty()) {
+        throw std::runtime_error("A passphrase is required to encrypt blob values (set AK_PASSPHRASE)");
+    }
+    SegmentWriter writer(path(id), id, passphrase_, sealed_);
+    bool read = from.readSegments(id, info, [&](std::string_view piece, bool last) {
+        writer.add(piece, last);
+        return true;
+    });
+    writer.commit(read);
+    return readSegments(id, info, all);
+}
+
+bool BlobStore::read(const BlobRef& ref, std::string& value) const {
+    std::string out;
+    out.reserve(ref.size);
+    bool ok = stream(ref, [&](std::string_view piece) {
+        out.append(piece);
+        return true;
+    });
+    if (!ok) {
+        crypto::secureZero(&out[0], out.size());
+        return false;
+    }
+    value = std::move(out);
+    return true;
+}
+
+size_t BlobStore::collectGarbage(const std::set<std::string>& live) {
+    size_t removed = 0;
+    auto cutoff = fs::file_time_type::clock::now() - GC_GRACE;
+    std::error_code ec;
+    for (fs::directory_iterator it(dir_, ec), end; !ec && it != end; it.increment(ec)) {
+        std::string name = it->path().filename().string();
+        std::error_code timeEc;
+        auto written = it->last_write_time(timeEc);
+        if (!isBlobId(name) || live.count(name) || timeEc || written > cutoff) {
+            continue;
+        }
+        std::error_code rmEc;
+        if (fs::remove(it->path(), rmEc)) {
+            ++removed;
+        }
+    }
+    return removed;
+}
+
+bool resolveBlobValue(const core::Config& cfg, std::string& value) {
+    BlobRef ref;
+    if (!parseBlobRef(value, ref)) {
+        return true;
+    }
+    std::string passphrase = activeBackend(cfg) == Backend::Plain ? cfg.presetPassphrase : sealingPassphrase(cfg);
+    return BlobStore(cfg, passphrase).read(ref, value);
+}
+
+size_t collectBlobGarbage(const core::Config& cfg) {
+    std::set<std::string> live;
+    auto collect = [&](const KeyTable& table) {
+        for (const auto& entry : table.entries()) {
+            BlobRef ref;
+            if (parseBlobRef(entry.value, ref)) {
+                live.insert(ref.id);
+            }
+        }
+    };
+    KeyTable vault;
+    if (!tryLoadVaultTable(cfg, vault)) {
+        return 0;
+    }
+    collect(vault);
+    for (const auto& profile : listProfiles(cfg)) {
+        KeyTable table;
+        if (!tryLoadProfileKeyTable(cfg, profile, table)) {
+            return 0;
+        }
+        collect(table);
+    }
+    return BlobStore(cfg, "").collectGarbage(live);
+}
+
+} // namespace storage
+} // namespace ak
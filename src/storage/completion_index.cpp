@@ -0,0 +1,155 @@
+#include "storage/completion_index.hpp"
+#include "system/system.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace ak {
+namespace storage {
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// First line of the file; sections follow as a header line
+// "=<context> <exists> <mtime> <size> <scannedAt> <source path>" and then one
+// name per line
+const char HEADER[] = "ak-completion 1";
+
+long long nowNanos() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::system_clock::now().time_since_epoch())
+        .count();
+}
+
+// Names that would break the line format are left out
+bool indexable(const std::string& name) {
+    return !name.empty() && name[0] != '=' && name.find('\n') == std::string::npos;
+}
+
+} // namespace
+
+CompletionIndex::CompletionIndex(const core::Config& cfg) : path_(path(cfg)) {
+    std::ifstream in(path_);
+    std::string line;
+    if (!std::getline(in, line) || line != HEADER) {
+        return;
+    }
+    Section* current = nullptr;
+    while (std::getline(in, line)) {
+        if (line.empty()) {
+            continue;
+        }
+        if (line[0] != '=') {
+            if (!current) {
+                sections_.clear();
+                return;
+            }
+            current->names.push_back(line);
+            continue;
+        }
+        std::istringstream header(line.substr(1));
+        std::string context;
+        Section section;
+        int exists = 0;
+        if (!(header >> context >> exists >> section.source.mtime >> section.source.size >> section.scannedAt)) {
+            sections_.clear();
+            return;
+        }
+        section.source.exists = exists != 0;
+        header.get();
+        std::getline(header, section.sourcePath);
+        current = &(sections_[context] = std::move(section));
+    }
+}
+
+std::string CompletionIndex::path(const core::Config& cfg) {
+    return cfg.persistDir + "/completion.idx";
+}
+
+bool CompletionIndex::fresh(const std::string& context, const PathStamp& source) const {
+    auto it = sections_.find(context);
+    if (it == sections_.end() || !(it->second.source == source)) {
+        return false;
+    }
+    return !source.exists || source.mtime + MetadataCache::RACY_WINDOW < it->second.scannedAt;
+}
+
+void CompletionIndex::set(const std::string& context, const std::string& sourcePath, std::vector<std::string> names) {
+    names.erase(std::remove_if(names.begin(), names.end(), [](const std::string& n) { return !indexable(n); }),
+                names.end());
+    std::sort(names.begin(), names.end());
+    names.erase(std::unique(names.begin(), names.end()), names.end());
+
+    Section section;
+    section.sourcePath = sourcePath;
+    section.source = stampPath(sourcePath);
+    section.scannedAt = nowNanos();
+    section.names = std::move(names);
+
+    auto it = sections_.find(context);
+    // Rewriting only to move scannedAt forward is worth it while the old
+    // record is racy, since every lookup would re-read the source otherwise
+    if (it != sections_.end() && it->second.sourcePath == section.sourcePath && it->second.names == section.names &&
+        fresh(context, section.source)) {
+        return;
+    }
+    sections_[context] = std::move(section);
+    changed_ = true;
+}
+
+std::vector<std::string> CompletionIndex::match(const std::string& context, const std::string& prefix) const {
+    std::vector<std::string> out;
+    auto it = sections_.find(context);
+    if (it == sections_.end()) {
+        return out;
+    }
+    const Section& section = it->second;
+    if (!section.sourcePath.empty() && section.source.exists && !stampPath(section.sourcePath).exists) {
+        return out;
+    }
+    auto first = std::lower_bound(section.names.begin(), section.names.end(), prefix);
+    for (auto n = first; n != section.names.end() && n->compare(0, prefix.size(), prefix) == 0; ++n) {
+        out.push_back(*n);
+    }
+    return out;
+}
+
+void CompletionIndex::save() {
+    if (!changed_) {
+        return;
+    }
+    changed_ = false;
+    std::string data = HEADER;
+    data += '\n';
+    for (const auto& [context, section] : sections_) {
+        data += "=" + context + " " + (section.source.exists ? "1" : "0") + " " + std::to_string(section.source.mtime) +
+                " " + std::to_string(section.source.size) + " " + std::to_string(section.scannedAt) + " " +
+                section.sourcePath + "\n";
+        for (const auto& name : section.names) {
+            data += name;
+            data += '\n';
+        }
+    }
+
+    std::error_code ec;
+    fs::create_directories(fs::path(path_).parent_path(), ec);
+    try {
+        system::writeFileAtomic(path_, data);
+    } catch (const std::runtime_error&) {
+        // Only an index: the next completion rebuilds it
+    }
+}
+
+void recordVaultNames(const core::Config& cfg, std::vector<std::string> names) {
+    CompletionIndex index(cfg);
+    index.set("keys", cfg.vaultPath.get(), std::move(names));
+    index.save();
+}
+
+} // namespace storage
+} // namespace ak
@@ -0,0 +1,231 @@
+#include "storage/content_store.hpp"
+#include "crypto/crypto.hpp"
+#include "crypto/aead.hpp"
+#include "system/system.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+
+namespace ak {
+namespace storage {
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// First line of a manifest; "NAME\t<digest>" lines follow
+const char HEADER[] = "ak-manifest 1";
+// Sealed once per store so every later process checks its passphrase (and
+// picks up the store's KDF salt) from one small file
+const char KEY_SENTINEL[] = "key.akv";
+const char SENTINEL_TEXT[] = "ak-objects\n";
+
+std::string readFile(const fs::path& path) {
+    std::ifstream in(path, std::ios::binary);
+    std::ostringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+}
+
+bool isDigest(const std::string& s) {
+    return s.size() == 64 && s.find_first_not_of("0123456789abcdef") == std::string::npos;
+}
+
+} // namespace
+
+bool contentStoreEnabled(const core::Config& cfg) {
+    return cfg.contentStore && activeBackend(cfg) != Backend::Gpg;
+}
+
+std::string ContentStore::dir(const core::Config& cfg) {
+    return cfg.profilesDir + "/objects";
+}
+
+ContentStore::ContentStore(const core::Config& cfg, std::string passphrase)
+    : dir_(dir(cfg)), passphrase_(std::move(passphrase)), sealed_(activeBackend(cfg) == Backend::Aead) {}
+
+std::string ContentStore::digest(std::string_view value) {
+    if (salt_.empty()) {
+        fs::path saltPath = fs::path(dir_) / "salt";
+        salt_ = readFile(saltPath);
+        if (salt_.empty()) {
+            std::error_code ec;
+            fs::create_directories(dir_, ec);
+            std::random_device rd;
+            std::string fresh;
+            for (int i = 0; i < 8; ++i) {
+                uint32_t word = rd();
+                fresh.append(reinterpret_cast<const char*>(&word), sizeof(word));
+            }
+            fresh = crypto::base64Encode(fresh);
+            // Another process may have won the race; keep whichever landed
+            if (!fs::exists(saltPath)) {
+                system::writeFileAtomic(saltPath, fresh);
+            }
+            salt_ = readFile(saltPath);
+        }
+    }
+    crypto::SHA256 hasher;
+    hasher.update(salt_);
+    hasher.update(reinterpret_cast<const uint8_t*>(value.data()), value.size());
+    return hasher.final();
+}
+
+std::string ContentStore::objectPath(const std::string& digest) const {
+    return dir_ + "/" + digest.substr(0, 2) + "/" + digest.substr(2);
+}
+
+void ContentStore::primeKey() {
+    if (primed_ || !sealed_) {
+        return;
+    }
+    if (passphrase_.empty()) {
+        throw std::runtime_error("A passphrase is required to encrypt profile values (set AK_PASSPHRASE)");
+    }
+    fs::path sentinel = fs::path(dir_) / KEY_SENTINEL;
+    std::string sealed = readFile(sentinel);
+    if (sealed.empty()) {
+        std::error_code ec;
+        fs::create_directories(dir_, ec);
+        system::writeFileAtomic(sentinel, crypto::aeadSeal(SENTINEL_TEXT, passphrase_));
+    } else {
+        std::string text;
+        if (!crypto::aeadOpen(sealed, passphrase_, text)) {
+            throw std::runtime_error("The passphrase does not open the content store in " + dir_);
+        }
+    }
+    primed_ = true;
+}
+
+std::string ContentStore::put(const std::string& value) {
+    std::string id = digest(value);
+    std::string path = objectPath(id);
+    std::string want = sealed_ ? path + ".akv" : path;
+    std::string other = sealed_ ? path : path + ".akv";
+    std::error_code ec;
+    if (fs::exists(want, ec)) {
+        return id;
+    }
+    fs::create_directories(fs::path(path).parent_path(), ec);
+    if (sealed_) {
+        primeKey();
+        system::writeFileAtomic(want, crypto::aeadSeal(value, passphrase_));
+    } else {
+        system::writeFileAtomic(want, value);
+    }
+    // Written under another backend before a switch (`ak migrate`)
+    fs::remove(other, ec);
+    return id;
+}
+
+bool ContentStore::get(const std::string& digest, std::string& value) {
+    if (!isDigest(digest)) {
+        return false;
+    }
+    std::string path = objectPath(digest);
+    std::error_code ec;
+    if (fs::exists(path + ".akv", ec)) {
+        return !passphrase_.empty() && crypto::aeadOpen(readFile(path + ".akv"), passphrase_, value);
+    }
+    if (!fs::exists(path, ec)) {
+        return false;
+    }
+    value = readFile(path);
+    return true;
+}
+
+size_t ContentStore::collectGarbage(const std::set<std::string>& live) {
+    size_t removed = 0;
+    std::error_code ec;
+    for (fs::directory_iterator shard(dir_, ec), end; !ec && shard != end; shard.increment(ec)) {
+        if (!shard->is_directory() || shard->path().filename().string().size() != 2) {
+            continue;
+        }
+        std::string prefix = shard->path().filename().string();
+        std::error_code iterEc;
+        for (fs::directory_iterator it(shard->path(), iterEc), last; !iterEc && it != last; it.increment(iterEc)) {
+            std::string name = it->path().filename().string();
+            if (name.size() > 4 && name.compare(name.size() - 4, 4, ".tmp") == 0) {
+                continue;
+            }
+            std::string id = prefix + name.substr(0, 62);
+            if (!live.count(id)) {
+                std::error_code rmEc;
+                if (fs::remove(it->path(), rmEc)) {
+                    ++removed;
+                }
+            }
+        }
+        std::error_code rmEc;
+        fs::remove(shard->path(), rmEc);  // only succeeds once empty
+    }
+    return removed;
+}
+
+void ContentStore::stats(size_t& objects, unsigned long long& bytes) const {
+    objects = 0;
+    bytes = 0;
+    std::error_code ec;
+    for (fs::recursive_directory_iterator it(dir_, ec), end; !ec && it != end; it.increment(ec)) {
+        if (it.depth() == 1 && it->is_regular_file()) {
+            ++objects;
+            std::error_code sizeEc;
+            auto size = it->file_size(sizeEc);
+            bytes += sizeEc ? 0 : size;
+        }
+    }
+}
+
+bool readManifest(const std::string& path, Manifest& manifest) {
+    std::ifstream in(path);
+    std::string line;
+    if (!std::getline(in, line) || line != HEADER) {
+        return false;
+    }
+    manifest.clear();
+    while (std::getline(in, line)) {
+        auto tab = line.find('\t');
+        if (tab == std::string::npos) {
+            continue;
+        }
+        manifest[line.substr(0, tab)] = line.substr(tab + 1);
+    }
+    return true;
+}
+
+void writeManifest(const std::string& path, const Manifest& manifest) {
+    std::string data = HEADER;
+    data += '\n';
+    for (const auto& [name, id] : manifest) {
+        data += name;
+        data += '\t';
+        data += id;
+        data += '\n';
+    }
+    system::writeFileAtomic(path, data);
+}
+
+std::set<std::string> liveDigests(const core::Config& cfg) {
+    std::set<std::string> live;
+    std::error_code ec;
+    for (fs::directory_iterator it(cfg.profilesDir, ec), end; !ec && it != end; it.increment(ec)) {
+        std::string name = it->path().filename().string();
+        std::string suffix = std::string(".keys") + MANIFEST_SUFFIX;
+        if (name.size() <= suffix.size() || name.compare(name.size() - suffix.size(), suffix.size(), suffix) != 0) {
+            continue;
+        }
+        Manifest manifest;
+        if (readManifest(it->path().string(), manifest)) {
+            for (const auto& [key, id] : manifest) {
+                live.insert(id);
+            }
+        }
+    }
+    return live;
+}
+
+} // namespace storage
+} // namespace ak
@@ -0,0 +1,583 @@
+#include "storage/importer.hpp"
+#include "core/config.hpp"
+#include "core/metrics.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <stdexcept>
+
+namespace ak {
+namespace storage {
+
+namespace {
+
+constexpr size_t CHUNK_SIZE = 64 * 1024;
+
+bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+bool isLiteralChar(char c) {
+    return std::isalnum(static_cast<unsigned char>(c)) || c == '-' || c == '+' || c == '.';
+}
+
+size_t indentOf(const std::string& line) {
+    size_t n = 0;
+    while (n < line.size() && (line[n] == ' ' || line[n] == '\t')) {
+        ++n;
+    }
+    return n;
+}
+
+void appendUtf8(std::string& out, unsigned cp) {
+    if (cp < 0x80) {
+        out += static_cast<char>(cp);
+    } else if (cp < 0x800) {
+        out += static_cast<char>(0xC0 | (cp >> 6));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        out += static_cast<char>(0xE0 | (cp >> 12));
+        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (cp >> 18));
+        out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    }
+}
+
+// Decode a double-quoted scalar starting after its opening quote. Returns
+// true when the closing quote was found (`end` is just past it).
+bool decodeDoubleQuoted(const std::string& s, size_t from, std::string& out, size_t& end) {
+    for (size_t i = from; i < s.size(); ++i) {
+        char c = s[i];
+        if (c == '"') {
+            end = i + 1;
+            return true;
+        }
+        if (c != '\\' || i + 1 == s.size()) {
+            out += c;
+            continue;
+        }
+        char next = s[++i];
+        switch (next) {
+            case 'n': out += '\n'; break;
+            case 't': out += '\t'; break;
+            case 'r': out += '\r'; break;
+            case '"': out += '"'; break;
+            case '\\': out += '\\'; break;
+            case '$': out += '$'; break;
+            default:
+                out += '\\';
+                out += next;
+                break;
+        }
+    }
+    end = s.size();
+    return false;
+}
+
+// Shell lines an .env file may contain that never define a variable
+bool isShellConstruct(const std::string& line) {
+    return line.rfind("alias ", 0) == 0 || line.rfind("function ", 0) == 0 || line.rfind("if ", 0) == 0 ||
+           line.rfind("case ", 0) == 0 || line.rfind("for ", 0) == 0 || line.rfind("while ", 0) == 0 ||
+           line.find("[[") != std::string::npos || line.find("$(") != std::string::npos;
+}
+
+} // namespace
+
+bool isValidKeyName(std::string_view name) {
+    if (name.empty() || (!std::isalpha(static_cast<unsigned char>(name[0])) && name[0] != '_')) {
+        return false;
+    }
+    for (char c : name) {
+        if (!std::isalnum(static_cast<unsigned char>(c)) && c != '_') {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool parseImportFormat(const std::string& name, ImportFormat& format) {
+    if (name == "env" || name == "dotenv") {
+        format = ImportFormat::Env;
+    } else if (name == "json") {
+        format = ImportFormat::Json;
+    } else if (name == "yaml" || name == "yml") {
+        format = ImportFormat::Yaml;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+ImportParser::ImportParser(ImportFormat format, Sink sink) : format_(format), sink_(std::move(sink)) {
+}
+
+void ImportParser::emit(std::string name, std::string value) {
+    if (isValidKeyName(name)) {
+        sink_(std::move(name), std::move(value));
+    }
+}
+
+void ImportParser::feed(std::string_view chunk) {
+    if (format_ != ImportFormat::Json) {
+        feedLines(chunk);
+        return;
+    }
+    size_t i = 0;
+    while (i < chunk.size()) {
+        // Copy plain string runs in one go; most of a dump is string bodies
+        if (state_ == JsonState::String) {
+            size_t j = i;
+            while (j < chunk.size() && chunk[j] != '"' && chunk[j] != '\\' &&
+                   static_cast<unsigned char>(chunk[j]) >= 0x20) {
+                ++j;
+            }
+            token_.append(chunk.data() + i, j - i);
+            i = j;
+            if (i == chunk.size()) {
+                break;
+            }
+        }
+        jsonChar(chunk[i++]);
+    }
+}
+
+void ImportParser::finish() {
+    if (format_ == ImportFormat::Json) {
+        if (state_ == JsonState::Literal) {
+            jsonScalar(std::move(token_));
+        }
+        if (!stack_.empty() || state_ != JsonState::Value) {
+            jsonFail("unexpected end of input");
+        }
+        return;
+    }
+
+    if (!pending_.empty()) {
+        std::string last;
+        last.swap(pending_);
+        if (format_ == ImportFormat::Env) {
+            envLine(last);
+        } else {
+            yamlLine(last);
+        }
+    }
+    if (format_ == ImportFormat::Env && envOpen_) {
+        throw std::runtime_error("Unterminated quoted value for " + envName_);
+    }
+    if (format_ == ImportFormat::Yaml) {
+        flushYamlBlock();
+    }
+}
+
+void ImportParser::feedLines(std::string_view chunk) {
+    while (!chunk.empty()) {
+        size_t nl = chunk.find('\n');
+        if (nl == std::string_view::npos) {
+            pending_.append(chunk.data(), chunk.size());
+            return;
+        }
+        std::string line;
+        if (pending_.empty()) {
+            line.assign(chunk.data(), nl);
+        } else {
+            pending_.append(chunk.data(), nl);
+            line.swap(pending_);
+        }
+        chunk.remove_prefix(nl + 1);
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (format_ == ImportFormat::Env) {
+            envLine(line);
+        } else {
+            yamlLine(line);
+        }
+        ++line_;
+    }
+}
+
+// ---- env -------------------------------------------------------------------
+
+void ImportParser::envLine(const std::string& line) {
+    if (envOpen_) {
+        size_t end = 0;
+        if (decodeDoubleQuoted(line, 0, envValue_, end)) {
+            envOpen_ = false;
+            emit(std::move(envName_), std::move(envValue_));
+            envName_.clear();
+            envValue_.clear();
+        } else {
+            envValue_ += '\n';
+        }
+        return;
+    }
+
+    std::string trimmed = core::trim(line);
+    if (trimmed.empty() || trimmed[0] == '#' || isShellConstruct(trimmed)) {
+        return;
+    }
+    if (trimmed.rfind("export ", 0) == 0) {
+        trimmed.erase(0, 7);
+    }
+    size_t eq = trimmed.find('=');
+    if (eq == std::string::npos) {
+        return;
+    }
+    std::string name = core::trim(trimmed.substr(0, eq));
+    if (!isValidKeyName(name)) {
+        return;
+    }
+
+    std::string rest = trimmed.substr(eq + 1);
+    if (!rest.empty() && rest[0] == '"') {
+        std::string value;
+        size_t end = 0;
+        if (decodeDoubleQuoted(rest, 1, value, end)) {
+            emit(std::move(name), std::move(value));
+        } else {
+            // Carries on over the following lines until the closing quote
+            envOpen_ = true;
+            envName_ = std::move(name);
+            envValue_ = std::move(value) + '\n';
+        }
+        return;
+    }
+    if (rest.size() >= 2 && rest.front() == '\'' && rest.back() == '\'') {
+        rest = rest.substr(1, rest.size() - 2);
+    }
+    emit(std::move(name), std::move(rest));
+}
+
+// ---- yaml ------------------------------------------------------------------
+
+void ImportParser::flushYamlBlock() {
+    if (!blockStyle_) {
+        return;
+    }
+    while (!blockLines_.empty() && core::trim(blockLines_.back()).empty()) {
+        blockLines_.pop_back();
+    }
+    size_t indent = std::string::npos;
+    for (const auto& l : blockLines_) {
+        if (!core::trim(l).empty()) {
+            indent = std::min(indent, indentOf(l));
+        }
+    }
+    std::string value;
+    for (size_t i = 0; i < blockLines_.size(); ++i) {
+        const auto& l = blockLines_[i];
+        std::string text = l.size() > indent ? l.substr(indent) : "";
+        if (i > 0) {
+            // Folded scalars join lines with spaces; blank lines stay breaks
+            value += (blockStyle_ == '>' && !text.empty() && !blockLines_[i - 1].empty()) ? ' ' : '\n';
+        }
+        value += text;
+    }
+    if (blockKeepNewline_ && !value.empty()) {
+        value += '\n';
+    }
+    blockStyle_ = 0;
+    blockLines_.clear();
+    emit(std::move(blockName_), std::move(value));
+    blockName_.clear();
+}
+
+void ImportParser::yamlLine(const std::string& line) {
+    size_t indent = indentOf(line);
+    if (blockStyle_) {
+        if (core::trim(line).empty()) {
+            blockLines_.emplace_back();
+            return;
+        }
+        if (indent > blockIndent_) {
+            blockLines_.push_back(line);
+            return;
+        }
+        flushYamlBlock();
+    }
+
+    std::string t = core::trim(line);
+    if (t.empty() || t[0] == '#' || t == "---" || t == "...") {
+        return;
+    }
+    if (t.rfind("- ", 0) == 0) {
+        t = core::trim(t.substr(2));
+    }
+    size_t colon = t.find(':');
+    if (colon == std::string::npos) {
+        return;
+    }
+    std::string name = core::trim(t.substr(0, colon));
+    if (name.size() >= 2 && (name.front() == '"' || name.front() == '\'') && name.back() == name.front()) {
+        name = name.substr(1, name.size() - 2);
+    }
+    std::string rest = core::trim(t.substr(colon + 1));
+    if (rest.empty()) {
+        return; // parent of a nested mapping
+    }
+
+    if (rest[0] == '|' || rest[0] == '>') {
+        blockName_ = std::move(name);
+        blockStyle_ = rest[0];
+        blockKeepNewline_ = rest.find('-') == std::string::npos;
+        blockIndent_ = indent;
+        return;
+    }
+
+    std::string value;
+    if (rest[0] == '"') {
+        size_t end = 0;
+        decodeDoubleQuoted(rest, 1, value, end);
+    } else if (rest[0] == '\'') {
+        for (size_t i = 1; i < rest.size(); ++i) {
+            if (rest[i] == '\'') {
+                if (i + 1 < rest.size() && rest[i + 1] == '\'') {
+                    value += '\'';
+                    ++i;
+                    continue;
+                }
+                break;
+            }
+            value += rest[i];
+        }
+    } else {
+        size_t comment = rest.find(" #");
+        value = core::trim(comment == std::string::npos ? rest : rest.substr(0, comment));
+    }
+    emit(std::move(name), std::move(value));
+}
+
+// ---- json ------------------------------------------------------------------
+
+void ImportParser::jsonFail(const std::string& what) const {
+    throw std::runtime_error("Invalid JSON at line " + std::to_string(line_) + ": " + what);
+}
+
+void ImportParser::jsonScalar(std::string text) {
+    if (!stack_.empty() && stack_.back().object) {
+        Frame& top = stack_.back();
+        if (top.key == "name" || top.key == "key") {
+            top.name = std::move(text);
+            top.hasName = true;
+        } else if (top.key == "value") {
+            top.value = std::move(text);
+            top.hasValue = true;
+        } else {
+            emit(top.key, std::move(text));
+        }
+    }
+    state_ = stack_.empty() ? JsonState::Value : JsonState::CommaOrEnd;
+}
+
+void ImportParser::jsonClose(char c) {
+    if (stack_.empty() || stack_.back().object != (c == '}')) {
+        jsonFail(std::string("unexpected '") + c + "'");
+    }
+    Frame top = std::move(stack_.back());
+    stack_.pop_back();
+    if (top.hasName && top.hasValue) {
+        emit(std::move(top.name), std::move(top.value));
+    } else if (top.hasName) {
+        emit("name", std::move(top.name));
+    } else if (top.hasValue) {
+        emit("value", std::move(top.value));
+    }
+    state_ = stack_.empty() ? JsonState::Value : JsonState::CommaOrEnd;
+}
+
+void ImportParser::jsonChar(char c) {
+    switch (state_) {
+        case JsonState::String:
+            if (c == '"') {
+                if (highSurrogate_) {
+                    appendUtf8(token_, 0xFFFD);
+                    highSurrogate_ = 0;
+                }
+                if (tokenIsKey_) {
+                    stack_.back().key = std::move(token_);
+                    token_.clear();
+                    state_ = JsonState::Colon;
+                } else {
+                    std::string text = std::move(token_);
+                    token_.clear();
+                    jsonScalar(std::move(text));
+                }
+            } else if (c == '\\') {
+                state_ = JsonState::Escape;
+            } else {
+                jsonFail("control character in string");
+            }
+            return;
+
+        case JsonState::Escape: {
+            char out = 0;
+            switch (c) {
+                case '"': out = '"'; break;
+                case '\\': out = '\\'; break;
+                case '/': out = '/'; break;
+                case 'b': out = '\b'; break;
+                case 'f': out = '\f'; break;
+                case 'n': out = '\n'; break;
+                case 'r': out = '\r'; break;
+                case 't': out = '\t'; break;
+                case 'u':
+                    unicodeDigits_ = 0;
+                    unicodeValue_ = 0;
+                    state_ = JsonState::Unicode;
+                    return;
+                default:
+                    jsonFail(std::string("bad escape '\\") + c + "'");
+            }
+            if (highSurrogate_) {
+                appendUtf8(token_, 0xFFFD);
+                highSurrogate_ = 0;
+            }
+            token_ += out;
+            state_ = JsonState::String;
+            return;
+        }
+
+        case JsonState::Unicode: {
+            int digit = std::isdigit(static_cast<unsigned char>(c)) ? c - '0'
+                        : (c >= 'a' && c <= 'f')                    ? c - 'a' + 10
+                        : (c >= 'A' && c <= 'F')                    ? c - 'A' + 10
+                                                                    : -1;
+            if (digit < 0) {
+                jsonFail("bad \\u escape");
+            }
+            unicodeValue_ = (unicodeValue_ << 4) | static_cast<unsigned>(digit);
+            if (++unicodeDigits_ < 4) {
+                return;
+            }
+            unsigned cp = unicodeValue_;
+            if (cp >= 0xD800 && cp <= 0xDBFF) {
+                if (highSurrogate_) {
+                    appendUtf8(token_, 0xFFFD);
+                }
+                highSurrogate_ = cp;
+            } else if (cp >= 0xDC00 && cp <= 0xDFFF) {
+                appendUtf8(token_, highSurrogate_ ? 0x10000 + ((highSurrogate_ - 0xD800) << 10) + (cp - 0xDC00)
+                                                  : 0xFFFD);
+                highSurrogate_ = 0;
+            } else {
+                if (highSurrogate_) {
+                    appendUtf8(token_, 0xFFFD);
+                    highSurrogate_ = 0;
+                }
+                appendUtf8(token_, cp);
+            }
+            state_ = JsonState::String;
+            return;
+        }
+
+        case JsonState::Literal:
+            if (isLiteralChar(c)) {
+                token_ += c;
+                return;
+            }
+            {
+                std::string text = std::move(token_);
+                token_.clear();
+                if (text == "null") {
+                    state_ = stack_.empty() ? JsonState::Value : JsonState::CommaOrEnd;
+                } else if (text == "true" || text == "false" || text[0] == '-' ||
+                           std::isdigit(static_cast<unsigned char>(text[0]))) {
+                    jsonScalar(std::move(text));
+                } else {
+                    jsonFail("unexpected '" + text + "'");
+                }
+            }
+            jsonChar(c);
+            return;
+
+        default:
+            break;
+    }
+
+    if (isSpace(c)) {
+        if (c == '\n') {
+            ++line_;
+        }
+        return;
+    }
+
+    switch (state_) {
+        case JsonState::Value:
+        case JsonState::ValueOrEnd:
+            if (c == '{') {
+                stack_.emplace_back();
+                stack_.back().object = true;
+                state_ = JsonState::KeyOrEnd;
+            } else if (c == '[') {
+                stack_.emplace_back();
+                state_ = JsonState::ValueOrEnd;
+            } else if (c == '"') {
+                tokenIsKey_ = false;
+                state_ = JsonState::String;
+            } else if (c == ']' && state_ == JsonState::ValueOrEnd) {
+                jsonClose(c);
+            } else if (isLiteralChar(c)) {
+                token_ = c;
+                state_ = JsonState::Literal;
+            } else {
+                jsonFail(std::string("unexpected '") + c + "'");
+            }
+            return;
+
+        case JsonState::KeyOrEnd:
+        case JsonState::Key:
+            if (c == '"') {
+                tokenIsKey_ = true;
+                state_ = JsonState::String;
+            } else if (c == '}' && state_ == JsonState::KeyOrEnd) {
+                jsonClose(c);
+            } else {
+                jsonFail("expected a member name");
+            }
+            return;
+
+        case JsonState::Colon:
+            if (c != ':') {
+                jsonFail("expected ':'");
+            }
+            state_ = JsonState::Value;
+            return;
+
+        case JsonState::CommaOrEnd:
+            if (c == ',') {
+                state_ = stack_.back().object ? JsonState::Key : JsonState::Value;
+            } else if (c == '}' || c == ']') {
+                jsonClose(c);
+            } else {
+                jsonFail("expected ',' or a closing bracket");
+            }
+            return;
+
+        default:
+            return;
+    }
+}
+
+void importStream(std::istream& in, ImportFormat format, const ImportParser::Sink& sink) {
+    ImportParser parser(format, sink);
+    std::string buffer(CHUNK_SIZE, '\0');
+    uint64_t parsed = 0;
+    while (in) {
+        in.read(&buffer[0], static_cast<std::streamsize>(buffer.size()));
+        auto got = static_cast<size_t>(in.gcount());
+        if (got == 0) {
+            break;
+        }
+        parser.feed(std::string_view(buffer.data(), got));
+        parsed += got;
+    }
+    parser.finish();
+    core::metrics::count("ak_bytes_parsed_total", {{"format", "import"}}, parsed);
+}
+
+} // namespace storage
+} // namespace ak
@@ -0,0 +1,88 @@
+#include "storage/key_table.hpp"
+#include "crypto/crypto.hpp"
+
+#include <algorithm>
+
+namespace ak {
+namespace storage {
+
+using crypto::SecretView;
+
+KeyTable KeyTable::parse(std::string data) {
+    KeyTable table;
+    std::string_view rest(data);
+
+    // One bound for every name and value, so the arena maps a single chunk
+    struct Raw {
+        std::string_view name;
+        std::string_view encoded;
+        bool removed;
+    };
+    std::vector<Raw> raw;
+    raw.reserve(static_cast<std::size_t>(std::count(rest.begin(), rest.end(), '\n')) + 1);
+    std::size_t arenaSize = 0;
+    while (!rest.empty()) {
+        auto nl = rest.find('\n');
+        std::string_view line = rest.substr(0, nl);
+        rest.remove_prefix(nl == std::string_view::npos ? rest.size() : nl + 1);
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        auto eq = line.find('=');
+        if (eq == std::string_view::npos) {
+            if (line[0] == '-' && line.size() > 1) {
+                raw.push_back({line.substr(1), {}, true});
+                arenaSize += line.size() - 1;
+            }
+            continue;
+        }
+        raw.push_back({line.substr(0, eq), line.substr(eq + 1), false});
+        arenaSize += eq + crypto::base64DecodedBound(raw.back().encoded.size());
+    }
+
+    table.arena_ = std::make_unique<crypto::SecretArena>(arenaSize);
+    table.entries_.reserve(raw.size());
+    // Tombstones are marked by a null value pointer until deduplicated
+    for (const auto& line : raw) {
+        SecretView name = table.arena_->store(line.name);
+        if (line.removed) {
+            table.entries_.push_back({name.view(), SecretView()});
+            continue;
+        }
+        // Vector stores may run a few bytes past the value, so it gets its whole bound
+        char* cursor = table.arena_->allocate(crypto::base64DecodedBound(line.encoded.size()));
+        std::size_t length = crypto::base64DecodeInto(line.encoded, cursor);
+        table.entries_.push_back({name.view(), SecretView(cursor, length)});
+    }
+    crypto::secureZero(&data[0], data.size());
+
+    // Later lines override earlier ones: stable sort, then keep the last
+    // entry of each run of equal names
+    std::stable_sort(table.entries_.begin(), table.entries_.end(),
+                     [](const Entry& a, const Entry& b) { return a.name < b.name; });
+    std::size_t kept = 0;
+    for (std::size_t i = 0; i < table.entries_.size(); ++i) {
+        bool superseded = i + 1 < table.entries_.size() && table.entries_[i + 1].name == table.entries_[i].name;
+        if (superseded || table.entries_[i].value.data() == nullptr) {
+            continue;
+        }
+        table.entries_[kept++] = table.entries_[i];
+    }
+    table.entries_.resize(kept);
+    return table;
+}
+
+const KeyTable::Entry* KeyTable::find(std::string_view name) const {
+    auto it = std::lower_bound(entries_.begin(), entries_.end(), name,
+                               [](const Entry& entry, std::string_view n) { return entry.name < n; });
+    return it != entries_.end() && it->name == name ? &*it : nullptr;
+}
+
+void KeyTable::wipe() {
+    // The arena zeroes what it handed out as it goes
+    arena_.reset();
+    entries_.clear();
+}
+
+} // namespace storage
+} // namespace ak
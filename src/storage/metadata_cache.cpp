@@ -0,0 +1,318 @@
+#include "storage/metadata_cache.hpp"
+#include "core/metrics.hpp"
+#include "system/system.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace ak {
+namespace storage {
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// "AKMC", format version, then tagged sections; all integers little endian
+const char MAGIC[4] = {'A', 'K', 'M', 'C'};
+const uint32_t VERSION = 1;
+const uint32_t TAG_PROFILES = 1;
+const uint32_t TAG_SERVICES = 2;
+
+long long nowNanos() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::system_clock::now().time_since_epoch())
+        .count();
+}
+
+void putU32(std::string& out, uint32_t v) {
+    for (int i = 0; i < 4; ++i) {
+        out += static_cast<char>((v >> (8 * i)) & 0xff);
+    }
+}
+
+void putI64(std::string& out, long long v) {
+    auto u = static_cast<uint64_t>(v);
+    for (int i = 0; i < 8; ++i) {
+        out += static_cast<char>((u >> (8 * i)) & 0xff);
+    }
+}
+
+void putString(std::string& out, const std::string& s) {
+    putU32(out, static_cast<uint32_t>(s.size()));
+    out += s;
+}
+
+// Bounds-checked cursor over the mapped file; any overrun sets `bad`
+struct Reader {
+    std::string_view data;
+    size_t pos = 0;
+    bool bad = false;
+
+    bool need(size_t n) {
+        if (bad || data.size() - pos < n) {
+            bad = true;
+            return false;
+        }
+        return true;
+    }
+    uint32_t u32() {
+        if (!need(4)) {
+            return 0;
+        }
+        uint32_t v = 0;
+        for (int i = 0; i < 4; ++i) {
+            v |= static_cast<uint32_t>(static_cast<unsigned char>(data[pos + i])) << (8 * i);
+        }
+        pos += 4;
+        return v;
+    }
+    long long i64() {
+        if (!need(8)) {
+            return 0;
+        }
+        uint64_t v = 0;
+        for (int i = 0; i < 8; ++i) {
+            v |= static_cast<uint64_t>(static_cast<unsigned char>(data[pos + i])) << (8 * i);
+        }
+        pos += 8;
+        return static_cast<long long>(v);
+    }
+    std::string_view bytes(size_t n) {
+        if (!need(n)) {
+            return {};
+        }
+        auto v = data.substr(pos, n);
+        pos += n;
+        return v;
+    }
+    std::string string() {
+        uint32_t n = u32();
+        return std::string(bytes(n));
+    }
+};
+
+void putSection(std::string& out, uint32_t tag, const std::string& payload) {
+    putU32(out, tag);
+    putU32(out, static_cast<uint32_t>(payload.size()));
+    out += payload;
+}
+
+void putStamp(std::string& out, const PathStamp& stamp, long long scannedAt) {
+    out += stamp.exists ? '\1' : '\0';
+    putI64(out, stamp.mtime);
+    putI64(out, static_cast<long long>(stamp.size));
+    putI64(out, scannedAt);
+}
+
+void readStamp(Reader& in, PathStamp& stamp, long long& scannedAt) {
+    stamp.exists = in.bytes(1) == std::string_view("\1", 1);
+    stamp.mtime = in.i64();
+    stamp.size = static_cast<unsigned long long>(in.i64());
+    scannedAt = in.i64();
+}
+
+} // namespace
+
+PathStamp stampPath(const std::string& path) {
+    PathStamp stamp;
+#ifdef __unix__
+    struct stat st;
+    if (::stat(path.c_str(), &st) != 0) {
+        return stamp;
+    }
+    stamp.exists = true;
+    stamp.mtime = static_cast<long long>(st.st_mtim.tv_sec) * 1000000000LL + st.st_mtim.tv_nsec;
+    stamp.size = S_ISDIR(st.st_mode) ? 0 : static_cast<unsigned long long>(st.st_size);
+#else
+    std::error_code ec;
+    auto mtime = fs::last_write_time(path, ec);
+    if (ec) {
+        return stamp;
+    }
+    stamp.exists = true;
+    stamp.mtime = static_cast<long long>(mtime.time_since_epoch().count());
+    stamp.size = fs::is_directory(path, ec) ? 0 : static_cast<unsigned long long>(fs::file_size(path, ec));
+#endif
+    return stamp;
+}
+
+std::string MetadataCache::path(const core::Config& cfg) {
+    return cfg.configDir + "/meta.cache";
+}
+
+MetadataCache::MetadataCache(const core::Config& cfg) : path_(path(cfg)) {
+#if defined(__unix__) || defined(__APPLE__)
+    int fd = ::open(path_.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+    struct stat st;
+    if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+        size_t size = static_cast<size_t>(st.st_size);
+        void* map = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+            parse(std::string_view(static_cast<const char*>(map), size));
+            ::munmap(map, size);
+        }
+    }
+    ::close(fd);
+#else
+    std::ifstream in(path_, std::ios::binary);
+    if (in) {
+        std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        parse(data);
+    }
+#endif
+}
+
+void MetadataCache::parse(std::string_view data) {
+    Reader in{data};
+    if (in.bytes(4) != std::string_view(MAGIC, 4) || in.u32() != VERSION) {
+        return;
+    }
+    Section profileSection;
+    std::vector<ProfileSummary> profiles;
+    Section serviceSection;
+    std::vector<std::vector<std::string>> rows;
+
+    uint32_t sections = in.u32();
+    for (uint32_t s = 0; s < sections && !in.bad; ++s) {
+        uint32_t tag = in.u32();
+        Reader body{in.bytes(in.u32())};
+        if (tag == TAG_PROFILES) {
+            readStamp(body, profileSection.source, profileSection.scannedAt);
+            uint32_t count = body.u32();
+            for (uint32_t i = 0; i < count && !body.bad; ++i) {
+                ProfileSummary summary;
+                summary.keyCount = body.u32();
+                summary.name = body.string();
+                profiles.push_back(std::move(summary));
+            }
+            profileSection.present = !body.bad;
+        } else if (tag == TAG_SERVICES) {
+            readStamp(body, serviceSection.source, serviceSection.scannedAt);
+            uint32_t count = body.u32();
+            for (uint32_t i = 0; i < count && !body.bad; ++i) {
+                std::vector<std::string> row(body.u32());
+                for (auto& field : row) {
+                    field = body.string();
+                }
+                rows.push_back(std::move(row));
+            }
+            serviceSection.present = !body.bad;
+        }
+        // Unknown tags are skipped; a newer ak may have added them
+    }
+    if (in.bad) {
+        return;
+    }
+    if (profileSection.present) {
+        profileSection_ = profileSection;
+        profiles_ = std::move(profiles);
+    }
+    if (serviceSection.present) {
+        serviceSection_ = serviceSection;
+        serviceRows_ = std::move(rows);
+    }
+}
+
+std::string MetadataCache::serialize() const {
+    std::string out(MAGIC, 4);
+    putU32(out, VERSION);
+    putU32(out, (profileSection_.present ? 1 : 0) + (serviceSection_.present ? 1 : 0));
+    if (profileSection_.present) {
+        std::string body;
+        putStamp(body, profileSection_.source, profileSection_.scannedAt);
+        putU32(body, static_cast<uint32_t>(profiles_.size()));
+        for (const auto& summary : profiles_) {
+            putU32(body, static_cast<uint32_t>(summary.keyCount));
+            putString(body, summary.name);
+        }
+        putSection(out, TAG_PROFILES, body);
+    }
+    if (serviceSection_.present) {
+        std::string body;
+        putStamp(body, serviceSection_.source, serviceSection_.scannedAt);
+        putU32(body, static_cast<uint32_t>(serviceRows_.size()));
+        for (const auto& row : serviceRows_) {
+            putU32(body, static_cast<uint32_t>(row.size()));
+            for (const auto& field : row) {
+                putString(body, field);
+            }
+        }
+        putSection(out, TAG_SERVICES, body);
+    }
+    return out;
+}
+
+bool MetadataCache::fresh(const Section& section, const PathStamp& now) const {
+    return section.present && section.source == now && section.scannedAt - now.mtime > RACY_WINDOW;
+}
+
+bool MetadataCache::profiles(const PathStamp& dir, std::vector<ProfileSummary>& out) const {
+    bool hit = fresh(profileSection_, dir);
+    core::metrics::count("ak_cache_requests_total", {{"cache", "metadata_profiles"}, {"result", hit ? "hit" : "miss"}});
+    if (!hit) {
+        return false;
+    }
+    out = profiles_;
+    return true;
+}
+
+void MetadataCache::setProfiles(const PathStamp& dir, std::vector<ProfileSummary> profiles) {
+    long long now = nowNanos();
+    if (!dir.exists || now - dir.mtime <= RACY_WINDOW) {
+        return; // would not be trusted on the next read anyway
+    }
+    profileSection_ = {true, dir, now};
+    profiles_ = std::move(profiles);
+    changed_ = true;
+}
+
+bool MetadataCache::serviceRecords(const PathStamp& file, std::vector<std::vector<std::string>>& out) const {
+    bool hit = fresh(serviceSection_, file);
+    core::metrics::count("ak_cache_requests_total", {{"cache", "metadata_services"}, {"result", hit ? "hit" : "miss"}});
+    if (!hit) {
+        return false;
+    }
+    out = serviceRows_;
+    return true;
+}
+
+void MetadataCache::setServiceRecords(const PathStamp& file, std::vector<std::vector<std::string>> rows) {
+    long long now = nowNanos();
+    if (!file.exists || now - file.mtime <= RACY_WINDOW) {
+        return;
+    }
+    serviceSection_ = {true, file, now};
+    serviceRows_ = std::move(rows);
+    changed_ = true;
+}
+
+void MetadataCache::save() {
+    if (!changed_) {
+        return;
+    }
+    changed_ = false;
+    std::error_code ec;
+    fs::create_directories(fs::path(path_).parent_path(), ec);
+    try {
+        system::writeFileAtomic(path_, serialize());
+    } catch (const std::runtime_error&) {
+        // Only a cache: the next run scans again
+    }
+}
+
+} // namespace storage
+} // namespace ak
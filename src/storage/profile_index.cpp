@@ -0,0 +1,85 @@
+#include "storage/profile_index.hpp"
+#include "storage/vault.hpp"
+
+#include <algorithm>
+#include <cctype>
+
+namespace ak {
+namespace storage {
+
+ProfileIndex::ProfileIndex(const std::map<std::string, std::string>& keys) {
+    serviceByKey_.reserve(keys.size());
+    keysByNormalized_.reserve(keys.size());
+    for (const auto& entry : keys) {
+        add(entry.first);
+    }
+}
+
+std::string ProfileIndex::normalize(std::string_view name) {
+    std::string out(name);
+    for (char& c : out) {
+        c = c == '-' ? '_' : static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+    }
+    return out;
+}
+
+void ProfileIndex::add(const std::string& name) {
+    auto [it, inserted] = serviceByKey_.emplace(name, std::string());
+    if (!inserted) {
+        return;
+    }
+    it->second = getServiceForKeyName(name);
+    keysByService_[it->second].insert(name);
+    keysByNormalized_[normalize(name)].push_back(name);
+}
+
+void ProfileIndex::remove(const std::string& name) {
+    auto it = serviceByKey_.find(name);
+    if (it == serviceByKey_.end()) {
+        return;
+    }
+    auto service = keysByService_.find(it->second);
+    service->second.erase(name);
+    if (service->second.empty()) {
+        keysByService_.erase(service);
+    }
+    auto normalized = keysByNormalized_.find(normalize(name));
+    auto& names = normalized->second;
+    names.erase(std::find(names.begin(), names.end(), name));
+    if (names.empty()) {
+        keysByNormalized_.erase(normalized);
+    }
+    serviceByKey_.erase(it);
+}
+
+bool ProfileIndex::contains(const std::string& name) const {
+    return serviceByKey_.count(name) > 0;
+}
+
+const std::string* ProfileIndex::conflictFor(const std::string& name) const {
+    auto it = keysByNormalized_.find(normalize(name));
+    if (it == keysByNormalized_.end()) {
+        return nullptr;
+    }
+    for (const auto& existing : it->second) {
+        if (existing != name) {
+            return &existing;
+        }
+    }
+    return nullptr;
+}
+
+const std::string& ProfileIndex::serviceOf(const std::string& name) const {
+    static const std::string none;
+    auto it = serviceByKey_.find(name);
+    return it == serviceByKey_.end() ? none : it->second;
+}
+
+const std::set<std::string>& ProfileIndex::keysForService(const std::string& service) const {
+    static const std::set<std::string> none;
+    auto it = keysByService_.find(service);
+    return it == keysByService_.end() ? none : it->second;
+}
+
+} // namespace storage
+} // namespace ak
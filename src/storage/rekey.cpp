@@ -0,0 +1,370 @@
+#include "storage/rekey.hpp"
+#include "crypto/aead.hpp"
+#include "crypto/crypto.hpp"
+#include "storage/blob_store.hpp"
+#include "storage/content_store.hpp"
+#include "storage/vault.hpp"
+#include "system/system.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <thread>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace ak {
+namespace storage {
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// First line "ak-rekey 1 <target backend>", then "<kind>\t<name>" for each
+// finished item
+const char JOURNAL_HEADER[] = "ak-rekey 1 ";
+
+const Backend ALL_BACKENDS[] = {Backend::Gpg, Backend::Aead, Backend::Plain};
+
+// Appends finished items; each line is on disk before the item counts
+class Journal {
+public:
+    Journal(const std::string& path, const std::string& target) {
+        std::ifstream in(path);
+        std::string line;
+        bool existing = static_cast<bool>(std::getline(in, line));
+        if (existing && line != JOURNAL_HEADER + target) {
+            throw std::runtime_error("An unfinished run towards another backend left " + path +
+                                     "; finish it or remove the file");
+        }
+        while (std::getline(in, line)) {
+            done_.insert(line);
+        }
+        in.close();
+#if defined(__unix__) || defined(__APPLE__)
+        fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+        if (fd_ < 0) {
+            throw std::runtime_error("Failed to open " + path);
+        }
+#else
+        out_.open(path, std::ios::binary | std::ios::app);
+        if (!out_) {
+            throw std::runtime_error("Failed to open " + path);
+        }
+#endif
+        if (!existing && !append(JOURNAL_HEADER + target)) {
+            throw std::runtime_error("Failed to write " + path);
+        }
+    }
+    ~Journal() {
+#if defined(__unix__) || defined(__APPLE__)
+        ::close(fd_);
+#endif
+    }
+    Journal(const Journal&) = delete;
+    Journal& operator=(const Journal&) = delete;
+
+    bool done(const std::string& kind, const std::string& name) const {
+        return done_.count(kind + "\t" + name) > 0;
+    }
+
+    // False when the line could not be written
+    bool record(const std::string& kind, const std::string& name) { return append(kind + "\t" + name); }
+
+private:
+    bool append(std::string line) {
+        line += '\n';
+        std::lock_guard<std::mutex> lock(mutex_);
+#if defined(__unix__) || defined(__APPLE__)
+        const char* data = line.data();
+        size_t left = line.size();
+        while (left > 0) {
+            ssize_t n = ::write(fd_, data, left);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                return false;
+            }
+            data += n;
+            left -= static_cast<size_t>(n);
+        }
+        return ::fsync(fd_) == 0;
+#else
+        return static_cast<bool>(out_.write(line.data(), static_cast<std::streamsize>(line.size())).flush());
+#endif
+    }
+
+    std::set<std::string> done_; // read once, before any worker starts
+    std::mutex mutex_;
+#if defined(__unix__) || defined(__APPLE__)
+    int fd_ = -1;
+#else
+    std::ofstream out_;
+#endif
+};
+
+// Runs work(i) for every i < count on up to `jobs` threads
+void runPool(size_t jobs, size_t count, const std::function<void(size_t)>& work) {
+    jobs = std::max<size_t>(1, std::min(jobs, count));
+    std::atomic<size_t> next{0};
+    auto worker = [&]() {
+        for (size_t i = next++; i < count; i = next++) {
+            work(i);
+        }
+    };
+    std::vector<std::thread> threads;
+    threads.reserve(jobs - 1);
+    for (size_t t = 1; t < jobs; ++t) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+bool profileHasKeyFile(const core::Config& cfg, const std::string& name) {
+    std::error_code ec;
+    bool found = fs::exists(profileKeysPath(cfg, name), ec);
+    for (auto b : ALL_BACKENDS) {
+        found = found || fs::exists(profileKeysPathFor(cfg, name, b), ec);
+    }
+    return found;
+}
+
+bool vaultExists(const core::Config& cfg) {
+    std::error_code ec;
+    bool found = hasGlobalVault(cfg);
+    for (auto b : ALL_BACKENDS) {
+        found = found || fs::exists(vaultPathFor(cfg, b), ec);
+    }
+    return found;
+}
+
+// The sealed content store files (objects and the key sentinel)
+std::vector<std::string> sealedObjects(const core::Config& cfg) {
+    std::vector<std::string> out;
+    std::error_code ec;
+    std::string dir = ContentStore::dir(cfg);
+    for (fs::recursive_directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec)) {
+        std::string name = it->path().filename().string();
+        if (it->is_regular_file() && name.size() > 4 && name.compare(name.size() - 4, 4, ".akv") == 0) {
+            out.push_back(fs::relative(it->path(), dir).generic_string());
+        }
+    }
+    return out;
+}
+
+enum class Outcome { Done, Resumed, Failed };
+
+} // namespace
+
+std::string rekeyJournalPath(const core::Config& cfg) {
+    return cfg.persistDir + "/rekey.journal";
+}
+
+std::string pendingRekeyTarget(const core::Config& cfg) {
+    std::ifstream in(rekeyJournalPath(cfg));
+    std::string line;
+    std::string header = JOURNAL_HEADER;
+    if (!std::getline(in, line) || line.rfind(header, 0) != 0) {
+        return "";
+    }
+    return line.substr(header.size());
+}
+
+RekeyReport rekeyAll(const core::Config& from, const core::Config& to, const RekeyOptions& options) {
+    Backend target = activeBackend(to);
+    fs::create_directories(to.persistDir);
+    Journal journal(rekeyJournalPath(to), backendName(target));
+    size_t jobs = options.jobs ? options.jobs : std::max(1u, std::thread::hardware_concurrency());
+    clearProfileKeysCache();
+
+    RekeyReport report;
+    std::mutex reportMutex;
+    auto finish = [&](Outcome outcome, const std::string& kind, const std::string& name, size_t RekeyReport::*count) {
+        std::lock_guard<std::mutex> lock(reportMutex);
+        if (outcome == Outcome::Failed) {
+            report.failed.push_back(kind + " " + name);
+            return;
+        }
+        if (count) {
+            ++(report.*count);
+        }
+        if (outcome == Outcome::Resumed) {
+            ++report.resumed;
+        }
+    };
+
+    // Objects and blobs first: profile manifests point into the store, so
+    // they only read under `to` once these do
+    std::vector<std::string> objects;
+    if (activeBackend(from) == Backend::Aead && target == Backend::Aead &&
+        from.presetPassphrase != to.presetPassphrase) {
+        objects = sealedObjects(from);
+    }
+    std::string objectDir = ContentStore::dir(from);
+    runPool(jobs, objects.size(), [&](size_t i) {
+        const std::string& name = objects[i];
+        fs::path path = fs::path(objectDir) / name;
+        std::ifstream in(path, std::ios::binary);
+        std::string sealed((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        std::string plain;
+        Outcome outcome = Outcome::Failed;
+        if (crypto::aeadOpen(sealed, to.presetPassphrase, plain)) {
+            outcome = journal.done("object", name) ? Outcome::Resumed : Outcome::Done;
+        } else if (crypto::aeadOpen(sealed, from.presetPassphrase, plain)) {
+            try {
+                system::writeFileAtomic(path, crypto::aeadSeal(plain, to.presetPassphrase));
+                std::ifstream check(path, std::ios::binary);
+                std::string written((std::istreambuf_iterator<char>(check)), std::istreambuf_iterator<char>());
+                std::string reopened;
+                if (crypto::aeadOpen(written, to.presetPassphrase, reopened) && reopened == plain) {
+                    outcome = Outcome::Done;
+                }
+                crypto::secureZero(&reopened[0], reopened.size());
+            } catch (const std::exception&) {
+            }
+        }
+        crypto::secureZero(&plain[0], plain.size());
+        if (outcome == Outcome::Done && !journal.record("object", name)) {
+            outcome = Outcome::Failed;
+        }
+        finish(outcome, "object", name, &RekeyReport::objects);
+    });
+
+    BlobStore blobSource(from, activeBackend(from) == Backend::Plain ? "" : from.presetPassphrase);
+    BlobStore blobTarget(to, target == Backend::Plain ? "" : to.presetPassphrase);
+    std::vector<std::string> blobs = blobTarget.ids();
+    runPool(jobs, blobs.size(), [&](size_t i) {
+        Outcome outcome = Outcome::Failed;
+        try {
+            if (blobTarget.reseal(blobs[i], blobSource)) {
+                outcome = journal.done("blob", blobs[i]) ? Outcome::Resumed : Outcome::Done;
+            }
+        } catch (const std::exception&) {
+        }
+        if (outcome == Outcome::Done && !journal.record("blob", blobs[i])) {
+            outcome = Outcome::Failed;
+        }
+        finish(outcome, "blob", blobs[i], &RekeyReport::objects);
+    });
+
+    // Profiles and the vault. A journaled item is trusted once it opens
+    // under `to` from the target backend's file; anything else is read
+    // under `from`, or found already swapped by a run that stopped before
+    // recording it.
+    std::vector<std::string> profiles;
+    for (const auto& name : listProfiles(from)) {
+        if (profileHasKeyFile(from, name)) {
+            profiles.push_back(name);
+        }
+    }
+    bool haveVault = vaultExists(from);
+    runPool(jobs, profiles.size() + (haveVault ? 1 : 0), [&](size_t i) {
+        Outcome outcome = Outcome::Failed;
+        std::error_code ec;
+        if (i == profiles.size()) {
+            core::KeyStore current;
+            bool swapped = fs::exists(vaultPathFor(to, target), ec);
+            if (journal.done("vault", "") && swapped && tryLoadVault(to, current)) {
+                outcome = Outcome::Resumed;
+            } else {
+                core::KeyStore vault;
+                if (tryLoadVault(from, vault)) {
+                    try {
+                        saveVault(to, vault);
+                        core::KeyStore check;
+                        if (tryLoadVault(to, check) && check.kv == vault.kv) {
+                            outcome = Outcome::Done;
+                        }
+                    } catch (const std::exception&) {
+                    }
+                } else if (swapped && tryLoadVault(to, current)) {
+                    outcome = Outcome::Done;
+                }
+            }
+            if (outcome == Outcome::Done && !journal.record("vault", "")) {
+                outcome = Outcome::Failed;
+            }
+            std::lock_guard<std::mutex> lock(reportMutex);
+            if (outcome == Outcome::Failed) {
+                report.failed.push_back("vault");
+            } else {
+                report.vault = true;
+                report.resumed += outcome == Outcome::Resumed;
+            }
+            return;
+        }
+
+        const std::string& name = profiles[i];
+        std::map<std::string, std::string> keys;
+        std::map<std::string, std::string> current;
+        bool swapped = fs::exists(profileKeysPath(to, name), ec);
+        // A manifest holds only names and digests; once the objects are
+        // re-sealed it reads under `to` as it is
+        bool manifest = !objects.empty() &&
+                        fs::exists(fs::path(from.profilesDir) / (name + ".keys" + MANIFEST_SUFFIX), ec);
+        if ((journal.done("profile", name) || manifest) && (swapped || manifest) &&
+            tryLoadProfileKeys(to, name, current)) {
+            outcome = journal.done("profile", name) ? Outcome::Resumed : Outcome::Done;
+        } else if (tryLoadProfileKeys(from, name, keys)) {
+            try {
+                invalidateProfileKeysCache(to, name);
+                saveProfileKeys(to, name, keys);
+                std::map<std::string, std::string> check;
+                if (tryLoadProfileKeys(to, name, check) && check == keys) {
+                    outcome = Outcome::Done;
+                }
+            } catch (const std::exception&) {
+            }
+        } else if (swapped && tryLoadProfileKeys(to, name, current)) {
+            outcome = Outcome::Done;
+        }
+        if (outcome == Outcome::Done && !journal.record("profile", name)) {
+            outcome = Outcome::Failed;
+        }
+        finish(outcome, "profile", name, &RekeyReport::profiles);
+    });
+
+    if (!report.complete()) {
+        std::sort(report.failed.begin(), report.failed.end());
+        clearProfileKeysCache();
+        return report;
+    }
+
+    writeBackendSetting(to, target);
+    std::error_code ec;
+    if (!options.keepOld) {
+        for (auto b : ALL_BACKENDS) {
+            if (b == target) {
+                continue;
+            }
+            for (const auto& name : profiles) {
+                fs::remove(profileKeysPathFor(from, name, b), ec);
+            }
+            if (haveVault) {
+                fs::remove(vaultPathFor(from, b), ec);
+            }
+        }
+    }
+    // Directory bundles were sealed under the old passphrase
+    bumpGeneration(to);
+    clearProfileKeysCache();
+    fs::remove(rekeyJournalPath(to), ec);
+    return report;
+}
+
+} // namespace storage
+} // namespace ak
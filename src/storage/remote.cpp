@@ -0,0 +1,560 @@
+#include "storage/remote.hpp"
+#include "storage/vault.hpp"
+#include "core/config.hpp"
+#include "crypto/crypto.hpp"
+#include "crypto/aead.hpp"
+#include "http/http.hpp"
+#include "system/system.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+
+namespace ak {
+namespace storage {
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Remote layout: `index` lists "profile\t<object hash>"; objects/<hash>.akv
+// is the sealed profile, named by the SHA-256 of the sealed bytes
+const char INDEX_NAME[] = "index";
+const char INDEX_HEADER[] = "ak-remote 1";
+const char STATE_HEADER[] = "ak-sync 1";
+const char PROFILE_HEADER[] = "ak-profile 1";
+// The index is retried this many times when another machine replaced it
+// between our read and our write
+const int INDEX_ATTEMPTS = 3;
+
+std::string readFile(const fs::path& path) {
+    std::ifstream in(path, std::ios::binary);
+    std::ostringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+}
+
+bool readExisting(const fs::path& path, std::string& data) {
+    std::error_code ec;
+    if (!fs::is_regular_file(path, ec)) {
+        return false;
+    }
+    data = readFile(path);
+    return true;
+}
+
+std::string sha256(const std::string& data) {
+    crypto::SHA256 hasher;
+    hasher.update(data);
+    return hasher.final();
+}
+
+// Objects are only ever named by us; anything that could leave the
+// remote's root is refused
+void checkObjectName(const std::string& name) {
+    if (name.empty() || name.front() == '/' || name.find("..") != std::string::npos) {
+        throw std::runtime_error("Invalid remote object name: " + name);
+    }
+}
+
+// Index entries become file names under profilesDir
+bool safeProfileName(const std::string& name) {
+    return !name.empty() && name.front() != '.' && name.find('/') == std::string::npos &&
+           name.find('\\') == std::string::npos && name.find('\t') == std::string::npos;
+}
+
+class FileRemote : public RemoteBackend {
+public:
+    explicit FileRemote(std::string dir) : dir_(std::move(dir)) {}
+
+    RemoteObject get(const std::string& name, const std::string& etag) override {
+        checkObjectName(name);
+        RemoteObject object;
+        std::string data;
+        if (!readExisting(fs::path(dir_) / name, data)) {
+            return object;
+        }
+        object.found = true;
+        object.etag = sha256(data);
+        if (!etag.empty() && etag == object.etag) {
+            object.notModified = true;
+        } else {
+            object.data.swap(data);
+        }
+        return object;
+    }
+
+    bool put(const std::string& name, const std::string& data, const std::string* ifMatch,
+             std::string& etag) override {
+        checkObjectName(name);
+        fs::path path = fs::path(dir_) / name;
+        std::error_code ec;
+        fs::create_directories(path.parent_path(), ec);
+        if (ec) {
+            throw std::runtime_error("Cannot create " + path.parent_path().string());
+        }
+        // Machines sharing the directory serialize their conditional writes
+        system::FileLock lock(fs::path(dir_) / ".lock");
+        if (ifMatch) {
+            std::string current;
+            bool exists = readExisting(path, current);
+            if (ifMatch->empty() ? exists : (!exists || sha256(current) != *ifMatch)) {
+                return false;
+            }
+        }
+        system::writeFileAtomic(path, data);
+        etag = sha256(data);
+        return true;
+    }
+
+    std::string describe() const override { return dir_; }
+
+private:
+    std::string dir_;
+};
+
+class HttpRemote : public RemoteBackend {
+public:
+    explicit HttpRemote(std::string base) : base_(std::move(base)) {
+        while (!base_.empty() && base_.back() == '/') {
+            base_.pop_back();
+        }
+        token_ = core::getenvs("AK_REMOTE_TOKEN");
+    }
+
+    RemoteObject get(const std::string& name, const std::string& etag) override {
+        http::Request request = requestFor("GET", name);
+        if (!etag.empty()) {
+            request.headers.push_back("If-None-Match: " + etag);
+        }
+        http::Response response = send(request);
+        RemoteObject object;
+        if (response.status == 404) {
+            return object;
+        }
+        object.found = true;
+        object.etag = http::header(response, "ETag");
+        if (response.status == 304) {
+            object.notModified = true;
+            object.etag = etag;
+        } else if (response.status == 200) {
+            object.data.swap(response.body);
+        } else {
+            throw std::runtime_error(describe() + "/" + name + ": HTTP " + std::to_string(response.status));
+        }
+        return object;
+    }
+
+    bool put(const std::string& name, const std::string& data, const std::string* ifMatch,
+             std::string& etag) override {
+        http::Request request = requestFor("PUT", name);
+        request.body = data;
+        request.headers.push_back("Content-Type: application/octet-stream");
+        if (ifMatch) {
+            request.headers.push_back(ifMatch->empty() ? "If-None-Match: *" : "If-Match: " + *ifMatch);
+        }
+        http::Response response = send(request);
+        if (response.status == 412) {
+            return false;
+        }
+        if (response.status < 200 || response.status >= 300) {
+            throw std::runtime_error(describe() + "/" + name + ": HTTP " + std::to_string(response.status));
+        }
+        etag = http::header(response, "ETag");
+        return true;
+    }
+
+    std::string describe() const override { return base_; }
+
+private:
+    http::Request requestFor(const char* method, const std::string& name) const {
+        checkObjectName(name);
+        http::Request request;
+        request.method = method;
+        request.url = base_ + "/" + name;
+        request.maxBody = 64u << 20;
+        if (!token_.empty()) {
+            request.headers.push_back("Authorization: Bearer " + token_);
+        }
+        return request;
+    }
+
+    http::Response send(const http::Request& request) const {
+        if (!http::available()) {
+            throw std::runtime_error("HTTP remotes need ak built with libcurl");
+        }
+        http::Response response = http::perform(request);
+        if (!response.error.empty() || response.status == 0) {
+            throw std::runtime_error(request.url + ": " + (response.error.empty() ? "no response" : response.error));
+        }
+        return response;
+    }
+
+    std::string base_;
+    std::string token_;
+};
+
+using Index = std::map<std::string, std::string>; // profile -> object hash
+
+Index parseIndex(const std::string& text) {
+    Index index;
+    std::istringstream in(text);
+    std::string line;
+    if (!std::getline(in, line) || line != INDEX_HEADER) {
+        if (!text.empty()) {
+            throw std::runtime_error("The remote index is not an ak index");
+        }
+        return index;
+    }
+    while (std::getline(in, line)) {
+        auto tab = line.find('\t');
+        if (tab != std::string::npos) {
+            index[line.substr(0, tab)] = line.substr(tab + 1);
+        }
+    }
+    return index;
+}
+
+std::string formatIndex(const Index& index) {
+    std::string text = INDEX_HEADER;
+    text += '\n';
+    for (const auto& [profile, hash] : index) {
+        text += profile + "\t" + hash + "\n";
+    }
+    return text;
+}
+
+std::string serializeKeys(const std::map<std::string, std::string>& keys) {
+    std::string text = PROFILE_HEADER;
+    text += '\n';
+    for (const auto& [name, value] : keys) {
+        text += name + "=" + crypto::base64Encode(value) + "\n";
+    }
+    return text;
+}
+
+bool parseKeys(const std::string& text, std::map<std::string, std::string>& keys) {
+    std::istringstream in(text);
+    std::string line;
+    if (!std::getline(in, line) || line != PROFILE_HEADER) {
+        return false;
+    }
+    keys.clear();
+    while (std::getline(in, line)) {
+        auto eq = line.find('=');
+        if (eq != std::string::npos) {
+            keys[line.substr(0, eq)] = crypto::base64Decode(line.substr(eq + 1));
+        }
+    }
+    return true;
+}
+
+struct SyncedProfile {
+    std::string hash;    // remote object it last matched
+    std::string version; // profileKeysVersion then; "" forces a compare
+};
+
+struct SyncState {
+    std::string indexEtag;
+    std::map<std::string, SyncedProfile> profiles;
+};
+
+fs::path syncDir(const core::Config& cfg) {
+    return fs::path(cfg.persistDir) / "sync";
+}
+
+// Keyed by remote so pointing ak at another remote starts afresh
+fs::path statePath(const core::Config& cfg, RemoteBackend& remote) {
+    return syncDir(cfg) / ("state." + sha256(remote.describe()).substr(0, 16));
+}
+
+SyncState loadState(const fs::path& path) {
+    SyncState state;
+    std::ifstream in(path);
+    std::string line;
+    if (!std::getline(in, line) || line != STATE_HEADER || !std::getline(in, state.indexEtag)) {
+        return SyncState{};
+    }
+    while (std::getline(in, line)) {
+        auto tab = line.find('\t');
+        auto tab2 = tab == std::string::npos ? tab : line.find('\t', tab + 1);
+        if (tab2 != std::string::npos) {
+            state.profiles[line.substr(0, tab)] = {line.substr(tab + 1, tab2 - tab - 1), line.substr(tab2 + 1)};
+        }
+    }
+    return state;
+}
+
+void saveState(const fs::path& path, const SyncState& state) {
+    std::string text = STATE_HEADER;
+    text += "\n" + state.indexEtag + "\n";
+    for (const auto& [profile, synced] : state.profiles) {
+        text += profile + "\t" + synced.hash + "\t" + synced.version + "\n";
+    }
+    system::writeFileAtomic(path, text);
+}
+
+class Syncer {
+public:
+    Syncer(const core::Config& cfg, RemoteBackend& remote, SyncMode mode)
+        : cfg_(cfg), remote_(remote), mode_(mode), dir_(syncDir(cfg)), statePath_(statePath(cfg, remote)) {}
+
+    SyncReport run() {
+        if (!crypto::aeadAvailable()) {
+            throw std::runtime_error("Sync needs ak built with OpenSSL (profiles are sealed for the remote)");
+        }
+        passphrase_ = sealingPassphrase(cfg_);
+        if (passphrase_.empty()) {
+            throw std::runtime_error("A passphrase is required to seal profiles for the remote (set AK_PASSPHRASE)");
+        }
+        std::error_code ec;
+        fs::create_directories(dir_ / "objects", ec);
+        system::ensureSecureDir(dir_);
+        state_ = loadState(statePath_);
+
+        for (int attempt = 1;; ++attempt) {
+            if (pass()) {
+                break;
+            }
+            if (attempt == INDEX_ATTEMPTS) {
+                saveState(statePath_, state_);
+                throw std::runtime_error("The remote index kept changing; try again");
+            }
+            report_.changes.clear();
+        }
+        if (mode_ != SyncMode::Status) {
+            saveState(statePath_, state_);
+        }
+        return report_;
+    }
+
+private:
+    // One read of the index and, unless nothing changed, one write. False
+    // when the index was replaced between the two.
+    bool pass() {
+        Index index = fetchIndex();
+        Index updated = index;
+        std::set<std::string> profiles;
+        for (const auto& name : listProfiles(cfg_)) {
+            profiles.insert(name);
+        }
+        for (const auto& entry : index) {
+            profiles.insert(entry.first);
+        }
+        report_.profiles = profiles.size();
+
+        std::map<std::string, SyncedProfile> pushed;
+        for (const auto& profile : profiles) {
+            if (!safeProfileName(profile)) {
+                continue;
+            }
+            auto remoteIt = index.find(profile);
+            std::string remoteHash = remoteIt == index.end() ? "" : remoteIt->second;
+            SyncedProfile synced = state_.profiles.count(profile) ? state_.profiles[profile] : SyncedProfile{};
+
+            bool remoteChanged = !remoteHash.empty() && remoteHash != synced.hash;
+            std::string version = profileKeysVersion(cfg_, profile);
+            std::map<std::string, std::string> local;
+            bool localChanged = false;
+            if (!version.empty() && (synced.hash.empty() || version != synced.version)) {
+                if (!tryLoadProfileKeys(cfg_, profile, local)) {
+                    throw std::runtime_error("Cannot decrypt profile '" + profile + "'");
+                }
+                std::map<std::string, std::string> base;
+                localChanged = synced.hash.empty() || !loadObject(synced.hash, base) || base != local;
+                if (!localChanged && mode_ != SyncMode::Status) {
+                    state_.profiles[profile].version = version; // touched, not changed
+                }
+            }
+
+            if (mode_ == SyncMode::Status) {
+                if (remoteChanged) {
+                    report_.changes.push_back({profile, "remote changes"});
+                }
+                if (localChanged) {
+                    report_.changes.push_back({profile, "local changes"});
+                }
+                continue;
+            }
+            bool pull = remoteChanged && mode_ != SyncMode::Push;
+            bool push = localChanged && mode_ != SyncMode::Pull && (!remoteChanged || pull);
+            if (remoteChanged && !pull) {
+                report_.changes.push_back({profile, "remote changes"});
+            }
+            if (pull) {
+                std::map<std::string, std::string> theirs;
+                if (!loadObject(remoteHash, theirs)) {
+                    throw std::runtime_error("Remote profile '" + profile + "' does not open with this passphrase");
+                }
+                if (localChanged) {
+                    std::map<std::string, std::string> base;
+                    if (!synced.hash.empty()) {
+                        loadObject(synced.hash, base);
+                    }
+                    mergeKeyChanges(base, local, theirs);
+                }
+                applyLocally(profile, theirs, localChanged ? &local : nullptr);
+                // After a merge the local side still holds changes the
+                // remote lacks: keep comparing until they are pushed
+                state_.profiles[profile] = {remoteHash, localChanged ? "" : profileKeysVersion(cfg_, profile)};
+                report_.changes.push_back({profile, localChanged ? "merged" : "pulled"});
+                if (!push) {
+                    continue;
+                }
+                local = theirs;
+            }
+            if (push) {
+                std::string hash = storeObject(local);
+                updated[profile] = hash;
+                pushed[profile] = {hash, profileKeysVersion(cfg_, profile)};
+                if (!pull) {
+                    report_.changes.push_back({profile, "pushed"});
+                }
+            }
+        }
+
+        if (pushed.empty()) {
+            return true;
+        }
+        std::string etag;
+        ++report_.requests;
+        if (!remote_.put(INDEX_NAME, formatIndex(updated), &indexEtag_, etag)) {
+            return false;
+        }
+        system::writeFileAtomic(dir_ / "index", formatIndex(updated));
+        state_.indexEtag = etag;
+        for (auto& [profile, synced] : pushed) {
+            state_.profiles[profile] = synced;
+        }
+        return true;
+    }
+
+    Index fetchIndex() {
+        fs::path cached = dir_ / "index";
+        std::string cachedText;
+        bool haveCache = readExisting(cached, cachedText);
+        ++report_.requests;
+        RemoteObject object = remote_.get(INDEX_NAME, haveCache ? state_.indexEtag : "");
+        if (!object.found) {
+            indexEtag_.clear(); // the first push creates it
+            return Index{};
+        }
+        indexEtag_ = object.etag;
+        if (object.notModified) {
+            return parseIndex(cachedText);
+        }
+        Index index = parseIndex(object.data);
+        if (mode_ != SyncMode::Status) {
+            system::writeFileAtomic(cached, object.data);
+            state_.indexEtag = object.etag;
+        }
+        return index;
+    }
+
+    static std::string objectName(const std::string& hash) {
+        return "objects/" + hash + ".akv";
+    }
+
+    // Read through the local cache; false when the object is gone or does
+    // not open
+    bool loadObject(const std::string& hash, std::map<std::string, std::string>& keys) {
+        if (hash.size() != 64 || hash.find_first_not_of("0123456789abcdef") != std::string::npos) {
+            return false;
+        }
+        fs::path cached = dir_ / objectName(hash);
+        std::string sealed;
+        if (!readExisting(cached, sealed)) {
+            ++report_.requests;
+            RemoteObject object = remote_.get(objectName(hash), "");
+            if (!object.found || sha256(object.data) != hash) {
+                return false;
+            }
+            sealed.swap(object.data);
+            system::writeFileAtomic(cached, sealed);
+        }
+        std::string text;
+        return crypto::aeadOpen(sealed, passphrase_, text) && parseKeys(text, keys);
+    }
+
+    std::string storeObject(const std::map<std::string, std::string>& keys) {
+        std::string sealed = crypto::aeadSeal(serializeKeys(keys), passphrase_);
+        std::string hash = sha256(sealed);
+        std::string etag;
+        ++report_.requests;
+        remote_.put(objectName(hash), sealed, &NO_ETAG, etag); // false: already there
+        system::writeFileAtomic(dir_ / objectName(hash), sealed);
+        return hash;
+    }
+
+    void applyLocally(const std::string& profile, const std::map<std::string, std::string>& keys,
+                      const std::map<std::string, std::string>* localBase) {
+        auto base = localBase ? std::make_shared<const std::map<std::string, std::string>>(*localBase) : nullptr;
+        saveProfileKeys(cfg_, profile, keys, base);
+        std::vector<std::string> names;
+        for (const auto& entry : loadProfileKeys(cfg_, profile)) {
+            names.push_back(entry.first);
+        }
+        std::vector<std::string> listed = readProfile(cfg_, profile);
+        writeProfile(cfg_, profile, names, &listed);
+        bumpGeneration(cfg_);
+    }
+
+    static const std::string NO_ETAG;
+
+    const core::Config& cfg_;
+    RemoteBackend& remote_;
+    SyncMode mode_;
+    fs::path dir_;
+    fs::path statePath_;
+    std::string passphrase_;
+    std::string indexEtag_;
+    SyncState state_;
+    SyncReport report_;
+};
+
+const std::string Syncer::NO_ETAG;
+
+} // namespace
+
+std::unique_ptr<RemoteBackend> openRemote(const std::string& url) {
+    if (url.rfind("https://", 0) == 0 || url.rfind("http://", 0) == 0) {
+        return std::make_unique<HttpRemote>(url);
+    }
+    if (url.rfind("file://", 0) == 0) {
+        return std::make_unique<FileRemote>(url.substr(7));
+    }
+    if (!url.empty() && url.find("://") == std::string::npos) {
+        return std::make_unique<FileRemote>(url);
+    }
+    throw std::runtime_error("Unsupported remote: " + url + " (use a directory, file:// or http(s)://)");
+}
+
+std::string remoteSetting(const core::Config& cfg) {
+    std::string url = core::getenvs("AK_REMOTE");
+    if (!url.empty()) {
+        return url;
+    }
+    std::ifstream in(fs::path(cfg.configDir) / "remote");
+    std::getline(in, url);
+    return core::trim(url);
+}
+
+void writeRemoteSetting(const core::Config& cfg, const std::string& url) {
+    fs::path path = fs::path(cfg.configDir) / "remote";
+    if (url.empty()) {
+        std::error_code ec;
+        fs::remove(path, ec);
+        return;
+    }
+    system::writeFileAtomic(path, url + "\n");
+}
+
+SyncReport syncProfiles(const core::Config& cfg, RemoteBackend& remote, SyncMode mode) {
+    return Syncer(cfg, remote, mode).run();
+}
+
+} // namespace storage
+} // namespace ak
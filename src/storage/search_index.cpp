@@ -0,0 +1,391 @@
+#include "storage/search_index.hpp"
+#include "storage/vault.hpp"
+#include "system/system.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <regex>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace ak {
+namespace storage {
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// First line of the file; each profile follows as a header line
+// "=<exists> <mtime> <size> <scannedAt> <profile>" and then one
+// "<name>\t<modified>\t<service>" line per key
+const char HEADER[] = "ak-key-index 1";
+
+long long nowNanos() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::system_clock::now().time_since_epoch())
+        .count();
+}
+
+std::string lower(std::string s) {
+    for (auto& c : s) {
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+    return s;
+}
+
+bool globMatch(const char* p, const char* s) {
+    // Backtracks to the last '*' only, so it stays linear in practice
+    const char* star = nullptr;
+    const char* resume = nullptr;
+    while (*s) {
+        if (*p == '[') {
+            const char* q = p + 1;
+            bool negate = *q == '!' || *q == '^';
+            if (negate) {
+                ++q;
+            }
+            bool matched = false;
+            while (*q && *q != ']') {
+                if (q[1] == '-' && q[2] && q[2] != ']') {
+                    matched = matched || (*s >= q[0] && *s <= q[2]);
+                    q += 3;
+                } else {
+                    matched = matched || *s == *q;
+                    ++q;
+                }
+            }
+            if (*q == ']' && matched != negate) {
+                p = q + 1;
+                ++s;
+                continue;
+            }
+        } else if (*p == '?' || (*p && *p != '*' && *p == *s)) {
+            ++p;
+            ++s;
+            continue;
+        } else if (*p == '*') {
+            star = p++;
+            resume = s;
+            continue;
+        }
+        if (!star) {
+            return false;
+        }
+        p = star + 1;
+        s = ++resume;
+    }
+    while (*p == '*') {
+        ++p;
+    }
+    return *p == '\0';
+}
+
+// Padded like pg_trgm ("  name "), so prefixes weigh more than infixes
+std::vector<std::string> trigrams(const std::string& text) {
+    std::string padded = "  " + lower(text) + " ";
+    std::set<std::string> grams;
+    for (size_t i = 0; i + 3 <= padded.size(); ++i) {
+        grams.insert(padded.substr(i, 3));
+    }
+    return std::vector<std::string>(grams.begin(), grams.end());
+}
+
+double similarity(const std::vector<std::string>& a, const std::vector<std::string>& b) {
+    size_t shared = 0;
+    auto i = a.begin();
+    auto j = b.begin();
+    while (i != a.end() && j != b.end()) {
+        if (*i < *j) {
+            ++i;
+        } else if (*j < *i) {
+            ++j;
+        } else {
+            ++shared;
+            ++i;
+            ++j;
+        }
+    }
+    size_t total = a.size() + b.size() - shared;
+    return total == 0 ? 0.0 : static_cast<double>(shared) / static_cast<double>(total);
+}
+
+// Best of the whole name and its _-separated words, so "opnai" still finds
+// OPENAI_API_KEY
+double fuzzyScore(const std::vector<std::string>& query, const std::string& name) {
+    double best = similarity(query, trigrams(name));
+    size_t start = 0;
+    while (start < name.size()) {
+        size_t end = name.find_first_of("_-.", start);
+        if (end == std::string::npos) {
+            end = name.size();
+        }
+        if (end > start && end - start < name.size()) {
+            best = std::max(best, similarity(query, trigrams(name.substr(start, end - start))));
+        }
+        start = end + 1;
+    }
+    return best;
+}
+
+} // namespace
+
+KeyMatch parseKeyQuery(const std::string& query, std::string& pattern) {
+    if (query.size() >= 2 && query.front() == '/' && query.back() == '/') {
+        pattern = query.substr(1, query.size() - 2);
+        return KeyMatch::Regex;
+    }
+    if (query.size() >= 2 && query.front() == '~') {
+        pattern = query.substr(1);
+        return KeyMatch::Fuzzy;
+    }
+    pattern = query;
+    return query.find_first_of("*?[") != std::string::npos ? KeyMatch::Glob : KeyMatch::Substring;
+}
+
+KeySearchIndex::KeySearchIndex(const core::Config& cfg) : cfg_(cfg), path_(path(cfg)) {
+    std::ifstream in(path_);
+    std::string line;
+    if (!std::getline(in, line) || line != HEADER) {
+        return;
+    }
+    ProfileEntry* current = nullptr;
+    while (std::getline(in, line)) {
+        if (line.empty()) {
+            continue;
+        }
+        if (line[0] == '=') {
+            std::istringstream header(line.substr(1));
+            ProfileEntry entry;
+            int exists = 0;
+            std::string profile;
+            if (!(header >> exists >> entry.source.mtime >> entry.source.size >> entry.scannedAt)) {
+                profiles_.clear();
+                return;
+            }
+            entry.source.exists = exists != 0;
+            header.get();
+            std::getline(header, profile);
+            current = &(profiles_[profile] = std::move(entry));
+            continue;
+        }
+        size_t tab = line.find('\t');
+        size_t tab2 = tab == std::string::npos ? tab : line.find('\t', tab + 1);
+        if (!current || tab2 == std::string::npos) {
+            profiles_.clear();
+            return;
+        }
+        KeyRecord record;
+        record.modified = std::atoll(line.substr(tab + 1, tab2 - tab - 1).c_str());
+        record.service = line.substr(tab2 + 1);
+        current->keys[line.substr(0, tab)] = std::move(record);
+    }
+}
+
+std::string KeySearchIndex::path(const core::Config& cfg) {
+    return cfg.persistDir + "/keys.idx";
+}
+
+void KeySearchIndex::reread(const std::string& profile, ProfileEntry& entry, const PathStamp& source, long long now) {
+    std::map<std::string, KeyRecord> keys;
+    for (const auto& name : readProfile(cfg_, profile)) {
+        if (name.find('\t') != std::string::npos) {
+            continue;
+        }
+        auto known = entry.keys.find(name);
+        if (known != entry.keys.end()) {
+            keys[name] = std::move(known->second);
+        } else {
+            // Best guess for keys that appeared outside our writes
+            keys[name] = KeyRecord{source.mtime, getServiceForKeyName(name)};
+        }
+    }
+    entry.keys = std::move(keys);
+    entry.source = source;
+    entry.scannedAt = now;
+    changed_ = true;
+}
+
+void KeySearchIndex::refresh() {
+    long long now = nowNanos();
+    std::unordered_set<std::string> present;
+    for (const auto& profile : listProfiles(cfg_)) {
+        present.insert(profile);
+        PathStamp source = stampPath(profilePath(cfg_, profile).string());
+        auto it = profiles_.find(profile);
+        if (it != profiles_.end() && it->second.source == source &&
+            source.mtime + MetadataCache::RACY_WINDOW < it->second.scannedAt) {
+            continue;
+        }
+        reread(profile, profiles_[profile], source, now);
+    }
+    for (auto it = profiles_.begin(); it != profiles_.end();) {
+        if (present.count(it->first)) {
+            ++it;
+        } else {
+            it = profiles_.erase(it);
+            changed_ = true;
+        }
+    }
+}
+
+void KeySearchIndex::setProfile(const std::string& profile, const std::vector<std::string>& names) {
+    long long now = nowNanos();
+    ProfileEntry& entry = profiles_[profile];
+    std::map<std::string, KeyRecord> keys;
+    for (const auto& name : names) {
+        if (name.empty() || name.find('\t') != std::string::npos || name.find('\n') != std::string::npos) {
+            continue;
+        }
+        auto known = entry.keys.find(name);
+        if (known != entry.keys.end()) {
+            keys[name] = std::move(known->second);
+        } else {
+            keys[name] = KeyRecord{now, getServiceForKeyName(name)};
+        }
+    }
+    entry.keys = std::move(keys);
+    entry.source = stampPath(profilePath(cfg_, profile).string());
+    entry.scannedAt = now;
+    changed_ = true;
+}
+
+void KeySearchIndex::touch(const std::string& profile, const std::vector<std::string>& names) {
+    auto it = profiles_.find(profile);
+    if (it == profiles_.end()) {
+        return;
+    }
+    long long now = nowNanos();
+    for (const auto& name : names) {
+        auto key = it->second.keys.find(name);
+        if (key != it->second.keys.end()) {
+            key->second.modified = now;
+            changed_ = true;
+        }
+    }
+}
+
+void KeySearchIndex::removeProfile(const std::string& profile) {
+    if (profiles_.erase(profile)) {
+        changed_ = true;
+    }
+}
+
+std::vector<KeySearchHit> KeySearchIndex::search(const std::string& pattern, KeyMatch mode,
+                                                 const std::string& profile) const {
+    std::regex re;
+    if (mode == KeyMatch::Regex) {
+        try {
+            re = std::regex(pattern, std::regex::ECMAScript | std::regex::icase);
+        } catch (const std::regex_error& e) {
+            throw std::runtime_error("Invalid regex '" + pattern + "': " + e.what());
+        }
+    }
+    std::string needle = lower(pattern);
+    std::vector<std::string> queryGrams = mode == KeyMatch::Fuzzy ? trigrams(pattern) : std::vector<std::string>();
+
+    // Each distinct name is matched once, however many profiles hold it
+    std::map<std::string, KeySearchHit> hits;
+    std::unordered_map<std::string, bool> verdicts;
+    std::unordered_map<std::string, double> scores;
+    for (const auto& [profileName, entry] : profiles_) {
+        if (!profile.empty() && profileName != profile) {
+            continue;
+        }
+        for (const auto& [name, record] : entry.keys) {
+            auto verdict = verdicts.find(name);
+            if (verdict == verdicts.end()) {
+                bool matched = false;
+                switch (mode) {
+                case KeyMatch::Substring:
+                    matched = lower(name).find(needle) != std::string::npos;
+                    break;
+                case KeyMatch::Glob:
+                    matched = globMatch(needle.c_str(), lower(name).c_str());
+                    break;
+                case KeyMatch::Regex:
+                    matched = std::regex_search(name, re);
+                    break;
+                case KeyMatch::Fuzzy: {
+                    double score = fuzzyScore(queryGrams, name);
+                    matched = score >= FUZZY_THRESHOLD;
+                    scores[name] = score;
+                    break;
+                }
+                }
+                verdict = verdicts.emplace(name, matched).first;
+            }
+            if (!verdict->second) {
+                continue;
+            }
+            KeySearchHit& hit = hits[name];
+            if (hit.name.empty()) {
+                hit.name = name;
+                hit.service = record.service;
+                auto score = scores.find(name);
+                hit.score = score == scores.end() ? 1.0 : score->second;
+            }
+            hit.profiles.push_back(profileName);
+            hit.modified = std::max(hit.modified, record.modified);
+        }
+    }
+
+    std::vector<KeySearchHit> out;
+    out.reserve(hits.size());
+    for (auto& entry : hits) {
+        out.push_back(std::move(entry.second));
+    }
+    if (mode == KeyMatch::Fuzzy) {
+        std::stable_sort(out.begin(), out.end(),
+                         [](const KeySearchHit& a, const KeySearchHit& b) { return a.score > b.score; });
+    }
+    return out;
+}
+
+void KeySearchIndex::save() {
+    if (!changed_) {
+        return;
+    }
+    changed_ = false;
+    std::string data = HEADER;
+    data += '\n';
+    for (const auto& [profile, entry] : profiles_) {
+        data += "=" + std::string(entry.source.exists ? "1" : "0") + " " + std::to_string(entry.source.mtime) + " " +
+                std::to_string(entry.source.size) + " " + std::to_string(entry.scannedAt) + " " + profile + "\n";
+        for (const auto& [name, record] : entry.keys) {
+            data += name + "\t" + std::to_string(record.modified) + "\t" + record.service + "\n";
+        }
+    }
+
+    std::error_code ec;
+    fs::create_directories(fs::path(path_).parent_path(), ec);
+    try {
+        system::writeFileAtomic(path_, data);
+    } catch (const std::runtime_error&) {
+        // Only an index: the next search rescans
+    }
+}
+
+void recordProfileNames(const core::Config& cfg, const std::string& profile, const std::vector<std::string>& names) {
+    KeySearchIndex index(cfg);
+    index.setProfile(profile, names);
+    index.save();
+}
+
+void touchProfileNames(const core::Config& cfg, const std::string& profile, const std::vector<std::string>& names) {
+    if (names.empty()) {
+        return;
+    }
+    KeySearchIndex index(cfg);
+    index.touch(profile, names);
+    index.save();
+}
+
+} // namespace storage
+} // namespace ak
@@ -0,0 +1,91 @@
+#include "storage/transaction.hpp"
+#include "storage/vault.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace ak {
+namespace storage {
+
+Transaction::Transaction(const core::Config& cfg, std::string profile)
+    : cfg_(cfg), profile_(std::move(profile)), vault_(loadVault(cfg)) {
+    if (!profile_.empty()) {
+        profileList_ = readProfile(cfg_, profile_);
+        profileListBase_ = profileList_;
+        listed_.insert(profileList_.begin(), profileList_.end());
+        // Through the cache, so commit can hand saveProfileKeys a diff
+        profileKeysBase_ = loadProfileKeysCached(cfg_, profile_);
+        profileKeys_ = *profileKeysBase_;
+    }
+}
+
+void Transaction::put(const std::string& name, const std::string& value) {
+    auto it = vault_.kv.find(name);
+    if (it == vault_.kv.end()) {
+        vault_.kv.emplace(name, value);
+        ++stats_.addedToVault;
+        vaultChanged_ = true;
+    } else if (it->second != value) {
+        it->second = value;
+        ++stats_.updatedInVault;
+        vaultChanged_ = true;
+    }
+
+    if (!profile_.empty()) {
+        auto& slot = profileKeys_[name];
+        if (slot != value) {
+            slot = value;
+            keysChanged_ = true;
+        }
+        if (listed_.insert(name).second) {
+            profileList_.push_back(name);
+            ++stats_.addedToProfile;
+            listChanged_ = true;
+        }
+    }
+    touched_.push_back(name);
+}
+
+bool Transaction::remove(const std::string& name) {
+    bool found = false;
+    if (vault_.kv.erase(name)) {
+        ++stats_.removedFromVault;
+        vaultChanged_ = true;
+        found = true;
+    }
+    if (!profile_.empty()) {
+        if (profileKeys_.erase(name)) {
+            keysChanged_ = true;
+            found = true;
+        }
+        if (listed_.erase(name)) {
+            profileList_.erase(std::find(profileList_.begin(), profileList_.end(), name));
+            listChanged_ = true;
+            found = true;
+        }
+    }
+    if (found) {
+        touched_.push_back(name);
+    }
+    return found;
+}
+
+void Transaction::commit() {
+    if (committed_) {
+        throw std::logic_error("Transaction already committed");
+    }
+    committed_ = true;
+
+    if (vaultChanged_) {
+        saveVault(cfg_, vault_);
+    }
+    if (listChanged_) {
+        writeProfile(cfg_, profile_, profileList_, &profileListBase_);
+    }
+    if (keysChanged_) {
+        saveProfileKeys(cfg_, profile_, profileKeys_, profileKeysBase_);
+    }
+}
+
+} // namespace storage
+} // namespace ak
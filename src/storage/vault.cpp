@@ -1,15 +1,34 @@
 #include "storage/vault.hpp"
+#include "storage/importer.hpp"
+#include "storage/completion_index.hpp"
+#include "storage/search_index.hpp"
+#include "storage/metadata_cache.hpp"
+#include "storage/content_store.hpp"
 #include "crypto/crypto.hpp"
+#include "crypto/aead.hpp"
 #include "system/system.hpp"
 #include "core/config.hpp"
+#include "core/metrics.hpp"
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <string_view>
 #include <algorithm>
 #include <unordered_set>
 #include <filesystem>
+#include <atomic>
+#include <cstdlib>
+#include <chrono>
+#include <future>
+#include <mutex>
+#include <unordered_map>
+#include <random>
+#include <cstdio>
 #ifdef __unix__
+#include <sys/file.h>
 #include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 #endif
 
 namespace ak {
@@ -17,99 +36,223 @@ namespace storage {
 
 namespace fs = std::filesystem;
 
-// Vault operations
-core::KeyStore loadVault(const core::Config& cfg) {
-    core::KeyStore ks;
-    if (!fs::exists(cfg.vaultPath)) {
-        return ks;
-    }
-    
-    std::string data;
-    if (cfg.gpgAvailable && !cfg.forcePlain && 
-        cfg.vaultPath.size() > 4 && 
-        cfg.vaultPath.substr(cfg.vaultPath.size() - 4) == ".gpg") {
-        
-        int rc = 0;
-        if (!cfg.presetPassphrase.empty()) {
-            auto pfile = fs::path(cfg.configDir) / ".pass.tmp";
-            {
-                std::ofstream pf(pfile, std::ios::trunc);
-                pf << cfg.presetPassphrase;
-                pf.close();
-            }
+namespace {
+
+std::atomic<unsigned long> tmpCounter{0};
+
+std::string processTag() {
 #ifdef __unix__
-            ::chmod(pfile.c_str(), 0600);
+    return std::to_string(::getpid()) + "." + std::to_string(tmpCounter++);
+#else
+    return "0." + std::to_string(tmpCounter++);
 #endif
-            std::string cmd = "gpg --batch --yes --quiet --pinentry-mode loopback --passphrase-file '" + 
-                             pfile.string() + "' --decrypt '" + cfg.vaultPath + "' 2>/dev/null";
-            data = system::runCmdCapture(cmd, &rc);
-            fs::remove(pfile);
-        } else {
-            data = system::runCmdCapture("gpg --quiet --decrypt '" + cfg.vaultPath + "' 2>/dev/null", &rc);
+}
+
+#ifdef __unix__
+bool writeAll(int fd, const std::string& contents) {
+    const char* p = contents.data();
+    size_t left = contents.size();
+    while (left > 0) {
+        ssize_t n = ::write(fd, p, left);
+        if (n <= 0) {
+            return false;
         }
-        
-        if (rc != 0) {
-            std::cerr << "⚠️  Failed to decrypt vault\n";
-            return ks;
+        p += n;
+        left -= static_cast<size_t>(n);
+    }
+    return true;
+}
+#endif
+
+// Create (or truncate) a file readable only by the owner and fill it. The
+// data reaches the disk before this returns, so a rename over the real file
+// can never leave it empty after a crash.
+void writePrivateFile(const fs::path& path, const std::string& contents) {
+#ifdef __unix__
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to create " + path.string());
+    }
+    if (!writeAll(fd, contents) || ::fsync(fd) != 0) {
+        ::close(fd);
+        throw std::runtime_error("Failed to write " + path.string());
+    }
+    ::close(fd);
+#else
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out << contents;
+    if (!out) {
+        throw std::runtime_error("Failed to write " + path.string());
+    }
+#endif
+}
+
+// Persist a rename into `path`'s directory
+void syncParentDir(const fs::path& path) {
+#ifdef __unix__
+    int fd = ::open(path.parent_path().c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd >= 0) {
+        ::fsync(fd);
+        ::close(fd);
+    }
+#else
+    (void)path;
+#endif
+}
+
+// Write the preset passphrase to a private temp file for gpg. Names are unique
+// per process and call so concurrent decrypts never clobber or delete each
+// other's passphrase file.
+fs::path writePassphraseFile(const core::Config& cfg) {
+    auto pfile = fs::path(cfg.configDir) / (".pass." + processTag() + ".tmp");
+    writePrivateFile(pfile, cfg.presetPassphrase);
+    return pfile;
+}
+
+// Passphrase for the aead backend: AK_PASSPHRASE, otherwise asked for once per
+// process when prompting is allowed and we are attached to a terminal.
+std::string aeadPassphrase(const core::Config& cfg, bool allowPrompt) {
+    if (!cfg.presetPassphrase.empty()) {
+        return cfg.presetPassphrase;
+    }
+    static std::mutex promptMutex;
+    static std::string prompted;
+    std::lock_guard<std::mutex> lock(promptMutex);
+#ifdef __unix__
+    if (prompted.empty() && allowPrompt && ::isatty(STDIN_FILENO)) {
+        prompted = system::promptSecret("🔐 Vault passphrase: ");
+    }
+#else
+    if (prompted.empty() && allowPrompt) {
+        prompted = system::promptSecret("Vault passphrase: ");
+    }
+#endif
+    return prompted;
+}
+
+bool hasSuffix(const std::string& s, const std::string& suffix) {
+    return s.size() > suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// Strip a backend extension, e.g. "keys.env.gpg" -> "keys.env"
+std::string stripBackendSuffix(const std::string& path) {
+    for (const char* ext : {".gpg", ".akv"}) {
+        if (hasSuffix(path, ext)) {
+            return path.substr(0, path.size() - 4);
         }
-    } else {
-        std::ifstream in(cfg.vaultPath);
+    }
+    return path;
+}
+
+std::string backendSuffix(Backend backend) {
+    switch (backend) {
+        case Backend::Gpg: return ".gpg";
+        case Backend::Aead: return ".akv";
+        case Backend::Plain: break;
+    }
+    return "";
+}
+
+template <typename Map>
+std::string serializeKeys(const Map& kv) {
+    std::string out;
+    for (const auto& [key, value] : kv) {
+        out += key;
+        out += '=';
+        out += crypto::base64Encode(value);
+        out += '\n';
+    }
+    return out;
+}
+
+enum class ReadStatus { Ok, NoPassphrase, Failed };
+
+// Read a vault or profile key file in whatever format its extension says
+ReadStatus readSealedFile(const core::Config& cfg, const fs::path& path, bool allowPrompt, std::string& data) {
+    auto name = path.string();
+    if (hasSuffix(name, ".akv")) {
+        std::ifstream in(path, std::ios::binary);
         std::ostringstream ss;
         ss << in.rdbuf();
-        data = ss.str();
+        std::string pass = aeadPassphrase(cfg, allowPrompt);
+        if (pass.empty()) {
+            return ReadStatus::NoPassphrase;
+        }
+        std::string sealed = ss.str();
+        if (crypto::isAeadBlob(sealed) && !crypto::aeadParamsSupported(sealed)) {
+            std::cerr << "⚠️  Refusing to open " << name << ": its header asks for unsupported scrypt parameters\n";
+            return ReadStatus::Failed;
+        }
+        core::metrics::count("ak_sealed_bytes_read_total", {{"backend", "aead"}}, sealed.size());
+        core::metrics::Span span("ak_decrypt", {{"backend", "aead"}});
+        return crypto::aeadOpen(sealed, pass, data) ? ReadStatus::Ok : ReadStatus::Failed;
     }
-    
-    std::istringstream lines(data);
-    std::string line;
-    while (std::getline(lines, line)) {
-        if (line.empty() || line[0] == '#') {
-            continue;
+
+    if (hasSuffix(name, ".gpg")) {
+        if (!cfg.gpgAvailable) {
+            return ReadStatus::Failed;
         }
-        auto eq = line.find('=');
-        if (eq == std::string::npos) {
-            continue;
+        int rc = 0;
+        core::metrics::Span span("ak_decrypt", {{"backend", "gpg"}});
+        if (!cfg.presetPassphrase.empty()) {
+            auto pfile = writePassphraseFile(cfg);
+            std::string cmd = "gpg --batch --yes --quiet --pinentry-mode loopback --passphrase-file '" +
+                             pfile.string() + "' --decrypt '" + name + "' 2>/dev/null";
+            data = system::runCmdCapture(cmd, &rc);
+            fs::remove(pfile);
+        } else if (allowPrompt) {
+            data = system::runCmdCapture("gpg --quiet --decrypt '" + name + "' 2>/dev/null", &rc);
+        } else {
+            return ReadStatus::NoPassphrase;
         }
-        std::string key = line.substr(0, eq);
-        std::string encoded = line.substr(eq + 1);
-        ks.kv[key] = crypto::base64Decode(encoded);
+        if (core::metrics::enabled()) {
+            std::error_code ec;
+            auto size = fs::file_size(path, ec);
+            core::metrics::count("ak_sealed_bytes_read_total", {{"backend", "gpg"}}, ec ? 0 : size);
+        }
+        return rc == 0 ? ReadStatus::Ok : ReadStatus::Failed;
     }
-    
-    return ks;
+
+    std::ifstream in(path);
+    std::ostringstream ss;
+    ss << in.rdbuf();
+    data = ss.str();
+    return ReadStatus::Ok;
 }
 
-void saveVault(const core::Config& cfg, const core::KeyStore& ks) {
-    fs::create_directories(fs::path(cfg.vaultPath).parent_path());
-    auto tmp = fs::path(cfg.vaultPath).parent_path() / ".tmp.ak.vault";
-    
-    {
-        std::ofstream out(tmp);
-        for (const auto& pair : ks.kv) {
-            out << pair.first << "=" << crypto::base64Encode(pair.second) << "\n";
+// Write data to path in the format its extension says, via tmp + rename.
+// `tmp` must be unique to the caller (see processTag). Only the gpg path
+// ever puts plaintext on disk (gpg needs an input file).
+void writeSealedFile(const core::Config& cfg, const fs::path& path, const fs::path& tmp,
+                     const std::string& data, const std::string& what) {
+    auto name = path.string();
+    if (hasSuffix(name, ".akv")) {
+        std::string pass = aeadPassphrase(cfg, true);
+        if (pass.empty()) {
+            throw std::runtime_error("A passphrase is required to encrypt " + what + " (set AK_PASSPHRASE)");
         }
+        writePrivateFile(tmp, crypto::aeadSeal(data, pass));
+        fs::rename(tmp, path);
+        syncParentDir(path);
+        return;
     }
-    
-    if (cfg.gpgAvailable && !cfg.forcePlain && 
-        cfg.vaultPath.size() > 4 && 
-        cfg.vaultPath.substr(cfg.vaultPath.size() - 4) == ".gpg") {
-        
+
+    writePrivateFile(tmp, data);
+
+    if (hasSuffix(name, ".gpg") && cfg.gpgAvailable) {
         std::string cmd;
         std::string passFile;
+        // gpg writes beside the target and the result is renamed in, so a
+        // reader never sees a half-written file
+        std::string sealedTmp = tmp.string() + ".gpg";
         
         if (!cfg.presetPassphrase.empty()) {
-            passFile = (fs::path(cfg.configDir) / ".pass.tmp").string();
-            {
-                std::ofstream pf(passFile, std::ios::trunc);
-                pf << cfg.presetPassphrase;
-                pf.close();
-            }
-#ifdef __unix__
-            ::chmod(passFile.c_str(), 0600);
-#endif
-            cmd = "gpg --batch --yes -o '" + cfg.vaultPath + 
-                  "' --pinentry-mode loopback --passphrase-file '" + passFile + 
+            passFile = writePassphraseFile(cfg).string();
+            cmd = "gpg --batch --yes -o '" + sealedTmp +
+                  "' --pinentry-mode loopback --passphrase-file '" + passFile +
                   "' --symmetric --cipher-algo AES256 '" + tmp.string() + "'";
         } else {
-            cmd = "gpg --yes -o '" + cfg.vaultPath + 
+            cmd = "gpg --yes -o '" + sealedTmp +
                   "' --symmetric --cipher-algo AES256 '" + tmp.string() + "'";
         }
         
@@ -117,359 +260,1801 @@ void saveVault(const core::Config& cfg, const core::KeyStore& ks) {
         if (!passFile.empty()) {
             fs::remove(passFile);
         }
+        fs::remove(tmp);
         
         if (rc != 0) {
-            throw std::runtime_error("Failed to encrypt vault with gpg");
+            std::error_code ec;
+            fs::remove(sealedTmp, ec);
+            throw std::runtime_error("Failed to encrypt " + what + " with gpg");
         }
-        
-        fs::remove(tmp);
+        fs::rename(sealedTmp, path);
+    } else {
+        fs::rename(tmp, path);
+    }
+    syncParentDir(path);
+}
+
+// One write of a file: every replace-by-rename gives it a new inode, so the
+// stamp changes even when size and (coarse) mtime do not
+struct FileStamp {
+    bool exists = false;
+    long long mtime = 0;
+    unsigned long long size = 0;
+    unsigned long long inode = 0;
+
+    bool operator==(const FileStamp& o) const {
+        return exists == o.exists && mtime == o.mtime && size == o.size && inode == o.inode;
+    }
+    bool operator!=(const FileStamp& o) const { return !(*this == o); }
+};
+
+FileStamp stampFile(const fs::path& path) {
+    FileStamp st;
+#ifdef __unix__
+    struct stat info;
+    if (::stat(path.c_str(), &info) != 0) {
+        return st;
+    }
+    st.exists = true;
+    st.size = static_cast<unsigned long long>(info.st_size);
+    st.mtime = static_cast<long long>(info.st_mtim.tv_sec) * 1000000000LL + info.st_mtim.tv_nsec;
+    st.inode = static_cast<unsigned long long>(info.st_ino);
+#else
+    std::error_code ec;
+    auto size = fs::file_size(path, ec);
+    if (ec) {
+        return st;
+    }
+    auto mtime = fs::last_write_time(path, ec);
+    if (ec) {
+        return st;
+    }
+    st.exists = true;
+    st.size = size;
+    st.mtime = static_cast<long long>(mtime.time_since_epoch().count());
+#endif
+    return st;
+}
+
+std::string fileVersion(const fs::path& path) {
+    FileStamp st = stampFile(path);
+    if (!st.exists) {
+        return "";
+    }
+    return std::to_string(st.inode) + ":" + std::to_string(st.size) + ":" + std::to_string(st.mtime);
+}
+
+// Apply the edits that turn `base` into `mine` to `current`: keys set or
+// changed in `mine` win, keys it dropped are dropped, the rest of `current`
+// (another writer's keys) is kept
+template <typename Map>
+void mergeChanges(const Map& base, const Map& mine, Map& current) {
+    for (const auto& [name, value] : mine) {
+        auto it = base.find(name);
+        if (it == base.end() || it->second != value) {
+            current[name] = value;
+        }
+    }
+    for (const auto& entry : base) {
+        if (!mine.count(entry.first)) {
+            current.erase(entry.first);
+        }
+    }
+}
+
+// Writers of one profile serialize on this for their final read-and-write
+// only; see saveProfileKeys. Everything named *Locked expects it held.
+fs::path profileLockPath(const core::Config& cfg, const std::string& profileName) {
+    return fs::path(cfg.profilesDir) / ("." + profileName + ".lock");
+}
+
+// The vault file to read: the configured path, or the same vault stored by
+// another backend before a switch (until `ak migrate` converts it).
+std::string resolveVaultFile(const core::Config& cfg) {
+    if (fs::exists(cfg.vaultPath.get())) {
+        return cfg.vaultPath.get();
+    }
+    std::string base = stripBackendSuffix(cfg.vaultPath.get());
+    for (Backend b : {Backend::Aead, Backend::Gpg, Backend::Plain}) {
+        std::string candidate = base + backendSuffix(b);
+        if (candidate != cfg.vaultPath.get() && fs::exists(candidate)) {
+            return candidate;
+        }
+    }
+    return cfg.vaultPath.get();
+}
+
+} // namespace
+
+// Storage backends
+Backend activeBackend(const core::Config& cfg) {
+    if (cfg.forcePlain) {
+        return Backend::Plain;
+    }
+    Backend configured;
+    if (parseBackend(cfg.backend, configured) && backendSupported(cfg, configured)) {
+        return configured;
+    }
+    return cfg.gpgAvailable ? Backend::Gpg : Backend::Plain;
+}
+
+const char* backendName(Backend backend) {
+    switch (backend) {
+        case Backend::Gpg: return "gpg";
+        case Backend::Aead: return "aead";
+        case Backend::Plain: break;
+    }
+    return "plain";
+}
+
+bool parseBackend(const std::string& name, Backend& backend) {
+    std::string n = core::toLower(core::trim(name));
+    if (n == "gpg") {
+        backend = Backend::Gpg;
+    } else if (n == "aead" || n == "akv") {
+        backend = Backend::Aead;
+    } else if (n == "plain") {
+        backend = Backend::Plain;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool backendSupported(const core::Config& cfg, Backend backend) {
+    switch (backend) {
+        case Backend::Gpg: return cfg.gpgAvailable;
+        case Backend::Aead: return crypto::aeadAvailable();
+        case Backend::Plain: break;
+    }
+    return true;
+}
+
+std::string readBackendSetting(const core::Config& cfg) {
+    std::ifstream in(fs::path(cfg.configDir) / "backend");
+    std::string name;
+    std::getline(in, name);
+    return core::trim(name);
+}
+
+void writeBackendSetting(const core::Config& cfg, Backend backend) {
+    fs::create_directories(cfg.configDir);
+    std::ofstream out(fs::path(cfg.configDir) / "backend", std::ios::trunc);
+    out << backendName(backend) << "\n";
+}
+
+std::string vaultPathFor(const core::Config& cfg, Backend backend) {
+    return cfg.configDir + "/keys.env" + backendSuffix(backend);
+}
+
+core::Config loadConfig(const std::string& configDir) {
+    core::Config cfg;
+    if (configDir.empty()) {
+        std::string base = core::getenvs("XDG_CONFIG_HOME", core::getenvs("HOME") + "/.config");
+        cfg.configDir = base + "/ak";
     } else {
-        fs::rename(tmp, cfg.vaultPath);
+        cfg.configDir = configDir;
+    }
+    cfg.profilesDir = cfg.configDir + "/profiles";
+
+    if (getenv("AK_DISABLE_GPG")) {
+        cfg.forcePlain = true;
+    }
+    if (getenv("AK_PASSPHRASE")) {
+        cfg.presetPassphrase = core::getenvs("AK_PASSPHRASE");
+    }
+    // Probing spawns a shell; only commands that touch gpg pay for it
+    bool forcePlain = cfg.forcePlain;
+    cfg.gpgAvailable = core::Lazy<bool>::deferred([forcePlain] { return !forcePlain && core::commandExists("gpg"); });
+
+    const char* backend = getenv("AK_BACKEND");
+    cfg.backend = backend ? std::string(backend) : readBackendSetting(cfg);
+    cfg.profileLog = core::getenvs("AK_PROFILE_LOG") == "1";
+    cfg.contentStore = core::getenvs("AK_CONTENT_STORE") == "1";
+    cfg.auditLogPath = cfg.configDir + "/audit.log";
+    cfg.metricsFile = core::getenvs("AK_METRICS_FILE");
+    cfg.otlpEndpoint = core::getenvs("AK_OTLP_ENDPOINT");
+
+    system::ensureSecureDir(cfg.configDir);
+    cfg.persistDir = cfg.configDir + "/persist";
+    // The vault path may depend on gpg; persistDir is created with the instance id
+    core::Config resolved = cfg;
+    cfg.vaultPath = core::Lazy<std::string>::deferred(
+        [resolved] { return vaultPathFor(resolved, activeBackend(resolved)); });
+    cfg.instanceId = core::Lazy<std::string>::deferred([resolved] { return core::loadOrCreateInstanceId(resolved); });
+    return cfg;
+}
+
+// Vault operations
+namespace {
+
+// The decrypted key file; empty when there is no vault
+bool readVaultData(const core::Config& cfg, const std::string& path, std::string& data) {
+    if (!fs::exists(path)) {
+        data.clear();
+        return true;
+    }
+    if (readSealedFile(cfg, path, true, data) != ReadStatus::Ok) {
+        return false;
+    }
+    core::metrics::count("ak_bytes_parsed_total", {{"format", "vault"}}, data.size());
+    return true;
+}
+
+} // namespace
+
+bool tryLoadVaultTable(const core::Config& cfg, KeyTable& table) {
+    std::string data;
+    if (!readVaultData(cfg, resolveVaultFile(cfg), data)) {
+        return false;
+    }
+    table = KeyTable::parse(std::move(data));
+    return true;
+}
+
+bool tryLoadVault(const core::Config& cfg, core::KeyStore& ks) {
+    // Stamped before the read: a write landing in between only costs the
+    // next save a merge
+    std::string path = resolveVaultFile(cfg);
+    std::string version = fileVersion(path);
+    std::string data;
+    if (!readVaultData(cfg, path, data)) {
+        return false;
+    }
+    parseKeyLines(data, ks.kv);
+    ks.base = ks.kv;
+    ks.basePath = path;
+    ks.baseVersion = version;
+    return true;
+}
+
+KeyTable loadVaultTable(const core::Config& cfg) {
+    KeyTable table;
+    if (!tryLoadVaultTable(cfg, table)) {
+        std::cerr << "⚠️  Failed to decrypt vault\n";
+        table = KeyTable();
+    }
+    return table;
+}
+
+core::KeyStore loadVault(const core::Config& cfg) {
+    core::KeyStore ks;
+    if (!tryLoadVault(cfg, ks)) {
+        std::cerr << "⚠️  Failed to decrypt vault\n";
+        ks.kv.clear();
+    }
+    return ks;
+}
+
+void saveVault(const core::Config& cfg, const core::KeyStore& ks) {
+    auto dir = fs::path(cfg.vaultPath.get()).parent_path();
+    fs::create_directories(dir);
+    auto tmp = dir / (".tmp.ak.vault." + processTag());
+
+    // Readers never lock; writers hold it only for the check and the write
+    system::FileLock lock(dir / ".vault.lock");
+    const auto* keys = &ks.kv;
+    std::unordered_map<std::string, std::string> merged;
+    if (ks.basePath == cfg.vaultPath.get() && fileVersion(ks.basePath) != ks.baseVersion) {
+        // Another writer got in first: apply only our changes to its vault
+        core::KeyStore current;
+        if (!tryLoadVault(cfg, current)) {
+            throw std::runtime_error("The vault changed while saving and could not be decrypted to merge");
+        }
+        merged = std::move(current.kv);
+        mergeChanges(ks.base, ks.kv, merged);
+        keys = &merged;
+        core::metrics::count("ak_write_conflicts_total", {{"store", "vault"}});
+    }
+    writeSealedFile(cfg, cfg.vaultPath.get(), tmp, serializeKeys(*keys), "vault");
+    bumpGeneration(cfg);
+
+    std::vector<std::string> names;
+    names.reserve(keys->size());
+    for (const auto& entry : *keys) {
+        names.push_back(entry.first);
+    }
+    recordVaultNames(cfg, std::move(names));
+}
+
+// Profile operations
+fs::path profilePath(const core::Config& cfg, const std::string& name) {
+    return fs::path(cfg.profilesDir) / (name + ".profile");
+}
+
+std::vector<ProfileSummary> listProfileSummaries(const core::Config& cfg) {
+    std::vector<ProfileSummary> profiles;
+    PathStamp dir = stampPath(cfg.profilesDir);
+    if (!dir.exists) {
+        return profiles;
+    }
+    MetadataCache meta(cfg);
+    if (meta.profiles(dir, profiles)) {
+        return profiles;
+    }
+
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator(cfg.profilesDir, ec)) {
+        if (!entry.is_regular_file()) {
+            continue;
+        }
+        auto filename = entry.path().filename().string();
+        if (filename.size() > 8 && filename.substr(filename.size() - 8) == ".profile") {
+            ProfileSummary summary;
+            summary.name = filename.substr(0, filename.size() - 8);
+            summary.keyCount = readProfile(cfg, summary.name).size();
+            profiles.push_back(std::move(summary));
+        }
+    }
+
+    std::sort(profiles.begin(), profiles.end(),
+              [](const ProfileSummary& a, const ProfileSummary& b) { return a.name < b.name; });
+    meta.setProfiles(dir, profiles);
+    meta.save();
+    return profiles;
+}
+
+std::vector<std::string> listProfiles(const core::Config& cfg) {
+    std::vector<std::string> names;
+    for (auto& summary : listProfileSummaries(cfg)) {
+        names.push_back(std::move(summary.name));
+    }
+    return names;
+}
+
+std::vector<std::string> readProfile(const core::Config& cfg, const std::string& name) {
+    std::vector<std::string> keys;
+    auto path = profilePath(cfg, name);
+    if (!fs::exists(path)) {
+        return keys;
+    }
+    
+    std::ifstream in(path);
+    std::string line;
+    while (std::getline(in, line)) {
+        line = core::trim(line);
+        if (!line.empty()) {
+            keys.push_back(line);
+        }
+    }
+    
+    return keys;
+}
+
+void writeProfile(const core::Config& cfg, const std::string& name, const std::vector<std::string>& keys,
+                  const std::vector<std::string>* base) {
+    fs::create_directories(cfg.profilesDir);
+    system::FileLock lock(profileLockPath(cfg, name));
+    std::vector<std::string> sorted = keys;
+    if (base) {
+        auto current = readProfile(cfg, name);
+        if (current != *base) {
+            std::unordered_set<std::string> before(base->begin(), base->end());
+            std::unordered_set<std::string> after(keys.begin(), keys.end());
+            sorted.clear();
+            for (const auto& key : current) {
+                if (after.count(key) || !before.count(key)) {
+                    sorted.push_back(key);
+                }
+            }
+            for (const auto& key : keys) {
+                if (!before.count(key)) {
+                    sorted.push_back(key);
+                }
+            }
+        }
+    }
+    std::unordered_set<std::string> seen;
+    std::sort(sorted.begin(), sorted.end());
+
+    std::string data;
+    for (const auto& key : sorted) {
+        if (seen.insert(key).second) {
+            data += key;
+            data += '\n';
+        }
+    }
+    // Replaced by rename so the directory's mtime tracks every list change
+    // (see MetadataCache)
+    auto path = profilePath(cfg, name);
+    auto tmp = fs::path(cfg.profilesDir) / ("." + name + ".profile." + processTag() + ".tmp");
+    try {
+        writePrivateFile(tmp, data);
+    } catch (const std::exception&) {
+        std::error_code ec;
+        fs::remove(tmp, ec);
+        throw std::runtime_error("Failed to write profile " + name);
+    }
+    fs::rename(tmp, path);
+    bumpGeneration(cfg);
+
+    std::vector<std::string> names;
+    names.reserve(seen.size());
+    for (const auto& key : sorted) {
+        if (names.empty() || names.back() != key) {
+            names.push_back(key);
+        }
+    }
+    recordProfileNames(cfg, name, names);
+}
+
+// Persistence operations
+std::string dirKey(const std::string& dir) {
+    crypto::SHA256 hasher;
+    hasher.update(dir);
+    return hasher.final().substr(0, 16);
+}
+
+std::string mappingFileForDir(const core::Config& cfg, const std::string& dir) {
+    return cfg.persistDir + "/" + dirKey(dir) + ".mapping";
+}
+
+std::string dirIndexFile(const core::Config& cfg) {
+    return cfg.persistDir + "/dirs";
+}
+
+namespace {
+
+const char* const DIR_INDEX_HEADER = "# ak dirs v1";
+
+// All persisted directories, sorted by path. `legacy` counts per-directory
+// .mapping files that are not folded in yet; while it is zero lookups never
+// touch anything but the index.
+struct DirIndex {
+    std::vector<DirMapping> entries;
+    long legacy = 0;
+};
+
+std::string escapeIndexField(const std::string& value) {
+    std::string out;
+    out.reserve(value.size());
+    for (char c : value) {
+        switch (c) {
+            case '\\': out += "\\\\"; break;
+            case '\t': out += "\\t"; break;
+            case '\n': out += "\\n"; break;
+            default: out += c; break;
+        }
+    }
+    return out;
+}
+
+std::string unescapeIndexField(const std::string& value) {
+    std::string out;
+    out.reserve(value.size());
+    for (std::size_t i = 0; i < value.size(); ++i) {
+        if (value[i] == '\\' && i + 1 < value.size()) {
+            char next = value[++i];
+            out += next == 't' ? '\t' : next == 'n' ? '\n' : next;
+        } else {
+            out += value[i];
+        }
+    }
+    return out;
+}
+
+std::string normalizeDir(std::string dir) {
+    while (dir.size() > 1 && dir.back() == '/') {
+        dir.pop_back();
+    }
+    return dir;
+}
+
+std::vector<std::string> readLegacyMapping(const fs::path& file) {
+    std::vector<std::string> profiles;
+    std::ifstream in(file);
+    std::string line;
+    while (std::getline(in, line)) {
+        line = core::trim(line);
+        if (!line.empty()) {
+            profiles.push_back(line);
+        }
+    }
+    return profiles;
+}
+
+std::vector<std::string> listLegacyMappingKeys(const core::Config& cfg) {
+    std::vector<std::string> keys;
+    std::error_code ec;
+    for (fs::directory_iterator it(cfg.persistDir, ec), end; !ec && it != end; it.increment(ec)) {
+        auto filename = it->path().filename().string();
+        if (hasSuffix(filename, ".mapping")) {
+            keys.push_back(filename.substr(0, filename.size() - 8));
+        }
+    }
+    std::sort(keys.begin(), keys.end());
+    return keys;
+}
+
+void writeDirIndex(const core::Config& cfg, const DirIndex& index) {
+    std::ostringstream out;
+    out << DIR_INDEX_HEADER << "\n";
+    if (index.legacy > 0) {
+        out << "# legacy " << index.legacy << "\n";
+    }
+    for (const auto& entry : index.entries) {
+        out << escapeIndexField(entry.dir);
+        for (const auto& profile : entry.profiles) {
+            out << '\t' << escapeIndexField(profile);
+        }
+        out << "\n";
+    }
+    fs::create_directories(cfg.persistDir);
+    auto tmp = fs::path(cfg.persistDir) / (".dirs." + processTag() + ".tmp");
+    writePrivateFile(tmp, out.str());
+    fs::rename(tmp, dirIndexFile(cfg));
+}
+
+// Held around every read-modify-write of the index, so concurrent
+// `ak load --persist` / `ak unload` runs never drop each other's mappings
+fs::path dirIndexLockPath(const core::Config& cfg) {
+    return fs::path(cfg.persistDir) / ".dirs.lock";
+}
+
+// The index as it is on disk; without one, the number of old mapping files
+DirIndex parseDirIndex(const core::Config& cfg) {
+    DirIndex index;
+    std::ifstream in(dirIndexFile(cfg), std::ios::binary);
+    if (!in) {
+        index.legacy = static_cast<long>(listLegacyMappingKeys(cfg).size());
+        return index;
+    }
+
+    std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    std::size_t pos = 0;
+    bool first = true;
+    while (pos < data.size()) {
+        std::size_t end = data.find('\n', pos);
+        if (end == std::string::npos) {
+            end = data.size();
+        }
+        std::string line = data.substr(pos, end - pos);
+        pos = end + 1;
+        if (first) {
+            first = false;
+            if (line != DIR_INDEX_HEADER) {
+                return DirIndex{};
+            }
+            continue;
+        }
+        if (line.rfind("# legacy ", 0) == 0) {
+            index.legacy = std::strtol(line.c_str() + 9, nullptr, 10);
+            continue;
+        }
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        DirMapping entry;
+        std::size_t start = 0;
+        for (bool isDir = true;; isDir = false) {
+            std::size_t tab = line.find('\t', start);
+            std::string field = unescapeIndexField(line.substr(start, tab == std::string::npos ? std::string::npos : tab - start));
+            if (isDir) {
+                entry.dir = field;
+            } else if (!field.empty()) {
+                entry.profiles.push_back(field);
+            }
+            if (tab == std::string::npos) {
+                break;
+            }
+            start = tab + 1;
+        }
+        entry.key = dirKey(entry.dir);
+        index.entries.push_back(std::move(entry));
+    }
+    std::sort(index.entries.begin(), index.entries.end(),
+              [](const DirMapping& a, const DirMapping& b) { return a.dir < b.dir; });
+    return index;
+}
+
+DirIndex readDirIndex(const core::Config& cfg) {
+    DirIndex index = parseDirIndex(cfg);
+    std::error_code ec;
+    if (index.legacy > 0 && !fs::exists(dirIndexFile(cfg), ec)) {
+        // First run after upgrading: remember how many old mapping files
+        // exist so lookups know whether to look for them
+        try {
+            system::FileLock lock(dirIndexLockPath(cfg));
+            if (!fs::exists(dirIndexFile(cfg), ec)) {
+                writeDirIndex(cfg, index);
+            }
+        } catch (const std::exception&) {
+            // Read-only persist dir; counted again next time
+        }
+    }
+    return index;
+}
+
+std::vector<DirMapping>::iterator findEntry(DirIndex& index, const std::string& dir) {
+    auto it = std::lower_bound(index.entries.begin(), index.entries.end(), dir,
+                               [](const DirMapping& entry, const std::string& d) { return entry.dir < d; });
+    return it != index.entries.end() && it->dir == dir ? it : index.entries.end();
+}
+
+// Moves dir's old <key>.mapping file (if any) into the index. Returns true
+// when the index changed and must be written.
+bool foldLegacyMapping(const core::Config& cfg, DirIndex& index, const std::string& dir) {
+    if (index.legacy <= 0) {
+        return false;
+    }
+    fs::path file = mappingFileForDir(cfg, dir);
+    std::error_code ec;
+    if (!fs::exists(file, ec)) {
+        return false;
+    }
+    auto profiles = readLegacyMapping(file);
+    if (findEntry(index, dir) == index.entries.end() && !profiles.empty()) {
+        DirMapping entry{dir, dirKey(dir), profiles};
+        auto pos = std::lower_bound(index.entries.begin(), index.entries.end(), dir,
+                                    [](const DirMapping& e, const std::string& d) { return e.dir < d; });
+        index.entries.insert(pos, std::move(entry));
+    }
+    fs::remove(file, ec);
+    --index.legacy;
+    return true;
+}
+
+// Exact-path lookup, migrating an old mapping file on the way. The fold is
+// applied to the index as it is under the lock, which then replaces `index`.
+bool lookupExact(const core::Config& cfg, DirIndex& index, const std::string& dir, DirMapping& out) {
+    std::error_code ec;
+    if (index.legacy > 0 && fs::exists(mappingFileForDir(cfg, dir), ec)) {
+        try {
+            system::FileLock lock(dirIndexLockPath(cfg));
+            DirIndex current = parseDirIndex(cfg);
+            if (foldLegacyMapping(cfg, current, dir)) {
+                writeDirIndex(cfg, current);
+            }
+            index = std::move(current);
+        } catch (const std::exception&) {
+            // Still served from memory for this call
+            foldLegacyMapping(cfg, index, dir);
+        }
+    }
+    auto it = findEntry(index, dir);
+    if (it == index.entries.end()) {
+        return false;
+    }
+    out = *it;
+    return true;
+}
+
+} // namespace
+
+bool findDirMapping(const core::Config& cfg, const std::string& dir, DirMapping& out) {
+    DirIndex index = readDirIndex(cfg);
+    if (index.entries.empty() && index.legacy <= 0) {
+        return false;
+    }
+    // Nearest persisted ancestor wins, so subdirectories inherit
+    for (fs::path current = normalizeDir(dir);;) {
+        if (lookupExact(cfg, index, current.string(), out)) {
+            return true;
+        }
+        fs::path parent = current.parent_path();
+        if (parent.empty() || parent == current) {
+            return false;
+        }
+        current = parent;
+    }
+}
+
+std::vector<std::string> readDirProfiles(const core::Config& cfg, const std::string& dir) {
+    DirIndex index = readDirIndex(cfg);
+    DirMapping mapping;
+    return lookupExact(cfg, index, normalizeDir(dir), mapping) ? mapping.profiles : std::vector<std::string>{};
+}
+
+std::vector<std::string> readDirProfilesByKey(const core::Config& cfg, const std::string& key) {
+    for (const auto& mapping : listDirMappings(cfg)) {
+        if (mapping.key == key) {
+            return mapping.profiles;
+        }
+    }
+    return {};
+}
+
+void writeDirProfiles(const core::Config& cfg, const std::string& dir, const std::vector<std::string>& profiles) {
+    std::string normalized = normalizeDir(dir);
+    fs::create_directories(cfg.persistDir);
+    system::FileLock lock(dirIndexLockPath(cfg));
+    DirIndex index = parseDirIndex(cfg);
+    foldLegacyMapping(cfg, index, normalized);
+
+    auto it = findEntry(index, normalized);
+    if (profiles.empty()) {
+        if (it != index.entries.end()) {
+            index.entries.erase(it);
+        }
+    } else if (it != index.entries.end()) {
+        it->profiles = profiles;
+    } else {
+        auto pos = std::lower_bound(index.entries.begin(), index.entries.end(), normalized,
+                                    [](const DirMapping& e, const std::string& d) { return e.dir < d; });
+        index.entries.insert(pos, DirMapping{normalized, dirKey(normalized), profiles});
+    }
+    writeDirIndex(cfg, index);
+    bumpGeneration(cfg);
+}
+
+std::vector<DirMapping> listDirMappings(const core::Config& cfg) {
+    DirIndex index = readDirIndex(cfg);
+    std::vector<DirMapping> mappings = index.entries;
+    if (index.legacy > 0) {
+        // Not migrated yet: their paths are only known once someone visits them
+        for (const auto& key : listLegacyMappingKeys(cfg)) {
+            auto profiles = readLegacyMapping(fs::path(cfg.persistDir) / (key + ".mapping"));
+            if (!profiles.empty()) {
+                mappings.push_back(DirMapping{"", key, profiles});
+            }
+        }
+    }
+    return mappings;
+}
+
+std::vector<std::string> listPersistedDirKeys(const core::Config& cfg) {
+    std::vector<std::string> keys;
+    for (const auto& mapping : listDirMappings(cfg)) {
+        keys.push_back(mapping.key);
+    }
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    return keys;
+}
+
+// Generation stamp
+std::string generationFile(const core::Config& cfg) {
+    return cfg.persistDir + "/generation";
+}
+
+std::string readGeneration(const core::Config& cfg) {
+    std::ifstream in(generationFile(cfg));
+    std::string stamp;
+    std::getline(in, stamp);
+    return core::trim(stamp);
+}
+
+void bumpGeneration(const core::Config& cfg) {
+    // Unique rather than incremented, so concurrent writers never need a
+    // read-modify-write to stay distinct
+    auto now = std::chrono::system_clock::now().time_since_epoch();
+    std::string stamp = std::to_string(std::chrono::duration_cast<std::chrono::nanoseconds>(now).count()) +
+        "." + processTag();
+    std::error_code ec;
+    fs::create_directories(cfg.persistDir, ec);
+    auto tmp = fs::path(cfg.persistDir) / (".generation." + processTag() + ".tmp");
+    {
+        std::ofstream out(tmp);
+        out << stamp << "\n";
+        if (!out) {
+            fs::remove(tmp, ec);
+            return;
+        }
+    }
+    fs::rename(tmp, generationFile(cfg), ec);
+}
+
+// Directory bundles
+namespace {
+
+fs::path dirBundlePath(const core::Config& cfg, const std::string& key, Backend backend) {
+    return fs::path(cfg.persistDir) / (key + ".dirbundle" + backendSuffix(backend));
+}
+
+fs::path dirStampPath(const core::Config& cfg, const std::string& key) {
+    return fs::path(cfg.persistDir) / (key + ".dirstamp");
+}
+
+} // namespace
+
+bool canSealWithoutPrompt(const core::Config& cfg) {
+    switch (activeBackend(cfg)) {
+        case Backend::Aead: return !aeadPassphrase(cfg, false).empty();
+        case Backend::Gpg: return !cfg.presetPassphrase.empty();
+        case Backend::Plain: return true;
+    }
+    return false;
+}
+
+void writeDirBundle(const core::Config& cfg, const std::string& key, const std::string& generation,
+                    const std::string& exports) {
+    fs::create_directories(cfg.persistDir);
+    Backend backend = activeBackend(cfg);
+    auto path = dirBundlePath(cfg, key, backend);
+    auto tmp = fs::path(cfg.persistDir) / (".tmp." + key + "." + processTag() + ".dirbundle");
+    // The stamp goes last: a reader that sees it current also sees this bundle.
+    // It names the bundle's backend, so readers never probe for gpg.
+    writeSealedFile(cfg, path, tmp, exports, "directory bundle");
+    auto stampTmp = fs::path(cfg.persistDir) / (".tmp." + key + "." + processTag() + ".dirstamp");
+    writePrivateFile(stampTmp, generation + "\n" + backendName(backend) + "\n");
+    fs::rename(stampTmp, dirStampPath(cfg, key));
+}
+
+bool readDirBundle(const core::Config& cfg, const std::string& key, const std::string& generation,
+                   std::string& exports) {
+    std::string stamp, backendLine;
+    {
+        std::ifstream in(dirStampPath(cfg, key));
+        std::getline(in, stamp);
+        std::getline(in, backendLine);
+    }
+    Backend backend;
+    if (stamp.empty() || stamp != generation || !parseBackend(backendLine, backend)) {
+        return false;
+    }
+    auto path = dirBundlePath(cfg, key, backend);
+    if (!fs::exists(path)) {
+        return false;
+    }
+    return readSealedFile(cfg, path, false, exports) == ReadStatus::Ok;
+}
+
+void removeDirBundle(const core::Config& cfg, const std::string& key) {
+    std::error_code ec;
+    fs::remove(dirStampPath(cfg, key), ec);
+    for (Backend b : {Backend::Plain, Backend::Gpg, Backend::Aead}) {
+        fs::remove(fs::path(cfg.persistDir) / (key + ".dirbundle" + backendSuffix(b)), ec);
+    }
+}
+
+// Bundle operations
+std::string bundleFile(const core::Config& cfg, const std::string& profile) {
+    return cfg.persistDir + "/" + profile + ".bundle";
+}
+
+void writeEncryptedBundle(const core::Config& cfg, const std::string& profile, const std::string& exports) {
+    fs::create_directories(cfg.persistDir);
+    std::string bundlePath = bundleFile(cfg, profile);
+    
+    // For now, just write as plain text. In a real implementation, you might want to encrypt this
+    std::ofstream out(bundlePath);
+    out << exports;
+}
+
+std::string readEncryptedBundle(const core::Config& cfg, const std::string& profile) {
+    std::string bundlePath = bundleFile(cfg, profile);
+    if (!fs::exists(bundlePath)) {
+        return "";
+    }
+    
+    std::ifstream in(bundlePath);
+    std::ostringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+}
+
+// Import/Export helpers
+std::vector<std::pair<std::string, std::string>> parse_env_file(std::istream& input) {
+    std::vector<std::pair<std::string, std::string>> kvs;
+    importStream(input, ImportFormat::Env, [&](std::string name, std::string value) {
+        kvs.emplace_back(std::move(name), std::move(value));
+    });
+    return kvs;
+}
+
+std::vector<std::pair<std::string, std::string>> parse_json_min(const std::string& text) {
+    std::vector<std::pair<std::string, std::string>> kvs;
+    ImportParser parser(ImportFormat::Json, [&](std::string name, std::string value) {
+        kvs.emplace_back(std::move(name), std::move(value));
+    });
+    parser.feed(text);
+    parser.finish();
+    return kvs;
+}
+
+// Profile-specific key storage functions
+std::filesystem::path profileKeysPathFor(const core::Config& cfg, const std::string& name, Backend backend) {
+    return fs::path(cfg.profilesDir) / (name + ".keys" + backendSuffix(backend));
+}
+
+std::filesystem::path profileKeysPath(const core::Config& cfg, const std::string& name) {
+    if (contentStoreEnabled(cfg)) {
+        return fs::path(cfg.profilesDir) / (name + ".keys" + MANIFEST_SUFFIX);
+    }
+    return profileKeysPathFor(cfg, name, activeBackend(cfg));
+}
+
+namespace {
+
+bool isManifest(const fs::path& path) {
+    return hasSuffix(path.string(), MANIFEST_SUFFIX);
+}
+
+// The file loadProfileKeys actually reads: the active backend's file, or the
+// profile as stored by another backend (or as a content store manifest)
+// before a switch.
+fs::path resolveProfileKeysFile(const core::Config& cfg, const std::string& name) {
+    auto path = profileKeysPath(cfg, name);
+    if (fs::exists(path)) {
+        return path;
+    }
+    for (Backend b : {Backend::Aead, Backend::Gpg, Backend::Plain}) {
+        auto candidate = profileKeysPathFor(cfg, name, b);
+        if (candidate != path && fs::exists(candidate)) {
+            return candidate;
+        }
+    }
+    auto manifest = fs::path(cfg.profilesDir) / (name + ".keys" + MANIFEST_SUFFIX);
+    if (manifest != path && fs::exists(manifest)) {
+        return manifest;
+    }
+    return path;
+}
+
+// Profile record log: <keys file>.log holds the changes made since the key
+// file (the snapshot) was last written. Layout:
+//   "AKLOG1 <snapshot id>\n", then records of <u32 LE length><payload>
+// where a payload is "<snapshot id> <offset> NAME=base64" or
+// "<snapshot id> <offset> -NAME", sealed one by one for the aead backend.
+// The id hashes the snapshot's size and leading bytes (the aead nonce, or
+// the "# base" line of plain snapshots), so rewriting the snapshot orphans
+// the old log; the offset pins each record to its place in the file.
+const char* const LOG_MAGIC = "AKLOG1 ";
+const char* const LOG_BASE_PREFIX = "# base ";
+constexpr unsigned long long LOG_COMPACT_MIN = 16 * 1024;
+
+fs::path profileLogPath(const fs::path& snapshot) {
+    return snapshot.string() + ".log";
+}
+
+bool isSealedSnapshot(const fs::path& snapshot) {
+    return hasSuffix(snapshot.string(), ".akv");
+}
+
+std::string snapshotId(const fs::path& snapshot) {
+    std::ifstream in(snapshot, std::ios::binary);
+    std::error_code ec;
+    auto size = fs::file_size(snapshot, ec);
+    if (!in || ec) {
+        return "";
+    }
+    char head[64];
+    in.read(head, sizeof(head));
+    crypto::SHA256 hasher;
+    hasher.update(std::to_string(size) + ":");
+    hasher.update(reinterpret_cast<const uint8_t*>(head), static_cast<size_t>(in.gcount()));
+    return hasher.final().substr(0, 16);
+}
+
+// Plain snapshots written without logging have no unique first line, so two
+// rewrites with the same contents would share an id; they get rewritten
+// with one before their first record
+bool snapshotTakesLog(const fs::path& snapshot) {
+    if (isSealedSnapshot(snapshot)) {
+        return true;
+    }
+    if (hasSuffix(snapshot.string(), ".gpg")) {
+        return false;
+    }
+    std::ifstream in(snapshot);
+    std::string line;
+    return std::getline(in, line) && line.rfind(LOG_BASE_PREFIX, 0) == 0;
+}
+
+std::string snapshotBaseLine() {
+    std::random_device rd;
+    char id[17];
+    std::snprintf(id, sizeof(id), "%08x%08x", rd(), rd());
+    return std::string(LOG_BASE_PREFIX) + id + "\n";
+}
+
+void appendLe32(std::string& out, uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+        out += static_cast<char>((value >> (8 * i)) & 0xff);
+    }
+}
+
+uint32_t readLe32(const char* p) {
+    uint32_t value = 0;
+    for (int i = 3; i >= 0; --i) {
+        value = (value << 8) | static_cast<unsigned char>(p[i]);
+    }
+    return value;
+}
+
+// Cut a damaged tail off the log, unless an appender extended the file
+// since it was read
+void truncateProfileLog(const fs::path& logPath, unsigned long long seen, unsigned long long keep) {
+#ifdef __unix__
+    int fd = ::open(logPath.c_str(), O_WRONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return;
+    }
+    struct stat st;
+    if (::flock(fd, LOCK_EX) == 0 && ::fstat(fd, &st) == 0 &&
+        static_cast<unsigned long long>(st.st_size) == seen) {
+        int rc = ::ftruncate(fd, static_cast<off_t>(keep));
+        (void)rc;
+    }
+    ::close(fd);
+#else
+    (void)logPath;
+    (void)seen;
+    (void)keep;
+#endif
+}
+
+// Append the lines of every record that belongs to `snapshot` to `data`.
+// Replay stops at the first torn, unreadable or misplaced record and the
+// log is cut back to the records before it.
+void replayProfileLog(const core::Config& cfg, const fs::path& snapshot, std::string& data) {
+    auto logPath = profileLogPath(snapshot);
+    std::ifstream in(logPath, std::ios::binary);
+    if (!in) {
+        return;
+    }
+    std::ostringstream ss;
+    ss << in.rdbuf();
+    std::string log = ss.str();
+
+    std::string id = snapshotId(snapshot);
+    std::string header = LOG_MAGIC + id + "\n";
+    if (id.empty() || log.compare(0, header.size(), header) != 0) {
+        return; // left over from an earlier snapshot
+    }
+    bool sealed = isSealedSnapshot(snapshot);
+    std::string pass = sealed ? aeadPassphrase(cfg, false) : "";
+    if (sealed && pass.empty()) {
+        return;
+    }
+
+    if (!data.empty() && data.back() != '\n') {
+        data += '\n';
+    }
+    size_t pos = header.size();
+    std::string payload;
+    while (log.size() - pos >= 4) {
+        uint32_t length = readLe32(log.data() + pos);
+        if (length > log.size() - pos - 4) {
+            break;
+        }
+        if (sealed) {
+            if (!crypto::aeadOpen(log.substr(pos + 4, length), pass, payload)) {
+                break;
+            }
+        } else {
+            payload.assign(log, pos + 4, length);
+        }
+        std::string prefix = id + " " + std::to_string(pos) + " ";
+        if (payload.compare(0, prefix.size(), prefix) != 0 || payload.find('\n') != std::string::npos) {
+            break;
+        }
+        data.append(payload, prefix.size(), std::string::npos);
+        data += '\n';
+        pos += 4 + length;
+    }
+    if (pos < log.size()) {
+        truncateProfileLog(logPath, log.size(), pos);
+    }
+}
+
+// Append change lines to the log of `snapshot`, starting it over when it
+// belongs to an older snapshot. Returns the log size afterwards, or 0 when
+// it could not be written and the snapshot has to be rewritten instead.
+unsigned long long appendProfileLog(const core::Config& cfg, const fs::path& snapshot,
+                                    const std::vector<std::string>& lines) {
+#ifdef __unix__
+    std::string id = snapshotId(snapshot);
+    if (id.empty()) {
+        return 0;
+    }
+    bool sealed = isSealedSnapshot(snapshot);
+    std::string pass;
+    if (sealed) {
+        pass = aeadPassphrase(cfg, true);
+        if (pass.empty()) {
+            throw std::runtime_error("A passphrase is required to encrypt profile keys (set AK_PASSPHRASE)");
+        }
+    }
+
+    auto logPath = profileLogPath(snapshot);
+    int fd = ::open(logPath.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        return 0;
+    }
+    struct stat st;
+    if (::flock(fd, LOCK_EX) != 0 || ::fstat(fd, &st) != 0) {
+        ::close(fd);
+        return 0;
+    }
+
+    std::string header = LOG_MAGIC + id + "\n";
+    std::string current(header.size(), '\0');
+    ssize_t got = ::pread(fd, &current[0], current.size(), 0);
+    unsigned long long offset = static_cast<unsigned long long>(st.st_size);
+    std::string out;
+    if (got != static_cast<ssize_t>(header.size()) || current != header) {
+        if (::ftruncate(fd, 0) != 0) {
+            ::close(fd);
+            return 0;
+        }
+        out = header;
+        offset = header.size();
+    }
+    for (const auto& line : lines) {
+        std::string payload = id + " " + std::to_string(offset) + " " + line;
+        std::string record = sealed ? crypto::aeadSeal(payload, pass) : payload;
+        appendLe32(out, static_cast<uint32_t>(record.size()));
+        out += record;
+        offset += 4 + record.size();
+    }
+    // One write per batch; a crash mid-write leaves a torn tail that the
+    // next load cuts off
+    bool ok = writeAll(fd, out);
+    ::close(fd);
+    return ok ? offset : 0;
+#else
+    (void)cfg;
+    (void)snapshot;
+    (void)lines;
+    return 0;
+#endif
+}
+
+// A content store manifest, each distinct value opened once, as key file
+// lines
+bool readProfileManifest(const core::Config& cfg, const fs::path& path, const std::string& profileName,
+                         std::string& data) {
+    Manifest manifest;
+    if (!readManifest(path.string(), manifest)) {
+        std::cerr << "⚠️  Failed to read profile manifest for " << profileName << "\n";
+        return false;
+    }
+    std::string pass = aeadPassphrase(cfg, false);
+    if (pass.empty() && fs::exists(fs::path(ContentStore::dir(cfg)) / "key.akv")) {
+        return false;
+    }
+    ContentStore store(cfg, pass);
+    std::unordered_map<std::string, std::string> opened;
+    data.clear();
+    for (const auto& [name, id] : manifest) {
+        auto it = opened.find(id);
+        if (it == opened.end()) {
+            std::string value;
+            if (!store.get(id, value)) {
+                std::cerr << "⚠️  Missing or unreadable value for " << name << " in profile " << profileName << "\n";
+                for (auto& [digest, plain] : opened) {
+                    crypto::secureZero(&plain[0], plain.size());
+                }
+                crypto::secureZero(&data[0], data.size());
+                return false;
+            }
+            it = opened.emplace(id, std::move(value)).first;
+        }
+        data += name;
+        data += '=';
+        data += crypto::base64Encode(it->second);
+        data += '\n';
+    }
+    for (auto& [digest, plain] : opened) {
+        crypto::secureZero(&plain[0], plain.size());
+    }
+    core::metrics::count("ak_bytes_parsed_total", {{"format", "profile_manifest"}}, data.size());
+    return true;
+}
+
+// Decrypt a profile key file (with its log replayed) into key file lines;
+// empty when there is none. Returns false when it exists but could not be
+// decrypted (including when no passphrase is available).
+bool readProfileKeysData(const core::Config& cfg, const fs::path& path, const std::string& profileName,
+                         std::string& data) {
+    data.clear();
+    if (!fs::exists(path)) {
+        return true;
+    }
+    
+    if (isManifest(path)) {
+        return readProfileManifest(cfg, path, profileName, data);
+    }
+    
+    // Encrypted profiles need a preset passphrase - don't try interactive
+    // decryption in non-interactive contexts
+    ReadStatus status = readSealedFile(cfg, path, false, data);
+    if (status == ReadStatus::NoPassphrase) {
+        return false;
+    }
+    if (status == ReadStatus::Failed) {
+        std::cerr << "⚠️  Failed to decrypt profile keys for " << profileName << "\n";
+        return false;
+    }
+    if (!hasSuffix(path.string(), ".gpg")) {
+        replayProfileLog(cfg, path, data);
+    }
+    
+    core::metrics::count("ak_bytes_parsed_total", {{"format", "profile_keys"}}, data.size());
+    return true;
+}
+
+// Decoded once, into whichever form the caller keeps
+bool decodeProfileKeysFile(const core::Config& cfg, const fs::path& path, const std::string& profileName,
+                           KeyTable& table) {
+    std::string data;
+    if (!readProfileKeysData(cfg, path, profileName, data)) {
+        return false;
+    }
+    table = KeyTable::parse(std::move(data));
+    return true;
+}
+
+template <typename Map>
+bool decodeProfileKeysFile(const core::Config& cfg, const fs::path& path, const std::string& profileName,
+                           Map& keys) {
+    std::string data;
+    if (!readProfileKeysData(cfg, path, profileName, data)) {
+        return false;
+    }
+    parseKeyLines(data, keys);
+    return true;
+}
+
+// Process-wide cache of decrypted profile keys. An entry is valid for one
+// (key file and log mtime/size, passphrase, backend) combination; concurrent callers
+// asking for the same profile share a single in-flight decryption.
+struct ProfileCacheEntry {
+    FileStamp stamp;
+    FileStamp logStamp;
+    bool decoded = false; // keys hold the files' contents, not a failed decrypt
+    ProfileIndexPtr index;           // built on first use, see loadProfileIndexCached
+    const void* indexedKeys = nullptr; // the keys `index` describes
+    size_t passphraseHash = 0;
+    Backend backend = Backend::Plain;
+    std::shared_future<ProfileKeysPtr> keys;
+};
+
+std::mutex profileCacheMutex;
+std::unordered_map<std::string, ProfileCacheEntry> profileCache;
+
+std::string profileCacheKey(const core::Config& cfg, const std::string& profileName) {
+    return cfg.profilesDir + '\0' + profileName;
+}
+
+// `changed` lists the names that differ from the keys cached so far; with
+// it an existing index is carried over and patched instead of dropped
+void storeCachedProfileKeys(const core::Config& cfg, const std::string& profileName, const fs::path& path,
+                            ProfileKeysPtr keys, const std::vector<std::string>* changed = nullptr) {
+    std::string cacheKey = profileCacheKey(cfg, profileName);
+    ProfileIndexPtr index;
+    if (changed) {
+        ProfileIndexPtr previous;
+        {
+            std::lock_guard<std::mutex> lock(profileCacheMutex);
+            auto it = profileCache.find(cacheKey);
+            if (it != profileCache.end()) {
+                previous = it->second.index;
+            }
+        }
+        if (previous) {
+            auto patched = std::make_shared<ProfileIndex>(*previous);
+            for (const auto& name : *changed) {
+                if (keys->count(name)) {
+                    patched->add(name);
+                } else {
+                    patched->remove(name);
+                }
+            }
+            index = std::move(patched);
+        }
+    }
+
+    ProfileCacheEntry entry;
+    entry.index = index;
+    entry.indexedKeys = index ? keys.get() : nullptr;
+    std::promise<ProfileKeysPtr> ready;
+    ready.set_value(std::move(keys));
+
+    entry.stamp = stampFile(path);
+    entry.logStamp = stampFile(profileLogPath(path));
+    entry.decoded = true;
+    entry.passphraseHash = std::hash<std::string>{}(cfg.presetPassphrase);
+    entry.backend = activeBackend(cfg);
+    entry.keys = ready.get_future().share();
+
+    std::lock_guard<std::mutex> lock(profileCacheMutex);
+    profileCache[cacheKey] = std::move(entry);
+}
+
+// Names touched by record-log lines ("NAME=..." or "-NAME")
+std::vector<std::string> changedKeyNames(const std::vector<std::string>& lines) {
+    std::vector<std::string> names;
+    names.reserve(lines.size());
+    for (const auto& line : lines) {
+        names.push_back(line[0] == '-' ? line.substr(1) : line.substr(0, line.find('=')));
+    }
+    return names;
+}
+
+// The cached keys of a profile when they were decoded from its current
+// files, without waiting for or starting a decrypt
+ProfileKeysPtr peekCachedProfileKeys(const core::Config& cfg, const std::string& profileName,
+                                     const fs::path& path) {
+    FileStamp stamp = stampFile(path);
+    FileStamp logStamp = stampFile(profileLogPath(path));
+    if (!stamp.exists) {
+        return nullptr;
+    }
+    std::shared_future<ProfileKeysPtr> keys;
+    {
+        std::lock_guard<std::mutex> lock(profileCacheMutex);
+        auto it = profileCache.find(profileCacheKey(cfg, profileName));
+        if (it == profileCache.end() || !it->second.decoded || !(it->second.stamp == stamp) ||
+            !(it->second.logStamp == logStamp) ||
+            it->second.passphraseHash != std::hash<std::string>{}(cfg.presetPassphrase) ||
+            it->second.backend != activeBackend(cfg)) {
+            return nullptr;
+        }
+        keys = it->second.keys;
+    }
+    if (keys.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        return nullptr;
+    }
+    try {
+        return keys.get();
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+// Record-log lines that turn `before` into `after`
+std::vector<std::string> diffKeyLines(const std::map<std::string, std::string>& before,
+                                      const std::map<std::string, std::string>& after) {
+    std::vector<std::string> lines;
+    auto b = before.begin();
+    auto a = after.begin();
+    while (b != before.end() || a != after.end()) {
+        if (a == after.end() || (b != before.end() && b->first < a->first)) {
+            lines.push_back("-" + b->first);
+            ++b;
+        } else if (b == before.end() || a->first < b->first) {
+            lines.push_back(a->first + "=" + crypto::base64Encode(a->second));
+            ++a;
+        } else {
+            if (a->second != b->second) {
+                lines.push_back(a->first + "=" + crypto::base64Encode(a->second));
+            }
+            ++a;
+            ++b;
+        }
+    }
+    return lines;
+}
+
+// Full rewrite of a profile's key file; its record log goes with it.
+// `changed` as for storeCachedProfileKeys.
+void writeProfileSnapshot(const core::Config& cfg, const std::string& profileName,
+                          const std::map<std::string, std::string>& keys,
+                          const std::vector<std::string>* changed = nullptr) {
+    fs::create_directories(cfg.profilesDir);
+    auto path = profileKeysPath(cfg, profileName);
+    auto tmp = fs::path(cfg.profilesDir) / (".tmp." + profileName + "." + processTag() + ".keys");
+
+    try {
+        if (isManifest(path)) {
+            ContentStore store(cfg, aeadPassphrase(cfg, true));
+            Manifest manifest;
+            for (const auto& [name, value] : keys) {
+                manifest[name] = store.put(value);
+            }
+            writeManifest(path.string(), manifest);
+            // The manifest supersedes the backend's key file
+            std::error_code ec;
+            auto legacy = profileKeysPathFor(cfg, profileName, activeBackend(cfg));
+            fs::remove(legacy, ec);
+            fs::remove(profileLogPath(legacy), ec);
+        } else {
+            std::string data = serializeKeys(keys);
+            if (cfg.profileLog && activeBackend(cfg) == Backend::Plain) {
+                data.insert(0, snapshotBaseLine());
+            }
+            writeSealedFile(cfg, path, tmp, data, "profile keys");
+        }
+    } catch (...) {
+        invalidateProfileKeysCache(cfg, profileName);
+        throw;
+    }
+    // A stale log is ignored anyway (its id no longer matches); this just
+    // reclaims the space
+    std::error_code ec;
+    fs::remove(profileLogPath(path), ec);
+
+    bumpGeneration(cfg);
+
+    // Refresh the cache with what we just wrote so readers skip a decrypt
+    storeCachedProfileKeys(cfg, profileName, path,
+                           std::make_shared<const std::map<std::string, std::string>>(keys), changed);
+    if (changed) {
+        touchProfileNames(cfg, profileName, *changed);
+    }
+}
+
+bool compactProfileKeysLocked(const core::Config& cfg, const std::string& profileName) {
+    auto path = resolveProfileKeysFile(cfg, profileName);
+    if (!fs::exists(profileLogPath(path))) {
+        return false;
+    }
+    std::map<std::string, std::string> keys;
+    if (!tryLoadProfileKeys(cfg, profileName, keys)) {
+        throw std::runtime_error("Failed to decrypt profile keys for " + profileName);
+    }
+    writeProfileSnapshot(cfg, profileName, keys);
+    std::error_code ec;
+    fs::remove(profileLogPath(path), ec);
+    return true;
+}
+
+// Append `lines` to the profile's log and update the cache to `after` (or
+// drop it when the caller has no full picture). Compacts once the log
+// outgrows the key file. False when the change has to be written as a
+// full snapshot instead.
+bool logProfileChanges(const core::Config& cfg, const std::string& profileName,
+                       const std::vector<std::string>& lines,
+                       const std::map<std::string, std::string>* after) {
+    auto path = profileKeysPath(cfg, profileName);
+    if (!profileLogEnabled(cfg) || !fs::exists(path) || !snapshotTakesLog(path)) {
+        return false;
+    }
+    unsigned long long logSize = appendProfileLog(cfg, path, lines);
+    if (logSize == 0) {
+        return false;
+    }
+
+    // `after` is always the cached keys plus these lines
+    auto names = changedKeyNames(lines);
+    std::error_code ec;
+    auto snapshotSize = fs::file_size(path, ec);
+    if (!ec && logSize > std::max<unsigned long long>(LOG_COMPACT_MIN, snapshotSize)) {
+        if (after) {
+            writeProfileSnapshot(cfg, profileName, *after, &names);
+        } else {
+            compactProfileKeysLocked(cfg, profileName);
+        }
+        return true;
+    }
+
+    bumpGeneration(cfg);
+    if (after) {
+        storeCachedProfileKeys(cfg, profileName, path,
+                               std::make_shared<const std::map<std::string, std::string>>(*after), &names);
+    } else {
+        invalidateProfileKeysCache(cfg, profileName);
+    }
+    touchProfileNames(cfg, profileName, names);
+    return true;
+}
+
+} // namespace
+
+bool tryLoadProfileKeyTable(const core::Config& cfg, const std::string& profileName, KeyTable& table) {
+    return decodeProfileKeysFile(cfg, resolveProfileKeysFile(cfg, profileName), profileName, table);
+}
+
+bool tryLoadProfileKeys(const core::Config& cfg, const std::string& profileName,
+                        std::map<std::string, std::string>& keys) {
+    return decodeProfileKeysFile(cfg, resolveProfileKeysFile(cfg, profileName), profileName, keys);
+}
+
+std::map<std::string, std::string> loadProfileKeys(const core::Config& cfg, const std::string& profileName) {
+    std::map<std::string, std::string> keys;
+    if (!tryLoadProfileKeys(cfg, profileName, keys)) {
+        keys.clear();
     }
+    return keys;
 }
 
-// Profile operations
-fs::path profilePath(const core::Config& cfg, const std::string& name) {
-    return fs::path(cfg.profilesDir) / (name + ".profile");
+ProfileKeysPtr loadProfileKeysCached(const core::Config& cfg, const std::string& profileName) {
+    ProfileKeysPtr keys;
+    tryLoadProfileKeysCached(cfg, profileName, keys);
+    return keys;
 }
 
-std::vector<std::string> listProfiles(const core::Config& cfg) {
-    std::vector<std::string> names;
-    if (!fs::exists(cfg.profilesDir)) {
-        return names;
+bool tryLoadProfileKeysCached(const core::Config& cfg, const std::string& profileName, ProfileKeysPtr& keys) {
+    auto path = resolveProfileKeysFile(cfg, profileName);
+    FileStamp stamp = stampFile(path);
+    if (!stamp.exists) {
+        keys = std::make_shared<const std::map<std::string, std::string>>();
+        return true;
     }
-    
-    for (const auto& entry : fs::directory_iterator(cfg.profilesDir)) {
-        if (!entry.is_regular_file()) {
-            continue;
+    FileStamp logStamp = stampFile(profileLogPath(path));
+
+    size_t passHash = std::hash<std::string>{}(cfg.presetPassphrase);
+    Backend backend = activeBackend(cfg);
+    std::string cacheKey = profileCacheKey(cfg, profileName);
+
+    std::promise<ProfileKeysPtr> promise;
+    std::shared_future<ProfileKeysPtr> pending;
+    {
+        std::lock_guard<std::mutex> lock(profileCacheMutex);
+        auto it = profileCache.find(cacheKey);
+        if (it != profileCache.end() && it->second.stamp == stamp && it->second.logStamp == logStamp &&
+            it->second.passphraseHash == passHash && it->second.backend == backend) {
+            pending = it->second.keys;
+        } else {
+            ProfileCacheEntry entry;
+            entry.stamp = stamp;
+            entry.logStamp = logStamp;
+            entry.passphraseHash = passHash;
+            entry.backend = backend;
+            entry.keys = promise.get_future().share();
+            profileCache[cacheKey] = entry;
         }
-        auto filename = entry.path().filename().string();
-        if (filename.size() > 8 && filename.substr(filename.size() - 8) == ".profile") {
-            names.push_back(filename.substr(0, filename.size() - 8));
+    }
+    core::metrics::count("ak_cache_requests_total",
+                         {{"cache", "profile_keys"}, {"result", pending.valid() ? "hit" : "miss"}});
+    if (pending.valid()) {
+        keys = pending.get();
+        // The owner marks the entry before resolving the future
+        std::lock_guard<std::mutex> lock(profileCacheMutex);
+        auto it = profileCache.find(cacheKey);
+        return it != profileCache.end() && it->second.decoded && it->second.stamp == stamp &&
+               it->second.logStamp == logStamp;
+    }
+
+    // We own this load; waiters block on the shared future until it resolves.
+    // A failed decrypt is cached too: retrying with the same passphrase against
+    // the same file cannot succeed, and a new passphrase or file misses anyway.
+    try {
+        auto decodedKeys = std::make_shared<std::map<std::string, std::string>>();
+        bool decoded = decodeProfileKeysFile(cfg, path, profileName, *decodedKeys);
+        if (decoded) {
+            std::lock_guard<std::mutex> lock(profileCacheMutex);
+            auto it = profileCache.find(cacheKey);
+            if (it != profileCache.end() && it->second.stamp == stamp && it->second.logStamp == logStamp) {
+                it->second.decoded = true;
+            }
         }
+        keys = decodedKeys;
+        promise.set_value(keys);
+        return decoded;
+    } catch (...) {
+        promise.set_exception(std::current_exception());
+        std::lock_guard<std::mutex> lock(profileCacheMutex);
+        profileCache.erase(cacheKey);
+        throw;
     }
-    
-    std::sort(names.begin(), names.end());
-    return names;
 }
 
-std::vector<std::string> readProfile(const core::Config& cfg, const std::string& name) {
-    std::vector<std::string> keys;
-    auto path = profilePath(cfg, name);
-    if (!fs::exists(path)) {
-        return keys;
-    }
-    
-    std::ifstream in(path);
-    std::string line;
-    while (std::getline(in, line)) {
-        line = core::trim(line);
-        if (!line.empty()) {
-            keys.push_back(line);
+ProfileIndexPtr loadProfileIndexCached(const core::Config& cfg, const std::string& profileName) {
+    auto keys = loadProfileKeysCached(cfg, profileName);
+    std::string cacheKey = profileCacheKey(cfg, profileName);
+    {
+        std::lock_guard<std::mutex> lock(profileCacheMutex);
+        auto it = profileCache.find(cacheKey);
+        if (it != profileCache.end() && it->second.index && it->second.indexedKeys == keys.get()) {
+            return it->second.index;
         }
     }
-    
-    return keys;
-}
 
-void writeProfile(const core::Config& cfg, const std::string& name, const std::vector<std::string>& keys) {
-    fs::create_directories(cfg.profilesDir);
-    std::ofstream out(profilePath(cfg, name));
-    
-    std::unordered_set<std::string> seen;
-    std::vector<std::string> sorted = keys;
-    std::sort(sorted.begin(), sorted.end());
-    
-    for (const auto& key : sorted) {
-        if (seen.insert(key).second) {
-            out << key << "\n";
+    // Built outside the lock; a concurrent builder just does the same work
+    auto index = std::make_shared<const ProfileIndex>(*keys);
+    std::lock_guard<std::mutex> lock(profileCacheMutex);
+    auto it = profileCache.find(cacheKey);
+    if (it != profileCache.end()) {
+        auto& entry = it->second;
+        if (entry.keys.valid() && entry.keys.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+            try {
+                if (entry.keys.get() == keys) {
+                    entry.index = index;
+                    entry.indexedKeys = keys.get();
+                }
+            } catch (...) {
+            }
         }
     }
+    return index;
 }
 
-// Persistence operations
-std::string mappingFileForDir(const core::Config& cfg, const std::string& dir) {
-    crypto::SHA256 hasher;
-    hasher.update(dir);
-    std::string sha = hasher.final().substr(0, 16);
-    return cfg.persistDir + "/" + sha + ".mapping";
+void invalidateProfileKeysCache(const core::Config& cfg, const std::string& profileName) {
+    std::lock_guard<std::mutex> lock(profileCacheMutex);
+    profileCache.erase(profileCacheKey(cfg, profileName));
 }
 
-std::vector<std::string> readDirProfiles(const core::Config& cfg, const std::string& dir) {
-    std::vector<std::string> profiles;
-    std::string mappingFile = mappingFileForDir(cfg, dir);
-    
-    if (!fs::exists(mappingFile)) {
-        return profiles;
-    }
-    
-    std::ifstream in(mappingFile);
-    std::string line;
-    while (std::getline(in, line)) {
-        line = core::trim(line);
-        if (!line.empty()) {
-            profiles.push_back(line);
-        }
-    }
-    
-    return profiles;
+void clearProfileKeysCache() {
+    std::lock_guard<std::mutex> lock(profileCacheMutex);
+    profileCache.clear();
 }
 
-void writeDirProfiles(const core::Config& cfg, const std::string& dir, const std::vector<std::string>& profiles) {
-    fs::create_directories(cfg.persistDir);
-    std::string mappingFile = mappingFileForDir(cfg, dir);
-    
-    std::ofstream out(mappingFile);
-    for (const auto& profile : profiles) {
-        out << profile << "\n";
+namespace {
+
+void saveProfileKeysLocked(const core::Config& cfg, const std::string& profileName,
+                           const std::map<std::string, std::string>& keys) {
+    // With a current decoded copy at hand, a few changes go to the log and
+    // the profile index is patched rather than rebuilt
+    if (auto current = peekCachedProfileKeys(cfg, profileName, profileKeysPath(cfg, profileName))) {
+        auto lines = diffKeyLines(*current, keys);
+        if (lines.empty() && profileLogEnabled(cfg)) {
+            return;
+        }
+        // Past a quarter of the profile a rewrite is cheaper than the records
+        if (profileLogEnabled(cfg) && lines.size() <= keys.size() / 4 + 1 &&
+            logProfileChanges(cfg, profileName, lines, &keys)) {
+            return;
+        }
+        auto names = changedKeyNames(lines);
+        writeProfileSnapshot(cfg, profileName, keys, &names);
+        return;
     }
+    writeProfileSnapshot(cfg, profileName, keys);
 }
 
-// Bundle operations
-std::string bundleFile(const core::Config& cfg, const std::string& profile) {
-    return cfg.persistDir + "/" + profile + ".bundle";
-}
+} // namespace
 
-void writeEncryptedBundle(const core::Config& cfg, const std::string& profile, const std::string& exports) {
-    fs::create_directories(cfg.persistDir);
-    std::string bundlePath = bundleFile(cfg, profile);
-    
-    // For now, just write as plain text. In a real implementation, you might want to encrypt this
-    std::ofstream out(bundlePath);
-    out << exports;
+void mergeKeyChanges(const std::map<std::string, std::string>& base, const std::map<std::string, std::string>& mine,
+                     std::map<std::string, std::string>& current) {
+    mergeChanges(base, mine, current);
 }
 
-std::string readEncryptedBundle(const core::Config& cfg, const std::string& profile) {
-    std::string bundlePath = bundleFile(cfg, profile);
-    if (!fs::exists(bundlePath)) {
+std::string profileKeysVersion(const core::Config& cfg, const std::string& profileName) {
+    auto path = resolveProfileKeysFile(cfg, profileName);
+    std::string version = fileVersion(path);
+    if (version.empty()) {
         return "";
     }
-    
-    std::ifstream in(bundlePath);
-    std::ostringstream ss;
-    ss << in.rdbuf();
-    return ss.str();
+    std::string log = fileVersion(profileLogPath(path));
+    return log.empty() ? version : version + "+" + log;
 }
 
-// Import/Export helpers
-std::vector<std::pair<std::string, std::string>> parse_env_file(std::istream& input) {
-    std::vector<std::pair<std::string, std::string>> kvs;
-    std::string line;
-    
-    while (std::getline(input, line)) {
-        line = core::trim(line);
-        if (line.empty() || line[0] == '#') {
-            continue;
-        }
-        
-        // Skip shell constructs that aren't env vars
-        if (line.find("alias ") == 0 ||
-            line.find("[[") != std::string::npos ||
-            line.find("$(") != std::string::npos ||
-            line.find("function ") == 0 ||
-            line.find("if ") == 0 ||
-            line.find("case ") == 0 ||
-            line.find("for ") == 0 ||
-            line.find("while ") == 0) {
-            continue;
-        }
-        
-        if (line.rfind("export ", 0) == 0) {
-            line = line.substr(7);
-        }
-        
-        auto eq = line.find('=');
-        if (eq == std::string::npos) {
-            continue;
-        }
-        
-        std::string key = core::trim(line.substr(0, eq));
-        std::string value = line.substr(eq + 1);
-        
-        // Validate key name - must be valid variable name
-        if (key.empty() || (!std::isalpha(key[0]) && key[0] != '_')) {
-            continue;
-        }
-        
-        bool validKey = true;
-        for (char c : key) {
-            if (!std::isalnum(c) && c != '_') {
-                validKey = false;
-                break;
-            }
-        }
-        if (!validKey) {
-            continue;
-        }
-        
-        if (!value.empty() && value.front() == '"' && value.back() == '"') {
-            value = value.substr(1, value.size() - 2);
-        }
-        
-        kvs.push_back({key, value});
-    }
-    
-    return kvs;
+std::string sealingPassphrase(const core::Config& cfg) {
+    return aeadPassphrase(cfg, true);
 }
 
-std::vector<std::pair<std::string, std::string>> parse_json_min(const std::string& text) {
-    std::vector<std::pair<std::string, std::string>> kvs;
-    size_t i = 0;
-    
-    while (true) {
-        i = text.find('"', i);
-        if (i == std::string::npos) {
-            break;
-        }
-        
-        size_t j = text.find('"', i + 1);
-        if (j == std::string::npos) {
-            break;
-        }
-        
-        std::string key = text.substr(i + 1, j - i - 1);
-        size_t colon = text.find(':', j);
-        if (colon == std::string::npos) {
-            break;
-        }
-        
-        size_t v1 = text.find('"', colon);
-        if (v1 == std::string::npos) {
-            i = j + 1;
-            continue;
-        }
-        
-        size_t v2 = text.find('"', v1 + 1);
-        if (v2 == std::string::npos) {
-            break;
+void saveProfileKeys(const core::Config& cfg, const std::string& profileName,
+                     const std::map<std::string, std::string>& keys, const ProfileKeysPtr& base) {
+    fs::create_directories(cfg.profilesDir);
+    system::FileLock lock(profileLockPath(cfg, profileName));
+    // `base` is current while the cache still holds that very copy for the
+    // file as it is now; otherwise someone else wrote since it was loaded
+    if (base && peekCachedProfileKeys(cfg, profileName, profileKeysPath(cfg, profileName)) != base) {
+        std::map<std::string, std::string> merged;
+        if (!tryLoadProfileKeys(cfg, profileName, merged)) {
+            throw std::runtime_error("Profile '" + profileName +
+                                     "' changed while saving and could not be decrypted to merge");
         }
-        
-        std::string value = text.substr(v1 + 1, v2 - v1 - 1);
-        kvs.push_back({key, value});
-        i = v2 + 1;
+        mergeChanges(*base, keys, merged);
+        core::metrics::count("ak_write_conflicts_total", {{"store", "profile_keys"}});
+        saveProfileKeysLocked(cfg, profileName, merged);
+        return;
     }
-    
-    return kvs;
+    saveProfileKeysLocked(cfg, profileName, keys);
 }
 
-// Profile-specific key storage functions
-std::filesystem::path profileKeysPath(const core::Config& cfg, const std::string& name) {
-    return fs::path(cfg.profilesDir) / (name + ".keys.gpg");
+bool profileLogEnabled(const core::Config& cfg) {
+    return cfg.profileLog && activeBackend(cfg) != Backend::Gpg && !contentStoreEnabled(cfg);
 }
 
-std::map<std::string, std::string> loadProfileKeys(const core::Config& cfg, const std::string& profileName) {
-    std::map<std::string, std::string> keys;
-    auto path = profileKeysPath(cfg, profileName);
-    
-    if (!fs::exists(path)) {
-        return keys;
+void setProfileKey(const core::Config& cfg, const std::string& profileName,
+                   const std::string& name, const std::string& value) {
+    // A single key needs no base: it is applied to whatever is current
+    fs::create_directories(cfg.profilesDir);
+    system::FileLock lock(profileLockPath(cfg, profileName));
+    std::map<std::string, std::string> after;
+    const std::map<std::string, std::string>* known = nullptr;
+    if (auto current = peekCachedProfileKeys(cfg, profileName, profileKeysPath(cfg, profileName))) {
+        after = *current;
+        after[name] = value;
+        known = &after;
     }
-    
-    std::string data;
-    if (cfg.gpgAvailable && !cfg.forcePlain &&
-        path.extension() == ".gpg") {
-        
-        // If file is encrypted, we need a passphrase - return empty if not provided
-        if (cfg.presetPassphrase.empty()) {
-            // Silently return empty map - don't try interactive decryption in non-interactive contexts
-            return keys;
-        }
-        
-        int rc = 0;
-        auto pfile = fs::path(cfg.configDir) / ".pass.tmp";
-        {
-            std::ofstream pf(pfile, std::ios::trunc);
-            pf << cfg.presetPassphrase;
-            pf.close();
-        }
-#ifdef __unix__
-        ::chmod(pfile.c_str(), 0600);
-#endif
-        std::string cmd = "gpg --batch --yes --quiet --pinentry-mode loopback --passphrase-file '" +
-                         pfile.string() + "' --decrypt '" + path.string() + "' 2>/dev/null";
-        data = system::runCmdCapture(cmd, &rc);
-        fs::remove(pfile);
-        
-        if (rc != 0) {
-            std::cerr << "⚠️  Failed to decrypt profile keys for " << profileName << "\n";
-            return keys;
-        }
-    } else {
-        std::ifstream in(path);
-        std::ostringstream ss;
-        ss << in.rdbuf();
-        data = ss.str();
+    if (logProfileChanges(cfg, profileName, {name + "=" + crypto::base64Encode(value)}, known)) {
+        return;
     }
-    
-    std::istringstream lines(data);
-    std::string line;
-    while (std::getline(lines, line)) {
-        if (line.empty() || line[0] == '#') {
-            continue;
-        }
-        auto eq = line.find('=');
-        if (eq == std::string::npos) {
-            continue;
+    auto keys = known ? after : loadProfileKeys(cfg, profileName);
+    keys[name] = value;
+    std::vector<std::string> changed{name};
+    writeProfileSnapshot(cfg, profileName, keys, known ? &changed : nullptr);
+}
+
+void removeProfileKey(const core::Config& cfg, const std::string& profileName, const std::string& name) {
+    fs::create_directories(cfg.profilesDir);
+    system::FileLock lock(profileLockPath(cfg, profileName));
+    std::map<std::string, std::string> after;
+    const std::map<std::string, std::string>* known = nullptr;
+    if (auto current = peekCachedProfileKeys(cfg, profileName, profileKeysPath(cfg, profileName))) {
+        if (!current->count(name)) {
+            return;
         }
-        std::string key = line.substr(0, eq);
-        std::string encoded = line.substr(eq + 1);
-        keys[key] = crypto::base64Decode(encoded);
+        after = *current;
+        after.erase(name);
+        known = &after;
+    }
+    if (logProfileChanges(cfg, profileName, {"-" + name}, known)) {
+        return;
+    }
+    auto keys = known ? after : loadProfileKeys(cfg, profileName);
+    if (keys.erase(name) || known) {
+        std::vector<std::string> changed{name};
+        writeProfileSnapshot(cfg, profileName, keys, known ? &changed : nullptr);
     }
-    
-    return keys;
 }
 
-void saveProfileKeys(const core::Config& cfg, const std::string& profileName, const std::map<std::string, std::string>& keys) {
+bool compactProfileKeys(const core::Config& cfg, const std::string& profileName) {
+    system::FileLock lock(profileLockPath(cfg, profileName));
+    return compactProfileKeysLocked(cfg, profileName);
+}
+
+bool duplicateProfileKeys(const core::Config& cfg, const std::string& from, const std::string& to) {
+    auto source = resolveProfileKeysFile(cfg, from);
+    if (!fs::exists(source)) {
+        return false;
+    }
+    auto target = profileKeysPath(cfg, to);
     fs::create_directories(cfg.profilesDir);
-    auto path = profileKeysPath(cfg, profileName);
-    auto tmp = fs::path(cfg.profilesDir) / (".tmp." + profileName + ".keys");
-    
-    {
-        std::ofstream out(tmp);
-        for (const auto& [key, value] : keys) {
-            out << key << "=" << crypto::base64Encode(value) << "\n";
+    system::FileLock lock(profileLockPath(cfg, to));
+    Manifest manifest;
+    if (isManifest(source) && isManifest(target) && readManifest(source.string(), manifest)) {
+        // Copy-on-write: the new profile shares every object until it changes
+        writeManifest(target.string(), manifest);
+        invalidateProfileKeysCache(cfg, to);
+        bumpGeneration(cfg);
+        std::vector<std::string> names;
+        names.reserve(manifest.size());
+        for (const auto& entry : manifest) {
+            names.push_back(entry.first);
         }
+        touchProfileNames(cfg, to, names);
+        return true;
     }
-    
-    if (cfg.gpgAvailable && !cfg.forcePlain && path.extension() == ".gpg") {
-        std::string cmd;
-        std::string passFile;
-        
-        if (!cfg.presetPassphrase.empty()) {
-            passFile = (fs::path(cfg.configDir) / ".pass.tmp").string();
-            {
-                std::ofstream pf(passFile, std::ios::trunc);
-                pf << cfg.presetPassphrase;
-                pf.close();
-            }
-#ifdef __unix__
-            ::chmod(passFile.c_str(), 0600);
-#endif
-            cmd = "gpg --batch --yes -o '" + path.string() +
-                  "' --pinentry-mode loopback --passphrase-file '" + passFile +
-                  "' --symmetric --cipher-algo AES256 '" + tmp.string() + "'";
-        } else {
-            cmd = "gpg --yes -o '" + path.string() +
-                  "' --symmetric --cipher-algo AES256 '" + tmp.string() + "'";
+    std::map<std::string, std::string> keys;
+    if (!tryLoadProfileKeys(cfg, from, keys)) {
+        throw std::runtime_error("Failed to decrypt profile keys for " + from);
+    }
+    invalidateProfileKeysCache(cfg, to);
+    std::vector<std::string> names;
+    for (const auto& entry : keys) {
+        names.push_back(entry.first);
+    }
+    writeProfileSnapshot(cfg, to, keys, &names);
+    return true;
+}
+
+size_t rotateSharedValue(const core::Config& cfg, const std::string& oldValue, const std::string& newValue,
+                         std::vector<std::string>* changedProfiles) {
+    if (!contentStoreEnabled(cfg) || oldValue == newValue) {
+        return 0;
+    }
+    ContentStore store(cfg, aeadPassphrase(cfg, true));
+    std::string oldId = store.digest(oldValue);
+    std::string newId;
+    size_t changed = 0;
+    std::string suffix = std::string(".keys") + MANIFEST_SUFFIX;
+    std::error_code ec;
+    for (fs::directory_iterator it(cfg.profilesDir, ec), end; !ec && it != end; it.increment(ec)) {
+        std::string file = it->path().filename().string();
+        if (!hasSuffix(file, suffix)) {
+            continue;
         }
-        
-        int rc = ::system(cmd.c_str());
-        if (!passFile.empty()) {
-            fs::remove(passFile);
+        std::string profile = file.substr(0, file.size() - suffix.size());
+        system::FileLock lock(profileLockPath(cfg, profile));
+        Manifest manifest;
+        if (!readManifest(it->path().string(), manifest)) {
+            continue;
         }
-        
-        if (rc != 0) {
-            throw std::runtime_error("Failed to encrypt profile keys with gpg");
+        std::vector<std::string> names;
+        for (auto& [name, id] : manifest) {
+            if (id == oldId) {
+                if (newId.empty()) {
+                    newId = store.put(newValue);
+                }
+                id = newId;
+                names.push_back(name);
+            }
         }
-        
-        fs::remove(tmp);
-    } else {
-        // For plain text storage, change extension
-        if (path.extension() == ".gpg") {
-            path = fs::path(cfg.profilesDir) / (profileName + ".keys");
+        if (names.empty()) {
+            continue;
         }
-        fs::rename(tmp, path);
+        writeManifest(it->path().string(), manifest);
+        invalidateProfileKeysCache(cfg, profile);
+        touchProfileNames(cfg, profile, names);
+        if (changedProfiles) {
+            changedProfiles->push_back(profile);
+        }
+        ++changed;
+    }
+    if (changed) {
+        bumpGeneration(cfg);
     }
+    return changed;
+}
+
+size_t collectContentGarbage(const core::Config& cfg) {
+    return ContentStore(cfg, "").collectGarbage(liveDigests(cfg));
 }
 
 std::map<std::string, std::string> readProfileKeys(const core::Config& cfg, const std::string& name) {
@@ -503,7 +2088,7 @@ void setDefaultProfile(const core::Config& cfg, const std::string& profileName)
 
 // Migration utilities
 bool hasGlobalVault(const core::Config& cfg) {
-    return fs::exists(cfg.vaultPath);
+    return fs::exists(cfg.vaultPath.get());
 }
 
 void migrateGlobalVaultToProfiles(const core::Config& cfg) {
@@ -533,8 +2118,8 @@ void migrateGlobalVaultToProfiles(const core::Config& cfg) {
         saveProfileKeys(cfg, defaultProfileName, existingKeys);
         
         // Optionally backup and remove global vault
-        std::string backupPath = cfg.vaultPath + ".backup";
-        fs::copy_file(cfg.vaultPath, backupPath);
+        std::string backupPath = cfg.vaultPath.get() + ".backup";
+        fs::copy_file(cfg.vaultPath.get(), backupPath);
         
         std::cout << "Global vault migrated to default profile. Backup saved to: " << backupPath << std::endl;
         
@@ -547,84 +2132,51 @@ void migrateGlobalVaultToProfiles(const core::Config& cfg) {
 // Key constraint validation
 bool validateKeyUniquenessInProfile(const core::Config& cfg, const std::string& profileName, const std::string& keyName, const std::string& excludeKeyName) {
     try {
-        auto profileKeys = loadProfileKeys(cfg, profileName);
-        
         // Check if key name already exists in profile (excluding the key being updated)
-        for (const auto& [existingKey, value] : profileKeys) {
-            if (existingKey == keyName && existingKey != excludeKeyName) {
-                return false; // Key name already exists
-            }
-        }
-        
-        return true; // Key name is unique in this profile
+        return keyName == excludeKeyName || !loadProfileIndexCached(cfg, profileName)->contains(keyName);
     } catch (const std::exception&) {
         return true; // If we can't load profile, assume it's valid
     }
 }
 
 std::string getServiceForKeyName(const std::string& keyName) {
-    // Extract service name from key name by common patterns
+    // Extract service name from key name by common patterns; first match wins
+    static const std::pair<const char*, const char*> patterns[] = {
+        {"openai", "openai"},         {"anthropic", "anthropic"},    {"gemini", "gemini"},
+        {"google", "gemini"},         {"azure", "azure_openai"},     {"brave", "brave"},
+        {"cohere", "cohere"},         {"deepseek", "deepseek"},      {"exa", "exa"},
+        {"fireworks", "fireworks"},   {"groq", "groq"},              {"huggingface", "huggingface"},
+        {"hugging_face", "huggingface"}, {"langchain", "langchain"}, {"mistral", "mistral"},
+        {"openrouter", "openrouter"}, {"perplexity", "perplexity"},  {"sambanova", "sambanova"},
+        {"tavily", "tavily"},         {"together", "together"},      {"xai", "xai"},
+        {"aws", "aws"},               {"github", "github"},          {"stripe", "stripe"},
+        {"slack", "slack"},           {"discord", "discord"},
+    };
+
     std::string lowerKey = keyName;
     std::transform(lowerKey.begin(), lowerKey.end(), lowerKey.begin(), ::tolower);
-    
-    // Common service patterns
-    if (lowerKey.find("openai") != std::string::npos) return "openai";
-    if (lowerKey.find("anthropic") != std::string::npos) return "anthropic";
-    if (lowerKey.find("gemini") != std::string::npos || lowerKey.find("google") != std::string::npos) return "gemini";
-    if (lowerKey.find("azure") != std::string::npos) return "azure_openai";
-    if (lowerKey.find("brave") != std::string::npos) return "brave";
-    if (lowerKey.find("cohere") != std::string::npos) return "cohere";
-    if (lowerKey.find("deepseek") != std::string::npos) return "deepseek";
-    if (lowerKey.find("exa") != std::string::npos) return "exa";
-    if (lowerKey.find("fireworks") != std::string::npos) return "fireworks";
-    if (lowerKey.find("groq") != std::string::npos) return "groq";
-    if (lowerKey.find("huggingface") != std::string::npos || lowerKey.find("hugging_face") != std::string::npos) return "huggingface";
-    if (lowerKey.find("langchain") != std::string::npos) return "langchain";
-    if (lowerKey.find("mistral") != std::string::npos) return "mistral";
-    if (lowerKey.find("openrouter") != std::string::npos) return "openrouter";
-    if (lowerKey.find("perplexity") != std::string::npos) return "perplexity";
-    if (lowerKey.find("sambanova") != std::string::npos) return "sambanova";
-    if (lowerKey.find("tavily") != std::string::npos) return "tavily";
-    if (lowerKey.find("together") != std::string::npos) return "together";
-    if (lowerKey.find("xai") != std::string::npos) return "xai";
-    if (lowerKey.find("aws") != std::string::npos) return "aws";
-    if (lowerKey.find("github") != std::string::npos) return "github";
-    if (lowerKey.find("stripe") != std::string::npos) return "stripe";
-    if (lowerKey.find("slack") != std::string::npos) return "slack";
-    if (lowerKey.find("discord") != std::string::npos) return "discord";
-    
+    for (const auto& [pattern, service] : patterns) {
+        if (lowerKey.find(pattern) != std::string::npos) {
+            return service;
+        }
+    }
     return "unknown"; // Could not determine service
 }
 
 std::vector<std::string> getServiceKeysInProfile(const core::Config& cfg, const std::string& profileName, const std::string& serviceName) {
-    std::vector<std::string> serviceKeys;
-    
     try {
-        auto profileKeys = loadProfileKeys(cfg, profileName);
-        
-        for (const auto& [keyName, value] : profileKeys) {
-            if (getServiceForKeyName(keyName) == serviceName) {
-                serviceKeys.push_back(keyName);
-            }
-        }
+        const auto& keys = loadProfileIndexCached(cfg, profileName)->keysForService(serviceName);
+        return std::vector<std::string>(keys.begin(), keys.end());
     } catch (const std::exception&) {
-        // Ignore errors loading profile
+        return {}; // Ignore errors loading profile
     }
-    
-    return serviceKeys;
 }
 
 bool canAddKeyToProfile(const core::Config& cfg, const std::string& profileName, const std::string& keyName, const std::string& serviceName) {
     (void)serviceName; // Currently unused, but kept for future extensibility
     
-    // Check if key name is unique in profile
-    if (!validateKeyUniquenessInProfile(cfg, profileName, keyName, "")) {
-        return false;
-    }
-    
     // Multiple keys per service are allowed as long as they have different names
-    // This is already handled by the key name uniqueness check above
-    return true;
+    return validateKeyUniquenessInProfile(cfg, profileName, keyName, "");
 }
 
 } // namespace storage
@@ -0,0 +1,475 @@
+#include "system/process.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+#ifdef _WIN32
+#include <windows.h>
+#define environ _environ
+#else
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <poll.h>
+#include <spawn.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+extern char** environ;
+#endif
+
+namespace ak {
+namespace system {
+
+namespace {
+
+#ifdef _WIN32
+const char PATH_SEPARATOR = ';';
+#else
+const char PATH_SEPARATOR = ':';
+#endif
+
+constexpr size_t MAX_CAPTURE = 1 << 20;
+constexpr int CAPTURE_GRACE_MS = 500;
+
+void appendCapped(std::string& out, const char* data, size_t size) {
+    if (out.size() < MAX_CAPTURE) {
+        out.append(data, std::min(size, MAX_CAPTURE - out.size()));
+    }
+}
+
+// Deadline passed or cancelled; records which in `result`
+bool shouldStop(std::chrono::steady_clock::time_point deadline, bool limited,
+                const std::atomic<bool>* cancel, CaptureResult& result) {
+    if (cancel && cancel->load()) {
+        result.cancelled = true;
+        return true;
+    }
+    if (limited && std::chrono::steady_clock::now() >= deadline) {
+        result.timedOut = true;
+        return true;
+    }
+    return false;
+}
+
+// argv/envp arrays pointing into `strings`, null-terminated
+std::vector<char*> pointers(const std::vector<std::string>& strings) {
+    std::vector<char*> out;
+    out.reserve(strings.size() + 1);
+    for (const auto& s : strings) {
+        out.push_back(const_cast<char*>(s.c_str()));
+    }
+    out.push_back(nullptr);
+    return out;
+}
+
+bool isExecutable(const std::string& path) {
+#ifdef _WIN32
+    DWORD attrs = GetFileAttributesA(path.c_str());
+    return attrs != INVALID_FILE_ATTRIBUTES && !(attrs & FILE_ATTRIBUTE_DIRECTORY);
+#else
+    struct stat st;
+    return ::stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode) && ::access(path.c_str(), X_OK) == 0;
+#endif
+}
+
+#ifdef _WIN32
+// One argument quoted the way CommandLineToArgvW splits it back
+void appendQuoted(std::string& line, const std::string& arg) {
+    if (!arg.empty() && arg.find_first_of(" \t\"") == std::string::npos) {
+        line += arg;
+        return;
+    }
+    line += '"';
+    size_t backslashes = 0;
+    for (char c : arg) {
+        if (c == '\\') {
+            ++backslashes;
+            continue;
+        }
+        line.append(c == '"' ? backslashes * 2 + 1 : backslashes, '\\');
+        backslashes = 0;
+        line += c;
+    }
+    line.append(backslashes * 2, '\\');
+    line += '"';
+}
+#endif
+
+} // namespace
+
+std::vector<std::string> mergeEnvironment(const std::vector<std::pair<std::string, std::string>>& overrides) {
+    std::unordered_map<std::string, size_t> latest; // name -> index of its last override
+    for (size_t i = 0; i < overrides.size(); ++i) {
+        latest[overrides[i].first] = i;
+    }
+
+    std::vector<std::string> env;
+    std::unordered_set<std::string> placed;
+    for (char** entry = environ; entry && *entry; ++entry) {
+        std::string_view text(*entry);
+        std::string name(text.substr(0, text.find('=')));
+        auto it = latest.find(name);
+        if (it == latest.end()) {
+            env.emplace_back(text);
+        } else if (placed.insert(name).second) {
+            env.push_back(name + "=" + overrides[it->second].second);
+        }
+    }
+    for (size_t i = 0; i < overrides.size(); ++i) {
+        const auto& name = overrides[i].first;
+        if (latest[name] == i && placed.insert(name).second) {
+            env.push_back(name + "=" + overrides[i].second);
+        }
+    }
+    return env;
+}
+
+std::string findExecutable(const std::string& program) {
+    if (program.empty()) {
+        return "";
+    }
+#ifdef _WIN32
+    if (program.find_first_of("/\\") != std::string::npos) {
+        return program;
+    }
+    const char* const suffixes[] = {"", ".exe", ".cmd", ".bat"};
+#else
+    if (program.find('/') != std::string::npos) {
+        return program;
+    }
+    const char* const suffixes[] = {""};
+#endif
+    const char* pathEnv = std::getenv("PATH");
+    std::string path = pathEnv ? pathEnv : "/usr/local/bin:/bin:/usr/bin";
+    size_t start = 0;
+    for (;;) {
+        size_t end = path.find(PATH_SEPARATOR, start);
+        std::string dir = path.substr(start, end == std::string::npos ? std::string::npos : end - start);
+        if (dir.empty()) {
+            dir = "."; // an empty PATH element means the current directory
+        }
+        for (const char* suffix : suffixes) {
+            std::string candidate = dir + "/" + program + suffix;
+            if (isExecutable(candidate)) {
+                return candidate;
+            }
+        }
+        if (end == std::string::npos) {
+            return "";
+        }
+        start = end + 1;
+    }
+}
+
+#ifdef _WIN32
+
+bool spawnProcess(const std::vector<std::string>& argv, const std::vector<std::string>& env, ChildProcess& child) {
+    std::string path = argv.empty() ? "" : findExecutable(argv[0]);
+    if (path.empty()) {
+        return false;
+    }
+    std::string line;
+    for (size_t i = 0; i < argv.size(); ++i) {
+        if (i > 0) {
+            line += ' ';
+        }
+        appendQuoted(line, argv[i]);
+    }
+    std::string block;
+    for (const auto& entry : env) {
+        block += entry;
+        block += '\0';
+    }
+    block += '\0';
+
+    STARTUPINFOA si{};
+    si.cb = sizeof(si);
+    PROCESS_INFORMATION pi{};
+    if (!CreateProcessA(path.c_str(), &line[0], nullptr, nullptr, TRUE, 0, &block[0], nullptr, &si, &pi)) {
+        return false;
+    }
+    CloseHandle(pi.hThread);
+    child.handle = pi.hProcess;
+    child.pid = static_cast<long>(pi.dwProcessId);
+    return true;
+}
+
+bool waitProcess(ChildProcess& child, int timeoutMs, int& exitCode) {
+    if (!child.handle) {
+        exitCode = 1;
+        return true;
+    }
+    if (WaitForSingleObject(child.handle, timeoutMs < 0 ? INFINITE : static_cast<DWORD>(timeoutMs)) != WAIT_OBJECT_0) {
+        return false;
+    }
+    DWORD code = 1;
+    GetExitCodeProcess(child.handle, &code);
+    CloseHandle(child.handle);
+    child.handle = nullptr;
+    child.pid = -1;
+    exitCode = static_cast<int>(code);
+    return true;
+}
+
+void stopProcess(ChildProcess& child, int graceMs) {
+    (void)graceMs; // no SIGTERM equivalent for console programs
+    if (!child.handle) {
+        return;
+    }
+    TerminateProcess(child.handle, 1);
+    int code = 0;
+    waitProcess(child, -1, code);
+}
+
+CaptureResult captureProcess(const std::vector<std::string>& argv, int timeoutMs,
+                             const std::atomic<bool>* cancel) {
+    CaptureResult result;
+    std::string path = argv.empty() ? "" : findExecutable(argv[0]);
+    if (path.empty()) {
+        return result;
+    }
+    std::string line;
+    for (size_t i = 0; i < argv.size(); ++i) {
+        if (i > 0) {
+            line += ' ';
+        }
+        appendQuoted(line, argv[i]);
+    }
+    SECURITY_ATTRIBUTES sa{};
+    sa.nLength = sizeof(sa);
+    sa.bInheritHandle = TRUE;
+    HANDLE readEnd = nullptr;
+    HANDLE writeEnd = nullptr;
+    if (!CreatePipe(&readEnd, &writeEnd, &sa, 0)) {
+        return result;
+    }
+    SetHandleInformation(readEnd, HANDLE_FLAG_INHERIT, 0);
+    STARTUPINFOA si{};
+    si.cb = sizeof(si);
+    si.dwFlags = STARTF_USESTDHANDLES;
+    si.hStdInput = INVALID_HANDLE_VALUE;
+    si.hStdOutput = writeEnd;
+    si.hStdError = writeEnd;
+    PROCESS_INFORMATION pi{};
+    BOOL created = CreateProcessA(path.c_str(), &line[0], nullptr, nullptr, TRUE, CREATE_NO_WINDOW, nullptr,
+                                  nullptr, &si, &pi);
+    CloseHandle(writeEnd);
+    if (!created) {
+        CloseHandle(readEnd);
+        return result;
+    }
+    CloseHandle(pi.hThread);
+    result.started = true;
+    ChildProcess child;
+    child.handle = pi.hProcess;
+    child.pid = static_cast<long>(pi.dwProcessId);
+
+    // Pipe reads block, so they get a thread; this one watches the clock
+    std::thread reader([&] {
+        char buffer[4096];
+        DWORD n = 0;
+        while (ReadFile(readEnd, buffer, sizeof(buffer), &n, nullptr) && n > 0) {
+            appendCapped(result.output, buffer, n);
+        }
+    });
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs < 0 ? 0 : timeoutMs);
+    int code = -1;
+    while (!waitProcess(child, 50, code)) {
+        if (shouldStop(deadline, timeoutMs >= 0, cancel, result)) {
+            stopProcess(child, CAPTURE_GRACE_MS);
+            code = -1;
+            break;
+        }
+    }
+    reader.join();
+    CloseHandle(readEnd);
+    result.exitCode = code;
+    return result;
+}
+
+int execProcess(const std::vector<std::string>& argv, const std::vector<std::string>& env) {
+    ChildProcess child;
+    if (!spawnProcess(argv, env, child)) {
+        return 127;
+    }
+    int code = 1;
+    waitProcess(child, -1, code);
+    return code;
+}
+
+#else
+
+bool spawnProcess(const std::vector<std::string>& argv, const std::vector<std::string>& env, ChildProcess& child) {
+    std::string path = argv.empty() ? "" : findExecutable(argv[0]);
+    if (path.empty()) {
+        return false;
+    }
+    auto cargv = pointers(argv);
+    auto cenv = pointers(env);
+
+    // The parent may ignore SIGINT while it supervises; the child must not
+    // inherit that
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    sigset_t defaults;
+    sigemptyset(&defaults);
+    sigaddset(&defaults, SIGINT);
+    sigaddset(&defaults, SIGQUIT);
+    sigaddset(&defaults, SIGTERM);
+    sigaddset(&defaults, SIGPIPE);
+    posix_spawnattr_setsigdefault(&attr, &defaults);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGDEF);
+
+    pid_t pid = -1;
+    int rc = posix_spawn(&pid, path.c_str(), nullptr, &attr, cargv.data(), cenv.data());
+    posix_spawnattr_destroy(&attr);
+    if (rc != 0) {
+        return false;
+    }
+    child.pid = pid;
+    return true;
+}
+
+bool waitProcess(ChildProcess& child, int timeoutMs, int& exitCode) {
+    if (child.pid <= 0) {
+        exitCode = 1;
+        return true;
+    }
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs < 0 ? 0 : timeoutMs);
+    for (;;) {
+        int status = 0;
+        pid_t r = ::waitpid(static_cast<pid_t>(child.pid), &status, timeoutMs < 0 ? 0 : WNOHANG);
+        if (r == static_cast<pid_t>(child.pid)) {
+            exitCode = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+            child.pid = -1;
+            return true;
+        }
+        if (r < 0 && errno != EINTR) {
+            exitCode = 1;
+            child.pid = -1;
+            return true;
+        }
+        if (timeoutMs >= 0) {
+            if (std::chrono::steady_clock::now() >= deadline) {
+                return false;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+    }
+}
+
+void stopProcess(ChildProcess& child, int graceMs) {
+    if (child.pid <= 0) {
+        return;
+    }
+    int code = 0;
+    ::kill(static_cast<pid_t>(child.pid), SIGTERM);
+    if (!waitProcess(child, graceMs, code)) {
+        ::kill(static_cast<pid_t>(child.pid), SIGKILL);
+        waitProcess(child, -1, code);
+    }
+}
+
+CaptureResult captureProcess(const std::vector<std::string>& argv, int timeoutMs,
+                             const std::atomic<bool>* cancel) {
+    CaptureResult result;
+    std::string path = argv.empty() ? "" : findExecutable(argv[0]);
+    int fds[2];
+    if (path.empty() || ::pipe(fds) != 0) {
+        return result;
+    }
+    ::fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    ::fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+    posix_spawn_file_actions_adddup2(&actions, fds[1], STDOUT_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, fds[1], STDERR_FILENO);
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    sigset_t defaults;
+    sigemptyset(&defaults);
+    sigaddset(&defaults, SIGINT);
+    sigaddset(&defaults, SIGPIPE);
+    posix_spawnattr_setsigdefault(&attr, &defaults);
+    // Its own process group, so stopping it also stops what it started
+    posix_spawnattr_setpgroup(&attr, 0);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETPGROUP);
+    auto cargv = pointers(argv);
+    pid_t pid = -1;
+    int rc = posix_spawn(&pid, path.c_str(), &actions, &attr, cargv.data(), environ);
+    posix_spawnattr_destroy(&attr);
+    posix_spawn_file_actions_destroy(&actions);
+    ::close(fds[1]);
+    if (rc != 0) {
+        ::close(fds[0]);
+        return result;
+    }
+    result.started = true;
+    ChildProcess child;
+    child.pid = pid;
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs < 0 ? 0 : timeoutMs);
+    bool stopped = false;
+    char buffer[4096];
+    for (;;) {
+        if (shouldStop(deadline, timeoutMs >= 0, cancel, result)) {
+            ::kill(-pid, SIGTERM);
+            stopProcess(child, CAPTURE_GRACE_MS);
+            stopped = true;
+            break;
+        }
+        pollfd pfd{fds[0], POLLIN, 0};
+        int ready = ::poll(&pfd, 1, 50);
+        if (ready < 0 && errno != EINTR) {
+            break;
+        }
+        if (ready <= 0) {
+            continue;
+        }
+        ssize_t n = ::read(fds[0], buffer, sizeof(buffer));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break; // EOF: the child (and anything it forked) closed the pipe
+        }
+        appendCapped(result.output, buffer, static_cast<size_t>(n));
+    }
+    ::close(fds[0]);
+    int code = -1;
+    // A child that closed its output but keeps running still gets the deadline
+    while (!stopped && !waitProcess(child, 50, code)) {
+        if (shouldStop(deadline, timeoutMs >= 0, cancel, result)) {
+            ::kill(-pid, SIGTERM);
+            stopProcess(child, CAPTURE_GRACE_MS);
+            code = -1;
+            break;
+        }
+    }
+    result.exitCode = code;
+    return result;
+}
+
+int execProcess(const std::vector<std::string>& argv, const std::vector<std::string>& env) {
+    std::string path = argv.empty() ? "" : findExecutable(argv[0]);
+    if (path.empty()) {
+        return 127;
+    }
+    auto cargv = pointers(argv);
+    auto cenv = pointers(env);
+    ::execve(path.c_str(), cargv.data(), cenv.data());
+    return errno == ENOENT ? 127 : 126;
+}
+
+#endif
+
+} // namespace system
+} // namespace ak
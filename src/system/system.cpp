@@ -1,12 +1,18 @@
 #include "system/system.hpp"
 #include "core/config.hpp"
+#include "crypto/crypto.hpp"
 #include <array>
+#include <atomic>
+#include <cerrno>
 #include <cstdio>
 #include <cstdlib>
 #include <fstream>
 #include <sstream>
+#include <stdexcept>
+#include <vector>
 #include <iostream>
 #include <filesystem>
+#include <random>
 #ifdef __unix__
 #include <termios.h>
 #include <unistd.h>
@@ -14,6 +20,13 @@
 #include <sys/stat.h>
 #include <sys/wait.h>
 #endif
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#endif
 
 namespace ak {
 namespace system {
@@ -142,6 +155,98 @@ void appendLine(const std::string& path, const std::string& line) {
     file << line << "\n";
 }
 
+std::string uniqueTmpPath(const std::string& path) {
+    static std::atomic<unsigned long> counter{0};
+#if defined(__unix__) || defined(__APPLE__)
+    long pid = static_cast<long>(::getpid());
+#elif defined(_WIN32)
+    long pid = static_cast<long>(::GetCurrentProcessId());
+#else
+    long pid = 0;
+#endif
+    return path + "." + std::to_string(pid) + "." + std::to_string(counter++) + ".tmp";
+}
+
+void writeFileAtomic(const fs::path& path, const std::string& data) {
+    fs::path tmp = system::uniqueTmpPath(path.string());
+#if defined(__unix__) || defined(__APPLE__)
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to create " + tmp.string());
+    }
+    size_t done = 0;
+    while (done < data.size()) {
+        ssize_t n = ::write(fd, data.data() + done, data.size() - done);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        done += static_cast<size_t>(n);
+    }
+    bool synced = done == data.size() && ::fsync(fd) == 0;
+    ::close(fd);
+#else
+    bool synced = false;
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            throw std::runtime_error("Failed to create " + tmp.string());
+        }
+        out.write(data.data(), static_cast<std::streamsize>(data.size()));
+        synced = static_cast<bool>(out.flush());
+    }
+#endif
+    std::error_code ec;
+    if (!synced) {
+        fs::remove(tmp, ec);
+        throw std::runtime_error("Failed to write " + tmp.string());
+    }
+    fs::rename(tmp, path, ec);
+    if (ec) {
+        fs::remove(tmp, ec);
+        throw std::runtime_error("Failed to replace " + path.string());
+    }
+}
+
+FileLock::FileLock(const fs::path& path) {
+#if defined(__unix__) || defined(__APPLE__)
+    fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd_ < 0) {
+        return;
+    }
+    int rc;
+    do {
+        rc = ::flock(fd_, LOCK_EX);
+    } while (rc != 0 && errno == EINTR);
+    held_ = rc == 0;
+#elif defined(_WIN32)
+    HANDLE h = ::CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                             OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (h == INVALID_HANDLE_VALUE) {
+        return;
+    }
+    handle_ = h;
+    OVERLAPPED overlapped = {};
+    held_ = ::LockFileEx(h, LOCKFILE_EXCLUSIVE_LOCK, 0, MAXDWORD, MAXDWORD, &overlapped) != 0;
+#else
+    (void)path;
+#endif
+}
+
+FileLock::~FileLock() {
+#if defined(__unix__) || defined(__APPLE__)
+    if (fd_ >= 0) {
+        ::close(fd_); // releases the lock
+    }
+#elif defined(_WIN32)
+    if (handle_) {
+        ::CloseHandle(static_cast<HANDLE>(handle_));
+    }
+#endif
+}
+
 // User information
 TargetUser resolveTargetUser() {
     TargetUser user;
@@ -280,52 +385,12 @@ void writeShellInitFile(const core::Config& cfg) {
     out << "    fi\n";
     out << "}\n\n";
     
-    out << "# Auto-load persisted profiles for current directory\n";
-    out << "ak_auto_load() {\n";
-    out << "    local current_dir=\"$(pwd)\"\n";
-    out << "    local ak_binary=\"" << akBinary << "\"\n";
-    out << "    \n";
-    out << "    # Skip auto-loading if we're already in the middle of loading\n";
-    out << "    if [ -n \"$AK_LOADING\" ]; then\n";
-    out << "        return 0\n";
-    out << "    fi\n";
-    out << "    \n";
-    out << "    # Get persisted profiles for this directory\n";
-    out << "    local persisted_profiles\n";
-    out << "    persisted_profiles=$(\"$ak_binary\" _internal_get_dir_profiles \"$current_dir\" 2>/dev/null)\n";
-    out << "    \n";
-    out << "    if [ -z \"$persisted_profiles\" ]; then\n";
-    out << "        return 0\n";
-    out << "    fi\n";
-    out << "    \n";
-    out << "    # Set loading flag to prevent recursion\n";
-    out << "    export AK_LOADING=1\n";
-    out << "    \n";
-    out << "    # Load each persisted profile\n";
-    out << "    echo \"$persisted_profiles\" | while read -r profile_name; do\n";
-    out << "        if [ -n \"$profile_name\" ]; then\n";
-    out << "            # Check if it's a default profile or if we should auto-load it\n";
-    out << "            if [ \"$profile_name\" = \"default\" ] || [ \"$AK_AUTO_LOAD_ALL\" = \"1\" ]; then\n";
-    out << "                local exports\n";
-    out << "                exports=$(\"$ak_binary\" _internal_get_bundle \"$profile_name\" 2>/dev/null)\n";
-    out << "                if [ -n \"$exports\" ]; then\n";
-    out << "                    eval \"$exports\"\n";
-    out << "                    echo \"🔄 Auto-loaded profile '$profile_name' for $current_dir\" >&2\n";
-    out << "                fi\n";
-    out << "            fi\n";
-    out << "        fi\n";
-    out << "    done\n";
-    out << "    \n";
-    out << "    # Clear loading flag\n";
-    out << "    unset AK_LOADING\n";
-    out << "}\n\n";
-    
     out << "# Completion functions (basic)\n";
     out << "if [ -n \"$BASH_VERSION\" ]; then\n";
     out << "    _ak_load_complete() {\n";
     out << "        local cur=\"${COMP_WORDS[COMP_CWORD]}\"\n";
-    out << "        local profiles=$(ak profiles 2>/dev/null)\n";
-    out << "        local keys=$(ak ls 2>/dev/null | awk '{print $1}')\n";
+    out << "        local profiles=$(ak __complete profiles \"$cur\" 2>/dev/null)\n";
+    out << "        local keys=$(ak __complete keys \"$cur\" 2>/dev/null)\n";
     out << "        COMPREPLY=( $(compgen -W \"$profiles $keys --persist\" -- \"$cur\") )\n";
     out << "    }\n";
     out << "    complete -F _ak_load_complete ak_load\n";
@@ -360,27 +425,29 @@ void writeShellInitFile(const core::Config& cfg) {
     out << "    \"$ak_binary\" \"$@\"\n";
     out << "}\n\n";
     
-    out << "# Directory change detection for auto-loading\n";
-    out << "ak_setup_cd_hook() {\n";
-    out << "    if [ -n \"$BASH_VERSION\" ]; then\n";
-    out << "        # Bash: override cd with a function\n";
-    out << "        cd() {\n";
-    out << "            builtin cd \"$@\" && ak_auto_load\n";
-    out << "        }\n";
-    out << "    elif [ -n \"$ZSH_VERSION\" ]; then\n";
-    out << "        # Zsh: use chpwd hook\n";
-    out << "        chpwd() {\n";
-    out << "            ak_auto_load\n";
-    out << "        }\n";
-    out << "    fi\n";
-    out << "}\n\n";
-    
-    out << "# Setup hooks and run initial auto-load\n";
-    out << "ak_setup_cd_hook\n";
-    out << "ak_auto_load\n\n";
-    
+    // One hook per shell; it skips even the ak call while the directory and
+    // the generation stamp are unchanged
+    std::string stampFile = cfg.persistDir + "/generation";
+    out << "# Auto-load persisted profiles: ak hook-env prints only what changed\n";
+    out << "if [ -n \"$ZSH_VERSION\" ]; then\n";
+    out << "    _ak_hook() { local g=; [ -r \"" << stampFile << "\" ] && read -r g < \"" << stampFile << "\"; "
+        << "[ \"$PWD|$g|$AK_AUTO_LOAD_ALL\" = \"$_AK_HOOK_SEEN\" ] && return; _AK_HOOK_SEEN=\"$PWD|$g|$AK_AUTO_LOAD_ALL\"; "
+        << "eval \"$(\"" << akBinary << "\" hook-env --shell zsh)\"; }\n";
+    out << "    typeset -ag precmd_functions; (( ${precmd_functions[(I)_ak_hook]} )) || precmd_functions=(_ak_hook $precmd_functions)\n";
+    out << "elif [ -n \"$BASH_VERSION\" ]; then\n";
+    out << "    _ak_hook() { local s=$? g=; [ -r \"" << stampFile << "\" ] && read -r g < \"" << stampFile << "\"; "
+        << "if [ \"$PWD|$g|$AK_AUTO_LOAD_ALL\" != \"$_AK_HOOK_SEEN\" ]; then _AK_HOOK_SEEN=\"$PWD|$g|$AK_AUTO_LOAD_ALL\"; "
+        << "eval \"$(\"" << akBinary << "\" hook-env --shell bash)\"; fi; return $s; }\n";
+    out << "    case \";${PROMPT_COMMAND:-};\" in *\";_ak_hook;\"*) ;; *) PROMPT_COMMAND=\"_ak_hook${PROMPT_COMMAND:+;$PROMPT_COMMAND}\" ;; esac\n";
+    out << "fi\n\n";
+
     out << "# Export functions for availability in subshells\n";
-    out << "export -f ak ak_load ak_unload ak_auto_load ak_setup_cd_hook 2>/dev/null || true\n";
+    out << "export -f ak ak_load ak_unload 2>/dev/null || true\n";
+    out.close();
+
+    std::ofstream fish(fs::path(cfg.configDir) / "shell-init.fish");
+    fish << "# AK Shell Integration (fish) - auto-generated, do not edit\n";
+    fish << "function __ak_hook --on-event fish_prompt; \"" << akBinary << "\" hook-env --shell fish | source; end\n";
 }
 
 void ensureSourcedInRc(const core::Config& cfg) {
@@ -403,10 +470,155 @@ void ensureSourcedInRc(const core::Config& cfg) {
             appendLine(rcFile, "# Added by ak installer");
             appendLine(rcFile, sourceLine);
         }
+    } else if (user.shellName == "fish") {
+        std::string rcFile = user.home + "/.config/fish/config.fish";
+        std::string fishLine = "source \"" + (fs::path(cfg.configDir) / "shell-init.fish").string() + "\"";
+        if (!fileContains(rcFile, fishLine)) {
+            std::error_code ec;
+            fs::create_directories(fs::path(rcFile).parent_path(), ec);
+            appendLine(rcFile, "# Added by ak installer");
+            appendLine(rcFile, fishLine);
+        }
     }
     // Additional shell support would be added here
 }
 
+// Prompt hook
+bool parseShell(const std::string& name, Shell& shell) {
+    if (name == "bash") {
+        shell = Shell::Bash;
+    } else if (name == "zsh") {
+        shell = Shell::Zsh;
+    } else if (name == "fish") {
+        shell = Shell::Fish;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+std::string shellExport(Shell shell, const std::string& name, const std::string& value) {
+    // Single quotes keep $, ` and newlines literal in every supported shell
+    std::string quoted = "'";
+    for (char c : value) {
+        if (c == '\'') {
+            quoted += shell == Shell::Fish ? "\\'" : "'\\''";
+        } else if (c == '\\' && shell == Shell::Fish) {
+            quoted += "\\\\";
+        } else {
+            quoted += c;
+        }
+    }
+    quoted += "'";
+    if (shell == Shell::Fish) {
+        return "set -gx " + name + " " + quoted + ";\n";
+    }
+    return "export " + name + "=" + quoted + ";\n";
+}
+
+std::string shellUnset(Shell shell, const std::string& name) {
+    if (shell == Shell::Fish) {
+        return "set -e " + name + ";\n";
+    }
+    return "unset " + name + ";\n";
+}
+
+std::string hookStateKey(const core::Config& cfg) {
+    fs::path path = fs::path(cfg.configDir) / "hook.key";
+    auto readKey = [&path](std::string& key) {
+        std::ifstream in(path);
+        return std::getline(in, key) && key.size() == 64 &&
+               key.find_first_not_of("0123456789abcdef") == std::string::npos;
+    };
+    std::string key;
+    if (readKey(key)) {
+        return key;
+    }
+
+    std::random_device rd;
+    key.clear();
+    for (int i = 0; i < 8; ++i) {
+        char buf[9];
+        std::snprintf(buf, sizeof(buf), "%08x", static_cast<unsigned>(rd()));
+        key += buf;
+    }
+    try {
+        ensureSecureDir(fs::path(cfg.configDir));
+        writeFileAtomic(path, key + "\n");
+    } catch (const std::runtime_error&) {
+        return key;
+    }
+    // A concurrent first run may have renamed its own key in last
+    std::string stored;
+    return readKey(stored) ? stored : key;
+}
+
+std::string hookValueHash(const std::string& key, const std::string& value) {
+    return crypto::hmacSha256(key, value).substr(0, 12);
+}
+
+// 1:<dir key>:<generation>:<0|1>:<NAME>=<hash>,...
+std::string encodeHookState(const HookState& state) {
+    std::string token = "1:" + state.dirKey + ":" + state.generation + ":" + (state.loadAll ? "1" : "0") + ":";
+    bool first = true;
+    for (const auto& [name, hash] : state.exported) {
+        token += (first ? "" : ",") + name + "=" + hash;
+        first = false;
+    }
+    return token;
+}
+
+bool decodeHookState(const std::string& token, HookState& state) {
+    std::vector<std::string> parts;
+    std::size_t start = 0;
+    for (int i = 0; i < 4; ++i) {
+        std::size_t colon = token.find(':', start);
+        if (colon == std::string::npos) {
+            return false;
+        }
+        parts.push_back(token.substr(start, colon - start));
+        start = colon + 1;
+    }
+    if (parts[0] != "1") {
+        return false;
+    }
+
+    HookState decoded;
+    decoded.dirKey = parts[1];
+    decoded.generation = parts[2];
+    decoded.loadAll = parts[3] == "1";
+    std::istringstream entries(token.substr(start));
+    std::string entry;
+    while (std::getline(entries, entry, ',')) {
+        auto eq = entry.find('=');
+        if (eq == std::string::npos || eq == 0) {
+            return false;
+        }
+        decoded.exported[entry.substr(0, eq)] = entry.substr(eq + 1);
+    }
+    state = decoded;
+    return true;
+}
+
+std::string hookDelta(Shell shell, const HookState& previous, const HookState& next,
+                      const std::map<std::string, std::string>& values) {
+    std::string out;
+    for (const auto& [name, hash] : previous.exported) {
+        if (!next.exported.count(name)) {
+            out += shellUnset(shell, name);
+        }
+    }
+    for (const auto& [name, hash] : next.exported) {
+        auto prev = previous.exported.find(name);
+        auto value = values.find(name);
+        if (value != values.end() && (prev == previous.exported.end() || prev->second != hash)) {
+            out += shellExport(shell, name, value->second);
+        }
+    }
+    out += shellExport(shell, "AK_HOOK_STATE", encodeHookState(next));
+    return out;
+}
+
 // Guard functions - Placeholder implementations  
 void guard_enable(const core::Config& cfg) {
     // This would contain the guard enable logic
@@ -0,0 +1,141 @@
+#include "gtest/gtest.h"
+#include "agent/agent.hpp"
+#include "commands/layers.hpp"
+#include "crypto/aead.hpp"
+#include "storage/vault.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <random>
+#include <thread>
+
+namespace fs = std::filesystem;
+using namespace ak;
+
+#ifdef __unix__
+
+namespace {
+
+class AgentTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        std::random_device rd;
+        root = fs::temp_directory_path() / ("ak_agent_" + std::to_string(rd()));
+        fs::create_directories(root);
+        cfg.configDir = root.string();
+        cfg.profilesDir = (root / "profiles").string();
+        cfg.persistDir = (root / "persist").string();
+        cfg.vaultPath = (root / "keys.env").string();
+        cfg.instanceId = "test" + std::to_string(rd());
+        cfg.forcePlain = true;
+        ::unsetenv("XDG_RUNTIME_DIR");
+        ::unsetenv("AK_NO_AGENT");
+    }
+
+    void TearDown() override {
+        agent::stop(cfg);
+        if (server.joinable()) {
+            server.join();
+        }
+        storage::clearProfileKeysCache();
+        std::error_code ec;
+        fs::remove_all(root, ec);
+    }
+
+    void startAgent(int ttl = 30) {
+        server = std::thread([this, ttl]() { agent::serve(cfg, ttl); });
+        for (int i = 0; i < 100 && !agent::ping(cfg); ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    }
+
+    fs::path root;
+    core::Config cfg;
+    std::thread server;
+};
+
+} // namespace
+
+TEST_F(AgentTest, NoAgentMeansQuickFallback) {
+    std::map<std::string, std::string> keys;
+    EXPECT_FALSE(agent::ping(cfg));
+    EXPECT_FALSE(agent::fetchProfileKeys(cfg, "default", keys));
+}
+
+TEST_F(AgentTest, ServesProfileKeysAndVault) {
+    storage::saveProfileKeys(cfg, "dev", {{"OPENAI_API_KEY", "sk-agent"}, {"MULTI", "a\nb"}});
+    core::KeyStore ks;
+    ks.kv["LEGACY"] = "v";
+    storage::saveVault(cfg, ks);
+
+    startAgent();
+    ASSERT_TRUE(agent::ping(cfg));
+    EXPECT_EQ(fs::status(agent::socketPath(cfg)).permissions() & fs::perms::all,
+              fs::perms::owner_read | fs::perms::owner_write);
+
+    std::map<std::string, std::string> keys;
+    ASSERT_TRUE(agent::fetchProfileKeys(cfg, "dev", keys));
+    EXPECT_EQ(keys["OPENAI_API_KEY"], "sk-agent");
+    EXPECT_EQ(keys["MULTI"], "a\nb");
+
+    core::KeyStore vault;
+    ASSERT_TRUE(agent::fetchVault(cfg, vault));
+    EXPECT_EQ(vault.kv["LEGACY"], "v");
+
+    // Changes on disk are picked up without restarting the agent
+    storage::saveProfileKeys(cfg, "dev", {{"OPENAI_API_KEY", "sk-rotated"}});
+    keys.clear();
+    ASSERT_TRUE(agent::fetchProfileKeys(cfg, "dev", keys));
+    EXPECT_EQ(keys["OPENAI_API_KEY"], "sk-rotated");
+}
+
+TEST_F(AgentTest, ProfileItCannotDecryptFallsBackToTheClient) {
+    if (!crypto::aeadAvailable()) {
+        GTEST_SKIP() << "built without OpenSSL";
+    }
+    cfg.forcePlain = false;
+    cfg.backend = "aead";
+    core::Config owner = cfg;
+    owner.presetPassphrase = "owner-pass";
+    storage::saveProfileKeys(owner, "prod", {{"TOKEN", "sk-prod"}});
+    cfg.presetPassphrase = "agent-pass";
+    storage::saveProfileKeys(cfg, "dev", {{"TOKEN", "sk-dev"}});
+
+    startAgent();
+    ASSERT_TRUE(agent::ping(cfg));
+    std::map<std::string, std::string> keys;
+    ASSERT_TRUE(agent::fetchProfileKeys(cfg, "dev", keys));
+    EXPECT_EQ(keys["TOKEN"], "sk-dev");
+    keys.clear();
+    EXPECT_FALSE(agent::fetchProfileKeys(cfg, "prod", keys));
+    EXPECT_TRUE(keys.empty());
+
+    // The agent's refusal sends the client to its own decrypt
+    storage::writeProfile(owner, "prod", {"TOKEN"});
+    using Values = std::vector<std::pair<std::string, std::string>>;
+    EXPECT_EQ(commands::resolveLayers(owner, {"prod"}).values(), (Values{{"TOKEN", "sk-prod"}}));
+}
+
+TEST_F(AgentTest, RejectsPathTraversal) {
+    startAgent();
+    std::map<std::string, std::string> keys;
+    EXPECT_FALSE(agent::fetchProfileKeys(cfg, "../../etc/passwd", keys));
+}
+
+TEST_F(AgentTest, StopRemovesSocket) {
+    startAgent();
+    ASSERT_TRUE(agent::stop(cfg));
+    server.join();
+    EXPECT_FALSE(fs::exists(agent::socketPath(cfg)));
+    EXPECT_FALSE(agent::ping(cfg));
+}
+
+TEST_F(AgentTest, IdleTimeoutExits) {
+    startAgent(1);
+    ASSERT_TRUE(agent::ping(cfg));
+    server.join();  // returns once the agent has been idle for a second
+    EXPECT_FALSE(agent::ping(cfg));
+}
+
+#endif
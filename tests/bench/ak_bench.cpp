@@ -0,0 +1,270 @@
+// Benchmarks for the layers `ak load` and `ak test` go through, from the
+// primitives up to whole commands. Run via the `bench` target, which writes
+// bench.json (Google Benchmark's JSON format) next to the binary; any
+// benchmark flag works when running ak_bench directly, e.g.
+//   ./ak_bench --benchmark_filter=Profile --benchmark_out=before.json
+
+#include <benchmark/benchmark.h>
+
+#include "commands/commands.hpp"
+#include "core/config.hpp"
+#include "crypto/aead.hpp"
+#include "crypto/crypto.hpp"
+#include "services/services.hpp"
+#include "storage/vault.hpp"
+#if defined(__unix__)
+#include "http/local_server.hpp"
+#endif
+
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+using namespace ak;
+
+namespace {
+
+// Plain (or aead) config rooted in a fresh temp directory, removed on scope exit
+struct BenchRoot {
+    explicit BenchRoot(bool aead = false) {
+        std::random_device rd;
+        root = fs::temp_directory_path() / ("ak_bench_" + std::to_string(rd()));
+        fs::create_directories(root);
+        cfg.configDir = root.string();
+        cfg.profilesDir = (root / "profiles").string();
+        cfg.persistDir = (root / "persist").string();
+        cfg.vaultPath = (root / "keys.env").string();
+        cfg.auditLogPath = (root / "audit.log").string();
+        if (aead) {
+            cfg.backend = "aead";
+            cfg.presetPassphrase = "bench-passphrase";
+        } else {
+            cfg.forcePlain = true;
+        }
+        storage::clearProfileKeysCache();
+    }
+    ~BenchRoot() {
+        storage::clearProfileKeysCache();
+        std::error_code ec;
+        fs::remove_all(root, ec);
+    }
+
+    fs::path root;
+    core::Config cfg;
+};
+
+// `count` keys shaped like real ones: service-style names, 40-60 byte values
+std::map<std::string, std::string> syntheticKeys(size_t count) {
+    std::map<std::string, std::string> keys;
+    std::mt19937 gen(42);
+    const std::string alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789";
+    for (size_t i = 0; i < count; ++i) {
+        std::string value = "sk-";
+        size_t length = 40 + gen() % 20;
+        for (size_t j = 0; j < length; ++j) {
+            value += alphabet[gen() % alphabet.size()];
+        }
+        keys["SERVICE" + std::to_string(i) + "_API_KEY"] = value;
+    }
+    return keys;
+}
+
+std::string randomBytes(size_t size) {
+    std::mt19937 gen(7);
+    std::string data(size, '\0');
+    for (auto& c : data) {
+        c = static_cast<char>(gen());
+    }
+    return data;
+}
+
+// Swallows a command's stdout for the scope
+struct MuteStdout {
+    MuteStdout() : saved(std::cout.rdbuf(sink.rdbuf())) {}
+    ~MuteStdout() { std::cout.rdbuf(saved); }
+    std::ostringstream sink;
+    std::streambuf* saved;
+};
+
+void profileSizes(benchmark::internal::Benchmark* b) {
+    for (int keys : {10, 1000, 10000}) {
+        b->Arg(keys);
+    }
+}
+
+} // namespace
+
+// ---------------------------------------------------------------------------
+// Micro: primitives
+
+static void BM_Sha256(benchmark::State& state) {
+    std::string data = randomBytes(static_cast<size_t>(state.range(0)));
+    for (auto _ : state) {
+        crypto::SHA256 hasher;
+        hasher.update(reinterpret_cast<const uint8_t*>(data.data()), data.size());
+        benchmark::DoNotOptimize(hasher.finalRaw());
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+    state.SetLabel(crypto::SHA256::backend());
+}
+BENCHMARK(BM_Sha256)->Arg(64)->Arg(4096)->Arg(1 << 20);
+
+static void BM_Base64Encode(benchmark::State& state) {
+    std::string data = randomBytes(static_cast<size_t>(state.range(0)));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(crypto::base64Encode(data));
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+BENCHMARK(BM_Base64Encode)->Arg(64)->Arg(4096)->Arg(1 << 20);
+
+static void BM_Base64Decode(benchmark::State& state) {
+    std::string encoded = crypto::base64Encode(randomBytes(static_cast<size_t>(state.range(0))));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(crypto::base64Decode(encoded));
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(encoded.size()));
+}
+BENCHMARK(BM_Base64Decode)->Arg(64)->Arg(4096)->Arg(1 << 20);
+
+static void BM_ParseEnvFile(benchmark::State& state) {
+    std::string text = "# synthetic .env\n";
+    for (const auto& [name, value] : syntheticKeys(static_cast<size_t>(state.range(0)))) {
+        text += "export " + name + "=\"" + value + "\"\n";
+    }
+    for (auto _ : state) {
+        std::istringstream in(text);
+        benchmark::DoNotOptimize(storage::parse_env_file(in));
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(text.size()));
+}
+BENCHMARK(BM_ParseEnvFile)->Arg(100)->Arg(10000);
+
+static void BM_ParseJsonMin(benchmark::State& state) {
+    std::string text = "{";
+    bool first = true;
+    for (const auto& [name, value] : syntheticKeys(static_cast<size_t>(state.range(0)))) {
+        text += (first ? "\"" : ",\"") + name + "\":\"" + value + "\"";
+        first = false;
+    }
+    text += "}";
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(storage::parse_json_min(text));
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(text.size()));
+}
+BENCHMARK(BM_ParseJsonMin)->Arg(100)->Arg(10000);
+
+// ---------------------------------------------------------------------------
+// Storage: synthetic profiles, decoded from disk on every iteration
+
+static void profileLoad(benchmark::State& state, bool aead) {
+    BenchRoot env(aead);
+    auto keys = syntheticKeys(static_cast<size_t>(state.range(0)));
+    storage::saveProfileKeys(env.cfg, "bench", keys);
+    for (auto _ : state) {
+        storage::clearProfileKeysCache();
+        benchmark::DoNotOptimize(storage::loadProfileKeys(env.cfg, "bench"));
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+
+static void profileSave(benchmark::State& state, bool aead) {
+    BenchRoot env(aead);
+    auto keys = syntheticKeys(static_cast<size_t>(state.range(0)));
+    for (auto _ : state) {
+        // Without a cached copy every save is a full snapshot
+        storage::clearProfileKeysCache();
+        storage::saveProfileKeys(env.cfg, "bench", keys);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+
+static void BM_LoadProfileKeys_Plain(benchmark::State& state) { profileLoad(state, false); }
+static void BM_SaveProfileKeys_Plain(benchmark::State& state) { profileSave(state, false); }
+BENCHMARK(BM_LoadProfileKeys_Plain)->Apply(profileSizes);
+BENCHMARK(BM_SaveProfileKeys_Plain)->Apply(profileSizes);
+
+static void BM_LoadProfileKeys_Aead(benchmark::State& state) {
+    if (!crypto::aeadAvailable()) {
+        state.SkipWithError("built without OpenSSL");
+        return;
+    }
+    profileLoad(state, true);
+}
+static void BM_SaveProfileKeys_Aead(benchmark::State& state) {
+    if (!crypto::aeadAvailable()) {
+        state.SkipWithError("built without OpenSSL");
+        return;
+    }
+    profileSave(state, true);
+}
+BENCHMARK(BM_LoadProfileKeys_Aead)->Apply(profileSizes);
+BENCHMARK(BM_SaveProfileKeys_Aead)->Apply(profileSizes);
+
+// ---------------------------------------------------------------------------
+// End to end: what `ak load`, the shell hook and `ak test` run
+
+static void BM_MakeExportsForProfile(benchmark::State& state) {
+    BenchRoot env;
+    auto keys = syntheticKeys(static_cast<size_t>(state.range(0)));
+    storage::saveProfileKeys(env.cfg, "bench", keys);
+    std::vector<std::string> names;
+    for (const auto& entry : keys) {
+        names.push_back(entry.first);
+    }
+    storage::writeProfile(env.cfg, "bench", names);
+    for (auto _ : state) {
+        storage::clearProfileKeysCache();
+        benchmark::DoNotOptimize(commands::makeExportsForProfile(env.cfg, "bench"));
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+BENCHMARK(BM_MakeExportsForProfile)->Apply(profileSizes);
+
+// `ak _internal_get_bundle`: agent probe, then the persisted bundle
+static void BM_InternalGetBundle(benchmark::State& state) {
+    BenchRoot env;
+    std::string exports;
+    for (const auto& [name, value] : syntheticKeys(static_cast<size_t>(state.range(0)))) {
+        exports += "export " + name + "=\"" + value + "\"\n";
+    }
+    storage::writeEncryptedBundle(env.cfg, "bench", exports);
+    for (auto _ : state) {
+        MuteStdout mute;
+        commands::cmd_internal_get_bundle(env.cfg, {"_internal_get_bundle", "bench"});
+        benchmark::DoNotOptimize(mute.sink.str());
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+BENCHMARK(BM_InternalGetBundle)->Apply(profileSizes);
+
+#if defined(__unix__)
+// `ak test` over custom services that all point at a local keep-alive server
+static void BM_RunTestsParallel(benchmark::State& state) {
+    BenchRoot env;
+    ak::tests::LocalServer server;
+    std::vector<std::string> names;
+    std::map<std::string, std::string> keys;
+    for (int64_t i = 0; i < state.range(0); ++i) {
+        std::string name = "local" + std::to_string(i);
+        std::string keyName = "LOCAL" + std::to_string(i) + "_KEY";
+        services::addService(env.cfg, services::Service(name, keyName, "", server.url("/ok"), "GET", "", "Bearer", true));
+        keys[keyName] = "secret";
+        names.push_back(name);
+    }
+    storage::saveProfileKeys(env.cfg, "default", keys);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(services::run_tests_parallel(env.cfg, names, false, "default", false));
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+BENCHMARK(BM_RunTestsParallel)->Arg(8)->Arg(64)->UseRealTime()->Unit(benchmark::kMillisecond);
+#endif
+
+BENCHMARK_MAIN();
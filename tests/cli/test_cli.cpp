@@ -26,6 +26,15 @@ TEST(ExpandShortFlagsFunction, SingleShortFlag) {
     ASSERT_EQ(result[0], "--profile");
 }
 
+TEST(ExpandShortFlagsFunction, AppendsInPlace) {
+    std::vector<std::string> out = {"run"};
+    appendExpandedFlag("-pi", out);
+    appendExpandedFlag("--json", out);
+    appendExpandedFlag("-", out);
+    appendExpandedFlag("value", out);
+    ASSERT_EQ(out, (std::vector<std::string>{"run", "--profile", "--file", "--json", "-", "value"}));
+}
+
 TEST(ExpandShortFlagsFunction, MultipleShortFlagsInOneArgument) {
     std::vector<std::string> input = {"-pf"};
     auto result = expandShortFlags(input);
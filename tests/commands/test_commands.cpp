@@ -0,0 +1,191 @@
+#include "gtest/gtest.h"
+#include "../storage/temp_config.hpp"
+#include "commands/layers.hpp"
+#include "commands/exporters.hpp"
+#include "storage/vault.hpp"
+#include "storage/blob_store.hpp"
+#include "core/config.hpp"
+#include "crypto/crypto.hpp"
+
+#include <cstdio>
+#include <filesystem>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace fs = std::filesystem;
+using namespace ak;
+
+namespace {
+
+using tests::readFile;
+
+// Layer resolution and exports read profiles through the storage API
+class LayersTest : public tests::TempConfigTest {};
+class ExportTest : public tests::TempConfigTest {};
+
+} // namespace
+
+TEST_F(LayersTest, LayeredProfilesMergeLastWriterWins) {
+    storage::writeProfile(cfg, "base", {"A", "B", "LEGACY"});
+    storage::saveProfileKeys(cfg, "base", {{"A", "base-a"}, {"B", "base-b"}});
+    storage::writeProfile(cfg, "local", {"B", "C"});
+    storage::saveProfileKeys(cfg, "local", {{"B", "local-b"}, {"C", "local-c"}});
+    core::KeyStore vault;
+    vault.kv["LEGACY"] = "from-vault";
+    storage::saveVault(cfg, vault);
+
+    EXPECT_EQ(commands::parseLayers("base,,local"), (std::vector<std::string>{"base", "local"}));
+
+    auto env = commands::resolveLayers(cfg, {"base", "local"});
+    ASSERT_EQ(env.perLayer.size(), 2u);
+    EXPECT_EQ(env.perLayer[0].size(), 3u);
+    EXPECT_EQ(env.perLayer[0][2], (std::pair<std::string, std::string>{"LEGACY", "from-vault"}));
+
+    using Values = std::vector<std::pair<std::string, std::string>>;
+    EXPECT_EQ(env.values(), (Values{{"A", "base-a"}, {"B", "local-b"}, {"LEGACY", "from-vault"}, {"C", "local-c"}}));
+    EXPECT_EQ(env.merged.at("B").layer, 1u);
+    EXPECT_EQ(env.merged.at("A").layer, 0u);
+
+    // Reversed, base wins the shared key; a repeated layer is harmless
+    auto reversed = commands::resolveLayers(cfg, {"local", "base", "base"});
+    EXPECT_EQ(reversed.merged.at("B").value, "base-b");
+    EXPECT_EQ(reversed.merged.at("B").layer, 2u);
+    EXPECT_EQ(reversed.order, (std::vector<std::string>{"B", "C", "A", "LEGACY"}));
+}
+
+TEST_F(LayersTest, VisitLayersMatchesResolvedOrder) {
+    storage::writeProfile(cfg, "base", {"A", "B", "LEGACY"});
+    storage::saveProfileKeys(cfg, "base", {{"A", "base-a"}, {"B", "base-b"}});
+    storage::writeProfile(cfg, "local", {"B", "C"});
+    storage::saveProfileKeys(cfg, "local", {{"B", "local-b"}, {"C", "local-c"}});
+    core::KeyStore vault;
+    vault.kv["LEGACY"] = "from-vault";
+    storage::saveVault(cfg, vault);
+
+    for (const auto& layers : {std::vector<std::string>{"base", "local"},
+                               std::vector<std::string>{"local", "base", "base"}}) {
+        std::vector<std::pair<std::string, std::string>> visited;
+        commands::visitLayers(cfg, layers, [&](std::string_view name, std::string_view value) {
+            visited.emplace_back(std::string(name), std::string(value));
+        });
+        EXPECT_EQ(visited, commands::resolveLayers(cfg, layers).values());
+    }
+}
+
+TEST_F(LayersTest, BlobReferencesResolveToTheirContents) {
+    std::string value(storage::BLOB_CHUNK_SIZE + 17, 'k');
+    storage::BlobStore store(cfg, "");
+    std::istringstream in(value);
+    storage::BlobRef ref = store.put(in);
+    std::string stored = storage::formatBlobRef(ref);
+
+    // Keys holding the reference resolve to the contents wherever values are used
+    storage::writeProfile(cfg, "ops", {"KUBECONFIG", "TOKEN"});
+    storage::saveProfileKeys(cfg, "ops", {{"KUBECONFIG", stored}, {"TOKEN", "t"}});
+    using Values = std::vector<std::pair<std::string, std::string>>;
+    EXPECT_EQ(commands::resolveLayers(cfg, {"ops"}).values(), (Values{{"KUBECONFIG", value}, {"TOKEN", "t"}}));
+    Values visited;
+    commands::visitLayers(cfg, {"ops"}, [&](std::string_view name, std::string_view v) {
+        visited.emplace_back(std::string(name), std::string(v));
+    });
+    EXPECT_EQ(visited, (Values{{"KUBECONFIG", value}, {"TOKEN", "t"}}));
+
+    // A reference whose blob is gone (as after a sync) never becomes an
+    // empty value: its key is left out and the others still load
+    fs::remove(fs::path(storage::BlobStore::dir(cfg)) / ref.id);
+    EXPECT_FALSE(storage::resolveBlobValue(cfg, stored));
+    EXPECT_EQ(commands::resolveLayers(cfg, {"ops"}).values(), (Values{{"TOKEN", "t"}}));
+    visited.clear();
+    commands::visitLayers(cfg, {"ops"}, [&](std::string_view name, std::string_view v) {
+        visited.emplace_back(std::string(name), std::string(v));
+    });
+    EXPECT_EQ(visited, (Values{{"TOKEN", "t"}}));
+}
+
+namespace {
+
+// Runs one export writer over `layers` into a file and returns what it wrote
+std::string exportThrough(const core::Config& cfg, const fs::path& file, const std::string& format,
+                          const std::vector<std::string>& layers, const commands::ExportOptions& options = {}) {
+    auto writer = commands::makeExportWriter(format, options);
+    if (!writer) {
+        ADD_FAILURE() << "no writer for " << format;
+        return "";
+    }
+    std::FILE* f = std::fopen(file.string().c_str(), "wb");
+    {
+        commands::ExportSink sink(fileno(f));
+        commands::streamExport(cfg, layers, *writer, sink);
+        EXPECT_TRUE(sink.ok());
+    }
+    std::fclose(f);
+    return readFile(file);
+}
+
+} // namespace
+
+TEST_F(ExportTest, ExportWritersEscapeForTheirTarget) {
+    storage::writeProfile(cfg, "app", {"PLAIN", "QUOTED", "MULTI"});
+    storage::saveProfileKeys(cfg, "app", {{"PLAIN", "abc"}, {"QUOTED", "say \"hi\" \\o/"}, {"MULTI", "l1\nl2"}});
+    fs::path out = root / "out.txt";
+
+    // Keys come out in the merged order, sorted within a profile
+
+    EXPECT_EQ(exportThrough(cfg, out, "env", {"app"}),
+              "export MULTI=\"l1\\nl2\"\nexport PLAIN=\"abc\"\nexport QUOTED=\"say \\\"hi\\\" \\\\o/\"\n");
+    EXPECT_EQ(exportThrough(cfg, out, "dotenv", {"app"}),
+              "MULTI=\"l1\\nl2\"\nPLAIN=\"abc\"\nQUOTED=\"say \\\"hi\\\" \\\\o/\"\n");
+    EXPECT_EQ(exportThrough(cfg, out, "json", {"app"}),
+              "{\n  \"MULTI\": \"l1\\nl2\",\n  \"PLAIN\": \"abc\",\n  \"QUOTED\": \"say \\\"hi\\\" \\\\o/\"\n}\n");
+    EXPECT_EQ(exportThrough(cfg, out, "systemd", {"app"}),
+              "MULTI=\"l1\nl2\"\nPLAIN=\"abc\"\nQUOTED=\"say \\\"hi\\\" \\\\o/\"\n");
+
+    std::string github = exportThrough(cfg, out, "github", {"app"});
+    auto open = github.find("MULTI<<");
+    ASSERT_NE(open, std::string::npos);
+    std::string delimiter = github.substr(open + 7, github.find('\n', open) - open - 7);
+    EXPECT_EQ(delimiter.rfind("ak_EOF_", 0), 0u);
+    EXPECT_NE(github.find("MULTI<<" + delimiter + "\nl1\nl2\n" + delimiter + "\n"), std::string::npos);
+
+    // docker env-files are literal lines: a multi-line value is refused
+    auto docker = commands::makeExportWriter("docker");
+    std::FILE* f = std::fopen(out.string().c_str(), "wb");
+    {
+        commands::ExportSink sink(fileno(f));
+        EXPECT_THROW(commands::streamExport(cfg, {"app"}, *docker, sink), std::runtime_error);
+    }
+    std::fclose(f);
+    storage::saveProfileKeys(cfg, "app", {{"PLAIN", "abc"}, {"QUOTED", "a \"b\""}, {"MULTI", "x=y"}});
+    EXPECT_EQ(exportThrough(cfg, out, "docker", {"app"}), "MULTI=x=y\nPLAIN=abc\nQUOTED=a \"b\"\n");
+
+    EXPECT_EQ(commands::makeExportWriter("toml"), nullptr);
+}
+
+TEST_F(ExportTest, KubernetesSecretExportIsBase64) {
+    // Larger than one base64 step, and not a multiple of three
+    std::string big(10000, 'x');
+    big += "\x01\xff";
+    storage::writeProfile(cfg, "base", {"TOKEN", "BIG"});
+    storage::saveProfileKeys(cfg, "base", {{"TOKEN", "old"}, {"BIG", big}});
+    storage::writeProfile(cfg, "prod", {"TOKEN"});
+    storage::saveProfileKeys(cfg, "prod", {{"TOKEN", "s3cr3t"}});
+    fs::path out = root / "secret.yaml";
+
+    commands::ExportOptions options{"app-prod", "apps"};
+    std::string yaml = exportThrough(cfg, out, "k8s", {"base", "prod"}, options);
+    EXPECT_EQ(yaml, "apiVersion: v1\nkind: Secret\nmetadata:\n  name: \"app-prod\"\n  namespace: \"apps\"\n"
+                    "type: Opaque\ndata:\n  BIG: " + crypto::base64Encode(big) +
+                    "\n  TOKEN: " + crypto::base64Encode("s3cr3t") + "\n");
+
+    std::string json = exportThrough(cfg, out, "k8s-json", {"prod"}, {"app", ""});
+    EXPECT_EQ(json, "{\n  \"apiVersion\": \"v1\",\n  \"kind\": \"Secret\",\n  \"metadata\": {\"name\": \"app\"},"
+                    "\n  \"type\": \"Opaque\",\n  \"data\": {\n    \"TOKEN\": \"" +
+                    crypto::base64Encode("s3cr3t") + "\"\n  }\n}\n");
+
+    storage::writeProfile(cfg, "empty", {});
+    EXPECT_NE(exportThrough(cfg, out, "k8s", {"empty"}, options).find("data: {}\n"), std::string::npos);
+}
@@ -0,0 +1,128 @@
+#include "gtest/gtest.h"
+#include "core/audit.hpp"
+
+#include <cstdio>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace ak::core;
+
+namespace {
+
+class AuditLogTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        std::random_device rd;
+        dir = std::filesystem::temp_directory_path() / ("ak_audit_" + std::to_string(rd()));
+        std::filesystem::create_directories(dir);
+        path = (dir / "audit.log").string();
+    }
+    void TearDown() override {
+        std::error_code ec;
+        std::filesystem::remove_all(dir, ec);
+    }
+
+    // Day `day` of January 2026, one line per key
+    void append(int day, const std::string& action, const std::vector<std::string>& keys,
+                const AuditRotation& rotation = {}) {
+        char ts[48];
+        std::snprintf(ts, sizeof(ts), "2026-01-%02dT12:00:00.000Z", day);
+        std::string lines;
+        for (const auto& key : keys) {
+            lines += std::string(ts) + " " + action + " " + key + "\n";
+        }
+        appendAudit(path, lines, rotation);
+    }
+
+    std::filesystem::path dir;
+    std::string path;
+};
+
+} // namespace
+
+TEST_F(AuditLogTest, QueriesFilterAndTailWithoutLimitsLeaking) {
+    AuditRotation keep{0, 0};
+    for (int day = 1; day <= 20; ++day) {
+        append(day, day % 2 ? "get" : "set", {"k" + std::to_string(day), "shared"}, keep);
+    }
+
+    AuditQuery last;
+    last.limit = 3;
+    auto tail = queryAudit(path, last);
+    ASSERT_EQ(tail.size(), 3u);
+    EXPECT_EQ(tail[0].keyHash, "shared");
+    EXPECT_EQ(tail[1].keyHash, "k20");
+    EXPECT_EQ(tail[2].timestamp, "2026-01-20T12:00:00.000Z");
+
+    AuditQuery range;
+    range.since = "2026-01-05";
+    range.until = "2026-01-07";
+    range.keyHash = "shared";
+    range.limit = 0;
+    auto days = queryAudit(path, range);
+    ASSERT_EQ(days.size(), 3u);
+    EXPECT_EQ(days.front().timestamp.substr(0, 10), "2026-01-05");
+    EXPECT_EQ(days.back().timestamp.substr(0, 10), "2026-01-07");
+
+    AuditQuery sets;
+    sets.action = "set";
+    sets.limit = 0;
+    EXPECT_EQ(queryAudit(path, sets).size(), 20u);
+    EXPECT_EQ(resolveAuditTime("2026-01-01"), "2026-01-01");
+    EXPECT_EQ(resolveAuditTime("1d").size(), 24u);
+}
+
+TEST_F(AuditLogTest, RotatesIntoIndexedSegments) {
+    AuditRotation small{512, 0};
+    for (int day = 1; day <= 28; ++day) {
+        append(day, "get", {"a", "b", "c"}, small);
+    }
+
+    size_t segments = 0;
+    for (const auto& entry : std::filesystem::directory_iterator(dir)) {
+        segments += entry.path().filename().string().rfind("audit.log.2026", 0) == 0;
+    }
+    EXPECT_GT(segments, 2u);
+    EXPECT_LT(std::filesystem::file_size(path), 512u + 200u);
+
+    // A range in the past is served from segments, oldest first
+    AuditQuery q;
+    q.since = "2026-01-02";
+    q.until = "2026-01-03";
+    q.limit = 0;
+    auto entries = queryAudit(path, q);
+    ASSERT_EQ(entries.size(), 6u);
+    EXPECT_EQ(entries.front().timestamp.substr(0, 10), "2026-01-02");
+    EXPECT_EQ(entries.back().keyHash, "c");
+
+    AuditQuery all;
+    all.limit = 0;
+    EXPECT_EQ(queryAudit(path, all).size(), 28u * 3);
+}
+
+TEST_F(AuditLogTest, ConcurrentWritersKeepBatchesWhole) {
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; ++t) {
+        threads.emplace_back([&, t] {
+            for (int i = 0; i < 100; ++i) {
+                append(1 + t, "t" + std::to_string(t), {"x", "y"}, AuditRotation{4096, 0});
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    AuditQuery all;
+    all.limit = 0;
+    auto entries = queryAudit(path, all);
+    ASSERT_EQ(entries.size(), 8u * 100 * 2);
+    for (size_t i = 0; i + 1 < entries.size(); i += 2) {
+        // Each batch's two lines stay adjacent
+        EXPECT_EQ(entries[i].action, entries[i + 1].action);
+        EXPECT_EQ(entries[i].keyHash, "x");
+        EXPECT_EQ(entries[i + 1].keyHash, "y");
+    }
+}
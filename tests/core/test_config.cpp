@@ -78,13 +78,37 @@ TEST(ConfigStructure, ConfigInitialization) {
     ASSERT_FALSE(cfg.forcePlain);
     ASSERT_TRUE(cfg.presetPassphrase.empty());
     ASSERT_TRUE(cfg.configDir.empty());
-    ASSERT_TRUE(cfg.vaultPath.empty());
+    ASSERT_TRUE(cfg.vaultPath.get().empty());
     ASSERT_TRUE(cfg.profilesDir.empty());
     ASSERT_TRUE(cfg.auditLogPath.empty());
-    ASSERT_TRUE(cfg.instanceId.empty());
+    ASSERT_TRUE(cfg.instanceId.get().empty());
     ASSERT_TRUE(cfg.persistDir.empty());
 }
 
+TEST(LazySetting, ResolvesOnceAndSharesAcrossCopies) {
+    int calls = 0;
+    Config cfg;
+    cfg.instanceId = Lazy<std::string>::deferred([&calls] { ++calls; return std::string("abc"); });
+    Config copy = cfg;
+    EXPECT_TRUE(cfg.instanceId.pending());
+    EXPECT_EQ(calls, 0);
+
+    EXPECT_EQ(copy.instanceId.get(), "abc");
+    EXPECT_EQ(cfg.instanceId.get(), "abc");
+    EXPECT_EQ(calls, 1);
+    EXPECT_FALSE(cfg.instanceId.pending());
+
+    // Assigning detaches from the shared result
+    copy.instanceId = "override";
+    EXPECT_EQ(copy.instanceId.get(), "override");
+    EXPECT_EQ(cfg.instanceId.get(), "abc");
+
+    cfg.gpgAvailable = Lazy<bool>::deferred([] { return true; });
+    EXPECT_TRUE(cfg.gpgAvailable);
+    cfg.gpgAvailable = false;
+    EXPECT_FALSE(cfg.gpgAvailable);
+}
+
 TEST(KeyStoreStructure, KeyStoreInitialization) {
     KeyStore ks;
     ASSERT_TRUE(ks.kv.empty());
@@ -126,4 +150,4 @@ TEST(GetenvsFunction, ShouldReturnActualValueForExistingVariable) {
     // but we can test the function logic with existing env vars
     std::string user = getenvs("USER", "unknown");
     // USER might exist on Unix systems, but if not, should return "unknown"
-}
\ No newline at end of file
+}
@@ -0,0 +1,48 @@
+#include "gtest/gtest.h"
+#include "core/metrics.hpp"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace ak::core;
+
+TEST(Metrics, ExportsCountersAndCumulativeHistograms) {
+    metrics::enable();
+    metrics::reset();
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([] {
+            for (int i = 0; i < 1000; ++i) {
+                metrics::count("ak_cache_requests_total", {{"cache", "profile_keys"}, {"result", "hit"}});
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    metrics::observe("ak_service_test_seconds", {{"service", "open\"ai"}}, 0.003);
+    metrics::observe("ak_service_test_seconds", {{"service", "open\"ai"}}, 0.2);
+    metrics::observe("ak_service_test_seconds", {{"service", "open\"ai"}}, 30);
+    { metrics::Span span("ak_decrypt", {{"backend", "aead"}}); }
+
+    std::string text = metrics::prometheusText();
+    EXPECT_NE(text.find("# TYPE ak_cache_requests_total counter\n"
+                        "ak_cache_requests_total{cache=\"profile_keys\",result=\"hit\"} 4000\n"),
+              std::string::npos);
+    EXPECT_NE(text.find("# TYPE ak_service_test_seconds histogram\n"), std::string::npos);
+    EXPECT_NE(text.find("ak_service_test_seconds_bucket{service=\"open\\\"ai\",le=\"0.0025\"} 0\n"), std::string::npos);
+    EXPECT_NE(text.find("ak_service_test_seconds_bucket{service=\"open\\\"ai\",le=\"0.005\"} 1\n"), std::string::npos);
+    EXPECT_NE(text.find("ak_service_test_seconds_bucket{service=\"open\\\"ai\",le=\"10\"} 2\n"), std::string::npos);
+    EXPECT_NE(text.find("ak_service_test_seconds_bucket{service=\"open\\\"ai\",le=\"+Inf\"} 3\n"), std::string::npos);
+    EXPECT_NE(text.find("ak_service_test_seconds_count{service=\"open\\\"ai\"} 3\n"), std::string::npos);
+    EXPECT_NE(text.find("ak_decrypt_seconds_count{backend=\"aead\"} 1\n"), std::string::npos);
+    EXPECT_NEAR(metrics::histogram("ak_service_test_seconds", {{"service", "open\"ai"}}).sum(), 30.203, 1e-6);
+
+    std::string otlp = metrics::otlpJson();
+    EXPECT_NE(otlp.find("\"name\":\"ak_cache_requests_total\",\"sum\""), std::string::npos);
+    EXPECT_NE(otlp.find("\"asInt\":\"4000\""), std::string::npos);
+    EXPECT_NE(otlp.find("\"bucketCounts\":[\"0\",\"0\",\"0\",\"1\""), std::string::npos);
+    metrics::reset();
+}
@@ -0,0 +1,80 @@
+#include "gtest/gtest.h"
+#include "core/redact.hpp"
+
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#ifdef __unix__
+#include <unistd.h>
+#endif
+
+using namespace ak::core;
+
+TEST(Redactor, ReplacesEverySecretInOnePass) {
+    Redactor redactor({"sk-abc123", "abc", "123456", ""}, {"unauthorized"});
+
+    EXPECT_EQ(redactor.redact("key=sk-abc123 again sk-abc123"), "key=[REDACTED] again [REDACTED]");
+    // Overlapping secrets collapse into one token; no fragment survives
+    EXPECT_EQ(redactor.redact("x123456y sk-abc123456"), "x[REDACTED]y [REDACTED]");
+    EXPECT_EQ(redactor.redact("ABC stays, abc goes"), "ABC stays, [REDACTED] goes");
+
+    bool flagged = false;
+    EXPECT_EQ(redactor.redact("HTTP 401 Unauthorized", &flagged), "HTTP 401 Unauthorized");
+    EXPECT_TRUE(flagged);
+    EXPECT_FALSE(redactor.flags("all fine"));
+    EXPECT_TRUE(Redactor().redact("nothing to do") == "nothing to do");
+}
+
+TEST(PatternMatcher, ReportsOverlappingMatches) {
+    PatternMatcher matcher({{"he", false}, {"she", false}, {"his", false}, {"HERS", true}});
+    std::vector<std::pair<size_t, size_t>> hits; // id, begin
+    matcher.scan("ushers", [&](size_t id, size_t begin, size_t) { hits.emplace_back(id, begin); });
+    EXPECT_EQ(hits, (std::vector<std::pair<size_t, size_t>>{{1, 1}, {0, 2}, {3, 2}}));
+    EXPECT_EQ(matcher.longest(), 4u);
+    EXPECT_FALSE(matcher.spansLines());
+}
+
+#ifdef __unix__
+TEST(Redactor, StreamsAcrossChunkBoundaries) {
+    std::string secret(40, 'k');
+    secret += "-tail";
+    Redactor redactor({secret});
+
+    std::string input;
+    for (int i = 0; i < 4000; ++i) {
+        input += "line " + std::to_string(i) + " " + secret + "\n";
+    }
+    int in[2];
+    int out[2];
+    ASSERT_EQ(pipe(in), 0);
+    ASSERT_EQ(pipe(out), 0);
+    std::thread writer([&] {
+        // Odd-sized writes so secrets straddle reads
+        for (size_t pos = 0; pos < input.size(); pos += 4093) {
+            size_t n = std::min<size_t>(4093, input.size() - pos);
+            ASSERT_EQ(write(in[1], input.data() + pos, n), static_cast<ssize_t>(n));
+        }
+        close(in[1]);
+    });
+    std::string output;
+    std::thread reader([&] {
+        char buf[8192];
+        ssize_t n;
+        while ((n = read(out[0], buf, sizeof(buf))) > 0) {
+            output.append(buf, static_cast<size_t>(n));
+        }
+    });
+    EXPECT_TRUE(redactor.redactStream(in[0], out[1]));
+    close(out[1]);
+    writer.join();
+    reader.join();
+    close(in[0]);
+    close(out[0]);
+
+    EXPECT_EQ(output.find("kkkk"), std::string::npos);
+    EXPECT_EQ(output.substr(0, 19), "line 0 [REDACTED]\nl");
+    EXPECT_EQ(output.size(), input.size() - 4000 * (secret.size() - Redactor::TOKEN.size()));
+}
+#endif
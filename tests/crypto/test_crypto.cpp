@@ -1,5 +1,10 @@
 #include "gtest/gtest.h"
 #include "crypto/crypto.hpp"
+#include "crypto/aead.hpp"
+#include "crypto/secret_arena.hpp"
+
+#include <string>
+#include <vector>
 
 using namespace ak::crypto;
 
@@ -71,6 +76,48 @@ TEST(Base64RoundTrip, VariousStringsShouldEncodeAndDecodeCorrectly) {
     }
 }
 
+TEST(Base64Vector, MatchesScalarAcrossLengths) {
+    std::string input;
+    for (int i = 0; i < 400; ++i) {
+        input.push_back(static_cast<char>((i * 97 + 13) & 0xFF));
+    }
+    for (size_t len = 0; len <= input.size(); ++len) {
+        std::string slice = input.substr(0, len);
+        base64ForcePortable(true);
+        std::string expected = base64Encode(slice);
+        base64ForcePortable(false);
+        std::string encoded = base64Encode(slice);
+        ASSERT_EQ(encoded, expected) << "length " << len;
+        ASSERT_EQ(base64Decode(encoded), slice) << "length " << len;
+        std::string strict;
+        ASSERT_TRUE(base64DecodeStrict(encoded, strict)) << "length " << len;
+        ASSERT_EQ(strict, slice);
+    }
+}
+
+TEST(Base64Vector, LenientDecodeSkipsNoiseInsideLongInput) {
+    std::string value(300, 'k');
+    std::string encoded = base64Encode(value);
+    std::string noisy = encoded.substr(0, 70) + "\n \t" + encoded.substr(70, 90) + "*" + encoded.substr(160);
+    EXPECT_EQ(base64Decode(noisy), value);
+    std::string out;
+    EXPECT_FALSE(base64DecodeStrict(noisy, out));
+    EXPECT_TRUE(out.empty());
+}
+
+TEST(Base64Strict, RejectsMalformedInput) {
+    std::string out;
+    EXPECT_TRUE(base64DecodeStrict("", out));
+    EXPECT_TRUE(base64DecodeStrict("Zm8=", out));
+    EXPECT_EQ(out, "fo");
+    EXPECT_FALSE(base64DecodeStrict("Zm8", out));      // length
+    EXPECT_FALSE(base64DecodeStrict("Zm=8", out));     // padding inside
+    EXPECT_FALSE(base64DecodeStrict("Zm9=Zm9v", out)); // padding before the end
+    EXPECT_FALSE(base64DecodeStrict("Zh==", out));     // non-zero trailing bits
+    EXPECT_FALSE(base64DecodeStrict("Zm\x80v", out));
+    EXPECT_FALSE(base64DecodeStrict("====", out));
+}
+
 TEST(SHA256Hashing, EmptyString) {
     SHA256 hasher;
     hasher.update("");
@@ -103,6 +150,70 @@ TEST(SHA256Hashing, MultipleUpdatesShouldProduceSameResult) {
     ASSERT_EQ(hasher1.final(), hasher2.final());
 }
 
+TEST(SHA256Hashing, HardwareMatchesPortableAcrossLengths) {
+    std::string input;
+    for (int i = 0; i < 300; ++i) {
+        input.push_back(static_cast<char>((i * 131 + 7) & 0xFF));
+    }
+    std::vector<std::string> expected;
+    SHA256::forcePortable(true);
+    for (size_t len = 0; len <= input.size(); ++len) {
+        SHA256 hasher;
+        hasher.update(input.substr(0, len));
+        expected.push_back(hasher.final());
+    }
+    SHA256::forcePortable(false);
+
+    for (size_t len = 0; len <= input.size(); ++len) {
+        SHA256 whole, split;
+        whole.update(input.substr(0, len));
+        split.update(input.substr(0, len / 3));
+        split.update(input.substr(len / 3, len - len / 3));
+        ASSERT_EQ(whole.final(), expected[len]) << SHA256::backend() << " length " << len;
+        ASSERT_EQ(split.final(), expected[len]) << "split at " << len / 3;
+    }
+}
+
+TEST(SHA256Hashing, FinalRawAndCopiedMidstate) {
+    SHA256 salted;
+    salted.update("instance-salt:");
+    SHA256 copy = salted;
+    copy.update("value");
+
+    SHA256 fresh;
+    fresh.update("instance-salt:value");
+    auto raw = fresh.finalRaw();
+    EXPECT_EQ(SHA256::toHex(raw), copy.final());
+
+    SHA256 empty;
+    EXPECT_EQ(SHA256::toHex(empty.finalRaw()), "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+}
+
+TEST(SHA256Hashing, HashManyMatchesSingleMessages) {
+    std::vector<std::string> inputs = {"", "a", "Hello, World!", std::string(55, 'x'), std::string(56, 'y'),
+                                       std::string(64, 'z'), std::string(200, 'q'), "b", "OPENAI_API_KEY"};
+    for (bool portable : {true, false}) {
+        SHA256::forcePortable(portable);
+        auto digests = SHA256::hashMany(inputs);
+        ASSERT_EQ(digests.size(), inputs.size());
+        for (size_t i = 0; i < inputs.size(); ++i) {
+            SHA256 hasher;
+            hasher.update(inputs[i]);
+            EXPECT_EQ(SHA256::toHex(digests[i]), hasher.final()) << "input " << i;
+        }
+    }
+    SHA256::forcePortable(false);
+    EXPECT_TRUE(SHA256::hashMany({}).empty());
+}
+
+TEST(HmacSha256, MatchesRfc4231Vectors) {
+    EXPECT_EQ(hmacSha256("Jefe", "what do ya want for nothing?"),
+              "5bdcc146bf60754e6a042426089575c75a003f089d2739839dec58b964ec3843");
+    // Keys longer than a block are hashed first
+    EXPECT_EQ(hmacSha256(std::string(131, '\xaa'), "Test Using Larger Than Block-Size Key - Hash Key First"),
+              "60e431591ee0b67f0d8a26aacbf5b77f8e0bc6213728c5140546040f0ee37f54");
+}
+
 TEST(HashKeyNameFunction, ShouldProduceConsistent16CharacterHash) {
     std::string hash1 = hashKeyName("API_KEY");
     std::string hash2 = hashKeyName("API_KEY");
@@ -124,4 +235,104 @@ TEST(HashKeyNameFunction, ShouldOnlyContainHexCharacters) {
     for (char c : hash) {
         ASSERT_TRUE(((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f')));
     }
-}
\ No newline at end of file
+}
+TEST(AeadVault, RoundTrip) {
+    if (!aeadAvailable()) {
+        GTEST_SKIP() << "built without OpenSSL";
+    }
+    std::string plaintext = "OPENAI_API_KEY=c2stdGVzdA==\nEMPTY=\n";
+    std::string blob = aeadSeal(plaintext, "correct horse");
+    ASSERT_TRUE(isAeadBlob(blob));
+    ASSERT_EQ(blob.find("OPENAI_API_KEY"), std::string::npos);
+
+    std::string out;
+    ASSERT_TRUE(aeadOpen(blob, "correct horse", out));
+    ASSERT_EQ(out, plaintext);
+}
+
+TEST(AeadVault, FreshNoncePerSeal) {
+    if (!aeadAvailable()) {
+        GTEST_SKIP() << "built without OpenSSL";
+    }
+    ASSERT_NE(aeadSeal("same", "pw"), aeadSeal("same", "pw"));
+}
+
+TEST(AeadVault, WrongPassphraseFails) {
+    if (!aeadAvailable()) {
+        GTEST_SKIP() << "built without OpenSSL";
+    }
+    std::string blob = aeadSeal("secret", "right");
+    std::string out = "unchanged";
+    ASSERT_FALSE(aeadOpen(blob, "wrong", out));
+    ASSERT_EQ(out, "unchanged");
+}
+
+TEST(AeadVault, TamperingIsDetected) {
+    if (!aeadAvailable()) {
+        GTEST_SKIP() << "built without OpenSSL";
+    }
+    std::string blob = aeadSeal("secret value", "pw");
+    std::string out;
+
+    std::string flippedBody = blob;
+    flippedBody[flippedBody.size() - 20] ^= 0x01;
+    ASSERT_FALSE(aeadOpen(flippedBody, "pw", out));
+
+    std::string flippedHeader = blob;
+    flippedHeader[10] ^= 0x01;  // salt byte (authenticated as AAD)
+    ASSERT_FALSE(aeadOpen(flippedHeader, "pw", out));
+
+    ASSERT_FALSE(aeadOpen(blob.substr(0, 20), "pw", out));
+    ASSERT_FALSE(aeadOpen("not a vault", "pw", out));
+}
+
+TEST(AeadVault, OversizedKdfHeaderIsRefused) {
+    if (!aeadAvailable()) {
+        GTEST_SKIP() << "built without OpenSSL";
+    }
+    std::string blob = aeadSeal("secret", "pw");
+    EXPECT_TRUE(aeadParamsSupported(blob));
+    std::string out;
+
+    // N=2^22 with r=255 would have scrypt allocate ~137 GB
+    std::string huge = blob;
+    huge[5] = 22;
+    huge[6] = static_cast<char>(255);
+    EXPECT_FALSE(aeadParamsSupported(huge));
+    EXPECT_FALSE(aeadOpen(huge, "pw", out));
+
+    std::string wide = blob;
+    wide[7] = 17;
+    EXPECT_FALSE(aeadParamsSupported(wide));
+    EXPECT_FALSE(aeadOpen(wide, "pw", out));
+
+    // Each within its own cap, but 4 GiB together
+    std::string heavy = blob;
+    heavy[5] = 22;
+    heavy[6] = 8;
+    EXPECT_FALSE(aeadParamsSupported(heavy));
+    EXPECT_FALSE(aeadParamsSupported(blob.substr(0, 10)));
+    EXPECT_TRUE(out.empty());
+}
+
+TEST(SecretArena, StoresGrowsAndZeroesOnReset) {
+    SecretArena arena(64);
+    SecretView first = arena.store("sk-first");
+    EXPECT_EQ(first, "sk-first");
+    EXPECT_EQ(first.copy(), std::string("sk-first"));
+
+    // Past the first chunk: earlier views stay valid
+    std::string big(3 * 4096 * 16, 'x');
+    SecretView second = arena.store(big);
+    EXPECT_EQ(second, big);
+    EXPECT_EQ(first, "sk-first");
+    EXPECT_GE(arena.capacity(), arena.used());
+    EXPECT_EQ(arena.used(), big.size() + 8);
+
+    // The first chunk is kept for reuse, with its old contents zeroed
+    const char* old = first.data();
+    arena.reset();
+    EXPECT_EQ(arena.used(), 0u);
+    EXPECT_EQ(std::string(old, 8), std::string(8, '\0'));
+    EXPECT_EQ(arena.store("again").data(), old);
+}
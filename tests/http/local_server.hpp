@@ -0,0 +1,134 @@
+#pragma once
+
+// Keep-alive HTTP/1.1 server on 127.0.0.1 for engine and scheduler tests.
+// Paths containing "/denied" get a 401, "/slow" waits `delayMs` first;
+// everything else is a 200 "ok". Unix only.
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+
+namespace ak {
+namespace tests {
+
+class LocalServer {
+public:
+    explicit LocalServer(bool respond = true, int delayMs = 0)
+        : state_(std::make_shared<State>()) {
+        state_->respond = respond;
+        state_->delayMs = delayMs;
+        fd_ = ::socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        ::bind(fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+        socklen_t len = sizeof(addr);
+        ::getsockname(fd_, reinterpret_cast<sockaddr*>(&addr), &len);
+        port_ = ntohs(addr.sin_port);
+        ::listen(fd_, 64);
+        thread_ = std::thread([this]() { serve(); });
+    }
+
+    ~LocalServer() {
+        ::shutdown(fd_, SHUT_RDWR);
+        ::close(fd_);
+        thread_.join();
+    }
+
+    std::string url(const std::string& path) const {
+        return "http://127.0.0.1:" + std::to_string(port_) + path;
+    }
+
+    int accepted() const { return state_->accepted; }
+    int requests() const { return state_->requests; }
+    int maxConcurrent() const { return state_->maxConcurrent; }
+
+private:
+    // Shared with connection threads, which can outlive the server object
+    // while the client keeps their connections cached
+    struct State {
+        bool respond = true;
+        int delayMs = 0;
+        std::atomic<int> accepted{0};
+        std::atomic<int> requests{0};
+        std::atomic<int> concurrent{0};
+        std::atomic<int> maxConcurrent{0};
+    };
+
+    void serve() {
+        for (;;) {
+            int client = ::accept(fd_, nullptr, nullptr);
+            if (client < 0) {
+                return;
+            }
+            ++state_->accepted;
+            std::thread(handle, client, state_).detach();
+        }
+    }
+
+    static void handle(int client, std::shared_ptr<State> state) {
+        std::string buffer;
+        char chunk[4096];
+        for (;;) {
+            ssize_t n = ::recv(client, chunk, sizeof(chunk), 0);
+            if (n <= 0) {
+                break;
+            }
+            buffer.append(chunk, static_cast<size_t>(n));
+            size_t end;
+            while ((end = buffer.find("\r\n\r\n")) != std::string::npos) {
+                std::string head = buffer.substr(0, end);
+                buffer.erase(0, end + 4);
+                size_t length = 0;
+                size_t cl = head.find("Content-Length: ");
+                if (cl != std::string::npos) {
+                    length = std::stoul(head.substr(cl + 16));
+                }
+                while (buffer.size() < length) {
+                    n = ::recv(client, chunk, sizeof(chunk), 0);
+                    if (n <= 0) {
+                        ::close(client);
+                        return;
+                    }
+                    buffer.append(chunk, static_cast<size_t>(n));
+                }
+                buffer.erase(0, length);
+
+                ++state->requests;
+                if (!state->respond) {
+                    continue;
+                }
+                int now = ++state->concurrent;
+                int seen = state->maxConcurrent;
+                while (now > seen && !state->maxConcurrent.compare_exchange_weak(seen, now)) {
+                }
+                if (head.find("/slow") != std::string::npos) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(state->delayMs));
+                }
+                bool denied = head.find("/denied") != std::string::npos;
+                std::string body = denied ? "{\"error\":\"nope\"}" : "ok";
+                std::string reply = std::string(denied ? "HTTP/1.1 401 Unauthorized" : "HTTP/1.1 200 OK") +
+                    "\r\nContent-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+                --state->concurrent;
+                ::send(client, reply.data(), reply.size(), MSG_NOSIGNAL);
+            }
+        }
+        ::close(client);
+    }
+
+    std::shared_ptr<State> state_;
+    int fd_ = -1;
+    int port_ = 0;
+    std::thread thread_;
+};
+
+} // namespace tests
+} // namespace ak
@@ -0,0 +1,145 @@
+#include "gtest/gtest.h"
+#include "http/http.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+#ifdef __unix__
+#include "local_server.hpp"
+#endif
+
+using namespace ak;
+
+TEST(HttpHeaders, ParsesCurlStyleArguments) {
+    auto headers = http::parseHeaderArgs(
+        "-H 'Accept: application/json' --header \"X-Quote: a \\\"b\\\"\" -H'X-It'\\''s: yes' --compressed");
+    ASSERT_EQ(headers.size(), 3u);
+    EXPECT_EQ(headers[0], "Accept: application/json");
+    EXPECT_EQ(headers[1], "X-Quote: a \"b\"");
+    EXPECT_EQ(headers[2], "X-It's: yes");
+    EXPECT_TRUE(http::parseHeaderArgs("").empty());
+}
+
+TEST(HttpHeaders, CurlArgsAreShellQuoted) {
+    http::Request request;
+    request.method = "POST";
+    request.url = "https://example.com/v1?a=1&b=2";
+    request.headers = {"X-Name: it's"};
+    request.body = "{}";
+    EXPECT_EQ(http::toCurlArgs(request),
+              "-X POST -H 'X-Name: it'\\''s' --data-binary '{}' 'https://example.com/v1?a=1&b=2'");
+}
+
+TEST(HttpTimeouts, DefaultsAndOverrides) {
+    ::unsetenv("AK_HTTP_CONNECT_TIMEOUT");
+    ::unsetenv("AK_HTTP_TIMEOUT");
+    auto timeouts = http::defaultTimeouts();
+    EXPECT_EQ(timeouts.connectMs, 5000);
+    EXPECT_EQ(timeouts.totalMs, 12000);
+
+    ::setenv("AK_HTTP_CONNECT_TIMEOUT", "0.5", 1);
+    ::setenv("AK_HTTP_TIMEOUT", "30", 1);
+    timeouts = http::defaultTimeouts();
+    EXPECT_EQ(timeouts.connectMs, 500);
+    EXPECT_EQ(timeouts.totalMs, 30000);
+    ::unsetenv("AK_HTTP_CONNECT_TIMEOUT");
+    ::unsetenv("AK_HTTP_TIMEOUT");
+
+    EXPECT_EQ(http::formatSeconds(5000), "5");
+    EXPECT_EQ(http::formatSeconds(250), "0.25");
+}
+
+#if defined(__unix__) && defined(AK_HAVE_LIBCURL)
+
+using ak::tests::LocalServer;
+
+TEST(HttpEngine, ReusesConnectionsPerHost) {
+    LocalServer server;
+    http::Request request;
+    request.url = server.url("/ping");
+    for (int i = 0; i < 3; ++i) {
+        auto response = http::perform(request);
+        EXPECT_EQ(response.curlCode, 0) << response.error;
+        EXPECT_EQ(response.status, 200);
+        EXPECT_EQ(response.body, "ok");
+    }
+    EXPECT_EQ(server.accepted(), 1);
+}
+
+TEST(HttpEngine, CapturesResponseHeaders) {
+    LocalServer server;
+    http::Request request;
+    request.url = server.url("/ping");
+    auto response = http::perform(request);
+    ASSERT_EQ(response.status, 200) << response.error;
+    EXPECT_EQ(http::header(response, "content-length"), "2");
+    EXPECT_EQ(http::header(response, "Content-Length"), "2");
+    EXPECT_EQ(http::header(response, "ETag"), "");
+    // The second response on the connection starts a fresh list
+    response = http::perform(request);
+    EXPECT_EQ(response.headers.size(), 1u);
+}
+
+TEST(HttpEngine, ReportsHttpErrors) {
+    LocalServer server;
+    http::Request request;
+    request.url = server.url("/denied");
+    auto response = http::perform(request);
+    EXPECT_EQ(response.curlCode, 0);
+    EXPECT_EQ(response.status, 401);
+    EXPECT_NE(response.body.find("nope"), std::string::npos);
+}
+
+TEST(HttpEngine, HonoursTotalTimeout) {
+    LocalServer server(false);
+    http::Request request;
+    request.url = server.url("/hang");
+    http::Timeouts timeouts;
+    timeouts.totalMs = 200;
+    auto response = http::perform(request, timeouts);
+    EXPECT_EQ(response.curlCode, 28); // CURLE_OPERATION_TIMEDOUT
+    EXPECT_EQ(response.status, 0);
+    EXPECT_FALSE(response.error.empty());
+}
+
+TEST(HttpEngine, ConcurrentCallers) {
+    LocalServer server;
+    http::Request request;
+    request.url = server.url("/ping");
+    std::atomic<int> okCount{0};
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 8; ++i) {
+        threads.emplace_back([&]() {
+            if (http::perform(request).status == 200) {
+                ++okCount;
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    EXPECT_EQ(okCount, 8);
+}
+
+TEST(HttpEngine, CancelAbortsInFlightRequest) {
+    LocalServer server(false);
+    http::Request request;
+    request.url = server.url("/hang");
+    std::atomic<bool> cancel{false};
+    auto started = std::chrono::steady_clock::now();
+    std::thread canceller([&]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        cancel = true;
+        http::interrupt();
+    });
+    auto response = http::perform(request, http::defaultTimeouts(), &cancel);
+    canceller.join();
+    EXPECT_EQ(response.curlCode, 42); // CURLE_ABORTED_BY_CALLBACK
+    EXPECT_EQ(response.error, "Cancelled");
+    EXPECT_LT(std::chrono::steady_clock::now() - started, std::chrono::seconds(2));
+}
+
+#endif
@@ -0,0 +1,218 @@
+#include "gtest/gtest.h"
+#include "libak/ak.h"
+#include "storage/blob_store.hpp"
+#include "storage/vault.hpp"
+#include "core/config.hpp"
+#include "crypto/aead.hpp"
+
+#include <filesystem>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+using namespace ak;
+
+namespace {
+
+// A config directory of its own, written through the storage API the way
+// `ak set` would, and read back through the C API
+class LibakTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        std::random_device rd;
+        root = fs::temp_directory_path() / ("ak_test_" + std::to_string(rd()));
+        fs::create_directories(root);
+    }
+
+    void TearDown() override {
+        std::error_code ec;
+        fs::remove_all(root, ec);
+    }
+
+    core::Config configFor(const std::string& backend, const std::string& passphrase = "") {
+        core::Config cfg = storage::loadConfig(root.string());
+        cfg.backend = backend;
+        cfg.presetPassphrase = passphrase;
+        return cfg;
+    }
+
+    ak_options optionsFor(const char* backend, const char* passphrase = nullptr) {
+        configDir = root.string();
+        return ak_options{configDir.c_str(), passphrase, backend};
+    }
+
+    fs::path root;
+    std::string configDir;
+};
+
+} // namespace
+
+TEST_F(LibakTest, GetManyAndIterate) {
+    storage::saveProfileKeys(configFor("plain"), "default",
+                             {{"OPENAI_API_KEY", "sk-one"}, {"MULTI", "line1\nline2"}, {"ANTHROPIC_API_KEY", "sk-two"}});
+    ak_options options = optionsFor("plain");
+    ak_vault* vault = nullptr;
+    ASSERT_EQ(ak_open(&options, &vault), AK_OK);
+
+    char* value = nullptr;
+    size_t length = 0;
+    ASSERT_EQ(ak_get(vault, nullptr, "MULTI", &value, &length), AK_OK);
+    EXPECT_EQ(std::string(value, length), "line1\nline2");
+    EXPECT_EQ(value[length], '\0');
+    ak_free_secret(value);
+    EXPECT_EQ(ak_get(vault, "default", "MISSING", &value, &length), AK_ERR_NOT_FOUND);
+    EXPECT_EQ(value, nullptr);
+    EXPECT_EQ(ak_get(vault, "../default", "MULTI", &value, &length), AK_ERR_INVALID);
+
+    const char* names[] = {"OPENAI_API_KEY", "MISSING", "ANTHROPIC_API_KEY"};
+    char* values[3];
+    size_t lengths[3];
+    ASSERT_EQ(ak_get_many(vault, "default", names, 3, values, lengths), AK_OK);
+    EXPECT_STREQ(values[0], "sk-one");
+    EXPECT_EQ(values[1], nullptr);
+    EXPECT_EQ(lengths[1], 0u);
+    EXPECT_STREQ(values[2], "sk-two");
+    for (char* v : values) {
+        ak_free_secret(v);
+    }
+
+    ak_iter* iter = nullptr;
+    ASSERT_EQ(ak_iter_open(vault, "default", &iter), AK_OK);
+    // Unlocked once: a later write is only seen after ak_reload
+    storage::saveProfileKeys(configFor("plain"), "default", {{"OPENAI_API_KEY", "sk-rotated"}});
+    ASSERT_EQ(ak_get(vault, nullptr, "OPENAI_API_KEY", &value, &length), AK_OK);
+    EXPECT_STREQ(value, "sk-one");
+    ak_free_secret(value);
+    ASSERT_EQ(ak_reload(vault, nullptr), AK_OK);
+    ASSERT_EQ(ak_get(vault, nullptr, "OPENAI_API_KEY", &value, &length), AK_OK);
+    EXPECT_STREQ(value, "sk-rotated");
+    ak_free_secret(value);
+    ak_close(vault);
+
+    // The iterator keeps the table it was opened on
+    std::vector<std::string> seen;
+    const char* name = nullptr;
+    size_t nameLength = 0;
+    const char* data = nullptr;
+    size_t dataLength = 0;
+    while (ak_iter_next(iter, &name, &nameLength, &data, &dataLength)) {
+        seen.push_back(std::string(name, nameLength) + "=" + std::string(data, dataLength));
+    }
+    ak_iter_close(iter);
+    EXPECT_EQ(seen, (std::vector<std::string>{"ANTHROPIC_API_KEY=sk-two", "MULTI=line1\nline2", "OPENAI_API_KEY=sk-one"}));
+}
+
+TEST_F(LibakTest, EncryptedProfileNeedsPassphrase) {
+    if (!crypto::aeadAvailable()) {
+        GTEST_SKIP() << "built without OpenSSL";
+    }
+    storage::saveProfileKeys(configFor("aead", "right"), "prod", {{"DB_PASSWORD", "hunter2"}});
+
+    ak_vault* vault = nullptr;
+    char* value = nullptr;
+    ak_options wrong = optionsFor("aead", "wrong");
+    ASSERT_EQ(ak_open(&wrong, &vault), AK_OK);
+    EXPECT_EQ(ak_get(vault, "prod", "DB_PASSWORD", &value, nullptr), AK_ERR_DECRYPT);
+    ak_close(vault);
+
+    ak_options right = optionsFor("aead", "right");
+    ASSERT_EQ(ak_open(&right, &vault), AK_OK);
+    ASSERT_EQ(ak_get(vault, "prod", "DB_PASSWORD", &value, nullptr), AK_OK);
+    EXPECT_STREQ(value, "hunter2");
+    ak_free_secret(value);
+    ak_close(vault);
+}
+
+TEST_F(LibakTest, BlobValuesAreReadFromTheBlobStore) {
+    if (!crypto::aeadAvailable()) {
+        GTEST_SKIP() << "built without OpenSSL";
+    }
+    core::Config cfg = configFor("aead", "pw");
+    std::string big(storage::BLOB_CHUNK_SIZE + 7, 'b');
+    std::istringstream in(big);
+    storage::BlobRef ref = storage::BlobStore(cfg, "pw").put(in);
+    storage::BlobRef gone = ref;
+    gone.id = std::string(32, '0');
+    storage::saveProfileKeys(cfg, "certs", {{"BUNDLE", storage::formatBlobRef(ref)},
+                                            {"GONE", storage::formatBlobRef(gone)},
+                                            {"TOKEN", "t"}});
+    ak_options options = optionsFor("aead", "pw");
+    ak_vault* vault = nullptr;
+    ASSERT_EQ(ak_open(&options, &vault), AK_OK);
+
+    char* value = nullptr;
+    size_t length = 0;
+    ASSERT_EQ(ak_get(vault, "certs", "BUNDLE", &value, &length), AK_OK);
+    EXPECT_EQ(std::string(value, length), big);
+    ak_free_secret(value);
+    EXPECT_EQ(ak_get(vault, "certs", "GONE", &value, &length), AK_ERR_DECRYPT);
+    EXPECT_EQ(value, nullptr);
+
+    const char* names[] = {"TOKEN", "BUNDLE"};
+    char* values[2];
+    size_t lengths[2];
+    ASSERT_EQ(ak_get_many(vault, "certs", names, 2, values, lengths), AK_OK);
+    EXPECT_STREQ(values[0], "t");
+    EXPECT_EQ(lengths[1], big.size());
+    for (char* v : values) {
+        ak_free_secret(v);
+    }
+
+    ak_iter* iter = nullptr;
+    ASSERT_EQ(ak_iter_open(vault, "certs", &iter), AK_OK);
+    ak_close(vault);
+    std::map<std::string, std::string> seen;
+    const char* name = nullptr;
+    size_t nameLength = 0;
+    const char* data = nullptr;
+    size_t dataLength = 0;
+    while (ak_iter_next(iter, &name, &nameLength, &data, &dataLength)) {
+        seen[std::string(name, nameLength)] = std::string(data, dataLength);
+    }
+    ak_iter_close(iter);
+    EXPECT_EQ(seen, (std::map<std::string, std::string>{{"BUNDLE", big}, {"TOKEN", "t"}}));
+}
+
+TEST_F(LibakTest, HandleIsSharedAcrossThreads) {
+    std::map<std::string, std::string> keys;
+    for (int i = 0; i < 50; ++i) {
+        keys["KEY_" + std::to_string(i)] = "value-" + std::to_string(i);
+    }
+    for (const char* profile : {"a", "b"}) {
+        storage::saveProfileKeys(configFor("plain"), profile, keys);
+    }
+    ak_options options = optionsFor("plain");
+    ak_vault* vault = nullptr;
+    ASSERT_EQ(ak_open(&options, &vault), AK_OK);
+
+    std::vector<std::thread> threads;
+    std::vector<int> failures(8, 0);
+    for (int t = 0; t < 8; ++t) {
+        threads.emplace_back([&, t] {
+            const char* profile = t % 2 ? "a" : "b";
+            for (int i = 0; i < 200; ++i) {
+                std::string name = "KEY_" + std::to_string(i % 50);
+                char* value = nullptr;
+                if (ak_get(vault, profile, name.c_str(), &value, nullptr) != AK_OK ||
+                    std::string(value) != "value-" + std::to_string(i % 50)) {
+                    ++failures[t];
+                }
+                ak_free_secret(value);
+                if (i == 100 && t == 0) {
+                    ak_reload(vault, nullptr);
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    ak_close(vault);
+    for (int f : failures) {
+        EXPECT_EQ(f, 0);
+    }
+}
@@ -1,7 +1,23 @@
 #include "gtest/gtest.h"
 #include "services/services.hpp"
+#include "services/test_cache.hpp"
+#include "services/monitor.hpp"
 #include "core/config.hpp" // Required for ak::core::Config
+#include "storage/vault.hpp"
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <set>
+#include <thread>
+
+#if defined(__unix__) && defined(AK_HAVE_LIBCURL)
+#include "../http/local_server.hpp"
+#endif
 
 using namespace ak::services;
 
@@ -159,3 +175,465 @@ TEST(RunTestsParallelFunction, ShouldRespectFailFastFlag) {
     ASSERT_LE(results1.size(), services.size());
     ASSERT_LE(results2.size(), services.size());
 }
+
+TEST(TestScheduler, HostForService) {
+    std::map<std::string, Service> services = DEFAULT_SERVICES;
+    services["mine"] = Service("mine", "MINE_KEY", "", "https://user@API.Example.com:8443/v1?q=1", "GET", "", "Bearer", true);
+    EXPECT_EQ(testHostFor(services, "mine"), "api.example.com:8443");
+    EXPECT_EQ(testHostFor(services, "openai"), "api.openai.com");
+    EXPECT_EQ(testHostFor(services, "groq"), "");  // key presence only
+    EXPECT_EQ(testHostFor(services, "missing"), "");
+}
+
+TEST(BuiltinRegistry, PerfectHashFindsEveryService) {
+    EXPECT_EQ(builtinServices().size(), DEFAULT_SERVICES.size());
+    for (const auto& builtin : builtinServices()) {
+        const BuiltinService* found = findBuiltinService(builtin.name);
+        ASSERT_EQ(found, &builtin) << builtin.name;
+        EXPECT_EQ(DEFAULT_SERVICES.at(std::string(builtin.name)).keyName, builtin.keyName);
+    }
+    EXPECT_EQ(findBuiltinService("mine"), nullptr);
+    EXPECT_EQ(findBuiltinService(""), nullptr);
+    EXPECT_EQ(findBuiltinService("OPENAI"), nullptr);
+
+    Service discord = makeService(*findBuiltinService("discord"));
+    EXPECT_EQ(discord.authMethod, "Bot");
+    EXPECT_EQ(discord.generateUrl, "https://discord.com/developers/applications");
+    EXPECT_TRUE(discord.isBuiltIn);
+}
+
+TEST(BuiltinRegistry, DetectsProviderByLongestPrefix) {
+    EXPECT_EQ(detectProviderFromKey("sk-proj-abcdefghijklmnopqrstuvwxyz"), "openai");
+    EXPECT_EQ(detectProviderFromKey("sk-short"), "");
+    EXPECT_EQ(detectProviderFromKey("sk-ant-REDACTED"), "anthropic");
+    EXPECT_EQ(detectProviderFromKey("sk-ant-x"), "anthropic");
+    EXPECT_EQ(detectProviderFromKey("sk-or-v1-abcdefghijklmnopqrstuvwxyz"), "openrouter");
+    EXPECT_EQ(detectProviderFromKey("sk_live_123"), "stripe");
+    EXPECT_EQ(detectProviderFromKey("github_pat_11AAAA"), "github");
+    EXPECT_EQ(detectProviderFromKey("ghs_abc"), "github");
+    EXPECT_EQ(detectProviderFromKey("xoxp-1-2"), "slack");
+    EXPECT_EQ(detectProviderFromKey("mistral-key"), "mistral");
+    EXPECT_EQ(detectProviderFromKey("lsv2_pt_x"), "langchain");
+    EXPECT_EQ(detectProviderFromKey(std::string(40, 'a')), "cohere");
+    EXPECT_EQ(detectProviderFromKey(std::string(64, 'b')), "together");
+    EXPECT_EQ(detectProviderFromKey("tok-vercel-1"), "vercel");
+    EXPECT_EQ(detectProviderFromKey("nothing-known"), "");
+    EXPECT_EQ(detectProviderFromKey(""), "");
+}
+
+TEST(ServiceRegistryCache, ReloadsOnlyWhenUserServicesChange) {
+    std::random_device rd;
+    auto root = std::filesystem::temp_directory_path() / ("ak_registry_" + std::to_string(rd()));
+    ak::core::Config cfg;
+    cfg.configDir = root.string();
+
+    auto first = loadAllServicesCached(cfg);
+    EXPECT_EQ(first->size(), DEFAULT_SERVICES.size());
+    EXPECT_EQ(loadAllServicesCached(cfg), first);
+
+    addService(cfg, Service("mine", "MINE_KEY", "Mine", "https://example.com", "GET", "", "Bearer", true));
+    auto added = loadAllServicesCached(cfg);
+    EXPECT_NE(added, first);
+    ASSERT_TRUE(added->count("mine"));
+    EXPECT_FALSE(added->at("mine").isBuiltIn);
+    EXPECT_EQ(loadAllServicesCached(cfg), added);
+
+    // Edited behind our back
+    {
+        std::ofstream out(root / "user_services.txt", std::ios::app);
+        out << "[SERVICE]\nname=other\nkey_name=OTHER_KEY\n";
+    }
+    auto edited = loadAllServicesCached(cfg);
+    EXPECT_TRUE(edited->count("other"));
+    EXPECT_TRUE(edited->count("mine"));
+
+    std::filesystem::remove_all(root);
+    EXPECT_EQ(loadAllServicesCached(cfg)->size(), DEFAULT_SERVICES.size());
+}
+
+TEST(TestResultJson, EscapesAndOmitsEmptyFields) {
+    TestResult result;
+    result.service = "openai";
+    result.ok = false;
+    result.duration = std::chrono::milliseconds(42);
+    result.http_status = 401;
+    result.error_message = "bad \"key\"\n";
+    EXPECT_EQ(toJsonLine(result),
+              "{\"service\":\"openai\",\"ok\":false,\"duration_ms\":42,\"http_status\":401,"
+              "\"error\":\"bad \\\"key\\\"\\n\"}");
+
+    result.profile = "work";
+    result.ok = true;
+    result.http_status = 0;
+    result.error_message.clear();
+    EXPECT_EQ(toJsonLine(result), "{\"service\":\"openai\",\"profile\":\"work\",\"ok\":true,\"duration_ms\":42}");
+
+    result.cached = true;
+    EXPECT_EQ(toJsonLine(result),
+              "{\"service\":\"openai\",\"profile\":\"work\",\"ok\":true,\"duration_ms\":42,\"cached\":true}");
+}
+
+TEST(TestResultCacheTest, ParsesMaxAge) {
+    EXPECT_EQ(parseMaxAge("90"), 90);
+    EXPECT_EQ(parseMaxAge("30s"), 30);
+    EXPECT_EQ(parseMaxAge("15m"), 900);
+    EXPECT_EQ(parseMaxAge("2h"), 7200);
+    EXPECT_EQ(parseMaxAge("1d"), 86400);
+    EXPECT_EQ(parseMaxAge(""), -1);
+    EXPECT_EQ(parseMaxAge("h"), -1);
+    EXPECT_EQ(parseMaxAge("5w"), -1);
+    EXPECT_EQ(parseMaxAge("-5"), -1);
+}
+
+TEST(TestResultCacheTest, PersistsByKeyHash) {
+    std::random_device rd;
+    auto root = std::filesystem::temp_directory_path() / ("ak_tcache_" + std::to_string(rd()));
+    ak::core::Config cfg;
+    cfg.persistDir = (root / "persist").string();
+    cfg.instanceId = "instance";
+
+    TestResult ok;
+    ok.service = "openai";
+    ok.ok = true;
+    ok.http_status = 200;
+    ok.duration = std::chrono::milliseconds(120);
+    ok.curl_command = "curl ...";
+    TestResult flaky = ok;
+    flaky.ok = false;
+    flaky.http_status = 503;
+    TestResult denied = flaky;
+    denied.http_status = 401;
+    denied.error_message = "HTTP 401:\tnope";
+    TestResult keyOnly = ok;
+    keyOnly.curl_command.clear();
+
+    {
+        TestResultCache cache(cfg);
+        cache.store("openai", "sk-one", ok);
+        cache.store("groq", "gsk-two", flaky);       // transient: not kept
+        cache.store("mistral", "m-three", denied);
+        cache.store("brave", "b-four", keyOnly);     // no request made
+        cache.save();
+    }
+
+    // Stored under a salted hash, never the key itself
+    std::ifstream in(TestResultCache::path(cfg));
+    std::string contents((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    EXPECT_EQ(contents.find("sk-one"), std::string::npos);
+
+    TestResultCache cache(cfg);
+    TestResult hit;
+    ASSERT_TRUE(cache.lookup("openai", "sk-one", 60, hit));
+    EXPECT_TRUE(hit.ok);
+    EXPECT_TRUE(hit.cached);
+    EXPECT_EQ(hit.http_status, 200);
+    EXPECT_EQ(hit.duration.count(), 120);
+    EXPECT_FALSE(cache.lookup("openai", "sk-rotated", 60, hit));
+    EXPECT_FALSE(cache.lookup("groq", "gsk-two", 60, hit));
+    EXPECT_FALSE(cache.lookup("brave", "b-four", 60, hit));
+    ASSERT_TRUE(cache.lookup("mistral", "m-three", -1, hit));
+    EXPECT_FALSE(hit.ok);
+    EXPECT_EQ(hit.error_message, "HTTP 401:\tnope");
+
+    // A different instance salt cannot match the entries
+    cfg.instanceId = "other";
+    EXPECT_FALSE(TestResultCache(cfg).lookup("openai", "sk-one", 60, hit));
+
+    std::error_code ec;
+    std::filesystem::remove_all(root, ec);
+}
+
+TEST(TestResultCacheTest, ParallelSavesKeepEachOthersEntries) {
+    std::random_device rd;
+    auto root = std::filesystem::temp_directory_path() / ("ak_tcache_" + std::to_string(rd()));
+    ak::core::Config cfg;
+    cfg.persistDir = (root / "persist").string();
+    cfg.instanceId = "instance";
+    TestResult ok;
+    ok.ok = true;
+    ok.http_status = 200;
+    ok.curl_command = "curl ...";
+
+    // Like parallel CI runs: each loaded the file before any of them saved
+    std::vector<std::unique_ptr<TestResultCache>> runs;
+    for (int r = 0; r < 6; ++r) {
+        runs.push_back(std::make_unique<TestResultCache>(cfg));
+        for (int k = 0; k < 5; ++k) {
+            runs.back()->store("svc" + std::to_string(r), "key" + std::to_string(k), ok);
+        }
+    }
+    std::vector<std::thread> threads;
+    for (auto& run : runs) {
+        threads.emplace_back([&run] { run->save(); });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    TestResultCache cache(cfg);
+    TestResult hit;
+    for (int r = 0; r < 6; ++r) {
+        for (int k = 0; k < 5; ++k) {
+            EXPECT_TRUE(cache.lookup("svc" + std::to_string(r), "key" + std::to_string(k), -1, hit)) << r << " " << k;
+        }
+    }
+#ifdef __unix__
+    auto perms = std::filesystem::status(TestResultCache::path(cfg)).permissions();
+    EXPECT_EQ(perms & (std::filesystem::perms::group_all | std::filesystem::perms::others_all),
+              std::filesystem::perms::none);
+#endif
+
+    std::error_code ec;
+    std::filesystem::remove_all(root, ec);
+}
+
+namespace {
+
+TestResult monitorResult(const std::string& service, bool ok, int httpStatus = 0) {
+    TestResult result{};
+    result.service = service;
+    result.ok = ok;
+    result.http_status = httpStatus;
+    return result;
+}
+
+} // namespace
+
+TEST(MonitorScheduleTest, BacksOffThrottledAndRelaxesHealthyKeys) {
+    using namespace std::chrono;
+    MonitorPolicy policy;
+    policy.healthyInterval = seconds(300);
+    policy.failingInterval = seconds(60);
+    policy.backoffBase = seconds(30);
+    policy.maxBackoff = seconds(100);
+    policy.jitter = 0;
+    auto t0 = MonitorSchedule::Clock::now();
+    MonitorSchedule monitor({{"openai", ""}, {"groq", ""}, {"brave", ""}}, policy, t0, 1);
+    EXPECT_EQ(monitor.due(t0).size(), 3u);
+
+    TestResult ok = monitorResult("openai", true);
+    TestResult denied = monitorResult("groq", false, 401);
+    TestResult limited = monitorResult("brave", false, 429);
+
+    EXPECT_TRUE(monitor.record(0, ok, t0));
+    EXPECT_TRUE(monitor.record(1, denied, t0));
+    EXPECT_TRUE(monitor.record(2, limited, t0));
+    EXPECT_EQ(monitor.state(0).next - t0, seconds(300));
+    EXPECT_EQ(monitor.state(1).next - t0, seconds(60));
+    EXPECT_EQ(monitor.state(2).next - t0, seconds(30));
+    EXPECT_EQ(monitor.nextWake(), t0 + seconds(30));
+    EXPECT_EQ(monitor.due(t0 + seconds(59)), std::vector<size_t>{2});
+    EXPECT_EQ(monitor.due(t0 + seconds(60)), (std::vector<size_t>{2, 1}));
+
+    // Repeats only reschedule; throttling doubles up to the cap
+    EXPECT_FALSE(monitor.record(2, limited, t0));
+    EXPECT_EQ(monitor.state(2).next - t0, seconds(60));
+    TestResult unavailable = limited;
+    unavailable.http_status = 503;
+    EXPECT_FALSE(monitor.record(2, unavailable, t0));
+    EXPECT_EQ(monitor.state(2).next - t0, seconds(100));
+    EXPECT_EQ(monitor.state(2).consecutive, 3);
+
+    TestResult recovered = monitorResult("brave", true);
+    EXPECT_TRUE(monitor.record(2, recovered, t0));
+    EXPECT_EQ(monitor.state(2).health, KeyHealth::Healthy);
+    EXPECT_EQ(monitor.state(2).consecutive, 1);
+
+    // Jitter stays within its band
+    policy.jitter = 0.1;
+    MonitorSchedule jittered({{"openai", ""}}, policy, t0, 7);
+    for (int i = 0; i < 50; ++i) {
+        jittered.record(0, ok, t0);
+        auto delay = jittered.state(0).next - t0;
+        EXPECT_GE(delay, seconds(270));
+        EXPECT_LE(delay, seconds(330));
+    }
+}
+
+TEST(MonitorScheduleTest, ClassifiesOutcomes) {
+    TestResult result = monitorResult("openai", false);
+    result.exit_code = 28; // timeout, no response
+    EXPECT_EQ(classifyHealth(result), KeyHealth::Throttled);
+    result.exit_code = 0;
+    result.http_status = 403;
+    EXPECT_EQ(classifyHealth(result), KeyHealth::Failing);
+    result.http_status = 502;
+    EXPECT_EQ(classifyHealth(result), KeyHealth::Throttled);
+    result.ok = true;
+    EXPECT_EQ(classifyHealth(result), KeyHealth::Healthy);
+    EXPECT_STREQ(healthName(KeyHealth::Throttled), "throttled");
+}
+
+#if defined(__unix__) && defined(AK_HAVE_LIBCURL)
+
+namespace {
+
+// Custom services pointing at a local server, keys in a plain default profile
+class TestSchedulerLocal : public ::testing::Test {
+protected:
+    void SetUp() override {
+        std::random_device rd;
+        root = std::filesystem::temp_directory_path() / ("ak_sched_" + std::to_string(rd()));
+        std::filesystem::create_directories(root);
+        cfg.configDir = root.string();
+        cfg.profilesDir = (root / "profiles").string();
+        cfg.persistDir = (root / "persist").string();
+        cfg.vaultPath = (root / "keys.env").string();
+        cfg.forcePlain = true;
+    }
+
+    void TearDown() override {
+        ak::storage::clearProfileKeysCache();
+        std::error_code ec;
+        std::filesystem::remove_all(root, ec);
+    }
+
+    std::vector<TestJob> addServices(const ak::tests::LocalServer& server, const std::vector<std::string>& paths) {
+        std::map<std::string, std::string> keys;
+        std::vector<TestJob> jobs;
+        for (size_t i = 0; i < paths.size(); ++i) {
+            std::string name = "local" + std::to_string(i);
+            std::string keyName = "LOCAL" + std::to_string(i) + "_KEY";
+            addService(cfg, Service(name, keyName, "", server.url(paths[i]), "GET", "", "Bearer", true));
+            keys[keyName] = "secret";
+            jobs.push_back({name, ""});
+        }
+        ak::storage::saveProfileKeys(cfg, "default", keys);
+        return jobs;
+    }
+
+    std::filesystem::path root;
+    ak::core::Config cfg;
+};
+
+} // namespace
+
+TEST_F(TestSchedulerLocal, StreamsEveryResultWithinHostLimit) {
+    ak::tests::LocalServer server(true, 100);
+    auto jobs = addServices(server, std::vector<std::string>(6, "/slow"));
+
+    TestSchedule schedule;
+    schedule.workers = 6;
+    schedule.perHost = 2;
+    std::set<std::string> seen;
+    auto results = run_test_jobs(cfg, jobs, schedule, [&](const TestJob& job, const TestResult& result) {
+        EXPECT_EQ(job.service, result.service);
+        seen.insert(result.service);
+    });
+
+    ASSERT_EQ(results.size(), 6u);
+    EXPECT_EQ(seen.size(), 6u);
+    for (const auto& result : results) {
+        EXPECT_TRUE(result.ok) << result.service << ": " << result.error_message;
+    }
+    EXPECT_LE(server.maxConcurrent(), 2);
+}
+
+TEST_F(TestSchedulerLocal, ObserverSeesStartsAndExternalCancel) {
+    ak::tests::LocalServer server(true, 3000);
+    auto jobs = addServices(server, std::vector<std::string>(4, "/slow"));
+
+    std::atomic<bool> cancel{false};
+    std::atomic<int> started{0};
+    TestSchedule schedule;
+    schedule.workers = 2;
+    schedule.cancel = &cancel;
+    std::thread stopper([&]() {
+        while (started < 2) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        cancelTests(cancel);
+    });
+
+    auto begin = std::chrono::steady_clock::now();
+    int delivered = 0;
+    auto results = run_test_jobs(cfg, jobs, schedule,
+        [&](const TestJob&, const TestResult&) { ++delivered; },
+        [&](const TestJob&) { ++started; });
+    stopper.join();
+
+    EXPECT_EQ(started, 2);
+    EXPECT_EQ(delivered, 0);  // both in-flight checks were aborted
+    EXPECT_TRUE(results.empty());
+    EXPECT_LT(std::chrono::steady_clock::now() - begin, std::chrono::seconds(2));
+}
+
+TEST_F(TestSchedulerLocal, FailFastCancelsRemainingWork) {
+    ak::tests::LocalServer server(true, 3000);
+    std::vector<std::string> paths(8, "/slow");
+    paths[0] = "/denied";
+    auto jobs = addServices(server, paths);
+
+    TestSchedule schedule;
+    schedule.workers = 2;
+    schedule.perHost = 2;
+    schedule.failFast = true;
+    auto started = std::chrono::steady_clock::now();
+    auto results = run_test_jobs(cfg, jobs, schedule);
+    auto elapsed = std::chrono::steady_clock::now() - started;
+
+    ASSERT_FALSE(results.empty());
+    EXPECT_FALSE(results.back().ok);
+    EXPECT_EQ(results.back().service, "local0");
+    EXPECT_LT(elapsed, std::chrono::seconds(2));
+    EXPECT_LT(server.requests(), 8);
+}
+
+TEST_F(TestSchedulerLocal, CachedResultsSkipTheNetwork) {
+    ak::tests::LocalServer server;
+    auto jobs = addServices(server, {"/ping", "/denied"});
+
+    TestSchedule schedule;
+    schedule.useCache = true;
+    auto first = run_test_jobs(cfg, jobs, schedule);
+    ASSERT_EQ(first.size(), 2u);
+    EXPECT_EQ(server.requests(), 2);
+
+    auto second = run_test_jobs(cfg, jobs, schedule);
+    ASSERT_EQ(second.size(), 2u);
+    EXPECT_EQ(server.requests(), 2);
+    for (const auto& result : second) {
+        EXPECT_TRUE(result.cached);
+        EXPECT_EQ(result.ok, result.service == "local0");
+    }
+
+    schedule.refreshCache = true;
+    auto refreshed = run_test_jobs(cfg, jobs, schedule);
+    EXPECT_EQ(server.requests(), 4);
+    EXPECT_FALSE(refreshed.front().cached);
+
+    // Rotating the key invalidates its entry
+    schedule.refreshCache = false;
+    ak::storage::saveProfileKeys(cfg, "default", {{"LOCAL0_KEY", "rotated"}, {"LOCAL1_KEY", "secret"}});
+    run_test_jobs(cfg, jobs, schedule);
+    EXPECT_EQ(server.requests(), 5);
+}
+
+TEST_F(TestSchedulerLocal, ChangedKeyGetsAFreshCheck) {
+    ak::tests::LocalServer server;
+    auto jobs = addServices(server, {"/ping"});
+    TestSchedule schedule;
+    schedule.useCache = true;
+    ASSERT_EQ(run_test_jobs(cfg, jobs, schedule).size(), 1u);
+    EXPECT_EQ(server.requests(), 1);
+
+    ak::storage::saveProfileKeys(cfg, "default", {{"LOCAL0_KEY", "changed"}});
+    auto fresh = run_test_jobs(cfg, jobs, schedule);
+    ASSERT_EQ(fresh.size(), 1u);
+    EXPECT_FALSE(fresh[0].cached);
+    EXPECT_EQ(server.requests(), 2);
+
+    // Another profile's key for the same service keeps its own entry
+    ak::storage::writeProfile(cfg, "work", {"LOCAL0_KEY"});
+    ak::storage::saveProfileKeys(cfg, "work", {{"LOCAL0_KEY", "work-secret"}});
+    std::vector<TestJob> both = {{"local0", ""}, {"local0", "work"}};
+    run_test_jobs(cfg, both, schedule);
+    EXPECT_EQ(server.requests(), 3);
+    for (const auto& result : run_test_jobs(cfg, both, schedule)) {
+        EXPECT_TRUE(result.cached) << result.profile;
+    }
+    EXPECT_EQ(server.requests(), 3);
+}
+
+#endif
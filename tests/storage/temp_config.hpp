@@ -0,0 +1,50 @@
+#pragma once
+
+// Plain-mode config rooted in a fresh temp directory, with the shared
+// profile-key cache cleared around each test. Feature fixtures derive from
+// it so each suite names its own fixture without repeating the setup.
+
+#include "gtest/gtest.h"
+#include "core/config.hpp"
+#include "storage/vault.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+
+namespace ak {
+namespace tests {
+
+class TempConfigTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        std::random_device rd;
+        root = std::filesystem::temp_directory_path() / ("ak_test_" + std::to_string(rd()));
+        std::filesystem::create_directories(root);
+        cfg.configDir = root.string();
+        cfg.profilesDir = (root / "profiles").string();
+        cfg.persistDir = (root / "persist").string();
+        cfg.vaultPath = (root / "keys.env").string();
+        cfg.forcePlain = true;
+        storage::clearProfileKeysCache();
+    }
+
+    void TearDown() override {
+        storage::clearProfileKeysCache();
+        std::error_code ec;
+        std::filesystem::remove_all(root, ec);
+    }
+
+    std::filesystem::path root;
+    core::Config cfg;
+};
+
+inline std::string readFile(const std::filesystem::path& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+}
+
+} // namespace tests
+} // namespace ak
@@ -0,0 +1,1377 @@
+#include "gtest/gtest.h"
+#include "temp_config.hpp"
+#include "storage/vault.hpp"
+#include "storage/importer.hpp"
+#include "storage/completion_index.hpp"
+#include "storage/search_index.hpp"
+#include "storage/metadata_cache.hpp"
+#include "storage/profile_index.hpp"
+#include "storage/transaction.hpp"
+#include "storage/content_store.hpp"
+#include "storage/blob_store.hpp"
+#include "storage/rekey.hpp"
+#include "storage/remote.hpp"
+#include "core/config.hpp"
+#include "system/system.hpp"
+#include "crypto/aead.hpp"
+#include "crypto/crypto.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <map>
+#include <random>
+#include <set>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+using namespace ak;
+
+namespace {
+
+using tests::readFile;
+
+// One fixture per feature, all on a fresh plain-mode config
+class ProfileKeysCacheTest : public tests::TempConfigTest {};
+class DirBundleTest : public tests::TempConfigTest {};
+class ProfileLogTest : public tests::TempConfigTest {};
+class ContentStoreTest : public tests::TempConfigTest {};
+class TransactionTest : public tests::TempConfigTest {};
+class ProfileIndexTest : public tests::TempConfigTest {};
+class MetadataCacheTest : public tests::TempConfigTest {};
+class CompletionIndexTest : public tests::TempConfigTest {};
+class KeySearchIndexTest : public tests::TempConfigTest {};
+class BlobStoreTest : public tests::TempConfigTest {};
+class RekeyTest : public tests::TempConfigTest {};
+class SyncTest : public tests::TempConfigTest {};
+
+} // namespace
+
+TEST_F(ProfileKeysCacheTest, PlainRoundTrip) {
+    storage::saveProfileKeys(cfg, "dev", {{"OPENAI_API_KEY", "sk-test"}, {"EMPTY", ""}});
+    auto keys = storage::loadProfileKeys(cfg, "dev");
+    ASSERT_EQ(keys.size(), 2u);
+    EXPECT_EQ(keys["OPENAI_API_KEY"], "sk-test");
+    EXPECT_EQ(keys["EMPTY"], "");
+}
+
+TEST_F(ProfileKeysCacheTest, MissingProfileIsEmpty) {
+    auto keys = storage::loadProfileKeysCached(cfg, "nope");
+    ASSERT_NE(keys, nullptr);
+    EXPECT_TRUE(keys->empty());
+}
+
+TEST_F(ProfileKeysCacheTest, RepeatedLoadsShareOneDecode) {
+    storage::saveProfileKeys(cfg, "dev", {{"A", "1"}});
+    storage::clearProfileKeysCache();
+
+    auto first = storage::loadProfileKeysCached(cfg, "dev");
+    auto second = storage::loadProfileKeysCached(cfg, "dev");
+    EXPECT_EQ(first.get(), second.get());
+    EXPECT_EQ(first->at("A"), "1");
+}
+
+TEST_F(ProfileKeysCacheTest, ConcurrentLoadsShareOneDecode) {
+    storage::saveProfileKeys(cfg, "dev", {{"A", "1"}, {"B", "2"}});
+    storage::clearProfileKeysCache();
+
+    std::vector<std::future<storage::ProfileKeysPtr>> futures;
+    for (int i = 0; i < 16; ++i) {
+        futures.push_back(std::async(std::launch::async, [this]() {
+            return storage::loadProfileKeysCached(cfg, "dev");
+        }));
+    }
+    auto expected = futures.front().get();
+    for (size_t i = 1; i < futures.size(); ++i) {
+        EXPECT_EQ(futures[i].get().get(), expected.get());
+    }
+    EXPECT_EQ(expected->size(), 2u);
+}
+
+TEST_F(ProfileKeysCacheTest, SaveRefreshesCache) {
+    storage::saveProfileKeys(cfg, "dev", {{"A", "1"}});
+    auto before = storage::loadProfileKeysCached(cfg, "dev");
+    storage::saveProfileKeys(cfg, "dev", {{"A", "2"}});
+    auto after = storage::loadProfileKeysCached(cfg, "dev");
+    EXPECT_EQ(before->at("A"), "1");
+    EXPECT_EQ(after->at("A"), "2");
+}
+
+TEST_F(ProfileKeysCacheTest, ExternalChangeIsDetected) {
+    storage::saveProfileKeys(cfg, "dev", {{"A", "1"}});
+    auto before = storage::loadProfileKeysCached(cfg, "dev");
+
+    // Rewrite the file behind the cache's back with a different size
+    {
+        std::ofstream out(fs::path(cfg.profilesDir) / "dev.keys", std::ios::trunc);
+        out << "A=MjI=\n"; // "22"
+    }
+    auto after = storage::loadProfileKeysCached(cfg, "dev");
+    EXPECT_EQ(before->at("A"), "1");
+    EXPECT_EQ(after->at("A"), "22");
+}
+
+TEST_F(ProfileKeysCacheTest, AeadBackendRoundTrip) {
+    if (!crypto::aeadAvailable()) {
+        GTEST_SKIP() << "built without OpenSSL";
+    }
+    cfg.forcePlain = false;
+    cfg.backend = "aead";
+    cfg.presetPassphrase = "test-passphrase";
+    ASSERT_EQ(storage::activeBackend(cfg), storage::Backend::Aead);
+
+    storage::saveProfileKeys(cfg, "dev", {{"OPENAI_API_KEY", "sk-secret"}});
+    auto path = fs::path(cfg.profilesDir) / "dev.keys.akv";
+    ASSERT_TRUE(fs::exists(path));
+    {
+        std::ifstream in(path, std::ios::binary);
+        std::string raw((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        EXPECT_EQ(raw.find("OPENAI_API_KEY"), std::string::npos);
+    }
+
+    storage::clearProfileKeysCache();
+    auto keys = storage::loadProfileKeys(cfg, "dev");
+    EXPECT_EQ(keys["OPENAI_API_KEY"], "sk-secret");
+
+    core::Config wrong = cfg;
+    wrong.presetPassphrase = "nope";
+    std::map<std::string, std::string> out;
+    EXPECT_FALSE(storage::tryLoadProfileKeys(wrong, "dev", out));
+}
+
+TEST_F(ProfileKeysCacheTest, PlainFilesStayReadableAfterSwitch) {
+    if (!crypto::aeadAvailable()) {
+        GTEST_SKIP() << "built without OpenSSL";
+    }
+    storage::saveProfileKeys(cfg, "dev", {{"A", "1"}});
+
+    cfg.forcePlain = false;
+    cfg.backend = "aead";
+    cfg.presetPassphrase = "pw";
+    storage::clearProfileKeysCache();
+    EXPECT_EQ(storage::loadProfileKeys(cfg, "dev")["A"], "1");
+}
+
+TEST(StorageBackend, ParseAndName) {
+    storage::Backend b;
+    ASSERT_TRUE(storage::parseBackend("AEAD", b));
+    EXPECT_EQ(b, storage::Backend::Aead);
+    ASSERT_TRUE(storage::parseBackend("gpg", b));
+    EXPECT_STREQ(storage::backendName(b), "gpg");
+    EXPECT_FALSE(storage::parseBackend("rot13", b));
+
+    core::Config cfg;
+    cfg.forcePlain = true;
+    cfg.backend = "aead";
+    EXPECT_EQ(storage::activeBackend(cfg), storage::Backend::Plain);
+}
+
+TEST(KeyTable, ParsesBufferIntoSortedViews) {
+    std::string data = "# comment\n"
+                       "ZED=" + crypto::base64Encode("last") + "\n"
+                       "\n"
+                       "API_KEY=" + crypto::base64Encode("old") + "\n"
+                       "broken line\n"
+                       "EMPTY=\n"
+                       "API_KEY=" + crypto::base64Encode("new value") + "\n"
+                       "PEM=" + crypto::base64Encode(std::string(5000, 'p'));
+    auto table = storage::KeyTable::parse(data);
+    ASSERT_EQ(table.size(), 4u);
+    EXPECT_EQ(table.entries()[0].name, "API_KEY");
+    EXPECT_EQ(table.entries()[0].value, "new value");
+    EXPECT_EQ(table.entries()[1].name, "EMPTY");
+    EXPECT_EQ(table.entries()[1].value, "");
+    EXPECT_EQ(table.entries()[3].name, "ZED");
+
+    const auto* pem = table.find("PEM");
+    ASSERT_NE(pem, nullptr);
+    EXPECT_EQ(pem->value, std::string(5000, 'p'));
+    EXPECT_EQ(table.find("MISSING"), nullptr);
+
+    // Views survive moving the table
+    storage::KeyTable moved = std::move(table);
+    EXPECT_EQ(moved.find("ZED")->value, "last");
+
+    std::map<std::string, std::string> map;
+    moved.copyTo(map);
+    EXPECT_EQ(map.size(), 4u);
+    EXPECT_EQ(map["API_KEY"], "new value");
+}
+
+TEST(KeyTable, MapParseMatchesTable) {
+    std::string data = "A=" + crypto::base64Encode("one") + "\n"
+                       "B=" + crypto::base64Encode("gone") + "\n"
+                       "-B\n"
+                       "A=" + crypto::base64Encode("two") + "\n"
+                       "-C\n"
+                       "C=" + crypto::base64Encode("back") + "\n"
+                       "EMPTY=\n";
+    std::string copy = data;
+    std::map<std::string, std::string> parsed;
+    storage::parseKeyLines(copy, parsed);
+    EXPECT_EQ(copy.find("A="), std::string::npos); // the input is wiped
+
+    std::map<std::string, std::string> viaTable;
+    storage::KeyTable::parse(data).copyTo(viaTable);
+    EXPECT_EQ(parsed, viaTable);
+    EXPECT_EQ(parsed, (std::map<std::string, std::string>{{"A", "two"}, {"C", "back"}, {"EMPTY", ""}}));
+}
+
+TEST_F(ProfileKeysCacheTest, TableLoadersMatchMapLoaders) {
+    storage::saveProfileKeys(cfg, "ci", {{"B", "2"}, {"A", "1"}});
+    storage::KeyTable table;
+    ASSERT_TRUE(storage::tryLoadProfileKeyTable(cfg, "ci", table));
+    ASSERT_EQ(table.size(), 2u);
+    EXPECT_EQ(table.entries()[0].name, "A");
+    EXPECT_EQ(table.entries()[1].value, "2");
+    EXPECT_EQ(storage::loadProfileKeys(cfg, "ci"), (std::map<std::string, std::string>{{"A", "1"}, {"B", "2"}}));
+
+    core::KeyStore ks;
+    ks.kv["SHORT"] = "x";
+    storage::saveVault(cfg, ks);
+    auto vault = storage::loadVaultTable(cfg);
+    ASSERT_EQ(vault.size(), 1u);
+    EXPECT_EQ(vault.find("SHORT")->value, "x");
+}
+
+TEST_F(DirBundleTest, WritesReplaceGenerationStamp) {
+    EXPECT_EQ(storage::readGeneration(cfg), "");
+    storage::saveProfileKeys(cfg, "dev", {{"A", "1"}});
+    std::string first = storage::readGeneration(cfg);
+    EXPECT_FALSE(first.empty());
+
+    storage::writeProfile(cfg, "dev", {"A"});
+    std::string second = storage::readGeneration(cfg);
+    EXPECT_NE(second, first);
+
+    storage::writeDirProfiles(cfg, "/work/repo", {"dev"});
+    EXPECT_NE(storage::readGeneration(cfg), second);
+    EXPECT_EQ(storage::listPersistedDirKeys(cfg), std::vector<std::string>{storage::dirKey("/work/repo")});
+}
+
+TEST_F(DirBundleTest, DirBundleIsServedOnlyWhileCurrent) {
+    storage::writeDirProfiles(cfg, "/work/repo", {"dev"});
+    std::string key = storage::dirKey("/work/repo");
+    std::string generation = storage::readGeneration(cfg);
+    ASSERT_TRUE(storage::canSealWithoutPrompt(cfg));
+
+    std::string bundle;
+    EXPECT_FALSE(storage::readDirBundle(cfg, key, generation, bundle));
+    storage::writeDirBundle(cfg, key, generation, "# profile dev\nexport A=\"1\"\n");
+    ASSERT_TRUE(storage::readDirBundle(cfg, key, generation, bundle));
+    EXPECT_EQ(bundle, "# profile dev\nexport A=\"1\"\n");
+
+    storage::saveProfileKeys(cfg, "dev", {{"A", "2"}});
+    EXPECT_FALSE(storage::readDirBundle(cfg, key, storage::readGeneration(cfg), bundle));
+
+    storage::removeDirBundle(cfg, key);
+    EXPECT_FALSE(storage::readDirBundle(cfg, key, generation, bundle));
+}
+
+TEST_F(DirBundleTest, ReadingABundleNeverProbesForGpg) {
+    storage::writeDirProfiles(cfg, "/work/repo", {"dev"});
+    std::string key = storage::dirKey("/work/repo");
+    std::string generation = storage::readGeneration(cfg);
+    storage::writeDirBundle(cfg, key, generation, "# profile dev\nexport A=\"1\"\n");
+
+    // With no backend configured, resolving one would look for gpg on PATH
+    core::Config reader = cfg;
+    reader.forcePlain = false;
+    bool probed = false;
+    reader.gpgAvailable = core::Lazy<bool>::deferred([&probed] {
+        probed = true;
+        return false;
+    });
+    std::string bundle;
+    ASSERT_TRUE(storage::readDirBundle(reader, key, generation, bundle));
+    EXPECT_EQ(bundle, "# profile dev\nexport A=\"1\"\n");
+    EXPECT_FALSE(probed);
+
+    // A stamp that doesn't name its backend is treated as stale
+    std::ofstream(root / "persist" / (key + ".dirstamp")) << generation << "\n";
+    EXPECT_FALSE(storage::readDirBundle(reader, key, generation, bundle));
+    EXPECT_FALSE(probed);
+}
+
+TEST_F(DirBundleTest, DirIndexResolvesNearestAncestor) {
+    storage::writeDirProfiles(cfg, "/work/repo", {"dev"});
+    storage::writeDirProfiles(cfg, "/work/repo/api/", {"api", "dev"});
+
+    storage::DirMapping mapping;
+    ASSERT_TRUE(storage::findDirMapping(cfg, "/work/repo/src/lib", mapping));
+    EXPECT_EQ(mapping.dir, "/work/repo");
+    EXPECT_EQ(mapping.key, storage::dirKey("/work/repo"));
+    EXPECT_EQ(mapping.profiles, std::vector<std::string>{"dev"});
+
+    ASSERT_TRUE(storage::findDirMapping(cfg, "/work/repo/api/v2", mapping));
+    EXPECT_EQ(mapping.dir, "/work/repo/api");
+    EXPECT_EQ(mapping.profiles, (std::vector<std::string>{"api", "dev"}));
+
+    EXPECT_FALSE(storage::findDirMapping(cfg, "/work/repository", mapping));
+    EXPECT_FALSE(storage::findDirMapping(cfg, "/work", mapping));
+    EXPECT_TRUE(storage::readDirProfiles(cfg, "/work/repo/src").empty());
+
+    storage::writeDirProfiles(cfg, "/work/repo/api", {});
+    ASSERT_TRUE(storage::findDirMapping(cfg, "/work/repo/api/v2", mapping));
+    EXPECT_EQ(mapping.dir, "/work/repo");
+    EXPECT_EQ(storage::listDirMappings(cfg).size(), 1u);
+}
+
+TEST_F(DirBundleTest, LegacyMappingFilesAreMigrated) {
+    fs::create_directories(cfg.persistDir);
+    auto legacy = fs::path(storage::mappingFileForDir(cfg, "/old/project"));
+    {
+        std::ofstream out(legacy);
+        out << "default\nextra\n";
+    }
+
+    // Listed by key before anyone has visited the directory
+    auto mappings = storage::listDirMappings(cfg);
+    ASSERT_EQ(mappings.size(), 1u);
+    EXPECT_EQ(mappings[0].key, storage::dirKey("/old/project"));
+    EXPECT_EQ(mappings[0].dir, "");
+
+    storage::DirMapping mapping;
+    ASSERT_TRUE(storage::findDirMapping(cfg, "/old/project/sub", mapping));
+    EXPECT_EQ(mapping.dir, "/old/project");
+    EXPECT_EQ(mapping.profiles, (std::vector<std::string>{"default", "extra"}));
+    EXPECT_FALSE(fs::exists(legacy));
+
+    std::ifstream in(storage::dirIndexFile(cfg));
+    std::string index((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    EXPECT_EQ(index, "# ak dirs v1\n/old/project\tdefault\textra\n");
+}
+
+TEST_F(DirBundleTest, ConcurrentMappingWritersKeepEveryDirectory) {
+    // Old mapping files folded in by lookups while the writers run
+    fs::create_directories(cfg.persistDir);
+    for (int i = 0; i < 4; ++i) {
+        std::ofstream(storage::mappingFileForDir(cfg, "/old/p" + std::to_string(i))) << "default\n";
+    }
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 6; ++t) {
+        threads.emplace_back([this, t] {
+            for (int i = 0; i < 6; ++i) {
+                std::string dir = "/work/t" + std::to_string(t) + "_" + std::to_string(i);
+                storage::writeDirProfiles(cfg, dir, {"dev"});
+                if (i % 2) {
+                    storage::writeDirProfiles(cfg, dir + "/gone", {"dev"});
+                    storage::writeDirProfiles(cfg, dir + "/gone", {});
+                }
+            }
+        });
+    }
+    threads.emplace_back([this] {
+        storage::DirMapping mapping;
+        for (int i = 0; i < 4; ++i) {
+            EXPECT_TRUE(storage::findDirMapping(cfg, "/old/p" + std::to_string(i), mapping));
+        }
+    });
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    std::set<std::string> dirs;
+    for (const auto& mapping : storage::listDirMappings(cfg)) {
+        dirs.insert(mapping.dir);
+    }
+    EXPECT_EQ(dirs.size(), 40u);
+    EXPECT_TRUE(dirs.count("/work/t5_5"));
+    EXPECT_TRUE(dirs.count("/old/p3"));
+    EXPECT_FALSE(dirs.count("/work/t0_1/gone"));
+}
+
+TEST_F(DirBundleTest, AeadDirBundleIsSealed) {
+    if (!crypto::aeadAvailable()) {
+        GTEST_SKIP() << "built without OpenSSL";
+    }
+    cfg.forcePlain = false;
+    cfg.backend = "aead";
+    cfg.presetPassphrase = "test-passphrase";
+
+    storage::writeDirBundle(cfg, "abc", "g1", "export SECRET=\"sk-value\"\n");
+    auto path = fs::path(cfg.persistDir) / "abc.dirbundle.akv";
+    ASSERT_TRUE(fs::exists(path));
+    std::ifstream in(path, std::ios::binary);
+    std::string raw((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    EXPECT_EQ(raw.find("sk-value"), std::string::npos);
+
+    std::string bundle;
+    ASSERT_TRUE(storage::readDirBundle(cfg, "abc", "g1", bundle));
+    EXPECT_EQ(bundle, "export SECRET=\"sk-value\"\n");
+}
+
+TEST(KeyTable, TombstonesDropEarlierValues) {
+    std::string data = "A=" + crypto::base64Encode("1") + "\n"
+                       "B=" + crypto::base64Encode("2") + "\n"
+                       "-A\n"
+                       "-B\n"
+                       "B=" + crypto::base64Encode("3") + "\n";
+    auto table = storage::KeyTable::parse(data);
+    ASSERT_EQ(table.size(), 1u);
+    EXPECT_EQ(table.find("A"), nullptr);
+    EXPECT_EQ(table.find("B")->value, "3");
+}
+
+TEST_F(ProfileLogTest, ProfileLogAppendsWithoutRewriting) {
+    cfg.profileLog = true;
+    storage::saveProfileKeys(cfg, "dev", {{"A", "1"}, {"B", "2"}});
+    auto path = fs::path(cfg.profilesDir) / "dev.keys";
+    auto logPath = fs::path(cfg.profilesDir) / "dev.keys.log";
+    std::string snapshot = readFile(path);
+    EXPECT_FALSE(fs::exists(logPath));
+
+    storage::setProfileKey(cfg, "dev", "C", "3");
+    storage::removeProfileKey(cfg, "dev", "A");
+    // A small save on top of a current cache becomes records too
+    storage::saveProfileKeys(cfg, "dev", {{"B", "22"}, {"C", "3"}});
+    EXPECT_EQ(readFile(path), snapshot);
+    ASSERT_TRUE(fs::exists(logPath));
+
+    std::map<std::string, std::string> expected{{"B", "22"}, {"C", "3"}};
+    EXPECT_EQ(*storage::loadProfileKeysCached(cfg, "dev"), expected);
+    storage::clearProfileKeysCache();
+    EXPECT_EQ(storage::loadProfileKeys(cfg, "dev"), expected);
+
+    // Without a cached copy the record is still appended
+    storage::clearProfileKeysCache();
+    storage::setProfileKey(cfg, "dev", "D", "4");
+    EXPECT_EQ(readFile(path), snapshot);
+    EXPECT_EQ(storage::loadProfileKeysCached(cfg, "dev")->at("D"), "4");
+
+    EXPECT_TRUE(storage::compactProfileKeys(cfg, "dev"));
+    EXPECT_FALSE(fs::exists(logPath));
+    EXPECT_FALSE(storage::compactProfileKeys(cfg, "dev"));
+    storage::clearProfileKeysCache();
+    expected["D"] = "4";
+    EXPECT_EQ(storage::loadProfileKeys(cfg, "dev"), expected);
+}
+
+TEST_F(ProfileLogTest, StaleProfileLogIsIgnored) {
+    cfg.profileLog = true;
+    storage::saveProfileKeys(cfg, "dev", {{"A", "1"}});
+    storage::setProfileKey(cfg, "dev", "A", "from-log");
+    auto logPath = fs::path(cfg.profilesDir) / "dev.keys.log";
+    std::string log = readFile(logPath);
+    ASSERT_FALSE(log.empty());
+
+    // A full rewrite with the same contents still gets a new snapshot id
+    cfg.profileLog = false;
+    storage::saveProfileKeys(cfg, "dev", {{"A", "1"}});
+    cfg.profileLog = true;
+    storage::saveProfileKeys(cfg, "dev", {{"A", "1"}, {"B", "2"}, {"C", "3"}, {"D", "4"}, {"E", "5"}});
+    std::ofstream(logPath, std::ios::binary) << log;
+
+    storage::clearProfileKeysCache();
+    EXPECT_EQ(storage::loadProfileKeys(cfg, "dev")["A"], "1");
+
+    // The next record starts the log over
+    storage::setProfileKey(cfg, "dev", "F", "6");
+    storage::clearProfileKeysCache();
+    auto keys = storage::loadProfileKeys(cfg, "dev");
+    EXPECT_EQ(keys["A"], "1");
+    EXPECT_EQ(keys["F"], "6");
+}
+
+TEST_F(ProfileLogTest, TornProfileLogTailIsCut) {
+    cfg.profileLog = true;
+    storage::saveProfileKeys(cfg, "dev", {{"A", "1"}});
+    storage::setProfileKey(cfg, "dev", "B", "2");
+    auto logPath = fs::path(cfg.profilesDir) / "dev.keys.log";
+    auto good = fs::file_size(logPath);
+    {
+        std::ofstream out(logPath, std::ios::binary | std::ios::app);
+        out << std::string("\x40\x00\x00\x00", 4) << "partial";
+    }
+
+    storage::clearProfileKeysCache();
+    auto keys = storage::loadProfileKeys(cfg, "dev");
+    EXPECT_EQ(keys["B"], "2");
+    EXPECT_EQ(fs::file_size(logPath), good);
+
+    // Records must sit at the offset they were written for
+    std::string log = readFile(logPath);
+    std::string moved = log.substr(0, log.find('\n') + 1) + std::string(3, 'x') + log.substr(log.find('\n') + 1);
+    std::ofstream(logPath, std::ios::binary) << moved;
+    storage::clearProfileKeysCache();
+    EXPECT_EQ(storage::loadProfileKeys(cfg, "dev").count("B"), 0u);
+}
+
+TEST_F(ProfileLogTest, AeadProfileLogRecordsAreSealed) {
+    if (!crypto::aeadAvailable()) {
+        GTEST_SKIP() << "built without OpenSSL";
+    }
+    cfg.forcePlain = false;
+    cfg.backend = "aead";
+    cfg.presetPassphrase = "test-passphrase";
+    cfg.profileLog = true;
+    ASSERT_TRUE(storage::profileLogEnabled(cfg));
+
+    storage::saveProfileKeys(cfg, "dev", {{"A", "1"}});
+    storage::setProfileKey(cfg, "dev", "SECRET", "sk-logged");
+    auto logPath = fs::path(cfg.profilesDir) / "dev.keys.akv.log";
+    ASSERT_TRUE(fs::exists(logPath));
+    EXPECT_EQ(readFile(logPath).find("SECRET"), std::string::npos);
+
+    storage::clearProfileKeysCache();
+    EXPECT_EQ(storage::loadProfileKeys(cfg, "dev")["SECRET"], "sk-logged");
+
+    core::Config wrong = cfg;
+    wrong.presetPassphrase = "nope";
+    std::map<std::string, std::string> out;
+    EXPECT_FALSE(storage::tryLoadProfileKeys(wrong, "dev", out));
+    EXPECT_TRUE(fs::exists(logPath));
+
+    // Outgrowing the key file folds the log back in
+    for (int i = 0; i < 200; ++i) {
+        storage::setProfileKey(cfg, "dev", "K" + std::to_string(i), std::string(64, 'v'));
+    }
+    EXPECT_GT(fs::file_size(fs::path(cfg.profilesDir) / "dev.keys.akv"), 4096u);
+    EXPECT_LT(fs::file_size(logPath), 16 * 1024u + 512u);
+    storage::clearProfileKeysCache();
+    auto keys = storage::loadProfileKeys(cfg, "dev");
+    EXPECT_EQ(keys.size(), 202u);
+    EXPECT_EQ(keys["SECRET"], "sk-logged");
+}
+
+namespace {
+
+size_t countObjects(const core::Config& cfg) {
+    size_t objects = 0;
+    unsigned long long bytes = 0;
+    storage::ContentStore(cfg, cfg.presetPassphrase).stats(objects, bytes);
+    return objects;
+}
+
+} // namespace
+
+TEST_F(ContentStoreTest, ContentStoreSharesValuesAcrossProfiles) {
+    cfg.contentStore = true;
+    ASSERT_TRUE(storage::contentStoreEnabled(cfg));
+    storage::saveProfileKeys(cfg, "dev", {{"OPENAI_API_KEY", "sk-shared"}, {"DB_URL", "postgres://dev"}});
+    storage::saveProfileKeys(cfg, "prod", {{"OPENAI_API_KEY", "sk-shared"}, {"DB_URL", "postgres://prod"}});
+    EXPECT_TRUE(fs::exists(fs::path(cfg.profilesDir) / "dev.keys.cas"));
+    EXPECT_FALSE(fs::exists(fs::path(cfg.profilesDir) / "dev.keys"));
+    EXPECT_EQ(countObjects(cfg), 3u);
+    EXPECT_EQ(readFile(fs::path(cfg.profilesDir) / "dev.keys.cas").find("sk-shared"), std::string::npos);
+
+    // Duplicating copies the manifest and stores nothing new
+    ASSERT_TRUE(storage::duplicateProfileKeys(cfg, "prod", "staging"));
+    EXPECT_EQ(readFile(fs::path(cfg.profilesDir) / "staging.keys.cas"),
+              readFile(fs::path(cfg.profilesDir) / "prod.keys.cas"));
+    EXPECT_EQ(countObjects(cfg), 3u);
+    storage::clearProfileKeysCache();
+    std::map<std::string, std::string> expected{{"OPENAI_API_KEY", "sk-shared"}, {"DB_URL", "postgres://prod"}};
+    EXPECT_EQ(storage::loadProfileKeys(cfg, "staging"), expected);
+
+    // Copy-on-write: changing the copy leaves the source alone
+    storage::setProfileKey(cfg, "staging", "DB_URL", "postgres://staging");
+    storage::clearProfileKeysCache();
+    EXPECT_EQ(storage::loadProfileKeys(cfg, "prod"), expected);
+    EXPECT_EQ(storage::loadProfileKeys(cfg, "staging")["DB_URL"], "postgres://staging");
+
+    // A missing object fails the load instead of dropping the key
+    storage::Manifest manifest;
+    ASSERT_TRUE(storage::readManifest((fs::path(cfg.profilesDir) / "dev.keys.cas").string(), manifest));
+    manifest["DB_URL"] = std::string(64, 'a');
+    storage::writeManifest((fs::path(cfg.profilesDir) / "dev.keys.cas").string(), manifest);
+    storage::clearProfileKeysCache();
+    std::map<std::string, std::string> out;
+    EXPECT_FALSE(storage::tryLoadProfileKeys(cfg, "dev", out));
+}
+
+TEST_F(ContentStoreTest, ContentStoreRotatesSharedValueAndCollectsGarbage) {
+    cfg.contentStore = true;
+    storage::saveProfileKeys(cfg, "a", {{"TOKEN", "old"}, {"OTHER", "keep"}});
+    storage::saveProfileKeys(cfg, "b", {{"ALIAS", "old"}});
+    storage::saveProfileKeys(cfg, "c", {{"TOKEN", "unrelated"}});
+    // Warm caches must not hide the rewritten manifests
+    storage::loadProfileKeysCached(cfg, "b");
+
+    std::vector<std::string> changed;
+    EXPECT_EQ(storage::rotateSharedValue(cfg, "old", "new", &changed), 2u);
+    EXPECT_EQ(changed, (std::vector<std::string>{"a", "b"}));
+    EXPECT_EQ(storage::loadProfileKeysCached(cfg, "b")->at("ALIAS"), "new");
+    EXPECT_EQ(storage::loadProfileKeys(cfg, "a")["TOKEN"], "new");
+    EXPECT_EQ(storage::loadProfileKeys(cfg, "c")["TOKEN"], "unrelated");
+    EXPECT_EQ(storage::rotateSharedValue(cfg, "old", "newer"), 0u);
+
+    size_t before = countObjects(cfg);
+    EXPECT_EQ(storage::collectContentGarbage(cfg), 1u);
+    EXPECT_EQ(countObjects(cfg), before - 1);
+    EXPECT_EQ(storage::collectContentGarbage(cfg), 0u);
+    storage::clearProfileKeysCache();
+    EXPECT_EQ(storage::loadProfileKeys(cfg, "a")["OTHER"], "keep");
+}
+
+TEST_F(ContentStoreTest, AeadContentStoreObjectsAreSealed) {
+    if (!crypto::aeadAvailable()) {
+        GTEST_SKIP() << "built without OpenSSL";
+    }
+    cfg.forcePlain = false;
+    cfg.backend = "aead";
+    cfg.presetPassphrase = "test-passphrase";
+    // A profile written before the switch is read, then superseded
+    storage::saveProfileKeys(cfg, "dev", {{"SECRET", "sk-sealed"}});
+    cfg.contentStore = true;
+    storage::clearProfileKeysCache();
+    EXPECT_EQ(storage::loadProfileKeys(cfg, "dev")["SECRET"], "sk-sealed");
+    storage::setProfileKey(cfg, "dev", "MORE", "sk-sealed");
+    EXPECT_FALSE(fs::exists(fs::path(cfg.profilesDir) / "dev.keys.akv"));
+    EXPECT_EQ(countObjects(cfg), 1u);
+
+    for (const auto& entry : fs::recursive_directory_iterator(storage::ContentStore::dir(cfg))) {
+        if (entry.is_regular_file()) {
+            EXPECT_EQ(readFile(entry.path()).find("sk-sealed"), std::string::npos) << entry.path();
+        }
+    }
+    storage::clearProfileKeysCache();
+    EXPECT_EQ(storage::loadProfileKeys(cfg, "dev")["MORE"], "sk-sealed");
+
+    core::Config wrong = cfg;
+    wrong.presetPassphrase = "nope";
+    std::map<std::string, std::string> out;
+    EXPECT_FALSE(storage::tryLoadProfileKeys(wrong, "dev", out));
+    EXPECT_THROW(storage::setProfileKey(wrong, "dev", "NEW", "value"), std::runtime_error);
+}
+
+TEST_F(TransactionTest, TransactionWritesOnceOnCommit) {
+    core::KeyStore ks;
+    ks.kv["OLD"] = "1";
+    ks.kv["GONE"] = "x";
+    storage::saveVault(cfg, ks);
+    storage::writeProfile(cfg, "dev", {"GONE"});
+    storage::saveProfileKeys(cfg, "dev", {{"GONE", "x"}});
+    std::string generation = storage::readGeneration(cfg);
+
+    storage::Transaction tx(cfg, "dev");
+    for (int i = 0; i < 50; ++i) {
+        tx.put("K" + std::to_string(i), "v" + std::to_string(i));
+    }
+    tx.put("OLD", "2");
+    EXPECT_TRUE(tx.remove("GONE"));
+    EXPECT_FALSE(tx.remove("MISSING"));
+
+    // Nothing reaches disk before commit
+    EXPECT_EQ(storage::readGeneration(cfg), generation);
+    EXPECT_EQ(storage::loadVault(cfg).kv.size(), 2u);
+
+    tx.commit();
+    EXPECT_THROW(tx.commit(), std::logic_error);
+    EXPECT_EQ(tx.stats().addedToVault, 50u);
+    EXPECT_EQ(tx.stats().updatedInVault, 1u);
+    EXPECT_EQ(tx.stats().removedFromVault, 1u);
+    EXPECT_EQ(tx.stats().addedToProfile, 51u);
+
+    auto vault = storage::loadVault(cfg);
+    EXPECT_EQ(vault.kv.size(), 51u);
+    EXPECT_EQ(vault.kv["OLD"], "2");
+    EXPECT_EQ(vault.kv.count("GONE"), 0u);
+    storage::clearProfileKeysCache();
+    auto keys = storage::loadProfileKeys(cfg, "dev");
+    EXPECT_EQ(keys.size(), 51u);
+    EXPECT_EQ(keys["K7"], "v7");
+    EXPECT_EQ(keys.count("GONE"), 0u);
+    auto listed = storage::readProfile(cfg, "dev");
+    EXPECT_EQ(std::count(listed.begin(), listed.end(), "GONE"), 0);
+    EXPECT_EQ(listed.size(), 51u);
+}
+
+namespace {
+
+using Pairs = std::vector<std::pair<std::string, std::string>>;
+
+// Feeds `text` in chunks of `step` bytes
+Pairs importChunked(storage::ImportFormat format, const std::string& text, size_t step) {
+    Pairs out;
+    storage::ImportParser parser(format, [&](std::string name, std::string value) {
+        out.emplace_back(std::move(name), std::move(value));
+    });
+    for (size_t i = 0; i < text.size(); i += step) {
+        parser.feed(std::string_view(text).substr(i, step));
+    }
+    parser.finish();
+    return out;
+}
+
+} // namespace
+
+TEST_F(TransactionTest, ConcurrentSavesMergeInsteadOfClobbering) {
+    core::KeyStore seed;
+    seed.kv["SHARED"] = "0";
+    seed.kv["DROP"] = "x";
+    storage::saveVault(cfg, seed);
+
+    // Both writers load the same vault; the second save merges
+    core::KeyStore first = storage::loadVault(cfg);
+    core::KeyStore second = storage::loadVault(cfg);
+    first.kv["A"] = "1";
+    first.kv.erase("DROP");
+    storage::saveVault(cfg, first);
+    second.kv["B"] = "2";
+    second.kv["SHARED"] = "changed";
+    storage::saveVault(cfg, second);
+    auto vault = storage::loadVault(cfg).kv;
+    EXPECT_EQ(vault, (std::unordered_map<std::string, std::string>{{"A", "1"}, {"B", "2"}, {"SHARED", "changed"}}));
+
+    // The same for a profile edited from a cached copy
+    storage::saveProfileKeys(cfg, "dev", {{"A", "1"}, {"B", "2"}});
+    auto base = storage::loadProfileKeysCached(cfg, "dev");
+    storage::setProfileKey(cfg, "dev", "C", "3");
+    auto edited = *base;
+    edited["A"] = "11";
+    edited.erase("B");
+    storage::saveProfileKeys(cfg, "dev", edited, base);
+    storage::clearProfileKeysCache();
+    EXPECT_EQ(storage::loadProfileKeys(cfg, "dev"), (std::map<std::string, std::string>{{"A", "11"}, {"C", "3"}}));
+
+    // A current base takes the plain path
+    base = storage::loadProfileKeysCached(cfg, "dev");
+    storage::saveProfileKeys(cfg, "dev", {{"A", "11"}}, base);
+    EXPECT_EQ(storage::loadProfileKeys(cfg, "dev"), (std::map<std::string, std::string>{{"A", "11"}}));
+
+    // Key lists keep names another writer added
+    storage::writeProfile(cfg, "dev", {"A"});
+    auto listed = storage::readProfile(cfg, "dev");
+    storage::writeProfile(cfg, "dev", {"A", "C"});
+    auto mine = listed;
+    mine.push_back("D");
+    storage::writeProfile(cfg, "dev", mine, &listed);
+    EXPECT_EQ(storage::readProfile(cfg, "dev"), (std::vector<std::string>{"A", "C", "D"}));
+}
+
+TEST_F(TransactionTest, ParallelWritersKeepEveryKey) {
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 6; ++t) {
+        threads.emplace_back([this, t] {
+            for (int i = 0; i < 8; ++i) {
+                std::string name = "T" + std::to_string(t) + "_" + std::to_string(i);
+                storage::setProfileKey(cfg, "dev", name, "v");
+                core::KeyStore ks = storage::loadVault(cfg);
+                ks.kv[name] = "v";
+                storage::saveVault(cfg, ks);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    storage::clearProfileKeysCache();
+    EXPECT_EQ(storage::loadProfileKeys(cfg, "dev").size(), 48u);
+    EXPECT_EQ(storage::loadVault(cfg).kv.size(), 48u);
+    for (const auto& entry : fs::recursive_directory_iterator(cfg.configDir)) {
+        EXPECT_EQ(entry.path().filename().string().find(".tmp"), std::string::npos) << entry.path();
+    }
+}
+
+TEST(ProfileIndex, TracksServicesAndNearDuplicates) {
+    storage::ProfileIndex index({{"OPENAI_API_KEY", "a"}, {"OPENAI_ORG", "b"}, {"GROQ-KEY", "c"}});
+    EXPECT_EQ(index.size(), 3u);
+    EXPECT_EQ(index.serviceOf("OPENAI_ORG"), "openai");
+    EXPECT_EQ(index.keysForService("openai"), (std::set<std::string>{"OPENAI_API_KEY", "OPENAI_ORG"}));
+    EXPECT_TRUE(index.keysForService("stripe").empty());
+
+    // Case and '-' vs '_' differences are reported, the key itself is not
+    ASSERT_NE(index.conflictFor("groq_key"), nullptr);
+    EXPECT_EQ(*index.conflictFor("groq_key"), "GROQ-KEY");
+    EXPECT_EQ(index.conflictFor("GROQ-KEY"), nullptr);
+
+    index.remove("OPENAI_ORG");
+    index.add("STRIPE_KEY");
+    index.add("STRIPE_KEY");
+    EXPECT_FALSE(index.contains("OPENAI_ORG"));
+    EXPECT_EQ(index.keysForService("openai"), (std::set<std::string>{"OPENAI_API_KEY"}));
+    EXPECT_EQ(index.keysForService("stripe").size(), 1u);
+    EXPECT_EQ(index.size(), 3u);
+    index.remove("GROQ-KEY");
+    EXPECT_EQ(index.conflictFor("groq_key"), nullptr);
+    EXPECT_TRUE(index.serviceOf("GROQ-KEY").empty());
+}
+
+TEST_F(ProfileIndexTest, ProfileIndexFollowsKeyChanges) {
+    storage::saveProfileKeys(cfg, "dev", {{"OPENAI_API_KEY", "a"}, {"GROQ_KEY", "b"}});
+    auto index = storage::loadProfileIndexCached(cfg, "dev");
+    EXPECT_EQ(storage::loadProfileIndexCached(cfg, "dev"), index);
+    EXPECT_FALSE(storage::validateKeyUniquenessInProfile(cfg, "dev", "GROQ_KEY"));
+    EXPECT_TRUE(storage::validateKeyUniquenessInProfile(cfg, "dev", "GROQ_KEY", "GROQ_KEY"));
+
+    storage::setProfileKey(cfg, "dev", "OPENAI_ORG", "c");
+    storage::removeProfileKey(cfg, "dev", "GROQ_KEY");
+    auto patched = storage::loadProfileIndexCached(cfg, "dev");
+    EXPECT_TRUE(patched->contains("OPENAI_ORG"));
+    EXPECT_FALSE(patched->contains("GROQ_KEY"));
+    EXPECT_TRUE(storage::validateKeyUniquenessInProfile(cfg, "dev", "GROQ_KEY"));
+    EXPECT_EQ(storage::getServiceKeysInProfile(cfg, "dev", "openai"),
+              (std::vector<std::string>{"OPENAI_API_KEY", "OPENAI_ORG"}));
+
+    // A cold load builds the same index from disk
+    storage::clearProfileKeysCache();
+    EXPECT_EQ(storage::getServiceKeysInProfile(cfg, "dev", "openai"),
+              (std::vector<std::string>{"OPENAI_API_KEY", "OPENAI_ORG"}));
+    EXPECT_TRUE(storage::getServiceKeysInProfile(cfg, "dev", "groq").empty());
+}
+
+TEST_F(MetadataCacheTest, MetadataCacheServesProfileListing) {
+    storage::writeProfile(cfg, "dev", {"A", "B"});
+    storage::writeProfile(cfg, "prod", {"A"});
+    auto age = [&](const fs::path& p) {
+        fs::last_write_time(p, fs::file_time_type::clock::now() - std::chrono::hours(1));
+    };
+
+    // A directory changed moments ago is racy: listed, but not recorded
+    EXPECT_EQ(storage::listProfiles(cfg), (std::vector<std::string>{"dev", "prod"}));
+    EXPECT_FALSE(fs::exists(storage::MetadataCache::path(cfg)));
+
+    age(cfg.profilesDir);
+    auto summaries = storage::listProfileSummaries(cfg);
+    ASSERT_EQ(summaries.size(), 2u);
+    EXPECT_EQ(summaries[0].keyCount, 2u);
+    ASSERT_TRUE(fs::exists(storage::MetadataCache::path(cfg)));
+
+    // Served from the cache while the directory stamp holds; an in-place edit
+    // that leaves the directory alone is not seen
+    auto dirTime = fs::last_write_time(cfg.profilesDir);
+    { std::ofstream(storage::profilePath(cfg, "dev")) << "A\nB\nC\n"; }
+    fs::last_write_time(cfg.profilesDir, dirTime);
+    EXPECT_EQ(storage::listProfileSummaries(cfg)[0].keyCount, 2u);
+
+    // Profile writes go through rename, which moves the directory's mtime
+    storage::writeProfile(cfg, "dev", {"A", "B", "C", "D"});
+    age(cfg.profilesDir);
+    summaries = storage::listProfileSummaries(cfg);
+    EXPECT_EQ(summaries[0].keyCount, 4u);
+
+    // Damaged or foreign files read as empty
+    { std::ofstream(storage::MetadataCache::path(cfg), std::ios::trunc) << "AKMC\x01"; }
+    storage::MetadataCache damaged(cfg);
+    std::vector<storage::ProfileSummary> out;
+    EXPECT_FALSE(damaged.profiles(storage::stampPath(cfg.profilesDir), out));
+    EXPECT_EQ(storage::listProfiles(cfg).size(), 2u);
+}
+
+TEST_F(MetadataCacheTest, MetadataCacheKeepsServiceRecordsPerStamp) {
+    auto file = root / "src.txt";
+    { std::ofstream(file) << "x"; }
+    fs::last_write_time(file, fs::file_time_type::clock::now() - std::chrono::hours(1));
+    auto stamp = storage::stampPath(file.string());
+    ASSERT_TRUE(stamp.exists);
+    EXPECT_EQ(stamp.size, 1u);
+
+    {
+        storage::MetadataCache meta(cfg);
+        meta.setServiceRecords(stamp, {{"mine", "MINE_KEY", std::string("a\0b", 3)}, {}});
+        meta.save();
+    }
+    storage::MetadataCache meta(cfg);
+    std::vector<std::vector<std::string>> rows;
+    ASSERT_TRUE(meta.serviceRecords(stamp, rows));
+    ASSERT_EQ(rows.size(), 2u);
+    EXPECT_EQ(rows[0][2], std::string("a\0b", 3));
+    EXPECT_TRUE(rows[1].empty());
+
+    auto moved = stamp;
+    moved.mtime += 1;
+    EXPECT_FALSE(meta.serviceRecords(moved, rows));
+}
+
+TEST_F(CompletionIndexTest, CompletionIndexFollowsVaultWrites) {
+    core::KeyStore ks;
+    ks.kv["OPENAI_API_KEY"] = "sk-secret-value";
+    ks.kv["OPENROUTER_API_KEY"] = "or-secret-value";
+    ks.kv["GROQ_API_KEY"] = "gq-secret-value";
+    storage::saveVault(cfg, ks);
+
+    storage::CompletionIndex index(cfg);
+    EXPECT_EQ(index.match("keys", "OPEN"), (std::vector<std::string>{"OPENAI_API_KEY", "OPENROUTER_API_KEY"}));
+    EXPECT_EQ(index.match("keys", "").size(), 3u);
+    EXPECT_TRUE(index.match("keys", "X").empty());
+    EXPECT_TRUE(index.match("nope", "").empty());
+
+    // Names only: no value reaches the index file
+    std::ifstream in(storage::CompletionIndex::path(cfg));
+    std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    EXPECT_EQ(data.find("secret-value"), std::string::npos);
+
+    ks.kv.erase("GROQ_API_KEY");
+    storage::saveVault(cfg, ks);
+    EXPECT_EQ(storage::CompletionIndex(cfg).match("keys", "G").size(), 0u);
+
+    // A removed vault offers nothing
+    fs::remove(cfg.vaultPath.get());
+    EXPECT_TRUE(storage::CompletionIndex(cfg).match("keys", "").empty());
+}
+
+TEST_F(CompletionIndexTest, CompletionIndexSectionsTrackTheirSource) {
+    storage::writeProfile(cfg, "dev", {"A"});
+    auto dir = storage::stampPath(cfg.profilesDir);
+    {
+        storage::CompletionIndex index(cfg);
+        EXPECT_FALSE(index.fresh("profiles", dir));
+        index.set("profiles", cfg.profilesDir, {"dev", "=bad", "dev"});
+        // Just written, so still racy
+        EXPECT_FALSE(index.fresh("profiles", dir));
+        index.save();
+    }
+    fs::last_write_time(cfg.profilesDir, fs::file_time_type::clock::now() - std::chrono::hours(1));
+    dir = storage::stampPath(cfg.profilesDir);
+    storage::CompletionIndex index(cfg);
+    index.set("profiles", cfg.profilesDir, {"dev"});
+    EXPECT_TRUE(index.fresh("profiles", dir));
+    EXPECT_EQ(index.match("profiles", "d"), (std::vector<std::string>{"dev"}));
+
+    storage::writeProfile(cfg, "prod", {"A"});
+    EXPECT_FALSE(index.fresh("profiles", storage::stampPath(cfg.profilesDir)));
+
+    // Damaged files read as empty
+    { std::ofstream(storage::CompletionIndex::path(cfg), std::ios::trunc) << "ak-completion 1\nstray\n"; }
+    EXPECT_TRUE(storage::CompletionIndex(cfg).match("profiles", "").empty());
+}
+
+TEST_F(KeySearchIndexTest, KeySearchIndexSpansProfiles) {
+    storage::writeProfile(cfg, "dev", {"STRIPE_SECRET_KEY", "OPENAI_API_KEY"});
+    storage::writeProfile(cfg, "prod", {"STRIPE_SECRET_KEY", "STRIPE_WEBHOOK_SECRET"});
+
+    storage::KeySearchIndex index(cfg);
+    auto hits = index.search("stripe_*", storage::KeyMatch::Glob);
+    ASSERT_EQ(hits.size(), 2u);
+    EXPECT_EQ(hits[0].name, "STRIPE_SECRET_KEY");
+    EXPECT_EQ(hits[0].profiles, (std::vector<std::string>{"dev", "prod"}));
+    EXPECT_GT(hits[0].modified, 0);
+    EXPECT_EQ(hits[1].profiles, (std::vector<std::string>{"prod"}));
+
+    EXPECT_EQ(index.search("openai", storage::KeyMatch::Substring)[0].service, "openai");
+    EXPECT_EQ(index.search("^STRIPE_.*SECRET$", storage::KeyMatch::Regex).size(), 1u);
+    EXPECT_EQ(index.search("STRIPE", storage::KeyMatch::Substring, "dev").size(), 1u);
+    EXPECT_THROW(index.search("(", storage::KeyMatch::Regex), std::runtime_error);
+
+    auto fuzzy = index.search("STRIPE_SECRT_KEY", storage::KeyMatch::Fuzzy);
+    ASSERT_FALSE(fuzzy.empty());
+    EXPECT_EQ(fuzzy[0].name, "STRIPE_SECRET_KEY");
+    EXPECT_LT(fuzzy[0].score, 1.0);
+    EXPECT_EQ(index.search("opnai", storage::KeyMatch::Fuzzy)[0].name, "OPENAI_API_KEY");
+
+    std::string pattern;
+    EXPECT_EQ(storage::parseKeyQuery("/^A/", pattern), storage::KeyMatch::Regex);
+    EXPECT_EQ(pattern, "^A");
+    EXPECT_EQ(storage::parseKeyQuery("~opnai", pattern), storage::KeyMatch::Fuzzy);
+    EXPECT_EQ(storage::parseKeyQuery("A[BC]", pattern), storage::KeyMatch::Glob);
+    EXPECT_EQ(storage::parseKeyQuery("api", pattern), storage::KeyMatch::Substring);
+}
+
+TEST_F(KeySearchIndexTest, KeySearchIndexRefreshFollowsOutsideChanges) {
+    storage::writeProfile(cfg, "dev", {"A_KEY"});
+    storage::writeProfile(cfg, "gone", {"B_KEY"});
+
+    // Edited and removed behind the index's back
+    { std::ofstream(storage::profilePath(cfg, "dev")) << "A_KEY\nC_KEY\n"; }
+    fs::remove(storage::profilePath(cfg, "gone"));
+
+    storage::KeySearchIndex index(cfg);
+    index.refresh();
+    index.save();
+    EXPECT_EQ(index.search("C_KEY", storage::KeyMatch::Substring).size(), 1u);
+    EXPECT_TRUE(index.search("B_KEY", storage::KeyMatch::Substring).empty());
+    EXPECT_EQ(storage::KeySearchIndex(cfg).search("_KEY", storage::KeyMatch::Substring).size(), 2u);
+}
+
+TEST(ImportParser, JsonHandlesNestingEscapesAndChunks) {
+    std::string json = "{\"A\": \"say \\\"hi\\\"\\n\", \"prod\": {\"DB_URL\": \"pg://x\", \"PORT\": 5432,"
+                       " \"OFF\": null, \"bad-name\": \"x\"},\n"
+                       " \"list\": [{\"name\": \"TOKEN\", \"value\": \"t\\u00e9\\ud83d\\ude00\"}, [1, 2]],"
+                       " \"FLAG\": true}\n{\"NEXT\": \"ndjson\"}";
+    Pairs expected{{"A", "say \"hi\"\n"}, {"DB_URL", "pg://x"}, {"PORT", "5432"},
+                   {"TOKEN", "t\xc3\xa9\xf0\x9f\x98\x80"}, {"FLAG", "true"}, {"NEXT", "ndjson"}};
+    for (size_t step : {1u, 3u, 7u, 4096u}) {
+        EXPECT_EQ(importChunked(storage::ImportFormat::Json, json, step), expected) << "step " << step;
+    }
+    EXPECT_EQ(storage::parse_json_min("{\"K\": \"v\"}"), (Pairs{{"K", "v"}}));
+
+    EXPECT_THROW(importChunked(storage::ImportFormat::Json, "{\"A\": \"open", 4), std::runtime_error);
+    EXPECT_THROW(importChunked(storage::ImportFormat::Json, "{\"A\" \"x\"}", 4), std::runtime_error);
+    EXPECT_THROW(importChunked(storage::ImportFormat::Json, "[1, 2}", 4), std::runtime_error);
+}
+
+TEST(ImportParser, EnvQuotesAndMultilineValues) {
+    std::string env = "# comment\r\n"
+                      "export A=plain value\n"
+                      "B=\"tab\\there \\\"q\\\"\"\n"
+                      "C='single $literal'\n"
+                      "PEM=\"-----BEGIN-----\n"
+                      "abc\n"
+                      "-----END-----\"\n"
+                      "alias ll=ls\n"
+                      "9BAD=x\n"
+                      "LAST=no-newline";
+    Pairs expected{{"A", "plain value"}, {"B", "tab\there \"q\""}, {"C", "single $literal"},
+                   {"PEM", "-----BEGIN-----\nabc\n-----END-----"}, {"LAST", "no-newline"}};
+    for (size_t step : {1u, 5u, 4096u}) {
+        EXPECT_EQ(importChunked(storage::ImportFormat::Env, env, step), expected) << "step " << step;
+    }
+    std::istringstream in(env);
+    EXPECT_EQ(storage::parse_env_file(in), expected);
+    EXPECT_THROW(importChunked(storage::ImportFormat::Env, "A=\"never closed\n", 8), std::runtime_error);
+}
+
+TEST(ImportParser, YamlScalarsAndBlocks) {
+    std::string yaml = "---\n"
+                       "prod:\n"
+                       "  API_KEY: sk-123 # trailing comment\n"
+                       "  QUOTED: \"a\\nb\"\n"
+                       "  SINGLE: 'it''s'\n"
+                       "  CERT: |\n"
+                       "    line one\n"
+                       "    line two\n"
+                       "\n"
+                       "  FOLDED: >-\n"
+                       "    folded\n"
+                       "    text\n"
+                       "- ITEM: x\n";
+    Pairs expected{{"API_KEY", "sk-123"}, {"QUOTED", "a\nb"}, {"SINGLE", "it's"},
+                   {"CERT", "line one\nline two\n"}, {"FOLDED", "folded text"}, {"ITEM", "x"}};
+    for (size_t step : {1u, 6u, 4096u}) {
+        EXPECT_EQ(importChunked(storage::ImportFormat::Yaml, yaml, step), expected) << "step " << step;
+    }
+
+    storage::ImportFormat format;
+    EXPECT_TRUE(storage::parseImportFormat("yml", format));
+    EXPECT_EQ(format, storage::ImportFormat::Yaml);
+    EXPECT_FALSE(storage::parseImportFormat("toml", format));
+}
+
+TEST_F(BlobStoreTest, BlobValuesStreamInSegments) {
+    std::mt19937 gen(7);
+    std::string value(storage::BLOB_CHUNK_SIZE * 2 + 17, '\0');
+    for (auto& c : value) {
+        c = static_cast<char>(gen());
+    }
+    storage::BlobStore store(cfg, "");
+    std::istringstream in(value);
+    storage::BlobRef ref = store.put(in);
+    EXPECT_EQ(ref.size, value.size());
+
+    std::string stored = storage::formatBlobRef(ref);
+    storage::BlobRef parsed;
+    ASSERT_TRUE(storage::parseBlobRef(stored, parsed));
+    EXPECT_EQ(parsed.id, ref.id);
+    EXPECT_EQ(parsed.size, ref.size);
+    EXPECT_FALSE(storage::parseBlobRef(stored.substr(1), parsed));
+    EXPECT_FALSE(storage::parseBlobRef("plain value", parsed));
+
+    std::vector<size_t> pieces;
+    std::string streamed;
+    EXPECT_TRUE(store.stream(ref, [&](std::string_view piece) {
+        pieces.push_back(piece.size());
+        streamed.append(piece);
+        return true;
+    }));
+    EXPECT_EQ(pieces, (std::vector<size_t>{storage::BLOB_CHUNK_SIZE, storage::BLOB_CHUNK_SIZE, 17}));
+    EXPECT_EQ(streamed, value);
+
+    std::istringstream empty("");
+    storage::BlobRef none = store.put(empty);
+    std::string read = "stale";
+    EXPECT_TRUE(store.read(none, read));
+    EXPECT_EQ(read, "");
+
+    // A reference whose blob is gone (as after a sync) does not resolve
+    fs::remove(fs::path(storage::BlobStore::dir(cfg)) / ref.id);
+    EXPECT_FALSE(storage::resolveBlobValue(cfg, stored));
+}
+
+TEST_F(BlobStoreTest, AeadBlobSegmentsAreSealedAndBound) {
+    if (!crypto::aeadAvailable()) {
+        GTEST_SKIP() << "built without OpenSSL";
+    }
+    cfg.forcePlain = false;
+    cfg.backend = "aead";
+    cfg.presetPassphrase = "test-passphrase";
+    std::string value;
+    while (value.size() < storage::BLOB_CHUNK_SIZE + 100) {
+        value += "-----BEGIN CERTIFICATE-----\n";
+    }
+    storage::BlobStore store(cfg, cfg.presetPassphrase);
+    std::istringstream in(value);
+    storage::BlobRef ref = store.put(in);
+    fs::path file = fs::path(storage::BlobStore::dir(cfg)) / ref.id;
+    std::string sealed = readFile(file);
+    EXPECT_EQ(sealed.find("BEGIN CERTIFICATE"), std::string::npos);
+
+    std::string read;
+    EXPECT_TRUE(store.read(ref, read));
+    EXPECT_EQ(read, value);
+    storage::BlobStore wrong(cfg, "nope");
+    EXPECT_FALSE(wrong.read(ref, read));
+
+    // Dropping the last segment (and fixing the header) is noticed
+    std::string cut = sealed;
+    uint32_t first = static_cast<unsigned char>(cut[24]) | static_cast<unsigned char>(cut[25]) << 8 |
+                     static_cast<unsigned char>(cut[26]) << 16 | static_cast<unsigned char>(cut[27]) << 24;
+    cut.resize(24 + 4 + first);
+    for (int i = 0; i < 8; ++i) {
+        cut[8 + i] = static_cast<char>((storage::BLOB_CHUNK_SIZE >> (8 * i)) & 0xff);
+    }
+    cut[20] = 1;
+    system::writeFileAtomic(file, cut);
+    storage::BlobRef shorter = ref;
+    shorter.size = storage::BLOB_CHUNK_SIZE;
+    EXPECT_FALSE(store.read(shorter, read));
+    EXPECT_FALSE(store.read(ref, read));
+}
+
+TEST_F(BlobStoreTest, BlobGarbageKeepsReferencedBlobs) {
+    storage::BlobStore store(cfg, "");
+    std::istringstream a("kept"), b("dropped");
+    storage::BlobRef kept = store.put(a);
+    storage::BlobRef dropped = store.put(b);
+    storage::writeProfile(cfg, "ops", {"CERT"});
+    storage::saveProfileKeys(cfg, "ops", {{"CERT", storage::formatBlobRef(kept)}});
+
+    // Fresh blobs are left alone: their reference may not be saved yet
+    EXPECT_EQ(storage::collectBlobGarbage(cfg), 0u);
+    auto old = fs::file_time_type::clock::now() - std::chrono::hours(1);
+    for (const auto& entry : fs::directory_iterator(storage::BlobStore::dir(cfg))) {
+        fs::last_write_time(entry.path(), old);
+    }
+    EXPECT_EQ(storage::collectBlobGarbage(cfg), 1u);
+    std::string value;
+    EXPECT_TRUE(store.read(kept, value));
+    EXPECT_EQ(value, "kept");
+    EXPECT_FALSE(store.read(dropped, value));
+}
+
+TEST_F(RekeyTest, RekeyRotatesEveryProfileObjectAndBlob) {
+    if (!crypto::aeadAvailable()) {
+        GTEST_SKIP() << "built without OpenSSL";
+    }
+    cfg.forcePlain = false;
+    cfg.backend = "aead";
+    cfg.vaultPath = storage::vaultPathFor(cfg, storage::Backend::Aead);
+    cfg.presetPassphrase = "old-passphrase";
+    storage::BlobStore blobs(cfg, cfg.presetPassphrase);
+    std::istringstream in(std::string(storage::BLOB_CHUNK_SIZE + 10, 'k'));
+    storage::BlobRef ref = blobs.put(in);
+    for (int i = 0; i < 6; ++i) {
+        std::string name = "p" + std::to_string(i);
+        storage::writeProfile(cfg, name, {"TOKEN"});
+        storage::saveProfileKeys(cfg, name, {{"TOKEN", "t" + std::to_string(i)}});
+    }
+    storage::saveProfileKeys(cfg, "p0", {{"TOKEN", "t0"}, {"CERT", storage::formatBlobRef(ref)}});
+    cfg.contentStore = true;
+    storage::writeProfile(cfg, "cas", {"SHARED"});
+    storage::saveProfileKeys(cfg, "cas", {{"SHARED", "sk-shared"}});
+    core::KeyStore vault;
+    vault.kv["GLOBAL"] = "g";
+    storage::saveVault(cfg, vault);
+
+    core::Config to = cfg;
+    to.presetPassphrase = "new-passphrase";
+    storage::RekeyOptions options;
+    options.jobs = 4;
+    storage::RekeyReport report = storage::rekeyAll(cfg, to, options);
+    ASSERT_TRUE(report.complete()) << report.failed.front();
+    EXPECT_EQ(report.profiles, 7u);
+    EXPECT_TRUE(report.vault);
+    EXPECT_GE(report.objects, 3u); // the shared value, the key sentinel and the blob
+    EXPECT_FALSE(fs::exists(storage::rekeyJournalPath(cfg)));
+
+    std::map<std::string, std::string> keys;
+    EXPECT_FALSE(storage::tryLoadProfileKeys(cfg, "p3", keys));
+    ASSERT_TRUE(storage::tryLoadProfileKeys(to, "p3", keys));
+    EXPECT_EQ(keys["TOKEN"], "t3");
+    EXPECT_EQ(storage::loadProfileKeys(to, "cas")["SHARED"], "sk-shared");
+    core::KeyStore check;
+    ASSERT_TRUE(storage::tryLoadVault(to, check));
+    EXPECT_EQ(check.kv["GLOBAL"], "g");
+    std::string value;
+    EXPECT_FALSE(blobs.read(ref, value));
+    ASSERT_TRUE(storage::BlobStore(to, to.presetPassphrase).read(ref, value));
+    EXPECT_EQ(value.size(), storage::BLOB_CHUNK_SIZE + 10);
+}
+
+TEST_F(RekeyTest, RekeyResumesFromItsJournal) {
+    if (!crypto::aeadAvailable()) {
+        GTEST_SKIP() << "built without OpenSSL";
+    }
+    cfg.forcePlain = false;
+    cfg.backend = "aead";
+    cfg.vaultPath = storage::vaultPathFor(cfg, storage::Backend::Aead);
+    cfg.presetPassphrase = "old-passphrase";
+    for (const char* name : {"a", "b", "c"}) {
+        storage::writeProfile(cfg, name, {"TOKEN"});
+        storage::saveProfileKeys(cfg, name, {{"TOKEN", name}});
+    }
+    core::Config to = cfg;
+    to.presetPassphrase = "new-passphrase";
+
+    // A run that swapped and recorded "a", then stopped
+    storage::saveProfileKeys(to, "a", {{"TOKEN", "a"}});
+    fs::create_directories(cfg.persistDir);
+    {
+        std::ofstream journal(storage::rekeyJournalPath(cfg));
+        journal << "ak-rekey 1 aead\nprofile\ta\n";
+    }
+    EXPECT_EQ(storage::pendingRekeyTarget(cfg), "aead");
+
+    // Only a run towards the same backend may continue it
+    core::Config plain = cfg;
+    plain.backend = "plain";
+    plain.vaultPath = storage::vaultPathFor(plain, storage::Backend::Plain);
+    EXPECT_THROW(storage::rekeyAll(cfg, plain), std::runtime_error);
+
+    storage::RekeyReport report = storage::rekeyAll(cfg, to);
+    ASSERT_TRUE(report.complete());
+    EXPECT_EQ(report.profiles, 3u);
+    EXPECT_EQ(report.resumed, 1u);
+    EXPECT_EQ(storage::pendingRekeyTarget(cfg), "");
+    for (const char* name : {"a", "b", "c"}) {
+        EXPECT_EQ(storage::loadProfileKeys(to, name)["TOKEN"], name);
+    }
+}
+
+TEST_F(RekeyTest, RekeyKeepsTheJournalWhenAnItemFails) {
+    if (!crypto::aeadAvailable()) {
+        GTEST_SKIP() << "built without OpenSSL";
+    }
+    cfg.forcePlain = false;
+    cfg.backend = "aead";
+    cfg.vaultPath = storage::vaultPathFor(cfg, storage::Backend::Aead);
+    cfg.presetPassphrase = "old-passphrase";
+    storage::writeProfile(cfg, "good", {"TOKEN"});
+    storage::saveProfileKeys(cfg, "good", {{"TOKEN", "fine"}});
+    core::Config other = cfg;
+    other.presetPassphrase = "unrelated";
+    storage::writeProfile(cfg, "odd", {"TOKEN"});
+    storage::saveProfileKeys(other, "odd", {{"TOKEN", "sealed elsewhere"}});
+
+    core::Config to = cfg;
+    to.presetPassphrase = "new-passphrase";
+    storage::RekeyReport report = storage::rekeyAll(cfg, to);
+    EXPECT_FALSE(report.complete());
+    EXPECT_EQ(report.failed, (std::vector<std::string>{"profile odd"}));
+    EXPECT_EQ(storage::pendingRekeyTarget(cfg), "aead");
+    EXPECT_EQ(storage::loadProfileKeys(to, "good")["TOKEN"], "fine");
+    // The failed item keeps its old file
+    EXPECT_EQ(storage::loadProfileKeys(other, "odd")["TOKEN"], "sealed elsewhere");
+}
+
+TEST_F(RekeyTest, MigrateFromPlainKeepsEveryValue) {
+    if (!crypto::aeadAvailable()) {
+        GTEST_SKIP() << "built without OpenSSL";
+    }
+    storage::writeProfile(cfg, "dev", {"TOKEN"});
+    storage::saveProfileKeys(cfg, "dev", {{"TOKEN", "sk-dev"}});
+    core::KeyStore vault;
+    vault.kv["GLOBAL"] = "g";
+    storage::saveVault(cfg, vault);
+
+    core::Config to = cfg;
+    to.forcePlain = false;
+    to.backend = "aead";
+    to.vaultPath = storage::vaultPathFor(to, storage::Backend::Aead);
+    to.presetPassphrase = "test-passphrase";
+    storage::RekeyReport report = storage::rekeyAll(cfg, to);
+    ASSERT_TRUE(report.complete());
+    EXPECT_EQ(report.profiles, 1u);
+    EXPECT_TRUE(report.vault);
+    EXPECT_EQ(storage::loadProfileKeys(to, "dev")["TOKEN"], "sk-dev");
+    EXPECT_EQ(readFile(storage::profileKeysPath(to, "dev")).find("sk-dev"), std::string::npos);
+    EXPECT_FALSE(fs::exists(storage::profileKeysPathFor(cfg, "dev", storage::Backend::Plain)));
+    EXPECT_FALSE(fs::exists(storage::vaultPathFor(cfg, storage::Backend::Plain)));
+}
+
+namespace {
+
+// Counts round trips so a test can check what a sync costs
+class CountingRemote : public storage::RemoteBackend {
+public:
+    explicit CountingRemote(std::unique_ptr<storage::RemoteBackend> inner) : inner_(std::move(inner)) {}
+
+    storage::RemoteObject get(const std::string& name, const std::string& etag) override {
+        ++gets;
+        return inner_->get(name, etag);
+    }
+    bool put(const std::string& name, const std::string& data, const std::string* ifMatch,
+             std::string& etag) override {
+        ++puts;
+        return inner_->put(name, data, ifMatch, etag);
+    }
+    std::string describe() const override { return inner_->describe(); }
+
+    int gets = 0;
+    int puts = 0;
+
+private:
+    std::unique_ptr<storage::RemoteBackend> inner_;
+};
+
+std::vector<std::string> actions(const storage::SyncReport& report) {
+    std::vector<std::string> out;
+    for (const auto& change : report.changes) {
+        out.push_back(change.profile + " " + change.action);
+    }
+    return out;
+}
+
+} // namespace
+
+TEST_F(SyncTest, SyncMergesProfilesBetweenMachines) {
+    if (!crypto::aeadAvailable()) {
+        GTEST_SKIP() << "built without OpenSSL";
+    }
+    cfg.presetPassphrase = "sync-pass";
+    core::Config laptop = cfg;
+    laptop.configDir = (root / "laptop").string();
+    laptop.profilesDir = (root / "laptop" / "profiles").string();
+    laptop.persistDir = (root / "laptop" / "persist").string();
+    laptop.vaultPath = (root / "laptop" / "keys.env").string();
+    fs::create_directories(laptop.configDir);
+    CountingRemote remote(storage::openRemote("file://" + (root / "remote").string()));
+
+    storage::writeProfile(cfg, "dev", {"A", "B"});
+    storage::saveProfileKeys(cfg, "dev", {{"A", "sk-alpha"}, {"B", "sk-beta"}});
+    EXPECT_EQ(actions(storage::syncProfiles(cfg, remote)), (std::vector<std::string>{"dev pushed"}));
+    for (fs::recursive_directory_iterator it(root / "remote"), end; it != end; ++it) {
+        if (it->is_regular_file()) {
+            EXPECT_EQ(readFile(it->path()).find("sk-alpha"), std::string::npos) << it->path();
+        }
+    }
+
+    EXPECT_EQ(actions(storage::syncProfiles(laptop, remote)), (std::vector<std::string>{"dev pulled"}));
+    EXPECT_EQ(storage::loadProfileKeys(laptop, "dev"), storage::loadProfileKeys(cfg, "dev"));
+    EXPECT_EQ(storage::readProfile(laptop, "dev"), (std::vector<std::string>{"A", "B"}));
+
+    // Both machines edit the profile: the second to sync merges
+    storage::saveProfileKeys(cfg, "dev", {{"A", "sk-alpha-2"}, {"B", "sk-beta"}});
+    storage::saveProfileKeys(laptop, "dev", {{"A", "sk-alpha"}, {"B", "sk-beta"}, {"C", "sk-gamma"}});
+    EXPECT_EQ(actions(storage::syncProfiles(cfg, remote)), (std::vector<std::string>{"dev pushed"}));
+    EXPECT_EQ(actions(storage::syncProfiles(laptop, remote, storage::SyncMode::Status)),
+              (std::vector<std::string>{"dev remote changes", "dev local changes"}));
+    EXPECT_EQ(actions(storage::syncProfiles(laptop, remote)), (std::vector<std::string>{"dev merged"}));
+    EXPECT_EQ(actions(storage::syncProfiles(cfg, remote)), (std::vector<std::string>{"dev pulled"}));
+    std::map<std::string, std::string> expected{{"A", "sk-alpha-2"}, {"B", "sk-beta"}, {"C", "sk-gamma"}};
+    EXPECT_EQ(storage::loadProfileKeys(cfg, "dev"), expected);
+    EXPECT_EQ(storage::loadProfileKeys(laptop, "dev"), expected);
+
+    // Nothing changed anywhere: one conditional read of the index
+    remote.gets = 0;
+    remote.puts = 0;
+    auto idle = storage::syncProfiles(laptop, remote);
+    EXPECT_TRUE(idle.changes.empty());
+    EXPECT_EQ(idle.requests, 1u);
+    EXPECT_EQ(remote.gets, 1);
+    EXPECT_EQ(remote.puts, 0);
+
+    // A wrong passphrase cannot read what the remote holds
+    core::Config stranger = laptop;
+    stranger.configDir = (root / "stranger").string();
+    stranger.profilesDir = (root / "stranger" / "profiles").string();
+    stranger.persistDir = (root / "stranger" / "persist").string();
+    stranger.presetPassphrase = "wrong";
+    fs::create_directories(stranger.configDir);
+    EXPECT_THROW(storage::syncProfiles(stranger, remote), std::runtime_error);
+}
@@ -0,0 +1,161 @@
+#include "gtest/gtest.h"
+#include "core/config.hpp"
+#include "system/system.hpp"
+#include "system/process.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <thread>
+
+using namespace ak::system;
+
+TEST(ShellHook, QuotesValuesPerShell) {
+    EXPECT_EQ(shellExport(Shell::Bash, "A", "it's $HOME"), "export A='it'\\''s $HOME';\n");
+    EXPECT_EQ(shellExport(Shell::Zsh, "A", "x\ny"), "export A='x\ny';\n");
+    EXPECT_EQ(shellExport(Shell::Fish, "A", "it's a\\b"), "set -gx A 'it\\'s a\\\\b';\n");
+    EXPECT_EQ(shellUnset(Shell::Bash, "A"), "unset A;\n");
+    EXPECT_EQ(shellUnset(Shell::Fish, "A"), "set -e A;\n");
+
+    Shell shell;
+    EXPECT_TRUE(parseShell("fish", shell));
+    EXPECT_EQ(shell, Shell::Fish);
+    EXPECT_FALSE(parseShell("tcsh", shell));
+}
+
+TEST(ShellHook, StateRoundTrips) {
+    HookState state;
+    state.dirKey = "e85b10c77f0039f3";
+    state.generation = "1760000000000000000.42.0";
+    state.loadAll = true;
+    state.exported = {{"FOO", hookValueHash("k", "bar")}, {"BAZ", hookValueHash("k", "q")}};
+
+    HookState decoded;
+    ASSERT_TRUE(decodeHookState(encodeHookState(state), decoded));
+    EXPECT_EQ(decoded.dirKey, state.dirKey);
+    EXPECT_EQ(decoded.generation, state.generation);
+    EXPECT_TRUE(decoded.loadAll);
+    EXPECT_EQ(decoded.exported, state.exported);
+
+    HookState empty;
+    ASSERT_TRUE(decodeHookState(encodeHookState(empty), decoded));
+    EXPECT_TRUE(decoded.exported.empty());
+    EXPECT_FALSE(decodeHookState("garbage", decoded));
+    EXPECT_FALSE(decodeHookState("2:a:b:0:", decoded));
+}
+
+TEST(ShellHook, DeltaOnlyTouchesChangedVariables) {
+    HookState previous;
+    const std::string key = "hook-key";
+    previous.exported = {{"KEEP", hookValueHash(key, "same")}, {"GONE", hookValueHash(key, "x")},
+                         {"ROTATED", hookValueHash(key, "old")}};
+
+    HookState next;
+    next.dirKey = "k";
+    next.generation = "g";
+    std::map<std::string, std::string> values = {{"KEEP", "same"}, {"ROTATED", "new"}, {"ADDED", "1"}};
+    for (const auto& [name, value] : values) {
+        next.exported[name] = hookValueHash(key, value);
+    }
+
+    std::string delta = hookDelta(Shell::Bash, previous, next, values);
+    EXPECT_NE(delta.find("unset GONE;\n"), std::string::npos);
+    EXPECT_NE(delta.find("export ROTATED='new';\n"), std::string::npos);
+    EXPECT_NE(delta.find("export ADDED='1';\n"), std::string::npos);
+    EXPECT_EQ(delta.find("KEEP='"), std::string::npos);
+    EXPECT_NE(delta.find("export AK_HOOK_STATE='" + encodeHookState(next) + "';\n"), std::string::npos);
+    EXPECT_EQ(delta.find("same"), std::string::npos);
+}
+
+TEST(ShellHook, ValueHashesAreKeyedPerInstall) {
+    std::random_device rd;
+    auto root = std::filesystem::temp_directory_path() / ("ak_hook_" + std::to_string(rd()));
+    ak::core::Config cfg;
+    cfg.configDir = (root / "a").string();
+    ak::core::Config other;
+    other.configDir = (root / "b").string();
+
+    std::string key = hookStateKey(cfg);
+    EXPECT_EQ(key.size(), 64u);
+    EXPECT_EQ(hookStateKey(cfg), key);
+    EXPECT_NE(hookStateKey(other), key);
+    std::string stored;
+    std::getline(std::ifstream(root / "a" / "hook.key"), stored);
+    EXPECT_EQ(stored, key);
+#ifdef __unix__
+    auto perms = std::filesystem::status(root / "a" / "hook.key").permissions();
+    EXPECT_EQ(perms & (std::filesystem::perms::group_all | std::filesystem::perms::others_all),
+              std::filesystem::perms::none);
+#endif
+
+    // Same value, different install: nothing to match an exported hash against
+    EXPECT_EQ(hookValueHash(key, "sk-secret"), hookValueHash(key, "sk-secret"));
+    EXPECT_NE(hookValueHash(key, "sk-secret"), hookValueHash(hookStateKey(other), "sk-secret"));
+    EXPECT_EQ(hookValueHash(key, "sk-secret").size(), 12u);
+
+    HookState state;
+    state.exported = {{"TOKEN", hookValueHash(key, "sk-secret")}};
+    EXPECT_EQ(encodeHookState(state).find(key), std::string::npos);
+    std::filesystem::remove_all(root);
+}
+
+#ifdef __unix__
+TEST(RunProcess, MergesEnvironmentInPlace) {
+    setenv("AK_RUN_TEST_EXISTING", "old", 1);
+    auto env = mergeEnvironment({{"AK_RUN_TEST_NEW", "1"}, {"AK_RUN_TEST_EXISTING", "a"}, {"AK_RUN_TEST_EXISTING", "b"}});
+    unsetenv("AK_RUN_TEST_EXISTING");
+
+    EXPECT_EQ(std::count(env.begin(), env.end(), "AK_RUN_TEST_EXISTING=b"), 1);
+    EXPECT_EQ(std::count_if(env.begin(), env.end(),
+                            [](const std::string& e) { return e.rfind("AK_RUN_TEST_EXISTING=", 0) == 0; }),
+              1);
+    EXPECT_EQ(env.back(), "AK_RUN_TEST_NEW=1");
+}
+
+TEST(RunProcess, SpawnsWithEnvironmentAndReportsStatus) {
+    EXPECT_FALSE(findExecutable("sh").empty());
+    EXPECT_EQ(findExecutable("ak-no-such-program"), "");
+    EXPECT_EQ(execProcess({"ak-no-such-program"}, {}), 127);
+
+    ChildProcess child;
+    ASSERT_TRUE(spawnProcess({"sh", "-c", "test \"$AK_RUN_TEST\" = secret && exit 3"},
+                             mergeEnvironment({{"AK_RUN_TEST", "secret"}}), child));
+    int code = 0;
+    ASSERT_TRUE(waitProcess(child, -1, code));
+    EXPECT_EQ(code, 3);
+
+    ASSERT_TRUE(spawnProcess({"sh", "-c", "sleep 30"}, mergeEnvironment({}), child));
+    EXPECT_FALSE(waitProcess(child, 50, code));
+    stopProcess(child, 1000);
+    EXPECT_EQ(child.pid, -1);
+}
+
+TEST(RunProcess, CapturesOutputWithTimeoutAndCancel) {
+    auto done = captureProcess({"sh", "-c", "echo out; echo err >&2; exit 4"}, 5000);
+    ASSERT_TRUE(done.started);
+    EXPECT_EQ(done.exitCode, 4);
+    EXPECT_EQ(done.output, "out\nerr\n");
+    EXPECT_FALSE(captureProcess({"ak-no-such-program"}, 1000).started);
+
+    auto start = std::chrono::steady_clock::now();
+    auto slow = captureProcess({"sh", "-c", "echo partial; sleep 30"}, 200);
+    EXPECT_TRUE(slow.timedOut);
+    EXPECT_EQ(slow.output, "partial\n");
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(5));
+
+    std::atomic<bool> cancel{false};
+    std::thread canceller([&] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        cancel = true;
+    });
+    auto cancelled = captureProcess({"sh", "-c", "sleep 30"}, -1, &cancel);
+    canceller.join();
+    EXPECT_TRUE(cancelled.cancelled);
+    EXPECT_FALSE(cancelled.timedOut);
+}
+#endif